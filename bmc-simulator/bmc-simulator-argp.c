@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#if HAVE_ARGP_H
+#include <argp.h>
+#else /* !HAVE_ARGP_H */
+#include "freeipmi-argp.h"
+#endif /* !HAVE_ARGP_H */
+#include <limits.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "bmc-simulator.h"
+#include "bmc-simulator-argp.h"
+
+#include "freeipmi-portability.h"
+#include "parse-common.h"
+#include "error.h"
+
+const char *argp_program_version =
+  "bmc-simulator - " PACKAGE_VERSION "\n"
+  "Copyright (C) 2003-2015 FreeIPMI Core Team\n"
+  "This program is free software; you may redistribute it under the terms of\n"
+  "the GNU General Public License.  This program has absolutely no warranty.";
+
+const char *argp_program_bug_address =
+  "<" PACKAGE_BUGREPORT ">";
+
+static char cmdline_doc[] =
+  "bmc-simulator - simulate IPMI LAN BMCs for testing and benchmarking";
+
+static char cmdline_args_doc[] = "";
+
+static struct argp_option cmdline_options[] =
+  {
+    { "address", BMC_SIMULATOR_ADDRESS_KEY, "ADDRESS", 0,
+      "Specify the IPv4 address of the first simulated BMC.", 1},
+    { "port", BMC_SIMULATOR_PORT_KEY, "PORT", 0,
+      "Specify the UDP port of the first simulated BMC.", 2},
+    { "count", BMC_SIMULATOR_COUNT_KEY, "NUM", 0,
+      "Specify the number of simulated BMCs.", 3},
+    { "port-increment", BMC_SIMULATOR_PORT_INCREMENT_KEY, 0, 0,
+      "Give each simulated BMC its own port instead of its own address.", 4},
+    { "username", BMC_SIMULATOR_USERNAME_KEY, "USERNAME", 0,
+      "Specify the username accepted by the simulated BMCs.", 5},
+    { "password", BMC_SIMULATOR_PASSWORD_KEY, "PASSWORD", 0,
+      "Specify the password accepted by the simulated BMCs.", 6},
+    { "k-g", BMC_SIMULATOR_K_G_KEY, "K_G", 0,
+      "Specify the K_g BMC key used by the simulated BMCs.", 7},
+    { "privilege-level", BMC_SIMULATOR_PRIVILEGE_LEVEL_KEY, "PRIVILEGE-LEVEL", 0,
+      "Specify the maximum privilege level of the user.", 8},
+    { "script", BMC_SIMULATOR_SCRIPT_KEY, "FILE", 0,
+      "Specify a script of sensors, SEL entries and responses.", 9},
+    { "latency", BMC_SIMULATOR_LATENCY_KEY, "MILLISECONDS", 0,
+      "Specify the delay added before each packet is sent.", 10},
+    { "jitter", BMC_SIMULATOR_JITTER_KEY, "MILLISECONDS", 0,
+      "Specify the maximum random delay added on top of the latency.", 11},
+    { "loss", BMC_SIMULATOR_LOSS_KEY, "PERCENT", 0,
+      "Specify the percentage of packets dropped in each direction.", 12},
+    { "session-timeout", BMC_SIMULATOR_SESSION_TIMEOUT_KEY, "SECONDS", 0,
+      "Specify the session inactivity timeout.", 13},
+    { "max-sessions", BMC_SIMULATOR_MAX_SESSIONS_KEY, "NUM", 0,
+      "Specify the maximum number of sessions per simulated BMC.", 14},
+    { "debug", BMC_SIMULATOR_DEBUG_KEY, 0, 0,
+      "Turn on debugging.", 15},
+    { NULL, 0, NULL, 0, NULL, 0}
+  };
+
+static error_t cmdline_parse (int key, char *arg, struct argp_state *state);
+
+static struct argp cmdline_argp = { cmdline_options,
+                                    cmdline_parse,
+                                    cmdline_args_doc,
+                                    cmdline_doc };
+
+static unsigned int
+_parse_unsigned_int (const char *arg, const char *what, unsigned int min, unsigned int max)
+{
+  char *endptr;
+  long tmp;
+
+  assert (arg);
+  assert (what);
+
+  errno = 0;
+  tmp = strtol (arg, &endptr, 0);
+  if (errno
+      || endptr[0] != '\0'
+      || tmp < min
+      || tmp > max)
+    {
+      fprintf (stderr, "invalid %s\n", what);
+      exit (EXIT_FAILURE);
+    }
+
+  return (tmp);
+}
+
+static char *
+_strdup (const char *arg)
+{
+  char *rv;
+
+  assert (arg);
+
+  if (!(rv = strdup (arg)))
+    {
+      perror ("strdup");
+      exit (EXIT_FAILURE);
+    }
+
+  return (rv);
+}
+
+static error_t
+cmdline_parse (int key, char *arg, struct argp_state *state)
+{
+  struct bmc_simulator_arguments *cmd_args;
+  int tmp;
+  int rv;
+
+  assert (state);
+
+  cmd_args = state->input;
+
+  switch (key)
+    {
+    case BMC_SIMULATOR_ADDRESS_KEY: /* --address */
+      cmd_args->address = _strdup (arg);
+      break;
+    case BMC_SIMULATOR_PORT_KEY: /* --port */
+      cmd_args->port = _parse_unsigned_int (arg, "port", 1, USHRT_MAX);
+      break;
+    case BMC_SIMULATOR_COUNT_KEY: /* --count */
+      cmd_args->count = _parse_unsigned_int (arg, "count", 1, USHRT_MAX);
+      break;
+    case BMC_SIMULATOR_PORT_INCREMENT_KEY: /* --port-increment */
+      cmd_args->port_increment = 1;
+      break;
+    case BMC_SIMULATOR_USERNAME_KEY: /* --username */
+      if (strlen (arg) > IPMI_MAX_USER_NAME_LENGTH)
+        {
+          fprintf (stderr, "username too long\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->username = _strdup (arg);
+      break;
+    case BMC_SIMULATOR_PASSWORD_KEY: /* --password */
+      if (strlen (arg) > IPMI_2_0_MAX_PASSWORD_LENGTH)
+        {
+          fprintf (stderr, "password too long\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->password = _strdup (arg);
+      break;
+    case BMC_SIMULATOR_K_G_KEY: /* --k-g */
+      if ((rv = parse_kg (cmd_args->k_g, IPMI_MAX_K_G_LENGTH, arg)) < 0)
+        {
+          fprintf (stderr, "k_g input formatted incorrectly\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->k_g_len = rv;
+      break;
+    case BMC_SIMULATOR_PRIVILEGE_LEVEL_KEY: /* --privilege-level */
+      if ((tmp = parse_privilege_level (arg)) < 0)
+        {
+          fprintf (stderr, "invalid privilege level\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->privilege_level = tmp;
+      break;
+    case BMC_SIMULATOR_SCRIPT_KEY: /* --script */
+      cmd_args->script = _strdup (arg);
+      break;
+    case BMC_SIMULATOR_LATENCY_KEY: /* --latency */
+      cmd_args->latency = _parse_unsigned_int (arg, "latency", 0, INT_MAX);
+      break;
+    case BMC_SIMULATOR_JITTER_KEY: /* --jitter */
+      cmd_args->jitter = _parse_unsigned_int (arg, "jitter", 0, INT_MAX);
+      break;
+    case BMC_SIMULATOR_LOSS_KEY: /* --loss */
+      cmd_args->loss = _parse_unsigned_int (arg, "loss", 0, 100);
+      break;
+    case BMC_SIMULATOR_SESSION_TIMEOUT_KEY: /* --session-timeout */
+      cmd_args->session_timeout = _parse_unsigned_int (arg, "session timeout", 1, INT_MAX);
+      break;
+    case BMC_SIMULATOR_MAX_SESSIONS_KEY: /* --max-sessions */
+      cmd_args->max_sessions = _parse_unsigned_int (arg, "max sessions", 1, USHRT_MAX);
+      break;
+    case BMC_SIMULATOR_DEBUG_KEY: /* --debug */
+      cmd_args->debug = 1;
+      break;
+    case ARGP_KEY_ARG:
+      /* Too many arguments. */
+      argp_usage (state);
+      break;
+    case ARGP_KEY_END:
+      break;
+    default:
+      return (ARGP_ERR_UNKNOWN);
+    }
+
+  return (0);
+}
+
+void
+bmc_simulator_argp_parse (int argc, char **argv, struct bmc_simulator_arguments *cmd_args)
+{
+  assert (argc >= 0);
+  assert (argv);
+  assert (cmd_args);
+
+  memset (cmd_args, '\0', sizeof (struct bmc_simulator_arguments));
+  cmd_args->address = BMC_SIMULATOR_ADDRESS_DEFAULT;
+  cmd_args->port = BMC_SIMULATOR_PORT_DEFAULT;
+  cmd_args->count = BMC_SIMULATOR_COUNT_DEFAULT;
+  cmd_args->port_increment = 0;
+  cmd_args->username = "";
+  cmd_args->password = "";
+  cmd_args->k_g_len = 0;
+  cmd_args->privilege_level = IPMI_PRIVILEGE_LEVEL_ADMIN;
+  cmd_args->script = NULL;
+  cmd_args->latency = 0;
+  cmd_args->jitter = 0;
+  cmd_args->loss = 0;
+  cmd_args->session_timeout = BMC_SIMULATOR_SESSION_TIMEOUT_DEFAULT;
+  cmd_args->max_sessions = BMC_SIMULATOR_MAX_SESSIONS_DEFAULT;
+  cmd_args->debug = 0;
+
+  argp_parse (&cmdline_argp,
+              argc,
+              argv,
+              ARGP_IN_ORDER,
+              NULL,
+              cmd_args);
+}
@@ -0,0 +1,901 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <assert.h>
+
+#include <freeipmi/freeipmi.h>
+
+#include "bmc-simulator.h"
+#include "bmc-simulator-cmds.h"
+#include "bmc-simulator-script.h"
+#include "bmc-simulator-session.h"
+
+#include "freeipmi-portability.h"
+
+#define BMC_SIMULATOR_CHANNEL_NUMBER      0x01
+
+#define BMC_SIMULATOR_IPMI_VERSION        0x51
+
+#define BMC_SIMULATOR_SEL_EVENT_INTERVAL  60
+
+#define BMC_SIMULATOR_REPOSITORY_FREE     0x8000
+
+typedef unsigned int (*bmc_simulator_cmd_func)(struct bmc_simulator_bmc *bmc,
+                                               struct bmc_simulator_session *session,
+                                               const struct sockaddr_in *from,
+                                               const uint8_t *data,
+                                               unsigned int data_len,
+                                               uint8_t *rs);
+
+struct bmc_simulator_cmd_handler
+{
+  uint8_t net_fn;
+  uint8_t cmd;
+  uint8_t privilege_level;
+  bmc_simulator_cmd_func func;
+};
+
+static void
+_set_u16 (uint8_t *buf, uint16_t val)
+{
+  buf[0] = val & 0x00FF;
+  buf[1] = (val & 0xFF00) >> 8;
+}
+
+static void
+_set_u32 (uint8_t *buf, uint32_t val)
+{
+  buf[0] = val & 0x000000FF;
+  buf[1] = (val & 0x0000FF00) >> 8;
+  buf[2] = (val & 0x00FF0000) >> 16;
+  buf[3] = (val & 0xFF000000) >> 24;
+}
+
+static uint16_t
+_get_u16 (const uint8_t *buf)
+{
+  return (buf[0] | (buf[1] << 8));
+}
+
+static uint32_t
+_get_u32 (const uint8_t *buf)
+{
+  return (buf[0]
+          | (buf[1] << 8)
+          | (buf[2] << 16)
+          | ((uint32_t)buf[3] << 24));
+}
+
+/* returns data length of a completion code only response */
+static unsigned int
+_comp_code (uint8_t *rs, uint8_t comp_code)
+{
+  rs[1] = comp_code;
+  return (0);
+}
+
+static int
+_username_matches (const uint8_t *username)
+{
+  char buf[IPMI_MAX_USER_NAME_LENGTH];
+  unsigned int len;
+
+  len = strlen (cmd_args.username);
+  if (len > IPMI_MAX_USER_NAME_LENGTH)
+    len = IPMI_MAX_USER_NAME_LENGTH;
+
+  memset (buf, '\0', IPMI_MAX_USER_NAME_LENGTH);
+  memcpy (buf, cmd_args.username, len);
+  return (!memcmp (buf, username, IPMI_MAX_USER_NAME_LENGTH));
+}
+
+static unsigned int
+_get_channel_authentication_capabilities (struct bmc_simulator_bmc *bmc,
+                                          struct bmc_simulator_session *session,
+                                          const struct sockaddr_in *from,
+                                          const uint8_t *data,
+                                          unsigned int data_len,
+                                          uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+
+  if (data_len < 2)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  rs_data[0] = BMC_SIMULATOR_CHANNEL_NUMBER;
+
+  /* none, MD2, MD5, straight password/key */
+  rs_data[1] = 0x17;
+  if (data[0] & 0x80)
+    rs_data[1] |= 0x80;
+
+  rs_data[2] = 0;
+  if (!strlen (cmd_args.username))
+    {
+      if (!strlen (cmd_args.password))
+        rs_data[2] |= 0x01;     /* anonymous login */
+      else
+        rs_data[2] |= 0x02;     /* null username */
+    }
+  else
+    rs_data[2] |= 0x04;         /* non-null username */
+  if (cmd_args.k_g_len)
+    rs_data[2] |= 0x20;
+
+  /* IPMI 1.5 and 2.0 */
+  rs_data[3] = (data[0] & 0x80) ? 0x03 : 0x00;
+
+  /* OEM id and auxiliary data */
+  memset (&rs_data[4], '\0', 4);
+
+  return (8);
+}
+
+static unsigned int
+_get_session_challenge (struct bmc_simulator_bmc *bmc,
+                        struct bmc_simulator_session *session,
+                        const struct sockaddr_in *from,
+                        const uint8_t *data,
+                        unsigned int data_len,
+                        uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+  uint8_t authentication_type;
+
+  if (data_len < (1 + IPMI_MAX_USER_NAME_LENGTH))
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  authentication_type = data[0] & 0x0F;
+  if (authentication_type != IPMI_AUTHENTICATION_TYPE_NONE
+      && authentication_type != IPMI_AUTHENTICATION_TYPE_MD2
+      && authentication_type != IPMI_AUTHENTICATION_TYPE_MD5
+      && authentication_type != IPMI_AUTHENTICATION_TYPE_STRAIGHT_PASSWORD_KEY)
+    return (_comp_code (rs, IPMI_COMP_CODE_INVALID_DATA_FIELD_IN_REQUEST));
+
+  if (!_username_matches (&data[1]))
+    {
+      if (data[1] == '\0')
+        return (_comp_code (rs, IPMI_COMP_CODE_GET_SESSION_CHALLENGE_NULL_USERNAME_NOT_ENABLED));
+      return (_comp_code (rs, IPMI_COMP_CODE_GET_SESSION_CHALLENGE_INVALID_USERNAME));
+    }
+
+  if (!(session = bmc_simulator_session_create (bmc, from, 0)))
+    return (_comp_code (rs, IPMI_COMP_CODE_NODE_BUSY));
+
+  session->authentication_type = authentication_type;
+  if (ipmi_get_random (session->challenge_string, IPMI_CHALLENGE_STRING_LENGTH) < 0)
+    memset (session->challenge_string, 0x5A, IPMI_CHALLENGE_STRING_LENGTH);
+
+  _set_u32 (&rs_data[0], session->session_id);
+  memcpy (&rs_data[4], session->challenge_string, IPMI_CHALLENGE_STRING_LENGTH);
+  return (4 + IPMI_CHALLENGE_STRING_LENGTH);
+}
+
+/* session id is kept from the challenge, so the response goes out
+ * with the temporary session id as IPMI 1.5 requires
+ */
+static unsigned int
+_activate_session (struct bmc_simulator_bmc *bmc,
+                   struct bmc_simulator_session *session,
+                   const struct sockaddr_in *from,
+                   const uint8_t *data,
+                   unsigned int data_len,
+                   uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+  uint8_t maximum_privilege_level;
+  uint32_t initial_inbound_sequence_number;
+
+  if (data_len < (2 + IPMI_CHALLENGE_STRING_LENGTH + 4))
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if (!session
+      || session->rmcpplus
+      || session->state != BMC_SIMULATOR_SESSION_STATE_CHALLENGE)
+    return (_comp_code (rs, IPMI_COMP_CODE_ACTIVATE_SESSION_INVALID_SESSION_ID));
+
+  if ((data[0] & 0x0F) != session->authentication_type
+      || memcmp (&data[2], session->challenge_string, IPMI_CHALLENGE_STRING_LENGTH))
+    return (_comp_code (rs, IPMI_COMP_CODE_INVALID_DATA_FIELD_IN_REQUEST));
+
+  maximum_privilege_level = data[1] & 0x0F;
+  if (maximum_privilege_level > cmd_args.privilege_level)
+    return (_comp_code (rs, IPMI_COMP_CODE_ACTIVATE_SESSION_EXCEEDS_PRIVILEGE_LEVEL));
+
+  session->state = BMC_SIMULATOR_SESSION_STATE_ACTIVE;
+  session->maximum_privilege_level = maximum_privilege_level;
+  session->outbound_sequence_number = _get_u32 (&data[2 + IPMI_CHALLENGE_STRING_LENGTH]);
+  bmc->sessions_activated++;
+  bmc_simulator_debug (bmc, "session 0x%08X activated", session->session_id);
+
+  if (ipmi_get_random (&initial_inbound_sequence_number, sizeof (uint32_t)) < 0
+      || !initial_inbound_sequence_number)
+    initial_inbound_sequence_number = 1;
+
+  rs_data[0] = session->authentication_type;
+  _set_u32 (&rs_data[1], session->session_id);
+  _set_u32 (&rs_data[5], initial_inbound_sequence_number);
+  rs_data[9] = maximum_privilege_level;
+  return (10);
+}
+
+static unsigned int
+_set_session_privilege_level (struct bmc_simulator_bmc *bmc,
+                              struct bmc_simulator_session *session,
+                              const struct sockaddr_in *from,
+                              const uint8_t *data,
+                              unsigned int data_len,
+                              uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+  uint8_t privilege_level;
+
+  if (data_len < 1)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  privilege_level = data[0] & 0x0F;
+  if (privilege_level)
+    {
+      if (privilege_level < IPMI_PRIVILEGE_LEVEL_USER
+          || privilege_level > IPMI_PRIVILEGE_LEVEL_OEM)
+        return (_comp_code (rs, IPMI_COMP_CODE_INVALID_DATA_FIELD_IN_REQUEST));
+
+      if (privilege_level > session->maximum_privilege_level)
+        return (_comp_code (rs, IPMI_COMP_CODE_SET_SESSION_PRIVILEGE_LEVEL_REQUESTED_LEVEL_EXCEEDS_USER_PRIVILEGE_LIMIT));
+
+      session->privilege_level = privilege_level;
+    }
+
+  rs_data[0] = session->privilege_level;
+  return (1);
+}
+
+static unsigned int
+_close_session (struct bmc_simulator_bmc *bmc,
+                struct bmc_simulator_session *session,
+                const struct sockaddr_in *from,
+                const uint8_t *data,
+                unsigned int data_len,
+                uint8_t *rs)
+{
+  struct bmc_simulator_session *close_session;
+
+  if (data_len < 4)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if (!(close_session = bmc_simulator_session_find (bmc, _get_u32 (data))))
+    return (_comp_code (rs, IPMI_COMP_CODE_CLOSE_SESSION_INVALID_SESSION_ID_IN_REQUEST));
+
+  if (close_session != session
+      && session->privilege_level < IPMI_PRIVILEGE_LEVEL_ADMIN)
+    return (_comp_code (rs, IPMI_COMP_CODE_INSUFFICIENT_PRIVILEGE_LEVEL));
+
+  bmc_simulator_session_destroy (bmc, close_session);
+  return (0);
+}
+
+static unsigned int
+_get_device_id (struct bmc_simulator_bmc *bmc,
+                struct bmc_simulator_session *session,
+                const struct sockaddr_in *from,
+                const uint8_t *data,
+                unsigned int data_len,
+                uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+
+  rs_data[0] = IPMI_SLAVE_ADDRESS_BMC;  /* device id */
+  rs_data[1] = 0x01;                    /* device revision */
+  rs_data[2] = 0x01;                    /* firmware major revision */
+  rs_data[3] = 0x00;                    /* firmware minor revision */
+  rs_data[4] = 0x02;                    /* IPMI 2.0 */
+  rs_data[5] = 0x87;                    /* chassis, SEL, SDR repository, sensor */
+  memset (&rs_data[6], '\0', 5);        /* manufacturer id, product id */
+  return (11);
+}
+
+static unsigned int
+_get_device_guid (struct bmc_simulator_bmc *bmc,
+                  struct bmc_simulator_session *session,
+                  const struct sockaddr_in *from,
+                  const uint8_t *data,
+                  unsigned int data_len,
+                  uint8_t *rs)
+{
+  memcpy (rs + 2, bmc->guid, IPMI_MANAGED_SYSTEM_GUID_LENGTH);
+  return (IPMI_MANAGED_SYSTEM_GUID_LENGTH);
+}
+
+static unsigned int
+_get_chassis_status (struct bmc_simulator_bmc *bmc,
+                     struct bmc_simulator_session *session,
+                     const struct sockaddr_in *from,
+                     const uint8_t *data,
+                     unsigned int data_len,
+                     uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+
+  rs_data[0] = bmc->power_state ? 0x01 : 0x00;
+  rs_data[1] = 0x10;            /* last power on via IPMI */
+  rs_data[2] = 0x00;
+  return (3);
+}
+
+static unsigned int
+_chassis_control (struct bmc_simulator_bmc *bmc,
+                  struct bmc_simulator_session *session,
+                  const struct sockaddr_in *from,
+                  const uint8_t *data,
+                  unsigned int data_len,
+                  uint8_t *rs)
+{
+  if (data_len < 1)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  switch (data[0] & 0x0F)
+    {
+    case IPMI_CHASSIS_CONTROL_POWER_DOWN:
+    case IPMI_CHASSIS_CONTROL_INITIATE_SOFT_SHUTDOWN:
+      bmc->power_state = 0;
+      break;
+    case IPMI_CHASSIS_CONTROL_POWER_UP:
+    case IPMI_CHASSIS_CONTROL_POWER_CYCLE:
+      bmc->power_state = 1;
+      break;
+    case IPMI_CHASSIS_CONTROL_HARD_RESET:
+    case IPMI_CHASSIS_CONTROL_PULSE_DIAGNOSTIC_INTERRUPT:
+      if (!bmc->power_state)
+        return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_PARAMETER_NOT_SUPPORTED));
+      break;
+    default:
+      return (_comp_code (rs, IPMI_COMP_CODE_INVALID_DATA_FIELD_IN_REQUEST));
+    }
+
+  bmc_simulator_debug (bmc, "chassis control 0x%02X, power %s",
+                       data[0] & 0x0F,
+                       bmc->power_state ? "on" : "off");
+  return (0);
+}
+
+static unsigned int
+_get_sdr_repository_info (struct bmc_simulator_bmc *bmc,
+                          struct bmc_simulator_session *session,
+                          const struct sockaddr_in *from,
+                          const uint8_t *data,
+                          unsigned int data_len,
+                          uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+
+  rs_data[0] = BMC_SIMULATOR_IPMI_VERSION;
+  _set_u16 (&rs_data[1], script.sensors_count);
+  _set_u16 (&rs_data[3], BMC_SIMULATOR_REPOSITORY_FREE);
+  _set_u32 (&rs_data[5], script.sdr_timestamp);
+  _set_u32 (&rs_data[9], 0);
+  rs_data[13] = 0x02;           /* reserve supported */
+  return (14);
+}
+
+static unsigned int
+_reserve_sdr_repository (struct bmc_simulator_bmc *bmc,
+                         struct bmc_simulator_session *session,
+                         const struct sockaddr_in *from,
+                         const uint8_t *data,
+                         unsigned int data_len,
+                         uint8_t *rs)
+{
+  if (!++bmc->sdr_reservation_id)
+    bmc->sdr_reservation_id++;
+  _set_u16 (rs + 2, bmc->sdr_reservation_id);
+  return (2);
+}
+
+static unsigned int
+_get_sdr (struct bmc_simulator_bmc *bmc,
+          struct bmc_simulator_session *session,
+          const struct sockaddr_in *from,
+          const uint8_t *data,
+          unsigned int data_len,
+          uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+  uint16_t record_id;
+  unsigned int offset;
+  unsigned int bytes_to_read;
+  unsigned int index;
+
+  if (data_len < 6)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if (!script.sensors_count)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUESTED_SENSOR_DATA_OR_RECORD_NOT_PRESENT));
+
+  record_id = _get_u16 (&data[2]);
+  offset = data[4];
+  bytes_to_read = data[5];
+
+  /* reservation only required for partial reads */
+  if (offset
+      && _get_u16 (&data[0]) != bmc->sdr_reservation_id)
+    return (_comp_code (rs, IPMI_COMP_CODE_RESERVATION_CANCELLED));
+
+  if (record_id == IPMI_SDR_RECORD_ID_FIRST)
+    index = 0;
+  else if (record_id == IPMI_SDR_RECORD_ID_LAST)
+    index = script.sensors_count - 1;
+  else if (record_id <= script.sensors_count)
+    index = record_id - 1;
+  else
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUESTED_SENSOR_DATA_OR_RECORD_NOT_PRESENT));
+
+  if (offset >= script.sdr_len[index])
+    return (_comp_code (rs, IPMI_COMP_CODE_PARAMETER_OUT_OF_RANGE));
+
+  if (bytes_to_read > (script.sdr_len[index] - offset))
+    bytes_to_read = script.sdr_len[index] - offset;
+
+  if ((index + 1) < script.sensors_count)
+    _set_u16 (&rs_data[0], index + 2);
+  else
+    _set_u16 (&rs_data[0], IPMI_SDR_RECORD_ID_LAST);
+  memcpy (&rs_data[2], &script.sdr[index][offset], bytes_to_read);
+  return (2 + bytes_to_read);
+}
+
+static unsigned int
+_get_sel_info (struct bmc_simulator_bmc *bmc,
+               struct bmc_simulator_session *session,
+               const struct sockaddr_in *from,
+               const uint8_t *data,
+               unsigned int data_len,
+               uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+
+  rs_data[0] = BMC_SIMULATOR_IPMI_VERSION;
+  _set_u16 (&rs_data[1], bmc->sel_entries_count);
+  _set_u16 (&rs_data[3], BMC_SIMULATOR_REPOSITORY_FREE);
+  _set_u32 (&rs_data[5], script.start_time);
+  _set_u32 (&rs_data[9], bmc->sel_erase_timestamp);
+  rs_data[13] = 0x02;           /* reserve supported */
+  return (14);
+}
+
+static unsigned int
+_reserve_sel (struct bmc_simulator_bmc *bmc,
+              struct bmc_simulator_session *session,
+              const struct sockaddr_in *from,
+              const uint8_t *data,
+              unsigned int data_len,
+              uint8_t *rs)
+{
+  if (!++bmc->sel_reservation_id)
+    bmc->sel_reservation_id++;
+  _set_u16 (rs + 2, bmc->sel_reservation_id);
+  return (2);
+}
+
+static unsigned int
+_get_sel_entry (struct bmc_simulator_bmc *bmc,
+                struct bmc_simulator_session *session,
+                const struct sockaddr_in *from,
+                const uint8_t *data,
+                unsigned int data_len,
+                uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+  struct bmc_simulator_sel_entry *sel_entry;
+  uint8_t record[IPMI_SEL_RECORD_MAX_RECORD_LENGTH];
+  uint16_t record_id;
+  unsigned int offset;
+  unsigned int bytes_to_read;
+  unsigned int index;
+
+  if (data_len < 6)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if (!bmc->sel_entries_count)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUESTED_SENSOR_DATA_OR_RECORD_NOT_PRESENT));
+
+  record_id = _get_u16 (&data[2]);
+  offset = data[4];
+  bytes_to_read = data[5];
+
+  if (offset
+      && _get_u16 (&data[0]) != bmc->sel_reservation_id)
+    return (_comp_code (rs, IPMI_COMP_CODE_RESERVATION_CANCELLED));
+
+  if (record_id == IPMI_SEL_RECORD_ID_FIRST)
+    index = 0;
+  else if (record_id == IPMI_SEL_RECORD_ID_LAST)
+    index = bmc->sel_entries_count - 1;
+  else if (record_id <= bmc->sel_entries_count)
+    index = record_id - 1;
+  else
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUESTED_SENSOR_DATA_OR_RECORD_NOT_PRESENT));
+
+  if (offset >= IPMI_SEL_RECORD_MAX_RECORD_LENGTH)
+    return (_comp_code (rs, IPMI_COMP_CODE_PARAMETER_OUT_OF_RANGE));
+
+  sel_entry = &(script.sel_entries[index]);
+
+  _set_u16 (&record[0], index + 1);
+  record[2] = IPMI_SEL_RECORD_TYPE_SYSTEM_EVENT_RECORD;
+  _set_u32 (&record[3], script.start_time + index * BMC_SIMULATOR_SEL_EVENT_INTERVAL);
+  record[7] = IPMI_SLAVE_ADDRESS_BMC;   /* generator id */
+  record[8] = 0x00;
+  record[9] = 0x04;                     /* event message format revision */
+  record[10] = sel_entry->sensor_type;
+  record[11] = sel_entry->sensor_number;
+  record[12] = (sel_entry->event_dir << 7) | sel_entry->event_type_code;
+  record[13] = sel_entry->event_data1;
+  record[14] = sel_entry->event_data2;
+  record[15] = sel_entry->event_data3;
+
+  if (bytes_to_read > (IPMI_SEL_RECORD_MAX_RECORD_LENGTH - offset))
+    bytes_to_read = IPMI_SEL_RECORD_MAX_RECORD_LENGTH - offset;
+
+  if ((index + 1) < bmc->sel_entries_count)
+    _set_u16 (&rs_data[0], index + 2);
+  else
+    _set_u16 (&rs_data[0], IPMI_SEL_RECORD_ID_LAST);
+  memcpy (&rs_data[2], &record[offset], bytes_to_read);
+  return (2 + bytes_to_read);
+}
+
+static unsigned int
+_clear_sel (struct bmc_simulator_bmc *bmc,
+            struct bmc_simulator_session *session,
+            const struct sockaddr_in *from,
+            const uint8_t *data,
+            unsigned int data_len,
+            uint8_t *rs)
+{
+  if (data_len < 6)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if (_get_u16 (&data[0]) != bmc->sel_reservation_id)
+    return (_comp_code (rs, IPMI_COMP_CODE_RESERVATION_CANCELLED));
+
+  if (data[2] != 'C' || data[3] != 'L' || data[4] != 'R')
+    return (_comp_code (rs, IPMI_COMP_CODE_INVALID_DATA_FIELD_IN_REQUEST));
+
+  if (data[5] == IPMI_SEL_CLEAR_OPERATION_INITIATE_ERASE)
+    {
+      bmc->sel_entries_count = 0;
+      bmc->sel_erase_timestamp = time (NULL);
+      bmc_simulator_debug (bmc, "SEL cleared");
+    }
+
+  rs[2] = IPMI_SEL_CLEAR_ERASE_COMPLETED;
+  return (1);
+}
+
+static unsigned int
+_get_sel_time (struct bmc_simulator_bmc *bmc,
+               struct bmc_simulator_session *session,
+               const struct sockaddr_in *from,
+               const uint8_t *data,
+               unsigned int data_len,
+               uint8_t *rs)
+{
+  _set_u32 (rs + 2, time (NULL));
+  return (4);
+}
+
+static struct bmc_simulator_sensor *
+_find_sensor (uint8_t sensor_number)
+{
+  unsigned int i;
+
+  for (i = 0; i < script.sensors_count; i++)
+    {
+      if (script.sensors[i].sensor_number == sensor_number)
+        return (&(script.sensors[i]));
+    }
+
+  return (NULL);
+}
+
+static unsigned int
+_get_sensor_reading (struct bmc_simulator_bmc *bmc,
+                     struct bmc_simulator_session *session,
+                     const struct sockaddr_in *from,
+                     const uint8_t *data,
+                     unsigned int data_len,
+                     uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+  struct bmc_simulator_sensor *sensor;
+
+  if (data_len < 1)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if (!(sensor = _find_sensor (data[0])))
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUESTED_SENSOR_DATA_OR_RECORD_NOT_PRESENT));
+
+  rs_data[0] = sensor->reading;
+  rs_data[1] = 0xC0;            /* event messages and scanning enabled */
+  rs_data[2] = 0x00;
+  if (sensor->thresholds)
+    {
+      if (sensor->reading <= sensor->lower_critical)
+        rs_data[2] |= 0x02;
+      if (sensor->reading >= sensor->upper_critical)
+        rs_data[2] |= 0x10;
+    }
+  rs_data[3] = 0x80;
+  return (4);
+}
+
+static unsigned int
+_get_sensor_thresholds (struct bmc_simulator_bmc *bmc,
+                        struct bmc_simulator_session *session,
+                        const struct sockaddr_in *from,
+                        const uint8_t *data,
+                        unsigned int data_len,
+                        uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+  struct bmc_simulator_sensor *sensor;
+
+  if (data_len < 1)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if (!(sensor = _find_sensor (data[0])))
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUESTED_SENSOR_DATA_OR_RECORD_NOT_PRESENT));
+
+  memset (rs_data, '\0', 7);
+  if (sensor->thresholds)
+    {
+      rs_data[0] = 0x12;        /* lower and upper critical readable */
+      rs_data[2] = sensor->lower_critical;
+      rs_data[5] = sensor->upper_critical;
+    }
+  return (7);
+}
+
+static unsigned int
+_get_channel_payload_support (struct bmc_simulator_bmc *bmc,
+                              struct bmc_simulator_session *session,
+                              const struct sockaddr_in *from,
+                              const uint8_t *data,
+                              unsigned int data_len,
+                              uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+
+  memset (rs_data, '\0', 8);
+  rs_data[0] = 0x03;            /* IPMI, SOL */
+  rs_data[2] = 0x3F;            /* RMCP+ open session and RAKP 1-4 */
+  return (8);
+}
+
+static unsigned int
+_get_channel_payload_version (struct bmc_simulator_bmc *bmc,
+                              struct bmc_simulator_session *session,
+                              const struct sockaddr_in *from,
+                              const uint8_t *data,
+                              unsigned int data_len,
+                              uint8_t *rs)
+{
+  if (data_len < 2)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if (data[1] != IPMI_PAYLOAD_TYPE_IPMI
+      && data[1] != IPMI_PAYLOAD_TYPE_SOL)
+    return (_comp_code (rs, IPMI_COMP_CODE_GET_CHANNEL_PAYLOAD_VERSION_PAYLOAD_TYPE_NOT_AVAILABLE_ON_GIVEN_CHANNEL));
+
+  rs[2] = 0x10;                 /* version 1.0 */
+  return (1);
+}
+
+static unsigned int
+_get_payload_activation_status (struct bmc_simulator_bmc *bmc,
+                                struct bmc_simulator_session *session,
+                                const struct sockaddr_in *from,
+                                const uint8_t *data,
+                                unsigned int data_len,
+                                uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+
+  if (data_len < 1)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if ((data[0] & 0x3F) != IPMI_PAYLOAD_TYPE_SOL)
+    return (_comp_code (rs, IPMI_COMP_CODE_INVALID_DATA_FIELD_IN_REQUEST));
+
+  rs_data[0] = 1;               /* one SOL instance */
+  rs_data[1] = bmc_simulator_session_sol (bmc) ? 0x01 : 0x00;
+  rs_data[2] = 0;
+  return (3);
+}
+
+static unsigned int
+_activate_payload (struct bmc_simulator_bmc *bmc,
+                   struct bmc_simulator_session *session,
+                   const struct sockaddr_in *from,
+                   const uint8_t *data,
+                   unsigned int data_len,
+                   uint8_t *rs)
+{
+  uint8_t *rs_data = rs + 2;
+
+  if (data_len < 6)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if ((data[0] & 0x3F) != IPMI_PAYLOAD_TYPE_SOL
+      || (data[1] & 0x0F) != 1)
+    return (_comp_code (rs, IPMI_COMP_CODE_INVALID_DATA_FIELD_IN_REQUEST));
+
+  /* SOL requires IPMI 2.0 */
+  if (!session->rmcpplus)
+    return (_comp_code (rs, IPMI_COMP_CODE_ACTIVATE_PAYLOAD_PAYLOAD_TYPE_IS_DISABLED));
+
+  if (bmc_simulator_session_sol (bmc))
+    return (_comp_code (rs, IPMI_COMP_CODE_ACTIVATE_PAYLOAD_PAYLOAD_ALREADY_ACTIVE_ON_ANOTHER_SESSION));
+
+  session->sol_activated = 1;
+  session->sol_sequence_number = 0;
+  session->sol_unacked_len = 0;
+  session->sol_retransmits = 0;
+  session->sol_output_len = strlen (script.sol_banner);
+  memcpy (session->sol_output, script.sol_banner, session->sol_output_len);
+  bmc_simulator_debug (bmc, "SOL activated on session 0x%08X", session->session_id);
+
+  _set_u32 (&rs_data[0], 0);
+  _set_u16 (&rs_data[4], BMC_SIMULATOR_SOL_PAYLOAD_SIZE);
+  _set_u16 (&rs_data[6], BMC_SIMULATOR_SOL_PAYLOAD_SIZE);
+  _set_u16 (&rs_data[8], ntohs (bmc->addr.sin_port));
+  _set_u16 (&rs_data[10], 0xFFFF);
+  return (12);
+}
+
+static unsigned int
+_deactivate_payload (struct bmc_simulator_bmc *bmc,
+                     struct bmc_simulator_session *session,
+                     const struct sockaddr_in *from,
+                     const uint8_t *data,
+                     unsigned int data_len,
+                     uint8_t *rs)
+{
+  struct bmc_simulator_session *sol_session;
+
+  if (data_len < 6)
+    return (_comp_code (rs, IPMI_COMP_CODE_REQUEST_DATA_LENGTH_INVALID));
+
+  if ((data[0] & 0x3F) != IPMI_PAYLOAD_TYPE_SOL
+      || (data[1] & 0x0F) != 1)
+    return (_comp_code (rs, IPMI_COMP_CODE_INVALID_DATA_FIELD_IN_REQUEST));
+
+  if (!(sol_session = bmc_simulator_session_sol (bmc)))
+    return (_comp_code (rs, IPMI_COMP_CODE_DEACTIVATE_PAYLOAD_PAYLOAD_ALREADY_DEACTIVATED));
+
+  sol_session->sol_activated = 0;
+  bmc_simulator_debug (bmc, "SOL deactivated on session 0x%08X", sol_session->session_id);
+  return (0);
+}
+
+static struct bmc_simulator_cmd_handler cmd_handlers[] =
+  {
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_GET_DEVICE_ID, IPMI_PRIVILEGE_LEVEL_USER, _get_device_id },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_GET_DEVICE_GUID, IPMI_PRIVILEGE_LEVEL_USER, _get_device_guid },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_GET_CHANNEL_AUTHENTICATION_CAPABILITIES, 0, _get_channel_authentication_capabilities },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_GET_SESSION_CHALLENGE, 0, _get_session_challenge },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_ACTIVATE_SESSION, 0, _activate_session },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_SET_SESSION_PRIVILEGE_LEVEL, IPMI_PRIVILEGE_LEVEL_USER, _set_session_privilege_level },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_CLOSE_SESSION, IPMI_PRIVILEGE_LEVEL_USER, _close_session },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_GET_CHANNEL_PAYLOAD_SUPPORT, IPMI_PRIVILEGE_LEVEL_USER, _get_channel_payload_support },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_GET_CHANNEL_PAYLOAD_VERSION, IPMI_PRIVILEGE_LEVEL_USER, _get_channel_payload_version },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_GET_PAYLOAD_ACTIVATION_STATUS, IPMI_PRIVILEGE_LEVEL_USER, _get_payload_activation_status },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_ACTIVATE_PAYLOAD, IPMI_PRIVILEGE_LEVEL_USER, _activate_payload },
+    { IPMI_NET_FN_APP_RQ, IPMI_CMD_DEACTIVATE_PAYLOAD, IPMI_PRIVILEGE_LEVEL_USER, _deactivate_payload },
+    { IPMI_NET_FN_CHASSIS_RQ, IPMI_CMD_GET_CHASSIS_STATUS, IPMI_PRIVILEGE_LEVEL_USER, _get_chassis_status },
+    { IPMI_NET_FN_CHASSIS_RQ, IPMI_CMD_CHASSIS_CONTROL, IPMI_PRIVILEGE_LEVEL_OPERATOR, _chassis_control },
+    { IPMI_NET_FN_SENSOR_EVENT_RQ, IPMI_CMD_GET_SENSOR_READING, IPMI_PRIVILEGE_LEVEL_USER, _get_sensor_reading },
+    { IPMI_NET_FN_SENSOR_EVENT_RQ, IPMI_CMD_GET_SENSOR_THRESHOLDS, IPMI_PRIVILEGE_LEVEL_USER, _get_sensor_thresholds },
+    { IPMI_NET_FN_STORAGE_RQ, IPMI_CMD_GET_SDR_REPOSITORY_INFO, IPMI_PRIVILEGE_LEVEL_USER, _get_sdr_repository_info },
+    { IPMI_NET_FN_STORAGE_RQ, IPMI_CMD_RESERVE_SDR_REPOSITORY, IPMI_PRIVILEGE_LEVEL_USER, _reserve_sdr_repository },
+    { IPMI_NET_FN_STORAGE_RQ, IPMI_CMD_GET_SDR, IPMI_PRIVILEGE_LEVEL_USER, _get_sdr },
+    { IPMI_NET_FN_STORAGE_RQ, IPMI_CMD_GET_SEL_INFO, IPMI_PRIVILEGE_LEVEL_USER, _get_sel_info },
+    { IPMI_NET_FN_STORAGE_RQ, IPMI_CMD_RESERVE_SEL, IPMI_PRIVILEGE_LEVEL_USER, _reserve_sel },
+    { IPMI_NET_FN_STORAGE_RQ, IPMI_CMD_GET_SEL_ENTRY, IPMI_PRIVILEGE_LEVEL_USER, _get_sel_entry },
+    { IPMI_NET_FN_STORAGE_RQ, IPMI_CMD_CLEAR_SEL, IPMI_PRIVILEGE_LEVEL_OPERATOR, _clear_sel },
+    { IPMI_NET_FN_STORAGE_RQ, IPMI_CMD_GET_SEL_TIME, IPMI_PRIVILEGE_LEVEL_USER, _get_sel_time },
+    { 0, 0, 0, NULL },
+  };
+
+unsigned int
+bmc_simulator_cmd (struct bmc_simulator_bmc *bmc,
+                   struct bmc_simulator_session *session,
+                   const struct sockaddr_in *from,
+                   uint8_t net_fn,
+                   const uint8_t *rq,
+                   unsigned int rq_len,
+                   uint8_t *rs,
+                   unsigned int rs_len)
+{
+  const struct bmc_simulator_response *response;
+  struct bmc_simulator_cmd_handler *handler = NULL;
+  unsigned int i;
+
+  assert (bmc);
+  assert (from);
+  assert (rq);
+  assert (rq_len);
+  assert (rs);
+  assert (rs_len >= BMC_SIMULATOR_CMD_RS_BUFLEN);
+
+  rs[0] = rq[0];
+  rs[1] = IPMI_COMP_CODE_COMMAND_SUCCESS;
+
+  for (i = 0; cmd_handlers[i].func; i++)
+    {
+      if (cmd_handlers[i].net_fn == net_fn
+          && cmd_handlers[i].cmd == rq[0])
+        {
+          handler = &cmd_handlers[i];
+          break;
+        }
+    }
+
+  /* Only session setup is allowed outside of an active session.  A
+   * real BMC silently drops everything else, so we do too.
+   */
+  if (!session
+      || session->state != BMC_SIMULATOR_SESSION_STATE_ACTIVE)
+    {
+      if (!handler
+          || handler->privilege_level
+          || (handler->cmd == IPMI_CMD_ACTIVATE_SESSION) != (session != NULL))
+        return (0);
+
+      return (2 + handler->func (bmc, session, from, rq + 1, rq_len - 1, rs));
+    }
+
+  /* scripted responses may override anything but session management */
+  if (!handler
+      || (handler->cmd != IPMI_CMD_SET_SESSION_PRIVILEGE_LEVEL
+          && handler->cmd != IPMI_CMD_CLOSE_SESSION))
+    {
+      if ((response = bmc_simulator_script_response (&script, net_fn, rq[0])))
+        {
+          memcpy (rs + 1, response->data, response->data_len);
+          return (1 + response->data_len);
+        }
+    }
+
+  if (!handler)
+    return (2 + _comp_code (rs, IPMI_COMP_CODE_INVALID_COMMAND));
+
+  if (session->privilege_level < handler->privilege_level)
+    return (2 + _comp_code (rs, IPMI_COMP_CODE_INSUFFICIENT_PRIVILEGE_LEVEL));
+
+  return (2 + handler->func (bmc, session, from, rq + 1, rq_len - 1, rs));
+}
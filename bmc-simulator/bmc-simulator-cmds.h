@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BMC_SIMULATOR_CMDS_H
+#define BMC_SIMULATOR_CMDS_H
+
+#include "bmc-simulator.h"
+
+#define BMC_SIMULATOR_CMD_RS_BUFLEN 256
+
+/* rq is the cmd followed by the request data.  rs is filled with
+ * the cmd, completion code, and response data and must be at least
+ * BMC_SIMULATOR_CMD_RS_BUFLEN bytes.  session is NULL for
+ * session-less requests.
+ *
+ * Returns length of the response, 0 if the request should be
+ * silently dropped.
+ */
+unsigned int bmc_simulator_cmd (struct bmc_simulator_bmc *bmc,
+                                struct bmc_simulator_session *session,
+                                const struct sockaddr_in *from,
+                                uint8_t net_fn,
+                                const uint8_t *rq,
+                                unsigned int rq_len,
+                                uint8_t *rs,
+                                unsigned int rs_len);
+
+#endif /* BMC_SIMULATOR_CMDS_H */
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <assert.h>
+#include <errno.h>
+
+#include <freeipmi/freeipmi.h>
+
+#include "bmc-simulator.h"
+#include "bmc-simulator-cmds.h"
+#include "bmc-simulator-lan.h"
+#include "bmc-simulator-session.h"
+
+#include "freeipmi-portability.h"
+#include "error.h"
+
+fiid_template_t tmpl_bmc_simulator_raw =
+  {
+    { 8192, "raw_data", FIID_FIELD_OPTIONAL | FIID_FIELD_LENGTH_VARIABLE},
+    { 0, "", 0}
+  };
+
+static fiid_obj_t obj_rmcp_hdr = NULL;
+static fiid_obj_t obj_lan_session_hdr = NULL;
+static fiid_obj_t obj_lan_msg_hdr_rq = NULL;
+static fiid_obj_t obj_lan_msg_hdr_rs = NULL;
+static fiid_obj_t obj_lan_msg_trlr = NULL;
+static fiid_obj_t obj_cmd = NULL;
+static fiid_obj_t obj_asf_ping = NULL;
+static fiid_obj_t obj_asf_pong = NULL;
+
+void
+bmc_simulator_lan_setup (void)
+{
+  if (!(obj_rmcp_hdr = fiid_obj_create (tmpl_rmcp_hdr))
+      || !(obj_lan_session_hdr = fiid_obj_create (tmpl_lan_session_hdr))
+      || !(obj_lan_msg_hdr_rq = fiid_obj_create (tmpl_lan_msg_hdr_rq))
+      || !(obj_lan_msg_hdr_rs = fiid_obj_create (tmpl_lan_msg_hdr_rs))
+      || !(obj_lan_msg_trlr = fiid_obj_create (tmpl_lan_msg_trlr))
+      || !(obj_cmd = fiid_obj_create (tmpl_bmc_simulator_raw))
+      || !(obj_asf_ping = fiid_obj_create (tmpl_cmd_asf_presence_ping))
+      || !(obj_asf_pong = fiid_obj_create (tmpl_cmd_asf_presence_pong)))
+    err_exit ("fiid_obj_create: %s", strerror (errno));
+}
+
+int
+bmc_simulator_lan_fill_msg_hdr (fiid_obj_t obj_lan_msg_hdr_recv,
+                                fiid_obj_t obj_lan_msg_hdr)
+{
+  uint8_t buf[2];
+  uint64_t rs_addr, rs_lun, rq_addr, rq_lun, net_fn, rq_seq;
+
+  assert (obj_lan_msg_hdr_recv);
+  assert (obj_lan_msg_hdr);
+
+  /* field names in obj_lan_msg_hdr_recv are swapped, see header */
+  if (FIID_OBJ_GET (obj_lan_msg_hdr_recv, "rs_addr", &rs_addr) < 0
+      || FIID_OBJ_GET (obj_lan_msg_hdr_recv, "rs_lun", &rs_lun) < 0
+      || FIID_OBJ_GET (obj_lan_msg_hdr_recv, "rq_addr", &rq_addr) < 0
+      || FIID_OBJ_GET (obj_lan_msg_hdr_recv, "rq_lun", &rq_lun) < 0
+      || FIID_OBJ_GET (obj_lan_msg_hdr_recv, "net_fn", &net_fn) < 0
+      || FIID_OBJ_GET (obj_lan_msg_hdr_recv, "rq_seq", &rq_seq) < 0)
+    return (-1);
+
+  buf[0] = rs_addr;
+  buf[1] = ((net_fn | 0x01) << 2) | rs_lun;
+
+  if (fiid_obj_clear (obj_lan_msg_hdr) < 0
+      || fiid_obj_set (obj_lan_msg_hdr, "rs_addr", rs_addr) < 0
+      || fiid_obj_set (obj_lan_msg_hdr, "net_fn", net_fn | 0x01) < 0
+      || fiid_obj_set (obj_lan_msg_hdr, "rs_lun", rs_lun) < 0
+      || fiid_obj_set (obj_lan_msg_hdr, "checksum1", ipmi_checksum (buf, 2)) < 0
+      || fiid_obj_set (obj_lan_msg_hdr, "rq_addr", rq_addr) < 0
+      || fiid_obj_set (obj_lan_msg_hdr, "rq_lun", rq_lun) < 0
+      || fiid_obj_set (obj_lan_msg_hdr, "rq_seq", rq_seq) < 0)
+    return (-1);
+
+  return (0);
+}
+
+void
+bmc_simulator_lan_ping (struct bmc_simulator_bmc *bmc,
+                        const struct sockaddr_in *from,
+                        const uint8_t *pkt,
+                        unsigned int pkt_len)
+{
+  uint8_t buf[BMC_SIMULATOR_PKT_LEN];
+  uint64_t message_type, message_tag;
+  int len;
+
+  assert (bmc);
+  assert (from);
+  assert (pkt);
+
+  if (unassemble_rmcp_pkt (pkt,
+                           pkt_len,
+                           obj_rmcp_hdr,
+                           obj_asf_ping,
+                           IPMI_INTERFACE_FLAGS_DEFAULT) < 0)
+    {
+      bmc_simulator_debug (bmc, "unassemble_rmcp_pkt: %s", strerror (errno));
+      return;
+    }
+
+  if (FIID_OBJ_GET (obj_asf_ping, "message_type", &message_type) < 0
+      || FIID_OBJ_GET (obj_asf_ping, "message_tag", &message_tag) < 0
+      || message_type != RMCP_ASF_MESSAGE_TYPE_PRESENCE_PING)
+    return;
+
+  if (fill_rmcp_hdr_asf (obj_rmcp_hdr) < 0
+      || fiid_obj_clear (obj_asf_pong) < 0
+      || fiid_obj_set (obj_asf_pong, "iana_enterprise_number", htonl (RMCP_ASF_IANA_ENTERPRISE_NUM)) < 0
+      || fiid_obj_set (obj_asf_pong, "message_type", RMCP_ASF_MESSAGE_TYPE_PRESENCE_PONG) < 0
+      || fiid_obj_set (obj_asf_pong, "message_tag", message_tag) < 0
+      || fiid_obj_set (obj_asf_pong, "reserved1", 0) < 0
+      || fiid_obj_set (obj_asf_pong, "data_length", 0x10) < 0
+      || fiid_obj_set (obj_asf_pong, "oem_iana_enterprise_number", htonl (RMCP_ASF_IANA_ENTERPRISE_NUM)) < 0
+      || fiid_obj_set (obj_asf_pong, "oem_defined", 0) < 0
+      || fiid_obj_set (obj_asf_pong, "supported_entities.version", 1) < 0
+      || fiid_obj_set (obj_asf_pong, "supported_entities.reserved", 0) < 0
+      || fiid_obj_set (obj_asf_pong, "supported_entities.ipmi_supported", 1) < 0
+      || fiid_obj_set (obj_asf_pong, "supported_interactions.reserved", 0) < 0
+      || fiid_obj_set (obj_asf_pong, "supported_interactions.security_extensions", 0) < 0
+      || fiid_obj_set (obj_asf_pong, "reserved2", 0) < 0)
+    {
+      bmc_simulator_debug (bmc, "pong: %s", fiid_obj_errormsg (obj_asf_pong));
+      return;
+    }
+
+  if ((len = assemble_rmcp_pkt (obj_rmcp_hdr,
+                                obj_asf_pong,
+                                buf,
+                                BMC_SIMULATOR_PKT_LEN,
+                                IPMI_INTERFACE_FLAGS_DEFAULT)) < 0)
+    {
+      bmc_simulator_debug (bmc, "assemble_rmcp_pkt: %s", strerror (errno));
+      return;
+    }
+
+  bmc_simulator_send (bmc, from, buf, len);
+}
+
+void
+bmc_simulator_lan_process (struct bmc_simulator_bmc *bmc,
+                           const struct sockaddr_in *from,
+                           const uint8_t *pkt,
+                           unsigned int pkt_len)
+{
+  struct bmc_simulator_session *session = NULL;
+  uint8_t rq[BMC_SIMULATOR_PKT_LEN];
+  uint8_t rs[BMC_SIMULATOR_CMD_RS_BUFLEN];
+  uint8_t buf[BMC_SIMULATOR_PKT_LEN];
+  uint64_t authentication_type, session_id, net_fn;
+  uint32_t session_sequence_number = 0;
+  const char *password = NULL;
+  unsigned int password_len = 0;
+  int rq_len;
+  unsigned int rs_len;
+  int ret, len;
+
+  assert (bmc);
+  assert (from);
+  assert (pkt);
+
+  if ((ret = unassemble_ipmi_lan_pkt (pkt,
+                                      pkt_len,
+                                      obj_rmcp_hdr,
+                                      obj_lan_session_hdr,
+                                      obj_lan_msg_hdr_rs,
+                                      obj_cmd,
+                                      obj_lan_msg_trlr,
+                                      IPMI_INTERFACE_FLAGS_DEFAULT)) < 0)
+    {
+      bmc_simulator_debug (bmc, "unassemble_ipmi_lan_pkt: %s", strerror (errno));
+      return;
+    }
+
+  if (!ret)
+    {
+      bmc_simulator_debug (bmc, "truncated IPMI 1.5 packet");
+      return;
+    }
+
+  if (FIID_OBJ_GET (obj_lan_session_hdr, "authentication_type", &authentication_type) < 0
+      || FIID_OBJ_GET (obj_lan_session_hdr, "session_id", &session_id) < 0
+      || FIID_OBJ_GET (obj_lan_msg_hdr_rs, "net_fn", &net_fn) < 0)
+    return;
+
+  if ((ret = ipmi_lan_check_checksum (obj_lan_msg_hdr_rs,
+                                      obj_cmd,
+                                      obj_lan_msg_trlr)) <= 0)
+    {
+      bmc_simulator_debug (bmc, "invalid checksum");
+      return;
+    }
+
+  if (session_id)
+    {
+      if (!(session = bmc_simulator_session_find (bmc, session_id))
+          || session->rmcpplus
+          || session->authentication_type != authentication_type)
+        {
+          bmc_simulator_debug (bmc, "invalid session 0x%08X", (uint32_t)session_id);
+          return;
+        }
+
+      if (authentication_type != IPMI_AUTHENTICATION_TYPE_NONE)
+        {
+          password = cmd_args.password;
+          password_len = strlen (cmd_args.password);
+
+          if (ipmi_lan_check_packet_session_authentication_code (pkt,
+                                                                 pkt_len,
+                                                                 authentication_type,
+                                                                 password,
+                                                                 password_len) != 1)
+            {
+              bmc_simulator_debug (bmc, "invalid authentication code");
+              return;
+            }
+        }
+
+      session->last_activity = time (NULL);
+    }
+
+  if ((rq_len = fiid_obj_get_data (obj_cmd, "raw_data", rq, BMC_SIMULATOR_PKT_LEN)) <= 0)
+    return;
+
+  if (!(rs_len = bmc_simulator_cmd (bmc,
+                                    session,
+                                    from,
+                                    net_fn,
+                                    rq,
+                                    rq_len,
+                                    rs,
+                                    BMC_SIMULATOR_CMD_RS_BUFLEN)))
+    return;
+
+  /* The IPMI 1.5 session sequence number starts at the initial
+   * outbound sequence number given in the Activate Session request.
+   */
+  if (session)
+    {
+      if ((session_sequence_number = session->outbound_sequence_number))
+        {
+          if (!++session->outbound_sequence_number)
+            session->outbound_sequence_number++;
+        }
+    }
+  else
+    authentication_type = IPMI_AUTHENTICATION_TYPE_NONE;
+
+  if (fill_rmcp_hdr_ipmi (obj_rmcp_hdr) < 0
+      || fill_lan_session_hdr (authentication_type,
+                               session_sequence_number,
+                               session_id,
+                               obj_lan_session_hdr) < 0
+      || bmc_simulator_lan_fill_msg_hdr (obj_lan_msg_hdr_rs, obj_lan_msg_hdr_rq) < 0
+      || fiid_obj_clear (obj_cmd) < 0
+      || fiid_obj_set_all (obj_cmd, rs, rs_len) < 0)
+    {
+      bmc_simulator_debug (bmc, "response: %s", strerror (errno));
+      return;
+    }
+
+  if ((len = assemble_ipmi_lan_pkt (obj_rmcp_hdr,
+                                    obj_lan_session_hdr,
+                                    obj_lan_msg_hdr_rq,
+                                    obj_cmd,
+                                    password,
+                                    password_len,
+                                    buf,
+                                    BMC_SIMULATOR_PKT_LEN,
+                                    IPMI_INTERFACE_FLAGS_DEFAULT)) < 0)
+    {
+      bmc_simulator_debug (bmc, "assemble_ipmi_lan_pkt: %s", strerror (errno));
+      return;
+    }
+
+  bmc_simulator_send (bmc, from, buf, len);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BMC_SIMULATOR_LAN_H
+#define BMC_SIMULATOR_LAN_H
+
+#include <freeipmi/freeipmi.h>
+
+#include "bmc-simulator.h"
+
+/* request/response data of any command, starting at the cmd byte */
+extern fiid_template_t tmpl_bmc_simulator_raw;
+
+void bmc_simulator_lan_setup (void);
+
+/* The libfreeipmi message header templates are from the remote
+ * console's point of view.  Requests are unassembled into a
+ * tmpl_lan_msg_hdr_rs object, since it has the same layout as a
+ * request header, and responses are assembled with a
+ * tmpl_lan_msg_hdr_rq object built from it with this function.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int bmc_simulator_lan_fill_msg_hdr (fiid_obj_t obj_lan_msg_hdr_recv,
+                                    fiid_obj_t obj_lan_msg_hdr);
+
+/* RMCP/ASF presence ping */
+void bmc_simulator_lan_ping (struct bmc_simulator_bmc *bmc,
+                             const struct sockaddr_in *from,
+                             const uint8_t *pkt,
+                             unsigned int pkt_len);
+
+/* IPMI 1.5 */
+void bmc_simulator_lan_process (struct bmc_simulator_bmc *bmc,
+                                const struct sockaddr_in *from,
+                                const uint8_t *pkt,
+                                unsigned int pkt_len);
+
+#endif /* BMC_SIMULATOR_LAN_H */
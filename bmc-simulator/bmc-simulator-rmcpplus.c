@@ -0,0 +1,1064 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <assert.h>
+#include <errno.h>
+#ifdef WITH_ENCRYPTION
+#include <gcrypt.h>
+#endif /* WITH_ENCRYPTION */
+
+#include <freeipmi/freeipmi.h>
+
+#include "bmc-simulator.h"
+#include "bmc-simulator-cmds.h"
+#include "bmc-simulator-lan.h"
+#include "bmc-simulator-rmcpplus.h"
+#include "bmc-simulator-session.h"
+
+#include "freeipmi-portability.h"
+#include "error.h"
+
+#define BMC_SIMULATOR_RMCPPLUS_HDR_LEN        16
+
+#define BMC_SIMULATOR_SOL_CHARACTERS_MAX      (BMC_SIMULATOR_SOL_PAYLOAD_SIZE - 4)
+
+#define BMC_SIMULATOR_SOL_RETRANSMIT_TIMEOUT  1000
+
+#define BMC_SIMULATOR_SOL_RETRANSMITS_MAX     5
+
+#define BMC_SIMULATOR_SOL_SEQUENCE_NUMBER_MAX 0x0F
+
+#define BMC_SIMULATOR_SOL_NACK                0x40
+
+#define BMC_SIMULATOR_HMAC_DIGEST_LENGTH_MAX  IPMI_HMAC_SHA256_DIGEST_LENGTH
+
+#define BMC_SIMULATOR_KEY_DATA_MAX            512
+
+static fiid_obj_t obj_rmcp_hdr = NULL;
+static fiid_obj_t obj_rmcpplus_session_hdr = NULL;
+static fiid_obj_t obj_rmcpplus_payload = NULL;
+static fiid_obj_t obj_lan_msg_hdr_rq = NULL;
+static fiid_obj_t obj_lan_msg_hdr_rs = NULL;
+static fiid_obj_t obj_lan_msg_trlr = NULL;
+static fiid_obj_t obj_rmcpplus_session_trlr = NULL;
+static fiid_obj_t obj_cmd = NULL;
+static fiid_obj_t obj_sol = NULL;
+static fiid_obj_t obj_open_session_request = NULL;
+static fiid_obj_t obj_open_session_response = NULL;
+static fiid_obj_t obj_rakp_message_1 = NULL;
+static fiid_obj_t obj_rakp_message_2 = NULL;
+static fiid_obj_t obj_rakp_message_3 = NULL;
+static fiid_obj_t obj_rakp_message_4 = NULL;
+
+void
+bmc_simulator_rmcpplus_setup (void)
+{
+  if (ipmi_rmcpplus_init () < 0)
+    err_exit ("ipmi_rmcpplus_init: %s", strerror (errno));
+
+  if (!(obj_rmcp_hdr = fiid_obj_create (tmpl_rmcp_hdr))
+      || !(obj_rmcpplus_session_hdr = fiid_obj_create (tmpl_rmcpplus_session_hdr))
+      || !(obj_rmcpplus_payload = fiid_obj_create (tmpl_rmcpplus_payload))
+      || !(obj_lan_msg_hdr_rq = fiid_obj_create (tmpl_lan_msg_hdr_rq))
+      || !(obj_lan_msg_hdr_rs = fiid_obj_create (tmpl_lan_msg_hdr_rs))
+      || !(obj_lan_msg_trlr = fiid_obj_create (tmpl_lan_msg_trlr))
+      || !(obj_rmcpplus_session_trlr = fiid_obj_create (tmpl_rmcpplus_session_trlr))
+      || !(obj_cmd = fiid_obj_create (tmpl_bmc_simulator_raw))
+      || !(obj_sol = fiid_obj_create (tmpl_sol_payload_data))
+      || !(obj_open_session_request = fiid_obj_create (tmpl_rmcpplus_open_session_request))
+      || !(obj_open_session_response = fiid_obj_create (tmpl_rmcpplus_open_session_response))
+      || !(obj_rakp_message_1 = fiid_obj_create (tmpl_rmcpplus_rakp_message_1))
+      || !(obj_rakp_message_2 = fiid_obj_create (tmpl_rmcpplus_rakp_message_2))
+      || !(obj_rakp_message_3 = fiid_obj_create (tmpl_rmcpplus_rakp_message_3))
+      || !(obj_rakp_message_4 = fiid_obj_create (tmpl_rmcpplus_rakp_message_4)))
+    err_exit ("fiid_obj_create: %s", strerror (errno));
+}
+
+static uint32_t
+_get_u32 (const uint8_t *buf)
+{
+  return (buf[0]
+          | (buf[1] << 8)
+          | (buf[2] << 16)
+          | ((uint32_t)buf[3] << 24));
+}
+
+static unsigned int
+_set_u32 (uint8_t *buf, uint32_t val)
+{
+  buf[0] = val & 0x000000FF;
+  buf[1] = (val & 0x0000FF00) >> 8;
+  buf[2] = (val & 0x00FF0000) >> 16;
+  buf[3] = (val & 0xFF000000) >> 24;
+  return (4);
+}
+
+/* The libfreeipmi hash routines are internal to the library, so the
+ * RAKP 2 key exchange authentication code and RAKP 4 integrity
+ * check value, which only a BMC generates, are calculated here.
+ *
+ * Returns digest length on success, -1 on error.
+ */
+static int
+_hmac (uint8_t authentication_algorithm,
+       const void *key,
+       unsigned int key_len,
+       const void *data,
+       unsigned int data_len,
+       uint8_t *digest,
+       unsigned int digest_len)
+{
+#ifdef WITH_ENCRYPTION
+  gcry_md_hd_t h = NULL;
+  int gcry_md_algorithm;
+  unsigned int gcry_md_digest_len;
+  uint8_t *digestptr;
+  int rv = -1;
+
+  if (authentication_algorithm == IPMI_AUTHENTICATION_ALGORITHM_RAKP_HMAC_SHA1)
+    gcry_md_algorithm = GCRY_MD_SHA1;
+  else if (authentication_algorithm == IPMI_AUTHENTICATION_ALGORITHM_RAKP_HMAC_MD5)
+    gcry_md_algorithm = GCRY_MD_MD5;
+  else
+    gcry_md_algorithm = GCRY_MD_SHA256;
+
+  if ((gcry_md_digest_len = gcry_md_get_algo_dlen (gcry_md_algorithm)) > digest_len)
+    return (-1);
+
+  if (gcry_md_open (&h, gcry_md_algorithm, GCRY_MD_FLAG_HMAC) != GPG_ERR_NO_ERROR
+      || !h)
+    return (-1);
+
+  if (gcry_md_setkey (h, key, key_len) != GPG_ERR_NO_ERROR)
+    goto cleanup;
+
+  gcry_md_write (h, data, data_len);
+  gcry_md_final (h);
+
+  if (!(digestptr = gcry_md_read (h, gcry_md_algorithm)))
+    goto cleanup;
+
+  memcpy (digest, digestptr, gcry_md_digest_len);
+  rv = gcry_md_digest_len;
+
+ cleanup:
+  gcry_md_close (h);
+  return (rv);
+#else /* !WITH_ENCRYPTION */
+  return (-1);
+#endif /* !WITH_ENCRYPTION */
+}
+
+/* K_UID, a null password is a key of all zeroes */
+static void
+_k_uid (const void **k_uid, unsigned int *k_uid_len)
+{
+  static uint8_t k_uid_buf[IPMI_2_0_MAX_PASSWORD_LENGTH];
+
+  assert (k_uid);
+  assert (k_uid_len);
+
+  if (strlen (cmd_args.password))
+    {
+      *k_uid = cmd_args.password;
+      *k_uid_len = strlen (cmd_args.password);
+    }
+  else
+    {
+      memset (k_uid_buf, '\0', IPMI_2_0_MAX_PASSWORD_LENGTH);
+      *k_uid = k_uid_buf;
+      *k_uid_len = IPMI_2_0_MAX_PASSWORD_LENGTH;
+    }
+}
+
+/* Session setup payloads are sent outside of a session, so they are
+ * assembled directly.  assemble_ipmi_rmcpplus_pkt() only supports
+ * the remote console's side of session setup.
+ */
+static void
+_send_session_setup (struct bmc_simulator_bmc *bmc,
+                     const struct sockaddr_in *from,
+                     uint8_t payload_type,
+                     fiid_obj_t obj_payload)
+{
+  uint8_t buf[BMC_SIMULATOR_PKT_LEN];
+  uint8_t payload[BMC_SIMULATOR_PKT_LEN];
+  int len, hdr_len, payload_len;
+
+  assert (bmc);
+  assert (from);
+  assert (obj_payload);
+
+  if ((payload_len = fiid_obj_get_all (obj_payload,
+                                       payload,
+                                       BMC_SIMULATOR_PKT_LEN)) < 0)
+    {
+      bmc_simulator_debug (bmc, "fiid_obj_get_all: %s", fiid_obj_errormsg (obj_payload));
+      return;
+    }
+
+  if (fill_rmcp_hdr_ipmi (obj_rmcp_hdr) < 0
+      || fill_rmcpplus_session_hdr (payload_type,
+                                    IPMI_PAYLOAD_FLAG_UNAUTHENTICATED,
+                                    IPMI_PAYLOAD_FLAG_UNENCRYPTED,
+                                    0,
+                                    0,
+                                    0,
+                                    0,
+                                    obj_rmcpplus_session_hdr) < 0
+      || fiid_obj_set (obj_rmcpplus_session_hdr, "ipmi_payload_len", payload_len) < 0)
+    {
+      bmc_simulator_debug (bmc, "session header: %s", strerror (errno));
+      return;
+    }
+
+  if ((len = fiid_obj_get_all (obj_rmcp_hdr, buf, BMC_SIMULATOR_PKT_LEN)) < 0
+      || (hdr_len = fiid_obj_get_block (obj_rmcpplus_session_hdr,
+                                        "authentication_type",
+                                        "ipmi_payload_len",
+                                        buf + len,
+                                        BMC_SIMULATOR_PKT_LEN - len)) < 0
+      || (len + hdr_len) != BMC_SIMULATOR_RMCPPLUS_HDR_LEN)
+    {
+      bmc_simulator_debug (bmc, "session header: %s", fiid_obj_errormsg (obj_rmcpplus_session_hdr));
+      return;
+    }
+
+  memcpy (buf + BMC_SIMULATOR_RMCPPLUS_HDR_LEN, payload, payload_len);
+
+  bmc_simulator_send (bmc, from, buf, BMC_SIMULATOR_RMCPPLUS_HDR_LEN + payload_len);
+}
+
+static void
+_send_payload (struct bmc_simulator_bmc *bmc,
+               struct bmc_simulator_session *session,
+               uint8_t payload_type,
+               fiid_obj_t obj_lan_msg_hdr,
+               fiid_obj_t obj_payload)
+{
+  uint8_t buf[BMC_SIMULATOR_PKT_LEN];
+  int len;
+
+  assert (bmc);
+  assert (session);
+  assert (obj_payload);
+
+  if (fill_rmcp_hdr_ipmi (obj_rmcp_hdr) < 0
+      || fill_rmcpplus_session_hdr (payload_type,
+                                    (session->integrity_algorithm != IPMI_INTEGRITY_ALGORITHM_NONE) ? IPMI_PAYLOAD_FLAG_AUTHENTICATED : IPMI_PAYLOAD_FLAG_UNAUTHENTICATED,
+                                    (session->confidentiality_algorithm != IPMI_CONFIDENTIALITY_ALGORITHM_NONE) ? IPMI_PAYLOAD_FLAG_ENCRYPTED : IPMI_PAYLOAD_FLAG_UNENCRYPTED,
+                                    0,
+                                    0,
+                                    session->remote_console_session_id,
+                                    session->outbound_sequence_number,
+                                    obj_rmcpplus_session_hdr) < 0
+      || fill_rmcpplus_session_trlr (obj_rmcpplus_session_trlr) < 0)
+    {
+      bmc_simulator_debug (bmc, "session header: %s", strerror (errno));
+      return;
+    }
+
+  if ((len = assemble_ipmi_rmcpplus_pkt (session->authentication_algorithm,
+                                         session->integrity_algorithm,
+                                         session->confidentiality_algorithm,
+                                         session->integrity_key_ptr,
+                                         session->integrity_key_len,
+                                         session->confidentiality_key_ptr,
+                                         session->confidentiality_key_len,
+                                         cmd_args.password,
+                                         strlen (cmd_args.password),
+                                         obj_rmcp_hdr,
+                                         obj_rmcpplus_session_hdr,
+                                         obj_lan_msg_hdr,
+                                         obj_payload,
+                                         obj_rmcpplus_session_trlr,
+                                         buf,
+                                         BMC_SIMULATOR_PKT_LEN,
+                                         IPMI_INTERFACE_FLAGS_DEFAULT)) < 0)
+    {
+      bmc_simulator_debug (bmc, "assemble_ipmi_rmcpplus_pkt: %s", strerror (errno));
+      return;
+    }
+
+  if (!++session->outbound_sequence_number)
+    session->outbound_sequence_number++;
+
+  bmc_simulator_send (bmc, &(session->from), buf, len);
+}
+
+static void
+_open_session (struct bmc_simulator_bmc *bmc,
+               const struct sockaddr_in *from,
+               const uint8_t *payload,
+               unsigned int payload_len)
+{
+  struct bmc_simulator_session *session = NULL;
+  uint64_t message_tag, requested_maximum_privilege_level, remote_console_session_id;
+  uint64_t authentication_algorithm, integrity_algorithm, confidentiality_algorithm;
+  uint8_t maximum_privilege_level;
+  uint8_t status = RMCPPLUS_STATUS_NO_ERRORS;
+
+  if (fiid_obj_clear (obj_open_session_request) < 0
+      || fiid_obj_set_all (obj_open_session_request, payload, payload_len) < 0
+      || FIID_OBJ_GET (obj_open_session_request, "message_tag", &message_tag) < 0
+      || FIID_OBJ_GET (obj_open_session_request, "requested_maximum_privilege_level", &requested_maximum_privilege_level) < 0
+      || FIID_OBJ_GET (obj_open_session_request, "remote_console_session_id", &remote_console_session_id) < 0
+      || FIID_OBJ_GET (obj_open_session_request, "authentication_payload.authentication_algorithm", &authentication_algorithm) < 0
+      || FIID_OBJ_GET (obj_open_session_request, "integrity_payload.integrity_algorithm", &integrity_algorithm) < 0
+      || FIID_OBJ_GET (obj_open_session_request, "confidentiality_payload.confidentiality_algorithm", &confidentiality_algorithm) < 0)
+    {
+      bmc_simulator_debug (bmc, "invalid open session request");
+      return;
+    }
+
+  if (requested_maximum_privilege_level == IPMI_PRIVILEGE_LEVEL_HIGHEST_LEVEL)
+    maximum_privilege_level = cmd_args.privilege_level;
+  else
+    maximum_privilege_level = requested_maximum_privilege_level;
+
+  if (!IPMI_AUTHENTICATION_ALGORITHM_SUPPORTED (authentication_algorithm))
+    status = RMCPPLUS_STATUS_INVALID_AUTHENTICATION_ALGORITHM;
+  else if (!IPMI_INTEGRITY_ALGORITHM_SUPPORTED (integrity_algorithm))
+    status = RMCPPLUS_STATUS_INVALID_INTEGRITY_ALGORITHM;
+  else if (!IPMI_CONFIDENTIALITY_ALGORITHM_SUPPORTED (confidentiality_algorithm))
+    status = RMCPPLUS_STATUS_INVALID_CONFIDENTIALITY_ALGORITHM;
+  else if (authentication_algorithm == IPMI_AUTHENTICATION_ALGORITHM_RAKP_NONE
+           && (integrity_algorithm != IPMI_INTEGRITY_ALGORITHM_NONE
+               || confidentiality_algorithm != IPMI_CONFIDENTIALITY_ALGORITHM_NONE))
+    status = RMCPPLUS_STATUS_NO_CIPHER_SUITE_MATCH_WITH_PROPOSED_SECURITY_ALGORITHMS;
+  else if (maximum_privilege_level > cmd_args.privilege_level)
+    status = RMCPPLUS_STATUS_UNAUTHORIZED_ROLE_OR_PRIVILEGE_LEVEL_REQUESTED;
+  else if (!(session = bmc_simulator_session_create (bmc, from, 1)))
+    status = RMCPPLUS_STATUS_INSUFFICIENT_RESOURCES_TO_CREATE_A_SESSION;
+
+  if (session)
+    {
+      session->state = BMC_SIMULATOR_SESSION_STATE_OPEN_SESSION;
+      session->remote_console_session_id = remote_console_session_id;
+      session->maximum_privilege_level = maximum_privilege_level;
+      session->authentication_algorithm = authentication_algorithm;
+      session->integrity_algorithm = integrity_algorithm;
+      session->confidentiality_algorithm = confidentiality_algorithm;
+    }
+  else
+    bmc_simulator_debug (bmc, "open session failed, status 0x%02X", status);
+
+  if (fiid_obj_clear (obj_open_session_response) < 0
+      || fiid_obj_set (obj_open_session_response, "message_tag", message_tag) < 0
+      || fiid_obj_set (obj_open_session_response, "rmcpplus_status_code", status) < 0
+      || fiid_obj_set (obj_open_session_response, "maximum_privilege_level", maximum_privilege_level) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved1", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved2", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "remote_console_session_id", remote_console_session_id) < 0
+      || fiid_obj_set (obj_open_session_response, "managed_system_session_id", session ? session->session_id : 0) < 0
+      || fiid_obj_set (obj_open_session_response, "authentication_payload.payload_type", IPMI_AUTHENTICATION_PAYLOAD_TYPE) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved3", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "authentication_payload.payload_length", IPMI_AUTHENTICATION_PAYLOAD_LENGTH) < 0
+      || fiid_obj_set (obj_open_session_response, "authentication_payload.authentication_algorithm", authentication_algorithm) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved4", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved5", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "integrity_payload.payload_type", IPMI_INTEGRITY_PAYLOAD_TYPE) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved6", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "integrity_payload.payload_length", IPMI_INTEGRITY_PAYLOAD_LENGTH) < 0
+      || fiid_obj_set (obj_open_session_response, "integrity_payload.integrity_algorithm", integrity_algorithm) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved7", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved8", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "confidentiality_payload.payload_type", IPMI_CONFIDENTIALITY_PAYLOAD_TYPE) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved9", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "confidentiality_payload.payload_length", IPMI_CONFIDENTIALITY_PAYLOAD_LENGTH) < 0
+      || fiid_obj_set (obj_open_session_response, "confidentiality_payload.confidentiality_algorithm", confidentiality_algorithm) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved10", 0) < 0
+      || fiid_obj_set (obj_open_session_response, "reserved11", 0) < 0)
+    {
+      bmc_simulator_debug (bmc, "open session response: %s", fiid_obj_errormsg (obj_open_session_response));
+      return;
+    }
+
+  _send_session_setup (bmc,
+                       from,
+                       IPMI_PAYLOAD_TYPE_RMCPPLUS_OPEN_SESSION_RESPONSE,
+                       obj_open_session_response);
+}
+
+static void
+_rakp_message_1 (struct bmc_simulator_bmc *bmc,
+                 const struct sockaddr_in *from,
+                 const uint8_t *payload,
+                 unsigned int payload_len)
+{
+  struct bmc_simulator_session *session;
+  uint8_t key_exchange_authentication_code[BMC_SIMULATOR_HMAC_DIGEST_LENGTH_MAX];
+  uint8_t buf[BMC_SIMULATOR_KEY_DATA_MAX];
+  unsigned int buf_len = 0;
+  int key_exchange_authentication_code_len = 0;
+  uint64_t message_tag, managed_system_session_id, requested_maximum_privilege_level;
+  uint64_t name_only_lookup, user_name_length;
+  uint32_t remote_console_session_id = 0;
+  uint8_t status = RMCPPLUS_STATUS_NO_ERRORS;
+  const void *k_uid;
+  unsigned int k_uid_len;
+  char user_name[IPMI_MAX_USER_NAME_LENGTH + 1];
+
+  memset (user_name, '\0', IPMI_MAX_USER_NAME_LENGTH + 1);
+
+  if (fiid_obj_clear (obj_rakp_message_1) < 0
+      || fiid_obj_set_all (obj_rakp_message_1, payload, payload_len) < 0
+      || FIID_OBJ_GET (obj_rakp_message_1, "message_tag", &message_tag) < 0
+      || FIID_OBJ_GET (obj_rakp_message_1, "managed_system_session_id", &managed_system_session_id) < 0
+      || FIID_OBJ_GET (obj_rakp_message_1, "requested_maximum_privilege_level", &requested_maximum_privilege_level) < 0
+      || FIID_OBJ_GET (obj_rakp_message_1, "name_only_lookup", &name_only_lookup) < 0
+      || FIID_OBJ_GET (obj_rakp_message_1, "user_name_length", &user_name_length) < 0
+      || user_name_length > IPMI_MAX_USER_NAME_LENGTH
+      || (user_name_length
+          && fiid_obj_get_data (obj_rakp_message_1, "user_name", user_name, IPMI_MAX_USER_NAME_LENGTH) < 0))
+    {
+      bmc_simulator_debug (bmc, "invalid RAKP message 1");
+      return;
+    }
+  user_name[user_name_length] = '\0';
+
+  /* RAKP 1 is retransmitted if RAKP 2 is lost */
+  if (!(session = bmc_simulator_session_find (bmc, managed_system_session_id))
+      || !session->rmcpplus
+      || (session->state != BMC_SIMULATOR_SESSION_STATE_OPEN_SESSION
+          && session->state != BMC_SIMULATOR_SESSION_STATE_RAKP))
+    {
+      status = RMCPPLUS_STATUS_INVALID_SESSION_ID;
+      session = NULL;
+    }
+  else if (strcmp (user_name, cmd_args.username))
+    status = RMCPPLUS_STATUS_UNAUTHORIZED_NAME;
+  else if (!IPMI_PRIVILEGE_LEVEL_VALID (requested_maximum_privilege_level))
+    status = RMCPPLUS_STATUS_INVALID_ROLE;
+  else if (requested_maximum_privilege_level > session->maximum_privilege_level)
+    status = RMCPPLUS_STATUS_UNAUTHORIZED_ROLE_OR_PRIVILEGE_LEVEL_REQUESTED;
+
+  if (session)
+    remote_console_session_id = session->remote_console_session_id;
+
+  if (status == RMCPPLUS_STATUS_NO_ERRORS)
+    {
+      session->name_only_lookup = name_only_lookup;
+      session->requested_maximum_privilege_level = requested_maximum_privilege_level;
+      strcpy (session->user_name, user_name);
+      session->user_name_len = user_name_length;
+
+      if (fiid_obj_get_data (obj_rakp_message_1,
+                             "remote_console_random_number",
+                             session->remote_console_random_number,
+                             IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH) < 0
+          || ipmi_get_random (session->managed_system_random_number,
+                              IPMI_MANAGED_SYSTEM_RANDOM_NUMBER_LENGTH) < 0)
+        {
+          bmc_simulator_debug (bmc, "RAKP message 1: %s", strerror (errno));
+          return;
+        }
+
+      if (ipmi_calculate_rmcpplus_session_keys (session->authentication_algorithm,
+                                                session->integrity_algorithm,
+                                                session->confidentiality_algorithm,
+                                                strlen (cmd_args.password) ? cmd_args.password : NULL,
+                                                strlen (cmd_args.password),
+                                                cmd_args.k_g_len ? cmd_args.k_g : NULL,
+                                                cmd_args.k_g_len,
+                                                session->remote_console_random_number,
+                                                IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH,
+                                                session->managed_system_random_number,
+                                                IPMI_MANAGED_SYSTEM_RANDOM_NUMBER_LENGTH,
+                                                session->name_only_lookup,
+                                                session->requested_maximum_privilege_level,
+                                                session->user_name_len ? session->user_name : NULL,
+                                                session->user_name_len,
+                                                &(session->sik_key_ptr),
+                                                &(session->sik_key_len),
+                                                &(session->integrity_key_ptr),
+                                                &(session->integrity_key_len),
+                                                &(session->confidentiality_key_ptr),
+                                                &(session->confidentiality_key_len)) < 0)
+        {
+          bmc_simulator_debug (bmc, "ipmi_calculate_rmcpplus_session_keys: %s", strerror (errno));
+          return;
+        }
+
+      /* HMAC (SIDm, SIDc, Rm, Rc, GUIDc, ROLEm, ULENGTHm, UNAMEm) */
+      if (session->authentication_algorithm != IPMI_AUTHENTICATION_ALGORITHM_RAKP_NONE)
+        {
+          buf_len += _set_u32 (buf + buf_len, session->remote_console_session_id);
+          buf_len += _set_u32 (buf + buf_len, session->session_id);
+          memcpy (buf + buf_len, session->remote_console_random_number, IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH);
+          buf_len += IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH;
+          memcpy (buf + buf_len, session->managed_system_random_number, IPMI_MANAGED_SYSTEM_RANDOM_NUMBER_LENGTH);
+          buf_len += IPMI_MANAGED_SYSTEM_RANDOM_NUMBER_LENGTH;
+          memcpy (buf + buf_len, bmc->guid, IPMI_MANAGED_SYSTEM_GUID_LENGTH);
+          buf_len += IPMI_MANAGED_SYSTEM_GUID_LENGTH;
+          buf[buf_len++] = (session->name_only_lookup ? 0x10 : 0x00) | session->requested_maximum_privilege_level;
+          buf[buf_len++] = session->user_name_len;
+          memcpy (buf + buf_len, session->user_name, session->user_name_len);
+          buf_len += session->user_name_len;
+
+          _k_uid (&k_uid, &k_uid_len);
+
+          if ((key_exchange_authentication_code_len = _hmac (session->authentication_algorithm,
+                                                             k_uid,
+                                                             k_uid_len,
+                                                             buf,
+                                                             buf_len,
+                                                             key_exchange_authentication_code,
+                                                             BMC_SIMULATOR_HMAC_DIGEST_LENGTH_MAX)) < 0)
+            {
+              bmc_simulator_debug (bmc, "RAKP message 2 key exchange authentication code failed");
+              return;
+            }
+        }
+
+      session->state = BMC_SIMULATOR_SESSION_STATE_RAKP;
+    }
+  else
+    {
+      bmc_simulator_debug (bmc, "RAKP message 1 failed, status 0x%02X", status);
+      if (session)
+        bmc_simulator_session_destroy (bmc, session);
+    }
+
+  if (fiid_obj_clear (obj_rakp_message_2) < 0
+      || fiid_obj_set (obj_rakp_message_2, "message_tag", message_tag) < 0
+      || fiid_obj_set (obj_rakp_message_2, "rmcpplus_status_code", status) < 0
+      || fiid_obj_set (obj_rakp_message_2, "reserved1", 0) < 0
+      || fiid_obj_set (obj_rakp_message_2, "remote_console_session_id", remote_console_session_id) < 0)
+    {
+      bmc_simulator_debug (bmc, "RAKP message 2: %s", fiid_obj_errormsg (obj_rakp_message_2));
+      return;
+    }
+
+  if (status == RMCPPLUS_STATUS_NO_ERRORS)
+    {
+      if (fiid_obj_set_data (obj_rakp_message_2,
+                             "managed_system_random_number",
+                             session->managed_system_random_number,
+                             IPMI_MANAGED_SYSTEM_RANDOM_NUMBER_LENGTH) < 0
+          || fiid_obj_set_data (obj_rakp_message_2,
+                                "managed_system_guid",
+                                bmc->guid,
+                                IPMI_MANAGED_SYSTEM_GUID_LENGTH) < 0
+          || (key_exchange_authentication_code_len
+              && fiid_obj_set_data (obj_rakp_message_2,
+                                    "key_exchange_authentication_code",
+                                    key_exchange_authentication_code,
+                                    key_exchange_authentication_code_len) < 0))
+        {
+          bmc_simulator_debug (bmc, "RAKP message 2: %s", fiid_obj_errormsg (obj_rakp_message_2));
+          return;
+        }
+    }
+
+  _send_session_setup (bmc,
+                       from,
+                       IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_2,
+                       obj_rakp_message_2);
+}
+
+static void
+_rakp_message_3 (struct bmc_simulator_bmc *bmc,
+                 const struct sockaddr_in *from,
+                 const uint8_t *payload,
+                 unsigned int payload_len)
+{
+  struct bmc_simulator_session *session;
+  uint8_t key_exchange_authentication_code[BMC_SIMULATOR_HMAC_DIGEST_LENGTH_MAX];
+  uint8_t expected_key_exchange_authentication_code[BMC_SIMULATOR_HMAC_DIGEST_LENGTH_MAX];
+  uint8_t integrity_check_value[BMC_SIMULATOR_HMAC_DIGEST_LENGTH_MAX];
+  uint8_t buf[BMC_SIMULATOR_KEY_DATA_MAX];
+  unsigned int buf_len = 0;
+  int key_exchange_authentication_code_len, expected_len;
+  int integrity_check_value_len = 0;
+  uint64_t message_tag, rmcpplus_status_code, managed_system_session_id;
+  uint8_t status = RMCPPLUS_STATUS_NO_ERRORS;
+
+  if (fiid_obj_clear (obj_rakp_message_3) < 0
+      || fiid_obj_set_all (obj_rakp_message_3, payload, payload_len) < 0
+      || FIID_OBJ_GET (obj_rakp_message_3, "message_tag", &message_tag) < 0
+      || FIID_OBJ_GET (obj_rakp_message_3, "rmcpplus_status_code", &rmcpplus_status_code) < 0
+      || FIID_OBJ_GET (obj_rakp_message_3, "managed_system_session_id", &managed_system_session_id) < 0
+      || (key_exchange_authentication_code_len = fiid_obj_get_data (obj_rakp_message_3,
+                                                                     "key_exchange_authentication_code",
+                                                                     key_exchange_authentication_code,
+                                                                     BMC_SIMULATOR_HMAC_DIGEST_LENGTH_MAX)) < 0)
+    {
+      bmc_simulator_debug (bmc, "invalid RAKP message 3");
+      return;
+    }
+
+  /* No response to an unknown session.  RAKP 3 is retransmitted if
+   * RAKP 4 is lost, so it is accepted until the session is first used.
+   */
+  if (!(session = bmc_simulator_session_find (bmc, managed_system_session_id))
+      || !session->rmcpplus
+      || (session->state != BMC_SIMULATOR_SESSION_STATE_RAKP
+          && (session->state != BMC_SIMULATOR_SESSION_STATE_ACTIVE
+              || session->outbound_sequence_number != 1)))
+    {
+      bmc_simulator_debug (bmc, "RAKP message 3 for invalid session 0x%08X", (uint32_t)managed_system_session_id);
+      return;
+    }
+
+  /* remote console gave up */
+  if (rmcpplus_status_code != RMCPPLUS_STATUS_NO_ERRORS)
+    {
+      bmc_simulator_debug (bmc, "RAKP message 3 status 0x%02X", (uint8_t)rmcpplus_status_code);
+      bmc_simulator_session_destroy (bmc, session);
+      return;
+    }
+
+  if (session->authentication_algorithm != IPMI_AUTHENTICATION_ALGORITHM_RAKP_NONE)
+    {
+      const void *k_uid;
+      unsigned int k_uid_len;
+
+      _k_uid (&k_uid, &k_uid_len);
+
+      if ((expected_len = ipmi_calculate_rakp_3_key_exchange_authentication_code (session->authentication_algorithm,
+                                                                                   k_uid,
+                                                                                   k_uid_len,
+                                                                                   session->managed_system_random_number,
+                                                                                   IPMI_MANAGED_SYSTEM_RANDOM_NUMBER_LENGTH,
+                                                                                   session->remote_console_session_id,
+                                                                                   session->name_only_lookup,
+                                                                                   session->requested_maximum_privilege_level,
+                                                                                   session->user_name_len ? session->user_name : NULL,
+                                                                                   session->user_name_len,
+                                                                                   expected_key_exchange_authentication_code,
+                                                                                   BMC_SIMULATOR_HMAC_DIGEST_LENGTH_MAX)) < 0)
+        {
+          bmc_simulator_debug (bmc, "ipmi_calculate_rakp_3_key_exchange_authentication_code: %s", strerror (errno));
+          return;
+        }
+
+      if (key_exchange_authentication_code_len != expected_len
+          || memcmp (key_exchange_authentication_code,
+                     expected_key_exchange_authentication_code,
+                     expected_len))
+        status = RMCPPLUS_STATUS_INVALID_INTEGRITY_CHECK_VALUE;
+      else
+        {
+          /* HMAC (Rm, SIDc, GUIDc) keyed by SIK */
+          memcpy (buf + buf_len, session->remote_console_random_number, IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH);
+          buf_len += IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH;
+          buf_len += _set_u32 (buf + buf_len, session->session_id);
+          memcpy (buf + buf_len, bmc->guid, IPMI_MANAGED_SYSTEM_GUID_LENGTH);
+          buf_len += IPMI_MANAGED_SYSTEM_GUID_LENGTH;
+
+          if ((integrity_check_value_len = _hmac (session->authentication_algorithm,
+                                                  session->sik_key_ptr,
+                                                  session->sik_key_len,
+                                                  buf,
+                                                  buf_len,
+                                                  integrity_check_value,
+                                                  BMC_SIMULATOR_HMAC_DIGEST_LENGTH_MAX)) < 0)
+            {
+              bmc_simulator_debug (bmc, "RAKP message 4 integrity check value failed");
+              return;
+            }
+
+          if (session->authentication_algorithm == IPMI_AUTHENTICATION_ALGORITHM_RAKP_HMAC_SHA1)
+            integrity_check_value_len = IPMI_HMAC_SHA1_96_AUTHENTICATION_CODE_LENGTH;
+          else if (session->authentication_algorithm == IPMI_AUTHENTICATION_ALGORITHM_RAKP_HMAC_SHA256)
+            integrity_check_value_len = IPMI_HMAC_SHA256_128_AUTHENTICATION_CODE_LENGTH;
+        }
+    }
+
+  if (status == RMCPPLUS_STATUS_NO_ERRORS
+      && session->state == BMC_SIMULATOR_SESSION_STATE_RAKP)
+    {
+      session->state = BMC_SIMULATOR_SESSION_STATE_ACTIVE;
+      session->maximum_privilege_level = session->requested_maximum_privilege_level;
+      session->outbound_sequence_number = 1;
+      bmc->sessions_activated++;
+      bmc_simulator_debug (bmc, "session 0x%08X activated", session->session_id);
+    }
+  else if (status != RMCPPLUS_STATUS_NO_ERRORS)
+    {
+      bmc_simulator_debug (bmc, "RAKP message 3 failed, status 0x%02X", status);
+      bmc_simulator_session_destroy (bmc, session);
+    }
+
+  if (fiid_obj_clear (obj_rakp_message_4) < 0
+      || fiid_obj_set (obj_rakp_message_4, "message_tag", message_tag) < 0
+      || fiid_obj_set (obj_rakp_message_4, "rmcpplus_status_code", status) < 0
+      || fiid_obj_set (obj_rakp_message_4, "reserved1", 0) < 0
+      || fiid_obj_set (obj_rakp_message_4, "remote_console_session_id", session->remote_console_session_id) < 0
+      || (integrity_check_value_len
+          && fiid_obj_set_data (obj_rakp_message_4,
+                                "integrity_check_value",
+                                integrity_check_value,
+                                integrity_check_value_len) < 0))
+    {
+      bmc_simulator_debug (bmc, "RAKP message 4: %s", fiid_obj_errormsg (obj_rakp_message_4));
+      return;
+    }
+
+  _send_session_setup (bmc,
+                       from,
+                       IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_4,
+                       obj_rakp_message_4);
+}
+
+static void
+_send_sol (struct bmc_simulator_bmc *bmc,
+           struct bmc_simulator_session *session,
+           uint8_t packet_sequence_number,
+           uint8_t packet_ack_nack_sequence_number,
+           uint8_t accepted_character_count,
+           const void *character_data,
+           unsigned int character_data_len)
+{
+  assert (bmc);
+  assert (session);
+
+  if (fiid_obj_clear (obj_sol) < 0
+      || fiid_obj_set (obj_sol, "packet_sequence_number", packet_sequence_number) < 0
+      || fiid_obj_set (obj_sol, "reserved1", 0) < 0
+      || fiid_obj_set (obj_sol, "packet_ack_nack_sequence_number", packet_ack_nack_sequence_number) < 0
+      || fiid_obj_set (obj_sol, "reserved2", 0) < 0
+      || fiid_obj_set (obj_sol, "accepted_character_count", accepted_character_count) < 0
+      || fiid_obj_set (obj_sol, "operation_status", 0) < 0
+      || (character_data_len
+          && fiid_obj_set_data (obj_sol, "character_data", character_data, character_data_len) < 0))
+    {
+      bmc_simulator_debug (bmc, "SOL payload: %s", fiid_obj_errormsg (obj_sol));
+      return;
+    }
+
+  _send_payload (bmc, session, IPMI_PAYLOAD_TYPE_SOL, NULL, obj_sol);
+}
+
+void
+bmc_simulator_rmcpplus_sol (struct bmc_simulator_bmc *bmc,
+                            struct bmc_simulator_session *session,
+                            const struct timeval *now)
+{
+  unsigned int elapsed;
+  unsigned int len;
+
+  assert (bmc);
+  assert (session);
+  assert (now);
+
+  if (session->state != BMC_SIMULATOR_SESSION_STATE_ACTIVE
+      || !session->sol_activated)
+    return;
+
+  if (session->sol_unacked_len)
+    {
+      elapsed = (now->tv_sec - session->sol_sent.tv_sec) * 1000
+        + (now->tv_usec - session->sol_sent.tv_usec) / 1000;
+
+      if (elapsed < BMC_SIMULATOR_SOL_RETRANSMIT_TIMEOUT)
+        return;
+
+      if (++session->sol_retransmits <= BMC_SIMULATOR_SOL_RETRANSMITS_MAX)
+        {
+          _send_sol (bmc,
+                     session,
+                     session->sol_sequence_number,
+                     0,
+                     0,
+                     session->sol_unacked,
+                     session->sol_unacked_len);
+          session->sol_sent = *now;
+          return;
+        }
+
+      bmc_simulator_debug (bmc, "SOL packet %u not acknowledged, dropped", session->sol_sequence_number);
+      session->sol_unacked_len = 0;
+    }
+
+  if (!session->sol_output_len)
+    return;
+
+  len = session->sol_output_len;
+  if (len > BMC_SIMULATOR_SOL_CHARACTERS_MAX)
+    len = BMC_SIMULATOR_SOL_CHARACTERS_MAX;
+
+  memcpy (session->sol_unacked, session->sol_output, len);
+  session->sol_unacked_len = len;
+  session->sol_output_len -= len;
+  memmove (session->sol_output, session->sol_output + len, session->sol_output_len);
+
+  if (++session->sol_sequence_number > BMC_SIMULATOR_SOL_SEQUENCE_NUMBER_MAX)
+    session->sol_sequence_number = 1;
+  session->sol_retransmits = 0;
+  session->sol_sent = *now;
+
+  _send_sol (bmc,
+             session,
+             session->sol_sequence_number,
+             0,
+             0,
+             session->sol_unacked,
+             session->sol_unacked_len);
+}
+
+/* The console is a loopback, characters received are echoed back */
+static void
+_sol (struct bmc_simulator_bmc *bmc,
+      struct bmc_simulator_session *session)
+{
+  uint8_t character_data[BMC_SIMULATOR_PKT_LEN];
+  uint64_t packet_sequence_number, packet_ack_nack_sequence_number;
+  uint64_t accepted_character_count, operation_status;
+  unsigned int accepted, unaccepted;
+  struct timeval now;
+  int len;
+
+  assert (bmc);
+  assert (session);
+
+  if (!session->sol_activated)
+    return;
+
+  if (FIID_OBJ_GET (obj_sol, "packet_sequence_number", &packet_sequence_number) < 0
+      || FIID_OBJ_GET (obj_sol, "packet_ack_nack_sequence_number", &packet_ack_nack_sequence_number) < 0
+      || FIID_OBJ_GET (obj_sol, "accepted_character_count", &accepted_character_count) < 0
+      || FIID_OBJ_GET (obj_sol, "operation_status", &operation_status) < 0
+      || (len = fiid_obj_get_data (obj_sol, "character_data", character_data, BMC_SIMULATOR_PKT_LEN)) < 0)
+    {
+      bmc_simulator_debug (bmc, "invalid SOL payload");
+      return;
+    }
+
+  if (packet_ack_nack_sequence_number
+      && session->sol_unacked_len
+      && packet_ack_nack_sequence_number == session->sol_sequence_number
+      && !(operation_status & BMC_SIMULATOR_SOL_NACK))
+    {
+      /* characters not accepted are sent again */
+      accepted = accepted_character_count;
+      if (accepted > session->sol_unacked_len)
+        accepted = session->sol_unacked_len;
+      unaccepted = session->sol_unacked_len - accepted;
+      if (unaccepted
+          && (session->sol_output_len + unaccepted) <= BMC_SIMULATOR_SOL_BUFLEN)
+        {
+          memmove (session->sol_output + unaccepted, session->sol_output, session->sol_output_len);
+          memcpy (session->sol_output, session->sol_unacked + accepted, unaccepted);
+          session->sol_output_len += unaccepted;
+        }
+      session->sol_unacked_len = 0;
+    }
+
+  if (packet_sequence_number && len)
+    {
+      /* a retransmission was already echoed, only acknowledge it */
+      if (packet_sequence_number != session->sol_inbound_sequence_number)
+        {
+          accepted = len;
+          if (accepted > (BMC_SIMULATOR_SOL_BUFLEN - session->sol_output_len))
+            accepted = BMC_SIMULATOR_SOL_BUFLEN - session->sol_output_len;
+          memcpy (session->sol_output + session->sol_output_len, character_data, accepted);
+          session->sol_output_len += accepted;
+          session->sol_inbound_sequence_number = packet_sequence_number;
+        }
+      else
+        accepted = len;
+
+      _send_sol (bmc, session, 0, packet_sequence_number, accepted, NULL, 0);
+    }
+
+  gettimeofday (&now, NULL);
+  bmc_simulator_rmcpplus_sol (bmc, session, &now);
+}
+
+static void
+_payload (struct bmc_simulator_bmc *bmc,
+          const struct sockaddr_in *from,
+          const uint8_t *pkt,
+          unsigned int pkt_len,
+          uint8_t payload_type,
+          uint32_t session_id)
+{
+  struct bmc_simulator_session *session;
+  uint8_t rq[BMC_SIMULATOR_PKT_LEN];
+  uint8_t rs[BMC_SIMULATOR_CMD_RS_BUFLEN];
+  uint64_t net_fn;
+  int rq_len;
+  unsigned int rs_len;
+  int ret;
+
+  if (!(session = bmc_simulator_session_find (bmc, session_id))
+      || !session->rmcpplus
+      || session->state != BMC_SIMULATOR_SESSION_STATE_ACTIVE)
+    {
+      bmc_simulator_debug (bmc, "invalid session 0x%08X", session_id);
+      return;
+    }
+
+  if ((ret = unassemble_ipmi_rmcpplus_pkt (session->authentication_algorithm,
+                                           session->integrity_algorithm,
+                                           session->confidentiality_algorithm,
+                                           session->integrity_key_ptr,
+                                           session->integrity_key_len,
+                                           session->confidentiality_key_ptr,
+                                           session->confidentiality_key_len,
+                                           pkt,
+                                           pkt_len,
+                                           obj_rmcp_hdr,
+                                           obj_rmcpplus_session_hdr,
+                                           obj_rmcpplus_payload,
+                                           obj_lan_msg_hdr_rs,
+                                           payload_type == IPMI_PAYLOAD_TYPE_IPMI ? obj_cmd : obj_sol,
+                                           obj_lan_msg_trlr,
+                                           obj_rmcpplus_session_trlr,
+                                           IPMI_INTERFACE_FLAGS_DEFAULT)) < 0)
+    {
+      bmc_simulator_debug (bmc, "unassemble_ipmi_rmcpplus_pkt: %s", strerror (errno));
+      return;
+    }
+
+  if (!ret)
+    {
+      bmc_simulator_debug (bmc, "truncated IPMI 2.0 packet");
+      return;
+    }
+
+  if (session->integrity_algorithm != IPMI_INTEGRITY_ALGORITHM_NONE
+      && ipmi_rmcpplus_check_packet_session_authentication_code (session->integrity_algorithm,
+                                                                 pkt,
+                                                                 pkt_len,
+                                                                 session->integrity_key_ptr,
+                                                                 session->integrity_key_len,
+                                                                 cmd_args.password,
+                                                                 strlen (cmd_args.password),
+                                                                 obj_rmcpplus_session_trlr) != 1)
+    {
+      bmc_simulator_debug (bmc, "invalid session authentication code");
+      return;
+    }
+
+  session->last_activity = time (NULL);
+  memcpy (&(session->from), from, sizeof (struct sockaddr_in));
+
+  if (payload_type == IPMI_PAYLOAD_TYPE_SOL)
+    {
+      _sol (bmc, session);
+      return;
+    }
+
+  if (ipmi_lan_check_checksum (obj_lan_msg_hdr_rs, obj_cmd, obj_lan_msg_trlr) != 1)
+    {
+      bmc_simulator_debug (bmc, "invalid checksum");
+      return;
+    }
+
+  if (FIID_OBJ_GET (obj_lan_msg_hdr_rs, "net_fn", &net_fn) < 0
+      || (rq_len = fiid_obj_get_data (obj_cmd, "raw_data", rq, BMC_SIMULATOR_PKT_LEN)) <= 0)
+    return;
+
+  if (!(rs_len = bmc_simulator_cmd (bmc,
+                                    session,
+                                    from,
+                                    net_fn,
+                                    rq,
+                                    rq_len,
+                                    rs,
+                                    BMC_SIMULATOR_CMD_RS_BUFLEN)))
+    return;
+
+  if (bmc_simulator_lan_fill_msg_hdr (obj_lan_msg_hdr_rs, obj_lan_msg_hdr_rq) < 0
+      || fiid_obj_clear (obj_cmd) < 0
+      || fiid_obj_set_all (obj_cmd, rs, rs_len) < 0)
+    {
+      bmc_simulator_debug (bmc, "response: %s", strerror (errno));
+      return;
+    }
+
+  _send_payload (bmc, session, IPMI_PAYLOAD_TYPE_IPMI, obj_lan_msg_hdr_rq, obj_cmd);
+
+  /* SOL banner goes out once the activation response has */
+  if (session->sol_activated
+      && session->sol_output_len
+      && !session->sol_unacked_len)
+    {
+      struct timeval now;
+
+      gettimeofday (&now, NULL);
+      bmc_simulator_rmcpplus_sol (bmc, session, &now);
+    }
+}
+
+void
+bmc_simulator_rmcpplus_process (struct bmc_simulator_bmc *bmc,
+                                const struct sockaddr_in *from,
+                                const uint8_t *pkt,
+                                unsigned int pkt_len)
+{
+  uint8_t payload_type;
+  uint32_t session_id;
+  unsigned int payload_len;
+
+  assert (bmc);
+  assert (from);
+  assert (pkt);
+
+  /* The session setup payloads cannot be unassembled by libfreeipmi
+   * on the BMC side, so the header is parsed here.
+   *
+   * RMCP header (4), authentication type (1), payload type (1),
+   * session id (4), session sequence number (4), payload length (2)
+   */
+  if (pkt_len < BMC_SIMULATOR_RMCPPLUS_HDR_LEN)
+    return;
+
+  payload_type = pkt[5] & 0x3F;
+  session_id = _get_u32 (&pkt[6]);
+  payload_len = pkt[14] | (pkt[15] << 8);
+
+  if ((BMC_SIMULATOR_RMCPPLUS_HDR_LEN + payload_len) > pkt_len)
+    {
+      bmc_simulator_debug (bmc, "truncated IPMI 2.0 packet");
+      return;
+    }
+
+  switch (payload_type)
+    {
+    case IPMI_PAYLOAD_TYPE_RMCPPLUS_OPEN_SESSION_REQUEST:
+      _open_session (bmc, from, pkt + BMC_SIMULATOR_RMCPPLUS_HDR_LEN, payload_len);
+      break;
+    case IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_1:
+      _rakp_message_1 (bmc, from, pkt + BMC_SIMULATOR_RMCPPLUS_HDR_LEN, payload_len);
+      break;
+    case IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_3:
+      _rakp_message_3 (bmc, from, pkt + BMC_SIMULATOR_RMCPPLUS_HDR_LEN, payload_len);
+      break;
+    case IPMI_PAYLOAD_TYPE_IPMI:
+    case IPMI_PAYLOAD_TYPE_SOL:
+      _payload (bmc, from, pkt, pkt_len, payload_type, session_id);
+      break;
+    default:
+      bmc_simulator_debug (bmc, "unsupported payload type 0x%02X", payload_type);
+      break;
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BMC_SIMULATOR_RMCPPLUS_H
+#define BMC_SIMULATOR_RMCPPLUS_H
+
+#include "bmc-simulator.h"
+
+void bmc_simulator_rmcpplus_setup (void);
+
+/* IPMI 2.0 session setup, IPMI, and SOL payloads */
+void bmc_simulator_rmcpplus_process (struct bmc_simulator_bmc *bmc,
+                                     const struct sockaddr_in *from,
+                                     const uint8_t *pkt,
+                                     unsigned int pkt_len);
+
+/* sends pending SOL output and retransmits unacknowledged SOL
+ * packets
+ */
+void bmc_simulator_rmcpplus_sol (struct bmc_simulator_bmc *bmc,
+                                 struct bmc_simulator_session *session,
+                                 const struct timeval *now);
+
+#endif /* BMC_SIMULATOR_RMCPPLUS_H */
@@ -0,0 +1,604 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <freeipmi/freeipmi.h>
+
+#include "bmc-simulator.h"
+#include "bmc-simulator-script.h"
+
+#include "freeipmi-portability.h"
+#include "conffile.h"
+#include "error.h"
+
+#define BMC_SIMULATOR_SDR_VERSION 0x51
+
+/* 2014-01-01 00:00:00 UTC */
+#define BMC_SIMULATOR_SDR_TIMESTAMP_DEFAULT 1388534400
+
+/* Sensor types map to a unit and conversion factors so readings in
+ * the script can be given in the unit, e.g. "12.1" volts is stored
+ * as raw 121 with M = 1 and R exponent = -1.
+ */
+struct bmc_simulator_sensor_type
+{
+  char *name;
+  uint8_t sensor_type;
+  uint8_t sensor_base_unit;
+  int m;
+  int r_exponent;
+};
+
+static struct bmc_simulator_sensor_type sensor_types[] =
+  {
+    { "temperature", IPMI_SENSOR_TYPE_TEMPERATURE, IPMI_SENSOR_UNIT_DEGREES_C, 1, 0},
+    { "voltage", IPMI_SENSOR_TYPE_VOLTAGE, IPMI_SENSOR_UNIT_VOLTS, 1, -1},
+    { "current", IPMI_SENSOR_TYPE_CURRENT, IPMI_SENSOR_UNIT_AMPS, 1, -1},
+    { "fan", IPMI_SENSOR_TYPE_FAN, IPMI_SENSOR_UNIT_RPM, 100, 0},
+    { "power", IPMI_SENSOR_TYPE_OTHER_UNITS_BASED_SENSOR, IPMI_SENSOR_UNIT_WATTS, 10, 0},
+    { NULL, 0, 0, 0, 0},
+  };
+
+/* Used when no script is given */
+static char *default_sensors[][6] =
+  {
+    { "1", "CPU Temp", "temperature", "45", "5", "90" },
+    { "2", "System Temp", "temperature", "32", "5", "70" },
+    { "3", "12V", "voltage", "12.1", "10.8", "13.2" },
+    { "4", "3.3V", "voltage", "3.3", "3.0", "3.6" },
+    { "5", "Fan 1", "fan", "5400", "500", "20000" },
+    { "6", "PSU Power", "power", "180", NULL, NULL },
+    { NULL, NULL, NULL, NULL, NULL, NULL },
+  };
+
+static struct bmc_simulator_sel_entry default_sel_entries[] =
+  {
+    /* CPU Temp upper critical going high, reading 91, threshold 90 */
+    { IPMI_SENSOR_TYPE_TEMPERATURE, 1, IPMI_EVENT_READING_TYPE_CODE_THRESHOLD, 0, 0x59, 91, 90 },
+    /* Fan 1 lower critical going low, reading 400, threshold 500 */
+    { IPMI_SENSOR_TYPE_FAN, 5, IPMI_EVENT_READING_TYPE_CODE_THRESHOLD, 0, 0x52, 4, 5 },
+    /* OEM system boot event */
+    { IPMI_SENSOR_TYPE_SYSTEM_EVENT, 0x10, IPMI_EVENT_READING_TYPE_CODE_SENSOR_SPECIFIC, 0, 0x01, 0xFF, 0xFF },
+  };
+
+static void
+_script_error (conffile_t cf, const char *optionname, const char *msg)
+{
+  assert (optionname);
+  assert (msg);
+
+  if (cf)
+    err_exit ("Script Error: line %d: %s: %s",
+              conffile_line_number (cf),
+              optionname,
+              msg);
+  else
+    err_exit ("Script Error: %s: %s", optionname, msg);
+}
+
+static long
+_parse_number (conffile_t cf,
+               const char *optionname,
+               const char *str,
+               long min,
+               long max)
+{
+  char *endptr;
+  long rv;
+
+  assert (optionname);
+  assert (str);
+
+  errno = 0;
+  rv = strtol (str, &endptr, 0);
+  if (errno
+      || endptr[0] != '\0'
+      || rv < min
+      || rv > max)
+    _script_error (cf, optionname, "invalid number");
+
+  return (rv);
+}
+
+/* convert a reading in the sensor's unit to the raw reading */
+static uint8_t
+_parse_reading (conffile_t cf,
+                const char *optionname,
+                const char *str,
+                struct bmc_simulator_sensor *sensor)
+{
+  char *endptr;
+  double value;
+  double factor;
+  double raw;
+  int i;
+
+  assert (optionname);
+  assert (str);
+  assert (sensor);
+
+  errno = 0;
+  value = strtod (str, &endptr);
+  if (errno
+      || endptr[0] != '\0')
+    _script_error (cf, optionname, "invalid reading");
+
+  factor = sensor->m;
+  for (i = 0; i < sensor->r_exponent; i++)
+    factor *= 10;
+  for (i = 0; i > sensor->r_exponent; i--)
+    factor /= 10;
+
+  raw = (value / factor) + 0.5;
+  if (raw < 0 || raw > UCHAR_MAX)
+    _script_error (cf, optionname, "reading out of range for sensor type");
+
+  return ((uint8_t)raw);
+}
+
+static void
+_add_sensor (conffile_t cf,
+             const char *optionname,
+             char **args,
+             unsigned int args_count,
+             struct bmc_simulator_script *script)
+{
+  struct bmc_simulator_sensor *sensor;
+  unsigned int i;
+
+  assert (optionname);
+  assert (args);
+  assert (script);
+
+  /* NUMBER NAME TYPE READING [LOWER-CRITICAL UPPER-CRITICAL] */
+  if (args_count != 4 && args_count != 6)
+    _script_error (cf, optionname, "expected number, name, type, reading and optional thresholds");
+
+  if (script->sensors_count >= BMC_SIMULATOR_MAX_SENSORS)
+    _script_error (cf, optionname, "too many sensors");
+
+  sensor = &(script->sensors[script->sensors_count]);
+  memset (sensor, '\0', sizeof (struct bmc_simulator_sensor));
+
+  sensor->sensor_number = _parse_number (cf, optionname, args[0], 0, UCHAR_MAX - 1);
+  for (i = 0; i < script->sensors_count; i++)
+    {
+      if (script->sensors[i].sensor_number == sensor->sensor_number)
+        _script_error (cf, optionname, "duplicate sensor number");
+    }
+
+  if (strlen (args[1]) > BMC_SIMULATOR_SENSOR_NAME_MAX)
+    _script_error (cf, optionname, "sensor name too long");
+  strcpy (sensor->name, args[1]);
+
+  for (i = 0; sensor_types[i].name; i++)
+    {
+      if (!strcasecmp (sensor_types[i].name, args[2]))
+        break;
+    }
+  if (!sensor_types[i].name)
+    _script_error (cf, optionname, "unknown sensor type");
+
+  sensor->sensor_type = sensor_types[i].sensor_type;
+  sensor->sensor_base_unit = sensor_types[i].sensor_base_unit;
+  sensor->m = sensor_types[i].m;
+  sensor->r_exponent = sensor_types[i].r_exponent;
+
+  sensor->reading = _parse_reading (cf, optionname, args[3], sensor);
+
+  if (args_count == 6)
+    {
+      sensor->thresholds = 1;
+      sensor->lower_critical = _parse_reading (cf, optionname, args[4], sensor);
+      sensor->upper_critical = _parse_reading (cf, optionname, args[5], sensor);
+    }
+
+  script->sensors_count++;
+}
+
+static int
+_cb_sensor (conffile_t cf,
+            struct conffile_data *data,
+            char *optionname,
+            int option_type,
+            void *option_ptr,
+            int option_data,
+            void *app_ptr,
+            int app_data)
+{
+  char *args[CONFFILE_MAX_ARGS];
+  int i;
+
+  assert (data);
+  assert (optionname);
+  assert (option_ptr);
+
+  for (i = 0; i < data->stringlist_len; i++)
+    args[i] = data->stringlist[i];
+
+  _add_sensor (cf,
+               optionname,
+               args,
+               data->stringlist_len,
+               (struct bmc_simulator_script *)option_ptr);
+  return (0);
+}
+
+static int
+_cb_sel_entry (conffile_t cf,
+               struct conffile_data *data,
+               char *optionname,
+               int option_type,
+               void *option_ptr,
+               int option_data,
+               void *app_ptr,
+               int app_data)
+{
+  struct bmc_simulator_script *script;
+  struct bmc_simulator_sel_entry *sel_entry;
+
+  assert (data);
+  assert (optionname);
+  assert (option_ptr);
+
+  script = (struct bmc_simulator_script *)option_ptr;
+
+  /* SENSOR-TYPE SENSOR-NUMBER EVENT-TYPE-CODE EVENT-DATA1 EVENT-DATA2 EVENT-DATA3 [deassertion] */
+  if (data->stringlist_len != 6 && data->stringlist_len != 7)
+    _script_error (cf, optionname, "expected sensor type, sensor number, event type code and event data");
+
+  if (script->sel_entries_count >= BMC_SIMULATOR_MAX_SEL_ENTRIES)
+    _script_error (cf, optionname, "too many SEL entries");
+
+  sel_entry = &(script->sel_entries[script->sel_entries_count]);
+
+  sel_entry->sensor_type = _parse_number (cf, optionname, data->stringlist[0], 0, UCHAR_MAX);
+  sel_entry->sensor_number = _parse_number (cf, optionname, data->stringlist[1], 0, UCHAR_MAX);
+  sel_entry->event_type_code = _parse_number (cf, optionname, data->stringlist[2], 0, 0x7F);
+  sel_entry->event_data1 = _parse_number (cf, optionname, data->stringlist[3], 0, UCHAR_MAX);
+  sel_entry->event_data2 = _parse_number (cf, optionname, data->stringlist[4], 0, UCHAR_MAX);
+  sel_entry->event_data3 = _parse_number (cf, optionname, data->stringlist[5], 0, UCHAR_MAX);
+  sel_entry->event_dir = 0;
+
+  if (data->stringlist_len == 7)
+    {
+      if (strcasecmp (data->stringlist[6], "deassertion"))
+        _script_error (cf, optionname, "expected \"deassertion\"");
+      sel_entry->event_dir = 1;
+    }
+
+  script->sel_entries_count++;
+  return (0);
+}
+
+static int
+_cb_response (conffile_t cf,
+              struct conffile_data *data,
+              char *optionname,
+              int option_type,
+              void *option_ptr,
+              int option_data,
+              void *app_ptr,
+              int app_data)
+{
+  struct bmc_simulator_script *script;
+  struct bmc_simulator_response *response;
+  int i;
+
+  assert (data);
+  assert (optionname);
+  assert (option_ptr);
+
+  script = (struct bmc_simulator_script *)option_ptr;
+
+  /* NETFN CMD COMPLETION-CODE [DATA ...] */
+  if (data->stringlist_len < 3)
+    _script_error (cf, optionname, "expected netfn, cmd and completion code");
+
+  if ((data->stringlist_len - 2) > BMC_SIMULATOR_RESPONSE_DATA_MAX)
+    _script_error (cf, optionname, "too much response data");
+
+  if (script->responses_count >= BMC_SIMULATOR_MAX_RESPONSES)
+    _script_error (cf, optionname, "too many responses");
+
+  response = &(script->responses[script->responses_count]);
+
+  response->net_fn = _parse_number (cf, optionname, data->stringlist[0], 0, 0x3F);
+  response->cmd = _parse_number (cf, optionname, data->stringlist[1], 0, UCHAR_MAX);
+  response->data_len = 0;
+  for (i = 2; i < data->stringlist_len; i++)
+    response->data[response->data_len++] = _parse_number (cf, optionname, data->stringlist[i], 0, UCHAR_MAX);
+
+  script->responses_count++;
+  return (0);
+}
+
+static int
+_cb_sol_banner (conffile_t cf,
+                struct conffile_data *data,
+                char *optionname,
+                int option_type,
+                void *option_ptr,
+                int option_data,
+                void *app_ptr,
+                int app_data)
+{
+  struct bmc_simulator_script *script;
+  unsigned int len;
+
+  assert (data);
+  assert (optionname);
+  assert (option_ptr);
+
+  script = (struct bmc_simulator_script *)option_ptr;
+
+  /* each sol-banner is one line of the banner */
+  len = strlen (script->sol_banner);
+  if ((len + strlen (data->string) + 2) >= BMC_SIMULATOR_SOL_BUFLEN)
+    _script_error (cf, optionname, "banner too long");
+
+  strcat (script->sol_banner, data->string);
+  strcat (script->sol_banner, "\r\n");
+  return (0);
+}
+
+static int
+_cb_power_state (conffile_t cf,
+                 struct conffile_data *data,
+                 char *optionname,
+                 int option_type,
+                 void *option_ptr,
+                 int option_data,
+                 void *app_ptr,
+                 int app_data)
+{
+  struct bmc_simulator_script *script;
+
+  assert (data);
+  assert (optionname);
+  assert (option_ptr);
+
+  script = (struct bmc_simulator_script *)option_ptr;
+
+  if (!strcasecmp (data->string, "on"))
+    script->power_state = 1;
+  else if (!strcasecmp (data->string, "off"))
+    script->power_state = 0;
+  else
+    _script_error (cf, optionname, "expected \"on\" or \"off\"");
+  return (0);
+}
+
+/* Full Sensor Record, see IPMI 2.0 spec Table 43-1 */
+static void
+_build_sdr_record (struct bmc_simulator_script *script, unsigned int index)
+{
+  struct bmc_simulator_sensor *sensor;
+  uint8_t *record;
+  uint16_t record_id;
+  unsigned int name_len;
+
+  assert (script);
+  assert (index < script->sensors_count);
+
+  sensor = &(script->sensors[index]);
+  record = script->sdr[index];
+  record_id = index + 1;
+  name_len = strlen (sensor->name);
+
+  memset (record, '\0', BMC_SIMULATOR_SDR_RECORD_LENGTH_MAX);
+
+  /* record header */
+  record[0] = record_id & 0x00FF;
+  record[1] = (record_id & 0xFF00) >> 8;
+  record[2] = BMC_SIMULATOR_SDR_VERSION;
+  record[3] = IPMI_SDR_FORMAT_FULL_SENSOR_RECORD;
+  record[4] = 43 + name_len;
+
+  /* record key */
+  record[5] = IPMI_SLAVE_ADDRESS_BMC;
+  record[6] = 0;
+  record[7] = sensor->sensor_number;
+
+  /* record body */
+  record[8] = IPMI_ENTITY_ID_SYSTEM_BOARD;
+  record[9] = 1;
+  record[10] = 0x7F;            /* initialize scanning, events, thresholds, etc. */
+  record[11] = 0x40;            /* auto re-arm */
+  if (sensor->thresholds)
+    record[11] |= 0x04;         /* thresholds readable per mask */
+  record[12] = sensor->sensor_type;
+  record[13] = IPMI_EVENT_READING_TYPE_CODE_THRESHOLD;
+  if (sensor->thresholds)
+    {
+      /* lower critical going low asserts, lower/upper critical readable */
+      record[14] = 0x04;
+      record[15] = 0x20;
+      record[16] = 0x00;
+      record[17] = 0x22;
+      record[18] = 0x12;
+    }
+  record[20] = 0x00;            /* unsigned, no rate, not a percentage */
+  record[21] = sensor->sensor_base_unit;
+  record[23] = 0x00;            /* linear */
+  record[24] = sensor->m & 0xFF;
+  record[25] = ((sensor->m >> 8) & 0x03) << 6;
+  record[29] = (sensor->r_exponent & 0x0F) << 4;
+  record[34] = 0xFF;            /* sensor maximum reading */
+  record[35] = 0x00;            /* sensor minimum reading */
+  if (sensor->thresholds)
+    {
+      record[37] = sensor->upper_critical;
+      record[40] = sensor->lower_critical;
+    }
+  record[47] = 0xC0 | name_len; /* 8-bit ASCII + Latin 1 */
+  memcpy (&record[48], sensor->name, name_len);
+
+  script->sdr_len[index] = 48 + name_len;
+}
+
+void
+bmc_simulator_script_load (const char *filename, struct bmc_simulator_script *script)
+{
+  unsigned int i;
+
+  assert (script);
+
+  memset (script, '\0', sizeof (struct bmc_simulator_script));
+  script->power_state = 1;
+  script->start_time = time (NULL);
+  script->sdr_timestamp = BMC_SIMULATOR_SDR_TIMESTAMP_DEFAULT;
+
+  if (filename)
+    {
+      int sensor_count = 0, sel_entry_count = 0, response_count = 0;
+      int sol_banner_count = 0, power_state_count = 0;
+      struct stat statbuf;
+      struct conffile_option options[] =
+        {
+          {
+            "sensor",
+            CONFFILE_OPTION_LIST_STRING,
+            -1,
+            _cb_sensor,
+            -1,
+            0,
+            &sensor_count,
+            script,
+            0,
+          },
+          {
+            "sel-entry",
+            CONFFILE_OPTION_LIST_STRING,
+            -1,
+            _cb_sel_entry,
+            -1,
+            0,
+            &sel_entry_count,
+            script,
+            0,
+          },
+          {
+            "response",
+            CONFFILE_OPTION_LIST_STRING,
+            -1,
+            _cb_response,
+            -1,
+            0,
+            &response_count,
+            script,
+            0,
+          },
+          {
+            "sol-banner",
+            CONFFILE_OPTION_STRING,
+            -1,
+            _cb_sol_banner,
+            -1,
+            0,
+            &sol_banner_count,
+            script,
+            0,
+          },
+          {
+            "power-state",
+            CONFFILE_OPTION_STRING,
+            -1,
+            _cb_power_state,
+            1,
+            0,
+            &power_state_count,
+            script,
+            0,
+          },
+        };
+      conffile_t cf = NULL;
+
+      if (!(cf = conffile_handle_create ()))
+        err_exit ("conffile_handle_create: %s", strerror (errno));
+
+      if (conffile_parse (cf,
+                          filename,
+                          options,
+                          sizeof (options) / sizeof (struct conffile_option),
+                          NULL,
+                          0,
+                          0) < 0)
+        {
+          char buf[CONFFILE_MAX_ERRMSGLEN];
+
+          if (conffile_errmsg (cf, buf, CONFFILE_MAX_ERRMSGLEN) < 0)
+            err_exit ("conffile_parse: %d", conffile_errnum (cf));
+          err_exit ("Script Error: %s", buf);
+        }
+
+      conffile_handle_destroy (cf);
+
+      /* the SDR only changes when the script does */
+      if (!stat (filename, &statbuf))
+        script->sdr_timestamp = statbuf.st_mtime;
+    }
+  else
+    {
+      for (i = 0; default_sensors[i][0]; i++)
+        _add_sensor (NULL,
+                     "sensor",
+                     default_sensors[i],
+                     default_sensors[i][4] ? 6 : 4,
+                     script);
+
+      memcpy (script->sel_entries, default_sel_entries, sizeof (default_sel_entries));
+      script->sel_entries_count = sizeof (default_sel_entries) / sizeof (struct bmc_simulator_sel_entry);
+    }
+
+  for (i = 0; i < script->sensors_count; i++)
+    _build_sdr_record (script, i);
+}
+
+const struct bmc_simulator_response *
+bmc_simulator_script_response (const struct bmc_simulator_script *script,
+                               uint8_t net_fn,
+                               uint8_t cmd)
+{
+  unsigned int i;
+
+  assert (script);
+
+  for (i = 0; i < script->responses_count; i++)
+    {
+      if (script->responses[i].net_fn == net_fn
+          && script->responses[i].cmd == cmd)
+        return (&(script->responses[i]));
+    }
+
+  return (NULL);
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BMC_SIMULATOR_SCRIPT_H
+#define BMC_SIMULATOR_SCRIPT_H
+
+#include "bmc-simulator.h"
+
+/* Loads the script, or the built in defaults if filename is NULL,
+ * and builds the SDR.  Exits on error.
+ */
+void bmc_simulator_script_load (const char *filename, struct bmc_simulator_script *script);
+
+/* returns response if the script overrides net_fn/cmd, NULL if not */
+const struct bmc_simulator_response *bmc_simulator_script_response (const struct bmc_simulator_script *script,
+                                                                     uint8_t net_fn,
+                                                                     uint8_t cmd);
+
+#endif /* BMC_SIMULATOR_SCRIPT_H */
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <assert.h>
+
+#include <freeipmi/freeipmi.h>
+
+#include "bmc-simulator.h"
+#include "bmc-simulator-session.h"
+
+#include "freeipmi-portability.h"
+
+static uint32_t
+_session_id (struct bmc_simulator_bmc *bmc)
+{
+  uint32_t session_id;
+
+  assert (bmc);
+
+  /* 0 is reserved for session-less packets */
+  do {
+    if (ipmi_get_random (&session_id, sizeof (uint32_t)) < 0)
+      session_id = (uint32_t)random ();
+  } while (!session_id
+           || bmc_simulator_session_find (bmc, session_id));
+
+  return (session_id);
+}
+
+struct bmc_simulator_session *
+bmc_simulator_session_create (struct bmc_simulator_bmc *bmc,
+                              const struct sockaddr_in *from,
+                              int rmcpplus)
+{
+  struct bmc_simulator_session *session;
+  unsigned int i;
+
+  assert (bmc);
+  assert (from);
+
+  for (i = 0; i < cmd_args.max_sessions; i++)
+    {
+      if (bmc->sessions[i].state == BMC_SIMULATOR_SESSION_STATE_FREE)
+        break;
+    }
+
+  if (i >= cmd_args.max_sessions)
+    return (NULL);
+
+  session = &(bmc->sessions[i]);
+  memset (session, '\0', sizeof (struct bmc_simulator_session));
+  session->rmcpplus = rmcpplus;
+  memcpy (&(session->from), from, sizeof (struct sockaddr_in));
+  session->last_activity = time (NULL);
+  session->session_id = _session_id (bmc);
+  session->privilege_level = IPMI_PRIVILEGE_LEVEL_USER;
+  session->sik_key_ptr = session->sik_key;
+  session->sik_key_len = BMC_SIMULATOR_MAX_KEY_LENGTH;
+  session->integrity_key_ptr = session->integrity_key;
+  session->integrity_key_len = BMC_SIMULATOR_MAX_KEY_LENGTH;
+  session->confidentiality_key_ptr = session->confidentiality_key;
+  session->confidentiality_key_len = BMC_SIMULATOR_MAX_KEY_LENGTH;
+
+  /* state set by caller */
+  session->state = BMC_SIMULATOR_SESSION_STATE_CHALLENGE;
+  return (session);
+}
+
+struct bmc_simulator_session *
+bmc_simulator_session_find (struct bmc_simulator_bmc *bmc,
+                            uint32_t session_id)
+{
+  unsigned int i;
+
+  assert (bmc);
+
+  if (!session_id)
+    return (NULL);
+
+  for (i = 0; i < cmd_args.max_sessions; i++)
+    {
+      if (bmc->sessions[i].state != BMC_SIMULATOR_SESSION_STATE_FREE
+          && bmc->sessions[i].session_id == session_id)
+        return (&(bmc->sessions[i]));
+    }
+
+  return (NULL);
+}
+
+void
+bmc_simulator_session_destroy (struct bmc_simulator_bmc *bmc,
+                               struct bmc_simulator_session *session)
+{
+  assert (bmc);
+  assert (session);
+
+  bmc_simulator_debug (bmc, "session 0x%08X closed", session->session_id);
+  session->state = BMC_SIMULATOR_SESSION_STATE_FREE;
+  session->sol_activated = 0;
+}
+
+struct bmc_simulator_session *
+bmc_simulator_session_sol (struct bmc_simulator_bmc *bmc)
+{
+  unsigned int i;
+
+  assert (bmc);
+
+  for (i = 0; i < cmd_args.max_sessions; i++)
+    {
+      if (bmc->sessions[i].state == BMC_SIMULATOR_SESSION_STATE_ACTIVE
+          && bmc->sessions[i].sol_activated)
+        return (&(bmc->sessions[i]));
+    }
+
+  return (NULL);
+}
+
+void
+bmc_simulator_session_timeout (struct bmc_simulator_bmc *bmc, time_t now)
+{
+  unsigned int i;
+
+  assert (bmc);
+
+  for (i = 0; i < cmd_args.max_sessions; i++)
+    {
+      if (bmc->sessions[i].state != BMC_SIMULATOR_SESSION_STATE_FREE
+          && (now - bmc->sessions[i].last_activity) > cmd_args.session_timeout)
+        {
+          bmc_simulator_debug (bmc, "session 0x%08X timed out", bmc->sessions[i].session_id);
+          bmc_simulator_session_destroy (bmc, &(bmc->sessions[i]));
+        }
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BMC_SIMULATOR_SESSION_H
+#define BMC_SIMULATOR_SESSION_H
+
+#include "bmc-simulator.h"
+
+/* returns NULL if all session slots are in use */
+struct bmc_simulator_session *bmc_simulator_session_create (struct bmc_simulator_bmc *bmc,
+                                                            const struct sockaddr_in *from,
+                                                            int rmcpplus);
+
+/* returns NULL if session_id is not a known session */
+struct bmc_simulator_session *bmc_simulator_session_find (struct bmc_simulator_bmc *bmc,
+                                                          uint32_t session_id);
+
+/* session data is left intact, so a final response can still be
+ * built from it
+ */
+void bmc_simulator_session_destroy (struct bmc_simulator_bmc *bmc,
+                                    struct bmc_simulator_session *session);
+
+/* returns the session SOL is activated on, NULL if none */
+struct bmc_simulator_session *bmc_simulator_session_sol (struct bmc_simulator_bmc *bmc);
+
+/* destroys sessions idle longer than the session timeout */
+void bmc_simulator_session_timeout (struct bmc_simulator_bmc *bmc, time_t now);
+
+#endif /* BMC_SIMULATOR_SESSION_H */
@@ -0,0 +1,467 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <freeipmi/freeipmi.h>
+
+#include "bmc-simulator.h"
+#include "bmc-simulator-argp.h"
+#include "bmc-simulator-lan.h"
+#include "bmc-simulator-rmcpplus.h"
+#include "bmc-simulator-script.h"
+#include "bmc-simulator-session.h"
+
+#include "freeipmi-portability.h"
+#include "error.h"
+#include "heap.h"
+#include "timeval.h"
+
+#define BMC_SIMULATOR_POLL_TIMEOUT        1000
+
+#define BMC_SIMULATOR_POLL_TIMEOUT_BUSY   100
+
+#define BMC_SIMULATOR_SEND_QUEUE_SIZE     1024
+
+#define BMC_SIMULATOR_DEBUG_BUFLEN        1024
+
+#define BMC_SIMULATOR_RMCP_HDR_LEN        4
+
+#define BMC_SIMULATOR_RMCP_CLASS_MASK     0x1F
+
+struct bmc_simulator_arguments cmd_args;
+
+struct bmc_simulator_script script;
+
+static struct bmc_simulator_bmc *bmcs = NULL;
+
+static Heap send_queue = NULL;
+
+static int exit_flag = 1;
+
+/* a packet held back to simulate network latency */
+struct bmc_simulator_pkt
+{
+  struct timeval due;
+  struct bmc_simulator_bmc *bmc;
+  struct sockaddr_in to;
+  unsigned int pkt_len;
+  uint8_t pkt[BMC_SIMULATOR_PKT_LEN];
+};
+
+static void
+_signal_handler_callback (int sig)
+{
+  exit_flag = 0;
+}
+
+/* loss is a percentage */
+static int
+_drop (void)
+{
+  if (!cmd_args.loss)
+    return (0);
+  return ((unsigned int)(rand () % 100) < cmd_args.loss);
+}
+
+static unsigned int
+_delay (void)
+{
+  unsigned int delay = cmd_args.latency;
+
+  if (cmd_args.jitter)
+    delay += rand () % (cmd_args.jitter + 1);
+  return (delay);
+}
+
+/* heap is a max heap, earliest due packet on top */
+static int
+_pkt_cmp (void *x, void *y)
+{
+  struct bmc_simulator_pkt *a = (struct bmc_simulator_pkt *)x;
+  struct bmc_simulator_pkt *b = (struct bmc_simulator_pkt *)y;
+
+  if (timeval_lt (&(a->due), &(b->due)))
+    return (1);
+  if (timeval_gt (&(a->due), &(b->due)))
+    return (-1);
+  return (0);
+}
+
+static void
+_sendto (struct bmc_simulator_bmc *bmc,
+         const struct sockaddr_in *to,
+         const void *pkt,
+         unsigned int pkt_len)
+{
+  assert (bmc);
+  assert (to);
+  assert (pkt);
+
+  if (sendto (bmc->fd,
+              pkt,
+              pkt_len,
+              0,
+              (struct sockaddr *)to,
+              sizeof (struct sockaddr_in)) < 0)
+    {
+      bmc_simulator_debug (bmc, "sendto: %s", strerror (errno));
+      return;
+    }
+
+  bmc->packets_sent++;
+}
+
+void
+bmc_simulator_send (struct bmc_simulator_bmc *bmc,
+                    const struct sockaddr_in *to,
+                    const void *pkt,
+                    unsigned int pkt_len)
+{
+  struct bmc_simulator_pkt *p;
+  struct timeval now;
+  unsigned int delay;
+
+  assert (bmc);
+  assert (to);
+  assert (pkt);
+  assert (pkt_len <= BMC_SIMULATOR_PKT_LEN);
+
+  if (_drop ())
+    {
+      bmc->packets_dropped++;
+      return;
+    }
+
+  if (!(delay = _delay ()))
+    {
+      _sendto (bmc, to, pkt, pkt_len);
+      return;
+    }
+
+  /* no room to delay it, better late than never */
+  if (heap_is_full (send_queue))
+    {
+      _sendto (bmc, to, pkt, pkt_len);
+      return;
+    }
+
+  if (!(p = (struct bmc_simulator_pkt *)malloc (sizeof (struct bmc_simulator_pkt))))
+    err_exit ("malloc: %s", strerror (errno));
+
+  gettimeofday (&now, NULL);
+  timeval_add_ms (&now, delay, &(p->due));
+  p->bmc = bmc;
+  memcpy (&(p->to), to, sizeof (struct sockaddr_in));
+  memcpy (p->pkt, pkt, pkt_len);
+  p->pkt_len = pkt_len;
+
+  if (!heap_insert (send_queue, p))
+    err_exit ("heap_insert: %s", strerror (errno));
+}
+
+void
+bmc_simulator_debug (struct bmc_simulator_bmc *bmc, const char *fmt, ...)
+{
+  char buf[BMC_SIMULATOR_DEBUG_BUFLEN];
+  va_list ap;
+
+  assert (bmc);
+  assert (fmt);
+
+  if (!cmd_args.debug)
+    return;
+
+  va_start (ap, fmt);
+  vsnprintf (buf, BMC_SIMULATOR_DEBUG_BUFLEN, fmt, ap);
+  va_end (ap);
+
+  err_debug ("%s: %s", bmc->name, buf);
+}
+
+static void
+_send_queue_flush (const struct timeval *now)
+{
+  struct bmc_simulator_pkt *p;
+
+  while ((p = (struct bmc_simulator_pkt *)heap_peek (send_queue)))
+    {
+      if (timeval_gt (&(p->due), (struct timeval *)now))
+        break;
+
+      p = (struct bmc_simulator_pkt *)heap_pop (send_queue);
+      _sendto (p->bmc, &(p->to), p->pkt, p->pkt_len);
+      free (p);
+    }
+}
+
+static void
+_bmc_setup (struct bmc_simulator_bmc *bmc, unsigned int index)
+{
+  struct in_addr addr;
+  uint16_t port;
+
+  assert (bmc);
+
+  memset (bmc, '\0', sizeof (struct bmc_simulator_bmc));
+  bmc->index = index;
+
+  if (!inet_aton (cmd_args.address, &addr))
+    err_exit ("invalid address: %s", cmd_args.address);
+
+  /* each BMC listens on the next address, or the next port */
+  if (cmd_args.port_increment)
+    port = cmd_args.port + index;
+  else
+    {
+      port = cmd_args.port;
+      addr.s_addr = htonl (ntohl (addr.s_addr) + index);
+    }
+
+  bmc->addr.sin_family = AF_INET;
+  bmc->addr.sin_port = htons (port);
+  bmc->addr.sin_addr = addr;
+
+  snprintf (bmc->name,
+            INET_ADDRSTRLEN + 8,
+            "%s:%u",
+            inet_ntoa (addr),
+            port);
+
+  if ((bmc->fd = socket (AF_INET, SOCK_DGRAM, 0)) < 0)
+    err_exit ("socket: %s", strerror (errno));
+
+  if (bind (bmc->fd, (struct sockaddr *)&(bmc->addr), sizeof (struct sockaddr_in)) < 0)
+    err_exit ("%s: bind: %s", bmc->name, strerror (errno));
+
+  if (ipmi_get_random (bmc->guid, IPMI_MANAGED_SYSTEM_GUID_LENGTH) < 0)
+    err_exit ("ipmi_get_random: %s", strerror (errno));
+
+  bmc->power_state = script.power_state;
+  bmc->sel_entries_count = script.sel_entries_count;
+
+  if (!(bmc->sessions = (struct bmc_simulator_session *)calloc (cmd_args.max_sessions,
+                                                                sizeof (struct bmc_simulator_session))))
+    err_exit ("calloc: %s", strerror (errno));
+}
+
+static void
+_bmc_recv (struct bmc_simulator_bmc *bmc)
+{
+  uint8_t pkt[BMC_SIMULATOR_PKT_LEN];
+  struct sockaddr_in from;
+  socklen_t fromlen = sizeof (struct sockaddr_in);
+  ssize_t len;
+
+  assert (bmc);
+
+  if ((len = recvfrom (bmc->fd,
+                       pkt,
+                       BMC_SIMULATOR_PKT_LEN,
+                       0,
+                       (struct sockaddr *)&from,
+                       &fromlen)) < 0)
+    {
+      if (errno != EINTR && errno != EAGAIN)
+        bmc_simulator_debug (bmc, "recvfrom: %s", strerror (errno));
+      return;
+    }
+
+  bmc->packets_received++;
+
+  if (_drop ())
+    {
+      bmc->packets_dropped++;
+      return;
+    }
+
+  if (len <= BMC_SIMULATOR_RMCP_HDR_LEN)
+    return;
+
+  /* RMCP header (4), authentication type/format (1) */
+  if ((pkt[3] & BMC_SIMULATOR_RMCP_CLASS_MASK) == RMCP_HDR_MESSAGE_CLASS_ASF)
+    bmc_simulator_lan_ping (bmc, &from, pkt, len);
+  else if ((pkt[3] & BMC_SIMULATOR_RMCP_CLASS_MASK) == RMCP_HDR_MESSAGE_CLASS_IPMI)
+    {
+      if (pkt[BMC_SIMULATOR_RMCP_HDR_LEN] == IPMI_AUTHENTICATION_TYPE_RMCPPLUS)
+        bmc_simulator_rmcpplus_process (bmc, &from, pkt, len);
+      else
+        bmc_simulator_lan_process (bmc, &from, pkt, len);
+    }
+  else
+    bmc_simulator_debug (bmc, "unknown RMCP message class 0x%02X", pkt[3]);
+}
+
+static void
+_bmc_timers (struct bmc_simulator_bmc *bmc, const struct timeval *now)
+{
+  struct bmc_simulator_session *session;
+
+  assert (bmc);
+  assert (now);
+
+  bmc_simulator_session_timeout (bmc, now->tv_sec);
+
+  if ((session = bmc_simulator_session_sol (bmc)))
+    bmc_simulator_rmcpplus_sol (bmc, session, now);
+}
+
+static void
+_stats (void)
+{
+  unsigned int i;
+
+  for (i = 0; i < cmd_args.count; i++)
+    fprintf (stderr,
+             "%s: packets received %lu, sent %lu, dropped %lu, sessions activated %lu\n",
+             bmcs[i].name,
+             bmcs[i].packets_received,
+             bmcs[i].packets_sent,
+             bmcs[i].packets_dropped,
+             bmcs[i].sessions_activated);
+}
+
+static void
+_bmc_simulator (void)
+{
+  struct pollfd *pfds;
+  struct timeval now;
+  unsigned int i;
+  int timeout;
+
+  if (!(pfds = (struct pollfd *)calloc (cmd_args.count, sizeof (struct pollfd))))
+    err_exit ("calloc: %s", strerror (errno));
+
+  while (exit_flag)
+    {
+      int busy = 0;
+
+      for (i = 0; i < cmd_args.count; i++)
+        {
+          pfds[i].fd = bmcs[i].fd;
+          pfds[i].events = POLLIN;
+          pfds[i].revents = 0;
+          if (bmc_simulator_session_sol (&bmcs[i]))
+            busy++;
+        }
+
+      /* wake up more often when there are packets or SOL data
+       * waiting to go out
+       */
+      if (busy || !heap_is_empty (send_queue))
+        timeout = BMC_SIMULATOR_POLL_TIMEOUT_BUSY;
+      else
+        timeout = BMC_SIMULATOR_POLL_TIMEOUT;
+
+      if (poll (pfds, cmd_args.count, timeout) < 0)
+        {
+          if (errno != EINTR)
+            err_exit ("poll: %s", strerror (errno));
+          continue;
+        }
+
+      for (i = 0; i < cmd_args.count; i++)
+        {
+          if (pfds[i].revents & POLLIN)
+            _bmc_recv (&bmcs[i]);
+        }
+
+      gettimeofday (&now, NULL);
+
+      for (i = 0; i < cmd_args.count; i++)
+        _bmc_timers (&bmcs[i], &now);
+
+      _send_queue_flush (&now);
+    }
+
+  free (pfds);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct sigaction sa;
+  unsigned int i;
+
+  err_init (argv[0]);
+  err_set_flags (ERROR_STDERR);
+
+  bmc_simulator_argp_parse (argc, argv, &cmd_args);
+
+  bmc_simulator_script_load (cmd_args.script, &script);
+
+  srand (time (NULL) ^ getpid ());
+
+  bmc_simulator_lan_setup ();
+  bmc_simulator_rmcpplus_setup ();
+
+  if (!(send_queue = heap_create (BMC_SIMULATOR_SEND_QUEUE_SIZE, _pkt_cmp, (HeapDelF)free)))
+    err_exit ("heap_create: %s", strerror (errno));
+
+  if (!(bmcs = (struct bmc_simulator_bmc *)calloc (cmd_args.count, sizeof (struct bmc_simulator_bmc))))
+    err_exit ("calloc: %s", strerror (errno));
+
+  for (i = 0; i < cmd_args.count; i++)
+    _bmc_setup (&bmcs[i], i);
+
+  memset (&sa, '\0', sizeof (struct sigaction));
+  sa.sa_handler = _signal_handler_callback;
+  sigemptyset (&sa.sa_mask);
+  if (sigaction (SIGINT, &sa, NULL) < 0
+      || sigaction (SIGTERM, &sa, NULL) < 0)
+    err_exit ("sigaction: %s", strerror (errno));
+
+  fprintf (stderr,
+           "simulating %u BMC(s), first at %s\n",
+           cmd_args.count,
+           bmcs[0].name);
+
+  _bmc_simulator ();
+
+  _stats ();
+
+  for (i = 0; i < cmd_args.count; i++)
+    {
+      /* ignore potential error, cleanup path */
+      close (bmcs[i].fd);
+      free (bmcs[i].sessions);
+    }
+  free (bmcs);
+  heap_destroy (send_queue);
+  return (EXIT_SUCCESS);
+}
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BMC_SIMULATOR_H
+#define BMC_SIMULATOR_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdint.h>
+#if TIME_WITH_SYS_TIME
+#include <sys/time.h>
+#include <time.h>
+#else /* !TIME_WITH_SYS_TIME */
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else /* !HAVE_SYS_TIME_H */
+#include <time.h>
+#endif /* !HAVE_SYS_TIME_H */
+#endif /* !TIME_WITH_SYS_TIME */
+#include <netinet/in.h>
+
+#include <freeipmi/freeipmi.h>
+
+#define BMC_SIMULATOR_ADDRESS_DEFAULT          "127.0.1.1"
+
+#define BMC_SIMULATOR_PORT_DEFAULT             RMCP_PRIMARY_RMCP_PORT
+
+#define BMC_SIMULATOR_COUNT_DEFAULT            1
+
+#define BMC_SIMULATOR_SESSION_TIMEOUT_DEFAULT  60
+
+#define BMC_SIMULATOR_MAX_SESSIONS_DEFAULT     32
+
+#define BMC_SIMULATOR_PKT_LEN                  4096
+
+#define BMC_SIMULATOR_MAX_SENSORS              255
+
+#define BMC_SIMULATOR_MAX_SEL_ENTRIES          1024
+
+#define BMC_SIMULATOR_MAX_RESPONSES            256
+
+#define BMC_SIMULATOR_RESPONSE_DATA_MAX        64
+
+#define BMC_SIMULATOR_SENSOR_NAME_MAX          16
+
+#define BMC_SIMULATOR_SDR_RECORD_LENGTH_MAX    64
+
+#define BMC_SIMULATOR_SOL_BUFLEN               1024
+
+#define BMC_SIMULATOR_SOL_PAYLOAD_SIZE         200
+
+#define BMC_SIMULATOR_MAX_KEY_LENGTH           64
+
+enum bmc_simulator_argp_option_keys
+  {
+    BMC_SIMULATOR_ADDRESS_KEY = 'a',
+    BMC_SIMULATOR_COUNT_KEY = 'n',
+    BMC_SIMULATOR_USERNAME_KEY = 'u',
+    BMC_SIMULATOR_PASSWORD_KEY = 'p',
+    BMC_SIMULATOR_K_G_KEY = 'k',
+    BMC_SIMULATOR_PRIVILEGE_LEVEL_KEY = 'l',
+    BMC_SIMULATOR_SCRIPT_KEY = 's',
+    BMC_SIMULATOR_DEBUG_KEY = 'd',
+    BMC_SIMULATOR_PORT_KEY = 160,
+    BMC_SIMULATOR_PORT_INCREMENT_KEY = 161,
+    BMC_SIMULATOR_LATENCY_KEY = 162,
+    BMC_SIMULATOR_JITTER_KEY = 163,
+    BMC_SIMULATOR_LOSS_KEY = 164,
+    BMC_SIMULATOR_SESSION_TIMEOUT_KEY = 165,
+    BMC_SIMULATOR_MAX_SESSIONS_KEY = 166,
+  };
+
+struct bmc_simulator_arguments
+{
+  char *address;
+  uint16_t port;
+  unsigned int count;
+  int port_increment;
+  char *username;
+  char *password;
+  uint8_t k_g[IPMI_MAX_K_G_LENGTH + 1];
+  unsigned int k_g_len;
+  uint8_t privilege_level;
+  char *script;
+  unsigned int latency;
+  unsigned int jitter;
+  unsigned int loss;
+  unsigned int session_timeout;
+  unsigned int max_sessions;
+  int debug;
+};
+
+/* Threshold based sensors only.  Readings and thresholds are stored
+ * raw, the SDR record carries the M and R exponent to convert them.
+ */
+struct bmc_simulator_sensor
+{
+  uint8_t sensor_number;
+  char name[BMC_SIMULATOR_SENSOR_NAME_MAX + 1];
+  uint8_t sensor_type;
+  uint8_t sensor_base_unit;
+  int m;
+  int r_exponent;
+  uint8_t reading;
+  int thresholds;
+  uint8_t lower_critical;
+  uint8_t upper_critical;
+};
+
+struct bmc_simulator_sel_entry
+{
+  uint8_t sensor_type;
+  uint8_t sensor_number;
+  uint8_t event_type_code;
+  uint8_t event_dir;
+  uint8_t event_data1;
+  uint8_t event_data2;
+  uint8_t event_data3;
+};
+
+/* Canned response data, completion code first, for a netfn/cmd */
+struct bmc_simulator_response
+{
+  uint8_t net_fn;
+  uint8_t cmd;
+  uint8_t data[BMC_SIMULATOR_RESPONSE_DATA_MAX];
+  unsigned int data_len;
+};
+
+/* What the simulated BMCs report.  Loaded once and shared read-only
+ * by all virtual BMCs.
+ */
+struct bmc_simulator_script
+{
+  struct bmc_simulator_sensor sensors[BMC_SIMULATOR_MAX_SENSORS];
+  unsigned int sensors_count;
+  uint8_t sdr[BMC_SIMULATOR_MAX_SENSORS][BMC_SIMULATOR_SDR_RECORD_LENGTH_MAX];
+  unsigned int sdr_len[BMC_SIMULATOR_MAX_SENSORS];
+  struct bmc_simulator_sel_entry sel_entries[BMC_SIMULATOR_MAX_SEL_ENTRIES];
+  unsigned int sel_entries_count;
+  struct bmc_simulator_response responses[BMC_SIMULATOR_MAX_RESPONSES];
+  unsigned int responses_count;
+  char sol_banner[BMC_SIMULATOR_SOL_BUFLEN];
+  int power_state;
+  time_t start_time;
+  /* stable across restarts, so SDR caches remain valid */
+  time_t sdr_timestamp;
+};
+
+#define BMC_SIMULATOR_SESSION_STATE_FREE           0
+#define BMC_SIMULATOR_SESSION_STATE_CHALLENGE      1
+#define BMC_SIMULATOR_SESSION_STATE_OPEN_SESSION   2
+#define BMC_SIMULATOR_SESSION_STATE_RAKP           3
+#define BMC_SIMULATOR_SESSION_STATE_ACTIVE         4
+
+/* IPMI 1.5 sessions go CHALLENGE -> ACTIVE, IPMI 2.0 sessions go
+ * OPEN_SESSION -> RAKP -> ACTIVE.
+ *
+ * The key pointers are what ipmi_calculate_rmcpplus_session_keys()
+ * returns, they point into the key buffers or at the password.
+ */
+struct bmc_simulator_session
+{
+  int state;
+  int rmcpplus;
+  struct sockaddr_in from;
+  time_t last_activity;
+  uint32_t session_id;
+  uint32_t remote_console_session_id;
+  uint32_t outbound_sequence_number;
+  uint8_t privilege_level;
+  uint8_t maximum_privilege_level;
+
+  /* IPMI 1.5 */
+  uint8_t authentication_type;
+  uint8_t challenge_string[IPMI_CHALLENGE_STRING_LENGTH];
+
+  /* IPMI 2.0 */
+  uint8_t authentication_algorithm;
+  uint8_t integrity_algorithm;
+  uint8_t confidentiality_algorithm;
+  uint8_t remote_console_random_number[IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH];
+  uint8_t managed_system_random_number[IPMI_MANAGED_SYSTEM_RANDOM_NUMBER_LENGTH];
+  uint8_t name_only_lookup;
+  uint8_t requested_maximum_privilege_level;
+  char user_name[IPMI_MAX_USER_NAME_LENGTH + 1];
+  unsigned int user_name_len;
+  uint8_t sik_key[BMC_SIMULATOR_MAX_KEY_LENGTH];
+  void *sik_key_ptr;
+  unsigned int sik_key_len;
+  uint8_t integrity_key[BMC_SIMULATOR_MAX_KEY_LENGTH];
+  void *integrity_key_ptr;
+  unsigned int integrity_key_len;
+  uint8_t confidentiality_key[BMC_SIMULATOR_MAX_KEY_LENGTH];
+  void *confidentiality_key_ptr;
+  unsigned int confidentiality_key_len;
+
+  /* SOL, characters not yet sent and the one packet awaiting an ack */
+  int sol_activated;
+  uint8_t sol_sequence_number;
+  uint8_t sol_inbound_sequence_number;
+  char sol_output[BMC_SIMULATOR_SOL_BUFLEN];
+  unsigned int sol_output_len;
+  char sol_unacked[BMC_SIMULATOR_SOL_PAYLOAD_SIZE];
+  unsigned int sol_unacked_len;
+  struct timeval sol_sent;
+  unsigned int sol_retransmits;
+};
+
+struct bmc_simulator_bmc
+{
+  unsigned int index;
+  int fd;
+  struct sockaddr_in addr;
+  char name[INET_ADDRSTRLEN + 8];
+  uint8_t guid[IPMI_MANAGED_SYSTEM_GUID_LENGTH];
+  int power_state;
+  unsigned int sel_entries_count;
+  time_t sel_erase_timestamp;
+  uint16_t sdr_reservation_id;
+  uint16_t sel_reservation_id;
+  struct bmc_simulator_session *sessions;
+
+  unsigned long packets_received;
+  unsigned long packets_sent;
+  unsigned long packets_dropped;
+  unsigned long sessions_activated;
+};
+
+extern struct bmc_simulator_arguments cmd_args;
+
+extern struct bmc_simulator_script script;
+
+/* queues pkt to be sent after the configured latency, or drops it
+ * per the configured loss
+ */
+void bmc_simulator_send (struct bmc_simulator_bmc *bmc,
+                         const struct sockaddr_in *to,
+                         const void *pkt,
+                         unsigned int pkt_len);
+
+void bmc_simulator_debug (struct bmc_simulator_bmc *bmc, const char *fmt, ...);
+
+#endif /* BMC_SIMULATOR_H */
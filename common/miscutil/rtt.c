@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <assert.h>
+
+#include "rtt.h"
+#include "timeval.h"
+
+#define RTT_MICROSECONDS_IN_SECOND      1000000
+#define RTT_MICROSECONDS_IN_MILLISECOND 1000
+
+/* Cap a single sample, so one very late response can't blow up the
+ * estimate (or overflow it).
+ */
+#define RTT_SAMPLE_MAX                  (60 * RTT_MICROSECONDS_IN_SECOND)
+
+void
+rtt_init (struct rtt *r, unsigned int timeout)
+{
+  assert (r);
+  assert (timeout);
+
+  memset (r, '\0', sizeof (struct rtt));
+  r->timeout = timeout;
+  r->timeout_min = timeout < RTT_TIMEOUT_MIN ? timeout : RTT_TIMEOUT_MIN;
+  r->timeout_max = timeout * RTT_TIMEOUT_MAX_MULTIPLIER;
+}
+
+void
+rtt_sample (struct rtt *r, struct timeval *sent, struct timeval *received)
+{
+  struct timeval delta;
+  unsigned int sample;
+  unsigned int err;
+
+  assert (r);
+  assert (r->timeout);
+  assert (sent);
+  assert (received);
+
+  /* clock went backwards */
+  if (timeval_lt (received, sent))
+    return;
+
+  timeval_sub (received, sent, &delta);
+
+  if (delta.tv_sec >= RTT_SAMPLE_MAX / RTT_MICROSECONDS_IN_SECOND)
+    sample = RTT_SAMPLE_MAX;
+  else
+    sample = delta.tv_sec * RTT_MICROSECONDS_IN_SECOND + delta.tv_usec;
+
+  if (!r->samples)
+    {
+      r->srtt = sample;
+      r->rttvar = sample / 2;
+    }
+  else
+    {
+      /* rttvar = 3/4 rttvar + 1/4 |srtt - sample|
+       * srtt = 7/8 srtt + 1/8 sample
+       */
+      err = r->srtt > sample ? r->srtt - sample : sample - r->srtt;
+      r->rttvar = r->rttvar - (r->rttvar >> 2) + (err >> 2);
+      r->srtt = r->srtt - (r->srtt >> 3) + (sample >> 3);
+    }
+
+  r->samples++;
+}
+
+unsigned int
+rtt_timeout (struct rtt *r)
+{
+  unsigned int timeout;
+
+  assert (r);
+  assert (r->timeout);
+
+  if (!r->samples)
+    return (r->timeout);
+
+  /* round up, a timeout of 0 would mean retransmit immediately */
+  timeout = (r->srtt + 4 * r->rttvar + RTT_MICROSECONDS_IN_MILLISECOND - 1) / RTT_MICROSECONDS_IN_MILLISECOND;
+
+  if (timeout < r->timeout_min)
+    timeout = r->timeout_min;
+  if (timeout > r->timeout_max)
+    timeout = r->timeout_max;
+
+  return (timeout);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Adaptive retransmission timeout
+ *
+ * Smoothed round trip time and round trip time variation are
+ * estimated from responses as in Jacobson/Karels (see RFC 6298), and
+ * the retransmission timeout is the smoothed round trip time plus
+ * four times its variation.  Until the first sample, the
+ * retransmission timeout is the configured one.
+ *
+ * Callers must only sample responses to requests that were not
+ * retransmitted (Karn's algorithm), otherwise a response cannot be
+ * matched to the transmission it answers.
+ */
+
+#ifndef RTT_H
+#define RTT_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#if TIME_WITH_SYS_TIME
+#include <sys/time.h>
+#include <time.h>
+#else  /* !TIME_WITH_SYS_TIME */
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else /* !HAVE_SYS_TIME_H */
+#include <time.h>
+#endif  /* !HAVE_SYS_TIME_H */
+#endif /* !TIME_WITH_SYS_TIME */
+
+/* The adaptive timeout is never below RTT_TIMEOUT_MIN milliseconds
+ * (or the configured timeout if it is smaller), to leave room for
+ * BMCs that are occasionally slow to process a request, and never
+ * above RTT_TIMEOUT_MAX_MULTIPLIER times the configured timeout.
+ */
+#define RTT_TIMEOUT_MIN            100
+#define RTT_TIMEOUT_MAX_MULTIPLIER 4
+
+struct rtt
+{
+  unsigned int srtt;            /* microseconds */
+  unsigned int rttvar;          /* microseconds */
+  unsigned int samples;
+  unsigned int timeout;         /* configured timeout, milliseconds */
+  unsigned int timeout_min;     /* milliseconds */
+  unsigned int timeout_max;     /* milliseconds */
+};
+
+/* Initialize with the configured retransmission timeout in milliseconds */
+void rtt_init (struct rtt *r, unsigned int timeout);
+
+/* Add a round trip time sample, a request sent at sent and answered
+ * at received.
+ */
+void rtt_sample (struct rtt *r, struct timeval *sent, struct timeval *received);
+
+/* Returns the current retransmission timeout in milliseconds */
+unsigned int rtt_timeout (struct rtt *r);
+
+#endif /* RTT_H */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "session-broker.h"
+#include "fd.h"
+
+int
+session_broker_send (int fd, uint32_t type, const void *buf, unsigned int buflen)
+{
+  struct session_broker_hdr hdr;
+
+  assert (fd >= 0);
+  assert (buf || !buflen);
+
+  hdr.version = SESSION_BROKER_PROTOCOL_VERSION;
+  hdr.type = type;
+  hdr.len = buflen;
+
+  if (fd_write_n (fd, &hdr, sizeof (hdr)) < 0)
+    return (-1);
+
+  if (buflen && fd_write_n (fd, (void *)buf, buflen) < 0)
+    return (-1);
+
+  return (0);
+}
+
+int
+session_broker_recv (int fd, uint32_t *type, void *buf, unsigned int buflen)
+{
+  struct session_broker_hdr hdr;
+  ssize_t n;
+
+  assert (fd >= 0);
+  assert (type);
+  assert (buf);
+
+  if ((n = fd_read_n (fd, &hdr, sizeof (hdr))) < 0)
+    return (-1);
+
+  if (!n)
+    return (0);
+
+  if (n != sizeof (hdr)
+      || hdr.version != SESSION_BROKER_PROTOCOL_VERSION
+      || !hdr.len
+      || hdr.len > buflen)
+    {
+      errno = EPROTO;
+      return (-1);
+    }
+
+  if ((n = fd_read_n (fd, buf, hdr.len)) < 0)
+    return (-1);
+
+  if (n != hdr.len)
+    {
+      errno = EPROTO;
+      return (-1);
+    }
+
+  (*type) = hdr.type;
+  return (hdr.len);
+}
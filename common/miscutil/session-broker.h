@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Wire protocol between libfreeipmi and ipmisessiond(8)
+ *
+ * A client connects to the broker's Unix domain socket and sends an
+ * open request holding the same parameters it would pass to
+ * ipmi_ctx_open_outofband_2_0().  The broker attaches the client to
+ * its IPMI 2.0 session with that BMC, establishing one if necessary,
+ * and answers with an open response.  Thereafter, each command
+ * request is answered by exactly one command response.
+ *
+ * Every message is a struct session_broker_hdr followed by len bytes
+ * of message payload.  Both ends always run on the same machine, so
+ * the payloads are sent in host byte order as is.
+ */
+
+#ifndef SESSION_BROKER_H
+#define SESSION_BROKER_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdint.h>
+
+#define SESSION_BROKER_PROTOCOL_VERSION 1
+
+#define SESSION_BROKER_MSG_OPEN_RQ      1
+#define SESSION_BROKER_MSG_OPEN_RS      2
+#define SESSION_BROKER_MSG_CMD_RQ       3
+#define SESSION_BROKER_MSG_CMD_RS       4
+
+/* large enough for any hostname, username, password and K_g accepted
+ * by ipmi_ctx_open_outofband_2_0()
+ */
+#define SESSION_BROKER_HOSTNAME_MAX     1024
+#define SESSION_BROKER_USERNAME_MAX     32
+#define SESSION_BROKER_PASSWORD_MAX     32
+#define SESSION_BROKER_K_G_MAX          32
+
+#define SESSION_BROKER_BUFLEN           4096
+
+struct session_broker_hdr
+{
+  uint32_t version;
+  uint32_t type;
+  uint32_t len;
+};
+
+struct session_broker_open_rq
+{
+  char hostname[SESSION_BROKER_HOSTNAME_MAX+1];
+  char username[SESSION_BROKER_USERNAME_MAX+1];
+  char password[SESSION_BROKER_PASSWORD_MAX+1];
+  uint8_t k_g[SESSION_BROKER_K_G_MAX];
+  uint32_t k_g_len;
+  uint32_t privilege_level;
+  uint32_t cipher_suite_id;
+  uint32_t session_timeout;
+  uint32_t retransmission_timeout;
+  uint32_t workaround_flags;
+  uint32_t flags;
+};
+
+struct session_broker_open_rs
+{
+  int32_t errnum;
+};
+
+/* if ipmb is set, the command is bridged to channel_number/rs_addr */
+struct session_broker_cmd_rq
+{
+  uint8_t lun;
+  uint8_t net_fn;
+  uint8_t ipmb;
+  uint8_t channel_number;
+  uint8_t rs_addr;
+  uint32_t buf_rs_len;
+  uint32_t buf_rq_len;
+  uint8_t buf_rq[SESSION_BROKER_BUFLEN];
+};
+
+/* rv is the ipmi_cmd_raw() return value, errnum is only valid if rv < 0 */
+struct session_broker_cmd_rs
+{
+  int32_t errnum;
+  int32_t rv;
+  uint8_t buf_rs[SESSION_BROKER_BUFLEN];
+};
+
+/* Returns 0 on success, -1 on error */
+int session_broker_send (int fd, uint32_t type, const void *buf, unsigned int buflen);
+
+/* Receive a message of at most buflen bytes into buf.
+ *
+ * Returns message length on success, 0 if the peer closed the
+ * connection, -1 on error.  errno is set to EPROTO if the peer sent a
+ * malformed message.
+ */
+int session_broker_recv (int fd, uint32_t *type, void *buf, unsigned int buflen);
+
+#endif /* SESSION_BROKER_H */
@@ -51,6 +51,7 @@
 #include "pstdout.h"
 #include "cbuf.h"
 #include "fi_hostlist.h"
+#include "hash.h"
 #include "list.h"
 
 /* max hostrange size is typically 16 bytes
@@ -75,20 +76,23 @@ static char * pstdout_errmsg[] =
 static uint32_t pstdout_debug_flags = PSTDOUT_DEBUG_NONE;
 static uint32_t pstdout_output_flags = PSTDOUT_OUTPUT_STDOUT_DEFAULT | PSTDOUT_OUTPUT_STDERR_DEFAULT;
 static unsigned int pstdout_fanout = PSTDOUT_FANOUT_DEFAULT;
-
-static pthread_mutex_t pstdout_threadcount_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t pstdout_threadcount_cond = PTHREAD_COND_INITIALIZER;
-static int pstdout_threadcount = 0;
+static size_t pstdout_stacksize = PSTDOUT_STACKSIZE_DEFAULT;
 
 struct pstdout_thread_data {
   char *hostname;
-  pthread_t tid;
-  pthread_attr_t attr;
   int exit_code;
   Pstdout_Thread pstdout_func;
   void *arg;
 };
 
+/* A fixed pool of at most 'fanout' worker threads is launched, each
+ * taking the next host off the queue when it finishes with the last.
+ */
+static pthread_mutex_t pstdout_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pstdout_thread_data **pstdout_queue = NULL;
+static int pstdout_queue_count = 0;
+static int pstdout_queue_next = 0;
+
 struct pstdout_state {
   uint32_t magic;
   char *hostname;
@@ -111,6 +115,22 @@ int pstdout_errnum = PSTDOUT_ERR_SUCCESS;
 struct pstdout_consolidated_data {
   fi_hostlist_t h;
   char *output;
+  unsigned int output_len;
+  unsigned int hashval;
+  struct pstdout_consolidated_data *next;
+};
+
+/* Consolidated outputs are looked up by a hash of their content, so
+ * outputs are only compared when their hashes match.  Each bucket
+ * has its own lock, so threads with different output do not contend
+ * with each other.  The lists keep the outputs in the order first
+ * seen and are only locked when a new output is added.
+ */
+#define PSTDOUT_CONSOLIDATED_HASH_SIZE 1024
+
+struct pstdout_consolidated_bucket {
+  struct pstdout_consolidated_data *cdata;
+  pthread_mutex_t mutex;
 };
 
 static List pstdout_consolidated_stdout = NULL;
@@ -119,6 +139,9 @@ static List pstdout_consolidated_stderr = NULL;
 static pthread_mutex_t pstdout_consolidated_stdout_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t pstdout_consolidated_stderr_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+static struct pstdout_consolidated_bucket pstdout_consolidated_stdout_hash[PSTDOUT_CONSOLIDATED_HASH_SIZE];
+static struct pstdout_consolidated_bucket pstdout_consolidated_stderr_hash[PSTDOUT_CONSOLIDATED_HASH_SIZE];
+
 static int pstdout_initialized = 0;
 
 static pthread_mutex_t pstdout_launch_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -131,7 +154,10 @@ typedef void (*sighandler_t)(int);
 #endif /* HAVE_SIGHANDLER_T */
 
 static struct pstdout_consolidated_data *
-_pstdout_consolidated_data_create(const char *hostname, const char *output)
+_pstdout_consolidated_data_create(const char *hostname,
+                                  const char *output,
+                                  unsigned int output_len,
+                                  unsigned int hashval)
 {
   struct pstdout_consolidated_data *cdata = NULL;
 
@@ -145,6 +171,9 @@ _pstdout_consolidated_data_create(const char *hostname, const char *output)
     }
   cdata->h = NULL;
   cdata->output = NULL;
+  cdata->output_len = output_len;
+  cdata->hashval = hashval;
+  cdata->next = NULL;
 
   if (!(cdata->h = fi_hostlist_create(hostname)))
     {
@@ -152,11 +181,13 @@ _pstdout_consolidated_data_create(const char *hostname, const char *output)
       goto cleanup;
     }
 
-  if (!(cdata->output = strdup(output)))
+  /* output_len includes the '\0' */
+  if (!(cdata->output = (char *)malloc(output_len)))
     {
       pstdout_errnum = PSTDOUT_ERR_OUTMEM;
       goto cleanup;
     }
+  memcpy(cdata->output, output, output_len);
 
   return cdata;
 
@@ -211,23 +242,6 @@ _pstdout_consolidated_data_compare(void *x, void *y)
   return 0;
 }
 
-static int
-_pstdout_consolidated_data_find(void *x, void *key)
-{
-  struct pstdout_consolidated_data *cdata;
-
-  assert(x);
-  assert(key);
-
-  cdata = (struct pstdout_consolidated_data *)x;
-
-  assert(cdata->output);
-
-  if (!strcmp(cdata->output, (char *)key))
-    return 1;
-  return 0;
-}
-
 static int
 _pstdout_consolidated_data_delete_all(void *x, void *key)
 {
@@ -242,6 +256,41 @@ _pstdout_states_delete_pointer(void *x, void *key)
   return 0;
 }
 
+static int
+_pstdout_consolidated_hash_init(struct pstdout_consolidated_bucket *whichconsolidatedhash)
+{
+  int rc;
+  int i;
+
+  assert(whichconsolidatedhash);
+
+  for (i = 0; i < PSTDOUT_CONSOLIDATED_HASH_SIZE; i++)
+    {
+      whichconsolidatedhash[i].cdata = NULL;
+      if ((rc = pthread_mutex_init(&(whichconsolidatedhash[i].mutex), NULL)))
+        {
+          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+            fprintf(stderr, "pthread_mutex_init: %s\n", strerror(rc));
+          pstdout_errnum = PSTDOUT_ERR_INTERNAL;
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+/* Consolidated data is owned by the list, only forget it here */
+static void
+_pstdout_consolidated_hash_clear(struct pstdout_consolidated_bucket *whichconsolidatedhash)
+{
+  int i;
+
+  assert(whichconsolidatedhash);
+
+  for (i = 0; i < PSTDOUT_CONSOLIDATED_HASH_SIZE; i++)
+    whichconsolidatedhash[i].cdata = NULL;
+}
+
 int
 pstdout_init(void)
 {
@@ -262,6 +311,10 @@ pstdout_init(void)
           pstdout_errnum = PSTDOUT_ERR_OUTMEM;
           goto cleanup;
         }
+      if (_pstdout_consolidated_hash_init(pstdout_consolidated_stdout_hash) < 0)
+        goto cleanup;
+      if (_pstdout_consolidated_hash_init(pstdout_consolidated_stderr_hash) < 0)
+        goto cleanup;
       pstdout_initialized++;
     }
 
@@ -447,6 +500,47 @@ pstdout_get_fanout(void)
   return pstdout_fanout;
 }
 
+int
+pstdout_set_stacksize(size_t stacksize)
+{
+  int rc, rv = -1;
+
+  if (stacksize && stacksize < PSTDOUT_STACKSIZE_MIN)
+    {
+      pstdout_errnum = PSTDOUT_ERR_PARAMETERS;
+      return -1;
+    }
+
+  if ((rc = pthread_mutex_lock(&pstdout_launch_mutex)))
+    {
+      if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+        fprintf(stderr, "pthread_mutex_lock: %s\n", strerror(rc));
+      pstdout_errnum = PSTDOUT_ERR_INTERNAL;
+      return -1;
+    }
+
+  pstdout_stacksize = stacksize;
+
+  pstdout_errnum = PSTDOUT_ERR_SUCCESS;
+  rv = 0;
+
+  if ((rc = pthread_mutex_unlock(&pstdout_launch_mutex)))
+    {
+      if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+        fprintf(stderr, "pthread_mutex_unlock: %s\n", strerror(rc));
+      /* Don't change error code, just move on */
+    }
+
+  return rv;
+}
+
+size_t
+pstdout_get_stacksize(void)
+{
+  pstdout_errnum = PSTDOUT_ERR_SUCCESS;
+  return pstdout_stacksize;
+}
+
 int
 pstdout_hostnames_count(const char *hostnames)
 {
@@ -907,6 +1001,103 @@ _pstdout_state_init(pstdout_state_t pstate, const char *hostname)
   return 0;
 }
 
+static int
+_pstdout_consolidated_add(List whichconsolidatedlist,
+                          pthread_mutex_t *whichconsolidatedmutex,
+                          struct pstdout_consolidated_bucket *whichconsolidatedhash,
+                          const char *hostname,
+                          const char *output,
+                          unsigned int output_len)
+{
+  struct pstdout_consolidated_bucket *bucket;
+  struct pstdout_consolidated_data *cdata;
+  unsigned int hashval;
+  int rc, rv = -1;
+
+  assert(whichconsolidatedlist);
+  assert(whichconsolidatedmutex);
+  assert(whichconsolidatedhash);
+  assert(hostname);
+  assert(output);
+
+  /* Hash outside of any lock */
+  hashval = hash_key_string(output);
+  bucket = &whichconsolidatedhash[hashval % PSTDOUT_CONSOLIDATED_HASH_SIZE];
+
+  if ((rc = pthread_mutex_lock(&(bucket->mutex))))
+    {
+      if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+        fprintf(stderr, "pthread_mutex_lock: %s\n", strerror(rc));
+      pstdout_errnum = PSTDOUT_ERR_INTERNAL;
+      return -1;
+    }
+
+  cdata = bucket->cdata;
+  while (cdata)
+    {
+      if (cdata->hashval == hashval
+          && cdata->output_len == output_len
+          && !memcmp(cdata->output, output, output_len))
+        break;
+      cdata = cdata->next;
+    }
+
+  if (!cdata)
+    {
+      if (!(cdata = _pstdout_consolidated_data_create(hostname, output, output_len, hashval)))
+        goto cleanup;
+
+      if ((rc = pthread_mutex_lock(whichconsolidatedmutex)))
+        {
+          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+            fprintf(stderr, "pthread_mutex_lock: %s\n", strerror(rc));
+          pstdout_errnum = PSTDOUT_ERR_INTERNAL;
+          _pstdout_consolidated_data_destroy(cdata);
+          goto cleanup;
+        }
+
+      if (!list_append(whichconsolidatedlist, cdata))
+        {
+          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+            fprintf(stderr, "list_append: %s\n", strerror(errno));
+          pstdout_errnum = PSTDOUT_ERR_INTERNAL;
+          pthread_mutex_unlock(whichconsolidatedmutex);
+          _pstdout_consolidated_data_destroy(cdata);
+          goto cleanup;
+        }
+
+      if ((rc = pthread_mutex_unlock(whichconsolidatedmutex)))
+        {
+          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+            fprintf(stderr, "pthread_mutex_unlock: %s\n", strerror(rc));
+          /* Don't change error code, just move on */
+        }
+
+      cdata->next = bucket->cdata;
+      bucket->cdata = cdata;
+    }
+  else
+    {
+      if (!fi_hostlist_push(cdata->h, hostname))
+        {
+          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+            fprintf(stderr, "fi_hostlist_push: %s\n", strerror(errno));
+          pstdout_errnum = PSTDOUT_ERR_INTERNAL;
+          goto cleanup;
+        }
+    }
+
+  rv = 0;
+ cleanup:
+  if ((rc = pthread_mutex_unlock(&(bucket->mutex))))
+    {
+      if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+        fprintf(stderr, "pthread_mutex_unlock: %s\n", strerror(rc));
+      /* Don't change error code, just move on */
+    }
+  return rv;
+}
+
 static int
 _pstdout_output_buffer_data(pstdout_state_t pstate,
                             FILE *stream,
@@ -916,7 +1107,8 @@ _pstdout_output_buffer_data(pstdout_state_t pstate,
                             uint32_t whichbuffermask,
                             uint32_t whichconsolidatemask,
                             List whichconsolidatedlist,
-                            pthread_mutex_t *whichconsolidatedmutex)
+                            pthread_mutex_t *whichconsolidatedmutex,
+                            struct pstdout_consolidated_bucket *whichconsolidatedhash)
 {
   assert(pstate);
   assert(pstate->magic == PSTDOUT_STATE_MAGIC);
@@ -934,6 +1126,7 @@ _pstdout_output_buffer_data(pstdout_state_t pstate,
          || whichconsolidatemask == PSTDOUT_OUTPUT_STDERR_CONSOLIDATE);
   assert(whichconsolidatedlist);
   assert(whichconsolidatedmutex);
+  assert(whichconsolidatedhash);
 
   if ((*whichbuffer && *whichbufferlen)
       && (pstdout_output_flags & whichbuffermask
@@ -962,50 +1155,13 @@ _pstdout_output_buffer_data(pstdout_state_t pstate,
         }
       else
         {
-          struct pstdout_consolidated_data *cdata;
-          int rc;
-
-          if ((rc = pthread_mutex_lock(whichconsolidatedmutex)))
-            {
-              if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-                fprintf(stderr, "pthread_mutex_lock: %s\n", strerror(rc));
-              pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-              goto cleanup;
-            }
-
-          if (!(cdata = list_find_first(whichconsolidatedlist, _pstdout_consolidated_data_find, *whichbuffer)))
-            {
-              if (!(cdata = _pstdout_consolidated_data_create(pstate->hostname, *whichbuffer)))
-                goto cleanup;
-
-              if (!list_append(whichconsolidatedlist, cdata))
-                {
-                  if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-                    fprintf(stderr, "list_append: %s\n", strerror(errno));
-                  pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-                  _pstdout_consolidated_data_destroy(cdata);
-                  goto cleanup;
-                }
-            }
-          else
-            {
-              if (!fi_hostlist_push(cdata->h, pstate->hostname))
-                {
-                  if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-                    fprintf(stderr, "fi_hostlist_push: %s\n", strerror(errno));
-                  pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-                  goto cleanup;
-                }
-            }
-
-          if ((rc = pthread_mutex_unlock(whichconsolidatedmutex)))
-            {
-              if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-                fprintf(stderr, "pthread_mutex_unlock: %s\n", strerror(rc));
-              pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-              goto cleanup;
-            }
-
+          if (_pstdout_consolidated_add(whichconsolidatedlist,
+                                        whichconsolidatedmutex,
+                                        whichconsolidatedhash,
+                                        pstate->hostname,
+                                        *whichbuffer,
+                                        *whichbufferlen) < 0)
+            goto cleanup;
         }
     }
 
@@ -1052,7 +1208,8 @@ _pstdout_output_finish(pstdout_state_t pstate)
                                   PSTDOUT_OUTPUT_BUFFER_STDOUT,
                                   PSTDOUT_OUTPUT_STDOUT_CONSOLIDATE,
                                   pstdout_consolidated_stdout,
-                                  &pstdout_consolidated_stdout_mutex) < 0)
+                                  &pstdout_consolidated_stdout_mutex,
+                                  pstdout_consolidated_stdout_hash) < 0)
     goto cleanup;
 
   if (_pstdout_output_buffer_data(pstate,
@@ -1063,7 +1220,8 @@ _pstdout_output_finish(pstdout_state_t pstate)
                                   PSTDOUT_OUTPUT_BUFFER_STDERR,
                                   PSTDOUT_OUTPUT_STDERR_CONSOLIDATE,
                                   pstdout_consolidated_stderr,
-                                  &pstdout_consolidated_stderr_mutex) < 0)
+                                  &pstdout_consolidated_stderr_mutex,
+                                  pstdout_consolidated_stderr_hash) < 0)
     goto cleanup;
 
   /* Only output from internal to pstdout is allowed */
@@ -1098,14 +1256,13 @@ _pstdout_state_cleanup(pstdout_state_t pstate)
   memset(pstate, '\0', sizeof(struct pstdout_state));
 }
 
-static void *
-_pstdout_func_entry(void *arg)
+static void
+_pstdout_func_entry(struct pstdout_thread_data *tdata)
 {
-  struct pstdout_thread_data *tdata = NULL;
   struct pstdout_state pstate;
   int rc;
 
-  tdata = (struct pstdout_thread_data *)arg;
+  assert(tdata);
 
   if (_pstdout_state_init(&pstate, tdata->hostname) < 0)
     goto cleanup;
@@ -1145,10 +1302,43 @@ _pstdout_func_entry(void *arg)
   list_delete_all(pstdout_states, _pstdout_states_delete_pointer, &pstate);
   pthread_mutex_unlock(&pstdout_states_mutex);
   _pstdout_state_cleanup(&pstate);
-  pthread_mutex_lock(&pstdout_threadcount_mutex);
-  pstdout_threadcount--;
-  pthread_cond_signal(&pstdout_threadcount_cond);
-  pthread_mutex_unlock(&pstdout_threadcount_mutex);
+}
+
+static void *
+_pstdout_worker(void *arg)
+{
+  struct pstdout_thread_data *tdata;
+  int rc;
+
+  while (1)
+    {
+      if ((rc = pthread_mutex_lock(&pstdout_queue_mutex)))
+        {
+          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+            fprintf(stderr, "pthread_mutex_lock: %s\n", strerror(rc));
+          pstdout_errnum = PSTDOUT_ERR_INTERNAL;
+          break;
+        }
+
+      if (pstdout_queue_next >= pstdout_queue_count)
+        {
+          pthread_mutex_unlock(&pstdout_queue_mutex);
+          break;
+        }
+
+      tdata = pstdout_queue[pstdout_queue_next++];
+
+      if ((rc = pthread_mutex_unlock(&pstdout_queue_mutex)))
+        {
+          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+            fprintf(stderr, "pthread_mutex_unlock: %s\n", strerror(rc));
+          pstdout_errnum = PSTDOUT_ERR_INTERNAL;
+          break;
+        }
+
+      _pstdout_func_entry(tdata);
+    }
+
   return NULL;
 }
 
@@ -1329,6 +1519,12 @@ int
 pstdout_launch(const char *hostnames, Pstdout_Thread pstdout_func, void *arg)
 {
   struct pstdout_thread_data **tdata = NULL;
+  pthread_t *tids = NULL;
+  int tids_count = 0;
+  int join_errors = 0;
+  int threads;
+  pthread_attr_t attr;
+  int attr_init = 0;
   struct pstdout_state pstate;
   unsigned int pstate_init = 0;
   fi_hostlist_iterator_t hitr = NULL;
@@ -1441,22 +1637,6 @@ pstdout_launch(const char *hostnames, Pstdout_Thread pstdout_func, void *arg)
       tdata[i]->pstdout_func = pstdout_func;
       tdata[i]->arg = arg;
 
-      if ((rc = pthread_attr_init(&(tdata[i]->attr))))
-        {
-          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-            fprintf(stderr, "pthread_attr_init: %s\n", strerror(rc));
-          pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-          goto cleanup;
-        }
-
-      if ((rc = pthread_attr_setdetachstate(&(tdata[i]->attr), PTHREAD_CREATE_DETACHED)))
-        {
-          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-            fprintf(stderr, "pthread_attr_setdetachstate: %s\n", strerror(rc));
-          pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-          goto cleanup;
-        }
-
       free(host);
       i++;
     }
@@ -1468,70 +1648,70 @@ pstdout_launch(const char *hostnames, Pstdout_Thread pstdout_func, void *arg)
   fi_hostlist_destroy(h);
   h = NULL;
 
-  /* Launch threads up to fanout */
-  for (i = 0; i < h_count; i++)
+  threads = ((unsigned int)h_count < pstdout_fanout) ? h_count : (int)pstdout_fanout;
+
+  if (!(tids = (pthread_t *)malloc(sizeof(pthread_t) * threads)))
     {
-      if ((rc = pthread_mutex_lock(&pstdout_threadcount_mutex)))
-        {
-          if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-            fprintf(stderr, "pthread_mutex_lock: %s\n", strerror(rc));
-          pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-          goto cleanup;
-        }
+      pstdout_errnum = PSTDOUT_ERR_OUTMEM;
+      goto cleanup;
+    }
 
-      if (pstdout_threadcount == pstdout_fanout)
-        {
-          if ((rc = pthread_cond_wait(&pstdout_threadcount_cond, &pstdout_threadcount_mutex)))
-            {
-              if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-                fprintf(stderr, "pthread_cond_wait: %s\n", strerror(rc));
-              pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-              goto cleanup;
-            }
-        }
+  if ((rc = pthread_attr_init(&attr)))
+    {
+      if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
+        fprintf(stderr, "pthread_attr_init: %s\n", strerror(rc));
+      pstdout_errnum = PSTDOUT_ERR_INTERNAL;
+      goto cleanup;
+    }
+  attr_init++;
 
-      if ((rc = pthread_create(&(tdata[i]->tid),
-                               &(tdata[i]->attr),
-                               _pstdout_func_entry,
-                               (void *) tdata[i])))
+  if (pstdout_stacksize)
+    {
+      if ((rc = pthread_attr_setstacksize(&attr, pstdout_stacksize)))
         {
           if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-            fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+            fprintf(stderr, "pthread_attr_setstacksize: %s\n", strerror(rc));
           pstdout_errnum = PSTDOUT_ERR_INTERNAL;
           goto cleanup;
         }
+    }
 
-      pstdout_threadcount++;
+  /* No workers are running yet, so no need to lock */
+  pstdout_queue = tdata;
+  pstdout_queue_count = h_count;
+  pstdout_queue_next = 0;
 
-      if ((rc = pthread_mutex_unlock(&pstdout_threadcount_mutex)))
+  /* Launch worker threads up to fanout */
+  for (i = 0; i < threads; i++)
+    {
+      if ((rc = pthread_create(&tids[i],
+                               &attr,
+                               _pstdout_worker,
+                               NULL)))
         {
           if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-            fprintf(stderr, "pthread_mutex_unlock: %s\n", strerror(rc));
+            fprintf(stderr, "pthread_create: %s\n", strerror(rc));
           pstdout_errnum = PSTDOUT_ERR_INTERNAL;
           goto cleanup;
         }
+      tids_count++;
     }
 
   /* Wait for Threads to finish */
-
-  if ((rc = pthread_mutex_lock(&pstdout_threadcount_mutex)))
+  for (i = 0; i < tids_count; i++)
     {
-      if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-        fprintf(stderr, "pthread_mutex_lock: %s\n", strerror(rc));
-      pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-      goto cleanup;
-    }
-
-  while (pstdout_threadcount > 0)
-    {
-      if ((rc = pthread_cond_wait(&pstdout_threadcount_cond, &pstdout_threadcount_mutex)))
+      if ((rc = pthread_join(tids[i], NULL)))
         {
           if (pstdout_debug_flags & PSTDOUT_DEBUG_STANDARD)
-            fprintf(stderr, "pthread_cond_wait: %s\n", strerror(rc));
+            fprintf(stderr, "pthread_join: %s\n", strerror(rc));
           pstdout_errnum = PSTDOUT_ERR_INTERNAL;
-          goto cleanup;
+          join_errors++;
         }
     }
+  tids_count = 0;
+
+  if (join_errors)
+    goto cleanup;
 
   if (_pstdout_output_consolidated_finish() < 0)
     goto cleanup;
@@ -1545,6 +1725,24 @@ pstdout_launch(const char *hostnames, Pstdout_Thread pstdout_func, void *arg)
     }
 
  cleanup:
+  if (tids_count)
+    {
+      /* Let running hosts finish, but hand out no more */
+      pthread_mutex_lock(&pstdout_queue_mutex);
+      pstdout_queue_next = pstdout_queue_count;
+      pthread_mutex_unlock(&pstdout_queue_mutex);
+
+      for (i = 0; i < tids_count; i++)
+        pthread_join(tids[i], NULL);
+    }
+  pstdout_queue = NULL;
+  pstdout_queue_count = 0;
+  pstdout_queue_next = 0;
+  free(tids);
+  if (attr_init)
+    pthread_attr_destroy(&attr);
+  _pstdout_consolidated_hash_clear(pstdout_consolidated_stdout_hash);
+  _pstdout_consolidated_hash_clear(pstdout_consolidated_stderr_hash);
   /* Cannot pass NULL for key, so just pass dummy key */
   list_delete_all(pstdout_consolidated_stdout, _pstdout_consolidated_data_delete_all, "");
   list_delete_all(pstdout_consolidated_stderr, _pstdout_consolidated_data_delete_all, "");
@@ -1557,7 +1755,6 @@ pstdout_launch(const char *hostnames, Pstdout_Thread pstdout_func, void *arg)
           if (tdata[i])
             {
               free(tdata[i]->hostname);
-              pthread_attr_destroy(&(tdata[i]->attr));
               free(tdata[i]);
             }
         }
@@ -44,6 +44,7 @@
  * call pstdout_init()
  * call pstdout_set_output_flags() if non-defaults needed
  * call pstdout_set_fanout() if non-defaults needed
+ * call pstdout_set_stacksize() if non-defaults needed
  * call pstdout_lauch() to launch parallel threads
  * - within callback functions replace printf/fprintf/perror calls
  *   with pstdout equivalent calls.
@@ -116,7 +117,14 @@
  */
 #define PSTDOUT_FANOUT_DEFAULT    64
 #define PSTDOUT_FANOUT_MIN        1
-#define PSTDOUT_FANOUT_MAX        1024
+#define PSTDOUT_FANOUT_MAX        4096
+
+/*
+ * Thread stack size default and min, a stack size of 0 uses the
+ * system default.
+ */
+#define PSTDOUT_STACKSIZE_DEFAULT 0
+#define PSTDOUT_STACKSIZE_MIN     65536
 
 /* pstdout_errnum
  *
@@ -197,6 +205,22 @@ int pstdout_set_fanout(unsigned int fanout);
  */
 int pstdout_get_fanout(void);
 
+/* pstdout_set_stacksize
+ *
+ * Set the stack size of threads launched by 'pstdout_launch'.  The
+ * system default (often 8M) is reserved for each thread, which adds
+ * up with large fanouts.  Pass 0 to use the system default.
+ *
+ * Returns 0 on success, -1 on error
+ */
+int pstdout_set_stacksize(size_t stacksize);
+
+/* pstdout_get_stacksize
+ *
+ * Returns current stack size, 0 if the system default.
+ */
+size_t pstdout_get_stacksize(void);
+
 /* pstdout_hostnames_count
  *
  * Count the number of hosts specified by hostnames.  Primarily a
@@ -272,9 +296,10 @@ void pstdout_perror(pstdout_state_t pstate, const char *s);
 /* pstdout_launch
  *
  * Primary thread launching function of the library.  It will launch
- * no more than 'fanout' threads at the same time, launching new
- * threads after old ones have completed.  Will handle all standard output
- * buffering or consolidation that is required.
+ * a pool of no more than 'fanout' threads, each of which calls
+ * 'pstdout_func' for the next host after completing the last.  Will
+ * handle all standard output buffering or consolidation that is
+ * required.
  *
  * Returns: Largest exit code returned from all threads launched.
  */
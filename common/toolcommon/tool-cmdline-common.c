@@ -353,6 +353,22 @@ common_parse_opt (int key,
         }
       common_args->cipher_suite_id = tmp;
       break;
+    case ARGP_CAPABILITY_CACHE_DIRECTORY_KEY:
+      free (common_args->capability_cache_directory);
+      if (!(common_args->capability_cache_directory = strdup (arg)))
+        {
+          perror ("strdup");
+          exit (EXIT_FAILURE);
+        }
+      break;
+    case ARGP_SESSION_BROKER_KEY:
+      free (common_args->session_broker);
+      if (!(common_args->session_broker = strdup (arg)))
+        {
+          perror ("strdup");
+          exit (EXIT_FAILURE);
+        }
+      break;
     case ARGP_PRIVILEGE_LEVEL_KEY:
       if ((tmp = parse_privilege_level (arg)) < 0)
         {
@@ -508,6 +524,8 @@ _init_common_cmd_args (struct common_cmd_args *common_args)
   common_args->authentication_type = IPMI_AUTHENTICATION_TYPE_MD5;
   common_args->cipher_suite_id = 3;
   /* privilege_level set by parent function */
+  common_args->capability_cache_directory = NULL;
+  common_args->session_broker = NULL;
 
   common_args->config_file = NULL;
   common_args->workaround_flags_outofband = 0;
@@ -608,6 +626,16 @@ verify_common_cmd_args_outofband (struct common_cmd_args *common_args, int check
       exit (EXIT_FAILURE);
     }
 
+  if (common_args->capability_cache_directory)
+    {
+      if (access (common_args->capability_cache_directory, R_OK|W_OK|X_OK) < 0)
+        {
+          fprintf (stderr, "insufficient permission on capability cache directory '%s'\n",
+                   common_args->capability_cache_directory);
+          exit (EXIT_FAILURE);
+        }
+    }
+
   if (common_args->k_g_len)
     {
       unsigned int i;
@@ -75,6 +75,9 @@ enum argp_common_option_keys
     ARGP_FANOUT_KEY = 'F',
     ARGP_ELIMINATE_KEY = 'E',
     ARGP_ALWAYS_PREFIX_KEY = 149,
+    /* outofband options, cont. */
+    ARGP_CAPABILITY_CACHE_DIRECTORY_KEY = 150,
+    ARGP_SESSION_BROKER_KEY = 151,
   };
 
 /*
@@ -137,6 +140,14 @@ enum argp_common_option_keys
   { "cipher-suite-id",     ARGP_CIPHER_SUITE_ID_KEY, "CIPHER-SUITE-ID", 0,                                      \
       "Specify the IPMI 2.0 cipher suite ID to use.", 16}
 
+#define ARGP_COMMON_OPTIONS_CAPABILITY_CACHE                                                                    \
+  { "capability-cache-directory", ARGP_CAPABILITY_CACHE_DIRECTORY_KEY, "DIRECTORY", 0,                          \
+      "Cache IPMI 2.0 BMC capabilities in DIRECTORY to shorten session setup.", 16}
+
+#define ARGP_COMMON_OPTIONS_SESSION_BROKER                                                                      \
+  { "session-broker", ARGP_SESSION_BROKER_KEY, "SOCKET", 0,                                                     \
+      "Share IPMI 2.0 sessions through the ipmisessiond broker listening on SOCKET.", 16}
+
 #define ARGP_COMMON_OPTIONS_PRIVILEGE_LEVEL                                                                     \
   { "privilege-level",  ARGP_PRIVILEGE_LEVEL_KEY, "PRIVILEGE-LEVEL", 0,                                         \
       "Specify the privilege level to be used.", 17}
@@ -223,6 +234,8 @@ struct common_cmd_args
   int authentication_type;
   int cipher_suite_id;
   int privilege_level;
+  char *capability_cache_directory;
+  char *session_broker;
 
   /*
    * misc options
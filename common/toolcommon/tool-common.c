@@ -72,6 +72,29 @@ ipmi_open (const char *progname,
           parse_get_freeipmi_outofband_2_0_flags (common_args->workaround_flags_outofband_2_0,
                                                   &workaround_flags);
 
+          if (common_args->capability_cache_directory
+              && ipmi_ctx_set_capability_cache (ipmi_ctx,
+                                                common_args->capability_cache_directory,
+                                                0) < 0)
+            {
+              PSTDOUT_FPRINTF (pstate,
+                               stderr,
+                               "ipmi_ctx_set_capability_cache: %s\n",
+                               ipmi_ctx_errormsg (ipmi_ctx));
+              goto cleanup;
+            }
+
+          if (common_args->session_broker
+              && ipmi_ctx_set_session_broker (ipmi_ctx,
+                                              common_args->session_broker) < 0)
+            {
+              PSTDOUT_FPRINTF (pstate,
+                               stderr,
+                               "ipmi_ctx_set_session_broker: %s\n",
+                               ipmi_ctx_errormsg (ipmi_ctx));
+              goto cleanup;
+            }
+
           if (ipmi_ctx_open_outofband_2_0 (ipmi_ctx,
                                            hostname,
                                            common_args->username,
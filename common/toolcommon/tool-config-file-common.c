@@ -1316,7 +1316,8 @@ config_file_parse (const char *filename,
   int username_count = 0, password_count = 0, k_g_count = 0,
     session_timeout_count = 0, retransmission_timeout_count = 0,
     authentication_type_count = 0, cipher_suite_id_count = 0,
-    privilege_level_count = 0;
+    privilege_level_count = 0, capability_cache_directory_count = 0,
+    session_broker_count = 0;
 
   int quiet_cache_count = 0, sdr_cache_directory_count = 0;
 
@@ -1617,6 +1618,28 @@ config_file_parse (const char *filename,
         &common_cmd_args_config,
         0,
       },
+      {
+        "capability-cache-directory",
+        CONFFILE_OPTION_STRING,
+        -1,
+        _config_file_string,
+        1,
+        0,
+        &capability_cache_directory_count,
+        &(common_args->capability_cache_directory),
+        0
+      },
+      {
+        "session-broker",
+        CONFFILE_OPTION_STRING,
+        -1,
+        _config_file_string,
+        1,
+        0,
+        &session_broker_count,
+        &(common_args->session_broker),
+        0
+      },
     };
 
   struct conffile_option sdr_options[] =
@@ -4455,6 +4478,17 @@ config_file_parse (const char *filename,
         &(ipmipower_data.retransmission_backoff_count),
         0
       },
+      {
+        "ipmipower-fixed-retransmission-timeout",
+        CONFFILE_OPTION_BOOL,
+        -1,
+        _config_file_bool,
+        1,
+        0,
+        &(ipmipower_data.fixed_retransmission_timeout_count),
+        &(ipmipower_data.fixed_retransmission_timeout),
+        0
+      },
       {
         "ipmipower-ping-interval",
         CONFFILE_OPTION_INT,
@@ -4510,6 +4544,61 @@ config_file_parse (const char *filename,
         &(ipmipower_data.ping_consec_count),
         0
       },
+      {
+        "ipmipower-shared-sockets",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_unsigned_int,
+        1,
+        0,
+        &(ipmipower_data.shared_sockets_count),
+        &(ipmipower_data.shared_sockets),
+        0
+      },
+      {
+        "ipmipower-session-idle-timeout",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_unsigned_int,
+        1,
+        0,
+        &(ipmipower_data.session_idle_timeout_count),
+        &(ipmipower_data.session_idle_timeout),
+        0
+      },
+      {
+        "ipmipower-wave-window",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_unsigned_int,
+        1,
+        0,
+        &(ipmipower_data.wave_window_count),
+        &(ipmipower_data.wave_window),
+        0
+      },
+      {
+        "ipmipower-wave-rate",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_unsigned_int,
+        1,
+        0,
+        &(ipmipower_data.wave_rate_count),
+        &(ipmipower_data.wave_rate),
+        0
+      },
+      {
+        "ipmipower-wave-groups",
+        CONFFILE_OPTION_BOOL,
+        -1,
+        _config_file_bool,
+        1,
+        0,
+        &(ipmipower_data.wave_groups_count),
+        &(ipmipower_data.wave_groups),
+        0
+      },
     };
 
   /*
@@ -4714,6 +4803,39 @@ config_file_parse (const char *filename,
         &(ipmiseld_data.poll_interval),
         0
       },
+      {
+        "poll-interval-min",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_positive_unsigned_int,
+        1,
+        0,
+        &(ipmiseld_data.poll_interval_min_count),
+        &(ipmiseld_data.poll_interval_min),
+        0
+      },
+      {
+        "poll-interval-max",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_positive_unsigned_int,
+        1,
+        0,
+        &(ipmiseld_data.poll_interval_max_count),
+        &(ipmiseld_data.poll_interval_max),
+        0
+      },
+      {
+        "poll-rate-max",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_positive_unsigned_int,
+        1,
+        0,
+        &(ipmiseld_data.poll_rate_max_count),
+        &(ipmiseld_data.poll_rate_max),
+        0
+      },
       {
         "log-facility",
         CONFFILE_OPTION_STRING,
@@ -4736,6 +4858,72 @@ config_file_parse (const char *filename,
         &(ipmiseld_data.log_priority_str),
         0,
       },
+      {
+        "output-sink",
+        CONFFILE_OPTION_STRING,
+        -1,
+        _config_file_string,
+        1,
+        0,
+        &(ipmiseld_data.output_sink_str_count),
+        &(ipmiseld_data.output_sink_str),
+        0,
+      },
+      {
+        "output-path",
+        CONFFILE_OPTION_STRING,
+        -1,
+        _config_file_string,
+        1,
+        0,
+        &(ipmiseld_data.output_path_count),
+        &(ipmiseld_data.output_path),
+        0,
+      },
+      {
+        "output-format",
+        CONFFILE_OPTION_STRING,
+        -1,
+        _config_file_string,
+        1,
+        0,
+        &(ipmiseld_data.output_format_str_count),
+        &(ipmiseld_data.output_format_str),
+        0,
+      },
+      {
+        "output-rotate-size",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_unsigned_int,
+        1,
+        0,
+        &(ipmiseld_data.output_rotate_size_count),
+        &(ipmiseld_data.output_rotate_size),
+        0,
+      },
+      {
+        "output-rotate-count",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_positive_unsigned_int,
+        1,
+        0,
+        &(ipmiseld_data.output_rotate_count_count),
+        &(ipmiseld_data.output_rotate_count),
+        0,
+      },
+      {
+        "output-queue-length",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_positive_unsigned_int,
+        1,
+        0,
+        &(ipmiseld_data.output_queue_length_count),
+        &(ipmiseld_data.output_queue_length),
+        0,
+      },
       {
         "cache-directory",
         CONFFILE_OPTION_STRING,
@@ -4747,6 +4935,17 @@ config_file_parse (const char *filename,
         &(ipmiseld_data.cache_directory),
         0,
       },
+      {
+        "per-host-data-cache",
+        CONFFILE_OPTION_BOOL,
+        -1,
+        _config_file_bool,
+        1,
+        0,
+        &(ipmiseld_data.per_host_data_cache_count),
+        &(ipmiseld_data.per_host_data_cache),
+        0,
+      },
       {
         "ignore-sdr",
         CONFFILE_OPTION_BOOL,
@@ -4791,6 +4990,28 @@ config_file_parse (const char *filename,
         &(ipmiseld_data.threadpool_count),
         0
       },
+      {
+        "async-engine",
+        CONFFILE_OPTION_BOOL,
+        -1,
+        _config_file_bool,
+        1,
+        0,
+        &(ipmiseld_data.async_engine_count),
+        &(ipmiseld_data.async_engine),
+        0,
+      },
+      {
+        "async-session-count",
+        CONFFILE_OPTION_INT,
+        -1,
+        _config_file_positive_unsigned_int,
+        1,
+        0,
+        &(ipmiseld_data.async_session_count_count),
+        &(ipmiseld_data.async_session_count),
+        0
+      },
     };
 
   conffile_t cf = NULL;
@@ -265,6 +265,8 @@ struct config_file_data_ipmipower
   int retransmission_wait_timeout_count;
   unsigned int retransmission_backoff_count;
   int retransmission_backoff_count_count;
+  int fixed_retransmission_timeout;
+  int fixed_retransmission_timeout_count;
   unsigned int ping_interval;
   int ping_interval_count;
   unsigned int ping_timeout;
@@ -275,6 +277,16 @@ struct config_file_data_ipmipower
   int ping_percent_count;
   unsigned int ping_consec_count;
   int ping_consec_count_count;
+  unsigned int shared_sockets;
+  int shared_sockets_count;
+  unsigned int session_idle_timeout;
+  int session_idle_timeout_count;
+  unsigned int wave_window;
+  int wave_window_count;
+  unsigned int wave_rate;
+  int wave_rate_count;
+  int wave_groups;
+  int wave_groups_count;
 };
 
 struct config_file_data_ipmiseld
@@ -317,12 +329,32 @@ struct config_file_data_ipmiseld
   int oem_non_timestamped_event_format_str_count;
   unsigned int poll_interval;
   int poll_interval_count;
+  unsigned int poll_interval_min;
+  int poll_interval_min_count;
+  unsigned int poll_interval_max;
+  int poll_interval_max_count;
+  unsigned int poll_rate_max;
+  int poll_rate_max_count;
   char *log_facility_str;
   int log_facility_str_count;
   char *log_priority_str;
   int log_priority_str_count;
+  char *output_sink_str;
+  int output_sink_str_count;
+  char *output_path;
+  int output_path_count;
+  char *output_format_str;
+  int output_format_str_count;
+  unsigned int output_rotate_size;
+  int output_rotate_size_count;
+  unsigned int output_rotate_count;
+  int output_rotate_count_count;
+  unsigned int output_queue_length;
+  int output_queue_length_count;
   char *cache_directory;
   int cache_directory_count;
+  int per_host_data_cache;
+  int per_host_data_cache_count;
   int ignore_sdr;
   int ignore_sdr_count;
   int re_download_sdr;
@@ -331,6 +363,10 @@ struct config_file_data_ipmiseld
   int clear_sel_count;
   unsigned int threadpool_count;
   int threadpool_count_count;
+  int async_engine;
+  int async_engine_count;
+  unsigned int async_session_count;
+  int async_session_count_count;
 };
 
 int config_file_parse (const char *filename,
@@ -69,6 +69,8 @@ static struct argp_option cmdline_options[] = {
   ARGP_COMMON_OPTIONS_OUTOFBAND_HOSTRANGED,
   ARGP_COMMON_OPTIONS_AUTHENTICATION_TYPE,
   ARGP_COMMON_OPTIONS_CIPHER_SUITE_ID,
+  ARGP_COMMON_OPTIONS_CAPABILITY_CACHE,
+  ARGP_COMMON_OPTIONS_SESSION_BROKER,
   ARGP_COMMON_OPTIONS_PRIVILEGE_LEVEL,
   ARGP_COMMON_OPTIONS_CONFIG_FILE,
   ARGP_COMMON_OPTIONS_WORKAROUND_FLAGS,
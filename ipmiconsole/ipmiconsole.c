@@ -112,6 +112,54 @@ _reset_mode (void)
   return (0);
 }
 
+/* Console output is read in place from the context's output ring,
+ * rather than copied through the file descriptor.
+ */
+static int
+_stdout (const void *buf, unsigned int buflen, void *arg)
+{
+  const char *ptr = buf;
+  unsigned int left = buflen;
+  ssize_t n;
+
+  assert (buf);
+
+  while (left)
+    {
+      if ((n = write (STDOUT_FILENO, ptr, left)) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          perror ("write");
+          return (-1);
+        }
+      ptr += n;
+      left -= n;
+    }
+
+  return (buflen);
+}
+
+/* Returns 0 once the output ring is empty, -1 on error */
+static int
+_output_drain (ipmiconsole_ctx_t c)
+{
+  int n;
+
+  assert (c);
+
+  while ((n = ipmiconsole_ctx_output_read (c, _stdout, NULL)) > 0)
+    ;
+
+  if (n < 0)
+    {
+      fprintf (stderr, "ipmiconsole_ctx_output_read: %s\r\n", ipmiconsole_ctx_errormsg (c));
+      return (-1);
+    }
+
+  return (0);
+}
+
 static int
 _stdin (ipmiconsole_ctx_t c,
         char escape_char,
@@ -344,7 +392,7 @@ main (int argc, char **argv)
   protocol_config.acceptable_packet_errors_count = -1;
   protocol_config.maximum_retransmission_count = -1;
 
-  engine_config.engine_flags = 0;
+  engine_config.engine_flags = IPMICONSOLE_ENGINE_OUTPUT_RING;
   if (cmd_args.serial_keepalive)
     engine_config.engine_flags |= IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE;
   if (cmd_args.serial_keepalive_empty)
@@ -471,21 +519,17 @@ main (int argc, char **argv)
 
       if (FD_ISSET (fd, &rds))
         {
+          /* only doorbell bytes, output is in the output ring */
           if ((n = read (fd, buf, IPMICONSOLE_BUFLEN)) < 0)
             {
               perror ("read");
               goto cleanup;
             }
 
-          if (n)
-            {
-              if (write (STDOUT_FILENO, buf, n) != n)
-                {
-                  perror ("write");
-                  goto cleanup;
-                }
-            }
-          else
+          if (_output_drain (c) < 0)
+            goto cleanup;
+
+          if (!n)
             {
               /* b/c we're exitting */
               /* achu: it is possible that errnum can equal success.
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#if HAVE_ARGP_H
+#include <argp.h>
+#else /* !HAVE_ARGP_H */
+#include "freeipmi-argp.h"
+#endif /* !HAVE_ARGP_H */
+#include <limits.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "ipmiconsoled.h"
+#include "ipmiconsoled-argp.h"
+
+#include "freeipmi-portability.h"
+#include "tool-cmdline-common.h"
+#include "tool-config-file-common.h"
+#include "error.h"
+
+const char *argp_program_version =
+  "ipmiconsoled - " PACKAGE_VERSION "\n"
+  "Copyright (C) 2007-2015 Lawrence Livermore National Security, LLC.\n"
+  "This program is free software; you may redistribute it under the terms of\n"
+  "the GNU General Public License.  This program has absolutely no warranty.";
+
+const char *argp_program_bug_address =
+  "<" PACKAGE_BUGREPORT ">";
+
+static char cmdline_doc[] =
+  "ipmiconsoled - IPMI console logging daemon";
+
+static char cmdline_args_doc[] = "";
+
+static struct argp_option cmdline_options[] =
+  {
+    ARGP_COMMON_OPTIONS_OUTOFBAND_HOSTRANGED,
+    ARGP_COMMON_OPTIONS_CIPHER_SUITE_ID,
+    ARGP_COMMON_OPTIONS_PRIVILEGE_LEVEL,
+    ARGP_COMMON_OPTIONS_CONFIG_FILE,
+    ARGP_COMMON_OPTIONS_WORKAROUND_FLAGS,
+    ARGP_COMMON_OPTIONS_DEBUG,
+    { "log-directory", IPMICONSOLED_LOG_DIRECTORY_KEY, "DIRECTORY", 0,
+      "Specify the directory console logs are written to.", 40},
+    { "log-buffer-size", IPMICONSOLED_LOG_BUFFER_SIZE_KEY, "BYTES", 0,
+      "Specify the size of each console's log buffer.", 41},
+    { "flush-interval", IPMICONSOLED_FLUSH_INTERVAL_KEY, "SECONDS", 0,
+      "Specify how often buffered console output is written to the logs.", 42},
+    { "log-max-size", IPMICONSOLED_LOG_MAX_SIZE_KEY, "BYTES", 0,
+      "Specify the size at which a console log is rotated, 0 to never rotate.", 43},
+    { "log-rotate-count", IPMICONSOLED_LOG_ROTATE_COUNT_KEY, "COUNT", 0,
+      "Specify the number of rotated console logs to keep.", 44},
+    { "compress", IPMICONSOLED_COMPRESS_KEY, 0, 0,
+      "Compress rotated console logs with gzip.", 45},
+    { "socket-path", IPMICONSOLED_SOCKET_PATH_KEY, "PATH", 0,
+      "Specify the local socket for attaching to live consoles.", 46},
+    { "reconnect-max", IPMICONSOLED_RECONNECT_MAX_KEY, "SECONDS", 0,
+      "Specify the maximum delay between reconnect attempts.", 47},
+    { "engine-threads", IPMICONSOLED_ENGINE_THREADS_KEY, "NUM", 0,
+      "Specify the number of console engine threads.", 48},
+    { "serial-keepalive", IPMICONSOLED_SERIAL_KEEPALIVE_KEY, 0, 0,
+      "Occasionally send NUL characters to detect inactive serial connections.", 49},
+    { "serial-keepalive-empty", IPMICONSOLED_SERIAL_KEEPALIVE_EMPTY_KEY, 0, 0,
+      "Occasionally send empty SOL packets to detect inactive serial connections.", 50},
+    { "sol-payload-instance", IPMICONSOLED_SOL_PAYLOAD_INSTANCE_KEY, "NUM", 0,
+      "Specify SOL payload instance number.", 51},
+    { "lock-memory", IPMICONSOLED_LOCK_MEMORY_KEY, 0, 0,
+      "Lock sensitive information (such as usernames and passwords) in memory.", 52},
+    { "foreground", IPMICONSOLED_FOREGROUND_KEY, 0, 0,
+      "Run daemon in foreground.", 53},
+    { NULL, 0, NULL, 0, NULL, 0}
+  };
+
+static error_t cmdline_parse (int key, char *arg, struct argp_state *state);
+
+static struct argp cmdline_argp = { cmdline_options,
+                                    cmdline_parse,
+                                    cmdline_args_doc,
+                                    cmdline_doc };
+
+static struct argp cmdline_config_file_argp = { cmdline_options,
+                                                cmdline_config_file_parse,
+                                                cmdline_args_doc,
+                                                cmdline_doc };
+
+static unsigned int
+_parse_unsigned_int (const char *arg, const char *what, int zero_ok)
+{
+  char *endptr;
+  long tmp;
+
+  assert (arg);
+  assert (what);
+
+  errno = 0;
+  tmp = strtol (arg, &endptr, 0);
+  if (errno
+      || endptr[0] != '\0'
+      || tmp < (zero_ok ? 0 : 1)
+      || tmp > UINT_MAX)
+    {
+      fprintf (stderr, "invalid %s\n", what);
+      exit (EXIT_FAILURE);
+    }
+
+  return (tmp);
+}
+
+static error_t
+cmdline_parse (int key, char *arg, struct argp_state *state)
+{
+  struct ipmiconsoled_arguments *cmd_args;
+  unsigned int tmp;
+
+  assert (state);
+
+  cmd_args = state->input;
+
+  switch (key)
+    {
+    case IPMICONSOLED_LOG_DIRECTORY_KEY: /* --log-directory */
+      if (!(cmd_args->log_directory = strdup (arg)))
+        {
+          perror ("strdup");
+          exit (EXIT_FAILURE);
+        }
+      break;
+    case IPMICONSOLED_LOG_BUFFER_SIZE_KEY: /* --log-buffer-size */
+      cmd_args->log_buffer_size = _parse_unsigned_int (arg, "log buffer size", 0);
+      break;
+    case IPMICONSOLED_FLUSH_INTERVAL_KEY: /* --flush-interval */
+      cmd_args->flush_interval = _parse_unsigned_int (arg, "flush interval", 0);
+      break;
+    case IPMICONSOLED_LOG_MAX_SIZE_KEY: /* --log-max-size */
+      cmd_args->log_max_size = _parse_unsigned_int (arg, "log max size", 1);
+      break;
+    case IPMICONSOLED_LOG_ROTATE_COUNT_KEY: /* --log-rotate-count */
+      cmd_args->log_rotate_count = _parse_unsigned_int (arg, "log rotate count", 1);
+      break;
+    case IPMICONSOLED_COMPRESS_KEY: /* --compress */
+      cmd_args->compress = 1;
+      break;
+    case IPMICONSOLED_SOCKET_PATH_KEY: /* --socket-path */
+      if (!(cmd_args->socket_path = strdup (arg)))
+        {
+          perror ("strdup");
+          exit (EXIT_FAILURE);
+        }
+      break;
+    case IPMICONSOLED_RECONNECT_MAX_KEY: /* --reconnect-max */
+      cmd_args->reconnect_max = _parse_unsigned_int (arg, "reconnect max", 0);
+      break;
+    case IPMICONSOLED_ENGINE_THREADS_KEY: /* --engine-threads */
+      cmd_args->engine_threads = _parse_unsigned_int (arg, "engine threads", 0);
+      break;
+    case IPMICONSOLED_SERIAL_KEEPALIVE_KEY: /* --serial-keepalive */
+      cmd_args->serial_keepalive = 1;
+      break;
+    case IPMICONSOLED_SERIAL_KEEPALIVE_EMPTY_KEY: /* --serial-keepalive-empty */
+      cmd_args->serial_keepalive_empty = 1;
+      break;
+    case IPMICONSOLED_SOL_PAYLOAD_INSTANCE_KEY: /* --sol-payload-instance */
+      tmp = _parse_unsigned_int (arg, "sol payload instance", 0);
+      if (!IPMI_PAYLOAD_INSTANCE_VALID (tmp))
+        {
+          fprintf (stderr, "invalid sol payload instance\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->sol_payload_instance = tmp;
+      break;
+    case IPMICONSOLED_LOCK_MEMORY_KEY: /* --lock-memory */
+      cmd_args->lock_memory = 1;
+      break;
+    case IPMICONSOLED_FOREGROUND_KEY: /* --foreground */
+      cmd_args->foreground = 1;
+      break;
+    case ARGP_KEY_ARG:
+      /* Too many arguments. */
+      argp_usage (state);
+      break;
+    case ARGP_KEY_END:
+      break;
+    default:
+      return (common_parse_opt (key, arg, &(cmd_args->common_args)));
+    }
+
+  return (0);
+}
+
+static void
+_ipmiconsoled_config_file_parse (struct ipmiconsoled_arguments *cmd_args)
+{
+  struct config_file_data_ipmiconsole config_file_data;
+
+  assert (cmd_args);
+
+  memset (&config_file_data,
+          '\0',
+          sizeof (struct config_file_data_ipmiconsole));
+
+  /* SOL options are shared with ipmiconsole */
+  if (config_file_parse (cmd_args->common_args.config_file,
+                         0,
+                         &(cmd_args->common_args),
+                         CONFIG_FILE_OUTOFBAND,
+                         CONFIG_FILE_TOOL_IPMICONSOLE,
+                         &config_file_data) < 0)
+    {
+      fprintf (stderr, "config_file_parse: %s\n", strerror (errno));
+      exit (EXIT_FAILURE);
+    }
+
+  if (config_file_data.serial_keepalive_count)
+    cmd_args->serial_keepalive = config_file_data.serial_keepalive;
+  if (config_file_data.serial_keepalive_empty_count)
+    cmd_args->serial_keepalive_empty = config_file_data.serial_keepalive_empty;
+  if (config_file_data.lock_memory_count)
+    cmd_args->lock_memory = config_file_data.lock_memory;
+}
+
+static void
+_ipmiconsoled_args_validate (struct ipmiconsoled_arguments *cmd_args)
+{
+  assert (cmd_args);
+
+  if (!cmd_args->common_args.hostname)
+    {
+      fprintf (stderr, "hostname input required\n");
+      exit (EXIT_FAILURE);
+    }
+
+  if (access (cmd_args->log_directory, R_OK|W_OK|X_OK) < 0)
+    {
+      fprintf (stderr,
+               "insufficient permission on log directory '%s'\n",
+               cmd_args->log_directory);
+      exit (EXIT_FAILURE);
+    }
+}
+
+void
+ipmiconsoled_argp_parse (int argc, char **argv, struct ipmiconsoled_arguments *cmd_args)
+{
+  assert (argc >= 0);
+  assert (argv);
+  assert (cmd_args);
+
+  init_common_cmd_args_admin (&(cmd_args->common_args));
+
+  /* ipmiconsole differences */
+  cmd_args->common_args.driver_type = IPMI_DEVICE_LAN_2_0;
+  cmd_args->common_args.session_timeout = 60000;
+  cmd_args->common_args.retransmission_timeout = 500;
+
+  cmd_args->log_directory = IPMICONSOLED_LOG_DIRECTORY_DEFAULT;
+  cmd_args->log_buffer_size = IPMICONSOLED_LOG_BUFFER_SIZE_DEFAULT;
+  cmd_args->flush_interval = IPMICONSOLED_FLUSH_INTERVAL_DEFAULT;
+  cmd_args->log_max_size = IPMICONSOLED_LOG_MAX_SIZE_DEFAULT;
+  cmd_args->log_rotate_count = IPMICONSOLED_LOG_ROTATE_COUNT_DEFAULT;
+  cmd_args->compress = 0;
+  cmd_args->socket_path = IPMICONSOLED_SOCKET_PATH_DEFAULT;
+  cmd_args->reconnect_max = IPMICONSOLED_RECONNECT_MAX_DEFAULT;
+  cmd_args->engine_threads = IPMICONSOLED_ENGINE_THREADS_DEFAULT;
+  cmd_args->serial_keepalive = 0;
+  cmd_args->serial_keepalive_empty = 0;
+  cmd_args->sol_payload_instance = 0;
+  cmd_args->lock_memory = 0;
+  cmd_args->foreground = 0;
+
+  argp_parse (&cmdline_config_file_argp,
+              argc,
+              argv,
+              ARGP_IN_ORDER,
+              NULL,
+              &(cmd_args->common_args));
+
+  _ipmiconsoled_config_file_parse (cmd_args);
+
+  argp_parse (&cmdline_argp,
+              argc,
+              argv,
+              ARGP_IN_ORDER,
+              NULL,
+              cmd_args);
+
+  verify_common_cmd_args (&(cmd_args->common_args));
+  _ipmiconsoled_args_validate (cmd_args);
+}
@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <limits.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "ipmiconsoled-log.h"
+
+#include "freeipmi-portability.h"
+#include "error.h"
+
+struct ipmiconsoled_log
+{
+  char *path;
+  int fd;
+  char *buf;
+  unsigned int buf_size;
+  unsigned int buf_len;
+  unsigned int size;
+  unsigned int max_size;
+  unsigned int rotate_count;
+  int compress;
+  pid_t compress_pid;
+};
+
+static int
+_log_open (ipmiconsoled_log_t log)
+{
+  struct stat statbuf;
+
+  assert (log);
+  assert (log->fd < 0);
+
+  if ((log->fd = open (log->path, O_WRONLY | O_CREAT | O_APPEND, 0600)) < 0)
+    {
+      err_output ("open: %s: %s", log->path, strerror (errno));
+      return (-1);
+    }
+
+  if (fstat (log->fd, &statbuf) < 0)
+    {
+      err_output ("fstat: %s: %s", log->path, strerror (errno));
+      /* ignore potential error, error path */
+      close (log->fd);
+      log->fd = -1;
+      return (-1);
+    }
+
+  log->size = statbuf.st_size;
+  return (0);
+}
+
+static void
+_log_compress_wait (ipmiconsoled_log_t log, int block)
+{
+  assert (log);
+
+  if (log->compress_pid <= 0)
+    return;
+
+  if (waitpid (log->compress_pid, NULL, block ? 0 : WNOHANG))
+    log->compress_pid = 0;
+}
+
+static void
+_log_compress (ipmiconsoled_log_t log, const char *path)
+{
+  pid_t pid;
+
+  assert (log);
+  assert (path);
+
+  if ((pid = fork ()) < 0)
+    {
+      err_output ("fork: %s", strerror (errno));
+      return;
+    }
+
+  if (!pid)
+    {
+      long i, open_max;
+
+      /* don't hold the daemon's sockets open while compressing */
+      if ((open_max = sysconf (_SC_OPEN_MAX)) < 0)
+        open_max = 1024;
+      for (i = STDERR_FILENO + 1; i < open_max; i++)
+        close (i);
+
+      execlp ("gzip", "gzip", "-f", path, (char *)NULL);
+      _exit (EXIT_FAILURE);
+    }
+
+  log->compress_pid = pid;
+}
+
+static void
+_log_rotate_path (ipmiconsoled_log_t log,
+                  unsigned int num,
+                  char *buf,
+                  unsigned int buflen)
+{
+  assert (log);
+  assert (num);
+  assert (buf);
+  assert (buflen);
+
+  snprintf (buf,
+            buflen,
+            "%s.%u%s",
+            log->path,
+            num,
+            log->compress ? ".gz" : "");
+}
+
+static int
+_log_rotate (ipmiconsoled_log_t log)
+{
+  char from[PATH_MAX + 1];
+  char to[PATH_MAX + 1];
+  unsigned int i;
+
+  assert (log);
+  assert (log->fd >= 0);
+
+  /* A previous rotation's gzip must be done with <path>.1 before it
+   * is shifted and replaced.  Don't wait on it and stall every
+   * console, let the log run over its maximum size and try again on
+   * the next write.
+   */
+  _log_compress_wait (log, 0);
+  if (log->compress_pid > 0)
+    return (0);
+
+  /* ignore potential error, we're rotating */
+  close (log->fd);
+  log->fd = -1;
+
+  if (log->rotate_count)
+    {
+      for (i = log->rotate_count - 1; i > 0; i--)
+        {
+          _log_rotate_path (log, i, from, PATH_MAX);
+          _log_rotate_path (log, i + 1, to, PATH_MAX);
+          if (rename (from, to) < 0 && errno != ENOENT)
+            err_output ("rename: %s: %s", from, strerror (errno));
+        }
+
+      snprintf (to, PATH_MAX, "%s.1", log->path);
+      if (rename (log->path, to) < 0)
+        err_output ("rename: %s: %s", log->path, strerror (errno));
+      else if (log->compress)
+        _log_compress (log, to);
+    }
+  else
+    {
+      if (unlink (log->path) < 0)
+        err_output ("unlink: %s: %s", log->path, strerror (errno));
+    }
+
+  return (_log_open (log));
+}
+
+/* write out buf directly, rotating the log if necessary */
+static int
+_log_output (ipmiconsoled_log_t log, const char *buf, unsigned int buflen)
+{
+  unsigned int left = buflen;
+  ssize_t n;
+
+  assert (log);
+  assert (buf);
+
+  if (log->fd < 0)
+    {
+      if (_log_open (log) < 0)
+        return (-1);
+    }
+
+  while (left)
+    {
+      if ((n = write (log->fd, buf, left)) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          err_output ("write: %s: %s", log->path, strerror (errno));
+          return (-1);
+        }
+      buf += n;
+      left -= n;
+    }
+
+  log->size += buflen;
+
+  if (log->max_size && log->size >= log->max_size)
+    {
+      if (_log_rotate (log) < 0)
+        return (-1);
+    }
+
+  return (0);
+}
+
+ipmiconsoled_log_t
+ipmiconsoled_log_create (const char *directory,
+                         const char *hostname,
+                         unsigned int buffer_size,
+                         unsigned int max_size,
+                         unsigned int rotate_count,
+                         int compress)
+{
+  ipmiconsoled_log_t log = NULL;
+  unsigned int pathlen;
+
+  assert (directory);
+  assert (hostname);
+  assert (buffer_size);
+
+  if (!(log = (ipmiconsoled_log_t)malloc (sizeof (struct ipmiconsoled_log))))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      return (NULL);
+    }
+  memset (log, '\0', sizeof (struct ipmiconsoled_log));
+  log->fd = -1;
+  log->buf_size = buffer_size;
+  log->max_size = max_size;
+  log->rotate_count = rotate_count;
+  log->compress = compress;
+
+  /* directory + '/' + hostname + ".log" + NUL */
+  pathlen = strlen (directory) + 1 + strlen (hostname) + 4 + 1;
+
+  if (!(log->path = (char *)malloc (pathlen)))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      goto cleanup;
+    }
+  snprintf (log->path, pathlen, "%s/%s.log", directory, hostname);
+
+  if (!(log->buf = (char *)malloc (buffer_size)))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (_log_open (log) < 0)
+    goto cleanup;
+
+  return (log);
+
+ cleanup:
+  ipmiconsoled_log_destroy (log);
+  return (NULL);
+}
+
+int
+ipmiconsoled_log_write (ipmiconsoled_log_t log,
+                        const void *buf,
+                        unsigned int buflen)
+{
+  assert (log);
+  assert (buf);
+
+  if (buflen > log->buf_size - log->buf_len)
+    {
+      if (ipmiconsoled_log_flush (log) < 0)
+        return (-1);
+
+      /* too big to buffer, no point copying it */
+      if (buflen >= log->buf_size)
+        return (_log_output (log, buf, buflen));
+    }
+
+  memcpy (log->buf + log->buf_len, buf, buflen);
+  log->buf_len += buflen;
+  return (0);
+}
+
+int
+ipmiconsoled_log_flush (ipmiconsoled_log_t log)
+{
+  int rv = 0;
+
+  assert (log);
+
+  _log_compress_wait (log, 0);
+
+  if (!log->buf_len)
+    return (0);
+
+  /* On error the buffered output is lost, but a log that can't be
+   * written shouldn't stall the consoles.
+   */
+  if (_log_output (log, log->buf, log->buf_len) < 0)
+    rv = -1;
+
+  log->buf_len = 0;
+  return (rv);
+}
+
+int
+ipmiconsoled_log_reopen (ipmiconsoled_log_t log)
+{
+  int rv;
+
+  assert (log);
+
+  rv = ipmiconsoled_log_flush (log);
+
+  if (log->fd >= 0)
+    {
+      /* ignore potential error, re-opening */
+      close (log->fd);
+      log->fd = -1;
+    }
+
+  if (_log_open (log) < 0)
+    return (-1);
+
+  return (rv);
+}
+
+void
+ipmiconsoled_log_destroy (ipmiconsoled_log_t log)
+{
+  if (!log)
+    return;
+
+  if (log->fd >= 0)
+    {
+      ipmiconsoled_log_flush (log);
+      /* ignore potential error, cleanup path */
+      close (log->fd);
+    }
+  _log_compress_wait (log, 1);
+  free (log->path);
+  free (log->buf);
+  free (log);
+}
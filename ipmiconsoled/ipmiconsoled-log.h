@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMICONSOLED_LOG_H
+#define IPMICONSOLED_LOG_H
+
+typedef struct ipmiconsoled_log *ipmiconsoled_log_t;
+
+/* ipmiconsoled_log_create
+ *
+ * Open the console log <directory>/<hostname>.log for appending.
+ * Console output is gathered in a buffer of buffer_size bytes and
+ * written out by ipmiconsoled_log_flush() or when the buffer fills.
+ * Once the log reaches max_size bytes it is rotated, keeping
+ * rotate_count old logs, optionally compressed with gzip.  A max_size
+ * of 0 disables rotation.
+ *
+ * Returns log on success, NULL on error.
+ */
+ipmiconsoled_log_t ipmiconsoled_log_create (const char *directory,
+                                            const char *hostname,
+                                            unsigned int buffer_size,
+                                            unsigned int max_size,
+                                            unsigned int rotate_count,
+                                            int compress);
+
+/* Returns 0 on success, -1 on error */
+int ipmiconsoled_log_write (ipmiconsoled_log_t log,
+                            const void *buf,
+                            unsigned int buflen);
+
+/* Returns 0 on success, -1 on error */
+int ipmiconsoled_log_flush (ipmiconsoled_log_t log);
+
+/* Flush and re-open the log, for external log rotation.
+ *
+ * Returns 0 on success, -1 on error
+ */
+int ipmiconsoled_log_reopen (ipmiconsoled_log_t log);
+
+void ipmiconsoled_log_destroy (ipmiconsoled_log_t log);
+
+#endif /* IPMICONSOLED_LOG_H */
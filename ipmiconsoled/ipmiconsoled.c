@@ -0,0 +1,985 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#include <stdarg.h>
+#endif /* STDC_HEADERS */
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+#if TIME_WITH_SYS_TIME
+#include <sys/time.h>
+#include <time.h>
+#else /* !TIME_WITH_SYS_TIME */
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else /* !HAVE_SYS_TIME_H */
+#include <time.h>
+#endif /* !HAVE_SYS_TIME_H */
+#endif /* !TIME_WITH_SYS_TIME */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/poll.h>
+#include <syslog.h>
+#include <signal.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <ipmiconsole.h>        /* lib ipmiconsole.h */
+
+#include "ipmiconsoled.h"
+#include "ipmiconsoled-argp.h"
+#include "ipmiconsoled-log.h"
+
+#include "freeipmi-portability.h"
+#include "error.h"
+#include "fi_hostlist.h"
+#include "pstdout.h"
+#include "tool-common.h"
+#include "tool-daemon-common.h"
+#include "tool-util-common.h"
+
+#define IPMICONSOLED_PIDFILE            IPMICONSOLED_LOCALSTATEDIR "/run/ipmiconsoled.pid"
+
+#define IPMICONSOLED_POLL_TIMEOUT       1000
+
+#define IPMICONSOLED_LISTEN_BACKLOG     16
+
+#define IPMICONSOLED_DEBUG(__msg)               \
+  do {                                          \
+    if (debug_flag)                             \
+      err_debug __msg;                          \
+  } while (0)
+
+static int exit_flag = 1;
+
+static int debug_flag = 0;
+
+static int reopen_flag = 0;
+
+static ipmiconsoled_node_data_t **nodes = NULL;
+
+static unsigned int nodes_count = 0;
+
+static ipmiconsoled_client_t *clients[IPMICONSOLED_CLIENTS_MAX];
+
+static unsigned int clients_count = 0;
+
+static int listen_fd = -1;
+
+static void
+_signal_handler_callback (int sig)
+{
+  exit_flag = 0;
+}
+
+static void
+_reopen_signal_handler (int sig)
+{
+  reopen_flag = 1;
+}
+
+/* Notes from the daemon go in the console log so the log shows
+ * where output may have been missed.
+ */
+static void
+_node_log_note (ipmiconsoled_node_data_t *node_data, const char *fmt, ...)
+{
+  char note[IPMICONSOLED_BUFLEN];
+  char timestr[64];
+  char msg[IPMICONSOLED_BUFLEN];
+  struct tm tm;
+  time_t now;
+  va_list ap;
+  int len;
+
+  assert (node_data);
+  assert (fmt);
+
+  va_start (ap, fmt);
+  vsnprintf (msg, IPMICONSOLED_BUFLEN, fmt, ap);
+  va_end (ap);
+
+  now = time (NULL);
+  localtime_r (&now, &tm);
+  strftime (timestr, sizeof (timestr), "%Y-%m-%d %H:%M:%S", &tm);
+
+  len = snprintf (note,
+                  IPMICONSOLED_BUFLEN,
+                  "\r\n[ipmiconsoled %s: %s]\r\n",
+                  timestr,
+                  msg);
+  if (len >= IPMICONSOLED_BUFLEN)
+    len = IPMICONSOLED_BUFLEN - 1;
+
+  ipmiconsoled_log_write (node_data->log, note, len);
+}
+
+static void
+_client_close (ipmiconsoled_client_t *client)
+{
+  assert (client);
+
+  if (client->fd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (client->fd);
+      client->fd = -1;
+    }
+}
+
+/* Clients are never waited on.  One that can't keep up with its
+ * console is dropped rather than stalling logging for every node.
+ */
+static void
+_client_write (ipmiconsoled_client_t *client, const void *buf, unsigned int buflen)
+{
+  ssize_t n;
+
+  assert (client);
+  assert (buf);
+
+  if (client->fd < 0)
+    return;
+
+  if ((n = write (client->fd, buf, buflen)) != buflen)
+    {
+      if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EPIPE)
+        IPMICONSOLED_DEBUG (("write: %s", strerror (errno)));
+      _client_close (client);
+    }
+}
+
+static int
+_node_output_callback (const void *buf, unsigned int buflen, void *arg)
+{
+  ipmiconsoled_node_data_t *node_data;
+  unsigned int i;
+
+  assert (buf);
+  assert (arg);
+
+  node_data = (ipmiconsoled_node_data_t *)arg;
+
+  /* a log error is reported by the log, keep the console going */
+  ipmiconsoled_log_write (node_data->log, buf, buflen);
+
+  for (i = 0; i < clients_count; i++)
+    {
+      if (clients[i]->node_data == node_data)
+        _client_write (clients[i], buf, buflen);
+    }
+
+  return (buflen);
+}
+
+static void
+_node_disconnect (ipmiconsoled_node_data_t *node_data)
+{
+  struct ipmiconsoled_arguments *args;
+
+  assert (node_data);
+  assert (node_data->c);
+
+  args = node_data->prog_data->args;
+
+  /* pick up anything left in the output ring */
+  if (node_data->established)
+    {
+      if (ipmiconsole_ctx_output_read (node_data->c,
+                                       _node_output_callback,
+                                       node_data) < 0)
+        IPMICONSOLED_DEBUG (("%s: ipmiconsole_ctx_output_read: %s",
+                             node_data->hostname,
+                             ipmiconsole_ctx_errormsg (node_data->c)));
+    }
+
+  /* Only note lost consoles, not every failed reconnect attempt */
+  if (node_data->established)
+    {
+      _node_log_note (node_data,
+                      "console disconnected: %s",
+                      ipmiconsole_ctx_errormsg (node_data->c));
+      err_output ("%s: console disconnected: %s",
+                  node_data->hostname,
+                  ipmiconsole_ctx_errormsg (node_data->c));
+    }
+  else
+    IPMICONSOLED_DEBUG (("%s: console connect failed: %s",
+                         node_data->hostname,
+                         ipmiconsole_ctx_errormsg (node_data->c)));
+
+  if (node_data->fd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (node_data->fd);
+      node_data->fd = -1;
+    }
+
+  ipmiconsole_ctx_destroy (node_data->c);
+  node_data->c = NULL;
+  node_data->established = 0;
+
+  node_data->next_connect_time = time (NULL) + node_data->reconnect_delay;
+  node_data->reconnect_delay *= 2;
+  if (node_data->reconnect_delay > args->reconnect_max)
+    node_data->reconnect_delay = args->reconnect_max;
+}
+
+static void
+_node_connect (ipmiconsoled_node_data_t *node_data)
+{
+  ipmiconsoled_prog_data_t *prog_data;
+  struct ipmiconsoled_arguments *args;
+
+  assert (node_data);
+  assert (!node_data->c);
+
+  prog_data = node_data->prog_data;
+  args = prog_data->args;
+
+  if (!(node_data->c = ipmiconsole_ctx_create (node_data->hostname,
+                                               &(prog_data->ipmi_config),
+                                               &(prog_data->protocol_config),
+                                               &(prog_data->engine_config))))
+    {
+      err_output ("%s: ipmiconsole_ctx_create: %s",
+                  node_data->hostname,
+                  strerror (errno));
+      goto reconnect;
+    }
+
+  if (args->sol_payload_instance)
+    {
+      if (ipmiconsole_ctx_set_config (node_data->c,
+                                      IPMICONSOLE_CTX_CONFIG_OPTION_SOL_PAYLOAD_INSTANCE,
+                                      &(args->sol_payload_instance)) < 0)
+        {
+          err_output ("%s: ipmiconsole_ctx_set_config: %s",
+                      node_data->hostname,
+                      ipmiconsole_ctx_errormsg (node_data->c));
+          goto reconnect;
+        }
+    }
+
+  if (ipmiconsole_engine_submit (node_data->c, NULL, NULL) < 0)
+    {
+      IPMICONSOLED_DEBUG (("%s: ipmiconsole_engine_submit: %s",
+                           node_data->hostname,
+                           ipmiconsole_ctx_errormsg (node_data->c)));
+      goto reconnect;
+    }
+
+  if ((node_data->fd = ipmiconsole_ctx_fd (node_data->c)) < 0)
+    {
+      err_output ("%s: ipmiconsole_ctx_fd: %s",
+                  node_data->hostname,
+                  ipmiconsole_ctx_errormsg (node_data->c));
+      goto reconnect;
+    }
+
+  return;
+
+ reconnect:
+  if (node_data->c)
+    _node_disconnect (node_data);
+  else
+    node_data->next_connect_time = time (NULL) + node_data->reconnect_delay;
+}
+
+static void
+_node_established_check (ipmiconsoled_node_data_t *node_data)
+{
+  assert (node_data);
+  assert (node_data->c);
+  assert (!node_data->established);
+
+  if (ipmiconsole_ctx_status (node_data->c) != IPMICONSOLE_CTX_STATUS_SOL_ESTABLISHED)
+    return;
+
+  node_data->established = 1;
+  node_data->reconnect_delay = 1;
+  _node_log_note (node_data, "console connected");
+  IPMICONSOLED_DEBUG (("%s: console connected", node_data->hostname));
+}
+
+static void
+_node_input (ipmiconsoled_node_data_t *node_data)
+{
+  char buf[IPMICONSOLED_BUFLEN];
+  ssize_t n;
+
+  assert (node_data);
+  assert (node_data->c);
+  assert (node_data->fd >= 0);
+
+  /* In output ring mode only doorbell bytes arrive on the fd, the
+   * console output itself is read from the ring.
+   */
+  if ((n = read (node_data->fd, buf, IPMICONSOLED_BUFLEN)) < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        return;
+      IPMICONSOLED_DEBUG (("%s: read: %s", node_data->hostname, strerror (errno)));
+    }
+
+  if (n <= 0)
+    {
+      _node_disconnect (node_data);
+      return;
+    }
+
+  if (!node_data->established)
+    _node_established_check (node_data);
+
+  if (ipmiconsole_ctx_output_read (node_data->c,
+                                   _node_output_callback,
+                                   node_data) < 0)
+    IPMICONSOLED_DEBUG (("%s: ipmiconsole_ctx_output_read: %s",
+                         node_data->hostname,
+                         ipmiconsole_ctx_errormsg (node_data->c)));
+}
+
+static ipmiconsoled_node_data_t *
+_node_find (const char *hostname)
+{
+  unsigned int i;
+
+  assert (hostname);
+
+  for (i = 0; i < nodes_count; i++)
+    {
+      if (!strcmp (nodes[i]->hostname, hostname))
+        return (nodes[i]);
+    }
+
+  return (NULL);
+}
+
+static void
+_client_console_input (ipmiconsoled_client_t *client, const char *buf, unsigned int buflen)
+{
+  ipmiconsoled_node_data_t *node_data;
+
+  assert (client);
+  assert (client->node_data);
+  assert (buf);
+
+  node_data = client->node_data;
+
+  /* console input while disconnected is dropped */
+  if (!buflen || !node_data->established || node_data->fd < 0)
+    return;
+
+  /* errors will be noticed when the engine closes the fd */
+  if (write (node_data->fd, buf, buflen) < 0)
+    IPMICONSOLED_DEBUG (("%s: write: %s", node_data->hostname, strerror (errno)));
+}
+
+/* A client first sends the hostname of the console it wants, ended
+ * by a newline.  Everything after that is console input.
+ */
+static void
+_client_attach (ipmiconsoled_client_t *client)
+{
+  ipmiconsoled_node_data_t *node_data;
+  char msg[IPMICONSOLED_BUFLEN];
+  char *nl;
+  unsigned int len;
+
+  assert (client);
+  assert (!client->node_data);
+
+  if (!(nl = memchr (client->buf, '\n', client->buflen)))
+    {
+      if (client->buflen == IPMICONSOLED_BUFLEN)
+        _client_close (client);
+      return;
+    }
+
+  *nl = '\0';
+  if (nl > client->buf && *(nl - 1) == '\r')
+    *(nl - 1) = '\0';
+
+  if (!(node_data = _node_find (client->buf)))
+    {
+      len = snprintf (msg, IPMICONSOLED_BUFLEN, "unknown hostname '%s'\n", client->buf);
+      _client_write (client, msg, len < IPMICONSOLED_BUFLEN ? len : IPMICONSOLED_BUFLEN - 1);
+      _client_close (client);
+      return;
+    }
+
+  client->node_data = node_data;
+
+  len = snprintf (msg,
+                  IPMICONSOLED_BUFLEN,
+                  "[ipmiconsoled: attached to %s%s]\r\n",
+                  node_data->hostname,
+                  node_data->established ? "" : ", console not connected");
+  _client_write (client, msg, len < IPMICONSOLED_BUFLEN ? len : IPMICONSOLED_BUFLEN - 1);
+
+  nl++;
+  _client_console_input (client, nl, client->buflen - (nl - client->buf));
+  client->buflen = 0;
+}
+
+static void
+_client_input (ipmiconsoled_client_t *client)
+{
+  char buf[IPMICONSOLED_BUFLEN];
+  ssize_t n;
+
+  assert (client);
+  assert (client->fd >= 0);
+
+  if (!client->node_data)
+    {
+      if ((n = read (client->fd,
+                     client->buf + client->buflen,
+                     IPMICONSOLED_BUFLEN - client->buflen)) <= 0)
+        {
+          if (n < 0 && (errno == EINTR || errno == EAGAIN))
+            return;
+          _client_close (client);
+          return;
+        }
+      client->buflen += n;
+      _client_attach (client);
+      return;
+    }
+
+  if ((n = read (client->fd, buf, IPMICONSOLED_BUFLEN)) <= 0)
+    {
+      if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        return;
+      _client_close (client);
+      return;
+    }
+
+  _client_console_input (client, buf, n);
+}
+
+static void
+_client_accept (void)
+{
+  ipmiconsoled_client_t *client;
+  int fd;
+
+  if ((fd = accept (listen_fd, NULL, NULL)) < 0)
+    {
+      if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+        IPMICONSOLED_DEBUG (("accept: %s", strerror (errno)));
+      return;
+    }
+
+  if (clients_count == IPMICONSOLED_CLIENTS_MAX)
+    {
+      IPMICONSOLED_DEBUG (("too many clients attached"));
+      /* ignore potential error, rejecting client */
+      close (fd);
+      return;
+    }
+
+  if (fcntl (fd, F_SETFL, O_NONBLOCK) < 0)
+    {
+      IPMICONSOLED_DEBUG (("fcntl: %s", strerror (errno)));
+      /* ignore potential error, rejecting client */
+      close (fd);
+      return;
+    }
+
+  if (!(client = (ipmiconsoled_client_t *)malloc (sizeof (ipmiconsoled_client_t))))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      /* ignore potential error, rejecting client */
+      close (fd);
+      return;
+    }
+  memset (client, '\0', sizeof (ipmiconsoled_client_t));
+  client->fd = fd;
+  clients[clients_count++] = client;
+}
+
+/* remove clients closed while handling this round of events */
+static void
+_clients_reap (void)
+{
+  unsigned int i = 0;
+
+  while (i < clients_count)
+    {
+      if (clients[i]->fd < 0)
+        {
+          free (clients[i]);
+          clients[i] = clients[--clients_count];
+        }
+      else
+        i++;
+    }
+}
+
+static int
+_listen_setup (const char *socket_path)
+{
+  struct sockaddr_un addr;
+  mode_t old_umask;
+
+  assert (socket_path);
+
+  if (strlen (socket_path) >= sizeof (addr.sun_path))
+    {
+      err_output ("socket path '%s' too long", socket_path);
+      return (-1);
+    }
+
+  memset (&addr, '\0', sizeof (struct sockaddr_un));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, socket_path);
+
+  if ((listen_fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+      err_output ("socket: %s", strerror (errno));
+      return (-1);
+    }
+
+  /* a stale socket from a previous run */
+  (void) unlink (socket_path);
+
+  /* consoles are as sensitive as the BMC credentials, never let the
+   * socket exist with looser permissions
+   */
+  old_umask = umask (077);
+
+  if (bind (listen_fd, (struct sockaddr *)&addr, sizeof (struct sockaddr_un)) < 0)
+    {
+      err_output ("bind: %s: %s", socket_path, strerror (errno));
+      umask (old_umask);
+      return (-1);
+    }
+
+  umask (old_umask);
+
+  if (listen (listen_fd, IPMICONSOLED_LISTEN_BACKLOG) < 0)
+    {
+      err_output ("listen: %s", strerror (errno));
+      return (-1);
+    }
+
+  if (fcntl (listen_fd, F_SETFL, O_NONBLOCK) < 0)
+    {
+      err_output ("fcntl: %s", strerror (errno));
+      return (-1);
+    }
+
+  return (0);
+}
+
+static void
+_ipmiconsole_config_setup (ipmiconsoled_prog_data_t *prog_data)
+{
+  struct ipmiconsoled_arguments *args;
+
+  assert (prog_data);
+
+  args = prog_data->args;
+
+  prog_data->ipmi_config.username = args->common_args.username;
+  prog_data->ipmi_config.password = args->common_args.password;
+  prog_data->ipmi_config.k_g = args->common_args.k_g;
+  prog_data->ipmi_config.k_g_len = args->common_args.k_g_len;
+
+  if (args->common_args.privilege_level == IPMI_PRIVILEGE_LEVEL_USER)
+    prog_data->ipmi_config.privilege_level = IPMICONSOLE_PRIVILEGE_USER;
+  else if (args->common_args.privilege_level == IPMI_PRIVILEGE_LEVEL_OPERATOR)
+    prog_data->ipmi_config.privilege_level = IPMICONSOLE_PRIVILEGE_OPERATOR;
+  else
+    prog_data->ipmi_config.privilege_level = IPMICONSOLE_PRIVILEGE_ADMIN;
+
+  prog_data->ipmi_config.cipher_suite_id = args->common_args.cipher_suite_id;
+
+  prog_data->ipmi_config.workaround_flags = 0;
+
+  if (args->common_args.workaround_flags_outofband_2_0 & IPMI_PARSE_WORKAROUND_FLAGS_OUTOFBAND_2_0_AUTHENTICATION_CAPABILITIES)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_AUTHENTICATION_CAPABILITIES;
+  if (args->common_args.workaround_flags_outofband_2_0 & IPMI_PARSE_WORKAROUND_FLAGS_OUTOFBAND_2_0_INTEL_2_0_SESSION)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_INTEL_2_0_SESSION;
+  if (args->common_args.workaround_flags_outofband_2_0 & IPMI_PARSE_WORKAROUND_FLAGS_OUTOFBAND_2_0_SUPERMICRO_2_0_SESSION)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_SUPERMICRO_2_0_SESSION;
+  if (args->common_args.workaround_flags_outofband_2_0 & IPMI_PARSE_WORKAROUND_FLAGS_OUTOFBAND_2_0_SUN_2_0_SESSION)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_SUN_2_0_SESSION;
+  if (args->common_args.workaround_flags_outofband_2_0 & IPMI_PARSE_WORKAROUND_FLAGS_OUTOFBAND_2_0_OPEN_SESSION_PRIVILEGE)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_OPEN_SESSION_PRIVILEGE;
+  if (args->common_args.workaround_flags_outofband_2_0 & IPMI_PARSE_WORKAROUND_FLAGS_OUTOFBAND_2_0_NON_EMPTY_INTEGRITY_CHECK_VALUE)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_NON_EMPTY_INTEGRITY_CHECK_VALUE;
+  if (args->common_args.workaround_flags_outofband_2_0 & IPMI_PARSE_WORKAROUND_FLAGS_OUTOFBAND_2_0_NO_CHECKSUM_CHECK)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_NO_CHECKSUM_CHECK;
+
+  if (args->common_args.section_specific_workaround_flags & IPMI_PARSE_SECTION_SPECIFIC_WORKAROUND_FLAGS_IGNORE_SOL_PAYLOAD_SIZE)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_IGNORE_SOL_PAYLOAD_SIZE;
+  if (args->common_args.section_specific_workaround_flags & IPMI_PARSE_SECTION_SPECIFIC_WORKAROUND_FLAGS_IGNORE_SOL_PORT)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_IGNORE_SOL_PORT;
+  if (args->common_args.section_specific_workaround_flags & IPMI_PARSE_SECTION_SPECIFIC_WORKAROUND_FLAGS_SKIP_SOL_ACTIVATION_STATUS)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_SKIP_SOL_ACTIVATION_STATUS;
+  if (args->common_args.section_specific_workaround_flags & IPMI_PARSE_SECTION_SPECIFIC_WORKAROUND_FLAGS_SKIP_CHANNEL_PAYLOAD_SUPPORT)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_SKIP_CHANNEL_PAYLOAD_SUPPORT;
+  if (args->common_args.section_specific_workaround_flags & IPMI_PARSE_SECTION_SPECIFIC_WORKAROUND_FLAGS_SERIAL_ALERTS_DEFERRED)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_SERIAL_ALERTS_DEFERRED;
+  if (args->common_args.section_specific_workaround_flags & IPMI_PARSE_SECTION_SPECIFIC_WORKAROUND_FLAGS_INCREMENT_SOL_PACKET_SEQUENCE)
+    prog_data->ipmi_config.workaround_flags |= IPMICONSOLE_WORKAROUND_INCREMENT_SOL_PACKET_SEQUENCE;
+
+  prog_data->protocol_config.session_timeout_len = args->common_args.session_timeout;
+  prog_data->protocol_config.retransmission_timeout_len = args->common_args.retransmission_timeout;
+  prog_data->protocol_config.retransmission_backoff_count = -1;
+  prog_data->protocol_config.keepalive_timeout_len = -1;
+  prog_data->protocol_config.retransmission_keepalive_timeout_len = -1;
+  prog_data->protocol_config.acceptable_packet_errors_count = -1;
+  prog_data->protocol_config.maximum_retransmission_count = -1;
+
+  /* Console output is read straight out of each context's output
+   * ring into the log buffers.
+   */
+  prog_data->engine_config.engine_flags = IPMICONSOLE_ENGINE_OUTPUT_RING;
+  if (args->serial_keepalive)
+    prog_data->engine_config.engine_flags |= IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE;
+  if (args->serial_keepalive_empty)
+    prog_data->engine_config.engine_flags |= IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE_EMPTY;
+  if (args->lock_memory)
+    prog_data->engine_config.engine_flags |= IPMICONSOLE_ENGINE_LOCK_MEMORY;
+
+  prog_data->engine_config.behavior_flags = 0;
+
+  prog_data->engine_config.debug_flags = 0;
+  if (args->common_args.debug)
+    {
+      prog_data->engine_config.debug_flags |= IPMICONSOLE_DEBUG_SYSLOG;
+      if (args->foreground)
+        prog_data->engine_config.debug_flags |= IPMICONSOLE_DEBUG_STDERR;
+    }
+}
+
+static void
+_free_node_data (ipmiconsoled_node_data_t *node_data)
+{
+  if (!node_data)
+    return;
+
+  if (node_data->fd >= 0)
+    /* ignore potential error, cleanup path */
+    close (node_data->fd);
+  if (node_data->c)
+    ipmiconsole_ctx_destroy (node_data->c);
+  ipmiconsoled_log_destroy (node_data->log);
+  free (node_data->hostname);
+  free (node_data);
+}
+
+static ipmiconsoled_node_data_t *
+_alloc_node_data (ipmiconsoled_prog_data_t *prog_data, const char *hostname)
+{
+  struct ipmiconsoled_arguments *args;
+  ipmiconsoled_node_data_t *node_data;
+
+  assert (prog_data);
+  assert (hostname);
+
+  args = prog_data->args;
+
+  if (!(node_data = (ipmiconsoled_node_data_t *)malloc (sizeof (ipmiconsoled_node_data_t))))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      return (NULL);
+    }
+  memset (node_data, '\0', sizeof (ipmiconsoled_node_data_t));
+  node_data->prog_data = prog_data;
+  node_data->fd = -1;
+  node_data->reconnect_delay = 1;
+
+  if (!(node_data->hostname = strdup (hostname)))
+    {
+      err_output ("strdup: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (!(node_data->log = ipmiconsoled_log_create (args->log_directory,
+                                                  hostname,
+                                                  args->log_buffer_size,
+                                                  args->log_max_size,
+                                                  args->log_rotate_count,
+                                                  args->compress)))
+    goto cleanup;
+
+  return (node_data);
+
+ cleanup:
+  _free_node_data (node_data);
+  return (NULL);
+}
+
+static int
+_nodes_setup (ipmiconsoled_prog_data_t *prog_data)
+{
+  fi_hostlist_t hlist = NULL;
+  fi_hostlist_iterator_t hitr = NULL;
+  char *host = NULL;
+  int hosts_count;
+  int rv = -1;
+
+  assert (prog_data);
+
+  if ((hosts_count = pstdout_hostnames_count (prog_data->args->common_args.hostname)) <= 0)
+    {
+      err_output ("invalid number of hosts specified");
+      goto cleanup;
+    }
+
+  if (!(nodes = (ipmiconsoled_node_data_t **)malloc (sizeof (ipmiconsoled_node_data_t *) * hosts_count)))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (!(hlist = fi_hostlist_create (prog_data->args->common_args.hostname)))
+    {
+      err_output ("fi_hostlist_create: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  fi_hostlist_uniq (hlist);
+
+  if (!(hitr = fi_hostlist_iterator_create (hlist)))
+    {
+      err_output ("fi_hostlist_iterator_create: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  while ((host = fi_hostlist_next (hitr)) && nodes_count < hosts_count)
+    {
+      if (!(nodes[nodes_count] = _alloc_node_data (prog_data, host)))
+        goto cleanup;
+      nodes_count++;
+      free (host);
+    }
+  host = NULL;
+
+  rv = 0;
+ cleanup:
+  free (host);
+  fi_hostlist_iterator_destroy (hitr);
+  fi_hostlist_destroy (hlist);
+  return (rv);
+}
+
+static int
+_ipmiconsoled (ipmiconsoled_prog_data_t *prog_data)
+{
+  struct ipmiconsoled_arguments *args;
+  struct pollfd *pfds = NULL;
+  unsigned int pfds_len;
+  time_t next_flush_time;
+  unsigned int i;
+  int rv = -1;
+
+  assert (prog_data);
+
+  args = prog_data->args;
+
+  debug_flag = args->common_args.debug;
+
+  _ipmiconsole_config_setup (prog_data);
+
+  if (ipmiconsole_engine_init (args->engine_threads,
+                               prog_data->engine_config.debug_flags) < 0)
+    {
+      err_output ("ipmiconsole_engine_init: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (_nodes_setup (prog_data) < 0)
+    goto cleanup;
+
+  if (_listen_setup (args->socket_path) < 0)
+    goto cleanup;
+
+  pfds_len = 1 + nodes_count + IPMICONSOLED_CLIENTS_MAX;
+  if (!(pfds = (struct pollfd *)malloc (sizeof (struct pollfd) * pfds_len)))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  next_flush_time = time (NULL) + args->flush_interval;
+
+  while (exit_flag)
+    {
+      unsigned int nfds = 0;
+      time_t now;
+
+      now = time (NULL);
+
+      if (reopen_flag)
+        {
+          for (i = 0; i < nodes_count; i++)
+            ipmiconsoled_log_reopen (nodes[i]->log);
+          reopen_flag = 0;
+        }
+
+      /* console fds first, so their pfds index is the node index */
+      for (i = 0; i < nodes_count; i++)
+        {
+          if (!nodes[i]->c && now >= nodes[i]->next_connect_time)
+            _node_connect (nodes[i]);
+
+          if (nodes[i]->c && !nodes[i]->established)
+            _node_established_check (nodes[i]);
+
+          pfds[nfds].fd = nodes[i]->c ? nodes[i]->fd : -1;
+          pfds[nfds].events = POLLIN;
+          pfds[nfds].revents = 0;
+          nfds++;
+        }
+
+      pfds[nfds].fd = listen_fd;
+      pfds[nfds].events = POLLIN;
+      pfds[nfds].revents = 0;
+      nfds++;
+
+      for (i = 0; i < clients_count; i++)
+        {
+          pfds[nfds].fd = clients[i]->fd;
+          pfds[nfds].events = POLLIN;
+          pfds[nfds].revents = 0;
+          nfds++;
+        }
+
+      if (poll (pfds, nfds, IPMICONSOLED_POLL_TIMEOUT) < 0)
+        {
+          if (errno != EINTR)
+            {
+              err_output ("poll: %s", strerror (errno));
+              goto cleanup;
+            }
+          continue;
+        }
+
+      for (i = 0; i < nodes_count; i++)
+        {
+          if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            _node_input (nodes[i]);
+        }
+
+      /* clients accepted below aren't in pfds yet */
+      for (i = 0; i < clients_count; i++)
+        {
+          if (clients[i]->fd >= 0
+              && pfds[nodes_count + 1 + i].revents & (POLLIN | POLLHUP | POLLERR))
+            _client_input (clients[i]);
+        }
+
+      if (pfds[nodes_count].revents & POLLIN)
+        _client_accept ();
+
+      _clients_reap ();
+
+      /* Console output is batched, each log is written out once per
+       * flush interval unless its buffer fills first.
+       */
+      now = time (NULL);
+      if (now >= next_flush_time)
+        {
+          for (i = 0; i < nodes_count; i++)
+            ipmiconsoled_log_flush (nodes[i]->log);
+          next_flush_time = now + args->flush_interval;
+        }
+    }
+
+  rv = 0;
+ cleanup:
+  for (i = 0; i < clients_count; i++)
+    {
+      _client_close (clients[i]);
+      free (clients[i]);
+    }
+  clients_count = 0;
+  if (listen_fd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (listen_fd);
+      (void) unlink (args->socket_path);
+    }
+  for (i = 0; i < nodes_count; i++)
+    _free_node_data (nodes[i]);
+  free (nodes);
+  free (pfds);
+  ipmiconsole_engine_teardown (1);
+  return (rv);
+}
+
+int
+main (int argc, char **argv)
+{
+  ipmiconsoled_prog_data_t prog_data;
+  struct ipmiconsoled_arguments cmd_args;
+
+  err_init (argv[0]);
+  err_set_flags (ERROR_STDERR);
+
+  ipmi_disable_coredump ();
+
+  memset (&prog_data, '\0', sizeof (ipmiconsoled_prog_data_t));
+  prog_data.progname = argv[0];
+  ipmiconsoled_argp_parse (argc, argv, &cmd_args);
+  prog_data.args = &cmd_args;
+
+  if (!cmd_args.foreground)
+    {
+      daemonize_common (IPMICONSOLED_PIDFILE);
+      err_set_flags (ERROR_SYSLOG);
+    }
+  else
+    err_set_flags (ERROR_STDERR);
+
+  daemon_signal_handler_setup (_signal_handler_callback);
+
+  if (signal (SIGHUP, _reopen_signal_handler) == SIG_ERR)
+    err_exit ("signal: %s", strerror (errno));
+
+  /* attached clients may go away at any time */
+  if (signal (SIGPIPE, SIG_IGN) == SIG_ERR)
+    err_exit ("signal: %s", strerror (errno));
+
+  /* Call after daemonization, since daemonization closes currently
+   * open fds
+   */
+  if (argv[0][0] == '/')
+    argv[0] = strrchr(argv[0], '/') + 1;
+  openlog (argv[0], LOG_ODELAY | LOG_PID, LOG_DAEMON);
+
+  return (_ipmiconsoled (&prog_data));
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMICONSOLED_H
+#define IPMICONSOLED_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#if TIME_WITH_SYS_TIME
+#include <sys/time.h>
+#include <time.h>
+#else /* !TIME_WITH_SYS_TIME */
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else /* !HAVE_SYS_TIME_H */
+#include <time.h>
+#endif /* !HAVE_SYS_TIME_H */
+#endif /* !TIME_WITH_SYS_TIME */
+
+#include <freeipmi/freeipmi.h>
+
+#include <ipmiconsole.h>        /* lib ipmiconsole.h */
+
+#include "tool-cmdline-common.h"
+
+#include "ipmiconsoled-log.h"
+
+#define IPMICONSOLED_LOG_DIRECTORY_DEFAULT      IPMICONSOLED_LOCALSTATEDIR "/log/ipmiconsoled"
+
+#define IPMICONSOLED_SOCKET_PATH_DEFAULT        IPMICONSOLED_LOCALSTATEDIR "/run/ipmiconsoled.sock"
+
+#define IPMICONSOLED_LOG_BUFFER_SIZE_DEFAULT    (64*1024)
+
+#define IPMICONSOLED_FLUSH_INTERVAL_DEFAULT     1
+
+#define IPMICONSOLED_LOG_MAX_SIZE_DEFAULT       (64*1024*1024)
+
+#define IPMICONSOLED_LOG_ROTATE_COUNT_DEFAULT   4
+
+#define IPMICONSOLED_RECONNECT_MAX_DEFAULT      60
+
+#define IPMICONSOLED_ENGINE_THREADS_DEFAULT     4
+
+#define IPMICONSOLED_CLIENTS_MAX                64
+
+#define IPMICONSOLED_BUFLEN                     4096
+
+enum ipmiconsoled_argp_option_keys
+  {
+    IPMICONSOLED_LOG_DIRECTORY_KEY = 160,
+    IPMICONSOLED_LOG_BUFFER_SIZE_KEY = 161,
+    IPMICONSOLED_FLUSH_INTERVAL_KEY = 162,
+    IPMICONSOLED_LOG_MAX_SIZE_KEY = 163,
+    IPMICONSOLED_LOG_ROTATE_COUNT_KEY = 164,
+    IPMICONSOLED_COMPRESS_KEY = 165,
+    IPMICONSOLED_SOCKET_PATH_KEY = 166,
+    IPMICONSOLED_RECONNECT_MAX_KEY = 167,
+    IPMICONSOLED_ENGINE_THREADS_KEY = 168,
+    IPMICONSOLED_SERIAL_KEEPALIVE_KEY = 169,
+    IPMICONSOLED_SERIAL_KEEPALIVE_EMPTY_KEY = 170,
+    IPMICONSOLED_SOL_PAYLOAD_INSTANCE_KEY = 171,
+    IPMICONSOLED_LOCK_MEMORY_KEY = 172,
+    IPMICONSOLED_FOREGROUND_KEY = 173,
+  };
+
+struct ipmiconsoled_arguments
+{
+  struct common_cmd_args common_args;
+  char *log_directory;
+  unsigned int log_buffer_size;
+  unsigned int flush_interval;
+  unsigned int log_max_size;
+  unsigned int log_rotate_count;
+  int compress;
+  char *socket_path;
+  unsigned int reconnect_max;
+  unsigned int engine_threads;
+  int serial_keepalive;
+  int serial_keepalive_empty;
+  unsigned int sol_payload_instance;
+  int lock_memory;
+  int foreground;
+};
+
+typedef struct ipmiconsoled_prog_data
+{
+  char *progname;
+  struct ipmiconsoled_arguments *args;
+  struct ipmiconsole_ipmi_config ipmi_config;
+  struct ipmiconsole_protocol_config protocol_config;
+  struct ipmiconsole_engine_config engine_config;
+} ipmiconsoled_prog_data_t;
+
+/* A client attached to a live console through the local socket.
+ * Until the client has sent the hostname it wants, node_data is NULL
+ * and the request line is accumulated in buf.
+ */
+typedef struct ipmiconsoled_client
+{
+  int fd;
+  struct ipmiconsoled_node_data *node_data;
+  char buf[IPMICONSOLED_BUFLEN];
+  unsigned int buflen;
+} ipmiconsoled_client_t;
+
+typedef struct ipmiconsoled_node_data
+{
+  ipmiconsoled_prog_data_t *prog_data;
+  char *hostname;
+  ipmiconsole_ctx_t c;
+  int fd;
+  int established;
+  time_t next_connect_time;
+  unsigned int reconnect_delay;
+  ipmiconsoled_log_t log;
+} ipmiconsoled_node_data_t;
+
+#endif /* IPMICONSOLED_H */
@@ -57,6 +57,9 @@
 #endif /* HAVE_FCNTL_H */
 #include <netinet/in.h>
 #include <errno.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif /* HAVE_SYS_EPOLL_H */
 
 #include "ipmipower.h"
 #include "ipmipower_argp.h"
@@ -74,9 +77,19 @@
 #include "tool-common.h"
 #include "tool-util-common.h"
 
+#define IPMIPOWER_EPOLL_MAX_EVENTS 1024
+
+/* max packets read from a shared socket per poll, so one busy socket
+ * can't starve the others or stdin
+ */
+#define IPMIPOWER_SHARED_RECV_MAX  64
+
 cbuf_t ttyin;
 cbuf_t ttyout;
 
+/* epoll fd connections are registered with, -1 if using poll() */
+static int ipmipower_epfd = -1;
+
 /* configuration for ipmipower */
 struct ipmipower_arguments cmd_args;
 
@@ -141,6 +154,9 @@ _ipmipower_setup (void)
     }
 
   memset (output_counts, '\0', sizeof (output_counts));
+
+  /* must be done before connections are created */
+  ipmipower_epfd = ipmipower_connection_event_setup ();
 }
 
 static void
@@ -156,6 +172,10 @@ _ipmipower_cleanup (void)
 
   ipmipower_connection_array_destroy (ics, ics_len);
 
+  ipmipower_connection_shared_cleanup ();
+
+  ipmipower_connection_event_cleanup ();
+
   for (i = 0; i < IPMIPOWER_MSG_TYPE_NUM_ENTRIES; i++)
     fi_hostlist_destroy (output_hostrange[i]);
 }
@@ -208,74 +228,23 @@ _eliminate_nodes (void)
     }
 }
 
-static void
-_sendto (cbuf_t cbuf, int fd, struct sockaddr *destaddr, socklen_t destaddrlen)
+/* _recv
+ * - Receive a packet into buf
+ * - Returns length of packet, 0 if nothing was received
+ */
+static int
+_recv (int fd,
+       uint8_t *buf,
+       unsigned int buflen,
+       int flags,
+       struct sockaddr *from,
+       socklen_t *fromlen)
 {
-  int n, rv;
-  uint8_t buf[IPMIPOWER_PACKET_BUFLEN];
+  int rv;
 
-  if ((n = cbuf_read (cbuf, buf, IPMIPOWER_PACKET_BUFLEN)) < 0)
-    {
-      IPMIPOWER_ERROR (("cbuf_read: %s", fd, strerror (errno)));
-      exit (EXIT_FAILURE);
-    }
-
-  if (n == IPMIPOWER_PACKET_BUFLEN)
-    {
-      IPMIPOWER_ERROR (("cbuf_read: buffer full"));
-      exit (EXIT_FAILURE);
-    }
-
-  do
-    {
-      if (cmd_args.common_args.driver_type == IPMI_DEVICE_LAN)
-        rv = ipmi_lan_sendto (fd,
-                              buf,
-                              n,
-                              0,
-                              destaddr,
-                              destaddrlen);
-      else
-        {
-          if (ipmi_is_ipmi_1_5_packet (buf, n))
-            rv = ipmi_lan_sendto (fd,
-                                  buf,
-                                  n,
-                                  0,
-                                  destaddr,
-                                  destaddrlen);
-          else
-            rv = ipmi_rmcpplus_sendto (fd,
-                                       buf,
-                                       n,
-                                       0,
-                                       destaddr,
-                                       destaddrlen);
-        }
-    } while (rv < 0 && errno == EINTR);
-
-  if (rv < 0)
-    {
-      IPMIPOWER_ERROR (("ipmi_lan/rmcpplus_sendto: %s", strerror (errno)));
-      exit (EXIT_FAILURE);
-    }
-
-  /* cbuf should be empty now */
-  if (!cbuf_is_empty (cbuf))
-    {
-      IPMIPOWER_ERROR (("cbuf not empty"));
-      exit (EXIT_FAILURE);
-    }
-}
-
-static void
-_recvfrom (cbuf_t cbuf, int fd, struct sockaddr *srcaddr, socklen_t srcaddrlen)
-{
-  int n, rv, dropped = 0;
-  uint8_t buf[IPMIPOWER_PACKET_BUFLEN];
-  struct sockaddr_in6 from6;
-  struct sockaddr *from = (struct sockaddr *)&from6;
-  socklen_t fromlen = sizeof (struct sockaddr_in6);
+  assert (buf);
+  assert (from);
+  assert (fromlen);
 
   do
     {
@@ -289,10 +258,10 @@ _recvfrom (cbuf_t cbuf, int fd, struct sockaddr *srcaddr, socklen_t srcaddrlen)
        */
       rv = ipmi_lan_recvfrom (fd,
                               buf,
-                              IPMIPOWER_PACKET_BUFLEN,
-                              0,
+                              buflen,
+                              flags,
                               from,
-                              &fromlen);
+                              fromlen);
     } while (rv < 0 && errno == EINTR);
 
   /* achu & hliebig:
@@ -329,9 +298,15 @@ _recvfrom (cbuf_t cbuf, int fd, struct sockaddr *srcaddr, socklen_t srcaddrlen)
           || errno == ECONNREFUSED))
     {
       IPMIPOWER_DEBUG (("ipmi_lan_recvfrom: connection refused: %s", strerror (errno)));
-      return;
+      return (0);
     }
 
+  /* nothing left to read on a shared socket */
+  if (rv < 0
+      && (flags & MSG_DONTWAIT)
+      && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return (0);
+
   if (rv < 0)
     {
       IPMIPOWER_ERROR (("ipmi_lan_recvfrom: %s", strerror (errno)));
@@ -344,12 +319,73 @@ _recvfrom (cbuf_t cbuf, int fd, struct sockaddr *srcaddr, socklen_t srcaddrlen)
       exit (EXIT_FAILURE);
     }
 
+  return (rv);
+}
+
+/* _store
+ * - Store received packet in cbuf
+ */
+static void
+_store (cbuf_t cbuf, const uint8_t *buf, int len)
+{
+  int n, dropped = 0;
+
+  assert (cbuf);
+  assert (buf);
+
+  /* cbuf should be empty, but if it isn't, empty it */
+  if (!cbuf_is_empty (cbuf))
+    {
+      IPMIPOWER_DEBUG (("cbuf not empty, draining"));
+      do
+        {
+          uint8_t tempbuf[IPMIPOWER_PACKET_BUFLEN];
+
+          if (cbuf_read (cbuf, tempbuf, IPMIPOWER_PACKET_BUFLEN) < 0)
+            {
+              IPMIPOWER_ERROR (("cbuf_read: %s", strerror (errno)));
+              exit (EXIT_FAILURE);
+            }
+        } while(!cbuf_is_empty (cbuf));
+    }
+
+  if ((n = cbuf_write (cbuf, (void *)buf, len, &dropped)) < 0)
+    {
+      IPMIPOWER_ERROR (("cbuf_write: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  if (n != len)
+    {
+      IPMIPOWER_ERROR (("cbuf_write: rv=%d n=%d", len, n));
+      exit (EXIT_FAILURE);
+    }
+
+  if (dropped)
+    IPMIPOWER_DEBUG (("cbuf_write: read dropped %d bytes", dropped));
+}
+
+/* _recvfrom
+ * - Returns 1 if a packet was stored in cbuf, 0 if not
+ */
+static int
+_recvfrom (cbuf_t cbuf, int fd, struct sockaddr *srcaddr, socklen_t srcaddrlen)
+{
+  int rv;
+  uint8_t buf[IPMIPOWER_PACKET_BUFLEN];
+  struct sockaddr_in6 from6;
+  struct sockaddr *from = (struct sockaddr *)&from6;
+  socklen_t fromlen = sizeof (struct sockaddr_in6);
+
+  if (!(rv = _recv (fd, buf, IPMIPOWER_PACKET_BUFLEN, 0, from, &fromlen)))
+    return (0);
+
   if (from6.sin6_family == AF_INET6)
     {
       if (memcmp (&from6.sin6_addr,
                   &(((struct sockaddr_in6 *)srcaddr)->sin6_addr),
                   sizeof (from6.sin6_addr)))
-        return;
+        return (0);
     }
   else
     {
@@ -361,43 +397,258 @@ _recvfrom (cbuf_t cbuf, int fd, struct sockaddr *srcaddr, socklen_t srcaddrlen)
       memcpy (&from4, from, fromlen);
 
       if (from4.sin_addr.s_addr != ((struct sockaddr_in *)srcaddr)->sin_addr.s_addr)
-        return;
+        return (0);
     }
 
-  /* cbuf should be empty, but if it isn't, empty it */
-  if (!cbuf_is_empty (cbuf))
+  _store (cbuf, buf, rv);
+  return (1);
+}
+
+/* _shared_recvfrom
+ * - Receive packets on a shared socket and store them with the
+ *   connections they are for
+ */
+static void
+_shared_recvfrom (int fd)
+{
+  unsigned int count = 0;
+
+  while (count < IPMIPOWER_SHARED_RECV_MAX)
     {
-      IPMIPOWER_DEBUG (("cbuf not empty, draining"));
-      do
+      struct ipmipower_connection *ic;
+      uint8_t buf[IPMIPOWER_PACKET_BUFLEN];
+      struct sockaddr_in6 from6;
+      struct sockaddr *from = (struct sockaddr *)&from6;
+      socklen_t fromlen = sizeof (struct sockaddr_in6);
+      int rv, ping;
+
+      if (!(rv = _recv (fd,
+                        buf,
+                        IPMIPOWER_PACKET_BUFLEN,
+                        MSG_DONTWAIT,
+                        from,
+                        &fromlen)))
+        break;
+
+      count++;
+
+      if (!(ic = ipmipower_connection_shared_lookup (ics,
+                                                     ics_len,
+                                                     from,
+                                                     buf,
+                                                     rv,
+                                                     &ping)))
         {
-          uint8_t tempbuf[IPMIPOWER_PACKET_BUFLEN];
+          IPMIPOWER_DEBUG (("shared socket packet for unknown host"));
+          continue;
+        }
 
-          if (cbuf_read (cbuf, tempbuf, IPMIPOWER_PACKET_BUFLEN) < 0)
+      if (ping)
+        {
+          if (cmd_args.ping_interval)
+            _store (ic->ping_in, buf, rv);
+        }
+      else
+        {
+          _store (ic->ipmi_in, buf, rv);
+          ipmipower_powercmd_packet_received (ic);
+        }
+    }
+}
+
+/* _shared_process
+ * - process ready shared sockets after poll()
+ */
+static void
+_shared_process (struct pollfd *pfds, unsigned int shared_len)
+{
+  struct ipmipower_connection *ic;
+  int output_ready = 0;
+  unsigned int i;
+
+  assert (pfds);
+
+  for (i = 0; i < shared_len; i++)
+    {
+      if (pfds[i].fd < 0)
+        continue;
+
+      if (pfds[i].revents & (POLLIN | POLLERR))
+        _shared_recvfrom (pfds[i].fd);
+
+      if (pfds[i].revents & POLLOUT)
+        output_ready++;
+    }
+
+  if (!output_ready)
+    return;
+
+  ic = ipmipower_connection_shared_output_take ();
+  while (ic)
+    {
+      struct ipmipower_connection *next = ic->shared_output_next;
+
+      if (!cbuf_is_empty (ic->ipmi_out)
+          && (pfds[ic->shared_ipmi_index].revents & POLLOUT))
+        ipmipower_connection_sendto (ic->ipmi_out, ic->ipmi_fd, ic->destaddr, ic->destaddrlen);
+
+      if (!cbuf_is_empty (ic->ping_out)
+          && (pfds[ic->shared_ping_index].revents & POLLOUT))
+        ipmipower_connection_sendto (ic->ping_out, ic->ping_fd, ic->destaddr, ic->destaddrlen);
+
+      /* re-queues connection if its socket was not writable */
+      ipmipower_connection_event_update (ic);
+
+      ic = next;
+    }
+}
+
+/* _poll_process
+ * - process ready connection fds after poll()
+ */
+static void
+_poll_process (struct pollfd *pfds)
+{
+  int i;
+
+  assert (pfds);
+
+  for (i = 0; i < ics_len; i++)
+    {
+      if (pfds[i*2].revents & POLLERR)
+        {
+          IPMIPOWER_DEBUG (("host = %s; IPMI POLLERR", ics[i].hostname));
+          /* See comments in _ipmi_recvfrom() regarding ECONNRESET/ECONNREFUSED */
+          if (_recvfrom (ics[i].ipmi_in, ics[i].ipmi_fd, ics[i].destaddr, ics[i].destaddrlen))
+            ipmipower_powercmd_packet_received (&ics[i]);
+        }
+      else
+        {
+          if (pfds[i*2].revents & POLLIN)
             {
-              IPMIPOWER_ERROR (("cbuf_read: %s", strerror (errno)));
-              exit (EXIT_FAILURE);
+              if (_recvfrom (ics[i].ipmi_in, ics[i].ipmi_fd, ics[i].destaddr, ics[i].destaddrlen))
+                ipmipower_powercmd_packet_received (&ics[i]);
             }
-        } while(!cbuf_is_empty (cbuf));
+
+          if (pfds[i*2].revents & POLLOUT)
+            ipmipower_connection_sendto (ics[i].ipmi_out, ics[i].ipmi_fd, ics[i].destaddr, ics[i].destaddrlen);
+        }
+
+      if (!cmd_args.ping_interval)
+        continue;
+
+      if (pfds[i*2+1].revents & POLLERR)
+        {
+          IPMIPOWER_DEBUG (("host = %s; PING_POLLERR", ics[i].hostname));
+          _recvfrom (ics[i].ping_in, ics[i].ping_fd, ics[i].destaddr, ics[i].destaddrlen);
+        }
+      else
+        {
+          if (pfds[i*2+1].revents & POLLIN)
+            _recvfrom (ics[i].ping_in, ics[i].ping_fd, ics[i].destaddr, ics[i].destaddrlen);
+
+          if (pfds[i*2+1].revents & POLLOUT)
+            ipmipower_connection_sendto (ics[i].ping_out, ics[i].ping_fd, ics[i].destaddr, ics[i].destaddrlen);
+        }
     }
+}
 
-  if ((n = cbuf_write (cbuf, buf, rv, &dropped)) < 0)
+/* _epoll_process
+ * - process ready connection fds in the epoll set
+ */
+static void
+_epoll_process (void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event events[IPMIPOWER_EPOLL_MAX_EVENTS];
+  int i, n;
+
+  assert (ipmipower_epfd >= 0);
+
+  do
     {
-      IPMIPOWER_ERROR (("cbuf_write: %s", strerror (errno)));
-      exit (EXIT_FAILURE);
-    }
+      /* poll() already told us the epoll set is readable */
+      n = epoll_wait (ipmipower_epfd, events, IPMIPOWER_EPOLL_MAX_EVENTS, 0);
+    } while (n < 0 && errno == EINTR);
 
-  if (n != rv)
+  if (n < 0)
     {
-      IPMIPOWER_ERROR (("cbuf_write: rv=%d n=%d", rv, n));
+      IPMIPOWER_ERROR (("epoll_wait: %s", strerror (errno)));
       exit (EXIT_FAILURE);
     }
 
-  if (dropped)
-    IPMIPOWER_DEBUG (("cbuf_write: read dropped %d bytes", dropped));
+  for (i = 0; i < n; i++)
+    {
+      struct ipmipower_connection *ic;
+      unsigned int index;
+
+      index = IPMIPOWER_CONNECTION_EVENT_INDEX (events[i].data.u64);
+
+      /* should not happen, fds are removed from the epoll set when
+       * closed
+       */
+      if (index >= ics_len)
+        {
+          IPMIPOWER_DEBUG (("invalid epoll event index %u", index));
+          continue;
+        }
+
+      ic = &ics[index];
+
+      if (!IPMIPOWER_CONNECTION_EVENT_PING (events[i].data.u64))
+        {
+          if (events[i].events & EPOLLERR)
+            {
+              IPMIPOWER_DEBUG (("host = %s; IPMI EPOLLERR", ic->hostname));
+              /* See comments in _ipmi_recvfrom() regarding ECONNRESET/ECONNREFUSED */
+              if (_recvfrom (ic->ipmi_in, ic->ipmi_fd, ic->destaddr, ic->destaddrlen))
+                ipmipower_powercmd_packet_received (ic);
+            }
+          else
+            {
+              if (events[i].events & EPOLLIN)
+                {
+                  if (_recvfrom (ic->ipmi_in, ic->ipmi_fd, ic->destaddr, ic->destaddrlen))
+                    ipmipower_powercmd_packet_received (ic);
+                }
+
+              if ((events[i].events & EPOLLOUT)
+                  && !cbuf_is_empty (ic->ipmi_out))
+                ipmipower_connection_sendto (ic->ipmi_out, ic->ipmi_fd, ic->destaddr, ic->destaddrlen);
+            }
+        }
+      else
+        {
+          if (events[i].events & EPOLLERR)
+            {
+              IPMIPOWER_DEBUG (("host = %s; PING_EPOLLERR", ic->hostname));
+              _recvfrom (ic->ping_in, ic->ping_fd, ic->destaddr, ic->destaddrlen);
+            }
+          else
+            {
+              if (events[i].events & EPOLLIN)
+                _recvfrom (ic->ping_in, ic->ping_fd, ic->destaddr, ic->destaddrlen);
+
+              if ((events[i].events & EPOLLOUT)
+                  && !cbuf_is_empty (ic->ping_out))
+                ipmipower_connection_sendto (ic->ping_out, ic->ping_fd, ic->destaddr, ic->destaddrlen);
+            }
+        }
+
+      /* output cbufs are now empty, stop listening for EPOLLOUT */
+      ipmipower_connection_event_update (ic);
+    }
+#endif /* HAVE_SYS_EPOLL_H */
 }
 
 /* _poll_loop
  * - poll on all descriptors
+ *
+ * When epoll is available, connection fds are registered once in a
+ * persistent epoll set (see ipmipower_connection_event_update()) and
+ * only the epoll fd, stdin, and stdout are passed to poll().
+ * With shared sockets, only the shared sockets are polled.
+ * Otherwise, all connection fds are polled on every iteration.
  */
 static void
 _poll_loop (int non_interactive)
@@ -418,6 +669,9 @@ _poll_loop (int non_interactive)
       int i, num, timeout;
       int powercmd_timeout = -1;
       int ping_timeout = -1;
+      int host_fds;
+      const int *shared_fds = NULL;
+      unsigned int shared_len = 0;
 
       /* If there are no pending commands before this call,
        * powercmd_timeout will not be set, leaving it at -1
@@ -451,15 +705,28 @@ _poll_loop (int non_interactive)
        * changing.  By going to a callback/event mechanism, there will
        * still be some O(n) activities within the code, so I am only
        * going to create a more efficient O(n) poll loop.
+       *
+       * With epoll, the O(n) setup of the pollfd array is removed,
+       * only the epoll fd is polled on in place of the host fds.
        */
 
+      /* The "*2" is for each host's two fds, one for ipmi
+       * (ipmi_fd) and one for rmcp (ping_fd).
+       */
+      if (cmd_args.shared_sockets)
+        {
+          shared_fds = ipmipower_connection_shared_fds (&shared_len);
+          host_fds = shared_len;
+        }
+      else if (ipmipower_epfd >= 0)
+        host_fds = 1;
+      else
+        host_fds = ics_len*2;
+
       /* Has the number of hosts changed? */
-      if (nfds != (ics_len*2) + extra_fds)
+      if (nfds != host_fds + extra_fds)
         {
-          /* The "*2" is for each host's two fds, one for ipmi
-           * (ipmi_fd) and one for rmcp (ping_fd).
-           */
-          nfds = (ics_len*2) + extra_fds;
+          nfds = host_fds + extra_fds;
           free (pfds);
 
           if (!(pfds = (struct pollfd *)malloc (nfds * sizeof (struct pollfd))))
@@ -469,23 +736,46 @@ _poll_loop (int non_interactive)
             }
         }
 
-      for (i = 0; i < ics_len; i++)
+      if (cmd_args.shared_sockets)
+        {
+          int output_pending = ipmipower_connection_shared_output_pending ();
+
+          /* poll() ignores unopened shared sockets, which are -1 */
+          for (i = 0; i < shared_len; i++)
+            {
+              pfds[i].fd = shared_fds[i];
+              pfds[i].events = POLLIN;
+              if (output_pending)
+                pfds[i].events |= POLLOUT;
+              pfds[i].revents = 0;
+            }
+        }
+      else if (ipmipower_epfd >= 0)
+        {
+          pfds[0].fd = ipmipower_epfd;
+          pfds[0].events = POLLIN;
+          pfds[0].revents = 0;
+        }
+      else
         {
-          pfds[i*2].fd = ics[i].ipmi_fd;
-          pfds[i*2+1].fd = ics[i].ping_fd;
-          pfds[i*2].events = pfds[i*2+1].events = 0;
-          pfds[i*2].revents = pfds[i*2+1].revents = 0;
+          for (i = 0; i < ics_len; i++)
+            {
+              pfds[i*2].fd = ics[i].ipmi_fd;
+              pfds[i*2+1].fd = ics[i].ping_fd;
+              pfds[i*2].events = pfds[i*2+1].events = 0;
+              pfds[i*2].revents = pfds[i*2+1].revents = 0;
 
-          pfds[i*2].events |= POLLIN;
-          if (!cbuf_is_empty (ics[i].ipmi_out))
-            pfds[i*2].events |= POLLOUT;
+              pfds[i*2].events |= POLLIN;
+              if (!cbuf_is_empty (ics[i].ipmi_out))
+                pfds[i*2].events |= POLLOUT;
 
-          if (!cmd_args.ping_interval)
-            continue;
+              if (!cmd_args.ping_interval)
+                continue;
 
-          pfds[i*2+1].events |= POLLIN;
-          if (!cbuf_is_empty (ics[i].ping_out))
-            pfds[i*2+1].events |= POLLOUT;
+              pfds[i*2+1].events |= POLLIN;
+              if (!cbuf_is_empty (ics[i].ping_out))
+                pfds[i*2+1].events |= POLLOUT;
+            }
         }
 
       if (!non_interactive)
@@ -503,40 +793,15 @@ _poll_loop (int non_interactive)
 
       ipmipower_poll (pfds, nfds, timeout);
 
-      for (i = 0; i < ics_len; i++)
+      if (cmd_args.shared_sockets)
+        _shared_process (pfds, shared_len);
+      else if (ipmipower_epfd >= 0)
         {
-          if (pfds[i*2].revents & POLLERR)
-            {
-              IPMIPOWER_DEBUG (("host = %s; IPMI POLLERR", ics[i].hostname));
-              /* See comments in _ipmi_recvfrom() regarding ECONNRESET/ECONNREFUSED */
-              _recvfrom (ics[i].ipmi_in, ics[i].ipmi_fd, ics[i].destaddr, ics[i].destaddrlen);
-            }
-          else
-            {
-              if (pfds[i*2].revents & POLLIN)
-                _recvfrom (ics[i].ipmi_in, ics[i].ipmi_fd, ics[i].destaddr, ics[i].destaddrlen);
-
-              if (pfds[i*2].revents & POLLOUT)
-                _sendto (ics[i].ipmi_out, ics[i].ipmi_fd, ics[i].destaddr, ics[i].destaddrlen);
-            }
-
-          if (!cmd_args.ping_interval)
-            continue;
-
-          if (pfds[i*2+1].revents & POLLERR)
-            {
-              IPMIPOWER_DEBUG (("host = %s; PING_POLLERR", ics[i].hostname));
-              _recvfrom (ics[i].ping_in, ics[i].ping_fd, ics[i].destaddr, ics[i].destaddrlen);
-            }
-          else
-            {
-              if (pfds[i*2+1].revents & POLLIN)
-                _recvfrom (ics[i].ping_in, ics[i].ping_fd, ics[i].destaddr, ics[i].destaddrlen);
-
-              if (pfds[i*2+1].revents & POLLOUT)
-                _sendto (ics[i].ping_out, ics[i].ping_fd, ics[i].destaddr, ics[i].destaddrlen);
-            }
+          if (pfds[0].revents & POLLIN)
+            _epoll_process ();
         }
+      else
+        _poll_process (pfds);
 
       if (!non_interactive && (pfds[nfds-2].revents & POLLIN))
         {
@@ -708,6 +973,10 @@ main (int argc, char *argv[])
 
   _poll_loop ((cmd_args.powercmd != IPMIPOWER_POWER_CMD_NONE) ? 1 : 0);
 
+  /* don't leave idle sessions open on the BMCs */
+  ipmipower_powercmd_idle_sessions_close ();
+  ipmipower_connection_array_flush (ics, ics_len, IPMIPOWER_SESSION_CLOSE_FLUSH_TIMEOUT);
+
   ipmipower_powercmd_cleanup ();
   _ipmipower_cleanup ();
 
@@ -53,6 +53,7 @@
 #include "cbuf.h"
 #include "fi_hostlist.h"
 #include "list.h"
+#include "rtt.h"
 #include "tool-cmdline-common.h"
 
 #include "ipmidetect.h"
@@ -72,6 +73,19 @@
 
 #define IPMIPOWER_PACKET_BUFLEN                          1024
 
+#define IPMIPOWER_SHARED_SOCKETS_MAX                     1024
+
+#define IPMIPOWER_SESSION_IDLE_TIMEOUT_MAX               3600000
+
+/* how long to wait for close session requests of idle sessions to
+ * go out before connections are destroyed
+ */
+#define IPMIPOWER_SESSION_CLOSE_FLUSH_TIMEOUT            1000
+
+#define IPMIPOWER_WAVE_WINDOW_MAX                        65536
+
+#define IPMIPOWER_WAVE_RATE_MAX                          1000000
+
 #define IPMIPOWER_OUTPUT_BUFLEN                          65536
 
 #define IPMI_MAX_SIK_KEY_LENGTH                          64
@@ -270,11 +284,12 @@ typedef enum
     IPMIPOWER_PROTOCOL_STATE_C410X_SLOT_POWER_CONTROL_SENT        = 0x0C,
     IPMIPOWER_PROTOCOL_STATE_CLOSE_SESSION_SENT                   = 0x0D,
     IPMIPOWER_PROTOCOL_STATE_END                                  = 0x0E,
+    IPMIPOWER_PROTOCOL_STATE_SESSION_IDLE                         = 0x0F,
   } ipmipower_protocol_state_t;
 
 #define IPMIPOWER_PROTOCOL_STATE_VALID(__s)    \
   (((__s) >= IPMIPOWER_PROTOCOL_STATE_START    \
-    && (__s) <= IPMIPOWER_PROTOCOL_STATE_END) ? 1 : 0)
+    && (__s) <= IPMIPOWER_PROTOCOL_STATE_SESSION_IDLE) ? 1 : 0)
 
 typedef enum
   {
@@ -346,6 +361,7 @@ struct ipmipower_powercmd {
    */
   struct timeval time_begin;
   unsigned int retransmission_count;
+  unsigned int retransmission_total;
   uint8_t close_timeout;
 
   /*
@@ -383,6 +399,10 @@ struct ipmipower_powercmd {
   int wait_until_on_state;
   int wait_until_off_state;
 
+  /* session reuse, see --session-idle-timeout */
+  int session_reusable;
+  int session_resumed;
+
   struct ipmipower_connection *ic;
 
   fiid_obj_t obj_rmcp_hdr_rq;
@@ -432,6 +452,16 @@ struct ipmipower_powercmd {
 
   /* for oem power control to the same node */
   struct ipmipower_powercmd *next;
+
+  /* for pending heap, see ipmipower_powercmd_process_pending() */
+  struct timeval next_process_time;
+  int pending_index;
+  unsigned int pending_sequence;
+
+  /* for wave scheduling, see ipmipower_wave.c */
+  int wave_admitted;
+  unsigned int wave_sequence;
+  struct timeval wave_start_time;
 };
 
 struct ipmipower_connection_extra_arg
@@ -459,6 +489,9 @@ struct ipmipower_connection
   struct timeval last_ipmi_recv;
   struct timeval last_ping_recv;
 
+  /* adaptive retransmission timeout, see --fixed-retransmission-timeout */
+  struct rtt rtt;
+
   ipmipower_link_state_t link_state;
   unsigned int ping_last_packet_recv_flag;
   unsigned int ping_packet_count_send;
@@ -480,6 +513,33 @@ struct ipmipower_connection
 
   /* for eliminate option */
   int skip;
+
+  /* power command executing on this connection, NULL if none */
+  struct ipmipower_powercmd *powercmd;
+
+  /* idle session kept for the next power command, NULL if none */
+  struct ipmipower_powercmd *session;
+
+  /* for wave scheduling, index of the hostrange this host was
+   * specified in, see --wave-groups
+   */
+  unsigned int wave_group;
+
+  /* for shared sockets, index of ipmi_fd and ping_fd in the shared
+   * socket array, other connections with the same destination
+   * address, and link in the list of connections with pending output.
+   */
+  int shared_ipmi_index;
+  int shared_ping_index;
+  struct ipmipower_connection *shared_next;
+  int shared_output_queued;
+  struct ipmipower_connection *shared_output_next;
+
+  /* for epoll event loop, see ipmipower_connection_event_update() */
+  unsigned int ics_index;
+  int ipmi_fd_registered;
+  uint32_t ipmi_fd_events;
+  uint32_t ping_fd_events;
 };
 
 typedef struct ipmipower_powercmd *ipmipower_powercmd_t;
@@ -508,6 +568,12 @@ enum ipmipower_argp_option_keys
     PING_PACKET_COUNT_KEY = 174,
     PING_PERCENT_KEY = 175,
     PING_CONSEC_COUNT_KEY = 176,
+    SHARED_SOCKETS_KEY = 177,
+    SESSION_IDLE_TIMEOUT_KEY = 178,
+    WAVE_WINDOW_KEY = 179,
+    WAVE_RATE_KEY = 180,
+    WAVE_GROUPS_KEY = 181,
+    FIXED_RETRANSMISSION_TIMEOUT_KEY = 182,
   };
 
 struct ipmipower_arguments
@@ -525,11 +591,17 @@ struct ipmipower_arguments
 
   unsigned int retransmission_wait_timeout;
   unsigned int retransmission_backoff_count;
+  int fixed_retransmission_timeout;
   unsigned int ping_interval;
   unsigned int ping_timeout;
   unsigned int ping_packet_count;
   unsigned int ping_percent;
   unsigned int ping_consec_count;
+  unsigned int shared_sockets;
+  unsigned int session_idle_timeout;
+  unsigned int wave_window;
+  unsigned int wave_rate;
+  int wave_groups;
 };
 
 #endif /* IPMIPOWER_H */
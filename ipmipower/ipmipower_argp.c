@@ -106,6 +106,8 @@ static struct argp_option cmdline_options[] =
       "Specify the retransmission timeout length in milliseconds.", 52},
     { "retransmission-backoff-count", RETRANSMISSION_BACKOFF_COUNT_KEY, "COUNT", 0,
       "Specify the retransmission backoff count for retransmissions.", 53},
+    { "fixed-retransmission-timeout", FIXED_RETRANSMISSION_TIMEOUT_KEY, 0, 0,
+      "Do not adapt the retransmission timeout to measured round trip times.", 53},
     { "ping-interval", PING_INTERVAL_KEY, "MILLISECONDS", 0,
       "Specify the ping interval length in milliseconds.", 54},
     { "ping-timeout", PING_TIMEOUT_KEY, "MILLISECONDS", 0,
@@ -116,9 +118,19 @@ static struct argp_option cmdline_options[] =
       "Specify the ping percent value.", 57},
     { "ping-consec-count", PING_CONSEC_COUNT_KEY, "COUNT", 0,
       "Specify the ping consecutive count.", 58},
+    { "shared-sockets", SHARED_SOCKETS_KEY, "COUNT", 0,
+      "Multiplex all hosts over COUNT shared sockets instead of opening sockets per host.", 59},
+    { "session-idle-timeout", SESSION_IDLE_TIMEOUT_KEY, "MILLISECONDS", 0,
+      "Specify how long sessions are kept open for reuse in interactive mode.", 60},
+    { "wave-window", WAVE_WINDOW_KEY, "COUNT", 0,
+      "Schedule power commands in waves, with at most COUNT in flight.", 61},
+    { "wave-rate", WAVE_RATE_KEY, "HOSTS_PER_SECOND", 0,
+      "Schedule power commands in waves, starting at most HOSTS_PER_SECOND.", 62},
+    { "wave-groups", WAVE_GROUPS_KEY, 0, 0,
+      "Schedule power commands in waves, one hostrange at a time.", 63},
 #ifndef NDEBUG
     { "rmcpdump", RMCPDUMP_KEY, 0, 0,
-      "Turn on RMCP packet dump output.", 59},
+      "Turn on RMCP packet dump output.", 64},
 #endif
     { NULL, 0, NULL, 0, NULL, 0}
   };
@@ -225,6 +237,9 @@ cmdline_parse (int key,
         }
       cmd_args->retransmission_backoff_count = tmp;
       break;
+    case FIXED_RETRANSMISSION_TIMEOUT_KEY:       /* --fixed-retransmission-timeout */
+      cmd_args->fixed_retransmission_timeout++;
+      break;
     case PING_INTERVAL_KEY:       /* --ping-interval */
       errno = 0;
       tmp = strtol (arg, &endptr, 10);
@@ -285,6 +300,61 @@ cmdline_parse (int key,
         }
       cmd_args->ping_consec_count = tmp;
       break;
+    case SHARED_SOCKETS_KEY:       /* --shared-sockets */
+      errno = 0;
+      tmp = strtol (arg, &endptr, 10);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp < 0
+          || tmp > IPMIPOWER_SHARED_SOCKETS_MAX)
+        {
+          fprintf (stderr, "shared sockets count invalid");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->shared_sockets = tmp;
+      break;
+    case SESSION_IDLE_TIMEOUT_KEY:       /* --session-idle-timeout */
+      errno = 0;
+      tmp = strtol (arg, &endptr, 10);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp < 0
+          || tmp > IPMIPOWER_SESSION_IDLE_TIMEOUT_MAX)
+        {
+          fprintf (stderr, "session idle timeout length invalid");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->session_idle_timeout = tmp;
+      break;
+    case WAVE_WINDOW_KEY:       /* --wave-window */
+      errno = 0;
+      tmp = strtol (arg, &endptr, 10);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp < 0
+          || tmp > IPMIPOWER_WAVE_WINDOW_MAX)
+        {
+          fprintf (stderr, "wave window invalid");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->wave_window = tmp;
+      break;
+    case WAVE_RATE_KEY:       /* --wave-rate */
+      errno = 0;
+      tmp = strtol (arg, &endptr, 10);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp < 0
+          || tmp > IPMIPOWER_WAVE_RATE_MAX)
+        {
+          fprintf (stderr, "wave rate invalid");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->wave_rate = tmp;
+      break;
+    case WAVE_GROUPS_KEY:       /* --wave-groups */
+      cmd_args->wave_groups++;
+      break;
       /* removed legacy short options */
     default:
       return (common_parse_opt (key, arg, &(cmd_args->common_args)));
@@ -328,6 +398,8 @@ _ipmipower_config_file_parse (struct ipmipower_arguments *cmd_args)
     cmd_args->retransmission_wait_timeout = config_file_data.retransmission_wait_timeout;
   if (config_file_data.retransmission_backoff_count_count)
     cmd_args->retransmission_backoff_count = config_file_data.retransmission_backoff_count;
+  if (config_file_data.fixed_retransmission_timeout_count)
+    cmd_args->fixed_retransmission_timeout = config_file_data.fixed_retransmission_timeout;
   if (config_file_data.ping_interval_count)
     cmd_args->ping_interval = config_file_data.ping_interval;
   if (config_file_data.ping_timeout_count)
@@ -338,6 +410,16 @@ _ipmipower_config_file_parse (struct ipmipower_arguments *cmd_args)
     cmd_args->ping_percent = config_file_data.ping_percent;
   if (config_file_data.ping_consec_count_count)
     cmd_args->ping_consec_count = config_file_data.ping_consec_count;
+  if (config_file_data.shared_sockets_count)
+    cmd_args->shared_sockets = config_file_data.shared_sockets;
+  if (config_file_data.session_idle_timeout_count)
+    cmd_args->session_idle_timeout = config_file_data.session_idle_timeout;
+  if (config_file_data.wave_window_count)
+    cmd_args->wave_window = config_file_data.wave_window;
+  if (config_file_data.wave_rate_count)
+    cmd_args->wave_rate = config_file_data.wave_rate;
+  if (config_file_data.wave_groups_count)
+    cmd_args->wave_groups = config_file_data.wave_groups;
 }
 
 static void
@@ -374,6 +456,36 @@ _ipmipower_args_validate (struct ipmipower_arguments *cmd_args)
       fprintf (stderr, "ping consec count larger than ping packet count\n");
       exit (EXIT_FAILURE);
     }
+
+  if (cmd_args->shared_sockets > IPMIPOWER_SHARED_SOCKETS_MAX)
+    {
+      fprintf (stderr, "shared sockets count too large\n");
+      exit (EXIT_FAILURE);
+    }
+
+  if (cmd_args->session_idle_timeout > IPMIPOWER_SESSION_IDLE_TIMEOUT_MAX)
+    {
+      fprintf (stderr, "session idle timeout too large\n");
+      exit (EXIT_FAILURE);
+    }
+
+  if (cmd_args->wave_window > IPMIPOWER_WAVE_WINDOW_MAX)
+    {
+      fprintf (stderr, "wave window too large\n");
+      exit (EXIT_FAILURE);
+    }
+
+  if (cmd_args->wave_rate > IPMIPOWER_WAVE_RATE_MAX)
+    {
+      fprintf (stderr, "wave rate too large\n");
+      exit (EXIT_FAILURE);
+    }
+
+  /* groups are scheduled by the wave scheduler, so turn it on */
+  if (cmd_args->wave_groups
+      && !cmd_args->wave_window
+      && !cmd_args->wave_rate)
+    cmd_args->wave_window = IPMIPOWER_WAVE_WINDOW_MAX;
 }
 
 void
@@ -402,11 +514,17 @@ ipmipower_argp_parse (int argc, char **argv, struct ipmipower_arguments *cmd_arg
   cmd_args->oem_power_type = IPMIPOWER_OEM_POWER_TYPE_NONE;
   cmd_args->retransmission_wait_timeout = 500; /* .5 seconds  */
   cmd_args->retransmission_backoff_count = 8;
+  cmd_args->fixed_retransmission_timeout = 0;
   cmd_args->ping_interval = 5000; /* 5 seconds */
   cmd_args->ping_timeout = 30000; /* 30 seconds */
   cmd_args->ping_packet_count = 10;
   cmd_args->ping_percent = 50;
   cmd_args->ping_consec_count = 5;
+  cmd_args->shared_sockets = 0;
+  cmd_args->session_idle_timeout = 0;
+  cmd_args->wave_window = 0;
+  cmd_args->wave_rate = 0;
+  cmd_args->wave_groups = 0;
 
   argp_parse (&cmdline_config_file_argp,
               argc,
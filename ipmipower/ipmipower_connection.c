@@ -45,6 +45,9 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <errno.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif /* HAVE_SYS_EPOLL_H */
 
 #include <stdint.h>
 #include <sys/socket.h>
@@ -60,7 +63,9 @@
 #include "freeipmi-portability.h"
 #include "cbuf.h"
 #include "fi_hostlist.h"
+#include "hash.h"
 #include "network.h"
+#include "timeval.h"
 
 extern cbuf_t ttyout;
 
@@ -69,6 +74,43 @@ extern struct ipmipower_arguments cmd_args;
 #define IPMIPOWER_MIN_CONNECTION_BUF 1024*2
 #define IPMIPOWER_MAX_CONNECTION_BUF 1024*4
 
+#define IPMIPOWER_EPOLL_SIZE_HINT    1024
+
+#define IPMIPOWER_SHARED_HASH_SIZE   1024
+
+/* offsets into IPMI 2.0 packets for shared socket demultiplexing */
+#define IPMIPOWER_RMCP_MESSAGE_CLASS_OFFSET          3
+#define IPMIPOWER_RMCP_MESSAGE_CLASS_MASK            0x1F
+#define IPMIPOWER_IPMI_AUTHENTICATION_TYPE_OFFSET    4
+#define IPMIPOWER_IPMI_2_0_PAYLOAD_TYPE_OFFSET       5
+#define IPMIPOWER_IPMI_2_0_PAYLOAD_TYPE_MASK         0x3F
+#define IPMIPOWER_IPMI_2_0_SESSION_ID_OFFSET         6
+#define IPMIPOWER_IPMI_2_0_PAYLOAD_OFFSET            16
+#define IPMIPOWER_IPMI_2_0_PAYLOAD_SESSION_ID_OFFSET 4
+
+/* epoll set all connection fds are registered with, -1 if poll()
+ * is used instead
+ */
+static int connection_epfd = -1;
+
+/* Shared sockets, see --shared-sockets.  The first
+ * cmd_args.shared_sockets entries are AF_INET sockets, the remainder
+ * AF_INET6.  Sockets are opened on first use, -1 if not yet opened.
+ */
+static int *shared_fds = NULL;
+static unsigned int shared_fds_len = 0;
+static unsigned int shared_fds_next4 = 0;
+static unsigned int shared_fds_next6 = 0;
+
+/* destination address -> connection for the ics array it was built
+ * from, rebuilt when the ics array changes.
+ */
+static hash_t shared_hash = NULL;
+static struct ipmipower_connection *shared_hash_ics = NULL;
+
+/* connections with output waiting to be sent on shared sockets */
+static struct ipmipower_connection *shared_output = NULL;
+
 /* _clean_fd
  * - Remove any extraneous packets sitting on the fd buf
  */
@@ -110,7 +152,9 @@ ipmipower_connection_clear (struct ipmipower_connection *ic)
 {
   assert (ic);
 
-  _clean_fd (ic->ipmi_fd);
+  /* other hosts' packets may be sitting on a shared socket */
+  if (!cmd_args.shared_sockets)
+    _clean_fd (ic->ipmi_fd);
   if (cbuf_drop (ic->ipmi_in, -1) < 0)
     {
       IPMIPOWER_ERROR (("cbuf_drop: %s", strerror (errno)));
@@ -124,6 +168,92 @@ ipmipower_connection_clear (struct ipmipower_connection *ic)
   return;
 }
 
+/* _shared_socket_get
+ * - Get next shared socket of family, round robin, opening it if
+ *   necessary.
+ * - Returns fd on success, -1 on EMFILE or unsupported family.
+ */
+static int
+_shared_socket_get (int family, int *index)
+{
+  struct sockaddr_in6 srcaddr6;
+  struct sockaddr_in srcaddr4;
+  struct sockaddr *srcaddr;
+  socklen_t srcaddrlen;
+  unsigned int i;
+
+  assert (cmd_args.shared_sockets);
+  assert (index);
+
+  if (!shared_fds)
+    {
+      shared_fds_len = cmd_args.shared_sockets * 2;
+
+      if (!(shared_fds = (int *)malloc (sizeof (int) * shared_fds_len)))
+        {
+          IPMIPOWER_ERROR (("malloc: %s", strerror (errno)));
+          exit (EXIT_FAILURE);
+        }
+
+      for (i = 0; i < shared_fds_len; i++)
+        shared_fds[i] = -1;
+    }
+
+  if (family == AF_INET)
+    {
+      i = shared_fds_next4++ % cmd_args.shared_sockets;
+
+      /* zero everywhere, secure ephemeral port */
+      memset (&srcaddr4, '\0', sizeof (struct sockaddr_in));
+      srcaddr4.sin_family = AF_INET;
+      srcaddr = (struct sockaddr *)&srcaddr4;
+      srcaddrlen = sizeof (struct sockaddr_in);
+    }
+  else if (family == AF_INET6)
+    {
+      i = cmd_args.shared_sockets + (shared_fds_next6++ % cmd_args.shared_sockets);
+
+      /* zero everywhere, secure ephemeral port */
+      memset (&srcaddr6, '\0', sizeof (struct sockaddr_in6));
+      srcaddr6.sin6_family = AF_INET6;
+      srcaddr = (struct sockaddr *)&srcaddr6;
+      srcaddrlen = sizeof (struct sockaddr_in6);
+    }
+  else
+    {
+      errno = EAFNOSUPPORT;
+      return (-1);
+    }
+
+  if (shared_fds[i] < 0)
+    {
+      int fd;
+
+      if ((fd = socket (family, SOCK_DGRAM, 0)) < 0)
+        {
+          if (errno == EMFILE)
+            {
+              IPMIPOWER_DEBUG (("file descriptor limit reached"));
+              return (-1);
+            }
+          IPMIPOWER_ERROR (("socket: %s", strerror (errno)));
+          exit (EXIT_FAILURE);
+        }
+
+      if (bind (fd, srcaddr, srcaddrlen) < 0)
+        {
+          /* ignore potential error, error path */
+          close (fd);
+          return (-1);
+        }
+
+      shared_fds[i] = fd;
+    }
+
+  *index = i;
+  return (shared_fds[i]);
+}
+
 static int
 _connection_setup (struct ipmipower_connection *ic, const char *hostname)
 {
@@ -197,6 +327,8 @@ _connection_setup (struct ipmipower_connection *ic, const char *hostname)
   memset (&ic->last_ipmi_recv, '\0', sizeof (struct timeval));
   memset (&ic->last_ping_recv, '\0', sizeof (struct timeval));
 
+  rtt_init (&ic->rtt, cmd_args.common_args.retransmission_timeout);
+
   ic->link_state = IPMIPOWER_LINK_STATE_GOOD; /* assumed good to begin with */
   ic->ping_last_packet_recv_flag = 0;
   ic->ping_packet_count_send = 0;
@@ -311,25 +443,42 @@ _connection_setup (struct ipmipower_connection *ic, const char *hostname)
   /* Try all of the different answers we got, until we succeed. */
   for (ai = ai_res; ai != NULL; ai = ai->ai_next)
     {
-      if ((ic->ipmi_fd = socket (ai->ai_family,
-				 ai->ai_socktype, ai->ai_protocol)) < 0)
-	{
-	  if (errno == EMFILE)
-	    {
-	      IPMIPOWER_DEBUG (("file descriptor limit reached"));
-	      return (-1);
-	    }
-	}
+      if (cmd_args.shared_sockets)
+        {
+          /* unsupported families are skipped here too */
+          if ((ic->ipmi_fd = _shared_socket_get (ai->ai_family,
+                                                 &ic->shared_ipmi_index)) < 0
+              || (ic->ping_fd = _shared_socket_get (ai->ai_family,
+                                                    &ic->shared_ping_index)) < 0)
+            {
+              if (errno == EMFILE)
+                return (-1);
+              ic->ipmi_fd = ic->ping_fd = -1;
+              continue;
+            }
+        }
+      else
+        {
+          if ((ic->ipmi_fd = socket (ai->ai_family,
+                                     ai->ai_socktype, ai->ai_protocol)) < 0)
+            {
+              if (errno == EMFILE)
+                {
+                  IPMIPOWER_DEBUG (("file descriptor limit reached"));
+                  return (-1);
+                }
+            }
 
-      if ((ic->ping_fd = socket (ai->ai_family,
-				 ai->ai_socktype, ai->ai_protocol)) < 0)
-	{
-	  if (errno == EMFILE)
-	    {
-	      IPMIPOWER_DEBUG (("file descriptor limit reached"));
-	      return (-1);
-	    }
-	}
+          if ((ic->ping_fd = socket (ai->ai_family,
+                                     ai->ai_socktype, ai->ai_protocol)) < 0)
+            {
+              if (errno == EMFILE)
+                {
+                  IPMIPOWER_DEBUG (("file descriptor limit reached"));
+                  return (-1);
+                }
+            }
+        }
 
       if (ai->ai_family == AF_INET)
         {
@@ -363,8 +512,10 @@ _connection_setup (struct ipmipower_connection *ic, const char *hostname)
 	  continue;
         }
 
-      if ((bind (ic->ipmi_fd, ic->srcaddr, ic->srcaddrlen) < 0)
-          || (bind (ic->ping_fd, ic->srcaddr, ic->srcaddrlen) < 0))
+      /* shared sockets are bound when opened */
+      if (!cmd_args.shared_sockets
+          && ((bind (ic->ipmi_fd, ic->srcaddr, ic->srcaddrlen) < 0)
+              || (bind (ic->ping_fd, ic->srcaddr, ic->srcaddrlen) < 0)))
 	{
 	  close(ic->ipmi_fd);
 	  close(ic->ping_fd);
@@ -562,6 +713,131 @@ _hostname_count (const char *hostname)
   return (rv);
 }
 
+/* _connection_wave_groups
+ * - Assign each connection the index of the first comma separated
+ *   hostrange in hostname it is part of, for --wave-groups.
+ */
+static void
+_connection_wave_groups (struct ipmipower_connection *ics,
+                         unsigned int ics_len,
+                         const char *hostname)
+{
+  fi_hostlist_t *groups = NULL;
+  unsigned int groups_len = 0;
+  const char *start;
+  const char *ptr;
+  int depth = 0;
+  unsigned int i, j;
+
+  assert (ics);
+  assert (hostname);
+
+  /* split on commas outside of brackets, i.e. "foo[1-3,5],bar[1-2]"
+   * is two hostranges
+   */
+  start = ptr = hostname;
+  while (1)
+    {
+      if (*ptr == '[')
+        depth++;
+      else if (*ptr == ']' && depth)
+        depth--;
+      else if ((*ptr == ',' && !depth) || *ptr == '\0')
+        {
+          if (ptr > start)
+            {
+              fi_hostlist_t h = NULL;
+              fi_hostlist_t h2 = NULL;
+              fi_hostlist_iterator_t hitr = NULL;
+              fi_hostlist_t *tmp;
+              char *range;
+              char *hstr;
+
+              if (!(range = strndup (start, ptr - start)))
+                {
+                  IPMIPOWER_ERROR (("strndup: %s", strerror (errno)));
+                  exit (EXIT_FAILURE);
+                }
+
+              if (!(h2 = fi_hostlist_create (NULL)))
+                {
+                  IPMIPOWER_ERROR (("fi_hostlist_create: %s", strerror (errno)));
+                  exit (EXIT_FAILURE);
+                }
+
+              /* hostname was already parsed, so this can only fail if
+               * the split was wrong, in which case the hosts fall into
+               * the first group
+               */
+              if ((h = fi_hostlist_create (range)))
+                {
+                  if (!(hitr = fi_hostlist_iterator_create (h)))
+                    {
+                      IPMIPOWER_ERROR (("fi_hostlist_iterator_create: %s", strerror (errno)));
+                      exit (EXIT_FAILURE);
+                    }
+
+                  /* connections are named w/o the extra arg */
+                  while ((hstr = fi_hostlist_next (hitr)))
+                    {
+                      char *eptr;
+
+                      if (cmd_args.oem_power_type != IPMIPOWER_OEM_POWER_TYPE_NONE)
+                        {
+                          if ((eptr = strchr (hstr, '+')))
+                            *eptr = '\0';
+                        }
+
+                      if (!fi_hostlist_push (h2, hstr))
+                        {
+                          IPMIPOWER_ERROR (("fi_hostlist_push: %s", strerror(errno)));
+                          exit (EXIT_FAILURE);
+                        }
+
+                      free (hstr);
+                    }
+
+                  fi_hostlist_iterator_destroy (hitr);
+                  fi_hostlist_destroy (h);
+                }
+
+              free (range);
+
+              if (!(tmp = (fi_hostlist_t *)realloc (groups, sizeof (fi_hostlist_t) * (groups_len + 1))))
+                {
+                  IPMIPOWER_ERROR (("realloc: %s", strerror (errno)));
+                  exit (EXIT_FAILURE);
+                }
+              groups = tmp;
+              groups[groups_len++] = h2;
+            }
+
+          if (*ptr == '\0')
+            break;
+
+          start = ptr + 1;
+        }
+      ptr++;
+    }
+
+  for (i = 0; i < ics_len; i++)
+    {
+      ics[i].wave_group = 0;
+      for (j = 0; j < groups_len; j++)
+        {
+          if (fi_hostlist_find (groups[j], ics[i].hostname) >= 0)
+            {
+              ics[i].wave_group = j;
+              break;
+            }
+        }
+    }
+
+  for (j = 0; j < groups_len; j++)
+    fi_hostlist_destroy (groups[j]);
+  free (groups);
+}
+
 struct ipmipower_connection *
 ipmipower_connection_array_create (const char *hostname, unsigned int *len)
 {
@@ -597,6 +873,8 @@ ipmipower_connection_array_create (const char *hostname, unsigned int *len)
     {
       ics[i].ipmi_fd = -1;
       ics[i].ping_fd = -1;
+      ics[i].ics_index = i;
+      ics[i].ipmi_fd_registered = -1;
     }
 
   if (!(h = fi_hostlist_create (hostname)))
@@ -748,10 +1026,13 @@ ipmipower_connection_array_create (const char *hostname, unsigned int *len)
       int i;
       for (i = 0; i < index; i++)
         {
-          /* ignore potential error, error path */
-          close (ics[i].ipmi_fd);
-          /* ignore potential error, error path */
-          close (ics[i].ping_fd);
+          if (!cmd_args.shared_sockets)
+            {
+              /* ignore potential error, error path */
+              close (ics[i].ipmi_fd);
+              /* ignore potential error, error path */
+              close (ics[i].ping_fd);
+            }
           if (ics[i].ipmi_in)
             cbuf_destroy (ics[i].ipmi_in);
           if (ics[i].ipmi_out)
@@ -782,6 +1063,15 @@ ipmipower_connection_array_create (const char *hostname, unsigned int *len)
       return (NULL);
     }
 
+  if (cmd_args.wave_groups)
+    _connection_wave_groups (ics, index, hostname);
+
+  /* register each connection once, registrations are only updated
+   * when output is pending or the ipmi_fd changes.
+   */
+  for (i = 0; i < index; i++)
+    ipmipower_connection_event_update (&ics[i]);
+
   *len = index;
   return (ics);
 }
@@ -795,12 +1085,42 @@ ipmipower_connection_array_destroy (struct ipmipower_connection *ics,
   if (!ics)
     return;
 
+  if (cmd_args.shared_sockets)
+    {
+      struct ipmipower_connection *ic;
+      struct ipmipower_connection **icp;
+
+      /* in interactive mode, the new ics array is created before the
+       * old one is destroyed, so this array may not be the one the
+       * lookup hash was built from.
+       */
+      if (shared_hash_ics == ics)
+        {
+          hash_destroy (shared_hash);
+          shared_hash = NULL;
+          shared_hash_ics = NULL;
+        }
+
+      icp = &shared_output;
+      while ((ic = *icp))
+        {
+          if (ic >= ics && ic < ics + ics_len)
+            *icp = ic->shared_output_next;
+          else
+            icp = &ic->shared_output_next;
+        }
+    }
+
   for (i = 0; i < ics_len; i++)
     {
-      /* ignore potential error, cleanup path */
-      close (ics[i].ipmi_fd);
-      /* ignore potential error, cleanup path */
-      close (ics[i].ping_fd);
+      /* shared sockets are closed in ipmipower_connection_shared_cleanup() */
+      if (!cmd_args.shared_sockets)
+        {
+          /* ignore potential error, cleanup path */
+          close (ics[i].ipmi_fd);
+          /* ignore potential error, cleanup path */
+          close (ics[i].ping_fd);
+        }
       cbuf_destroy (ics[i].ipmi_in);
       cbuf_destroy (ics[i].ipmi_out);
       cbuf_destroy (ics[i].ping_in);
@@ -826,6 +1146,162 @@ ipmipower_connection_array_destroy (struct ipmipower_connection *ics,
   free (ics);
 }
 
+void
+ipmipower_connection_sendto (cbuf_t cbuf,
+                             int fd,
+                             struct sockaddr *destaddr,
+                             socklen_t destaddrlen)
+{
+  int n, rv;
+  uint8_t buf[IPMIPOWER_PACKET_BUFLEN];
+
+  if ((n = cbuf_read (cbuf, buf, IPMIPOWER_PACKET_BUFLEN)) < 0)
+    {
+      IPMIPOWER_ERROR (("cbuf_read: %s", fd, strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  if (n == IPMIPOWER_PACKET_BUFLEN)
+    {
+      IPMIPOWER_ERROR (("cbuf_read: buffer full"));
+      exit (EXIT_FAILURE);
+    }
+
+  do
+    {
+      if (cmd_args.common_args.driver_type == IPMI_DEVICE_LAN)
+        rv = ipmi_lan_sendto (fd,
+                              buf,
+                              n,
+                              0,
+                              destaddr,
+                              destaddrlen);
+      else
+        {
+          if (ipmi_is_ipmi_1_5_packet (buf, n))
+            rv = ipmi_lan_sendto (fd,
+                                  buf,
+                                  n,
+                                  0,
+                                  destaddr,
+                                  destaddrlen);
+          else
+            rv = ipmi_rmcpplus_sendto (fd,
+                                       buf,
+                                       n,
+                                       0,
+                                       destaddr,
+                                       destaddrlen);
+        }
+    } while (rv < 0 && errno == EINTR);
+
+  if (rv < 0)
+    {
+      IPMIPOWER_ERROR (("ipmi_lan/rmcpplus_sendto: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  /* cbuf should be empty now */
+  if (!cbuf_is_empty (cbuf))
+    {
+      IPMIPOWER_ERROR (("cbuf not empty"));
+      exit (EXIT_FAILURE);
+    }
+}
+
+void
+ipmipower_connection_array_flush (struct ipmipower_connection *ics,
+                                  unsigned int ics_len,
+                                  unsigned int timeout)
+{
+  struct pollfd *pfds = NULL;
+  unsigned int *pfds_index = NULL;
+  struct timeval start, now, delta;
+  unsigned int i;
+
+  if (!ics || !ics_len)
+    return;
+
+  if (!(pfds = (struct pollfd *)malloc (sizeof (struct pollfd) * ics_len)))
+    {
+      IPMIPOWER_ERROR (("malloc: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  if (!(pfds_index = (unsigned int *)malloc (sizeof (unsigned int) * ics_len)))
+    {
+      IPMIPOWER_ERROR (("malloc: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  if (gettimeofday (&start, NULL) < 0)
+    {
+      IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  while (1)
+    {
+      unsigned int nfds = 0;
+      unsigned int elapsed;
+
+      for (i = 0; i < ics_len; i++)
+        {
+          if (cbuf_is_empty (ics[i].ipmi_out))
+            continue;
+
+          if (ics[i].ipmi_fd < 0)
+            {
+              cbuf_drop (ics[i].ipmi_out, -1);
+              continue;
+            }
+
+          pfds[nfds].fd = ics[i].ipmi_fd;
+          pfds[nfds].events = POLLOUT;
+          pfds[nfds].revents = 0;
+          pfds_index[nfds] = i;
+          nfds++;
+        }
+
+      if (!nfds)
+        break;
+
+      if (gettimeofday (&now, NULL) < 0)
+        {
+          IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
+          exit (EXIT_FAILURE);
+        }
+
+      timeval_sub (&now, &start, &delta);
+      timeval_millisecond_calc (&delta, &elapsed);
+
+      if (elapsed >= timeout)
+        {
+          IPMIPOWER_DEBUG (("%u connections not flushed", nfds));
+          break;
+        }
+
+      ipmipower_poll (pfds, nfds, timeout - elapsed);
+
+      for (i = 0; i < nfds; i++)
+        {
+          struct ipmipower_connection *ic = &ics[pfds_index[i]];
+
+          /* don't let an unreachable host hold everyone up */
+          if (pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+            cbuf_drop (ic->ipmi_out, -1);
+          else if (pfds[i].revents & POLLOUT)
+            ipmipower_connection_sendto (ic->ipmi_out,
+                                         ic->ipmi_fd,
+                                         ic->destaddr,
+                                         ic->destaddrlen);
+        }
+    }
+
+  free (pfds);
+  free (pfds_index);
+}
+
 int
 ipmipower_connection_hostname_index (struct ipmipower_connection *ics,
                                      unsigned int ics_len,
@@ -844,3 +1320,449 @@ ipmipower_connection_hostname_index (struct ipmipower_connection *ics,
   IPMIPOWER_DEBUG (("host = %s not found", hostname));
   return (-1);
 }
+
+int
+ipmipower_connection_event_setup (void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  assert (connection_epfd < 0);
+
+  /* the handful of shared sockets are polled directly */
+  if (cmd_args.shared_sockets)
+    return (-1);
+
+  /* size argument is a hint, ignored on modern kernels */
+  if ((connection_epfd = epoll_create (IPMIPOWER_EPOLL_SIZE_HINT)) < 0)
+    {
+      if (errno != ENOSYS)
+        {
+          IPMIPOWER_ERROR (("epoll_create: %s", strerror (errno)));
+          exit (EXIT_FAILURE);
+        }
+      IPMIPOWER_DEBUG (("epoll not supported, using poll"));
+      connection_epfd = -1;
+    }
+
+  return (connection_epfd);
+#else /* !HAVE_SYS_EPOLL_H */
+  return (-1);
+#endif /* !HAVE_SYS_EPOLL_H */
+}
+
+void
+ipmipower_connection_event_cleanup (void)
+{
+  if (connection_epfd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (connection_epfd);
+      connection_epfd = -1;
+    }
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static void
+_event_ctl (int op, int fd, uint32_t events, uint64_t data)
+{
+  struct epoll_event ev;
+
+  memset (&ev, '\0', sizeof (struct epoll_event));
+  ev.events = events;
+  ev.data.u64 = data;
+
+  if (epoll_ctl (connection_epfd, op, fd, &ev) < 0)
+    {
+      /* fd was closed and the number reused since it was
+       * registered, the kernel already dropped the old registration
+       */
+      if (op == EPOLL_CTL_MOD && errno == ENOENT)
+        {
+          _event_ctl (EPOLL_CTL_ADD, fd, events, data);
+          return;
+        }
+
+      IPMIPOWER_ERROR (("epoll_ctl: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
+void
+ipmipower_connection_event_update (struct ipmipower_connection *ic)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  uint32_t ipmi_events;
+  uint32_t ping_events;
+#endif /* HAVE_SYS_EPOLL_H */
+
+  assert (ic);
+
+  if (cmd_args.shared_sockets)
+    {
+      if (!ic->shared_output_queued
+          && (!cbuf_is_empty (ic->ipmi_out)
+              || !cbuf_is_empty (ic->ping_out)))
+        {
+          ic->shared_output_next = shared_output;
+          shared_output = ic;
+          ic->shared_output_queued = 1;
+        }
+      return;
+    }
+
+#ifdef HAVE_SYS_EPOLL_H
+
+  if (connection_epfd < 0)
+    return;
+
+  ipmi_events = EPOLLIN;
+  if (!cbuf_is_empty (ic->ipmi_out))
+    ipmi_events |= EPOLLOUT;
+
+  /* Unlike the poll() loop, always listen on the ping fd, the ping
+   * interval may be changed at the prompt without any notification
+   * to us.
+   */
+  ping_events = EPOLLIN;
+  if (!cbuf_is_empty (ic->ping_out))
+    ping_events |= EPOLLOUT;
+
+  if (ic->ipmi_fd_registered != ic->ipmi_fd)
+    {
+      /* ipmi_fd was replaced, see _retry_packets() in
+       * ipmipower_powercmd.c.  The old fd is still open on the
+       * powercmd's sockets_to_close list, so remove it now before it
+       * is closed and its number potentially reused.
+       */
+      if (ic->ipmi_fd_registered >= 0)
+        {
+          struct epoll_event ev;
+
+          /* ev ignored, but required non-NULL on older kernels */
+          if (epoll_ctl (connection_epfd,
+                         EPOLL_CTL_DEL,
+                         ic->ipmi_fd_registered,
+                         &ev) < 0
+              && errno != ENOENT
+              && errno != EBADF)
+            {
+              IPMIPOWER_ERROR (("epoll_ctl: %s", strerror (errno)));
+              exit (EXIT_FAILURE);
+            }
+        }
+      else
+        {
+          /* first registration of this connection */
+          _event_ctl (EPOLL_CTL_ADD,
+                      ic->ping_fd,
+                      ping_events,
+                      IPMIPOWER_CONNECTION_EVENT_DATA (ic->ics_index, 1));
+          ic->ping_fd_events = ping_events;
+        }
+
+      _event_ctl (EPOLL_CTL_ADD,
+                  ic->ipmi_fd,
+                  ipmi_events,
+                  IPMIPOWER_CONNECTION_EVENT_DATA (ic->ics_index, 0));
+      ic->ipmi_fd_registered = ic->ipmi_fd;
+      ic->ipmi_fd_events = ipmi_events;
+    }
+  else if (ic->ipmi_fd_events != ipmi_events)
+    {
+      _event_ctl (EPOLL_CTL_MOD,
+                  ic->ipmi_fd,
+                  ipmi_events,
+                  IPMIPOWER_CONNECTION_EVENT_DATA (ic->ics_index, 0));
+      ic->ipmi_fd_events = ipmi_events;
+    }
+
+  if (ic->ping_fd_events != ping_events)
+    {
+      _event_ctl (EPOLL_CTL_MOD,
+                  ic->ping_fd,
+                  ping_events,
+                  IPMIPOWER_CONNECTION_EVENT_DATA (ic->ics_index, 1));
+      ic->ping_fd_events = ping_events;
+    }
+#endif /* HAVE_SYS_EPOLL_H */
+}
+
+const int *
+ipmipower_connection_shared_fds (unsigned int *len)
+{
+  assert (len);
+
+  *len = shared_fds_len;
+  return (shared_fds);
+}
+
+void
+ipmipower_connection_shared_cleanup (void)
+{
+  unsigned int i;
+
+  for (i = 0; i < shared_fds_len; i++)
+    {
+      /* ignore potential error, cleanup path */
+      if (shared_fds[i] >= 0)
+        close (shared_fds[i]);
+    }
+  free (shared_fds);
+  shared_fds = NULL;
+  shared_fds_len = 0;
+
+  hash_destroy (shared_hash);
+  shared_hash = NULL;
+  shared_hash_ics = NULL;
+  shared_output = NULL;
+}
+
+int
+ipmipower_connection_shared_rotate (struct ipmipower_connection *ic)
+{
+  int fd, index;
+
+  assert (ic);
+  assert (cmd_args.shared_sockets);
+
+  if ((fd = _shared_socket_get (ic->srcaddr->sa_family, &index)) < 0)
+    return (-1);
+
+  ic->ipmi_fd = fd;
+  ic->shared_ipmi_index = index;
+  return (0);
+}
+
+/* _shared_addr
+ * - Get address and port from AF_INET or AF_INET6 sockaddr
+ */
+static void
+_shared_addr (const struct sockaddr *sa,
+              const uint8_t **addr,
+              unsigned int *addrlen,
+              uint16_t *port)
+{
+  assert (sa);
+  assert (addr);
+  assert (addrlen);
+  assert (port);
+
+  if (sa->sa_family == AF_INET6)
+    {
+      const struct sockaddr_in6 *sa6 = (const struct sockaddr_in6 *)sa;
+
+      *addr = (const uint8_t *)&(sa6->sin6_addr);
+      *addrlen = sizeof (sa6->sin6_addr);
+      *port = sa6->sin6_port;
+    }
+  else
+    {
+      const struct sockaddr_in *sa4 = (const struct sockaddr_in *)sa;
+
+      *addr = (const uint8_t *)&(sa4->sin_addr);
+      *addrlen = sizeof (sa4->sin_addr);
+      *port = sa4->sin_port;
+    }
+}
+
+static unsigned int
+_shared_hash_key (const void *key)
+{
+  const uint8_t *addr;
+  unsigned int addrlen;
+  uint16_t port;
+  unsigned int rv;
+  unsigned int i;
+
+  assert (key);
+
+  _shared_addr ((const struct sockaddr *)key, &addr, &addrlen, &port);
+
+  rv = port;
+  for (i = 0; i < addrlen; i++)
+    rv = (rv * 31) + addr[i];
+
+  return (rv);
+}
+
+static int
+_shared_hash_cmp (const void *key1, const void *key2)
+{
+  const struct sockaddr *sa1 = (const struct sockaddr *)key1;
+  const struct sockaddr *sa2 = (const struct sockaddr *)key2;
+  const uint8_t *addr1, *addr2;
+  unsigned int addrlen1, addrlen2;
+  uint16_t port1, port2;
+
+  assert (key1);
+  assert (key2);
+
+  if (sa1->sa_family != sa2->sa_family)
+    return (1);
+
+  _shared_addr (sa1, &addr1, &addrlen1, &port1);
+  _shared_addr (sa2, &addr2, &addrlen2, &port2);
+
+  if (port1 != port2)
+    return (1);
+
+  return (memcmp (addr1, addr2, addrlen1));
+}
+
+static void
+_shared_hash_build (struct ipmipower_connection *ics, unsigned int ics_len)
+{
+  unsigned int i;
+
+  assert (ics);
+  assert (ics_len);
+
+  hash_destroy (shared_hash);
+
+  if (!(shared_hash = hash_create (IPMIPOWER_SHARED_HASH_SIZE,
+                                   _shared_hash_key,
+                                   _shared_hash_cmp,
+                                   NULL)))
+    {
+      IPMIPOWER_ERROR (("hash_create: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  for (i = 0; i < ics_len; i++)
+    {
+      struct ipmipower_connection *ic;
+
+      ics[i].shared_next = NULL;
+
+      if (ics[i].ipmi_fd < 0)
+        continue;
+
+      /* multiple hostnames may resolve to the same address */
+      if ((ic = hash_find (shared_hash, ics[i].destaddr)))
+        {
+          while (ic->shared_next)
+            ic = ic->shared_next;
+          ic->shared_next = &ics[i];
+          continue;
+        }
+
+      if (!hash_insert (shared_hash, ics[i].destaddr, &ics[i]))
+        {
+          IPMIPOWER_ERROR (("hash_insert: %s", strerror (errno)));
+          exit (EXIT_FAILURE);
+        }
+    }
+
+  shared_hash_ics = ics;
+}
+
+struct ipmipower_connection *
+ipmipower_connection_shared_lookup (struct ipmipower_connection *ics,
+                                    unsigned int ics_len,
+                                    const struct sockaddr *from,
+                                    const uint8_t *pkt,
+                                    unsigned int pkt_len,
+                                    int *ping)
+{
+  struct ipmipower_connection *ic;
+  uint8_t message_class;
+  uint32_t session_id = 0;
+
+  assert (from);
+  assert (pkt);
+  assert (ping);
+  assert (cmd_args.shared_sockets);
+
+  if (!ics || !ics_len)
+    return (NULL);
+
+  if (pkt_len <= IPMIPOWER_RMCP_MESSAGE_CLASS_OFFSET)
+    return (NULL);
+
+  message_class = pkt[IPMIPOWER_RMCP_MESSAGE_CLASS_OFFSET] & IPMIPOWER_RMCP_MESSAGE_CLASS_MASK;
+  if (message_class == RMCP_HDR_MESSAGE_CLASS_ASF)
+    *ping = 1;
+  else if (message_class == RMCP_HDR_MESSAGE_CLASS_IPMI)
+    *ping = 0;
+  else
+    return (NULL);
+
+  if (shared_hash_ics != ics)
+    _shared_hash_build (ics, ics_len);
+
+  if (!(ic = hash_find (shared_hash, from)))
+    return (NULL);
+
+  if (!ic->shared_next || *ping)
+    return (ic);
+
+  /* Multiple hosts share this address, the IPMI 2.0 remote console
+   * session id we chose tells them apart.  It's in the session header
+   * after the session is established and in the payload of the open
+   * session response and RAKP 2/4 messages before that.
+   */
+  if (pkt_len >= IPMIPOWER_IPMI_2_0_PAYLOAD_OFFSET
+      && pkt[IPMIPOWER_IPMI_AUTHENTICATION_TYPE_OFFSET] == IPMI_AUTHENTICATION_TYPE_RMCPPLUS)
+    {
+      uint8_t payload_type;
+      unsigned int offset;
+
+      offset = IPMIPOWER_IPMI_2_0_SESSION_ID_OFFSET;
+      session_id = pkt[offset]
+        | (pkt[offset + 1] << 8)
+        | (pkt[offset + 2] << 16)
+        | ((uint32_t)pkt[offset + 3] << 24);
+
+      payload_type = pkt[IPMIPOWER_IPMI_2_0_PAYLOAD_TYPE_OFFSET] & IPMIPOWER_IPMI_2_0_PAYLOAD_TYPE_MASK;
+
+      offset = IPMIPOWER_IPMI_2_0_PAYLOAD_OFFSET + IPMIPOWER_IPMI_2_0_PAYLOAD_SESSION_ID_OFFSET;
+      if (!session_id
+          && (payload_type == IPMI_PAYLOAD_TYPE_RMCPPLUS_OPEN_SESSION_RESPONSE
+              || payload_type == IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_2
+              || payload_type == IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_4)
+          && pkt_len >= offset + 4)
+        session_id = pkt[offset]
+          | (pkt[offset + 1] << 8)
+          | (pkt[offset + 2] << 16)
+          | ((uint32_t)pkt[offset + 3] << 24);
+    }
+
+  if (session_id)
+    {
+      struct ipmipower_connection *icp;
+
+      for (icp = ic; icp; icp = icp->shared_next)
+        {
+          if (icp->powercmd
+              && icp->powercmd->remote_console_session_id == session_id)
+            return (icp);
+        }
+    }
+
+  /* IPMI 1.5 has no session id chosen by us, give it to the first
+   * host with a power command running.
+   */
+  while (ic->shared_next && !ic->powercmd)
+    ic = ic->shared_next;
+
+  return (ic);
+}
+
+int
+ipmipower_connection_shared_output_pending (void)
+{
+  return (shared_output ? 1 : 0);
+}
+
+struct ipmipower_connection *
+ipmipower_connection_shared_output_take (void)
+{
+  struct ipmipower_connection *ic;
+  struct ipmipower_connection *rv = shared_output;
+
+  for (ic = shared_output; ic; ic = ic->shared_output_next)
+    ic->shared_output_queued = 0;
+
+  shared_output = NULL;
+  return (rv);
+}
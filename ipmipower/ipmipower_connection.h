@@ -47,6 +47,22 @@ struct ipmipower_connection *ipmipower_connection_array_create (const char *host
 void ipmipower_connection_array_destroy (struct ipmipower_connection *ics,
                                          unsigned int ics_len);
 
+/* ipmipower_connection_sendto
+ * - Send the packet in cbuf to destaddr
+ */
+void ipmipower_connection_sendto (cbuf_t cbuf,
+                                  int fd,
+                                  struct sockaddr *destaddr,
+                                  socklen_t destaddrlen);
+
+/* ipmipower_connection_array_flush
+ * - Send packets queued on connections, such as close session
+ *   requests, waiting no longer than timeout milliseconds
+ */
+void ipmipower_connection_array_flush (struct ipmipower_connection *ics,
+                                       unsigned int ics_len,
+                                       unsigned int timeout);
+
 /* ipmipower_connection_hostname_index
  * - Find ics entry with given hostname
  * - Returns index of entry, -1 if not found
@@ -55,4 +71,81 @@ int ipmipower_connection_hostname_index (struct ipmipower_connection *ics,
                                          unsigned int ics_len,
                                          const char *hostname);
 
+/* epoll event data encodes the ics index of the connection and
+ * whether the event is for the ipmi_fd or ping_fd
+ */
+#define IPMIPOWER_CONNECTION_EVENT_DATA(__index, __ping) \
+  ((((uint64_t)(__index)) << 1) | ((__ping) ? 0x1 : 0x0))
+#define IPMIPOWER_CONNECTION_EVENT_INDEX(__data) ((unsigned int)((__data) >> 1))
+#define IPMIPOWER_CONNECTION_EVENT_PING(__data)  (((__data) & 0x1) ? 1 : 0)
+
+/* ipmipower_connection_event_setup
+ * - Create persistent epoll set that connection file descriptors
+ *   are registered with.
+ * - Returns epoll fd on success, -1 if epoll is not available, in
+ *   which case callers should fall back to poll().
+ */
+int ipmipower_connection_event_setup (void);
+
+/* ipmipower_connection_event_cleanup
+ * - Destroy epoll set
+ */
+void ipmipower_connection_event_cleanup (void);
+
+/* ipmipower_connection_event_update
+ * - Update epoll registration of the connection's ipmi and ping fds.
+ * - Must be called after ipmi_out or ping_out goes between empty and
+ *   non-empty or after ipmi_fd is changed.
+ * - With shared sockets, queues the connection if output is pending.
+ * - Otherwise no-op if epoll is not in use.
+ */
+void ipmipower_connection_event_update (ipmipower_connection_t ic);
+
+/* ipmipower_connection_shared_fds
+ * - Get shared sockets, see --shared-sockets
+ * - Unopened entries in the array are -1
+ * - Returns array of fds, NULL if none opened yet
+ */
+const int *ipmipower_connection_shared_fds (unsigned int *len);
+
+/* ipmipower_connection_shared_cleanup
+ * - Close shared sockets
+ */
+void ipmipower_connection_shared_cleanup (void);
+
+/* ipmipower_connection_shared_rotate
+ * - Move the connection's ipmi_fd to the next shared socket of the
+ *   same address family, giving it a different source port.
+ * - Returns 0 on success, -1 on EMFILE
+ */
+int ipmipower_connection_shared_rotate (ipmipower_connection_t ic);
+
+/* ipmipower_connection_shared_lookup
+ * - Find connection a packet received on a shared socket is for,
+ *   based on the source address and, if multiple hosts have the same
+ *   address, the IPMI 2.0 session id.
+ * - ping set to 1 if packet is RMCP (ping), 0 if IPMI
+ * - Returns connection on success, NULL if packet is not for any
+ *   connection
+ */
+ipmipower_connection_t ipmipower_connection_shared_lookup (struct ipmipower_connection *ics,
+                                                           unsigned int ics_len,
+                                                           const struct sockaddr *from,
+                                                           const uint8_t *pkt,
+                                                           unsigned int pkt_len,
+                                                           int *ping);
+
+/* ipmipower_connection_shared_output_pending
+ * - Returns 1 if output is pending on shared sockets, 0 if not
+ */
+int ipmipower_connection_shared_output_pending (void);
+
+/* ipmipower_connection_shared_output_take
+ * - Remove and return list of connections with output pending on
+ *   shared sockets, linked through shared_output_next.
+ * - Connections are re-queued by ipmipower_connection_event_update(),
+ *   so save shared_output_next before calling it.
+ */
+ipmipower_connection_t ipmipower_connection_shared_output_take (void);
+
 #endif /* IPMIPOWER_CONNECTION_H */
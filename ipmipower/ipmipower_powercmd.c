@@ -62,6 +62,7 @@
 #include "ipmipower_packet.h"
 #include "ipmipower_check.h"
 #include "ipmipower_util.h"
+#include "ipmipower_wave.h"
 
 #include "freeipmi-portability.h"
 #include "cbuf.h"
@@ -71,8 +72,30 @@
 
 extern struct ipmipower_arguments cmd_args;
 
-/* Queue of all pending power commands */
-static List pending = NULL;
+/* Min-heap of all pending power commands, keyed on the time each
+ * command next needs to be processed (i.e. its next retransmission
+ * or session timeout).  Commands are moved to the top of the heap
+ * when a packet for them is received, so each wakeup only touches
+ * commands that have something to do.
+ */
+static ipmipower_powercmd_t *pending = NULL;
+static unsigned int pending_heap_count = 0;
+static unsigned int pending_heap_size = 0;
+
+/* Queue of power commands that have not started b/c of fanout */
+static List fanout_waiting = NULL;
+
+/* Count of all pending power commands, i.e. in the heap or waiting
+ * on fanout
+ */
+static unsigned int pending_count = 0;
+
+/* Tie breaker on heap, so commands due at the same time are
+ * processed in the order they were queued
+ */
+static unsigned int pending_sequence_counter = 0;
+
+#define IPMIPOWER_PENDING_HEAP_SIZE_DEFAULT 1024
 
 /* Queue of power commands to be added to the pending, for serializing
  * OEM power control to the same host
@@ -82,20 +105,18 @@ static List add_to_pending = NULL;
 /* Count of currently executing power commands for fanout */
 static unsigned int executing_count = 0;
 
-static int
-_find_ipmipower_powercmd (void *x, void *key)
-{
-  ipmipower_powercmd_t ip;
-  char *hostname;
-
-  assert (x);
-  assert (key);
-
-  ip = (ipmipower_powercmd_t)x;
-  hostname = (char *)key;
+/* Queues of power commands that have not been admitted by the wave
+ * scheduler, one per wave group.  Used instead of fanout_waiting
+ * when wave scheduling is enabled.
+ */
+static List *wave_waiting = NULL;
+static unsigned int wave_waiting_len = 0;
 
-  return (!strcasecmp (ip->ic->hostname, hostname));
-}
+/* Count of idle sessions kept for reuse, they are in the pending
+ * heap keyed on when they expire but are not counted as pending.
+ * See --session-idle-timeout.
+ */
+static unsigned int idle_count = 0;
 
 static void
 _destroy_ipmipower_powercmd (void *x)
@@ -179,13 +200,229 @@ _destroy_ipmipower_powercmd (void *x)
   free (ip);
 }
 
+static int
+_pending_cmp (ipmipower_powercmd_t a, ipmipower_powercmd_t b)
+{
+  if (timeval_lt (&(a->next_process_time), &(b->next_process_time)))
+    return (1);
+  if (timeval_gt (&(a->next_process_time), &(b->next_process_time)))
+    return (0);
+  return (a->pending_sequence < b->pending_sequence);
+}
+
+static void
+_pending_heap_set (unsigned int index, ipmipower_powercmd_t ip)
+{
+  pending[index] = ip;
+  ip->pending_index = index;
+}
+
+static void
+_pending_heap_sift_up (unsigned int index)
+{
+  ipmipower_powercmd_t ip = pending[index];
+
+  while (index > 0 && _pending_cmp (ip, pending[(index - 1) / 2]))
+    {
+      _pending_heap_set (index, pending[(index - 1) / 2]);
+      index = (index - 1) / 2;
+    }
+  _pending_heap_set (index, ip);
+}
+
+static void
+_pending_heap_sift_down (unsigned int index)
+{
+  ipmipower_powercmd_t ip = pending[index];
+
+  while ((2 * index) + 1 < pending_heap_count)
+    {
+      unsigned int child = (2 * index) + 1;
+
+      if (child + 1 < pending_heap_count
+          && _pending_cmp (pending[child + 1], pending[child]))
+        child++;
+
+      if (!_pending_cmp (pending[child], ip))
+        break;
+
+      _pending_heap_set (index, pending[child]);
+      index = child;
+    }
+  _pending_heap_set (index, ip);
+}
+
+static void
+_pending_heap_remove (ipmipower_powercmd_t ip)
+{
+  unsigned int index;
+
+  assert (ip);
+  assert (ip->pending_index >= 0);
+  assert (ip->pending_index < pending_heap_count);
+  assert (pending[ip->pending_index] == ip);
+
+  index = ip->pending_index;
+  ip->pending_index = -1;
+  pending_heap_count--;
+
+  if (index == pending_heap_count)
+    return;
+
+  _pending_heap_set (index, pending[pending_heap_count]);
+  _pending_heap_sift_up (index);
+  _pending_heap_sift_down (pending[index]->pending_index);
+}
+
+/* _pending_schedule
+ * - (re)schedule ip to be processed at time tv, NULL for immediately
+ */
+static void
+_pending_schedule (ipmipower_powercmd_t ip, struct timeval *tv)
+{
+  assert (ip);
+
+  if (ip->pending_index >= 0)
+    _pending_heap_remove (ip);
+
+  if (tv)
+    {
+      ip->next_process_time.tv_sec = tv->tv_sec;
+      ip->next_process_time.tv_usec = tv->tv_usec;
+    }
+  else
+    timeval_clear (&(ip->next_process_time));
+
+  if (pending_heap_count == pending_heap_size)
+    {
+      ipmipower_powercmd_t *tmp;
+      unsigned int size;
+
+      size = pending_heap_size ? pending_heap_size * 2 : IPMIPOWER_PENDING_HEAP_SIZE_DEFAULT;
+
+      if (!(tmp = (ipmipower_powercmd_t *)realloc (pending, sizeof (ipmipower_powercmd_t) * size)))
+        {
+          IPMIPOWER_ERROR (("realloc: %s", strerror (errno)));
+          exit (EXIT_FAILURE);
+        }
+      pending = tmp;
+      pending_heap_size = size;
+    }
+
+  _pending_heap_set (pending_heap_count, ip);
+  pending_heap_count++;
+  _pending_heap_sift_up (ip->pending_index);
+}
+
+/* _session_resume
+ * - Move the power command ip into the idle session of its
+ *   connection, so it can skip session setup.
+ * - Returns the session, ip is destroyed
+ */
+static ipmipower_powercmd_t
+_session_resume (ipmipower_powercmd_t ip)
+{
+  ipmipower_powercmd_t session;
+
+  assert (ip);
+  assert (ip->ic->session);
+  assert (ip->ic->session->protocol_state == IPMIPOWER_PROTOCOL_STATE_SESSION_IDLE);
+
+  session = ip->ic->session;
+  ip->ic->session = NULL;
+  _pending_heap_remove (session);
+  idle_count--;
+
+  IPMIPOWER_DEBUG (("host = %s; reusing session", ip->ic->hostname));
+
+  session->cmd = ip->cmd;
+  session->protocol_state = IPMIPOWER_PROTOCOL_STATE_START;
+  memset (&(session->time_begin), '\0', sizeof (struct timeval));
+  session->retransmission_count = 0;
+  session->retransmission_total = 0;
+  session->close_timeout = 0;
+  session->wait_until_on_state = 0;
+  session->wait_until_off_state = 0;
+  session->session_reusable = 0;
+  session->session_resumed = 1;
+
+  free (session->extra_arg);
+  session->extra_arg = ip->extra_arg;
+  ip->extra_arg = NULL;
+
+  session->next = ip->next;
+  ip->next = NULL;
+
+  session->pending_sequence = ip->pending_sequence;
+
+  session->wave_admitted = ip->wave_admitted;
+  session->wave_sequence = ip->wave_sequence;
+  session->wave_start_time = ip->wave_start_time;
+
+  _destroy_ipmipower_powercmd (ip);
+  return (session);
+}
+
+/* _session_park
+ * - Keep the session of completed power command ip open for reuse
+ *   until it has been idle for cmd_args.session_idle_timeout
+ */
+static void
+_session_park (ipmipower_powercmd_t ip)
+{
+  struct timeval cur_time, expire_time;
+
+  assert (ip);
+  assert (ip->session_reusable);
+  assert (!ip->ic->session);
+  assert (!ip->ic->powercmd);
+
+  if (gettimeofday (&cur_time, NULL) < 0)
+    {
+      IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  timeval_add_ms (&cur_time, cmd_args.session_idle_timeout, &expire_time);
+
+  ip->protocol_state = IPMIPOWER_PROTOCOL_STATE_SESSION_IDLE;
+  ip->session_reusable = 0;
+  ip->ic->session = ip;
+  idle_count++;
+  _pending_schedule (ip, &expire_time);
+}
+
+/* _pending_start
+ * - Make ip the power command executing on its connection and
+ *   schedule it
+ */
+static void
+_pending_start (ipmipower_powercmd_t ip)
+{
+  assert (ip);
+  assert (!ip->ic->powercmd);
+
+  if (ip->ic->session)
+    ip = _session_resume (ip);
+
+  ip->ic->powercmd = ip;
+  pending_count++;
+  _pending_schedule (ip, NULL);
+}
+
 void
 ipmipower_powercmd_setup ()
 {
-  assert (!pending);  /* need to cleanup first! */
+  assert (!fanout_waiting);  /* need to cleanup first! */
 
-  pending = list_create ((ListDelF)_destroy_ipmipower_powercmd);
-  if (!pending)
+  pending = NULL;
+  pending_heap_count = 0;
+  pending_heap_size = 0;
+  pending_count = 0;
+  idle_count = 0;
+
+  fanout_waiting = list_create ((ListDelF)_destroy_ipmipower_powercmd);
+  if (!fanout_waiting)
     {
       IPMIPOWER_ERROR (("list_create: %s", strerror (errno)));
       exit (EXIT_FAILURE);
@@ -197,57 +434,47 @@ ipmipower_powercmd_setup ()
       IPMIPOWER_ERROR (("list_create: %s", strerror (errno)));
       exit (EXIT_FAILURE);
     }
+
+  wave_waiting = NULL;
+  wave_waiting_len = 0;
+
+  ipmipower_wave_setup ();
 }
 
 void
 ipmipower_powercmd_cleanup ()
 {
-  assert (pending);  /* did not run ipmipower_powercmd_setup() */
-  list_destroy (pending);
+  unsigned int i;
+
+  assert (fanout_waiting);  /* did not run ipmipower_powercmd_setup() */
+  for (i = 0; i < pending_heap_count; i++)
+    _destroy_ipmipower_powercmd (pending[i]);
+  free (pending);
+  list_destroy (fanout_waiting);
   list_destroy (add_to_pending);
+  for (i = 0; i < wave_waiting_len; i++)
+    list_destroy (wave_waiting[i]);
+  free (wave_waiting);
+  ipmipower_wave_cleanup ();
   pending = NULL;
+  pending_heap_count = 0;
+  pending_heap_size = 0;
+  pending_count = 0;
+  idle_count = 0;
+  fanout_waiting = NULL;
   add_to_pending = NULL;
+  wave_waiting = NULL;
+  wave_waiting_len = 0;
 }
 
-void
-ipmipower_powercmd_queue (ipmipower_power_cmd_t cmd,
-                          struct ipmipower_connection *ic,
-                          const char *extra_arg)
+/* _session_init
+ * - Initialize session state, for a new command or when a reused
+ *   session must be re-established
+ */
+static void
+_session_init (ipmipower_powercmd_t ip)
 {
-  ipmipower_powercmd_t ip;
-
-  assert (pending);  /* did not run ipmipower_powercmd_setup() */
-  assert (ic);
-  assert (IPMIPOWER_POWER_CMD_VALID (cmd));
-
-  ipmipower_connection_clear (ic);
-
-  if (!(ip = (ipmipower_powercmd_t)malloc (sizeof (struct ipmipower_powercmd))))
-    {
-      IPMIPOWER_ERROR (("malloc: %s", strerror (errno)));
-      exit (EXIT_FAILURE);
-    }
-
-  ip->cmd = cmd;
-  ip->protocol_state = IPMIPOWER_PROTOCOL_STATE_START;
-
-  /*
-   * Protocol State Machine Variables
-   */
-#if 0
-  /* Initialize when protocol really begins.  Necessary b/c of fanout support
-   * For now just clear it.
-   */
-  if (gettimeofday (&(ip->time_begin), NULL) < 0)
-    {
-      IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
-      exit (EXIT_FAILURE);
-    }
-#else  /* 0 */
-  memset (&(ip->time_begin), '\0', sizeof (struct timeval));
-#endif  /* 0 */
-  ip->retransmission_count = 0;
-  ip->close_timeout = 0;
+  assert (ip);
 
   /*
    * Protocol Maintenance Variables
@@ -297,7 +524,7 @@ ipmipower_powercmd_queue (ipmipower_power_cmd_t cmd,
                                               &(ip->integrity_algorithm),
                                               &(ip->confidentiality_algorithm)) < 0)
         {
-          IPMIPOWER_ERROR (("ipmipower_powercmd_queue: ipmi_cipher_suite_id_to_algorithms: ",
+          IPMIPOWER_ERROR (("_session_init: ipmi_cipher_suite_id_to_algorithms: ",
                             "cmd_args.common_args.cipher_suite_id: %d: %s",
                             cmd_args.common_args.cipher_suite_id, strerror (errno)));
           exit (EXIT_FAILURE);
@@ -387,10 +614,57 @@ ipmipower_powercmd_queue (ipmipower_power_cmd_t cmd,
           exit (EXIT_FAILURE);
         }
     }
+}
+
+void
+ipmipower_powercmd_queue (ipmipower_power_cmd_t cmd,
+                          struct ipmipower_connection *ic,
+                          const char *extra_arg)
+{
+  ipmipower_powercmd_t ip;
+
+  assert (fanout_waiting);  /* did not run ipmipower_powercmd_setup() */
+  assert (ic);
+  assert (IPMIPOWER_POWER_CMD_VALID (cmd));
+
+  ipmipower_connection_clear (ic);
+
+  if (!(ip = (ipmipower_powercmd_t)malloc (sizeof (struct ipmipower_powercmd))))
+    {
+      IPMIPOWER_ERROR (("malloc: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  ip->cmd = cmd;
+  ip->protocol_state = IPMIPOWER_PROTOCOL_STATE_START;
+
+  /*
+   * Protocol State Machine Variables
+   */
+#if 0
+  /* Initialize when protocol really begins.  Necessary b/c of fanout support
+   * For now just clear it.
+   */
+  if (gettimeofday (&(ip->time_begin), NULL) < 0)
+    {
+      IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+#else  /* 0 */
+  memset (&(ip->time_begin), '\0', sizeof (struct timeval));
+#endif  /* 0 */
+  ip->retransmission_count = 0;
+  ip->retransmission_total = 0;
+  ip->close_timeout = 0;
+
+  _session_init (ip);
 
   ip->wait_until_on_state = 0;
   ip->wait_until_off_state = 0;
 
+  ip->session_reusable = 0;
+  ip->session_resumed = 0;
+
   ip->ic = ic;
 
   if (!(ip->obj_rmcp_hdr_rq = fiid_obj_create (tmpl_rmcp_hdr)))
@@ -643,45 +917,48 @@ ipmipower_powercmd_queue (ipmipower_power_cmd_t cmd,
    * We do not want to do power control to the host in parallel b/c
    * many BMCs can't handle parallel sessions (you will BUSY errors).
    * So we will serialize power control operations to the same host.
-   */
-
-  /* XXX: The constant strcmp and searching of this list can be slow
-   * (O(n^2)), but for the time being it is assumed this will not
-   * be an overall performance issue for ipmipower.  If it does become
-   * an issue, a bigger rearchitecture will be required.
+   * The connection tracks the power command executing on it, so
+   * there is no need to search the pending commands for it.
    */
 
   ip->next = NULL;
+  ip->pending_index = -1;
+  ip->pending_sequence = pending_sequence_counter++;
+
+  if (ipmipower_wave_enabled ())
+    ipmipower_wave_queue (ip);
 
-  if (cmd_args.oem_power_type == IPMIPOWER_OEM_POWER_TYPE_C410X)
+  if (ic->powercmd)
     {
-      ipmipower_powercmd_t iptmp;
+      ipmipower_powercmd_t iptmp = ic->powercmd;
 
-      if ((iptmp = list_find_first (pending,
-                                    _find_ipmipower_powercmd,
-                                    ip->ic->hostname)))
-        {
-          /* find the last one in the list */
-          while (iptmp->next)
-            iptmp = iptmp->next;
-          iptmp->next = ip;
-          return;
-        }
+      /* find the last one in the list */
+      while (iptmp->next)
+        iptmp = iptmp->next;
+      iptmp->next = ip;
+      return;
     }
 
-  if (!list_append (pending, ip))
-    {
-      IPMIPOWER_ERROR (("list_append: %s", strerror (errno)));
-      exit (EXIT_FAILURE);
-    }
+  _pending_start (ip);
 }
 
 int
 ipmipower_powercmd_pending ()
 {
-  assert (pending);  /* did not run ipmipower_powercmd_setup() */
+  assert (fanout_waiting);  /* did not run ipmipower_powercmd_setup() */
 
-  return (!list_is_empty (pending));
+  return (pending_count > 0);
+}
+
+void
+ipmipower_powercmd_packet_received (struct ipmipower_connection *ic)
+{
+  assert (fanout_waiting);  /* did not run ipmipower_powercmd_setup() */
+  assert (ic);
+
+  /* if not yet started (i.e. waiting on fanout), nothing to do */
+  if (ic->powercmd && ic->powercmd->pending_index >= 0)
+    _pending_schedule (ic->powercmd, NULL);
 }
 
 /* _send_packet
@@ -736,6 +1013,8 @@ _send_packet (ipmipower_powercmd_t ip, ipmipower_packet_type_t pkt)
   if (dropped)
     IPMIPOWER_DEBUG (("cbuf_write: dropped %d bytes", dropped));
 
+  ipmipower_connection_event_update (ip->ic);
+
   if (cmd_args.common_args.driver_type == IPMI_DEVICE_LAN
       && cmd_args.common_args.authentication_type == IPMI_AUTHENTICATION_TYPE_STRAIGHT_PASSWORD_KEY)
     secure_memset (buf, '\0', IPMIPOWER_PACKET_BUFLEN);
@@ -818,6 +1097,57 @@ _send_packet (ipmipower_powercmd_t ip, ipmipower_packet_type_t pkt)
     }
 }
 
+/* _session_restart
+ * - Give up on a reused session and establish a new one
+ */
+static void
+_session_restart (ipmipower_powercmd_t ip)
+{
+  assert (ip);
+  assert (ip->session_resumed);
+
+  _session_init (ip);
+  ip->session_resumed = 0;
+  ip->retransmission_count = 0;
+  ip->wait_until_on_state = 0;
+  ip->wait_until_off_state = 0;
+  ipmipower_connection_clear (ip->ic);
+  _send_packet (ip, IPMIPOWER_PACKET_TYPE_AUTHENTICATION_CAPABILITIES_RQ);
+}
+
+/* _session_error_completion_code
+ * - Returns 1 if the completion code indicates the BMC no longer
+ *   considers the session active, 0 if not
+ */
+static int
+_session_error_completion_code (ipmipower_powercmd_t ip,
+                                ipmipower_packet_type_t pkt)
+{
+  fiid_obj_t obj_cmd;
+  uint64_t val;
+
+  assert (ip);
+  assert (IPMIPOWER_PACKET_TYPE_IPMI_SESSION_PACKET_RS (pkt));
+
+  obj_cmd = ipmipower_packet_cmd_obj (ip, pkt);
+
+  if (FIID_OBJ_GET (obj_cmd,
+                    "comp_code",
+                    &val) < 0)
+    {
+      IPMIPOWER_ERROR (("FIID_OBJ_GET: 'comp_code': %s",
+                        fiid_obj_errormsg (obj_cmd)));
+      exit (EXIT_FAILURE);
+    }
+
+  /* BMCs that do not silently drop packets for closed sessions
+   * report them as insufficient privilege or not supported in the
+   * present state.
+   */
+  return ((val == IPMI_COMP_CODE_INSUFFICIENT_PRIVILEGE_LEVEL
+           || val == IPMI_COMP_CODE_REQUEST_PARAMETER_NOT_SUPPORTED) ? 1 : 0);
+}
+
 /* _recv_packet
  * - Receive a packet
  * Returns 1 if packet is of correct size and passes checks
@@ -1055,6 +1385,10 @@ _recv_packet (ipmipower_powercmd_t ip, ipmipower_packet_type_t pkt)
           if (pkt == IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RS)
             goto close_session_workaround;
 
+          if (ip->session_resumed
+              && _session_error_completion_code (ip, pkt))
+            goto session_restart;
+
           ipmipower_output (ipmipower_packet_errmsg (ip, pkt), ip->ic->hostname, ip->extra_arg);
 
           ip->retransmission_count = 0;  /* important to reset */
@@ -1233,6 +1567,10 @@ _recv_packet (ipmipower_powercmd_t ip, ipmipower_packet_type_t pkt)
           if (pkt == IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RS)
             goto close_session_workaround;
 
+          if (ip->session_resumed
+              && _session_error_completion_code (ip, pkt))
+            goto session_restart;
+
           ip->retransmission_count = 0;  /* important to reset */
           if (gettimeofday (&ip->ic->last_ipmi_recv, NULL) < 0)
             {
@@ -1260,13 +1598,27 @@ _recv_packet (ipmipower_powercmd_t ip, ipmipower_packet_type_t pkt)
    * close the session anyways.
    */
  close_session_workaround:
-  ip->retransmission_count = 0;  /* important to reset */
+  ip->session_resumed = 0;       /* reused session is still good */
   if (gettimeofday (&ip->ic->last_ipmi_recv, NULL) < 0)
     {
       IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
       exit (EXIT_FAILURE);
     }
+  /* Karn's algorithm, a response to a retransmitted request cannot
+   * be matched to the transmission it answers.
+   */
+  if (!ip->retransmission_count)
+    rtt_sample (&ip->ic->rtt, &ip->ic->last_ipmi_send, &ip->ic->last_ipmi_recv);
+  ip->retransmission_count = 0;  /* important to reset */
   rv = 1;
+  goto cleanup;
+
+ session_restart:
+  IPMIPOWER_DEBUG (("host = %s; p = %d; reused session rejected, starting new session",
+                    ip->ic->hostname,
+                    ip->protocol_state));
+  _session_restart (ip);
+  rv = 0;
 
  cleanup:
   /* Clear out data */
@@ -1283,6 +1635,59 @@ _recv_packet (ipmipower_powercmd_t ip, ipmipower_packet_type_t pkt)
   return (rv);
 }
 
+/* _send_power_command
+ * - Send the first packet of the power command, session must be up
+ */
+static void
+_send_power_command (ipmipower_powercmd_t ip)
+{
+  assert (ip);
+
+  if (cmd_args.oem_power_type == IPMIPOWER_OEM_POWER_TYPE_NONE)
+    {
+      if (ip->cmd == IPMIPOWER_POWER_CMD_POWER_STATUS
+          || ip->cmd == IPMIPOWER_POWER_CMD_IDENTIFY_STATUS
+          || (cmd_args.on_if_off
+              && (ip->cmd == IPMIPOWER_POWER_CMD_POWER_CYCLE
+                  || ip->cmd == IPMIPOWER_POWER_CMD_POWER_RESET)))
+        _send_packet (ip, IPMIPOWER_PACKET_TYPE_GET_CHASSIS_STATUS_RQ);
+      else if (ip->cmd == IPMIPOWER_POWER_CMD_IDENTIFY_ON
+               || ip->cmd == IPMIPOWER_POWER_CMD_IDENTIFY_OFF)
+        _send_packet (ip, IPMIPOWER_PACKET_TYPE_CHASSIS_IDENTIFY_RQ);
+      else /* on, off, cycle, reset, pulse diag interupt, soft shutdown */
+        _send_packet (ip, IPMIPOWER_PACKET_TYPE_CHASSIS_CONTROL_RQ);
+    }
+  else /* cmd_args.oem_power_type == IPMIPOWER_OEM_POWER_TYPE_C410X */
+    {
+      assert (ip->cmd == IPMIPOWER_POWER_CMD_POWER_STATUS
+              || ip->cmd == IPMIPOWER_POWER_CMD_POWER_OFF
+              || ip->cmd == IPMIPOWER_POWER_CMD_POWER_ON);
+
+      _send_packet (ip, IPMIPOWER_PACKET_TYPE_C410X_GET_SENSOR_READING_RQ);
+    }
+}
+
+/* _close_session
+ * - Power command completed successfully, close the session or, in
+ *   interactive mode with --session-idle-timeout, keep it open for
+ *   the next power command to this host.
+ */
+static void
+_close_session (ipmipower_powercmd_t ip)
+{
+  assert (ip);
+
+  if (cmd_args.session_idle_timeout
+      && cmd_args.powercmd == IPMIPOWER_POWER_CMD_NONE)
+    {
+      ip->session_reusable = 1;
+      ip->protocol_state = IPMIPOWER_PROTOCOL_STATE_END;
+      return;
+    }
+
+  _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+}
+
 /* _has_timed_out
  * - Check if command timed out
  * Returns 1 if timed out, 0 if not
@@ -1329,6 +1734,21 @@ _has_timed_out (ipmipower_powercmd_t ip)
   return (0);
 }
 
+/* _retransmission_timeout
+ * - Returns the base retransmission timeout in milliseconds, adapted
+ *   to measured round trip times unless --fixed-retransmission-timeout
+ */
+static unsigned int
+_retransmission_timeout (ipmipower_powercmd_t ip)
+{
+  assert (ip);
+
+  if (cmd_args.fixed_retransmission_timeout)
+    return (cmd_args.common_args.retransmission_timeout);
+
+  return (rtt_timeout (&ip->ic->rtt));
+}
+
 /* _retry_packets
  * - Check if we should retransmit and retransmit if necessary
  * Returns 1 if we sent a packet, 0 if not
@@ -1354,7 +1774,7 @@ _retry_packets (ipmipower_powercmd_t ip)
           && ip->cmd == IPMIPOWER_POWER_CMD_POWER_OFF))
     retransmission_timeout = cmd_args.retransmission_wait_timeout * (1 + (ip->retransmission_count/cmd_args.retransmission_backoff_count));
   else
-    retransmission_timeout = cmd_args.common_args.retransmission_timeout * (1 + (ip->retransmission_count/cmd_args.retransmission_backoff_count));
+    retransmission_timeout = _retransmission_timeout (ip) * (1 + (ip->retransmission_count/cmd_args.retransmission_backoff_count));
 
   if (gettimeofday (&cur_time, NULL) < 0)
     {
@@ -1375,8 +1795,28 @@ _retry_packets (ipmipower_powercmd_t ip)
   if (time_left < retransmission_timeout)
     return (0);
 
+  /* Most BMCs silently drop packets for sessions they have closed,
+   * so if a reused session does not respond, assume it is gone and
+   * establish a new one.
+   */
+  if (ip->session_resumed)
+    {
+      IPMIPOWER_DEBUG (("host = %s; p = %d; no response on reused session, starting new session",
+                        ip->ic->hostname,
+                        ip->protocol_state));
+
+      _session_restart (ip);
+      return (1);
+    }
+
   ip->retransmission_count++;
 
+  /* status queries while waiting for power on/off are not really
+   * retransmissions
+   */
+  if (!ip->wait_until_on_state && !ip->wait_until_off_state)
+    ip->retransmission_total++;
+
   IPMIPOWER_DEBUG (("host = %s; p = %d; Sending retry, retry count=%d",
                     ip->ic->hostname,
                     ip->protocol_state,
@@ -1409,9 +1849,25 @@ _retry_packets (ipmipower_powercmd_t ip)
          * store the old file descriptrs (which are bound to the old
          * ports) on a list, and close all of them after we have gotten
          * past the Get Session Challenge phase of the protocol.
+         *
+         * With shared sockets, move to the next shared socket
+         * instead.  Its port won't be brand new, but it is different
+         * if more than one shared socket is configured.
          */
         int new_fd, *old_fd;
 
+        if (cmd_args.shared_sockets)
+          {
+            if (ipmipower_connection_shared_rotate (ip->ic) < 0)
+              {
+                ipmipower_output (IPMIPOWER_MSG_TYPE_RESOURCES, ip->ic->hostname, ip->extra_arg);
+                return (-1);
+              }
+
+            _send_packet (ip, IPMIPOWER_PACKET_TYPE_GET_SESSION_CHALLENGE_RQ);
+            break;
+          }
+
         if ((new_fd = socket (ip->ic->srcaddr->sa_family, SOCK_DGRAM, 0)) < 0)
           {
             if (errno != EMFILE)
@@ -1872,6 +2328,8 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
 {
   struct timeval cur_time, end_time, result;
   unsigned int timeout;
+  unsigned int retransmission_timeout;
+  unsigned int time_since_last_ipmi_send;
   uint64_t val;
   int rv;
 
@@ -1893,14 +2351,39 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
 
   if (ip->protocol_state == IPMIPOWER_PROTOCOL_STATE_START)
     {
+      if (ipmipower_wave_enabled ())
+        {
+          struct timeval cur_time, result;
+
+          /* fanout is also considered by the wave scheduler */
+          if (!ip->wave_admitted && !ipmipower_wave_admit (ip))
+            return (cmd_args.common_args.session_timeout);
+
+          if (gettimeofday (&cur_time, NULL) < 0)
+            {
+              IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
+              exit (EXIT_FAILURE);
+            }
+
+          /* admitted, but not yet allowed to start by the rate */
+          if (timeval_gt (&(ip->wave_start_time), &cur_time))
+            {
+              timeval_sub (&(ip->wave_start_time), &cur_time, &result);
+              timeval_millisecond_calc (&result, &timeout);
+              return (timeout ? timeout : 1);
+            }
+        }
       /* Don't execute if fanout turned on and we're in the middle of too
        * many power commands.
        */
-      if (cmd_args.common_args.fanout
-          && (executing_count >= cmd_args.common_args.fanout))
+      else if (cmd_args.common_args.fanout
+               && (executing_count >= cmd_args.common_args.fanout))
         return (cmd_args.common_args.session_timeout);
 
-      _send_packet (ip, IPMIPOWER_PACKET_TYPE_AUTHENTICATION_CAPABILITIES_RQ);
+      if (ip->session_resumed)
+        _send_power_command (ip);
+      else
+        _send_packet (ip, IPMIPOWER_PACKET_TYPE_AUTHENTICATION_CAPABILITIES_RQ);
 
       if (gettimeofday (&(ip->time_begin), NULL) < 0)
         {
@@ -2016,28 +2499,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
           goto done;
         }
 
-      if (cmd_args.oem_power_type == IPMIPOWER_OEM_POWER_TYPE_NONE)
-        {
-          if (ip->cmd == IPMIPOWER_POWER_CMD_POWER_STATUS
-              || ip->cmd == IPMIPOWER_POWER_CMD_IDENTIFY_STATUS
-              || (cmd_args.on_if_off
-                  && (ip->cmd == IPMIPOWER_POWER_CMD_POWER_CYCLE
-                      || ip->cmd == IPMIPOWER_POWER_CMD_POWER_RESET)))
-            _send_packet (ip, IPMIPOWER_PACKET_TYPE_GET_CHASSIS_STATUS_RQ);
-          else if (ip->cmd == IPMIPOWER_POWER_CMD_IDENTIFY_ON
-                   || ip->cmd == IPMIPOWER_POWER_CMD_IDENTIFY_OFF)
-            _send_packet (ip, IPMIPOWER_PACKET_TYPE_CHASSIS_IDENTIFY_RQ);
-          else /* on, off, cycle, reset, pulse diag interupt, soft shutdown */
-            _send_packet (ip, IPMIPOWER_PACKET_TYPE_CHASSIS_CONTROL_RQ);
-        }
-      else /* cmd_args.oem_power_type == IPMIPOWER_OEM_POWER_TYPE_C410X */
-        {
-          assert (ip->cmd == IPMIPOWER_POWER_CMD_POWER_STATUS
-                  || ip->cmd == IPMIPOWER_POWER_CMD_POWER_OFF
-                  || ip->cmd == IPMIPOWER_POWER_CMD_POWER_ON);
-
-          _send_packet (ip, IPMIPOWER_PACKET_TYPE_C410X_GET_SENSOR_READING_RQ);
-        }
+      _send_power_command (ip);
     }
   else if (ip->protocol_state == IPMIPOWER_PROTOCOL_STATE_GET_CHASSIS_STATUS_SENT)
     {
@@ -2069,7 +2531,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
             {
               ipmipower_output (IPMIPOWER_MSG_TYPE_OK, ip->ic->hostname, ip->extra_arg);
               ip->wait_until_on_state = 0;
-              _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+              _close_session (ip);
             }
         }
       else if (cmd_args.wait_until_off
@@ -2080,7 +2542,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
             {
               ipmipower_output (IPMIPOWER_MSG_TYPE_OK, ip->ic->hostname, ip->extra_arg);
               ip->wait_until_off_state = 0;
-              _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+              _close_session (ip);
             }
         }
       else if (ip->cmd == IPMIPOWER_POWER_CMD_POWER_STATUS)
@@ -2088,7 +2550,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
           ipmipower_output ((power_state == IPMI_SYSTEM_POWER_IS_ON) ? IPMIPOWER_MSG_TYPE_ON : IPMIPOWER_MSG_TYPE_OFF,
                             ip->ic->hostname,
                             ip->extra_arg);
-          _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+          _close_session (ip);
         }
       else if (cmd_args.on_if_off && (ip->cmd == IPMIPOWER_POWER_CMD_POWER_CYCLE
                                       || ip->cmd == IPMIPOWER_POWER_CMD_POWER_RESET))
@@ -2139,7 +2601,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
           else
             ipmipower_output (IPMIPOWER_MSG_TYPE_UNKNOWN, ip->ic->hostname, ip->extra_arg);
 
-          _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+          _close_session (ip);
         }
       else
         {
@@ -2183,7 +2645,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
           if (ip->cmd == IPMIPOWER_POWER_CMD_POWER_RESET)
             goto finish_up;
           else
-            _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+            _close_session (ip);
         }
     }
   else if (ip->protocol_state == IPMIPOWER_PROTOCOL_STATE_CHASSIS_IDENTIFY_SENT)
@@ -2197,7 +2659,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
         }
 
       ipmipower_output (IPMIPOWER_MSG_TYPE_OK, ip->ic->hostname, ip->extra_arg);
-      _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+      _close_session (ip);
     }
   else if (ip->protocol_state == IPMIPOWER_PROTOCOL_STATE_C410X_GET_SENSOR_READING_SENT)
     {
@@ -2267,7 +2729,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
             {
               ipmipower_output (IPMIPOWER_MSG_TYPE_OK, ip->ic->hostname, ip->extra_arg);
               ip->wait_until_on_state = 0;
-              _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+              _close_session (ip);
             }
         }
       else if (cmd_args.wait_until_off
@@ -2278,7 +2740,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
             {
               ipmipower_output (IPMIPOWER_MSG_TYPE_OK, ip->ic->hostname, ip->extra_arg);
               ip->wait_until_off_state = 0;
-              _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+              _close_session (ip);
             }
         }
       else if (ip->cmd == IPMIPOWER_POWER_CMD_POWER_STATUS)
@@ -2286,14 +2748,14 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
           ipmipower_output ((slot_power_on_flag) ? IPMIPOWER_MSG_TYPE_ON : IPMIPOWER_MSG_TYPE_OFF,
                             ip->ic->hostname,
                             ip->extra_arg);
-          _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+          _close_session (ip);
         }
       else if (ip->cmd == IPMIPOWER_POWER_CMD_POWER_ON)
         {
           if (slot_power_on_flag)
             {
               ipmipower_output (IPMIPOWER_MSG_TYPE_OK, ip->ic->hostname, ip->extra_arg);
-              _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+              _close_session (ip);
             }
           else
             _send_packet (ip, IPMIPOWER_PACKET_TYPE_C410X_SLOT_POWER_CONTROL_RQ);
@@ -2303,7 +2765,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
           if (!slot_power_on_flag)
             {
               ipmipower_output (IPMIPOWER_MSG_TYPE_OK, ip->ic->hostname, ip->extra_arg);
-              _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+              _close_session (ip);
             }
           else
             _send_packet (ip, IPMIPOWER_PACKET_TYPE_C410X_SLOT_POWER_CONTROL_RQ);
@@ -2338,7 +2800,7 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
       else
         {
           ipmipower_output (IPMIPOWER_MSG_TYPE_OK, ip->ic->hostname, ip->extra_arg);
-          _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+          _close_session (ip);
         }
     }
   else if (ip->protocol_state == IPMIPOWER_PROTOCOL_STATE_CLOSE_SESSION_SENT)
@@ -2383,131 +2845,331 @@ _process_ipmi_packets (ipmipower_powercmd_t ip)
   timeval_sub (&end_time, &cur_time, &result);
   timeval_millisecond_calc (&result, &timeout);
 
-  /* shorter timeout b/c of retransmission timeout */
+  /* shorter timeout b/c of retransmission timeout, calculated from
+   * the last send so the retransmission is not delayed
+   */
   if ((ip->wait_until_on_state && ip->cmd == IPMIPOWER_POWER_CMD_POWER_ON)
       || (ip->wait_until_off_state && ip->cmd == IPMIPOWER_POWER_CMD_POWER_OFF))
+    retransmission_timeout = cmd_args.retransmission_wait_timeout * (1 + (ip->retransmission_count/cmd_args.retransmission_backoff_count));
+  else
+    retransmission_timeout = _retransmission_timeout (ip) * (1 + (ip->retransmission_count/cmd_args.retransmission_backoff_count));
+
+  timeval_sub (&cur_time, &(ip->ic->last_ipmi_send), &result);
+  timeval_millisecond_calc (&result, &time_since_last_ipmi_send);
+
+  if (time_since_last_ipmi_send < retransmission_timeout)
+    retransmission_timeout -= time_since_last_ipmi_send;
+
+  if (timeout > retransmission_timeout)
+    timeout = retransmission_timeout;
+
+  return (timeout);
+}
+
+/* _waiting_append
+ * - ip could not start b/c of fanout or the wave scheduler, queue it
+ *   until another command finishes
+ */
+static void
+_waiting_append (ipmipower_powercmd_t ip)
+{
+  List l;
+
+  assert (ip);
+
+  if (ipmipower_wave_enabled ())
+    {
+      unsigned int group = ip->ic->wave_group;
+
+      if (group >= wave_waiting_len)
+        {
+          List *tmp;
+          unsigned int i;
+
+          if (!(tmp = (List *)realloc (wave_waiting, sizeof (List) * (group + 1))))
+            {
+              IPMIPOWER_ERROR (("realloc: %s", strerror (errno)));
+              exit (EXIT_FAILURE);
+            }
+
+          for (i = wave_waiting_len; i <= group; i++)
+            {
+              if (!(tmp[i] = list_create ((ListDelF)_destroy_ipmipower_powercmd)))
+                {
+                  IPMIPOWER_ERROR (("list_create: %s", strerror (errno)));
+                  exit (EXIT_FAILURE);
+                }
+            }
+
+          wave_waiting = tmp;
+          wave_waiting_len = group + 1;
+        }
+
+      l = wave_waiting[group];
+    }
+  else
+    l = fanout_waiting;
+
+  if (!list_append (l, ip))
+    {
+      IPMIPOWER_ERROR (("list_append: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+}
+
+/* _waiting_release
+ * - Start commands waiting on fanout or the wave scheduler, now that
+ *   a command has finished
+ */
+static void
+_waiting_release (void)
+{
+  ipmipower_powercmd_t ipwait;
+
+  if (ipmipower_wave_enabled ())
+    {
+      unsigned int group = ipmipower_wave_group_current ();
+
+      if (group >= wave_waiting_len)
+        return;
+
+      /* admit as many as the window allows, they are started at the
+       * time given by the rate
+       */
+      while ((ipwait = list_peek (wave_waiting[group])))
+        {
+          if (!ipmipower_wave_admit (ipwait))
+            break;
+
+          list_dequeue (wave_waiting[group]);
+          _pending_schedule (ipwait, &(ipwait->wave_start_time));
+        }
+      return;
+    }
+
+  if (!list_is_empty (fanout_waiting))
+    {
+      if (!(ipwait = list_dequeue (fanout_waiting)))
+        {
+          IPMIPOWER_ERROR (("list_dequeue: %s", strerror (errno)));
+          exit (EXIT_FAILURE);
+        }
+
+      _pending_schedule (ipwait, NULL);
+    }
+}
+
+/* _pending_finish
+ * - ip has completed, remove and destroy it, start the next queued
+ *   command to the same host or waiting on fanout or the wave
+ *   scheduler
+ */
+static void
+_pending_finish (ipmipower_powercmd_t ip)
+{
+  assert (ip);
+  assert (ip->pending_index < 0);
+  assert (ip->ic->powercmd == ip);
+
+  ip->ic->powercmd = NULL;
+
+  if (ip->next)
     {
-      int retransmission_wait_timeout = cmd_args.retransmission_wait_timeout * (1 + (ip->retransmission_count/cmd_args.retransmission_backoff_count));
-      if (timeout > retransmission_wait_timeout)
-        timeout = retransmission_wait_timeout;
+      if (!list_append (add_to_pending, ip->next))
+        {
+          IPMIPOWER_ERROR (("list_append: %s", strerror (errno)));
+          exit (EXIT_FAILURE);
+        }
+
+      ip->next = NULL;
     }
+
+  if (ipmipower_wave_enabled ())
+    ipmipower_wave_finish (ip);
+
+  if (ip->session_reusable)
+    _session_park (ip);
   else
+    _destroy_ipmipower_powercmd (ip);
+
+  pending_count--;
+  executing_count--;
+
+  _waiting_release ();
+}
+
+/* _session_close_idle
+ * - Close and destroy idle session ip
+ */
+static void
+_session_close_idle (ipmipower_powercmd_t ip)
+{
+  assert (ip);
+  assert (ip->protocol_state == IPMIPOWER_PROTOCOL_STATE_SESSION_IDLE);
+  assert (ip->ic->session == ip);
+
+  if (ip->pending_index >= 0)
+    _pending_heap_remove (ip);
+
+  ip->ic->session = NULL;
+  idle_count--;
+
+  IPMIPOWER_DEBUG (("host = %s; closing idle session", ip->ic->hostname));
+
+  /* Don't wait for the response, see comments about retransmitting
+   * close session requests in _retry_packets().  A late response is
+   * dropped when the next power command clears the connection.
+   */
+  _send_packet (ip, IPMIPOWER_PACKET_TYPE_CLOSE_SESSION_RQ);
+
+  _destroy_ipmipower_powercmd (ip);
+}
+
+void
+ipmipower_powercmd_idle_sessions_close (void)
+{
+  ipmipower_powercmd_t *sessions;
+  unsigned int i, count = 0;
+
+  assert (fanout_waiting);  /* did not run ipmipower_powercmd_setup() */
+
+  if (!idle_count)
+    return;
+
+  /* closing modifies the heap, so gather them first */
+  if (!(sessions = (ipmipower_powercmd_t *)malloc (sizeof (ipmipower_powercmd_t) * idle_count)))
     {
-      int retransmission_timeout = cmd_args.common_args.retransmission_timeout * (1 + (ip->retransmission_count/cmd_args.retransmission_backoff_count));
-      if (timeout > retransmission_timeout)
-        timeout = retransmission_timeout;
+      IPMIPOWER_ERROR (("malloc: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
     }
 
-  return (timeout);
+  for (i = 0; i < pending_heap_count; i++)
+    {
+      if (pending[i]->protocol_state == IPMIPOWER_PROTOCOL_STATE_SESSION_IDLE)
+        sessions[count++] = pending[i];
+    }
+
+  assert (count == idle_count);
+
+  for (i = 0; i < count; i++)
+    _session_close_idle (sessions[i]);
+
+  free (sessions);
 }
 
 int
 ipmipower_powercmd_process_pending (int *timeout)
 {
-  ListIterator itr;
   ipmipower_powercmd_t ip;
+  struct timeval cur_time;
   int min_timeout = cmd_args.common_args.session_timeout;
-  int num_pending;
+  unsigned int pending_count_begin;
 
-  assert (pending);  /* did not run ipmipower_powercmd_setup() */
+  assert (fanout_waiting);  /* did not run ipmipower_powercmd_setup() */
   assert (timeout);
 
-  /* if there are no pending jobs, don't edit the timeout */
-  if (list_is_empty (pending))
+  /* if there are no pending jobs or idle sessions, don't edit the
+   * timeout
+   */
+  if (!pending_count && !idle_count)
     return (0);
 
-  /* If we have a fanout, powercmds should be executed "in order" on
-   * this list.  So no need to iterate through this list twice.
-   */
+  pending_count_begin = pending_count;
 
-  if (!(itr = list_iterator_create (pending)))
+  if (gettimeofday (&cur_time, NULL) < 0)
     {
-      IPMIPOWER_ERROR (("list_iterator_create: %s", strerror (errno)));
+      IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
       exit (EXIT_FAILURE);
     }
 
-  while ((ip = (ipmipower_powercmd_t)list_next (itr)))
+  /* Only process commands whose time has come or that have received
+   * a packet.  Commands scheduled "immediately" have a cleared
+   * next_process_time and are at the top of the heap.
+   */
+  while (pending_heap_count
+         && !timeval_gt (&(pending[0]->next_process_time), &cur_time))
     {
-      int tmp_timeout = -1;
+      struct timeval next_process_time;
+      int tmp_timeout;
 
-      if ((tmp_timeout = _process_ipmi_packets (ip)) < 0)
-        {
-          if (cmd_args.oem_power_type == IPMIPOWER_OEM_POWER_TYPE_C410X)
-            {
-              if (ip->next)
-                {
-                  if (!list_append (add_to_pending, ip->next))
-                    {
-                      IPMIPOWER_ERROR (("list_append: %s", strerror (errno)));
-                      exit (EXIT_FAILURE);
-                    }
+      ip = pending[0];
+      _pending_heap_remove (ip);
 
-                  ip->next = NULL;
-                }
-            }
+      /* idle session has expired */
+      if (ip->protocol_state == IPMIPOWER_PROTOCOL_STATE_SESSION_IDLE)
+        {
+          _session_close_idle (ip);
+          continue;
+        }
 
-          if (!list_delete (itr))
-            {
-              IPMIPOWER_ERROR (("list_delete"));
-              exit (EXIT_FAILURE);
-            }
+      /* END w/o error if the session is kept for reuse, see
+       * _close_session()
+       */
+      if ((tmp_timeout = _process_ipmi_packets (ip)) < 0
+          || ip->protocol_state == IPMIPOWER_PROTOCOL_STATE_END)
+        {
+          _pending_finish (ip);
+          continue;
+        }
 
-          executing_count--;
+      /* If we have a fanout, powercmds should be executed "in order".
+       * Commands that could not start wait on a FIFO until another
+       * command finishes.  Commands admitted by the wave scheduler
+       * but waiting on the rate are rescheduled below.
+       */
+      if (ip->protocol_state == IPMIPOWER_PROTOCOL_STATE_START
+          && !ip->wave_admitted)
+        {
+          _waiting_append (ip);
           continue;
         }
 
-      if (tmp_timeout < min_timeout)
-        min_timeout = tmp_timeout;
+      /* must be at least 1ms to guarantee we don't spin in this loop */
+      if (!tmp_timeout)
+        tmp_timeout = 1;
+
+      timeval_add_ms (&cur_time, tmp_timeout, &next_process_time);
+      _pending_schedule (ip, &next_process_time);
     }
-  list_iterator_destroy (itr);
 
   if (list_count (add_to_pending) > 0)
     {
-      ListIterator addtoitr;
-
-      if (!(addtoitr = list_iterator_create (add_to_pending)))
-        {
-          IPMIPOWER_ERROR (("list_iterator_create: %s", strerror (errno)));
-          exit (EXIT_FAILURE);
-        }
-      while ((ip = list_next (addtoitr)))
+      while ((ip = list_dequeue (add_to_pending)))
         {
           ipmipower_connection_clear (ip->ic);
-          if (!list_append (pending, ip))
-            {
-              IPMIPOWER_ERROR (("list_append: %s", strerror (errno)));
-              exit (EXIT_FAILURE);
-            }
-
-          if (!list_delete (addtoitr))
-            {
-              IPMIPOWER_ERROR (("list_delete"));
-              exit (EXIT_FAILURE);
-            }
+          _pending_start (ip);
         }
+    }
 
-      list_iterator_destroy (addtoitr);
+  if (pending_heap_count)
+    {
+      struct timeval result;
+      unsigned int ms;
 
-      /* If by chance all commands are going to the same host, then
-       * the next powercmd will start after a default timeout.  We
-       * don't want that.  We'll shorten the timeout to a
-       * retransmission timeout so it appears more normal.
-       */
+      timeval_sub (&(pending[0]->next_process_time), &cur_time, &result);
+      timeval_millisecond_calc (&result, &ms);
 
-      if (cmd_args.common_args.retransmission_timeout < min_timeout)
-        min_timeout = cmd_args.common_args.retransmission_timeout;
+      /* round up, we don't want to wake up right before the timeout */
+      if (result.tv_usec % 1000)
+        ms++;
+
+      if (ms < min_timeout)
+        min_timeout = ms;
     }
 
-  if (!(num_pending = list_count (pending)))
+  if (pending_count_begin && !pending_count)
     ipmipower_output_finish ();
 
   /* If the last pending power control command finished, the timeout
    * is 0 to get the primary poll loop to "re-init" at the start of
-   * the loop.
+   * the loop.  If only idle sessions are left, wake up when the next
+   * one expires.
    */
-  if (num_pending)
+  if (pending_count)
     *timeout = min_timeout;
-  else
+  else if (pending_count_begin)
     *timeout = 0;
-  return (num_pending);
+  else if (pending_heap_count)
+    *timeout = min_timeout;
+  return (pending_count);
 }
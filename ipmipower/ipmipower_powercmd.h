@@ -43,10 +43,26 @@ void ipmipower_powercmd_queue (ipmipower_power_cmd_t cmd,
  */
 int ipmipower_powercmd_pending ();
 
+/* ipmipower_powercmd_packet_received
+ * - Notify that a packet was received on the connection, so the
+ *   power command executing on it will be processed on the next call
+ *   to ipmipower_powercmd_process_pending().
+ */
+void ipmipower_powercmd_packet_received (struct ipmipower_connection *ic);
+
+/* ipmipower_powercmd_idle_sessions_close
+ * - Close all sessions kept open for reuse, see
+ *   --session-idle-timeout.
+ */
+void ipmipower_powercmd_idle_sessions_close (void);
+
 /* ipmipower_powercmd_process_pending
- * - Process remaining commands still in the queue
- * - Sets timeout to min timeout of all pending requests
- * - Does not set timeout if no pending requests exist
+ * - Process commands in the queue that have timed out, need to
+ *   retransmit, or have received a packet
+ * - Close sessions that have been idle too long
+ * - Sets timeout to min timeout of all pending requests, or of idle
+ *   sessions if no requests are pending
+ * - Does not set timeout if no pending requests or idle sessions exist
  * Returns number of pending requests, 0 if none
  */
 int ipmipower_powercmd_process_pending (int *timeout);
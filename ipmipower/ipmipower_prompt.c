@@ -114,6 +114,12 @@ _cmd_hostname_clear (void)
   free (cmd_args.common_args.hostname);
   cmd_args.common_args.hostname = NULL;
 
+  /* idle sessions reference the connections, and their close
+   * session requests must go out before the connections go away
+   */
+  ipmipower_powercmd_idle_sessions_close ();
+  ipmipower_connection_array_flush (ics, ics_len, IPMIPOWER_SESSION_CLOSE_FLUSH_TIMEOUT);
+
   ipmipower_connection_array_destroy (ics, ics_len);
   ics = NULL;
   ics_len = 0;
@@ -690,6 +696,7 @@ _cmd_help (void)
                          "ping-packet-count COUNT                  - Specify a new ping packet count.\n"
                          "ping-percent COUNT                       - Specify a new ping percent number.\n"
                          "ping-consec-count COUNT                  - Specify a new ping consec count.\n"
+                         "session-idle-timeout MILLISECONDS        - Specify a new session idle timeout length.\n"
                          "buffer-output [on|off]                   - Toggle buffer-output functionality.\n"
                          "consolidate-output [on|off]              - Toggle consolidate-output functionality.\n"
                          "fanout COUNT                             - Specify a fanout.\n"
@@ -1054,6 +1061,9 @@ _cmd_config (void)
   ipmipower_cbuf_printf (ttyout,
                          "Ping Consec Count:            %u\n",
                          cmd_args.ping_consec_count);
+  ipmipower_cbuf_printf (ttyout,
+                         "Session Idle Timeout:         %u ms\n",
+                         cmd_args.session_idle_timeout);
 
   ipmipower_cbuf_printf (ttyout,
                          "Buffer-Output:                %s\n",
@@ -1247,6 +1257,19 @@ ipmipower_prompt_process_cmdline (void)
 
           if (argv[0])
             {
+              /* idle sessions were established with the current
+               * session settings, they can't be reused if they change
+               */
+              if (!strcmp (argv[0], "driver-type")
+                  || !strcmp (argv[0], "username")
+                  || !strcmp (argv[0], "password")
+                  || !strcmp (argv[0], "k_g")
+                  || !strcmp (argv[0], "authentication-type")
+                  || !strcmp (argv[0], "cipher-suite-id")
+                  || !strcmp (argv[0], "privilege-level")
+                  || !strcmp (argv[0], "workaround-flags"))
+                ipmipower_powercmd_idle_sessions_close ();
+
               if (!strcmp (argv[0], "driver-type"))
                 _cmd_driver_type (argv);
               else if (!strcmp (argv[0], "hostname"))
@@ -1360,6 +1383,13 @@ ipmipower_prompt_process_cmdline (void)
                                               1,
                                               0,
                                               cmd_args.ping_packet_count);
+              else if (!strcmp (argv[0], "session-idle-timeout"))
+                _cmd_set_unsigned_int_ranged (argv,
+                                              &cmd_args.session_idle_timeout,
+                                              "session-idle-timeout",
+                                              1,
+                                              1,
+                                              IPMIPOWER_SESSION_IDLE_TIMEOUT_MAX);
               else if (!strcmp (argv[0], "buffer-output"))
                 _cmd_set_flag (argv,
                                &cmd_args.common_args.buffer_output,
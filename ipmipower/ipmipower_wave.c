@@ -0,0 +1,374 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#if TIME_WITH_SYS_TIME
+#include <sys/time.h>
+#include <time.h>
+#else  /* !TIME_WITH_SYS_TIME */
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else /* !HAVE_SYS_TIME_H */
+#include <time.h>
+#endif  /* !HAVE_SYS_TIME_H */
+#endif /* !TIME_WITH_SYS_TIME */
+#include <errno.h>
+
+#include "ipmipower_wave.h"
+#include "ipmipower_error.h"
+
+#include "freeipmi-portability.h"
+#include "timeval.h"
+
+extern struct ipmipower_arguments cmd_args;
+
+/* Wave scheduling is for powering up a large number of nodes at
+ * once (e.g. a whole data hall) without flooding the network and
+ * BMCs.  A fixed fanout is a poor fit for this, since a fanout that
+ * works for fast BMCs leads to a retransmit storm on slow ones.
+ *
+ * Power commands are admitted into an in-flight window, which is
+ * adapted similarly to a TCP congestion window.  The window grows
+ * while commands complete without retransmissions.  It is halved
+ * when completed commands indicate the BMCs or network are
+ * overloaded, i.e. the smoothed retransmission rate is too high,
+ * commands time out, or the smoothed latency is far above the
+ * fastest latency observed.  The window is halved at most once per
+ * "round", i.e. only commands admitted after the last decrease can
+ * decrease it again.
+ *
+ * Admitted commands are started no faster than --wave-rate, so the
+ * time to reach all hosts is predictable regardless of the window.
+ *
+ * With --wave-groups, each comma separated hostrange on the command
+ * line is a group, and a group is only started after all power
+ * commands to the previous group have completed.
+ */
+
+static unsigned int wave_window;
+static unsigned int wave_window_credit;
+static unsigned int wave_ssthresh;
+static unsigned int wave_inflight;
+
+static unsigned int wave_admit_sequence;
+static unsigned int wave_decrease_sequence;
+
+/* latencies in milliseconds, smoothed latency scaled by 8, smoothed
+ * retransmission rate scaled by 256
+ */
+static unsigned int wave_latency_min;
+static unsigned int wave_latency_avg;
+static unsigned int wave_retransmit_avg;
+
+static struct timeval wave_next_start_time;
+
+/* count of queued but not completed power commands per group */
+static unsigned int *wave_group_count = NULL;
+static unsigned int wave_group_count_len = 0;
+static unsigned int wave_group_current = 0;
+
+#define IPMIPOWER_WAVE_WINDOW_INITIAL            16
+
+/* 25% of power commands needing retransmissions */
+#define IPMIPOWER_WAVE_RETRANSMIT_THRESHOLD      64
+
+#define IPMIPOWER_WAVE_LATENCY_FACTOR            4
+
+int
+ipmipower_wave_enabled (void)
+{
+  return ((cmd_args.wave_window || cmd_args.wave_rate) ? 1 : 0);
+}
+
+static unsigned int
+_wave_window_max (void)
+{
+  unsigned int window_max;
+
+  window_max = cmd_args.wave_window ? cmd_args.wave_window : IPMIPOWER_WAVE_WINDOW_MAX;
+
+  if (cmd_args.common_args.fanout
+      && cmd_args.common_args.fanout < window_max)
+    window_max = cmd_args.common_args.fanout;
+
+  return (window_max);
+}
+
+void
+ipmipower_wave_setup (void)
+{
+  wave_window = IPMIPOWER_WAVE_WINDOW_INITIAL;
+  wave_window_credit = 0;
+  wave_ssthresh = IPMIPOWER_WAVE_WINDOW_MAX;
+  wave_inflight = 0;
+  wave_admit_sequence = 0;
+  wave_decrease_sequence = 0;
+  wave_latency_min = 0;
+  wave_latency_avg = 0;
+  wave_retransmit_avg = 0;
+  timeval_clear (&wave_next_start_time);
+  wave_group_count = NULL;
+  wave_group_count_len = 0;
+  wave_group_current = 0;
+}
+
+void
+ipmipower_wave_cleanup (void)
+{
+  free (wave_group_count);
+  wave_group_count = NULL;
+  wave_group_count_len = 0;
+}
+
+void
+ipmipower_wave_queue (ipmipower_powercmd_t ip)
+{
+  unsigned int group;
+
+  assert (ip);
+
+  group = ip->ic->wave_group;
+
+  if (group >= wave_group_count_len)
+    {
+      unsigned int *tmp;
+      unsigned int len = group + 1;
+
+      if (!(tmp = (unsigned int *)realloc (wave_group_count, sizeof (unsigned int) * len)))
+        {
+          IPMIPOWER_ERROR (("realloc: %s", strerror (errno)));
+          exit (EXIT_FAILURE);
+        }
+      memset (tmp + wave_group_count_len,
+              '\0',
+              sizeof (unsigned int) * (len - wave_group_count_len));
+      wave_group_count = tmp;
+      wave_group_count_len = len;
+    }
+
+  wave_group_count[group]++;
+
+  if (group < wave_group_current)
+    wave_group_current = group;
+
+  ip->wave_admitted = 0;
+  ip->wave_sequence = 0;
+  timeval_clear (&(ip->wave_start_time));
+}
+
+unsigned int
+ipmipower_wave_group_current (void)
+{
+  while (wave_group_current < wave_group_count_len
+         && !wave_group_count[wave_group_current])
+    wave_group_current++;
+
+  /* nothing left, next queued command will reset the group */
+  if (wave_group_current >= wave_group_count_len)
+    wave_group_current = wave_group_count_len;
+
+  return (wave_group_current);
+}
+
+int
+ipmipower_wave_admit (ipmipower_powercmd_t ip)
+{
+  struct timeval cur_time;
+
+  assert (ip);
+  assert (!ip->wave_admitted);
+
+  if (ip->ic->wave_group != ipmipower_wave_group_current ())
+    return (0);
+
+  if (wave_inflight >= wave_window
+      || wave_inflight >= _wave_window_max ())
+    return (0);
+
+  if (gettimeofday (&cur_time, NULL) < 0)
+    {
+      IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  if (cmd_args.wave_rate)
+    {
+      struct timeval interval;
+
+      /* Do not let an idle period build up credit, the point is to
+       * never go faster than the rate.
+       */
+      if (timeval_lt (&wave_next_start_time, &cur_time))
+        wave_next_start_time = cur_time;
+
+      ip->wave_start_time = wave_next_start_time;
+
+      interval.tv_sec = 0;
+      interval.tv_usec = 1000000 / cmd_args.wave_rate;
+      timeval_add (&wave_next_start_time, &interval, &wave_next_start_time);
+    }
+  else
+    ip->wave_start_time = cur_time;
+
+  ip->wave_admitted = 1;
+  ip->wave_sequence = ++wave_admit_sequence;
+  wave_inflight++;
+  return (1);
+}
+
+static void
+_wave_window_decrease (ipmipower_powercmd_t ip)
+{
+  assert (ip);
+
+  /* only once per round */
+  if (ip->wave_sequence <= wave_decrease_sequence)
+    return;
+
+  wave_ssthresh = wave_window / 2;
+  if (!wave_ssthresh)
+    wave_ssthresh = 1;
+  wave_window = wave_ssthresh;
+  wave_window_credit = 0;
+  wave_decrease_sequence = wave_admit_sequence;
+
+  /* start over, so the commands that caused the decrease don't cause
+   * another one
+   */
+  wave_retransmit_avg = 0;
+
+  IPMIPOWER_DEBUG (("wave window decreased to %u", wave_window));
+}
+
+static void
+_wave_window_increase (void)
+{
+  unsigned int window_max = _wave_window_max ();
+
+  if (wave_window >= window_max)
+    {
+      wave_window = window_max;
+      return;
+    }
+
+  /* grow fast until the first decrease, then by one per window of
+   * completed commands
+   */
+  if (wave_window < wave_ssthresh)
+    wave_window++;
+  else if (++wave_window_credit >= wave_window)
+    {
+      wave_window++;
+      wave_window_credit = 0;
+    }
+}
+
+void
+ipmipower_wave_finish (ipmipower_powercmd_t ip)
+{
+  struct timeval cur_time, result;
+  unsigned int latency = 0;
+  int timed_out = 0;
+  int waited;
+  int retransmitted;
+  int congested = 0;
+
+  assert (ip);
+  assert (ip->ic->wave_group < wave_group_count_len);
+  assert (wave_group_count[ip->ic->wave_group]);
+
+  wave_group_count[ip->ic->wave_group]--;
+
+  if (!ip->wave_admitted)
+    return;
+
+  assert (wave_inflight);
+  wave_inflight--;
+
+  /* never sent anything */
+  if (!ip->time_begin.tv_sec && !ip->time_begin.tv_usec)
+    return;
+
+  if (gettimeofday (&cur_time, NULL) < 0)
+    {
+      IPMIPOWER_ERROR (("gettimeofday: %s", strerror (errno)));
+      exit (EXIT_FAILURE);
+    }
+
+  timeval_sub (&cur_time, &(ip->time_begin), &result);
+  timeval_millisecond_calc (&result, &latency);
+
+  if (latency >= cmd_args.common_args.session_timeout)
+    timed_out++;
+
+  /* waiting for power on/off is expected to take long */
+  waited = (ip->wait_until_on_state || ip->wait_until_off_state) ? 1 : 0;
+
+  retransmitted = (timed_out || ip->retransmission_total) ? 1 : 0;
+
+  /* integer arithmetic, avg += (sample - avg) / 8 */
+  wave_retransmit_avg = wave_retransmit_avg
+    - (wave_retransmit_avg >> 3)
+    + (retransmitted ? (256 >> 3) : 0);
+
+  if (!timed_out && !waited)
+    {
+      if (!wave_latency_min || latency < wave_latency_min)
+        wave_latency_min = latency;
+
+      if (!wave_latency_avg)
+        wave_latency_avg = latency << 3;
+      else
+        wave_latency_avg = wave_latency_avg
+          - (wave_latency_avg >> 3)
+          + latency;
+    }
+
+  if (timed_out)
+    congested++;
+  else if (wave_retransmit_avg > IPMIPOWER_WAVE_RETRANSMIT_THRESHOLD)
+    congested++;
+  else if (wave_latency_min
+           && (wave_latency_avg >> 3) > cmd_args.common_args.retransmission_timeout
+           && (wave_latency_avg >> 3) > (wave_latency_min * IPMIPOWER_WAVE_LATENCY_FACTOR))
+    congested++;
+
+  IPMIPOWER_DEBUG (("host = %s; wave latency = %u ms, retransmissions = %u, window = %u, in flight = %u",
+                    ip->ic->hostname,
+                    latency,
+                    ip->retransmission_total,
+                    wave_window,
+                    wave_inflight));
+
+  if (congested)
+    _wave_window_decrease (ip);
+  else if (!retransmitted)
+    _wave_window_increase ();
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMIPOWER_WAVE_H
+#define IPMIPOWER_WAVE_H
+
+#include "ipmipower.h"
+
+/* ipmipower_wave_enabled
+ * - Returns 1 if wave scheduling is configured, 0 if not
+ */
+int ipmipower_wave_enabled (void);
+
+void ipmipower_wave_setup (void);
+
+void ipmipower_wave_cleanup (void);
+
+/* ipmipower_wave_queue
+ * - Account for power command ip in its wave group
+ */
+void ipmipower_wave_queue (ipmipower_powercmd_t ip);
+
+/* ipmipower_wave_admit
+ * - Admit power command ip into the in-flight window if its wave
+ *   group is current and the window has room.  The time it may
+ *   start, according to the target rate, is stored in
+ *   ip->wave_start_time.
+ * - Returns 1 if admitted, 0 if not
+ */
+int ipmipower_wave_admit (ipmipower_powercmd_t ip);
+
+/* ipmipower_wave_finish
+ * - Remove completed power command ip from the in-flight window and
+ *   adapt the window to its latency and retransmissions
+ */
+void ipmipower_wave_finish (ipmipower_powercmd_t ip);
+
+/* ipmipower_wave_group_current
+ * - Returns the wave group whose power commands may currently be
+ *   admitted
+ */
+unsigned int ipmipower_wave_group_current (void);
+
+#endif /* IPMIPOWER_WAVE_H */
@@ -35,6 +35,8 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif /* HAVE_UNISTD_H */
+#include <sys/socket.h>
+#include <sys/un.h>
 #if HAVE_ARGP_H
 #include <argp.h>
 #else /* !HAVE_ARGP_H */
@@ -72,6 +74,8 @@ static struct argp_option cmdline_options[] =
     ARGP_COMMON_OPTIONS_OUTOFBAND_HOSTRANGED,
     ARGP_COMMON_OPTIONS_AUTHENTICATION_TYPE,
     ARGP_COMMON_OPTIONS_CIPHER_SUITE_ID,
+    ARGP_COMMON_OPTIONS_CAPABILITY_CACHE,
+    ARGP_COMMON_OPTIONS_SESSION_BROKER,
     ARGP_COMMON_OPTIONS_PRIVILEGE_LEVEL,
     ARGP_COMMON_OPTIONS_CONFIG_FILE,
     ARGP_COMMON_OPTIONS_WORKAROUND_FLAGS,
@@ -128,6 +132,30 @@ static struct argp_option cmdline_options[] =
       "Do not daemonize, output current SEL as test of current settings.", 64},
     { "foreground", IPMISELD_FOREGROUND_KEY, 0, 0,
       "Run daemon in foreground.", 65},
+    { "async-engine", IPMISELD_ASYNC_ENGINE_KEY, 0, 0,
+      "Check the SEL of many hosts from a single event loop, only hosts with new SEL entries use the threadpool.", 66},
+    { "async-session-count", IPMISELD_ASYNC_SESSION_COUNT_KEY, "NUM", 0,
+      "Specify the maximum number of sessions the async engine has outstanding.", 67},
+    { "poll-interval-min", IPMISELD_POLL_INTERVAL_MIN_KEY, "SECONDS", 0,
+      "Specify the poll interval of hosts with new SEL events or a SEL past the warning threshold.", 68},
+    { "poll-interval-max", IPMISELD_POLL_INTERVAL_MAX_KEY, "SECONDS", 0,
+      "Specify the poll interval hosts without new SEL events back off to.", 69},
+    { "poll-rate-max", IPMISELD_POLL_RATE_MAX_KEY, "NUM", 0,
+      "Specify the maximum number of hosts polled per second.", 70},
+    { "per-host-data-cache", IPMISELD_PER_HOST_DATA_CACHE_KEY, 0, 0,
+      "Store SEL state in one cache file per host rather than a single state store.", 71},
+    { "output-sink", IPMISELD_OUTPUT_SINK_KEY, "STRING", 0,
+      "Specify where SEL events are output, syslog, file, or socket.", 72},
+    { "output-path", IPMISELD_OUTPUT_PATH_KEY, "PATH", 0,
+      "Specify the file or unix datagram socket SEL events are output to.", 73},
+    { "output-format", IPMISELD_OUTPUT_FORMAT_KEY, "STRING", 0,
+      "Specify the output format, text or keyvalue.", 74},
+    { "output-rotate-size", IPMISELD_OUTPUT_ROTATE_SIZE_KEY, "BYTES", 0,
+      "Specify the size the output file is rotated at.", 75},
+    { "output-rotate-count", IPMISELD_OUTPUT_ROTATE_COUNT_KEY, "NUM", 0,
+      "Specify the number of rotated output files kept.", 76},
+    { "output-queue-length", IPMISELD_OUTPUT_QUEUE_LENGTH_KEY, "NUM", 0,
+      "Specify the maximum number of log messages waiting to be output.", 77},
     { NULL, 0, NULL, 0, NULL, 0}
   };
 
@@ -278,6 +306,63 @@ cmdline_parse (int key, char *arg, struct argp_state *state)
           exit (EXIT_FAILURE);
         }
       break;
+    case IPMISELD_OUTPUT_SINK_KEY:
+      if (!(cmd_args->output_sink_str = strdup (arg)))
+        {
+          perror ("strdup");
+          exit (EXIT_FAILURE);
+        }
+      break;
+    case IPMISELD_OUTPUT_PATH_KEY:
+      if (!(cmd_args->output_path = strdup (arg)))
+        {
+          perror ("strdup");
+          exit (EXIT_FAILURE);
+        }
+      break;
+    case IPMISELD_OUTPUT_FORMAT_KEY:
+      if (!(cmd_args->output_format_str = strdup (arg)))
+        {
+          perror ("strdup");
+          exit (EXIT_FAILURE);
+        }
+      break;
+    case IPMISELD_OUTPUT_ROTATE_SIZE_KEY:
+      errno = 0;
+      tmp = strtol (arg, &endptr, 0);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp < 0)
+        {
+          fprintf (stderr, "invalid output rotate size\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->output_rotate_size = tmp;
+      break;
+    case IPMISELD_OUTPUT_ROTATE_COUNT_KEY:
+      errno = 0;
+      tmp = strtol (arg, &endptr, 0);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp <= 0)
+        {
+          fprintf (stderr, "invalid output rotate count\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->output_rotate_count = tmp;
+      break;
+    case IPMISELD_OUTPUT_QUEUE_LENGTH_KEY:
+      errno = 0;
+      tmp = strtol (arg, &endptr, 0);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp <= 0)
+        {
+          fprintf (stderr, "invalid output queue length\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->output_queue_length = tmp;
+      break;
     case IPMISELD_CACHE_DIRECTORY_KEY:
       if (!(cmd_args->cache_directory = strdup (arg)))
         {
@@ -285,6 +370,9 @@ cmdline_parse (int key, char *arg, struct argp_state *state)
           exit (EXIT_FAILURE);
         }
       break;
+    case IPMISELD_PER_HOST_DATA_CACHE_KEY:
+      cmd_args->per_host_data_cache = 1;
+      break;
     case IPMISELD_IGNORE_SDR_KEY:
       cmd_args->ignore_sdr = 1;
       break;
@@ -312,6 +400,57 @@ cmdline_parse (int key, char *arg, struct argp_state *state)
     case IPMISELD_FOREGROUND_KEY:
       cmd_args->foreground = 1;
       break;
+    case IPMISELD_ASYNC_ENGINE_KEY:
+      cmd_args->async_engine = 1;
+      break;
+    case IPMISELD_ASYNC_SESSION_COUNT_KEY:
+      errno = 0;
+      tmp = strtol (arg, &endptr, 0);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp <= 0)
+        {
+          fprintf (stderr, "invalid async session count\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->async_session_count = tmp;
+      break;
+    case IPMISELD_POLL_INTERVAL_MIN_KEY:
+      errno = 0;
+      tmp = strtol (arg, &endptr, 0);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp <= 0)
+        {
+          fprintf (stderr, "invalid poll interval min\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->poll_interval_min = tmp;
+      break;
+    case IPMISELD_POLL_INTERVAL_MAX_KEY:
+      errno = 0;
+      tmp = strtol (arg, &endptr, 0);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp <= 0)
+        {
+          fprintf (stderr, "invalid poll interval max\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->poll_interval_max = tmp;
+      break;
+    case IPMISELD_POLL_RATE_MAX_KEY:
+      errno = 0;
+      tmp = strtol (arg, &endptr, 0);
+      if (errno
+          || endptr[0] != '\0'
+          || tmp <= 0)
+        {
+          fprintf (stderr, "invalid poll rate max\n");
+          exit (EXIT_FAILURE);
+        }
+      cmd_args->poll_rate_max = tmp;
+      break;
     case ARGP_KEY_ARG:
       /* Too many arguments. */
       argp_usage (state);
@@ -421,12 +560,32 @@ _ipmiseld_config_file_parse (struct ipmiseld_arguments *cmd_args)
     cmd_args->oem_non_timestamped_event_format_str = config_file_data.oem_non_timestamped_event_format_str;
   if (config_file_data.poll_interval_count)
     cmd_args->poll_interval = config_file_data.poll_interval;
+  if (config_file_data.poll_interval_min_count)
+    cmd_args->poll_interval_min = config_file_data.poll_interval_min;
+  if (config_file_data.poll_interval_max_count)
+    cmd_args->poll_interval_max = config_file_data.poll_interval_max;
+  if (config_file_data.poll_rate_max_count)
+    cmd_args->poll_rate_max = config_file_data.poll_rate_max;
   if (config_file_data.log_facility_str_count)
     cmd_args->log_facility_str = config_file_data.log_facility_str;
   if (config_file_data.log_priority_str_count)
     cmd_args->log_priority_str = config_file_data.log_priority_str;
+  if (config_file_data.output_sink_str_count)
+    cmd_args->output_sink_str = config_file_data.output_sink_str;
+  if (config_file_data.output_path_count)
+    cmd_args->output_path = config_file_data.output_path;
+  if (config_file_data.output_format_str_count)
+    cmd_args->output_format_str = config_file_data.output_format_str;
+  if (config_file_data.output_rotate_size_count)
+    cmd_args->output_rotate_size = config_file_data.output_rotate_size;
+  if (config_file_data.output_rotate_count_count)
+    cmd_args->output_rotate_count = config_file_data.output_rotate_count;
+  if (config_file_data.output_queue_length_count)
+    cmd_args->output_queue_length = config_file_data.output_queue_length;
   if (config_file_data.cache_directory_count)
     cmd_args->cache_directory = config_file_data.cache_directory;
+  if (config_file_data.per_host_data_cache_count)
+    cmd_args->per_host_data_cache = config_file_data.per_host_data_cache;
   if (config_file_data.ignore_sdr_count)
     cmd_args->ignore_sdr = config_file_data.ignore_sdr;
   if (config_file_data.re_download_sdr_count)
@@ -435,6 +594,10 @@ _ipmiseld_config_file_parse (struct ipmiseld_arguments *cmd_args)
     cmd_args->clear_sel = config_file_data.clear_sel;
   if (config_file_data.threadpool_count_count)
     cmd_args->threadpool_count = config_file_data.threadpool_count;
+  if (config_file_data.async_engine_count)
+    cmd_args->async_engine = config_file_data.async_engine;
+  if (config_file_data.async_session_count_count)
+    cmd_args->async_session_count = config_file_data.async_session_count;
 }
 
 static void
@@ -462,6 +625,17 @@ _ipmiseld_args_validate (struct ipmiseld_arguments *cmd_args)
         err_exit ("Invalid event state filter specified\n");
     }
 
+  /* without a min or max, the interval is fixed */
+  if (!cmd_args->poll_interval_min)
+    cmd_args->poll_interval_min = cmd_args->poll_interval;
+
+  if (!cmd_args->poll_interval_max)
+    cmd_args->poll_interval_max = cmd_args->poll_interval;
+
+  if (cmd_args->poll_interval_min > cmd_args->poll_interval
+      || cmd_args->poll_interval_max < cmd_args->poll_interval)
+    err_exit ("poll interval must be between poll interval min and max\n");
+
   if (cmd_args->log_facility_str)
     {
       if (ipmiseld_log_facility_parse (cmd_args->log_facility_str) < 0)
@@ -474,6 +648,34 @@ _ipmiseld_args_validate (struct ipmiseld_arguments *cmd_args)
         err_exit ("Invalid log priority specified\n");
     }
 
+  if (cmd_args->output_sink_str)
+    {
+      int output_sink;
+
+      if ((output_sink = ipmiseld_output_sink_parse (cmd_args->output_sink_str)) < 0)
+        err_exit ("Invalid output sink specified\n");
+
+      if (output_sink != IPMISELD_OUTPUT_SINK_SYSLOG
+          && !cmd_args->output_path)
+        err_exit ("output path must be specified for output sink '%s'\n",
+                  cmd_args->output_sink_str);
+
+      if (output_sink == IPMISELD_OUTPUT_SINK_SOCKET)
+        {
+          struct sockaddr_un addr;
+
+          if (strlen (cmd_args->output_path) >= sizeof (addr.sun_path))
+            err_exit ("output path '%s' too long for a socket\n",
+                      cmd_args->output_path);
+        }
+    }
+
+  if (cmd_args->output_format_str)
+    {
+      if (ipmiseld_output_format_parse (cmd_args->output_format_str) < 0)
+        err_exit ("Invalid output format specified\n");
+    }
+
   if (cmd_args->cache_directory)
     {
       if (access (cmd_args->cache_directory, R_OK|W_OK|X_OK) < 0)
@@ -524,15 +726,27 @@ ipmiseld_argp_parse (int argc, char **argv, struct ipmiseld_arguments *cmd_args)
   cmd_args->oem_timestamped_event_format_str = NULL;
   cmd_args->oem_non_timestamped_event_format_str = NULL;
   cmd_args->poll_interval = IPMISELD_POLL_INTERVAL_DEFAULT;
+  cmd_args->poll_interval_min = 0;
+  cmd_args->poll_interval_max = 0;
+  cmd_args->poll_rate_max = 0;
   cmd_args->log_facility_str = NULL;
   cmd_args->log_priority_str = NULL;
+  cmd_args->output_sink_str = NULL;
+  cmd_args->output_path = NULL;
+  cmd_args->output_format_str = NULL;
+  cmd_args->output_rotate_size = 0;
+  cmd_args->output_rotate_count = IPMISELD_OUTPUT_ROTATE_COUNT_DEFAULT;
+  cmd_args->output_queue_length = IPMISELD_OUTPUT_QUEUE_LENGTH_DEFAULT;
   cmd_args->cache_directory = NULL;
+  cmd_args->per_host_data_cache = 0;
   cmd_args->ignore_sdr = 0;
   cmd_args->re_download_sdr = 0;
   cmd_args->clear_sel = 0;
   cmd_args->threadpool_count = IPMISELD_THREADPOOL_COUNT;
   cmd_args->test_run = 0;
   cmd_args->foreground = 0;
+  cmd_args->async_engine = 0;
+  cmd_args->async_session_count = IPMISELD_ASYNC_SESSION_COUNT_DEFAULT;
 
   argp_parse (&cmdline_config_file_argp,
               argc,
@@ -41,6 +41,8 @@
 #include <fcntl.h>
 #endif /* HAVE_FCNTL_H */
 #include <sys/param.h>          /* MAXPATHLEN */
+#include <time.h>
+#include <pthread.h>
 #include <assert.h>
 #include <errno.h>
 
@@ -52,6 +54,7 @@
 #include "freeipmi-portability.h"
 #include "error.h"
 #include "fd.h"
+#include "hash.h"
 
 #ifndef MAXPATHLEN
 #define MAXPATHLEN 4096
@@ -86,7 +89,10 @@
 
 #define IPMISELD_DATA_CACHE_FILE_VERSION  0x00000001
 
-#define IPMISELD_DATA_CACHE_LENGTH        (4 + 4 + 2 + 4 + 2 + 2 + 4 + 4 + 1 + 1 + 1 + 1)
+/* last_record_id through overflow_flag */
+#define IPMISELD_DATA_CACHE_STATE_LENGTH  (2 + 4 + 2 + 2 + 4 + 4 + 1 + 1 + 1)
+
+#define IPMISELD_DATA_CACHE_LENGTH        (4 + 4 + IPMISELD_DATA_CACHE_STATE_LENGTH + 1)
 
 static int
 _ipmiseld_sdr_cache_create (ipmiseld_host_data_t *host_data,
@@ -135,27 +141,33 @@ ipmiseld_sdr_cache_create_and_load (ipmiseld_host_data_t *host_data)
 
   memset (filename, '\0', MAXPATHLEN + 1);
 
-  if (!(host_data->host_poll->sdr_ctx = ipmi_sdr_ctx_create ()))
-    {
-      ipmiseld_err_output (host_data, "ipmi_sdr_ctx_create: %s", strerror (errno));
-      goto cleanup;
-    }
+  if (host_data->host_poll->sdr_cache_open)
+    return (0);
 
-  if (host_data->prog_data->args->foreground
-      && host_data->prog_data->args->common_args.debug > 1)
+  if (!host_data->host_poll->sdr_ctx)
     {
-      /* Don't error out, if this fails we can still continue */
-      if (ipmi_sdr_ctx_set_flags (host_data->host_poll->sdr_ctx, IPMI_SDR_FLAGS_DEBUG_DUMP) < 0)
-        ipmiseld_err_output (host_data,
-                             "ipmi_sdr_ctx_set_flags: %s",
-                             ipmi_sdr_ctx_errormsg (host_data->host_poll->sdr_ctx));
+      if (!(host_data->host_poll->sdr_ctx = ipmi_sdr_ctx_create ()))
+        {
+          ipmiseld_err_output (host_data, "ipmi_sdr_ctx_create: %s", strerror (errno));
+          return (-1);
+        }
 
-      if (host_data->hostname)
+      if (host_data->prog_data->args->foreground
+          && host_data->prog_data->args->common_args.debug > 1)
         {
-          if (ipmi_sdr_ctx_set_debug_prefix (host_data->host_poll->sdr_ctx, host_data->hostname) < 0)
+          /* Don't error out, if this fails we can still continue */
+          if (ipmi_sdr_ctx_set_flags (host_data->host_poll->sdr_ctx, IPMI_SDR_FLAGS_DEBUG_DUMP) < 0)
             ipmiseld_err_output (host_data,
-                                 "ipmi_sdr_ctx_set_debug_prefix: %s",
+                                 "ipmi_sdr_ctx_set_flags: %s",
                                  ipmi_sdr_ctx_errormsg (host_data->host_poll->sdr_ctx));
+
+          if (host_data->hostname)
+            {
+              if (ipmi_sdr_ctx_set_debug_prefix (host_data->host_poll->sdr_ctx, host_data->hostname) < 0)
+                ipmiseld_err_output (host_data,
+                                     "ipmi_sdr_ctx_set_debug_prefix: %s",
+                                     ipmi_sdr_ctx_errormsg (host_data->host_poll->sdr_ctx));
+            }
         }
     }
 
@@ -240,12 +252,13 @@ ipmiseld_sdr_cache_create_and_load (ipmiseld_host_data_t *host_data)
         }
     }
 
+  host_data->host_poll->sdr_cache_open = 1;
   return (0);
 
  cleanup:
+  /* sdr_ctx is kept for the next attempt */
   if (strlen (filename))
     ipmi_sdr_cache_delete (host_data->host_poll->sdr_ctx, filename);
-  ipmi_sdr_ctx_destroy (host_data->host_poll->sdr_ctx);
   return (-1);
 }
 
@@ -317,11 +330,35 @@ _unmarshall_uint8 (uint8_t *databuf, uint8_t *value)
   return (sizeof (uint8_t));
 }
 
+static unsigned int
+_unmarshall_state (uint8_t *databuf, ipmiseld_host_state_t *state)
+{
+  unsigned int databuf_offset = 0;
+
+  assert (databuf);
+  assert (state);
+
+  databuf_offset += _unmarshall_uint16 (databuf + databuf_offset, &state->last_record_id.record_id);
+  state->last_record_id.loaded = 1;
+  databuf_offset += _unmarshall_uint32 (databuf + databuf_offset, &state->last_percent_full);
+  databuf_offset += _unmarshall_uint16 (databuf + databuf_offset, &state->sel_info.entries);
+  databuf_offset += _unmarshall_uint16 (databuf + databuf_offset, &state->sel_info.free_space);
+  databuf_offset += _unmarshall_uint32 (databuf + databuf_offset, &state->sel_info.most_recent_addition_timestamp);
+  databuf_offset += _unmarshall_uint32 (databuf + databuf_offset, &state->sel_info.most_recent_erase_timestamp);
+  databuf_offset += _unmarshall_uint8 (databuf + databuf_offset, &state->sel_info.delete_sel_command_supported);
+  databuf_offset += _unmarshall_uint8 (databuf + databuf_offset, &state->sel_info.reserve_sel_command_supported);
+  databuf_offset += _unmarshall_uint8 (databuf + databuf_offset, &state->sel_info.overflow_flag);
+  state->initialized = 1;
+
+  assert (databuf_offset == IPMISELD_DATA_CACHE_STATE_LENGTH);
+  return (databuf_offset);
+}
+
 /* returns 1 on data found/loaded, 0 if not found, -1 on error loading
  *  (permission, corrupted, etc.)
  */
-int
-ipmiseld_data_cache_load (ipmiseld_host_data_t *host_data)
+static int
+_data_cache_file_load (ipmiseld_host_data_t *host_data)
 {
   uint32_t file_magic;
   uint32_t file_version;
@@ -405,17 +442,7 @@ ipmiseld_data_cache_load (ipmiseld_host_data_t *host_data)
       goto cleanup;
     }
 
-  databuf_offset += _unmarshall_uint16 (databuf + databuf_offset, &host_data->last_host_state.last_record_id.record_id);
-  host_data->last_host_state.last_record_id.loaded = 1;
-  databuf_offset += _unmarshall_uint32 (databuf + databuf_offset, &host_data->last_host_state.last_percent_full);
-  databuf_offset += _unmarshall_uint16 (databuf + databuf_offset, &host_data->last_host_state.sel_info.entries);
-  databuf_offset += _unmarshall_uint16 (databuf + databuf_offset, &host_data->last_host_state.sel_info.free_space);
-  databuf_offset += _unmarshall_uint32 (databuf + databuf_offset, &host_data->last_host_state.sel_info.most_recent_addition_timestamp);
-  databuf_offset += _unmarshall_uint32 (databuf + databuf_offset, &host_data->last_host_state.sel_info.most_recent_erase_timestamp);
-  databuf_offset += _unmarshall_uint8 (databuf + databuf_offset, &host_data->last_host_state.sel_info.delete_sel_command_supported);
-  databuf_offset += _unmarshall_uint8 (databuf + databuf_offset, &host_data->last_host_state.sel_info.reserve_sel_command_supported);
-  databuf_offset += _unmarshall_uint8 (databuf + databuf_offset, &host_data->last_host_state.sel_info.overflow_flag);
-  host_data->last_host_state.initialized = 1;
+  databuf_offset += _unmarshall_state (databuf + databuf_offset, &host_data->last_host_state);
 
   rv = 1;
  cleanup:
@@ -459,8 +486,30 @@ _marshall_uint8 (uint8_t *databuf, uint8_t value)
   return (sizeof (uint8_t));
 }
 
-int
-ipmiseld_data_cache_store (ipmiseld_host_data_t *host_data)
+static unsigned int
+_marshall_state (uint8_t *databuf, ipmiseld_host_state_t *state)
+{
+  unsigned int databuf_offset = 0;
+
+  assert (databuf);
+  assert (state);
+
+  databuf_offset += _marshall_uint16 (databuf + databuf_offset, state->last_record_id.record_id);
+  databuf_offset += _marshall_uint32 (databuf + databuf_offset, state->last_percent_full);
+  databuf_offset += _marshall_uint16 (databuf + databuf_offset, state->sel_info.entries);
+  databuf_offset += _marshall_uint16 (databuf + databuf_offset, state->sel_info.free_space);
+  databuf_offset += _marshall_uint32 (databuf + databuf_offset, state->sel_info.most_recent_addition_timestamp);
+  databuf_offset += _marshall_uint32 (databuf + databuf_offset, state->sel_info.most_recent_erase_timestamp);
+  databuf_offset += _marshall_uint8 (databuf + databuf_offset, state->sel_info.delete_sel_command_supported);
+  databuf_offset += _marshall_uint8 (databuf + databuf_offset, state->sel_info.reserve_sel_command_supported);
+  databuf_offset += _marshall_uint8 (databuf + databuf_offset, state->sel_info.overflow_flag);
+
+  assert (databuf_offset == IPMISELD_DATA_CACHE_STATE_LENGTH);
+  return (databuf_offset);
+}
+
+static int
+_data_cache_file_store (ipmiseld_host_data_t *host_data)
 {
   uint32_t file_magic = IPMISELD_DATA_CACHE_FILE_MAGIC;
   uint32_t file_version = IPMISELD_DATA_CACHE_FILE_VERSION;
@@ -515,15 +564,7 @@ ipmiseld_data_cache_store (ipmiseld_host_data_t *host_data)
 
   databuf_offset += _marshall_uint32 (databuf + databuf_offset, file_magic);
   databuf_offset += _marshall_uint32 (databuf + databuf_offset, file_version);
-  databuf_offset += _marshall_uint16 (databuf + databuf_offset, host_data->last_host_state.last_record_id.record_id);
-  databuf_offset += _marshall_uint32 (databuf + databuf_offset, host_data->last_host_state.last_percent_full);
-  databuf_offset += _marshall_uint16 (databuf + databuf_offset, host_data->last_host_state.sel_info.entries);
-  databuf_offset += _marshall_uint16 (databuf + databuf_offset, host_data->last_host_state.sel_info.free_space);
-  databuf_offset += _marshall_uint32 (databuf + databuf_offset, host_data->last_host_state.sel_info.most_recent_addition_timestamp);
-  databuf_offset += _marshall_uint32 (databuf + databuf_offset, host_data->last_host_state.sel_info.most_recent_erase_timestamp);
-  databuf_offset += _marshall_uint8 (databuf + databuf_offset, host_data->last_host_state.sel_info.delete_sel_command_supported);
-  databuf_offset += _marshall_uint8 (databuf + databuf_offset, host_data->last_host_state.sel_info.reserve_sel_command_supported);
-  databuf_offset += _marshall_uint8 (databuf + databuf_offset, host_data->last_host_state.sel_info.overflow_flag);
+  databuf_offset += _marshall_state (databuf + databuf_offset, &host_data->last_host_state);
 
   for (i = 0; i < databuf_offset; i++)
     zerosumchecksum += databuf[i];
@@ -565,3 +606,830 @@ ipmiseld_data_cache_store (ipmiseld_host_data_t *host_data)
     }
   return (rv);
 }
+
+/*
+ * State Store Format
+ *
+ * One append-only file for all hosts.  All numbers stored little
+ * endian.
+ *
+ * uint32_t store_magic
+ * uint32_t store_version
+ *
+ * followed by records, the last record for a host is its state
+ *
+ * uint16_t hostname_len
+ * char hostname[hostname_len]
+ * state, as in the data cache format from last_record_id through
+ * overflow_flag
+ * uint8_t zerosumchecksum
+ *
+ * A record cut short by a crash or with a bad checksum ends the
+ * store, everything after it is discarded on the next compaction.
+ *
+ * Records are buffered and written with a single fsync every
+ * IPMISELD_DATA_CACHE_FLUSH_INTERVAL seconds.  A crash loses at most
+ * that much state, so some SEL events may be logged twice but none
+ * are missed.  The store is compacted, rewritten with only the last
+ * record of each host, at startup and whenever it grows to
+ * IPMISELD_DATA_STORE_COMPACT_RATIO times the number of hosts.
+ */
+
+#define IPMISELD_DATA_STORE_FILENAME          "ipmiselddata.store"
+
+#define IPMISELD_DATA_STORE_LOCK_FILENAME     "ipmiselddata.lock"
+
+#define IPMISELD_DATA_STORE_MAGIC             0x4A1B11E7
+
+#define IPMISELD_DATA_STORE_VERSION           0x00000001
+
+#define IPMISELD_DATA_STORE_HEADER_LENGTH     (4 + 4)
+
+#define IPMISELD_DATA_STORE_RECORD_LENGTH(__hostname_len) \
+  (2 + (__hostname_len) + IPMISELD_DATA_CACHE_STATE_LENGTH + 1)
+
+#define IPMISELD_DATA_STORE_HOSTNAME_MAX      0xFFFF
+
+#define IPMISELD_DATA_STORE_FLUSH_BUFLEN      65536
+
+#define IPMISELD_DATA_STORE_COMPACT_RATIO     4
+
+#define IPMISELD_DATA_STORE_COMPACT_MIN       1024
+
+#define IPMISELD_DATA_STORE_HASH_SIZE         1024
+
+struct ipmiseld_data_store_entry
+{
+  char *hostname;
+  ipmiseld_host_state_t state;
+};
+
+static int data_store_enabled = 0;
+static pthread_mutex_t data_store_lock = PTHREAD_MUTEX_INITIALIZER;
+static char data_store_dirname[MAXPATHLEN + 1];
+static char data_store_filename[MAXPATHLEN + 1];
+static int data_store_fd = -1;
+static int data_store_lock_fd = -1;
+/* last state of each host, to compact without reading the store */
+static hash_t data_store_hash = NULL;
+static uint8_t *data_store_buf = NULL;
+static unsigned int data_store_buflen = 0;
+static unsigned int data_store_bufsize = 0;
+static time_t data_store_last_flush = 0;
+static unsigned int data_store_records = 0;
+/* A flush failed, the store may be missing the records dropped with
+ * the buffer, so it is rewritten from the hash on the next flush.
+ */
+static int data_store_dirty = 0;
+
+static void
+_data_store_entry_destroy (void *x)
+{
+  struct ipmiseld_data_store_entry *entry;
+
+  assert (x);
+
+  entry = (struct ipmiseld_data_store_entry *)x;
+  free (entry->hostname);
+  free (entry);
+}
+
+static unsigned int
+_data_store_hash_key (const void *key)
+{
+  assert (key);
+
+  return (hash_key_string ((const char *)key));
+}
+
+static int
+_data_store_hash_cmp (const void *key1, const void *key2)
+{
+  assert (key1);
+  assert (key2);
+
+  return (strcmp ((const char *)key1, (const char *)key2));
+}
+
+static const char *
+_data_store_hostname (ipmiseld_host_data_t *host_data)
+{
+  assert (host_data);
+
+  if (host_data->hostname)
+    return (host_data->hostname);
+  return (IPMISELD_CACHE_INBAND);
+}
+
+/* the store is locked by the caller or not yet shared */
+static int
+_data_store_update (const char *hostname, ipmiseld_host_state_t *state)
+{
+  struct ipmiseld_data_store_entry *entry;
+
+  assert (hostname);
+  assert (state);
+
+  if ((entry = hash_find (data_store_hash, hostname)))
+    {
+      memcpy (&entry->state, state, sizeof (ipmiseld_host_state_t));
+      return (0);
+    }
+
+  if (!(entry = (struct ipmiseld_data_store_entry *)malloc (sizeof (struct ipmiseld_data_store_entry))))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      return (-1);
+    }
+
+  if (!(entry->hostname = strdup (hostname)))
+    {
+      err_output ("strdup: %s", strerror (errno));
+      free (entry);
+      return (-1);
+    }
+  memcpy (&entry->state, state, sizeof (ipmiseld_host_state_t));
+
+  if (!hash_insert (data_store_hash, entry->hostname, entry))
+    {
+      err_output ("hash_insert: %s", strerror (errno));
+      _data_store_entry_destroy (entry);
+      return (-1);
+    }
+
+  return (0);
+}
+
+static int
+_data_store_record_marshall (uint8_t *databuf,
+                             const char *hostname,
+                             ipmiseld_host_state_t *state)
+{
+  unsigned int hostname_len;
+  unsigned int databuf_offset = 0;
+  uint8_t zerosumchecksum = 0;
+  unsigned int i;
+
+  assert (databuf);
+  assert (hostname);
+  assert (state);
+
+  hostname_len = strlen (hostname);
+
+  databuf_offset += _marshall_uint16 (databuf + databuf_offset, hostname_len);
+  memcpy (databuf + databuf_offset, hostname, hostname_len);
+  databuf_offset += hostname_len;
+  databuf_offset += _marshall_state (databuf + databuf_offset, state);
+
+  for (i = 0; i < databuf_offset; i++)
+    zerosumchecksum += databuf[i];
+
+  databuf_offset += _marshall_uint8 (databuf + databuf_offset, 0xFF - zerosumchecksum + 1);
+
+  return (databuf_offset);
+}
+
+/* returns record length, 0 at the end of valid records */
+static unsigned int
+_data_store_record_unmarshall (uint8_t *databuf,
+                               unsigned int databuflen,
+                               char *hostname,
+                               ipmiseld_host_state_t *state)
+{
+  uint16_t hostname_len;
+  unsigned int databuf_offset = 0;
+  uint8_t zerosumchecksum = 0;
+  unsigned int i;
+
+  assert (databuf);
+  assert (hostname);
+  assert (state);
+
+  if (databuflen < 2)
+    return (0);
+
+  databuf_offset += _unmarshall_uint16 (databuf + databuf_offset, &hostname_len);
+
+  if (!hostname_len
+      || databuflen < IPMISELD_DATA_STORE_RECORD_LENGTH (hostname_len))
+    return (0);
+
+  for (i = 0; i < IPMISELD_DATA_STORE_RECORD_LENGTH (hostname_len); i++)
+    zerosumchecksum += databuf[i];
+
+  if (zerosumchecksum)
+    return (0);
+
+  memcpy (hostname, databuf + databuf_offset, hostname_len);
+  hostname[hostname_len] = '\0';
+  databuf_offset += hostname_len;
+
+  memset (state, '\0', sizeof (ipmiseld_host_state_t));
+  databuf_offset += _unmarshall_state (databuf + databuf_offset, state);
+  databuf_offset++;             /* checksum */
+
+  return (databuf_offset);
+}
+
+struct _data_store_compact_arg
+{
+  int fd;
+  uint8_t *databuf;
+  int errnum;
+};
+
+static int
+_data_store_compact_write (void *data, const void *key, void *arg)
+{
+  struct ipmiseld_data_store_entry *entry;
+  struct _data_store_compact_arg *compact_arg;
+  unsigned int databuf_offset;
+  int n;
+
+  assert (data);
+  assert (arg);
+
+  entry = (struct ipmiseld_data_store_entry *)data;
+  compact_arg = (struct _data_store_compact_arg *)arg;
+
+  if (compact_arg->errnum)
+    return (0);
+
+  databuf_offset = _data_store_record_marshall (compact_arg->databuf,
+                                                entry->hostname,
+                                                &entry->state);
+
+  if ((n = fd_write_n (compact_arg->fd, compact_arg->databuf, databuf_offset)) < 0)
+    compact_arg->errnum = errno;
+  else if (n != databuf_offset)
+    compact_arg->errnum = EIO;
+
+  return (1);
+}
+
+static void
+_data_store_dir_sync (void)
+{
+  int fd;
+
+  if ((fd = open (data_store_dirname, O_RDONLY)) < 0)
+    {
+      err_output ("Error opening '%s': %s", data_store_dirname, strerror (errno));
+      return;
+    }
+
+  if (fsync (fd) < 0)
+    err_output ("fsync: %s: %s", data_store_dirname, strerror (errno));
+
+  /* ignore potential error, cleanup path */
+  close (fd);
+}
+
+/* Rewrite the store with the last record of each host.  Written to a
+ * temporary file and renamed, so a crash leaves either the old or new
+ * store.
+ */
+static int
+_data_store_compact (void)
+{
+  struct _data_store_compact_arg compact_arg;
+  char tmpfilename[MAXPATHLEN + 1];
+  uint8_t databuf[IPMISELD_DATA_STORE_RECORD_LENGTH (IPMISELD_DATA_STORE_HOSTNAME_MAX)];
+  unsigned int databuf_offset = 0;
+  int fd = -1;
+  int n;
+  int rv = -1;
+
+  if (strlen (data_store_filename) + strlen (".XXXXXX") > MAXPATHLEN)
+    {
+      err_output ("state store filename '%s' too long", data_store_filename);
+      goto cleanup;
+    }
+
+  memset (tmpfilename, '\0', MAXPATHLEN + 1);
+  strcpy (tmpfilename, data_store_filename);
+  strcat (tmpfilename, ".XXXXXX");
+
+  if ((fd = mkstemp (tmpfilename)) < 0)
+    {
+      err_output ("Error creating '%s': %s", tmpfilename, strerror (errno));
+      goto cleanup;
+    }
+
+  if (fchmod (fd, 0644) < 0)
+    {
+      err_output ("fchmod: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  databuf_offset += _marshall_uint32 (databuf + databuf_offset, IPMISELD_DATA_STORE_MAGIC);
+  databuf_offset += _marshall_uint32 (databuf + databuf_offset, IPMISELD_DATA_STORE_VERSION);
+
+  if ((n = fd_write_n (fd, databuf, databuf_offset)) < 0)
+    {
+      err_output ("fd_write_n: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (n != databuf_offset)
+    {
+      err_output ("incomplete write");
+      goto cleanup;
+    }
+
+  compact_arg.fd = fd;
+  compact_arg.databuf = databuf;
+  compact_arg.errnum = 0;
+
+  hash_for_each (data_store_hash, _data_store_compact_write, &compact_arg);
+
+  if (compact_arg.errnum)
+    {
+      err_output ("fd_write_n: %s", strerror (compact_arg.errnum));
+      goto cleanup;
+    }
+
+  if (fsync (fd) < 0)
+    {
+      err_output ("fsync: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (fcntl (fd, F_SETFL, O_APPEND) < 0)
+    {
+      err_output ("fcntl: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (rename (tmpfilename, data_store_filename) < 0)
+    {
+      err_output ("Error renaming '%s': %s", tmpfilename, strerror (errno));
+      goto cleanup;
+    }
+
+  /* The rename is not durable until the directory is synced.  The new
+   * store is in place either way, so only report an error.
+   */
+  _data_store_dir_sync ();
+
+  /* records buffered before the compaction are in it */
+  data_store_buflen = 0;
+  data_store_last_flush = time (NULL);
+  data_store_records = hash_count (data_store_hash);
+  data_store_dirty = 0;
+
+  if (data_store_fd >= 0)
+    {
+      /* ignore potential error, the store was replaced */
+      close (data_store_fd);
+    }
+  data_store_fd = fd;
+  fd = -1;
+  rv = 0;
+
+ cleanup:
+  if (fd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (fd);
+      unlink (tmpfilename);
+    }
+  return (rv);
+}
+
+static int
+_data_store_flush (void)
+{
+  off_t offset;
+  int n;
+
+  if (data_store_dirty)
+    {
+      if (_data_store_compact () < 0)
+        goto cleanup;
+      return (0);
+    }
+
+  if (!data_store_buflen)
+    return (0);
+
+  if ((offset = lseek (data_store_fd, 0, SEEK_END)) < 0)
+    {
+      err_output ("lseek: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  /* The buffer is dropped on error, the state is still in the hash
+   * and is rewritten on the next flush.
+   */
+  if ((n = fd_write_n (data_store_fd, data_store_buf, data_store_buflen)) < 0)
+    {
+      err_output ("fd_write_n: %s", strerror (errno));
+      goto truncate;
+    }
+
+  if (n != data_store_buflen)
+    {
+      err_output ("incomplete write");
+      goto truncate;
+    }
+
+  if (fsync (data_store_fd) < 0)
+    {
+      err_output ("fsync: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  data_store_buflen = 0;
+  data_store_last_flush = time (NULL);
+  return (0);
+
+ truncate:
+  /* a torn record would hide every record appended after it */
+  if (ftruncate (data_store_fd, offset) < 0)
+    err_output ("ftruncate: %s", strerror (errno));
+ cleanup:
+  data_store_dirty = 1;
+  data_store_buflen = 0;
+  data_store_last_flush = time (NULL);
+  return (-1);
+}
+
+/* Load what survives of the store, a bad header or record ends it
+ * without error.
+ */
+static int
+_data_store_read (int fd)
+{
+  uint8_t *databuf = NULL;
+  unsigned int databuflen;
+  unsigned int databuf_offset = 0;
+  uint32_t store_magic;
+  uint32_t store_version;
+  struct stat statbuf;
+  int n;
+  int rv = -1;
+
+  if (fstat (fd, &statbuf) < 0)
+    {
+      err_output ("fstat: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (statbuf.st_size < IPMISELD_DATA_STORE_HEADER_LENGTH)
+    {
+      rv = 0;
+      goto cleanup;
+    }
+
+  databuflen = statbuf.st_size;
+
+  if (!(databuf = (uint8_t *)malloc (databuflen)))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if ((n = fd_read_n (fd, databuf, databuflen)) < 0)
+    {
+      err_output ("fd_read_n: %s", strerror (errno));
+      goto cleanup;
+    }
+  databuflen = n;
+
+  if (databuflen < IPMISELD_DATA_STORE_HEADER_LENGTH)
+    {
+      rv = 0;
+      goto cleanup;
+    }
+
+  databuf_offset += _unmarshall_uint32 (databuf + databuf_offset, &store_magic);
+  databuf_offset += _unmarshall_uint32 (databuf + databuf_offset, &store_version);
+
+  if (store_magic != IPMISELD_DATA_STORE_MAGIC)
+    {
+      err_output ("state store '%s' corrupted", data_store_filename);
+      rv = 0;
+      goto cleanup;
+    }
+
+  if (store_version != IPMISELD_DATA_STORE_VERSION)
+    {
+      err_output ("state store '%s' out of date", data_store_filename);
+      rv = 0;
+      goto cleanup;
+    }
+
+  while (databuf_offset < databuflen)
+    {
+      char hostname[IPMISELD_DATA_STORE_HOSTNAME_MAX + 1];
+      ipmiseld_host_state_t state;
+      unsigned int len;
+
+      if (!(len = _data_store_record_unmarshall (databuf + databuf_offset,
+                                                 databuflen - databuf_offset,
+                                                 hostname,
+                                                 &state)))
+        {
+          err_output ("state store '%s' truncated or corrupted, later records ignored",
+                      data_store_filename);
+          break;
+        }
+
+      if (_data_store_update (hostname, &state) < 0)
+        goto cleanup;
+
+      databuf_offset += len;
+    }
+
+  rv = 0;
+ cleanup:
+  free (databuf);
+  return (rv);
+}
+
+int
+ipmiseld_data_cache_init (ipmiseld_prog_data_t *prog_data)
+{
+  char lockfilename[MAXPATHLEN + 1];
+  char *cache_dir;
+  int fd = -1;
+  int rv = -1;
+
+  assert (prog_data);
+  assert (!data_store_enabled);
+
+  if (prog_data->args->per_host_data_cache
+      || prog_data->args->test_run)
+    return (0);
+
+  if (prog_data->args->cache_directory)
+    cache_dir = prog_data->args->cache_directory;
+  else
+    cache_dir = IPMISELD_CACHE_DIRECTORY;
+
+  if (strlen (cache_dir) > MAXPATHLEN)
+    {
+      err_output ("cache directory '%s' too long", cache_dir);
+      goto cleanup;
+    }
+
+  memset (data_store_dirname, '\0', MAXPATHLEN + 1);
+  strcpy (data_store_dirname, cache_dir);
+
+  memset (lockfilename, '\0', MAXPATHLEN + 1);
+  snprintf (lockfilename,
+            MAXPATHLEN,
+            "%s/%s",
+            cache_dir,
+            IPMISELD_DATA_STORE_LOCK_FILENAME);
+
+  memset (data_store_filename, '\0', MAXPATHLEN + 1);
+  snprintf (data_store_filename,
+            MAXPATHLEN,
+            "%s/%s",
+            cache_dir,
+            IPMISELD_DATA_STORE_FILENAME);
+
+  /* The store is rewritten and renamed on compaction, so a separate
+   * file is locked.  Another daemon using the same cache directory
+   * keeps it, and this one uses per host files.
+   */
+  if ((data_store_lock_fd = open (lockfilename, O_CREAT | O_RDWR, 0644)) < 0)
+    {
+      err_output ("Error opening '%s': %s", lockfilename, strerror (errno));
+      goto cleanup;
+    }
+
+  if (fd_get_write_lock (data_store_lock_fd) < 0)
+    {
+      if (errno == EACCES || errno == EAGAIN)
+        {
+          err_output ("state store '%s' in use, using per host data cache files",
+                      data_store_filename);
+          /* ignore potential error, not using the store */
+          close (data_store_lock_fd);
+          data_store_lock_fd = -1;
+          rv = 0;
+          goto cleanup;
+        }
+
+      err_output ("fd_get_write_lock: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (!(data_store_hash = hash_create (IPMISELD_DATA_STORE_HASH_SIZE,
+                                       _data_store_hash_key,
+                                       _data_store_hash_cmp,
+                                       _data_store_entry_destroy)))
+    {
+      err_output ("hash_create: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if ((fd = open (data_store_filename, O_RDONLY)) < 0)
+    {
+      if (errno != ENOENT)
+        {
+          err_output ("Error opening '%s': %s", data_store_filename, strerror (errno));
+          goto cleanup;
+        }
+    }
+  else
+    {
+      if (_data_store_read (fd) < 0)
+        goto cleanup;
+    }
+
+  /* Drop superseded and corrupted records before appending, else a
+   * corrupted record would hide those appended after it.  The store
+   * is opened for appending by the compaction.
+   */
+  if (_data_store_compact () < 0)
+    goto cleanup;
+
+  data_store_enabled = 1;
+  rv = 0;
+
+ cleanup:
+  if (fd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (fd);
+    }
+  if (rv < 0)
+    ipmiseld_data_cache_fini ();
+  return (rv);
+}
+
+void
+ipmiseld_data_cache_flush (void)
+{
+  if (!data_store_enabled)
+    return;
+
+  pthread_mutex_lock (&data_store_lock);
+
+  if (data_store_buflen
+      && time (NULL) >= (data_store_last_flush + IPMISELD_DATA_CACHE_FLUSH_INTERVAL))
+    _data_store_flush ();
+
+  pthread_mutex_unlock (&data_store_lock);
+}
+
+void
+ipmiseld_data_cache_fini (void)
+{
+  pthread_mutex_lock (&data_store_lock);
+
+  if (data_store_enabled)
+    {
+      /* ignore potential error, nothing else can be done */
+      _data_store_flush ();
+      data_store_enabled = 0;
+    }
+
+  if (data_store_fd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (data_store_fd);
+      data_store_fd = -1;
+    }
+
+  if (data_store_lock_fd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (data_store_lock_fd);
+      data_store_lock_fd = -1;
+    }
+
+  if (data_store_hash)
+    {
+      hash_destroy (data_store_hash);
+      data_store_hash = NULL;
+    }
+
+  free (data_store_buf);
+  data_store_buf = NULL;
+  data_store_buflen = 0;
+  data_store_bufsize = 0;
+  data_store_records = 0;
+
+  pthread_mutex_unlock (&data_store_lock);
+}
+
+static int
+_data_store_load (ipmiseld_host_data_t *host_data)
+{
+  struct ipmiseld_data_store_entry *entry;
+  int rv = 0;
+
+  assert (host_data);
+
+  pthread_mutex_lock (&data_store_lock);
+
+  if ((entry = hash_find (data_store_hash, _data_store_hostname (host_data))))
+    {
+      memcpy (&host_data->last_host_state,
+              &entry->state,
+              sizeof (ipmiseld_host_state_t));
+      rv = 1;
+    }
+
+  pthread_mutex_unlock (&data_store_lock);
+
+  /* not in the store, maybe in a per host file from before the store */
+  if (!rv)
+    rv = _data_cache_file_load (host_data);
+
+  return (rv);
+}
+
+static int
+_data_store_store (ipmiseld_host_data_t *host_data)
+{
+  const char *hostname;
+  unsigned int record_len;
+  int rv = -1;
+
+  assert (host_data);
+
+  hostname = _data_store_hostname (host_data);
+
+  if (strlen (hostname) > IPMISELD_DATA_STORE_HOSTNAME_MAX)
+    {
+      ipmiseld_err_output (host_data, "hostname too long for state store");
+      return (-1);
+    }
+
+  record_len = IPMISELD_DATA_STORE_RECORD_LENGTH (strlen (hostname));
+
+  pthread_mutex_lock (&data_store_lock);
+
+  if (_data_store_update (hostname, &host_data->last_host_state) < 0)
+    goto cleanup;
+
+  if (data_store_buflen + record_len > data_store_bufsize)
+    {
+      unsigned int bufsize;
+      uint8_t *tmpbuf;
+
+      bufsize = data_store_buflen + record_len + IPMISELD_DATA_STORE_FLUSH_BUFLEN;
+
+      if (!(tmpbuf = (uint8_t *)realloc (data_store_buf, bufsize)))
+        {
+          ipmiseld_err_output (host_data, "realloc: %s", strerror (errno));
+          goto cleanup;
+        }
+      data_store_buf = tmpbuf;
+      data_store_bufsize = bufsize;
+    }
+
+  data_store_buflen += _data_store_record_marshall (data_store_buf + data_store_buflen,
+                                                    hostname,
+                                                    &host_data->last_host_state);
+  data_store_records++;
+
+  if (data_store_buflen >= IPMISELD_DATA_STORE_FLUSH_BUFLEN
+      || time (NULL) >= (data_store_last_flush + IPMISELD_DATA_CACHE_FLUSH_INTERVAL))
+    {
+      if (data_store_records > IPMISELD_DATA_STORE_COMPACT_MIN
+          && data_store_records > (hash_count (data_store_hash) * IPMISELD_DATA_STORE_COMPACT_RATIO))
+        {
+          if (_data_store_compact () < 0)
+            goto cleanup;
+        }
+      else
+        {
+          if (_data_store_flush () < 0)
+            goto cleanup;
+        }
+    }
+
+  rv = 0;
+ cleanup:
+  pthread_mutex_unlock (&data_store_lock);
+  return (rv);
+}
+
+int
+ipmiseld_data_cache_load (ipmiseld_host_data_t *host_data)
+{
+  assert (host_data);
+
+  if (data_store_enabled)
+    return (_data_store_load (host_data));
+
+  return (_data_cache_file_load (host_data));
+}
+
+int
+ipmiseld_data_cache_store (ipmiseld_host_data_t *host_data)
+{
+  assert (host_data);
+
+  if (data_store_enabled)
+    return (_data_store_store (host_data));
+
+  return (_data_cache_file_store (host_data));
+}
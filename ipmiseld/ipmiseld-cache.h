@@ -28,6 +28,9 @@
 
 #include "ipmiseld.h"
 
+/* seconds state store writes may be batched */
+#define IPMISELD_DATA_CACHE_FLUSH_INTERVAL 5
+
 int ipmiseld_sdr_cache_create_and_load (ipmiseld_host_data_t *host_data);
 
 /* returns 1 on data found/loaded, 0 if not found, -1 on error loading
@@ -37,4 +40,16 @@ int ipmiseld_data_cache_load (ipmiseld_host_data_t *host_data);
 
 int ipmiseld_data_cache_store (ipmiseld_host_data_t *host_data);
 
+/* Open the state store shared by all hosts, unless per host data
+ * cache files were requested or the store is in use.  Stores are
+ * batched, ipmiseld_data_cache_flush() writes them once the flush
+ * interval has passed and ipmiseld_data_cache_fini() writes any
+ * remaining.
+ */
+int ipmiseld_data_cache_init (ipmiseld_prog_data_t *prog_data);
+
+void ipmiseld_data_cache_flush (void);
+
+void ipmiseld_data_cache_fini (void);
+
 #endif /* IPMISELD_CACHE_H */
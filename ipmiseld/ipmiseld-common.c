@@ -41,6 +41,7 @@
 
 #include "ipmiseld.h"
 #include "ipmiseld-common.h"
+#include "ipmiseld-output.h"
 
 #include "freeipmi-portability.h"
 #include "error.h"
@@ -143,36 +144,30 @@ ipmiseld_log_priority_parse (const char *str)
 }
 
 
-static void
-_ipmiseld_syslog (ipmiseld_host_data_t *host_data,
-                  const char *message,
-                  va_list ap)
+int
+ipmiseld_output_sink_parse (const char *str)
 {
-  char buf[IPMISELD_ERR_BUFLEN + 1];
-
-  memset (buf, '\0', IPMISELD_ERR_BUFLEN + 1);
-  vsnprintf(buf, IPMISELD_ERR_BUFLEN, message, ap);
+  assert (str);
 
-  if (host_data->prog_data->args->test_run
-      || host_data->prog_data->args->foreground)
-    printf ("%s\n", buf);
-  else
-    syslog (host_data->prog_data->log_priority, "%s", buf);
+  if (!strcasecmp (str, "syslog"))
+    return (IPMISELD_OUTPUT_SINK_SYSLOG);
+  else if (!strcasecmp (str, "file"))
+    return (IPMISELD_OUTPUT_SINK_FILE);
+  else if (!strcasecmp (str, "socket"))
+    return (IPMISELD_OUTPUT_SINK_SOCKET);
+  return (-1);
 }
 
-void
-ipmiseld_syslog (ipmiseld_host_data_t *host_data,
-                 const char *message,
-                 ...)
+int
+ipmiseld_output_format_parse (const char *str)
 {
-  va_list ap;
-
-  assert (host_data);
-  assert (message);
+  assert (str);
 
-  va_start (ap, message);
-  _ipmiseld_syslog (host_data, message, ap);
-  va_end (ap);
+  if (!strcasecmp (str, "text"))
+    return (IPMISELD_OUTPUT_FORMAT_TEXT);
+  else if (!strcasecmp (str, "keyvalue"))
+    return (IPMISELD_OUTPUT_FORMAT_KEYVALUE);
+  return (-1);
 }
 
 void
@@ -180,30 +175,18 @@ ipmiseld_syslog_host (ipmiseld_host_data_t *host_data,
                       const char *message,
                       ...)
 {
+  char buf[IPMISELD_ERR_BUFLEN + 1];
   va_list ap;
 
   assert (host_data);
   assert (message);
 
   va_start (ap, message);
-  if (!host_data->hostname)
-    _ipmiseld_syslog (host_data, message, ap);
-  else
-    {
-      char buf[IPMISELD_ERR_BUFLEN + 1];
-      memset (buf, '\0', IPMISELD_ERR_BUFLEN + 1);
-      vsnprintf(buf, IPMISELD_ERR_BUFLEN, message, ap);
-
-      if (host_data->prog_data->args->test_run
-          || host_data->prog_data->args->foreground)
-        printf ("%s: %s\n", host_data->hostname, buf);
-      else
-        syslog (host_data->prog_data->log_priority,
-                "%s: %s",
-                host_data->hostname,
-                buf);
-    }
+  memset (buf, '\0', IPMISELD_ERR_BUFLEN + 1);
+  vsnprintf(buf, IPMISELD_ERR_BUFLEN, message, ap);
   va_end (ap);
+
+  ipmiseld_output (host_data, IPMISELD_OUTPUT_TYPE_STATUS, 0, buf);
 }
 
 void
@@ -39,9 +39,9 @@ int ipmiseld_log_facility_parse (const char *str);
 
 int ipmiseld_log_priority_parse (const char *str);
 
-void ipmiseld_syslog (ipmiseld_host_data_t *host_data,
-                      const char *message,
-                      ...);
+int ipmiseld_output_sink_parse (const char *str);
+
+int ipmiseld_output_format_parse (const char *str);
 
 void ipmiseld_syslog_host (ipmiseld_host_data_t *host_data,
                            const char *message,
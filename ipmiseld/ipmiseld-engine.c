@@ -0,0 +1,2316 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#if TIME_WITH_SYS_TIME
+#include <sys/time.h>
+#include <time.h>
+#else /* !TIME_WITH_SYS_TIME */
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else /* !HAVE_SYS_TIME_H */
+#include <time.h>
+#endif /* !HAVE_SYS_TIME_H */
+#endif /* !TIME_WITH_SYS_TIME */
+#include <sys/types.h>
+#include <sys/socket.h>
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+#include <netinet/in.h>
+#include <netdb.h>
+#include <sys/poll.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <freeipmi/freeipmi.h>
+
+#include "ipmiseld.h"
+#include "ipmiseld-common.h"
+#include "ipmiseld-debug.h"
+#include "ipmiseld-engine.h"
+
+#include "freeipmi-portability.h"
+#include "error.h"
+#include "hash.h"
+#include "network.h"
+#include "rtt.h"
+#include "timeval.h"
+
+#define IPMISELD_ENGINE_PACKET_BUFLEN                       1024
+
+#define IPMISELD_ENGINE_PORT_BUFLEN                         16
+
+/* max packets read from a socket per ipmiseld_engine_process() call,
+ * so timeouts are still handled under a flood of responses
+ */
+#define IPMISELD_ENGINE_RECV_MAX                            1024
+
+/* large receive buffer, many BMCs may respond at the same time */
+#define IPMISELD_ENGINE_SOCKET_RCVBUF                       (1024 * 1024)
+
+#define IPMISELD_ENGINE_RETRANSMISSION_BACKOFF_COUNT        2
+
+#define IPMISELD_ENGINE_LAN_INITIAL_OUTBOUND_SEQUENCE_NUMBER 1
+
+#define IPMISELD_ENGINE_MAX_SIK_KEY_LENGTH                  64
+#define IPMISELD_ENGINE_MAX_INTEGRITY_KEY_LENGTH            64
+#define IPMISELD_ENGINE_MAX_CONFIDENTIALITY_KEY_LENGTH      64
+#define IPMISELD_ENGINE_MAX_KEY_EXCHANGE_AUTHENTICATION_CODE_LENGTH 64
+
+/* The state is the request outstanding */
+typedef enum
+  {
+    IPMISELD_ENGINE_STATE_AUTHENTICATION_CAPABILITIES = 0,
+    IPMISELD_ENGINE_STATE_GET_SESSION_CHALLENGE = 1,
+    IPMISELD_ENGINE_STATE_ACTIVATE_SESSION = 2,
+    IPMISELD_ENGINE_STATE_OPEN_SESSION = 3,
+    IPMISELD_ENGINE_STATE_RAKP_MESSAGE_1 = 4,
+    IPMISELD_ENGINE_STATE_RAKP_MESSAGE_3 = 5,
+    IPMISELD_ENGINE_STATE_SET_SESSION_PRIVILEGE_LEVEL = 6,
+    IPMISELD_ENGINE_STATE_GET_SEL_INFO = 7,
+    IPMISELD_ENGINE_STATE_CLOSE_SESSION = 8,
+  } ipmiseld_engine_state_t;
+
+#define IPMISELD_ENGINE_STATE_IPMI_1_5_SETUP(__s)                \
+  ((__s) == IPMISELD_ENGINE_STATE_AUTHENTICATION_CAPABILITIES    \
+   || (__s) == IPMISELD_ENGINE_STATE_GET_SESSION_CHALLENGE       \
+   || (__s) == IPMISELD_ENGINE_STATE_ACTIVATE_SESSION)
+
+#define IPMISELD_ENGINE_STATE_IPMI_2_0_SETUP(__s)                \
+  ((__s) == IPMISELD_ENGINE_STATE_OPEN_SESSION                   \
+   || (__s) == IPMISELD_ENGINE_STATE_RAKP_MESSAGE_1              \
+   || (__s) == IPMISELD_ENGINE_STATE_RAKP_MESSAGE_3)
+
+/* Kept across polls, so a host is resolved once and the
+ * retransmission timeout learned from earlier polls is reused.
+ */
+struct ipmiseld_engine_host
+{
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+  int resolved;
+  struct rtt rtt;
+};
+
+/* Only the values needed from one packet exchange to the next are
+ * kept per session.  Packets are built and parsed in fiid objects
+ * shared by all sessions.
+ */
+struct ipmiseld_engine_session
+{
+  ipmiseld_host_data_t *host_data;
+  struct ipmiseld_engine_host *engine_host;
+  struct ipmiseld_engine_session *next_free;
+  ipmiseld_engine_state_t state;
+  int errnum;
+  uint8_t rq_seq;
+  int session_active;
+  uint32_t highest_received_sequence_number;
+  uint32_t previously_received_list;
+  /* IPMI 1.5 */
+  uint32_t temp_session_id;
+  uint8_t challenge_string[IPMI_CHALLENGE_STRING_LENGTH];
+  unsigned int challenge_string_len;
+  uint32_t session_id;
+  uint32_t initial_inbound_sequence_number;
+  uint32_t session_inbound_count;
+  int permsgauth_enabled;
+  /* IPMI 2.0 */
+  uint8_t authentication_algorithm;
+  uint8_t integrity_algorithm;
+  uint8_t confidentiality_algorithm;
+  uint8_t message_tag;
+  uint32_t remote_console_session_id;
+  uint32_t managed_system_session_id;
+  uint32_t session_sequence_number;
+  uint8_t remote_console_random_number[IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH];
+  uint8_t managed_system_random_number[IPMI_MANAGED_SYSTEM_RANDOM_NUMBER_LENGTH];
+  unsigned int managed_system_random_number_len;
+  uint8_t managed_system_guid[IPMI_MANAGED_SYSTEM_GUID_LENGTH];
+  unsigned int managed_system_guid_len;
+  uint8_t sik_key[IPMISELD_ENGINE_MAX_SIK_KEY_LENGTH];
+  void *sik_key_ptr;
+  unsigned int sik_key_len;
+  uint8_t integrity_key[IPMISELD_ENGINE_MAX_INTEGRITY_KEY_LENGTH];
+  void *integrity_key_ptr;
+  unsigned int integrity_key_len;
+  uint8_t confidentiality_key[IPMISELD_ENGINE_MAX_CONFIDENTIALITY_KEY_LENGTH];
+  void *confidentiality_key_ptr;
+  unsigned int confidentiality_key_len;
+  /* timeouts */
+  unsigned int retransmission_count;
+  struct timeval last_send;
+  struct timeval retransmission_deadline;
+  struct timeval session_deadline;
+};
+
+struct ipmiseld_engine_objs
+{
+  fiid_obj_t obj_rmcp_hdr_rq;
+  fiid_obj_t obj_rmcp_hdr_rs;
+  fiid_obj_t obj_lan_session_hdr_rq;
+  fiid_obj_t obj_lan_session_hdr_rs;
+  fiid_obj_t obj_lan_msg_hdr_rq;
+  fiid_obj_t obj_lan_msg_hdr_rs;
+  fiid_obj_t obj_lan_msg_trlr_rs;
+  fiid_obj_t obj_rmcpplus_session_hdr_rq;
+  fiid_obj_t obj_rmcpplus_session_hdr_rs;
+  fiid_obj_t obj_rmcpplus_payload_rs;
+  fiid_obj_t obj_rmcpplus_session_trlr_rq;
+  fiid_obj_t obj_rmcpplus_session_trlr_rs;
+  fiid_obj_t obj_authentication_capabilities_rq;
+  fiid_obj_t obj_authentication_capabilities_rs;
+  fiid_obj_t obj_get_session_challenge_rq;
+  fiid_obj_t obj_get_session_challenge_rs;
+  fiid_obj_t obj_activate_session_rq;
+  fiid_obj_t obj_activate_session_rs;
+  fiid_obj_t obj_open_session_rq;
+  fiid_obj_t obj_open_session_rs;
+  fiid_obj_t obj_rakp_message_1_rq;
+  fiid_obj_t obj_rakp_message_2_rs;
+  fiid_obj_t obj_rakp_message_3_rq;
+  fiid_obj_t obj_rakp_message_4_rs;
+  fiid_obj_t obj_set_session_privilege_level_rq;
+  fiid_obj_t obj_set_session_privilege_level_rs;
+  fiid_obj_t obj_get_sel_info_rq;
+  fiid_obj_t obj_get_sel_info_rs;
+  fiid_obj_t obj_close_session_rq;
+};
+
+static struct ipmiseld_prog_data *engine_prog_data = NULL;
+static IpmiSeldEngineCallback engine_callback = NULL;
+
+static struct ipmiseld_engine_session *engine_sessions = NULL;
+static unsigned int engine_sessions_len = 0;
+static struct ipmiseld_engine_session *engine_sessions_free = NULL;
+static unsigned int engine_sessions_active = 0;
+
+/* in flight sessions by BMC address */
+static hash_t engine_hash = NULL;
+
+static int engine_fd4 = -1;
+static int engine_fd6 = -1;
+
+static struct ipmiseld_engine_objs engine_objs;
+
+static unsigned int engine_session_timeout = 0;
+static unsigned int engine_retransmission_timeout = 0;
+
+/*
+ * _engine_addr
+ * - Get address and port from AF_INET or AF_INET6 sockaddr
+ */
+static void
+_engine_addr (const struct sockaddr *sa,
+              const uint8_t **addr,
+              unsigned int *addrlen,
+              uint16_t *port)
+{
+  assert (sa);
+  assert (addr);
+  assert (addrlen);
+  assert (port);
+
+  if (sa->sa_family == AF_INET6)
+    {
+      const struct sockaddr_in6 *sa6 = (const struct sockaddr_in6 *)sa;
+
+      *addr = (const uint8_t *)&(sa6->sin6_addr);
+      *addrlen = sizeof (sa6->sin6_addr);
+      *port = sa6->sin6_port;
+    }
+  else
+    {
+      const struct sockaddr_in *sa4 = (const struct sockaddr_in *)sa;
+
+      *addr = (const uint8_t *)&(sa4->sin_addr);
+      *addrlen = sizeof (sa4->sin_addr);
+      *port = sa4->sin_port;
+    }
+}
+
+static unsigned int
+_engine_hash_key (const void *key)
+{
+  const uint8_t *addr;
+  unsigned int addrlen;
+  uint16_t port;
+  unsigned int rv;
+  unsigned int i;
+
+  assert (key);
+
+  _engine_addr ((const struct sockaddr *)key, &addr, &addrlen, &port);
+
+  rv = port;
+  for (i = 0; i < addrlen; i++)
+    rv = (rv * 31) + addr[i];
+
+  return (rv);
+}
+
+static int
+_engine_hash_cmp (const void *key1, const void *key2)
+{
+  const struct sockaddr *sa1 = (const struct sockaddr *)key1;
+  const struct sockaddr *sa2 = (const struct sockaddr *)key2;
+  const uint8_t *addr1, *addr2;
+  unsigned int addrlen1, addrlen2;
+  uint16_t port1, port2;
+
+  assert (key1);
+  assert (key2);
+
+  if (sa1->sa_family != sa2->sa_family)
+    return (1);
+
+  _engine_addr (sa1, &addr1, &addrlen1, &port1);
+  _engine_addr (sa2, &addr2, &addrlen2, &port2);
+
+  if (port1 != port2)
+    return (1);
+
+  return (memcmp (addr1, addr2, addrlen1));
+}
+
+static int
+_engine_objs_create (void)
+{
+  struct {
+    fiid_obj_t *obj;
+    fiid_field_t *tmpl;
+  } objs[] =
+      {
+        { &engine_objs.obj_rmcp_hdr_rq, tmpl_rmcp_hdr },
+        { &engine_objs.obj_rmcp_hdr_rs, tmpl_rmcp_hdr },
+        { &engine_objs.obj_lan_session_hdr_rq, tmpl_lan_session_hdr },
+        { &engine_objs.obj_lan_session_hdr_rs, tmpl_lan_session_hdr },
+        { &engine_objs.obj_lan_msg_hdr_rq, tmpl_lan_msg_hdr_rq },
+        { &engine_objs.obj_lan_msg_hdr_rs, tmpl_lan_msg_hdr_rs },
+        { &engine_objs.obj_lan_msg_trlr_rs, tmpl_lan_msg_trlr },
+        { &engine_objs.obj_rmcpplus_session_hdr_rq, tmpl_rmcpplus_session_hdr },
+        { &engine_objs.obj_rmcpplus_session_hdr_rs, tmpl_rmcpplus_session_hdr },
+        { &engine_objs.obj_rmcpplus_payload_rs, tmpl_rmcpplus_payload },
+        { &engine_objs.obj_rmcpplus_session_trlr_rq, tmpl_rmcpplus_session_trlr },
+        { &engine_objs.obj_rmcpplus_session_trlr_rs, tmpl_rmcpplus_session_trlr },
+        { &engine_objs.obj_authentication_capabilities_rq, tmpl_cmd_get_channel_authentication_capabilities_rq },
+        { &engine_objs.obj_authentication_capabilities_rs, tmpl_cmd_get_channel_authentication_capabilities_rs },
+        { &engine_objs.obj_get_session_challenge_rq, tmpl_cmd_get_session_challenge_rq },
+        { &engine_objs.obj_get_session_challenge_rs, tmpl_cmd_get_session_challenge_rs },
+        { &engine_objs.obj_activate_session_rq, tmpl_cmd_activate_session_rq },
+        { &engine_objs.obj_activate_session_rs, tmpl_cmd_activate_session_rs },
+        { &engine_objs.obj_open_session_rq, tmpl_rmcpplus_open_session_request },
+        { &engine_objs.obj_open_session_rs, tmpl_rmcpplus_open_session_response },
+        { &engine_objs.obj_rakp_message_1_rq, tmpl_rmcpplus_rakp_message_1 },
+        { &engine_objs.obj_rakp_message_2_rs, tmpl_rmcpplus_rakp_message_2 },
+        { &engine_objs.obj_rakp_message_3_rq, tmpl_rmcpplus_rakp_message_3 },
+        { &engine_objs.obj_rakp_message_4_rs, tmpl_rmcpplus_rakp_message_4 },
+        { &engine_objs.obj_set_session_privilege_level_rq, tmpl_cmd_set_session_privilege_level_rq },
+        { &engine_objs.obj_set_session_privilege_level_rs, tmpl_cmd_set_session_privilege_level_rs },
+        { &engine_objs.obj_get_sel_info_rq, tmpl_cmd_get_sel_info_rq },
+        { &engine_objs.obj_get_sel_info_rs, tmpl_cmd_get_sel_info_rs },
+        { &engine_objs.obj_close_session_rq, tmpl_cmd_close_session_rq },
+      };
+  unsigned int i;
+
+  for (i = 0; i < sizeof (objs) / sizeof (objs[0]); i++)
+    {
+      if (!(*(objs[i].obj) = fiid_obj_create (objs[i].tmpl)))
+        {
+          err_output ("fiid_obj_create: %s", strerror (errno));
+          return (-1);
+        }
+    }
+
+  return (0);
+}
+
+static void
+_engine_objs_destroy (void)
+{
+  fiid_obj_destroy (engine_objs.obj_rmcp_hdr_rq);
+  fiid_obj_destroy (engine_objs.obj_rmcp_hdr_rs);
+  fiid_obj_destroy (engine_objs.obj_lan_session_hdr_rq);
+  fiid_obj_destroy (engine_objs.obj_lan_session_hdr_rs);
+  fiid_obj_destroy (engine_objs.obj_lan_msg_hdr_rq);
+  fiid_obj_destroy (engine_objs.obj_lan_msg_hdr_rs);
+  fiid_obj_destroy (engine_objs.obj_lan_msg_trlr_rs);
+  fiid_obj_destroy (engine_objs.obj_rmcpplus_session_hdr_rq);
+  fiid_obj_destroy (engine_objs.obj_rmcpplus_session_hdr_rs);
+  fiid_obj_destroy (engine_objs.obj_rmcpplus_payload_rs);
+  fiid_obj_destroy (engine_objs.obj_rmcpplus_session_trlr_rq);
+  fiid_obj_destroy (engine_objs.obj_rmcpplus_session_trlr_rs);
+  fiid_obj_destroy (engine_objs.obj_authentication_capabilities_rq);
+  fiid_obj_destroy (engine_objs.obj_authentication_capabilities_rs);
+  fiid_obj_destroy (engine_objs.obj_get_session_challenge_rq);
+  fiid_obj_destroy (engine_objs.obj_get_session_challenge_rs);
+  fiid_obj_destroy (engine_objs.obj_activate_session_rq);
+  fiid_obj_destroy (engine_objs.obj_activate_session_rs);
+  fiid_obj_destroy (engine_objs.obj_open_session_rq);
+  fiid_obj_destroy (engine_objs.obj_open_session_rs);
+  fiid_obj_destroy (engine_objs.obj_rakp_message_1_rq);
+  fiid_obj_destroy (engine_objs.obj_rakp_message_2_rs);
+  fiid_obj_destroy (engine_objs.obj_rakp_message_3_rq);
+  fiid_obj_destroy (engine_objs.obj_rakp_message_4_rs);
+  fiid_obj_destroy (engine_objs.obj_set_session_privilege_level_rq);
+  fiid_obj_destroy (engine_objs.obj_set_session_privilege_level_rs);
+  fiid_obj_destroy (engine_objs.obj_get_sel_info_rq);
+  fiid_obj_destroy (engine_objs.obj_get_sel_info_rs);
+  fiid_obj_destroy (engine_objs.obj_close_session_rq);
+  memset (&engine_objs, '\0', sizeof (struct ipmiseld_engine_objs));
+}
+
+int
+ipmiseld_engine_init (struct ipmiseld_prog_data *prog_data,
+                      IpmiSeldEngineCallback callback)
+{
+  unsigned int i;
+
+  assert (prog_data);
+  assert (prog_data->args->async_session_count);
+  assert (callback);
+  assert (!engine_sessions);
+
+  engine_prog_data = prog_data;
+  engine_callback = callback;
+
+  if (prog_data->args->common_args.session_timeout)
+    engine_session_timeout = prog_data->args->common_args.session_timeout;
+  else
+    engine_session_timeout = IPMI_SESSION_TIMEOUT_DEFAULT;
+
+  if (prog_data->args->common_args.retransmission_timeout)
+    engine_retransmission_timeout = prog_data->args->common_args.retransmission_timeout;
+  else
+    engine_retransmission_timeout = IPMI_RETRANSMISSION_TIMEOUT_DEFAULT;
+
+  if (!(engine_sessions = (struct ipmiseld_engine_session *)calloc (prog_data->args->async_session_count,
+                                                                    sizeof (struct ipmiseld_engine_session))))
+    {
+      err_output ("calloc: %s", strerror (errno));
+      goto cleanup;
+    }
+  engine_sessions_len = prog_data->args->async_session_count;
+
+  for (i = 0; i < engine_sessions_len; i++)
+    {
+      engine_sessions[i].next_free = engine_sessions_free;
+      engine_sessions_free = &engine_sessions[i];
+    }
+  engine_sessions_active = 0;
+
+  if (!(engine_hash = hash_create (engine_sessions_len,
+                                   _engine_hash_key,
+                                   _engine_hash_cmp,
+                                   NULL)))
+    {
+      err_output ("hash_create: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (_engine_objs_create () < 0)
+    goto cleanup;
+
+  return (0);
+
+ cleanup:
+  ipmiseld_engine_destroy ();
+  return (-1);
+}
+
+void
+ipmiseld_engine_destroy (void)
+{
+  /* sessions in flight are abandoned, they time out on the BMC */
+  free (engine_sessions);
+  engine_sessions = NULL;
+  engine_sessions_len = 0;
+  engine_sessions_free = NULL;
+  engine_sessions_active = 0;
+
+  if (engine_hash)
+    {
+      hash_destroy (engine_hash);
+      engine_hash = NULL;
+    }
+
+  if (engine_fd4 >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (engine_fd4);
+      engine_fd4 = -1;
+    }
+
+  if (engine_fd6 >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (engine_fd6);
+      engine_fd6 = -1;
+    }
+
+  _engine_objs_destroy ();
+}
+
+void
+ipmiseld_engine_host_destroy (struct ipmiseld_engine_host *engine_host)
+{
+  free (engine_host);
+}
+
+static int
+_engine_fd (int family)
+{
+  int *fdptr;
+  int rcvbuf = IPMISELD_ENGINE_SOCKET_RCVBUF;
+  int flags;
+  int fd;
+
+  assert (family == AF_INET || family == AF_INET6);
+
+  fdptr = (family == AF_INET6) ? &engine_fd6 : &engine_fd4;
+
+  if (*fdptr >= 0)
+    return (*fdptr);
+
+  if ((fd = socket (family, SOCK_DGRAM, 0)) < 0)
+    {
+      err_output ("socket: %s", strerror (errno));
+      return (-1);
+    }
+
+  if ((flags = fcntl (fd, F_GETFL, 0)) < 0
+      || fcntl (fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+      err_output ("fcntl: %s", strerror (errno));
+      /* ignore potential error, error path */
+      close (fd);
+      return (-1);
+    }
+
+  /* ignore potential error, the default may be good enough */
+  setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof (rcvbuf));
+
+  *fdptr = fd;
+  return (fd);
+}
+
+/* Returns 1 if resolved, 0 if not, -1 on error */
+static int
+_engine_host_resolve (ipmiseld_host_data_t *host_data,
+                      struct ipmiseld_engine_host *engine_host)
+{
+  char *hostname_copy = NULL;
+  char *port_copy = NULL;
+  const char *hostname_ptr = NULL;
+  const char *port_ptr = NULL;
+  uint16_t port = RMCP_AUX_BUS_SHUNT;
+  struct addrinfo ai_hints, *ai_res = NULL, *ai = NULL;
+  char port_str[IPMISELD_ENGINE_PORT_BUFLEN + 1];
+  int rv = -1;
+  int ret;
+
+  assert (host_data);
+  assert (host_data->hostname);
+  assert (engine_host);
+
+  if ((ret = host_is_host_with_port (host_data->hostname, &hostname_copy, &port_copy)) < 0)
+    {
+      ipmiseld_err_output (host_data, "host_is_host_with_port: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (ret)
+    {
+      hostname_ptr = hostname_copy;
+      port_ptr = port_copy;
+    }
+  else
+    hostname_ptr = host_data->hostname;
+
+  if ((ret = host_is_valid (hostname_ptr,
+                            port_ptr,
+                            &port)) < 0)
+    {
+      ipmiseld_err_output (host_data, "host_is_valid: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (!ret)
+    {
+      rv = 0;
+      goto cleanup;
+    }
+
+  memset (port_str, '\0', IPMISELD_ENGINE_PORT_BUFLEN + 1);
+  snprintf (port_str, IPMISELD_ENGINE_PORT_BUFLEN, "%d", port);
+
+  memset (&ai_hints, 0, sizeof (struct addrinfo));
+  ai_hints.ai_family = AF_UNSPEC;
+  ai_hints.ai_socktype = SOCK_DGRAM;
+  ai_hints.ai_flags = (AI_V4MAPPED | AI_ADDRCONFIG);
+
+  if (getaddrinfo (hostname_ptr, port_str, &ai_hints, &ai_res))
+    {
+      rv = 0;
+      goto cleanup;
+    }
+
+  for (ai = ai_res; ai != NULL; ai = ai->ai_next)
+    {
+      if ((ai->ai_family == AF_INET || ai->ai_family == AF_INET6)
+          && ai->ai_addrlen <= sizeof (struct sockaddr_storage))
+        break;
+    }
+
+  if (!ai)
+    {
+      rv = 0;
+      goto cleanup;
+    }
+
+  memset (&engine_host->addr, '\0', sizeof (struct sockaddr_storage));
+  memcpy (&engine_host->addr, ai->ai_addr, ai->ai_addrlen);
+  engine_host->addrlen = ai->ai_addrlen;
+  engine_host->resolved = 1;
+  rv = 1;
+ cleanup:
+  free (hostname_copy);
+  free (port_copy);
+  if (ai_res)
+    freeaddrinfo (ai_res);
+  return (rv);
+}
+
+static int
+_ipmi_2_0 (void)
+{
+  return (engine_prog_data->args->common_args.driver_type == IPMI_DEVICE_LAN_2_0);
+}
+
+static int
+_packet_create (struct ipmiseld_engine_session *s,
+                void *buf,
+                unsigned int buflen)
+{
+  ipmiseld_host_data_t *host_data;
+  struct common_cmd_args *common_args;
+  fiid_obj_t obj_cmd_rq = NULL;
+  uint8_t net_fn = IPMI_NET_FN_APP_RQ;
+  char *username;
+  unsigned int username_len;
+  char *password;
+  unsigned int password_len;
+  int len;
+
+  assert (s);
+  assert (s->host_data);
+  assert (buf);
+  assert (buflen);
+
+  host_data = s->host_data;
+  common_args = &(engine_prog_data->args->common_args);
+
+  username = common_args->username;
+  username_len = (username) ? strlen (username) : 0;
+  password = common_args->password;
+  password_len = (password) ? strlen (password) : 0;
+
+  s->rq_seq = (s->rq_seq + 1) % (IPMI_LAN_REQUESTER_SEQUENCE_NUMBER_MAX + 1);
+
+  if (s->state == IPMISELD_ENGINE_STATE_AUTHENTICATION_CAPABILITIES)
+    {
+      if (fill_cmd_get_channel_authentication_capabilities (IPMI_CHANNEL_NUMBER_CURRENT_CHANNEL,
+                                                            common_args->privilege_level,
+                                                            _ipmi_2_0 () ? IPMI_GET_IPMI_V20_EXTENDED_DATA : IPMI_GET_IPMI_V15_DATA,
+                                                            engine_objs.obj_authentication_capabilities_rq) < 0)
+        {
+          ipmiseld_err_output (host_data,
+                               "fill_cmd_get_channel_authentication_capabilities: %s",
+                               strerror (errno));
+          return (-1);
+        }
+      obj_cmd_rq = engine_objs.obj_authentication_capabilities_rq;
+    }
+  else if (s->state == IPMISELD_ENGINE_STATE_GET_SESSION_CHALLENGE)
+    {
+      if (fill_cmd_get_session_challenge (common_args->authentication_type,
+                                          username,
+                                          username_len,
+                                          engine_objs.obj_get_session_challenge_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_cmd_get_session_challenge: %s", strerror (errno));
+          return (-1);
+        }
+      obj_cmd_rq = engine_objs.obj_get_session_challenge_rq;
+    }
+  else if (s->state == IPMISELD_ENGINE_STATE_ACTIVATE_SESSION)
+    {
+      if (fill_cmd_activate_session (common_args->authentication_type,
+                                     common_args->privilege_level,
+                                     s->challenge_string,
+                                     s->challenge_string_len,
+                                     IPMISELD_ENGINE_LAN_INITIAL_OUTBOUND_SEQUENCE_NUMBER,
+                                     engine_objs.obj_activate_session_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_cmd_activate_session: %s", strerror (errno));
+          return (-1);
+        }
+      obj_cmd_rq = engine_objs.obj_activate_session_rq;
+    }
+  else if (s->state == IPMISELD_ENGINE_STATE_OPEN_SESSION)
+    {
+      s->message_tag++;
+      if (fill_rmcpplus_open_session (s->message_tag,
+                                      IPMI_PRIVILEGE_LEVEL_HIGHEST_LEVEL,
+                                      s->remote_console_session_id,
+                                      s->authentication_algorithm,
+                                      s->integrity_algorithm,
+                                      s->confidentiality_algorithm,
+                                      engine_objs.obj_open_session_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_rmcpplus_open_session: %s", strerror (errno));
+          return (-1);
+        }
+      obj_cmd_rq = engine_objs.obj_open_session_rq;
+    }
+  else if (s->state == IPMISELD_ENGINE_STATE_RAKP_MESSAGE_1)
+    {
+      s->message_tag++;
+      if (fill_rmcpplus_rakp_message_1 (s->message_tag,
+                                        s->managed_system_session_id,
+                                        s->remote_console_random_number,
+                                        IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH,
+                                        common_args->privilege_level,
+                                        IPMI_NAME_ONLY_LOOKUP,
+                                        username,
+                                        username_len,
+                                        engine_objs.obj_rakp_message_1_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_rmcpplus_rakp_message_1: %s", strerror (errno));
+          return (-1);
+        }
+      obj_cmd_rq = engine_objs.obj_rakp_message_1_rq;
+    }
+  else if (s->state == IPMISELD_ENGINE_STATE_RAKP_MESSAGE_3)
+    {
+      uint8_t key_exchange_authentication_code[IPMISELD_ENGINE_MAX_KEY_EXCHANGE_AUTHENTICATION_CODE_LENGTH];
+      int key_exchange_authentication_code_len;
+
+      if ((key_exchange_authentication_code_len = ipmi_calculate_rakp_3_key_exchange_authentication_code (s->authentication_algorithm,
+                                                                                                          password,
+                                                                                                          password_len,
+                                                                                                          s->managed_system_random_number,
+                                                                                                          s->managed_system_random_number_len,
+                                                                                                          s->remote_console_session_id,
+                                                                                                          IPMI_NAME_ONLY_LOOKUP,
+                                                                                                          common_args->privilege_level,
+                                                                                                          username,
+                                                                                                          username_len,
+                                                                                                          key_exchange_authentication_code,
+                                                                                                          IPMISELD_ENGINE_MAX_KEY_EXCHANGE_AUTHENTICATION_CODE_LENGTH)) < 0)
+        {
+          ipmiseld_err_output (host_data,
+                               "ipmi_calculate_rakp_3_key_exchange_authentication_code: %s",
+                               strerror (errno));
+          return (-1);
+        }
+
+      s->message_tag++;
+      if (fill_rmcpplus_rakp_message_3 (s->message_tag,
+                                        RMCPPLUS_STATUS_NO_ERRORS,
+                                        s->managed_system_session_id,
+                                        key_exchange_authentication_code,
+                                        key_exchange_authentication_code_len,
+                                        engine_objs.obj_rakp_message_3_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_rmcpplus_rakp_message_3: %s", strerror (errno));
+          return (-1);
+        }
+      obj_cmd_rq = engine_objs.obj_rakp_message_3_rq;
+    }
+  else if (s->state == IPMISELD_ENGINE_STATE_SET_SESSION_PRIVILEGE_LEVEL)
+    {
+      if (fill_cmd_set_session_privilege_level (common_args->privilege_level,
+                                                engine_objs.obj_set_session_privilege_level_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_cmd_set_session_privilege_level: %s", strerror (errno));
+          return (-1);
+        }
+      obj_cmd_rq = engine_objs.obj_set_session_privilege_level_rq;
+    }
+  else if (s->state == IPMISELD_ENGINE_STATE_GET_SEL_INFO)
+    {
+      if (fill_cmd_get_sel_info (engine_objs.obj_get_sel_info_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_cmd_get_sel_info: %s", strerror (errno));
+          return (-1);
+        }
+      obj_cmd_rq = engine_objs.obj_get_sel_info_rq;
+      net_fn = IPMI_NET_FN_STORAGE_RQ;
+    }
+  else /* s->state == IPMISELD_ENGINE_STATE_CLOSE_SESSION */
+    {
+      if (fill_cmd_close_session (_ipmi_2_0 () ? s->managed_system_session_id : s->session_id,
+                                  NULL,
+                                  engine_objs.obj_close_session_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_cmd_close_session: %s", strerror (errno));
+          return (-1);
+        }
+      obj_cmd_rq = engine_objs.obj_close_session_rq;
+    }
+
+  if (fill_rmcp_hdr_ipmi (engine_objs.obj_rmcp_hdr_rq) < 0)
+    {
+      ipmiseld_err_output (host_data, "fill_rmcp_hdr_ipmi: %s", strerror (errno));
+      return (-1);
+    }
+
+  if (fill_lan_msg_hdr (IPMI_SLAVE_ADDRESS_BMC,
+                        net_fn,
+                        IPMI_BMC_IPMB_LUN_BMC,
+                        s->rq_seq,
+                        engine_objs.obj_lan_msg_hdr_rq) < 0)
+    {
+      ipmiseld_err_output (host_data, "fill_lan_msg_hdr: %s", strerror (errno));
+      return (-1);
+    }
+
+  if (IPMISELD_ENGINE_STATE_IPMI_1_5_SETUP (s->state) || !_ipmi_2_0 ())
+    {
+      uint8_t authentication_type;
+      uint32_t session_sequence_number;
+      uint32_t session_id;
+
+      if (s->state == IPMISELD_ENGINE_STATE_AUTHENTICATION_CAPABILITIES
+          || s->state == IPMISELD_ENGINE_STATE_GET_SESSION_CHALLENGE)
+        {
+          authentication_type = IPMI_AUTHENTICATION_TYPE_NONE;
+          session_sequence_number = 0;
+          session_id = 0;
+        }
+      else if (s->state == IPMISELD_ENGINE_STATE_ACTIVATE_SESSION)
+        {
+          authentication_type = common_args->authentication_type;
+          session_sequence_number = 0;
+          session_id = s->temp_session_id;
+        }
+      else
+        {
+          if (s->permsgauth_enabled)
+            authentication_type = common_args->authentication_type;
+          else
+            authentication_type = IPMI_AUTHENTICATION_TYPE_NONE;
+          session_sequence_number = s->initial_inbound_sequence_number + s->session_inbound_count;
+          session_id = s->session_id;
+          s->session_inbound_count++;
+        }
+
+      if (authentication_type == IPMI_AUTHENTICATION_TYPE_NONE)
+        {
+          password = NULL;
+          password_len = 0;
+        }
+
+      if (fill_lan_session_hdr (authentication_type,
+                                session_sequence_number,
+                                session_id,
+                                engine_objs.obj_lan_session_hdr_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_lan_session_hdr: %s", strerror (errno));
+          return (-1);
+        }
+
+      if ((len = assemble_ipmi_lan_pkt (engine_objs.obj_rmcp_hdr_rq,
+                                        engine_objs.obj_lan_session_hdr_rq,
+                                        engine_objs.obj_lan_msg_hdr_rq,
+                                        obj_cmd_rq,
+                                        password,
+                                        password_len,
+                                        buf,
+                                        buflen,
+                                        IPMI_INTERFACE_FLAGS_DEFAULT)) < 0)
+        {
+          ipmiseld_err_output (host_data, "assemble_ipmi_lan_pkt: %s", strerror (errno));
+          return (-1);
+        }
+    }
+  else
+    {
+      uint8_t payload_type;
+      uint8_t payload_authenticated;
+      uint8_t payload_encrypted;
+      uint8_t authentication_algorithm;
+      uint8_t integrity_algorithm;
+      uint8_t confidentiality_algorithm;
+      void *integrity_key;
+      unsigned int integrity_key_len;
+      void *confidentiality_key;
+      unsigned int confidentiality_key_len;
+      uint32_t session_id;
+      uint32_t session_sequence_number;
+
+      if (IPMISELD_ENGINE_STATE_IPMI_2_0_SETUP (s->state))
+        {
+          if (s->state == IPMISELD_ENGINE_STATE_OPEN_SESSION)
+            payload_type = IPMI_PAYLOAD_TYPE_RMCPPLUS_OPEN_SESSION_REQUEST;
+          else if (s->state == IPMISELD_ENGINE_STATE_RAKP_MESSAGE_1)
+            payload_type = IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_1;
+          else
+            payload_type = IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_3;
+          payload_authenticated = IPMI_PAYLOAD_FLAG_UNAUTHENTICATED;
+          payload_encrypted = IPMI_PAYLOAD_FLAG_UNENCRYPTED;
+          authentication_algorithm = IPMI_AUTHENTICATION_ALGORITHM_RAKP_NONE;
+          integrity_algorithm = IPMI_INTEGRITY_ALGORITHM_NONE;
+          confidentiality_algorithm = IPMI_CONFIDENTIALITY_ALGORITHM_NONE;
+          integrity_key = NULL;
+          integrity_key_len = 0;
+          confidentiality_key = NULL;
+          confidentiality_key_len = 0;
+          session_id = 0;
+          session_sequence_number = 0;
+          password = NULL;
+          password_len = 0;
+        }
+      else
+        {
+          payload_type = IPMI_PAYLOAD_TYPE_IPMI;
+          if (s->integrity_algorithm == IPMI_INTEGRITY_ALGORITHM_NONE)
+            payload_authenticated = IPMI_PAYLOAD_FLAG_UNAUTHENTICATED;
+          else
+            payload_authenticated = IPMI_PAYLOAD_FLAG_AUTHENTICATED;
+          if (s->confidentiality_algorithm == IPMI_CONFIDENTIALITY_ALGORITHM_NONE)
+            payload_encrypted = IPMI_PAYLOAD_FLAG_UNENCRYPTED;
+          else
+            payload_encrypted = IPMI_PAYLOAD_FLAG_ENCRYPTED;
+          authentication_algorithm = s->authentication_algorithm;
+          integrity_algorithm = s->integrity_algorithm;
+          confidentiality_algorithm = s->confidentiality_algorithm;
+          integrity_key = s->integrity_key_ptr;
+          integrity_key_len = s->integrity_key_len;
+          confidentiality_key = s->confidentiality_key_ptr;
+          confidentiality_key_len = s->confidentiality_key_len;
+          session_id = s->managed_system_session_id;
+
+          /* In IPMI 2.0, session sequence numbers of 0 are special */
+          s->session_sequence_number++;
+          if (!s->session_sequence_number)
+            s->session_sequence_number++;
+          session_sequence_number = s->session_sequence_number;
+        }
+
+      if (fill_rmcpplus_session_hdr (payload_type,
+                                     payload_authenticated,
+                                     payload_encrypted,
+                                     0, /* oem_iana */
+                                     0, /* oem_payload_id */
+                                     session_id,
+                                     session_sequence_number,
+                                     engine_objs.obj_rmcpplus_session_hdr_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_rmcpplus_session_hdr: %s", strerror (errno));
+          return (-1);
+        }
+
+      if (fill_rmcpplus_session_trlr (engine_objs.obj_rmcpplus_session_trlr_rq) < 0)
+        {
+          ipmiseld_err_output (host_data, "fill_rmcpplus_session_trlr: %s", strerror (errno));
+          return (-1);
+        }
+
+      if ((len = assemble_ipmi_rmcpplus_pkt (authentication_algorithm,
+                                             integrity_algorithm,
+                                             confidentiality_algorithm,
+                                             integrity_key,
+                                             integrity_key_len,
+                                             confidentiality_key,
+                                             confidentiality_key_len,
+                                             password,
+                                             password_len,
+                                             engine_objs.obj_rmcp_hdr_rq,
+                                             engine_objs.obj_rmcpplus_session_hdr_rq,
+                                             engine_objs.obj_lan_msg_hdr_rq,
+                                             obj_cmd_rq,
+                                             engine_objs.obj_rmcpplus_session_trlr_rq,
+                                             buf,
+                                             buflen,
+                                             IPMI_INTERFACE_FLAGS_DEFAULT)) < 0)
+        {
+          ipmiseld_err_output (host_data, "assemble_ipmi_rmcpplus_pkt: %s", strerror (errno));
+          return (-1);
+        }
+    }
+
+  return (len);
+}
+
+/* A failed send is treated like a lost packet, it is retransmitted
+ * or the session times out.
+ */
+static int
+_send (struct ipmiseld_engine_session *s)
+{
+  ipmiseld_host_data_t *host_data;
+  uint8_t buf[IPMISELD_ENGINE_PACKET_BUFLEN];
+  unsigned int retransmission_timeout;
+  int len;
+  int fd;
+
+  assert (s);
+  assert (s->host_data);
+  assert (s->engine_host);
+
+  host_data = s->host_data;
+
+  if ((len = _packet_create (s, buf, IPMISELD_ENGINE_PACKET_BUFLEN)) < 0)
+    return (-1);
+
+  if ((fd = _engine_fd (s->engine_host->addr.ss_family)) < 0)
+    return (-1);
+
+  if (sendto (fd,
+              buf,
+              len,
+              0,
+              (struct sockaddr *)&(s->engine_host->addr),
+              s->engine_host->addrlen) < 0)
+    {
+      if (engine_prog_data->args->common_args.debug)
+        IPMISELD_HOST_DEBUG (("sendto: %s", strerror (errno)));
+    }
+
+  if (gettimeofday (&s->last_send, NULL) < 0)
+    {
+      ipmiseld_err_output (host_data, "gettimeofday: %s", strerror (errno));
+      return (-1);
+    }
+
+  retransmission_timeout = rtt_timeout (&(s->engine_host->rtt));
+  retransmission_timeout *= (s->retransmission_count / IPMISELD_ENGINE_RETRANSMISSION_BACKOFF_COUNT) + 1;
+  timeval_add_ms (&s->last_send, retransmission_timeout, &s->retransmission_deadline);
+
+  return (0);
+}
+
+/* Sends the request for a new state, the session timeout starts over
+ * with each request.
+ */
+static int
+_request (struct ipmiseld_engine_session *s, ipmiseld_engine_state_t state)
+{
+  assert (s);
+
+  s->state = state;
+  s->retransmission_count = 0;
+
+  if (_send (s) < 0)
+    return (-1);
+
+  timeval_add_ms (&s->last_send, engine_session_timeout, &s->session_deadline);
+  return (0);
+}
+
+static void
+_session_free (struct ipmiseld_engine_session *s)
+{
+  assert (s);
+  assert (s->host_data);
+
+  hash_remove (engine_hash, &(s->engine_host->addr));
+  s->host_data = NULL;
+  s->engine_host = NULL;
+  s->next_free = engine_sessions_free;
+  engine_sessions_free = s;
+  engine_sessions_active--;
+}
+
+static void
+_complete (struct ipmiseld_engine_session *s, fiid_obj_t obj_cmd_rs, int errnum)
+{
+  ipmiseld_host_data_t *host_data;
+
+  assert (s);
+  assert (s->host_data);
+
+  host_data = s->host_data;
+
+  if (engine_prog_data->args->common_args.debug && errnum)
+    IPMISELD_HOST_DEBUG (("async engine error: %s", ipmi_ctx_strerror (errnum)));
+
+  /* Like ipmipower, the close session is not retransmitted, the BMC
+   * will time out the session if it is lost.
+   */
+  if (s->session_active)
+    {
+      s->state = IPMISELD_ENGINE_STATE_CLOSE_SESSION;
+      /* ignore potential error, session is done */
+      _send (s);
+    }
+
+  /* A BMC may have been moved, resolve again next time */
+  if (errnum == IPMI_ERR_CONNECTION_TIMEOUT)
+    s->engine_host->resolved = 0;
+
+  _session_free (s);
+
+  engine_callback (host_data, obj_cmd_rs, errnum);
+}
+
+/* Returns 1 on success, 0 on failure, -1 on error */
+static int
+_check_completion_code (struct ipmiseld_engine_session *s, fiid_obj_t obj_cmd_rs)
+{
+  ipmiseld_host_data_t *host_data;
+  int ret;
+
+  assert (s);
+  assert (s->host_data);
+  assert (obj_cmd_rs);
+
+  host_data = s->host_data;
+
+  if ((ret = ipmi_check_completion_code_success (obj_cmd_rs)) < 0)
+    {
+      ipmiseld_err_output (host_data, "ipmi_check_completion_code_success: %s", strerror (errno));
+      return (-1);
+    }
+
+  if (ret)
+    return (1);
+
+  if (s->state == IPMISELD_ENGINE_STATE_GET_SESSION_CHALLENGE
+      && (ipmi_check_completion_code (obj_cmd_rs, IPMI_COMP_CODE_GET_SESSION_CHALLENGE_INVALID_USERNAME) == 1
+          || ipmi_check_completion_code (obj_cmd_rs, IPMI_COMP_CODE_GET_SESSION_CHALLENGE_NULL_USERNAME_NOT_ENABLED) == 1))
+    s->errnum = IPMI_ERR_USERNAME_INVALID;
+  else if (s->state == IPMISELD_ENGINE_STATE_ACTIVATE_SESSION
+           && (ipmi_check_completion_code (obj_cmd_rs, IPMI_COMP_CODE_ACTIVATE_SESSION_NO_SESSION_SLOT_AVAILABLE) == 1
+               || ipmi_check_completion_code (obj_cmd_rs, IPMI_COMP_CODE_ACTIVATE_SESSION_NO_SLOT_AVAILABLE_FOR_GIVEN_USER) == 1
+               || ipmi_check_completion_code (obj_cmd_rs, IPMI_COMP_CODE_ACTIVATE_SESSION_NO_SLOT_AVAILABLE_TO_SUPPORT_USER) == 1))
+    s->errnum = IPMI_ERR_BMC_BUSY;
+  else if (s->state == IPMISELD_ENGINE_STATE_ACTIVATE_SESSION
+           && (ipmi_check_completion_code (obj_cmd_rs, IPMI_COMP_CODE_ACTIVATE_SESSION_EXCEEDS_PRIVILEGE_LEVEL) == 1
+               || ipmi_check_completion_code (obj_cmd_rs, IPMI_COMP_CODE_INSUFFICIENT_PRIVILEGE_LEVEL) == 1))
+    s->errnum = IPMI_ERR_PRIVILEGE_LEVEL_CANNOT_BE_OBTAINED;
+  else if (s->state == IPMISELD_ENGINE_STATE_SET_SESSION_PRIVILEGE_LEVEL
+           && (ipmi_check_completion_code (obj_cmd_rs, IPMI_COMP_CODE_SET_SESSION_PRIVILEGE_LEVEL_REQUESTED_LEVEL_NOT_AVAILABLE_FOR_USER) == 1
+               || ipmi_check_completion_code (obj_cmd_rs, IPMI_COMP_CODE_SET_SESSION_PRIVILEGE_LEVEL_REQUESTED_LEVEL_EXCEEDS_USER_PRIVILEGE_LIMIT) == 1))
+    s->errnum = IPMI_ERR_PRIVILEGE_LEVEL_CANNOT_BE_OBTAINED;
+  else
+    s->errnum = IPMI_ERR_BAD_COMPLETION_CODE;
+
+  return (0);
+}
+
+/* Returns 1 on success, 0 on failure, -1 on error */
+static int
+_check_rmcpplus_status_code (struct ipmiseld_engine_session *s, fiid_obj_t obj_cmd_rs)
+{
+  ipmiseld_host_data_t *host_data;
+  uint8_t rmcpplus_status_code;
+  uint64_t val;
+
+  assert (s);
+  assert (s->host_data);
+  assert (obj_cmd_rs);
+
+  host_data = s->host_data;
+
+  if (FIID_OBJ_GET (obj_cmd_rs, "rmcpplus_status_code", &val) < 0)
+    {
+      ipmiseld_err_output (host_data, "fiid_obj_get: 'rmcpplus_status_code': %s",
+                           fiid_obj_errormsg (obj_cmd_rs));
+      return (-1);
+    }
+  rmcpplus_status_code = val;
+
+  if (rmcpplus_status_code == RMCPPLUS_STATUS_NO_ERRORS)
+    return (1);
+
+  if (rmcpplus_status_code == RMCPPLUS_STATUS_INSUFFICIENT_RESOURCES_TO_CREATE_A_SESSION
+      || rmcpplus_status_code == RMCPPLUS_STATUS_INSUFFICIENT_RESOURCES_TO_CREATE_A_SESSION_AT_THE_REQUESTED_TIME)
+    s->errnum = IPMI_ERR_BMC_BUSY;
+  else if (s->state == IPMISELD_ENGINE_STATE_OPEN_SESSION
+           && rmcpplus_status_code == RMCPPLUS_STATUS_NO_CIPHER_SUITE_MATCH_WITH_PROPOSED_SECURITY_ALGORITHMS)
+    s->errnum = IPMI_ERR_CIPHER_SUITE_ID_UNAVAILABLE;
+  else if (s->state == IPMISELD_ENGINE_STATE_OPEN_SESSION
+           && rmcpplus_status_code == RMCPPLUS_STATUS_INVALID_ROLE)
+    s->errnum = IPMI_ERR_PRIVILEGE_LEVEL_CANNOT_BE_OBTAINED;
+  else if (s->state == IPMISELD_ENGINE_STATE_RAKP_MESSAGE_1
+           && rmcpplus_status_code == RMCPPLUS_STATUS_UNAUTHORIZED_NAME)
+    s->errnum = IPMI_ERR_USERNAME_INVALID;
+  else if (s->state == IPMISELD_ENGINE_STATE_RAKP_MESSAGE_1
+           && rmcpplus_status_code == RMCPPLUS_STATUS_UNAUTHORIZED_ROLE_OR_PRIVILEGE_LEVEL_REQUESTED)
+    s->errnum = IPMI_ERR_PRIVILEGE_LEVEL_CANNOT_BE_OBTAINED;
+  else if (s->state == IPMISELD_ENGINE_STATE_RAKP_MESSAGE_3
+           && rmcpplus_status_code == RMCPPLUS_STATUS_INVALID_INTEGRITY_CHECK_VALUE)
+    s->errnum = IPMI_ERR_PASSWORD_INVALID;
+  else
+    s->errnum = IPMI_ERR_BAD_RMCPPLUS_STATUS_CODE;
+
+  return (0);
+}
+
+/* Returns 1 if the check passed, 0 if not, -1 on error */
+static int
+_check (ipmiseld_host_data_t *host_data, int ret, const char *func)
+{
+  assert (host_data);
+  assert (func);
+
+  if (ret < 0)
+    {
+      ipmiseld_err_output (host_data, "%s: %s", func, strerror (errno));
+      return (-1);
+    }
+
+  if (!ret && host_data->prog_data->args->common_args.debug)
+    IPMISELD_HOST_DEBUG (("%s failed, packet ignored", func));
+
+  return (ret);
+}
+
+/* IPMI 1.5 packets, the setup packets of both IPMI 1.5 and 2.0 and
+ * the session packets of IPMI 1.5.
+ *
+ * Returns 1 if the packet is a response to the outstanding request,
+ * 0 if it should be ignored, -1 on error.
+ */
+static int
+_check_lan_packet (struct ipmiseld_engine_session *s,
+                   const void *buf,
+                   unsigned int buflen,
+                   fiid_obj_t obj_cmd_rs,
+                   uint8_t net_fn,
+                   uint8_t cmd)
+{
+  ipmiseld_host_data_t *host_data;
+  struct common_cmd_args *common_args;
+  uint64_t val;
+  int ret;
+
+  assert (s);
+  assert (s->host_data);
+  assert (buf);
+  assert (buflen);
+  assert (obj_cmd_rs);
+
+  host_data = s->host_data;
+  common_args = &(engine_prog_data->args->common_args);
+
+  if ((ret = _check (host_data,
+                     ipmi_is_ipmi_1_5_packet (buf, buflen),
+                     "ipmi_is_ipmi_1_5_packet")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     unassemble_ipmi_lan_pkt (buf,
+                                              buflen,
+                                              engine_objs.obj_rmcp_hdr_rs,
+                                              engine_objs.obj_lan_session_hdr_rs,
+                                              engine_objs.obj_lan_msg_hdr_rs,
+                                              obj_cmd_rs,
+                                              engine_objs.obj_lan_msg_trlr_rs,
+                                              IPMI_INTERFACE_FLAGS_DEFAULT),
+                     "unassemble_ipmi_lan_pkt")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_lan_check_checksum (engine_objs.obj_lan_msg_hdr_rs,
+                                              obj_cmd_rs,
+                                              engine_objs.obj_lan_msg_trlr_rs),
+                     "ipmi_lan_check_checksum")) <= 0)
+    return (ret);
+
+  if (s->state == IPMISELD_ENGINE_STATE_ACTIVATE_SESSION
+      || !IPMISELD_ENGINE_STATE_IPMI_1_5_SETUP (s->state))
+    {
+      uint8_t authentication_type;
+      char *password;
+
+      if (s->state == IPMISELD_ENGINE_STATE_ACTIVATE_SESSION
+          || s->permsgauth_enabled)
+        authentication_type = common_args->authentication_type;
+      else
+        authentication_type = IPMI_AUTHENTICATION_TYPE_NONE;
+
+      if (authentication_type != IPMI_AUTHENTICATION_TYPE_NONE)
+        password = common_args->password;
+      else
+        password = NULL;
+
+      if ((ret = _check (host_data,
+                         ipmi_lan_check_packet_session_authentication_code (buf,
+                                                                            buflen,
+                                                                            authentication_type,
+                                                                            password,
+                                                                            password ? strlen (password) : 0),
+                         "ipmi_lan_check_packet_session_authentication_code")) <= 0)
+        return (ret);
+    }
+
+  if (!IPMISELD_ENGINE_STATE_IPMI_1_5_SETUP (s->state))
+    {
+      if (FIID_OBJ_GET (engine_objs.obj_lan_session_hdr_rs,
+                        "session_sequence_number",
+                        &val) < 0)
+        {
+          ipmiseld_err_output (host_data, "fiid_obj_get: 'session_sequence_number': %s",
+                               fiid_obj_errormsg (engine_objs.obj_lan_session_hdr_rs));
+          return (-1);
+        }
+
+      if ((ret = _check (host_data,
+                         ipmi_check_session_sequence_number_1_5 (val,
+                                                                 &s->highest_received_sequence_number,
+                                                                 &s->previously_received_list,
+                                                                 0),
+                         "ipmi_check_session_sequence_number_1_5")) <= 0)
+        return (ret);
+
+      if ((ret = _check (host_data,
+                         ipmi_lan_check_session_id (engine_objs.obj_lan_session_hdr_rs,
+                                                    s->session_id),
+                         "ipmi_lan_check_session_id")) <= 0)
+        return (ret);
+    }
+
+  if ((ret = _check (host_data,
+                     ipmi_lan_check_net_fn (engine_objs.obj_lan_msg_hdr_rs, net_fn),
+                     "ipmi_lan_check_net_fn")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_check_cmd (obj_cmd_rs, cmd),
+                     "ipmi_check_cmd")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_lan_check_rq_seq (engine_objs.obj_lan_msg_hdr_rs, s->rq_seq),
+                     "ipmi_lan_check_rq_seq")) <= 0)
+    return (ret);
+
+  return (1);
+}
+
+/* IPMI 2.0 packets, RMCP+ session setup and session packets.
+ *
+ * Returns 1 if the packet is a response to the outstanding request,
+ * 0 if it should be ignored, -1 on error.
+ */
+static int
+_check_rmcpplus_packet (struct ipmiseld_engine_session *s,
+                        const void *buf,
+                        unsigned int buflen,
+                        fiid_obj_t obj_cmd_rs,
+                        uint8_t payload_type,
+                        uint8_t net_fn,
+                        uint8_t cmd)
+{
+  ipmiseld_host_data_t *host_data;
+  struct common_cmd_args *common_args;
+  uint64_t val;
+  int ret;
+
+  assert (s);
+  assert (s->host_data);
+  assert (buf);
+  assert (buflen);
+  assert (obj_cmd_rs);
+
+  host_data = s->host_data;
+  common_args = &(engine_prog_data->args->common_args);
+
+  if ((ret = _check (host_data,
+                     ipmi_is_ipmi_2_0_packet (buf, buflen),
+                     "ipmi_is_ipmi_2_0_packet")) <= 0)
+    return (ret);
+
+  if (IPMISELD_ENGINE_STATE_IPMI_2_0_SETUP (s->state))
+    ret = unassemble_ipmi_rmcpplus_pkt (IPMI_AUTHENTICATION_ALGORITHM_RAKP_NONE,
+                                        IPMI_INTEGRITY_ALGORITHM_NONE,
+                                        IPMI_CONFIDENTIALITY_ALGORITHM_NONE,
+                                        NULL,
+                                        0,
+                                        NULL,
+                                        0,
+                                        buf,
+                                        buflen,
+                                        engine_objs.obj_rmcp_hdr_rs,
+                                        engine_objs.obj_rmcpplus_session_hdr_rs,
+                                        engine_objs.obj_rmcpplus_payload_rs,
+                                        engine_objs.obj_lan_msg_hdr_rs,
+                                        obj_cmd_rs,
+                                        engine_objs.obj_lan_msg_trlr_rs,
+                                        engine_objs.obj_rmcpplus_session_trlr_rs,
+                                        IPMI_INTERFACE_FLAGS_DEFAULT);
+  else
+    ret = unassemble_ipmi_rmcpplus_pkt (s->authentication_algorithm,
+                                        s->integrity_algorithm,
+                                        s->confidentiality_algorithm,
+                                        s->integrity_key_ptr,
+                                        s->integrity_key_len,
+                                        s->confidentiality_key_ptr,
+                                        s->confidentiality_key_len,
+                                        buf,
+                                        buflen,
+                                        engine_objs.obj_rmcp_hdr_rs,
+                                        engine_objs.obj_rmcpplus_session_hdr_rs,
+                                        engine_objs.obj_rmcpplus_payload_rs,
+                                        engine_objs.obj_lan_msg_hdr_rs,
+                                        obj_cmd_rs,
+                                        engine_objs.obj_lan_msg_trlr_rs,
+                                        engine_objs.obj_rmcpplus_session_trlr_rs,
+                                        IPMI_INTERFACE_FLAGS_DEFAULT);
+
+  if ((ret = _check (host_data, ret, "unassemble_ipmi_rmcpplus_pkt")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_rmcpplus_check_payload_type (engine_objs.obj_rmcpplus_session_hdr_rs,
+                                                       payload_type),
+                     "ipmi_rmcpplus_check_payload_type")) <= 0)
+    return (ret);
+
+  if (IPMISELD_ENGINE_STATE_IPMI_2_0_SETUP (s->state))
+    {
+      if ((ret = _check (host_data,
+                         ipmi_rmcpplus_check_message_tag (obj_cmd_rs, s->message_tag),
+                         "ipmi_rmcpplus_check_message_tag")) <= 0)
+        return (ret);
+
+      /* the remote console session id is checked after the status
+       * code by the caller, it may not be valid on an error
+       */
+      return (1);
+    }
+
+  if ((ret = _check (host_data,
+                     ipmi_rmcpplus_check_payload_pad (s->confidentiality_algorithm,
+                                                      engine_objs.obj_rmcpplus_payload_rs),
+                     "ipmi_rmcpplus_check_payload_pad")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_rmcpplus_check_integrity_pad (engine_objs.obj_rmcpplus_session_trlr_rs),
+                     "ipmi_rmcpplus_check_integrity_pad")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_lan_check_checksum (engine_objs.obj_lan_msg_hdr_rs,
+                                              obj_cmd_rs,
+                                              engine_objs.obj_lan_msg_trlr_rs),
+                     "ipmi_lan_check_checksum")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_rmcpplus_check_packet_session_authentication_code (s->integrity_algorithm,
+                                                                             buf,
+                                                                             buflen,
+                                                                             s->integrity_key_ptr,
+                                                                             s->integrity_key_len,
+                                                                             common_args->password,
+                                                                             common_args->password ? strlen (common_args->password) : 0,
+                                                                             engine_objs.obj_rmcpplus_session_trlr_rs),
+                     "ipmi_rmcpplus_check_packet_session_authentication_code")) <= 0)
+    return (ret);
+
+  if (FIID_OBJ_GET (engine_objs.obj_rmcpplus_session_hdr_rs,
+                    "session_sequence_number",
+                    &val) < 0)
+    {
+      ipmiseld_err_output (host_data, "fiid_obj_get: 'session_sequence_number': %s",
+                           fiid_obj_errormsg (engine_objs.obj_rmcpplus_session_hdr_rs));
+      return (-1);
+    }
+
+  if ((ret = _check (host_data,
+                     ipmi_check_session_sequence_number_2_0 (val,
+                                                             &s->highest_received_sequence_number,
+                                                             &s->previously_received_list,
+                                                             0),
+                     "ipmi_check_session_sequence_number_2_0")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_rmcpplus_check_session_id (engine_objs.obj_rmcpplus_session_hdr_rs,
+                                                     s->remote_console_session_id),
+                     "ipmi_rmcpplus_check_session_id")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_lan_check_net_fn (engine_objs.obj_lan_msg_hdr_rs, net_fn),
+                     "ipmi_lan_check_net_fn")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_check_cmd (obj_cmd_rs, cmd),
+                     "ipmi_check_cmd")) <= 0)
+    return (ret);
+
+  if ((ret = _check (host_data,
+                     ipmi_lan_check_rq_seq (engine_objs.obj_lan_msg_hdr_rs, s->rq_seq),
+                     "ipmi_lan_check_rq_seq")) <= 0)
+    return (ret);
+
+  return (1);
+}
+
+/* Returns 1 to continue, 0 on failure (s->errnum set), -1 on error */
+static int
+_authentication_capabilities_check (struct ipmiseld_engine_session *s)
+{
+  ipmiseld_host_data_t *host_data;
+  struct common_cmd_args *common_args;
+  fiid_obj_t obj_cmd_rs;
+  uint64_t val;
+  int ret;
+
+  assert (s);
+  assert (s->host_data);
+
+  host_data = s->host_data;
+  common_args = &(engine_prog_data->args->common_args);
+  obj_cmd_rs = engine_objs.obj_authentication_capabilities_rs;
+
+  if (_ipmi_2_0 ())
+    {
+      if ((ret = ipmi_check_authentication_capabilities_ipmi_2_0 (obj_cmd_rs)) < 0)
+        {
+          ipmiseld_err_output (host_data,
+                               "ipmi_check_authentication_capabilities_ipmi_2_0: %s",
+                               strerror (errno));
+          return (-1);
+        }
+
+      if (!ret)
+        {
+          s->errnum = IPMI_ERR_IPMI_2_0_UNAVAILABLE;
+          return (0);
+        }
+    }
+
+  if ((ret = ipmi_check_authentication_capabilities_username (common_args->username,
+                                                              common_args->password,
+                                                              obj_cmd_rs)) < 0)
+    {
+      ipmiseld_err_output (host_data,
+                           "ipmi_check_authentication_capabilities_username: %s",
+                           strerror (errno));
+      return (-1);
+    }
+
+  if (!ret)
+    {
+      s->errnum = IPMI_ERR_USERNAME_INVALID;
+      return (0);
+    }
+
+  if (_ipmi_2_0 ())
+    {
+      if ((ret = ipmi_check_authentication_capabilities_k_g (common_args->k_g_len ? common_args->k_g : NULL,
+                                                             obj_cmd_rs)) < 0)
+        {
+          ipmiseld_err_output (host_data,
+                               "ipmi_check_authentication_capabilities_k_g: %s",
+                               strerror (errno));
+          return (-1);
+        }
+
+      if (!ret)
+        {
+          s->errnum = IPMI_ERR_K_G_INVALID;
+          return (0);
+        }
+
+      return (1);
+    }
+
+  if ((ret = ipmi_check_authentication_capabilities_authentication_type (common_args->authentication_type,
+                                                                         obj_cmd_rs)) < 0)
+    {
+      ipmiseld_err_output (host_data,
+                           "ipmi_check_authentication_capabilities_authentication_type: %s",
+                           strerror (errno));
+      return (-1);
+    }
+
+  if (!ret)
+    {
+      s->errnum = IPMI_ERR_AUTHENTICATION_TYPE_UNAVAILABLE;
+      return (0);
+    }
+
+  if (FIID_OBJ_GET (obj_cmd_rs,
+                    "authentication_status.per_message_authentication",
+                    &val) < 0)
+    {
+      ipmiseld_err_output (host_data,
+                           "fiid_obj_get: 'authentication_status.per_message_authentication': %s",
+                           fiid_obj_errormsg (obj_cmd_rs));
+      return (-1);
+    }
+
+  /* per message authentication is disabled if the bit is set */
+  s->permsgauth_enabled = val ? 0 : 1;
+  return (1);
+}
+
+/* Returns 1 to continue, 0 on failure (s->errnum set), -1 on error */
+static int
+_activate_session_store (struct ipmiseld_engine_session *s)
+{
+  ipmiseld_host_data_t *host_data;
+  struct common_cmd_args *common_args;
+  fiid_obj_t obj_cmd_rs;
+  uint64_t val;
+
+  assert (s);
+  assert (s->host_data);
+
+  host_data = s->host_data;
+  common_args = &(engine_prog_data->args->common_args);
+  obj_cmd_rs = engine_objs.obj_activate_session_rs;
+
+  if (FIID_OBJ_GET (obj_cmd_rs, "session_id", &val) < 0)
+    {
+      ipmiseld_err_output (host_data, "fiid_obj_get: 'session_id': %s",
+                           fiid_obj_errormsg (obj_cmd_rs));
+      return (-1);
+    }
+  s->session_id = val;
+
+  if (FIID_OBJ_GET (obj_cmd_rs, "initial_inbound_sequence_number", &val) < 0)
+    {
+      ipmiseld_err_output (host_data, "fiid_obj_get: 'initial_inbound_sequence_number': %s",
+                           fiid_obj_errormsg (obj_cmd_rs));
+      return (-1);
+    }
+  s->initial_inbound_sequence_number = val;
+
+  if (FIID_OBJ_GET (engine_objs.obj_lan_session_hdr_rs,
+                    "session_sequence_number",
+                    &val) < 0)
+    {
+      ipmiseld_err_output (host_data, "fiid_obj_get: 'session_sequence_number': %s",
+                           fiid_obj_errormsg (engine_objs.obj_lan_session_hdr_rs));
+      return (-1);
+    }
+  s->highest_received_sequence_number = val;
+
+  /* the session is open from here on, even if it is not usable */
+  s->session_active = 1;
+
+  if (FIID_OBJ_GET (obj_cmd_rs, "authentication_type", &val) < 0)
+    {
+      ipmiseld_err_output (host_data, "fiid_obj_get: 'authentication_type': %s",
+                           fiid_obj_errormsg (obj_cmd_rs));
+      return (-1);
+    }
+
+  /* Some BMCs ignore that per message authentication is disabled,
+   * follow what the BMC does like ipmipower.
+   */
+  if (!s->permsgauth_enabled
+      && val != IPMI_AUTHENTICATION_TYPE_NONE)
+    s->permsgauth_enabled = 1;
+
+  if (s->permsgauth_enabled
+      && val != common_args->authentication_type)
+    {
+      s->errnum = IPMI_ERR_IPMI_ERROR;
+      return (0);
+    }
+
+  return (1);
+}
+
+/* Returns 1 to continue, 0 on failure (s->errnum set), -1 on error */
+static int
+_rakp_message_2_store (struct ipmiseld_engine_session *s)
+{
+  ipmiseld_host_data_t *host_data;
+  struct common_cmd_args *common_args;
+  fiid_obj_t obj_cmd_rs;
+  char *username;
+  unsigned int username_len;
+  char *password;
+  unsigned int password_len;
+  int len;
+  int ret;
+
+  assert (s);
+  assert (s->host_data);
+
+  host_data = s->host_data;
+  common_args = &(engine_prog_data->args->common_args);
+  obj_cmd_rs = engine_objs.obj_rakp_message_2_rs;
+
+  username = common_args->username;
+  username_len = (username) ? strlen (username) : 0;
+  password = common_args->password;
+  password_len = (password) ? strlen (password) : 0;
+
+  if ((len = fiid_obj_get_data (obj_cmd_rs,
+                                "managed_system_random_number",
+                                s->managed_system_random_number,
+                                IPMI_MANAGED_SYSTEM_RANDOM_NUMBER_LENGTH)) < 0)
+    {
+      ipmiseld_err_output (host_data, "fiid_obj_get_data: 'managed_system_random_number': %s",
+                           fiid_obj_errormsg (obj_cmd_rs));
+      return (-1);
+    }
+  s->managed_system_random_number_len = len;
+
+  if ((len = fiid_obj_get_data (obj_cmd_rs,
+                                "managed_system_guid",
+                                s->managed_system_guid,
+                                IPMI_MANAGED_SYSTEM_GUID_LENGTH)) < 0)
+    {
+      ipmiseld_err_output (host_data, "fiid_obj_get_data: 'managed_system_guid': %s",
+                           fiid_obj_errormsg (obj_cmd_rs));
+      return (-1);
+    }
+  s->managed_system_guid_len = len;
+
+  if ((ret = ipmi_rmcpplus_check_rakp_2_key_exchange_authentication_code (s->authentication_algorithm,
+                                                                          password,
+                                                                          password_len,
+                                                                          s->remote_console_session_id,
+                                                                          s->managed_system_session_id,
+                                                                          s->remote_console_random_number,
+                                                                          IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH,
+                                                                          s->managed_system_random_number,
+                                                                          s->managed_system_random_number_len,
+                                                                          s->managed_system_guid,
+                                                                          s->managed_system_guid_len,
+                                                                          IPMI_NAME_ONLY_LOOKUP,
+                                                                          common_args->privilege_level,
+                                                                          username,
+                                                                          username_len,
+                                                                          obj_cmd_rs)) < 0)
+    {
+      ipmiseld_err_output (host_data,
+                           "ipmi_rmcpplus_check_rakp_2_key_exchange_authentication_code: %s",
+                           strerror (errno));
+      return (-1);
+    }
+
+  if (!ret)
+    {
+      s->errnum = IPMI_ERR_PASSWORD_INVALID;
+      return (0);
+    }
+
+  s->sik_key_ptr = s->sik_key;
+  s->sik_key_len = IPMISELD_ENGINE_MAX_SIK_KEY_LENGTH;
+  s->integrity_key_ptr = s->integrity_key;
+  s->integrity_key_len = IPMISELD_ENGINE_MAX_INTEGRITY_KEY_LENGTH;
+  s->confidentiality_key_ptr = s->confidentiality_key;
+  s->confidentiality_key_len = IPMISELD_ENGINE_MAX_CONFIDENTIALITY_KEY_LENGTH;
+
+  if (ipmi_calculate_rmcpplus_session_keys (s->authentication_algorithm,
+                                            s->integrity_algorithm,
+                                            s->confidentiality_algorithm,
+                                            password,
+                                            password_len,
+                                            common_args->k_g_len ? common_args->k_g : NULL,
+                                            common_args->k_g_len,
+                                            s->remote_console_random_number,
+                                            IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH,
+                                            s->managed_system_random_number,
+                                            s->managed_system_random_number_len,
+                                            IPMI_NAME_ONLY_LOOKUP,
+                                            common_args->privilege_level,
+                                            username,
+                                            username_len,
+                                            &s->sik_key_ptr,
+                                            &s->sik_key_len,
+                                            &s->integrity_key_ptr,
+                                            &s->integrity_key_len,
+                                            &s->confidentiality_key_ptr,
+                                            &s->confidentiality_key_len) < 0)
+    {
+      ipmiseld_err_output (host_data,
+                           "ipmi_calculate_rmcpplus_session_keys: %s",
+                           strerror (errno));
+      return (-1);
+    }
+
+  return (1);
+}
+
+/* Returns 1 if the response was handled (the session may be freed),
+ * 0 if the packet was ignored, -1 on failure (s->errnum set)
+ */
+static int
+_recv_packet (struct ipmiseld_engine_session *s,
+              const void *buf,
+              unsigned int buflen)
+{
+  ipmiseld_host_data_t *host_data;
+  struct common_cmd_args *common_args;
+  fiid_obj_t obj_cmd_rs;
+  uint8_t payload_type = IPMI_PAYLOAD_TYPE_IPMI;
+  uint8_t net_fn = IPMI_NET_FN_APP_RS;
+  uint8_t cmd = 0;
+  struct timeval now;
+  uint64_t val;
+  int ret;
+
+  assert (s);
+  assert (s->host_data);
+  assert (buf);
+  assert (buflen);
+
+  host_data = s->host_data;
+  common_args = &(engine_prog_data->args->common_args);
+
+  switch (s->state)
+    {
+    case IPMISELD_ENGINE_STATE_AUTHENTICATION_CAPABILITIES:
+      obj_cmd_rs = engine_objs.obj_authentication_capabilities_rs;
+      cmd = IPMI_CMD_GET_CHANNEL_AUTHENTICATION_CAPABILITIES;
+      break;
+    case IPMISELD_ENGINE_STATE_GET_SESSION_CHALLENGE:
+      obj_cmd_rs = engine_objs.obj_get_session_challenge_rs;
+      cmd = IPMI_CMD_GET_SESSION_CHALLENGE;
+      break;
+    case IPMISELD_ENGINE_STATE_ACTIVATE_SESSION:
+      obj_cmd_rs = engine_objs.obj_activate_session_rs;
+      cmd = IPMI_CMD_ACTIVATE_SESSION;
+      break;
+    case IPMISELD_ENGINE_STATE_OPEN_SESSION:
+      obj_cmd_rs = engine_objs.obj_open_session_rs;
+      payload_type = IPMI_PAYLOAD_TYPE_RMCPPLUS_OPEN_SESSION_RESPONSE;
+      break;
+    case IPMISELD_ENGINE_STATE_RAKP_MESSAGE_1:
+      obj_cmd_rs = engine_objs.obj_rakp_message_2_rs;
+      payload_type = IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_2;
+      break;
+    case IPMISELD_ENGINE_STATE_RAKP_MESSAGE_3:
+      obj_cmd_rs = engine_objs.obj_rakp_message_4_rs;
+      payload_type = IPMI_PAYLOAD_TYPE_RAKP_MESSAGE_4;
+      break;
+    case IPMISELD_ENGINE_STATE_SET_SESSION_PRIVILEGE_LEVEL:
+      obj_cmd_rs = engine_objs.obj_set_session_privilege_level_rs;
+      cmd = IPMI_CMD_SET_SESSION_PRIVILEGE_LEVEL;
+      break;
+    case IPMISELD_ENGINE_STATE_GET_SEL_INFO:
+      obj_cmd_rs = engine_objs.obj_get_sel_info_rs;
+      net_fn = IPMI_NET_FN_STORAGE_RS;
+      cmd = IPMI_CMD_GET_SEL_INFO;
+      break;
+    default:
+      /* close session responses are not waited for */
+      return (0);
+    }
+
+  if (IPMISELD_ENGINE_STATE_IPMI_1_5_SETUP (s->state) || !_ipmi_2_0 ())
+    ret = _check_lan_packet (s, buf, buflen, obj_cmd_rs, net_fn, cmd);
+  else
+    ret = _check_rmcpplus_packet (s, buf, buflen, obj_cmd_rs, payload_type, net_fn, cmd);
+
+  if (ret < 0)
+    goto internal_error;
+
+  if (!ret)
+    return (0);
+
+  if (IPMISELD_ENGINE_STATE_IPMI_2_0_SETUP (s->state) && _ipmi_2_0 ())
+    {
+      if ((ret = _check_rmcpplus_status_code (s, obj_cmd_rs)) < 0)
+        goto internal_error;
+
+      if (!ret)
+        return (-1);
+
+      if ((ret = _check (host_data,
+                         ipmi_rmcpplus_check_remote_console_session_id (obj_cmd_rs,
+                                                                        s->remote_console_session_id),
+                         "ipmi_rmcpplus_check_remote_console_session_id")) < 0)
+        goto internal_error;
+
+      if (!ret)
+        return (0);
+    }
+  else
+    {
+      if ((ret = _check_completion_code (s, obj_cmd_rs)) < 0)
+        goto internal_error;
+
+      if (!ret)
+        return (-1);
+    }
+
+  /* If the packet is no good though, ignore it.  Must be checked
+   * after the completion code, error responses can be short.
+   */
+  if ((ret = _check (host_data,
+                     fiid_obj_packet_valid (obj_cmd_rs),
+                     "fiid_obj_packet_valid")) < 0)
+    goto internal_error;
+
+  if (!ret)
+    return (0);
+
+  if (gettimeofday (&now, NULL) < 0)
+    {
+      ipmiseld_err_output (host_data, "gettimeofday: %s", strerror (errno));
+      goto internal_error;
+    }
+
+  /* Karn's algorithm, a response to a retransmitted request cannot
+   * be matched to the transmission it answers
+   */
+  if (!s->retransmission_count)
+    rtt_sample (&(s->engine_host->rtt), &s->last_send, &now);
+
+  switch (s->state)
+    {
+    case IPMISELD_ENGINE_STATE_AUTHENTICATION_CAPABILITIES:
+      if ((ret = _authentication_capabilities_check (s)) < 0)
+        goto internal_error;
+      if (!ret)
+        return (-1);
+      if (_ipmi_2_0 ())
+        ret = _request (s, IPMISELD_ENGINE_STATE_OPEN_SESSION);
+      else
+        ret = _request (s, IPMISELD_ENGINE_STATE_GET_SESSION_CHALLENGE);
+      break;
+    case IPMISELD_ENGINE_STATE_GET_SESSION_CHALLENGE:
+      if (FIID_OBJ_GET (obj_cmd_rs, "temp_session_id", &val) < 0)
+        {
+          ipmiseld_err_output (host_data, "fiid_obj_get: 'temp_session_id': %s",
+                               fiid_obj_errormsg (obj_cmd_rs));
+          goto internal_error;
+        }
+      s->temp_session_id = val;
+
+      if ((ret = fiid_obj_get_data (obj_cmd_rs,
+                                    "challenge_string",
+                                    s->challenge_string,
+                                    IPMI_CHALLENGE_STRING_LENGTH)) < 0)
+        {
+          ipmiseld_err_output (host_data, "fiid_obj_get_data: 'challenge_string': %s",
+                               fiid_obj_errormsg (obj_cmd_rs));
+          goto internal_error;
+        }
+      s->challenge_string_len = ret;
+
+      ret = _request (s, IPMISELD_ENGINE_STATE_ACTIVATE_SESSION);
+      break;
+    case IPMISELD_ENGINE_STATE_ACTIVATE_SESSION:
+      if ((ret = _activate_session_store (s)) < 0)
+        goto internal_error;
+      if (!ret)
+        return (-1);
+      ret = _request (s, IPMISELD_ENGINE_STATE_SET_SESSION_PRIVILEGE_LEVEL);
+      break;
+    case IPMISELD_ENGINE_STATE_OPEN_SESSION:
+      if ((ret = ipmi_check_open_session_maximum_privilege (common_args->privilege_level,
+                                                            obj_cmd_rs)) < 0)
+        {
+          ipmiseld_err_output (host_data,
+                               "ipmi_check_open_session_maximum_privilege: %s",
+                               strerror (errno));
+          goto internal_error;
+        }
+
+      if (!ret)
+        {
+          s->errnum = IPMI_ERR_PRIVILEGE_LEVEL_CANNOT_BE_OBTAINED;
+          return (-1);
+        }
+
+      if (FIID_OBJ_GET (obj_cmd_rs, "managed_system_session_id", &val) < 0)
+        {
+          ipmiseld_err_output (host_data, "fiid_obj_get: 'managed_system_session_id': %s",
+                               fiid_obj_errormsg (obj_cmd_rs));
+          goto internal_error;
+        }
+      s->managed_system_session_id = val;
+
+      ret = _request (s, IPMISELD_ENGINE_STATE_RAKP_MESSAGE_1);
+      break;
+    case IPMISELD_ENGINE_STATE_RAKP_MESSAGE_1:
+      if ((ret = _rakp_message_2_store (s)) < 0)
+        goto internal_error;
+      if (!ret)
+        return (-1);
+      ret = _request (s, IPMISELD_ENGINE_STATE_RAKP_MESSAGE_3);
+      break;
+    case IPMISELD_ENGINE_STATE_RAKP_MESSAGE_3:
+      if ((ret = ipmi_rmcpplus_check_rakp_4_integrity_check_value (s->authentication_algorithm,
+                                                                   s->sik_key_ptr,
+                                                                   s->sik_key_len,
+                                                                   s->remote_console_random_number,
+                                                                   IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH,
+                                                                   s->managed_system_session_id,
+                                                                   s->managed_system_guid,
+                                                                   s->managed_system_guid_len,
+                                                                   obj_cmd_rs)) < 0)
+        {
+          ipmiseld_err_output (host_data,
+                               "ipmi_rmcpplus_check_rakp_4_integrity_check_value: %s",
+                               strerror (errno));
+          goto internal_error;
+        }
+
+      if (!ret)
+        {
+          s->errnum = IPMI_ERR_K_G_INVALID;
+          return (-1);
+        }
+
+      if (ipmi_check_session_sequence_number_2_0_init (&s->highest_received_sequence_number,
+                                                       &s->previously_received_list) < 0)
+        {
+          ipmiseld_err_output (host_data,
+                               "ipmi_check_session_sequence_number_2_0_init: %s",
+                               strerror (errno));
+          goto internal_error;
+        }
+
+      s->session_active = 1;
+      ret = _request (s, IPMISELD_ENGINE_STATE_SET_SESSION_PRIVILEGE_LEVEL);
+      break;
+    case IPMISELD_ENGINE_STATE_SET_SESSION_PRIVILEGE_LEVEL:
+      ret = _request (s, IPMISELD_ENGINE_STATE_GET_SEL_INFO);
+      break;
+    case IPMISELD_ENGINE_STATE_GET_SEL_INFO:
+    default:
+      _complete (s, obj_cmd_rs, 0);
+      return (1);
+    }
+
+  if (ret < 0)
+    goto internal_error;
+
+  return (1);
+
+ internal_error:
+  s->errnum = IPMI_ERR_INTERNAL_ERROR;
+  return (-1);
+}
+
+int
+ipmiseld_engine_submit (ipmiseld_host_data_t *host_data)
+{
+  struct common_cmd_args *common_args;
+  struct ipmiseld_engine_host *engine_host;
+  struct ipmiseld_engine_session *s;
+  int ret;
+
+  assert (host_data);
+  assert (host_data->hostname);
+  assert (engine_sessions);
+
+  common_args = &(engine_prog_data->args->common_args);
+
+  if (!engine_sessions_free)
+    return (0);
+
+  if (!host_data->engine_host)
+    {
+      if (!(host_data->engine_host = (struct ipmiseld_engine_host *)calloc (1, sizeof (struct ipmiseld_engine_host))))
+        {
+          ipmiseld_err_output (host_data, "calloc: %s", strerror (errno));
+          return (-1);
+        }
+      rtt_init (&(host_data->engine_host->rtt), engine_retransmission_timeout);
+    }
+  engine_host = host_data->engine_host;
+
+  /* invalid hostnames are reported through the threadpool */
+  if (!engine_host->resolved)
+    {
+      if ((ret = _engine_host_resolve (host_data, engine_host)) <= 0)
+        return (ret);
+    }
+
+  /* responses are matched to sessions by address */
+  if (hash_find (engine_hash, &(engine_host->addr)))
+    return (0);
+
+  s = engine_sessions_free;
+  memset (s, '\0', sizeof (struct ipmiseld_engine_session));
+  s->host_data = host_data;
+  s->engine_host = engine_host;
+
+  if (ipmi_get_random (&s->rq_seq, sizeof (s->rq_seq)) < 0)
+    {
+      ipmiseld_err_output (host_data, "ipmi_get_random: %s", strerror (errno));
+      return (-1);
+    }
+
+  if (_ipmi_2_0 ())
+    {
+      if (ipmi_cipher_suite_id_to_algorithms (common_args->cipher_suite_id,
+                                              &s->authentication_algorithm,
+                                              &s->integrity_algorithm,
+                                              &s->confidentiality_algorithm) < 0)
+        {
+          ipmiseld_err_output (host_data, "ipmi_cipher_suite_id_to_algorithms: %s", strerror (errno));
+          return (-1);
+        }
+
+      /* In IPMI 2.0, session_ids of 0 are special */
+      do
+        {
+          if (ipmi_get_random (&s->remote_console_session_id,
+                               sizeof (s->remote_console_session_id)) < 0)
+            {
+              ipmiseld_err_output (host_data, "ipmi_get_random: %s", strerror (errno));
+              return (-1);
+            }
+        } while (!s->remote_console_session_id);
+
+      if (ipmi_get_random (s->remote_console_random_number,
+                           IPMI_REMOTE_CONSOLE_RANDOM_NUMBER_LENGTH) < 0
+          || ipmi_get_random (&s->message_tag, sizeof (s->message_tag)) < 0)
+        {
+          ipmiseld_err_output (host_data, "ipmi_get_random: %s", strerror (errno));
+          return (-1);
+        }
+    }
+  else
+    {
+      if (ipmi_check_session_sequence_number_1_5_init (&s->highest_received_sequence_number,
+                                                       &s->previously_received_list) < 0)
+        {
+          ipmiseld_err_output (host_data,
+                               "ipmi_check_session_sequence_number_1_5_init: %s",
+                               strerror (errno));
+          return (-1);
+        }
+    }
+
+  if (!hash_insert (engine_hash, &(engine_host->addr), s))
+    {
+      ipmiseld_err_output (host_data, "hash_insert: %s", strerror (errno));
+      return (-1);
+    }
+
+  engine_sessions_free = s->next_free;
+  s->next_free = NULL;
+  engine_sessions_active++;
+
+  if (_request (s, IPMISELD_ENGINE_STATE_AUTHENTICATION_CAPABILITIES) < 0)
+    {
+      _session_free (s);
+      return (-1);
+    }
+
+  return (1);
+}
+
+int
+ipmiseld_engine_full (void)
+{
+  return (engine_sessions_free ? 0 : 1);
+}
+
+static int
+_engine_recv (int fd)
+{
+  uint8_t buf[IPMISELD_ENGINE_PACKET_BUFLEN];
+  unsigned int i;
+
+  for (i = 0; i < IPMISELD_ENGINE_RECV_MAX; i++)
+    {
+      struct ipmiseld_engine_session *s;
+      struct sockaddr_storage from;
+      socklen_t fromlen = sizeof (struct sockaddr_storage);
+      ssize_t len;
+
+      if ((len = recvfrom (fd,
+                           buf,
+                           IPMISELD_ENGINE_PACKET_BUFLEN,
+                           0,
+                           (struct sockaddr *)&from,
+                           &fromlen)) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+
+          /* e.g. an ICMP error, there is nothing to read */
+          if (engine_prog_data->args->common_args.debug)
+            IPMISELD_DEBUG (("recvfrom: %s", strerror (errno)));
+          break;
+        }
+
+      if (!len)
+        continue;
+
+      if (!(s = hash_find (engine_hash, &from)))
+        continue;
+
+      if (_recv_packet (s, buf, len) < 0)
+        _complete (s, NULL, s->errnum);
+    }
+
+  return (0);
+}
+
+static void
+_engine_timeouts (void)
+{
+  struct timeval now;
+  unsigned int i;
+
+  if (gettimeofday (&now, NULL) < 0)
+    {
+      err_output ("gettimeofday: %s", strerror (errno));
+      return;
+    }
+
+  for (i = 0; i < engine_sessions_len; i++)
+    {
+      struct ipmiseld_engine_session *s = &engine_sessions[i];
+
+      if (!s->host_data)
+        continue;
+
+      if (timeval_gt (&now, &s->session_deadline))
+        {
+          int errnum;
+
+          if (s->state == IPMISELD_ENGINE_STATE_AUTHENTICATION_CAPABILITIES)
+            errnum = IPMI_ERR_CONNECTION_TIMEOUT;
+          else if (s->state == IPMISELD_ENGINE_STATE_ACTIVATE_SESSION)
+            errnum = IPMI_ERR_PASSWORD_VERIFICATION_TIMEOUT;
+          else
+            errnum = IPMI_ERR_SESSION_TIMEOUT;
+
+          _complete (s, NULL, errnum);
+          continue;
+        }
+
+      if (timeval_gt (&now, &s->retransmission_deadline))
+        {
+          s->retransmission_count++;
+          if (_send (s) < 0)
+            _complete (s, NULL, IPMI_ERR_INTERNAL_ERROR);
+        }
+    }
+}
+
+/* milliseconds until the next retransmission or session timeout */
+static unsigned int
+_engine_next_timeout (unsigned int timeout)
+{
+  struct timeval now;
+  unsigned int i;
+
+  if (!engine_sessions_active)
+    return (timeout);
+
+  if (gettimeofday (&now, NULL) < 0)
+    {
+      err_output ("gettimeofday: %s", strerror (errno));
+      return (0);
+    }
+
+  for (i = 0; i < engine_sessions_len; i++)
+    {
+      struct ipmiseld_engine_session *s = &engine_sessions[i];
+      struct timeval *deadline;
+      struct timeval delta;
+      unsigned int ms;
+
+      if (!s->host_data)
+        continue;
+
+      if (timeval_lt (&s->retransmission_deadline, &s->session_deadline))
+        deadline = &s->retransmission_deadline;
+      else
+        deadline = &s->session_deadline;
+
+      if (!timeval_gt (deadline, &now))
+        return (0);
+
+      timeval_sub (deadline, &now, &delta);
+      timeval_millisecond_calc (&delta, &ms);
+      /* round up, do not wake up just before the deadline */
+      ms++;
+      if (ms < timeout)
+        timeout = ms;
+    }
+
+  return (timeout);
+}
+
+int
+ipmiseld_engine_process (unsigned int timeout)
+{
+  struct pollfd pfds[2];
+  unsigned int nfds = 0;
+  unsigned int i;
+
+  assert (engine_sessions);
+
+  if (engine_fd4 >= 0)
+    {
+      pfds[nfds].fd = engine_fd4;
+      pfds[nfds].events = POLLIN;
+      pfds[nfds].revents = 0;
+      nfds++;
+    }
+
+  if (engine_fd6 >= 0)
+    {
+      pfds[nfds].fd = engine_fd6;
+      pfds[nfds].events = POLLIN;
+      pfds[nfds].revents = 0;
+      nfds++;
+    }
+
+  timeout = _engine_next_timeout (timeout);
+
+  if (poll (pfds, nfds, timeout) < 0)
+    {
+      if (errno == EINTR)
+        return (0);
+      err_output ("poll: %s", strerror (errno));
+      return (-1);
+    }
+
+  for (i = 0; i < nfds; i++)
+    {
+      if (pfds[i].revents & POLLIN)
+        _engine_recv (pfds[i].fd);
+    }
+
+  _engine_timeouts ();
+  return (0);
+}
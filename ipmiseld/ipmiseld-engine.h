@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMISELD_ENGINE_H
+#define IPMISELD_ENGINE_H
+
+#include <freeipmi/freeipmi.h>
+
+#include "ipmiseld.h"
+
+/* The async engine checks the SEL info of many hosts from a single
+ * thread.  Sessions are set up and the Get SEL Info command is sent
+ * by non-blocking state machines driven from one event loop, so a
+ * host only needs a thread from the threadpool when there is
+ * something to read or clear in its SEL.
+ *
+ * The engine is not thread safe, all functions must be called from
+ * the same thread.
+ */
+
+/* Called when a host submitted to the engine is done.  On success
+ * obj_cmd_rs is the Get SEL Info response and errnum is 0.  On
+ * failure obj_cmd_rs is NULL and errnum is the IPMI_ERR_* reason.
+ * obj_cmd_rs is only valid until the callback returns.
+ */
+typedef void (*IpmiSeldEngineCallback)(ipmiseld_host_data_t *host_data,
+                                       fiid_obj_t obj_cmd_rs,
+                                       int errnum);
+
+int ipmiseld_engine_init (struct ipmiseld_prog_data *prog_data,
+                          IpmiSeldEngineCallback callback);
+
+void ipmiseld_engine_destroy (void);
+
+/* Returns 1 if the engine will get the host's SEL info, 0 if the
+ * host cannot be handled by the engine right now (it should be
+ * polled through the threadpool instead), -1 on error.
+ */
+int ipmiseld_engine_submit (ipmiseld_host_data_t *host_data);
+
+/* Returns 1 if all sessions are in use, 0 if not */
+int ipmiseld_engine_full (void);
+
+/* Receives responses, retransmits, and times out sessions, waiting
+ * at most timeout milliseconds for a response.  Callbacks are called
+ * from here.  Returns 0 on success, -1 on error.
+ */
+int ipmiseld_engine_process (unsigned int timeout);
+
+/* Frees per host data kept by the engine across polls */
+void ipmiseld_engine_host_destroy (struct ipmiseld_engine_host *engine_host);
+
+#endif /* IPMISELD_ENGINE_H */
@@ -34,6 +34,7 @@
 #include <stdarg.h>
 #endif /* STDC_HEADERS */
 #include <syslog.h>
+#include <pthread.h>
 #include <assert.h>
 #include <errno.h>
 
@@ -41,6 +42,7 @@
 
 #include "ipmiseld.h"
 #include "ipmiseld-common.h"
+#include "ipmiseld-debug.h"
 #include "ipmiseld-ipmi-communication.h"
 
 #include "freeipmi-portability.h"
@@ -48,14 +50,20 @@
 #include "network.h"
 #include "tool-util-common.h"
 
+#define IPMISELD_KEEPALIVE_BUFLEN 64
+
+/* sessions currently kept open between polls */
+static unsigned int sessions_kept = 0;
+static pthread_mutex_t sessions_kept_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static void
-_last_errnum_manage (ipmiseld_host_data_t *host_data)
+_last_errnum_manage (ipmiseld_host_data_t *host_data, int errnum)
 {
   assert (host_data);
 
-  if (host_data->last_ipmi_errnum != ipmi_ctx_errnum (host_data->host_poll->ipmi_ctx))
+  if (host_data->last_ipmi_errnum != errnum)
     {
-      host_data->last_ipmi_errnum = ipmi_ctx_errnum (host_data->host_poll->ipmi_ctx);
+      host_data->last_ipmi_errnum = errnum;
       host_data->last_ipmi_errnum_count = 1;
     }
   else
@@ -69,6 +77,41 @@ _last_errnum_manage (ipmiseld_host_data_t *host_data)
     }
 }
 
+static int
+_ipmi_outofband (ipmiseld_host_data_t *host_data)
+{
+  assert (host_data);
+
+  return (host_data->hostname && !host_is_localhost (host_data->hostname));
+}
+
+/* A session libfreeipmi would consider timed out is not reused */
+static int
+_session_reusable (ipmiseld_host_data_t *host_data)
+{
+  unsigned int session_timeout;
+  time_t now;
+
+  assert (host_data);
+  assert (host_data->host_poll->ipmi_ctx_open);
+
+  if (!_ipmi_outofband (host_data))
+    return (1);
+
+  if (!host_data->prog_data->session_reuse)
+    return (0);
+
+  if (host_data->prog_data->args->common_args.session_timeout)
+    session_timeout = host_data->prog_data->args->common_args.session_timeout;
+  else
+    session_timeout = IPMI_SESSION_TIMEOUT_DEFAULT;
+
+  now = time (NULL);
+
+  /* session timeout is in milliseconds, round idle time up */
+  return (((now - host_data->host_poll->last_activity + 1) * 1000) < session_timeout);
+}
+
 int
 ipmiseld_ipmi_setup (ipmiseld_host_data_t *host_data)
 {
@@ -81,19 +124,54 @@ ipmiseld_ipmi_setup (ipmiseld_host_data_t *host_data)
 
   common_args = &(host_data->prog_data->args->common_args);
 
-  if (!(host_data->host_poll->ipmi_ctx = ipmi_ctx_create ()))
+  if (host_data->host_poll->ipmi_ctx_open)
+    {
+      if (_session_reusable (host_data))
+        return (0);
+
+      if (common_args->debug)
+        IPMISELD_HOST_DEBUG (("Session idle too long - re-opening"));
+
+      ipmiseld_ipmi_close (host_data);
+    }
+
+  if (!host_data->host_poll->ipmi_ctx)
     {
-      ipmiseld_err_output (host_data, "ipmi_ctx_create: %s", strerror (errno));
-      goto cleanup;
+      if (!(host_data->host_poll->ipmi_ctx = ipmi_ctx_create ()))
+        {
+          ipmiseld_err_output (host_data, "ipmi_ctx_create: %s", strerror (errno));
+          goto cleanup;
+        }
     }
 
-  if (host_data->hostname && !host_is_localhost (host_data->hostname))
+  if (_ipmi_outofband (host_data))
     {
       if (common_args->driver_type == IPMI_DEVICE_LAN_2_0)
         {
           parse_get_freeipmi_outofband_2_0_flags (common_args->workaround_flags_outofband_2_0,
                                                   &workaround_flags);
 
+          if (common_args->capability_cache_directory
+              && ipmi_ctx_set_capability_cache (host_data->host_poll->ipmi_ctx,
+                                                common_args->capability_cache_directory,
+                                                0) < 0)
+            {
+              ipmiseld_err_output (host_data,
+                                   "ipmi_ctx_set_capability_cache: %s",
+                                   ipmi_ctx_errormsg (host_data->host_poll->ipmi_ctx));
+              goto cleanup;
+            }
+
+          if (common_args->session_broker
+              && ipmi_ctx_set_session_broker (host_data->host_poll->ipmi_ctx,
+                                              common_args->session_broker) < 0)
+            {
+              ipmiseld_err_output (host_data,
+                                   "ipmi_ctx_set_session_broker: %s",
+                                   ipmi_ctx_errormsg (host_data->host_poll->ipmi_ctx));
+              goto cleanup;
+            }
+
           if (ipmi_ctx_open_outofband_2_0 (host_data->host_poll->ipmi_ctx,
                                            host_data->hostname,
                                            common_args->username,
@@ -130,7 +208,7 @@ ipmiseld_ipmi_setup (ipmiseld_host_data_t *host_data)
                                          ipmi_ctx_errormsg (host_data->host_poll->ipmi_ctx));
                 }
 
-              _last_errnum_manage (host_data);
+              _last_errnum_manage (host_data, ipmi_ctx_errnum (host_data->host_poll->ipmi_ctx));
 
               goto cleanup;
             }
@@ -169,7 +247,7 @@ ipmiseld_ipmi_setup (ipmiseld_host_data_t *host_data)
                                          ipmi_ctx_errormsg (host_data->host_poll->ipmi_ctx));
                 }
 
-              _last_errnum_manage (host_data);
+              _last_errnum_manage (host_data, ipmi_ctx_errnum (host_data->host_poll->ipmi_ctx));
 
               goto cleanup;
             }
@@ -214,7 +292,7 @@ ipmiseld_ipmi_setup (ipmiseld_host_data_t *host_data)
                                          ipmi_ctx_errormsg (host_data->host_poll->ipmi_ctx));
                 }
 
-              _last_errnum_manage (host_data);
+              _last_errnum_manage (host_data, ipmi_ctx_errnum (host_data->host_poll->ipmi_ctx));
 
               goto cleanup;
             }
@@ -253,7 +331,7 @@ ipmiseld_ipmi_setup (ipmiseld_host_data_t *host_data)
                                          ipmi_ctx_errormsg (host_data->host_poll->ipmi_ctx));
                 }
 
-              _last_errnum_manage (host_data);
+              _last_errnum_manage (host_data, ipmi_ctx_errnum (host_data->host_poll->ipmi_ctx));
 
               goto cleanup;
             }
@@ -274,12 +352,138 @@ ipmiseld_ipmi_setup (ipmiseld_host_data_t *host_data)
         }
     }
 
-  rv = 0;
+  host_data->host_poll->ipmi_ctx_open = 1;
+  host_data->host_poll->last_activity = time (NULL);
+  rv = 1;
  cleanup:
   if (rv < 0)
     {
+      /* ignore potential error, cleanup path */
       ipmi_ctx_close (host_data->host_poll->ipmi_ctx);
-      ipmi_ctx_destroy (host_data->host_poll->ipmi_ctx);
     }
   return (rv);
 }
+
+int
+ipmiseld_ipmi_connect_error (ipmiseld_host_data_t *host_data, int errnum)
+{
+  assert (host_data);
+
+  if (errnum != IPMI_ERR_USERNAME_INVALID
+      && errnum != IPMI_ERR_PASSWORD_INVALID
+      && errnum != IPMI_ERR_K_G_INVALID
+      && errnum != IPMI_ERR_PRIVILEGE_LEVEL_INSUFFICIENT
+      && errnum != IPMI_ERR_PRIVILEGE_LEVEL_CANNOT_BE_OBTAINED
+      && errnum != IPMI_ERR_CIPHER_SUITE_ID_UNAVAILABLE
+      && errnum != IPMI_ERR_AUTHENTICATION_TYPE_UNAVAILABLE
+      && errnum != IPMI_ERR_PASSWORD_VERIFICATION_TIMEOUT
+      && errnum != IPMI_ERR_IPMI_2_0_UNAVAILABLE
+      && errnum != IPMI_ERR_CONNECTION_TIMEOUT
+      && errnum != IPMI_ERR_SESSION_TIMEOUT)
+    return (0);
+
+  if (host_data->last_ipmi_errnum != errnum
+      || host_data->prog_data->args->verbose_count)
+    ipmiseld_err_output (host_data,
+                         "Error connecting: %s",
+                         ipmi_ctx_strerror (errnum));
+
+  _last_errnum_manage (host_data, errnum);
+  return (1);
+}
+
+void
+ipmiseld_ipmi_close (ipmiseld_host_data_t *host_data)
+{
+  assert (host_data);
+  assert (host_data->host_poll);
+
+  if (!host_data->host_poll->ipmi_ctx_open)
+    return;
+
+  /* ignore potential error, session may already be gone */
+  ipmi_ctx_close (host_data->host_poll->ipmi_ctx);
+  host_data->host_poll->ipmi_ctx_open = 0;
+
+  if (host_data->host_poll->ipmi_ctx_kept)
+    {
+      pthread_mutex_lock (&sessions_kept_lock);
+      sessions_kept--;
+      pthread_mutex_unlock (&sessions_kept_lock);
+      host_data->host_poll->ipmi_ctx_kept = 0;
+    }
+
+  /* BMC may have been reset/updated, re-check everything learned
+   * over the session on the next one.
+   */
+  if (host_data->host_poll->sdr_cache_open)
+    {
+      /* ignore potential error, cleanup path */
+      ipmi_sdr_cache_close (host_data->host_poll->sdr_ctx);
+      host_data->host_poll->sdr_cache_open = 0;
+    }
+  host_data->host_poll->oem_data_loaded = 0;
+}
+
+int
+ipmiseld_ipmi_keep (ipmiseld_host_data_t *host_data)
+{
+  int rv = 0;
+
+  assert (host_data);
+  assert (host_data->host_poll);
+  assert (host_data->host_poll->ipmi_ctx_open);
+
+  if (host_data->host_poll->ipmi_ctx_kept)
+    return (1);
+
+  pthread_mutex_lock (&sessions_kept_lock);
+  if (sessions_kept < host_data->prog_data->session_reuse_max)
+    {
+      sessions_kept++;
+      host_data->host_poll->ipmi_ctx_kept = 1;
+      rv = 1;
+    }
+  pthread_mutex_unlock (&sessions_kept_lock);
+
+  return (rv);
+}
+
+int
+ipmiseld_ipmi_keepalive (ipmiseld_host_data_t *host_data)
+{
+  uint8_t buf_rq[1];
+  uint8_t buf_rs[IPMISELD_KEEPALIVE_BUFLEN];
+
+  assert (host_data);
+  assert (host_data->host_poll);
+
+  if (!host_data->host_poll->ipmi_ctx_open)
+    return (0);
+
+  if (!_session_reusable (host_data))
+    {
+      ipmiseld_ipmi_close (host_data);
+      return (0);
+    }
+
+  buf_rq[0] = IPMI_CMD_GET_DEVICE_ID;
+
+  if (ipmi_cmd_raw (host_data->host_poll->ipmi_ctx,
+                    IPMI_BMC_IPMB_LUN_BMC,
+                    IPMI_NET_FN_APP_RQ,
+                    buf_rq,
+                    1,
+                    buf_rs,
+                    IPMISELD_KEEPALIVE_BUFLEN) < 0)
+    {
+      if (host_data->prog_data->args->common_args.debug)
+        IPMISELD_HOST_DEBUG (("keepalive: %s",
+                              ipmi_ctx_errormsg (host_data->host_poll->ipmi_ctx)));
+      ipmiseld_ipmi_close (host_data);
+      return (-1);
+    }
+
+  host_data->host_poll->last_activity = time (NULL);
+  return (0);
+}
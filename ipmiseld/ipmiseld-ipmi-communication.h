@@ -28,6 +28,30 @@
 
 #include "ipmiseld.h"
 
+/* Reuses the host's session if it is still open, otherwise opens
+ * one.  Returns 1 if a session was opened, 0 if reused, -1 on error.
+ */
 int ipmiseld_ipmi_setup (ipmiseld_host_data_t *host_data);
 
+/* Outputs errors from sessions set up outside of the ipmi context,
+ * e.g. by the async engine, like ipmiseld_ipmi_setup() would.
+ * Returns 1 if errnum is a connection error and was handled, 0 if
+ * not.
+ */
+int ipmiseld_ipmi_connect_error (ipmiseld_host_data_t *host_data, int errnum);
+
+/* closes the session, the ipmi context is kept */
+void ipmiseld_ipmi_close (ipmiseld_host_data_t *host_data);
+
+/* Returns 1 if the open session may be kept open until the next
+ * poll, 0 if as many sessions as allowed are already kept open.
+ */
+int ipmiseld_ipmi_keep (ipmiseld_host_data_t *host_data);
+
+/* Keeps an open session from timing out.  Returns 0 on success or if
+ * there is no session, -1 on error, in which case the session is
+ * closed.
+ */
+int ipmiseld_ipmi_keepalive (ipmiseld_host_data_t *host_data);
+
 #endif /* IPMISELD_IPMI_COMMUNICATION_H */
@@ -0,0 +1,738 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+#include <sys/param.h>          /* MAXPATHLEN */
+#include <syslog.h>
+#include <pthread.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "ipmiseld.h"
+#include "ipmiseld-output.h"
+
+#include "freeipmi-portability.h"
+#include "error.h"
+#include "fd.h"
+#include "list.h"
+#include "timeval.h"
+
+#ifndef MAXPATHLEN
+#define MAXPATHLEN 4096
+#endif /* MAXPATHLEN */
+
+#define IPMISELD_OUTPUT_BUFLEN          2048
+
+#define IPMISELD_OUTPUT_TIME_BUFLEN     64
+
+/* milliseconds to wait on a full queue before dropping output */
+#define IPMISELD_OUTPUT_QUEUE_WAIT      1000
+
+/* seconds to wait on a socket receiver before dropping output */
+#define IPMISELD_OUTPUT_SOCKET_TIMEOUT  5
+
+static ipmiseld_prog_data_t *output_prog_data = NULL;
+
+static pthread_t output_tid;
+static int output_thread_running = 0;
+static int output_exit_flag = 0;
+
+/* Queued lines are moved to output_batch and written without the
+ * lock.  After a wait on a full queue times out, output is dropped
+ * without waiting until the queue is emptied, so polling is only
+ * slowed once when the sink falls behind.
+ */
+static List output_queue = NULL;
+static List output_batch = NULL;
+static pthread_mutex_t output_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t output_queue_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t output_queue_not_full = PTHREAD_COND_INITIALIZER;
+static int output_queue_overflow = 0;
+static unsigned int output_dropped = 0;
+static unsigned int output_dropped_reported = 0;
+
+/* only used by the output thread after initialization */
+static int output_fd = -1;
+static off_t output_file_size = 0;
+static int output_sink_error = 0;
+
+static int
+_output_file_open (void)
+{
+  struct stat statbuf;
+
+  assert (output_prog_data);
+  assert (output_prog_data->args->output_path);
+  assert (output_fd < 0);
+
+  if ((output_fd = open (output_prog_data->args->output_path,
+                         O_WRONLY | O_APPEND | O_CREAT,
+                         0644)) < 0)
+    {
+      err_output ("Error opening '%s': %s",
+                  output_prog_data->args->output_path,
+                  strerror (errno));
+      return (-1);
+    }
+
+  if (fstat (output_fd, &statbuf) < 0)
+    {
+      err_output ("fstat: %s", strerror (errno));
+      /* ignore potential error, error path */
+      close (output_fd);
+      output_fd = -1;
+      return (-1);
+    }
+
+  output_file_size = statbuf.st_size;
+  return (0);
+}
+
+/* path.N-1 -> path.N, ..., path -> path.1 */
+static int
+_output_file_rotate (void)
+{
+  char *path;
+  char from[MAXPATHLEN + 1];
+  char to[MAXPATHLEN + 1];
+  unsigned int i;
+
+  assert (output_prog_data);
+
+  path = output_prog_data->args->output_path;
+
+  /* ignore potential error, reopened below */
+  close (output_fd);
+  output_fd = -1;
+
+  for (i = output_prog_data->args->output_rotate_count; i > 0; i--)
+    {
+      memset (from, '\0', MAXPATHLEN + 1);
+      memset (to, '\0', MAXPATHLEN + 1);
+
+      if (i > 1)
+        snprintf (from, MAXPATHLEN, "%s.%u", path, i - 1);
+      else
+        snprintf (from, MAXPATHLEN, "%s", path);
+      snprintf (to, MAXPATHLEN, "%s.%u", path, i);
+
+      if (rename (from, to) < 0 && errno != ENOENT)
+        err_output ("Error renaming '%s': %s", from, strerror (errno));
+    }
+
+  return (_output_file_open ());
+}
+
+static int
+_output_socket_connect (void)
+{
+  struct sockaddr_un addr;
+  struct timeval tv;
+
+  assert (output_prog_data);
+  assert (output_prog_data->args->output_path);
+  assert (output_fd < 0);
+
+  if ((output_fd = socket (AF_UNIX, SOCK_DGRAM, 0)) < 0)
+    {
+      err_output ("socket: %s", strerror (errno));
+      return (-1);
+    }
+
+  /* a stuck receiver applies backpressure, but not forever */
+  tv.tv_sec = IPMISELD_OUTPUT_SOCKET_TIMEOUT;
+  tv.tv_usec = 0;
+  if (setsockopt (output_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv)) < 0)
+    {
+      err_output ("setsockopt: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  memset (&addr, '\0', sizeof (struct sockaddr_un));
+  addr.sun_family = AF_UNIX;
+  /* length checked when arguments are parsed */
+  strcpy (addr.sun_path, output_prog_data->args->output_path);
+
+  if (connect (output_fd, (struct sockaddr *)&addr, sizeof (struct sockaddr_un)) < 0)
+    {
+      if (!output_sink_error)
+        err_output ("Error connecting to '%s': %s",
+                    output_prog_data->args->output_path,
+                    strerror (errno));
+      output_sink_error = 1;
+      goto cleanup;
+    }
+
+  return (0);
+
+ cleanup:
+  /* ignore potential error, error path */
+  close (output_fd);
+  output_fd = -1;
+  return (-1);
+}
+
+static void
+_output_sink_error (const char *str, int errnum)
+{
+  assert (str);
+
+  /* output once, not for every line while the sink is down */
+  if (!output_sink_error)
+    err_output ("%s: %s", str, strerror (errnum));
+  output_sink_error = 1;
+}
+
+/* returns number of lines dropped */
+static unsigned int
+_output_write_file (List batch)
+{
+  char *buf = NULL;
+  unsigned int buflen = 0;
+  unsigned int count;
+  ListIterator itr = NULL;
+  char *line;
+  int n;
+
+  assert (batch);
+
+  count = list_count (batch);
+
+  if (output_fd < 0
+      && _output_file_open () < 0)
+    return (count);
+
+  if (!(itr = list_iterator_create (batch)))
+    {
+      err_output ("list_iterator_create: %s", strerror (errno));
+      return (count);
+    }
+
+  while ((line = list_next (itr)))
+    buflen += strlen (line) + 1;
+
+  if (!(buf = (char *)malloc (buflen)))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      list_iterator_destroy (itr);
+      return (count);
+    }
+
+  buflen = 0;
+  list_iterator_reset (itr);
+  while ((line = list_next (itr)))
+    {
+      unsigned int len = strlen (line);
+
+      memcpy (buf + buflen, line, len);
+      buf[buflen + len] = '\n';
+      buflen += len + 1;
+    }
+  list_iterator_destroy (itr);
+
+  if (output_prog_data->args->output_rotate_size
+      && output_file_size
+      && (output_file_size + buflen) > output_prog_data->args->output_rotate_size)
+    {
+      if (_output_file_rotate () < 0)
+        {
+          free (buf);
+          return (count);
+        }
+    }
+
+  /* one write per batch */
+  if ((n = fd_write_n (output_fd, buf, buflen)) < 0)
+    {
+      _output_sink_error ("fd_write_n", errno);
+      free (buf);
+      return (count);
+    }
+
+  output_file_size += n;
+  output_sink_error = 0;
+  free (buf);
+  return (0);
+}
+
+static int
+_output_exiting (void)
+{
+  int rv;
+
+  pthread_mutex_lock (&output_queue_lock);
+  rv = output_exit_flag;
+  pthread_mutex_unlock (&output_queue_lock);
+  return (rv);
+}
+
+static unsigned int
+_output_write_socket (List batch)
+{
+  unsigned int dropped = 0;
+  char *line;
+
+  assert (batch);
+
+  while ((line = list_dequeue (batch)))
+    {
+      int flags = 0;
+      int errnum;
+
+      if (output_fd < 0
+          && _output_socket_connect () < 0)
+        {
+          /* no receiver, don't try again for every line */
+          dropped += list_count (batch) + 1;
+          free (line);
+          break;
+        }
+
+      /* don't wait on a stuck receiver when exiting */
+      if (_output_exiting ())
+        flags = MSG_DONTWAIT;
+
+      /* one datagram per line */
+      if (send (output_fd, line, strlen (line), flags) < 0)
+        {
+          errnum = errno;
+          _output_sink_error ("send", errnum);
+          dropped++;
+          free (line);
+
+          if (errnum == ENOBUFS)
+            continue;
+
+          /* The receiver went away, or timed out and is stuck.  Don't
+           * wait on it again for each remaining line, drop the rest of
+           * the batch and reconnect with the next one.
+           */
+          dropped += list_count (batch);
+
+          /* ignore potential error, reconnecting */
+          close (output_fd);
+          output_fd = -1;
+          break;
+        }
+
+      output_sink_error = 0;
+      free (line);
+    }
+
+  return (dropped);
+}
+
+static unsigned int
+_output_write_syslog (List batch)
+{
+  char *line;
+
+  assert (batch);
+
+  while ((line = list_dequeue (batch)))
+    {
+      syslog (output_prog_data->log_priority, "%s", line);
+      free (line);
+    }
+
+  return (0);
+}
+
+static unsigned int
+_output_write (List batch)
+{
+  unsigned int dropped;
+  char *line;
+
+  assert (batch);
+
+  if (output_prog_data->output_sink == IPMISELD_OUTPUT_SINK_FILE)
+    dropped = _output_write_file (batch);
+  else if (output_prog_data->output_sink == IPMISELD_OUTPUT_SINK_SOCKET)
+    dropped = _output_write_socket (batch);
+  else
+    dropped = _output_write_syslog (batch);
+
+  /* lines left by the file sink or a failed write */
+  while ((line = list_dequeue (batch)))
+    free (line);
+
+  return (dropped);
+}
+
+static void
+_output_format_time (char *buf, unsigned int buflen)
+{
+  struct tm tm;
+  time_t t;
+
+  assert (buf);
+  assert (buflen);
+
+  t = time (NULL);
+  localtime_r (&t, &tm);
+  strftime (buf, buflen, "%Y-%m-%dT%H:%M:%S%z", &tm);
+}
+
+/* key=value values are quoted, quotes and backslashes are escaped */
+static void
+_output_format_keyvalue_str (char *buf,
+                             unsigned int buflen,
+                             unsigned int *offset,
+                             const char *str)
+{
+  const char *ptr;
+
+  assert (buf);
+  assert (offset);
+  assert (str);
+
+  if (*offset < buflen)
+    buf[(*offset)++] = '"';
+
+  for (ptr = str; *ptr && *offset < (buflen - 2); ptr++)
+    {
+      if (*ptr == '"' || *ptr == '\\')
+        buf[(*offset)++] = '\\';
+      if (*ptr == '\n' || *ptr == '\r')
+        buf[(*offset)++] = ' ';
+      else
+        buf[(*offset)++] = *ptr;
+    }
+
+  if (*offset < buflen)
+    buf[(*offset)++] = '"';
+  buf[*offset < buflen ? *offset : buflen - 1] = '\0';
+}
+
+static void
+_output_format (ipmiseld_host_data_t *host_data,
+                int type,
+                uint16_t record_id,
+                const char *str,
+                char *buf,
+                unsigned int buflen)
+{
+  assert (host_data);
+  assert (type == IPMISELD_OUTPUT_TYPE_EVENT
+          || type == IPMISELD_OUTPUT_TYPE_STATUS);
+  assert (str);
+  assert (buf);
+  assert (buflen);
+
+  memset (buf, '\0', buflen);
+
+  if (host_data->prog_data->output_format == IPMISELD_OUTPUT_FORMAT_KEYVALUE)
+    {
+      char timebuf[IPMISELD_OUTPUT_TIME_BUFLEN + 1];
+      unsigned int offset;
+
+      memset (timebuf, '\0', IPMISELD_OUTPUT_TIME_BUFLEN + 1);
+      _output_format_time (timebuf, IPMISELD_OUTPUT_TIME_BUFLEN);
+
+      if (type == IPMISELD_OUTPUT_TYPE_EVENT)
+        snprintf (buf,
+                  buflen,
+                  "time=%s host=%s type=event record_id=%u msg=",
+                  timebuf,
+                  host_data->hostname ? host_data->hostname : "localhost",
+                  record_id);
+      else
+        snprintf (buf,
+                  buflen,
+                  "time=%s host=%s type=status msg=",
+                  timebuf,
+                  host_data->hostname ? host_data->hostname : "localhost");
+
+      offset = strlen (buf);
+      _output_format_keyvalue_str (buf, buflen, &offset, str);
+    }
+  else
+    {
+      /* event format strings include the hostname if wanted */
+      if (type == IPMISELD_OUTPUT_TYPE_STATUS
+          && host_data->hostname)
+        snprintf (buf, buflen, "%s: %s", host_data->hostname, str);
+      else
+        snprintf (buf, buflen, "%s", str);
+    }
+}
+
+static void *
+_output_thread (void *arg)
+{
+  while (1)
+    {
+      unsigned int dropped;
+      List tmp;
+
+      pthread_mutex_lock (&output_queue_lock);
+
+      while (!list_count (output_queue)
+             && output_dropped == output_dropped_reported
+             && !output_exit_flag)
+        pthread_cond_wait (&output_queue_not_empty, &output_queue_lock);
+
+      if (!list_count (output_queue)
+          && output_dropped == output_dropped_reported
+          && output_exit_flag)
+        {
+          pthread_mutex_unlock (&output_queue_lock);
+          break;
+        }
+
+      tmp = output_queue;
+      output_queue = output_batch;
+      output_batch = tmp;
+      output_queue_overflow = 0;
+      pthread_cond_broadcast (&output_queue_not_full);
+
+      dropped = output_dropped - output_dropped_reported;
+      output_dropped_reported = output_dropped;
+
+      pthread_mutex_unlock (&output_queue_lock);
+
+      if (dropped)
+        {
+          char *line;
+
+          if (!(line = (char *)malloc (IPMISELD_OUTPUT_BUFLEN)))
+            err_output ("malloc: %s", strerror (errno));
+          else
+            {
+              if (output_prog_data->output_format == IPMISELD_OUTPUT_FORMAT_KEYVALUE)
+                {
+                  char timebuf[IPMISELD_OUTPUT_TIME_BUFLEN + 1];
+
+                  memset (timebuf, '\0', IPMISELD_OUTPUT_TIME_BUFLEN + 1);
+                  _output_format_time (timebuf, IPMISELD_OUTPUT_TIME_BUFLEN);
+
+                  snprintf (line,
+                            IPMISELD_OUTPUT_BUFLEN,
+                            "time=%s type=dropped count=%u",
+                            timebuf,
+                            dropped);
+                }
+              else
+                snprintf (line,
+                          IPMISELD_OUTPUT_BUFLEN,
+                          "%u log messages dropped, output is too slow or failed",
+                          dropped);
+              if (!list_prepend (output_batch, line))
+                {
+                  err_output ("list_prepend: %s", strerror (errno));
+                  free (line);
+                }
+            }
+        }
+
+      dropped = _output_write (output_batch);
+
+      if (dropped)
+        {
+          pthread_mutex_lock (&output_queue_lock);
+          output_dropped += dropped;
+          output_dropped_reported += dropped;
+          pthread_mutex_unlock (&output_queue_lock);
+        }
+    }
+
+  return (NULL);
+}
+
+int
+ipmiseld_output_init (ipmiseld_prog_data_t *prog_data)
+{
+  int ret;
+
+  assert (prog_data);
+  assert (!output_prog_data);
+
+  output_prog_data = prog_data;
+
+  /* output written directly, see ipmiseld_output() */
+  if (prog_data->args->test_run
+      || (prog_data->args->foreground
+          && prog_data->output_sink == IPMISELD_OUTPUT_SINK_SYSLOG))
+    return (0);
+
+  if (!(output_queue = list_create ((ListDelF)free)))
+    {
+      err_output ("list_create: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (!(output_batch = list_create ((ListDelF)free)))
+    {
+      err_output ("list_create: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  /* find configuration errors at startup, not on the first event */
+  if (prog_data->output_sink == IPMISELD_OUTPUT_SINK_FILE)
+    {
+      if (_output_file_open () < 0)
+        goto cleanup;
+    }
+
+  if ((ret = pthread_create (&output_tid, NULL, _output_thread, NULL)))
+    {
+      err_output ("pthread_create: %s", strerror (ret));
+      goto cleanup;
+    }
+  output_thread_running = 1;
+
+  return (0);
+
+ cleanup:
+  ipmiseld_output_fini ();
+  return (-1);
+}
+
+void
+ipmiseld_output (ipmiseld_host_data_t *host_data,
+                 int type,
+                 uint16_t record_id,
+                 const char *str)
+{
+  char *line = NULL;
+
+  assert (host_data);
+  assert (type == IPMISELD_OUTPUT_TYPE_EVENT
+          || type == IPMISELD_OUTPUT_TYPE_STATUS);
+  assert (str);
+
+  if (!(line = (char *)malloc (IPMISELD_OUTPUT_BUFLEN)))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      return;
+    }
+
+  _output_format (host_data, type, record_id, str, line, IPMISELD_OUTPUT_BUFLEN);
+
+  if (!output_thread_running)
+    {
+      if (host_data->prog_data->args->test_run
+          || host_data->prog_data->args->foreground)
+        printf ("%s\n", line);
+      else
+        syslog (host_data->prog_data->log_priority, "%s", line);
+      free (line);
+      return;
+    }
+
+  pthread_mutex_lock (&output_queue_lock);
+
+  if (!output_queue_overflow
+      && list_count (output_queue) >= host_data->prog_data->args->output_queue_length)
+    {
+      struct timespec ts;
+      struct timeval tv;
+
+      gettimeofday (&tv, NULL);
+      timeval_add_ms (&tv, IPMISELD_OUTPUT_QUEUE_WAIT, &tv);
+      ts.tv_sec = tv.tv_sec;
+      ts.tv_nsec = tv.tv_usec * 1000;
+
+      while (list_count (output_queue) >= host_data->prog_data->args->output_queue_length
+             && !output_queue_overflow)
+        {
+          if (pthread_cond_timedwait (&output_queue_not_full,
+                                      &output_queue_lock,
+                                      &ts) == ETIMEDOUT)
+            {
+              output_queue_overflow = 1;
+              break;
+            }
+        }
+    }
+
+  if (list_count (output_queue) >= host_data->prog_data->args->output_queue_length)
+    {
+      output_dropped++;
+      pthread_cond_signal (&output_queue_not_empty);
+      pthread_mutex_unlock (&output_queue_lock);
+      free (line);
+      return;
+    }
+
+  if (!list_append (output_queue, line))
+    {
+      err_output ("list_append: %s", strerror (errno));
+      output_dropped++;
+      free (line);
+    }
+
+  pthread_cond_signal (&output_queue_not_empty);
+  pthread_mutex_unlock (&output_queue_lock);
+}
+
+void
+ipmiseld_output_fini (void)
+{
+  if (output_thread_running)
+    {
+      pthread_mutex_lock (&output_queue_lock);
+      output_exit_flag = 1;
+      pthread_cond_signal (&output_queue_not_empty);
+      pthread_mutex_unlock (&output_queue_lock);
+
+      pthread_join (output_tid, NULL);
+      output_thread_running = 0;
+    }
+
+  if (output_dropped)
+    err_output ("%u log messages could not be output", output_dropped);
+
+  if (output_fd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (output_fd);
+      output_fd = -1;
+    }
+
+  if (output_queue)
+    {
+      list_destroy (output_queue);
+      output_queue = NULL;
+    }
+  if (output_batch)
+    {
+      list_destroy (output_batch);
+      output_batch = NULL;
+    }
+  output_prog_data = NULL;
+}
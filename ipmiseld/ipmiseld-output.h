@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMISELD_OUTPUT_H
+#define IPMISELD_OUTPUT_H
+
+#include <stdint.h>
+
+#include "ipmiseld.h"
+
+#define IPMISELD_OUTPUT_TYPE_EVENT  0
+#define IPMISELD_OUTPUT_TYPE_STATUS 1
+
+/* Output is queued and written to the output sink by a single
+ * thread, so polling threads do not wait on a slow log pipeline.
+ * When the queue is full, callers wait briefly and then drop output.
+ */
+int ipmiseld_output_init (ipmiseld_prog_data_t *prog_data);
+
+/* record_id only used with IPMISELD_OUTPUT_TYPE_EVENT */
+void ipmiseld_output (ipmiseld_host_data_t *host_data,
+                      int type,
+                      uint16_t record_id,
+                      const char *str);
+
+/* writes out all queued output */
+void ipmiseld_output_fini (void);
+
+#endif /* IPMISELD_OUTPUT_H */
@@ -43,8 +43,10 @@
 #include <time.h>
 #endif /* !HAVE_SYS_TIME_H */
 #endif /* !TIME_WITH_SYS_TIME */
+#include <sys/resource.h>
 #include <syslog.h>
 #include <pthread.h>
+#include <limits.h>
 #include <assert.h>
 #include <errno.h>
 
@@ -55,7 +57,9 @@
 #include "ipmiseld-cache.h"
 #include "ipmiseld-common.h"
 #include "ipmiseld-debug.h"
+#include "ipmiseld-engine.h"
 #include "ipmiseld-ipmi-communication.h"
+#include "ipmiseld-output.h"
 #include "ipmiseld-threadpool.h"
 
 #include "freeipmi-portability.h"
@@ -63,6 +67,7 @@
 #include "fi_hostlist.h"
 #include "heap.h"
 #include "pstdout.h"
+#include "timeval.h"
 #include "tool-common.h"
 #include "tool-daemon-common.h"
 #include "tool-event-common.h"
@@ -76,41 +81,34 @@
 
 #define IPMISELD_RETRY_ATTEMPT_MAX      3
 
+/* milliseconds, wake up to check for hosts due while idle */
+#define IPMISELD_ENGINE_PROCESS_TIMEOUT_MAX 1000
+
 static Heap host_data_heap = NULL;
 static pthread_mutex_t host_data_heap_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static int exit_flag = 1;
 
+/* earliest time the next host may be polled under the poll rate max */
+static struct timeval poll_rate_next;
+
+/* Also used on Get SEL Info responses from the async engine */
 static int
-ipmiseld_sel_info_get (ipmiseld_host_data_t *host_data, ipmiseld_sel_info_t *sel_info)
+_sel_info_parse (ipmiseld_host_data_t *host_data,
+                 fiid_obj_t obj_cmd_rs,
+                 ipmiseld_sel_info_t *sel_info)
 {
-  fiid_obj_t obj_cmd_rs = NULL;
   uint64_t val;
-  int rv = -1;
 
   assert (host_data);
-  assert (host_data->host_poll);
-  assert (host_data->host_poll->ipmi_ctx);
+  assert (obj_cmd_rs);
   assert (sel_info);
 
-  if (!(obj_cmd_rs = fiid_obj_create (tmpl_cmd_get_sel_info_rs)))
-    {
-      ipmiseld_err_output (host_data, "fiid_obj_create: %s", strerror (errno));
-      goto cleanup;
-    }
-
-  if (ipmi_cmd_get_sel_info (host_data->host_poll->ipmi_ctx, obj_cmd_rs) < 0)
-    {
-      ipmiseld_err_output (host_data, "ipmi_cmd_get_sel_info: %s",
-                  ipmi_ctx_errormsg (host_data->host_poll->ipmi_ctx));
-      goto cleanup;
-    }
-
   if (FIID_OBJ_GET (obj_cmd_rs, "entries", &val) < 0)
     {
       ipmiseld_err_output (host_data, "fiid_obj_get: 'entries': %s",
                   fiid_obj_errormsg (obj_cmd_rs));
-      goto cleanup;
+      return (-1);
     }
   sel_info->entries = val;
 
@@ -118,7 +116,7 @@ ipmiseld_sel_info_get (ipmiseld_host_data_t *host_data, ipmiseld_sel_info_t *sel
     {
       ipmiseld_err_output (host_data, "fiid_obj_get: 'free_space': %s",
                   fiid_obj_errormsg (obj_cmd_rs));
-      goto cleanup;
+      return (-1);
     }
   sel_info->free_space = val;
 
@@ -126,7 +124,7 @@ ipmiseld_sel_info_get (ipmiseld_host_data_t *host_data, ipmiseld_sel_info_t *sel
     {
       ipmiseld_err_output (host_data, "fiid_obj_get: 'most_recent_addition_timestamp': %s",
                   fiid_obj_errormsg (obj_cmd_rs));
-      goto cleanup;
+      return (-1);
     }
   sel_info->most_recent_addition_timestamp = val;
 
@@ -134,7 +132,7 @@ ipmiseld_sel_info_get (ipmiseld_host_data_t *host_data, ipmiseld_sel_info_t *sel
     {
       ipmiseld_err_output (host_data, "fiid_obj_get: 'most_recent_erase_timestamp': %s",
                   fiid_obj_errormsg (obj_cmd_rs));
-      goto cleanup;
+      return (-1);
     }
   sel_info->most_recent_erase_timestamp = val;
 
@@ -142,15 +140,15 @@ ipmiseld_sel_info_get (ipmiseld_host_data_t *host_data, ipmiseld_sel_info_t *sel
     {
       ipmiseld_err_output (host_data, "fiid_obj_get: 'delete_sel_command_supported': %s",
                   fiid_obj_errormsg (obj_cmd_rs));
-      goto cleanup;
+      return (-1);
     }
- sel_info->delete_sel_command_supported = val;
+  sel_info->delete_sel_command_supported = val;
 
   if (FIID_OBJ_GET (obj_cmd_rs, "reserve_sel_command_supported", &val) < 0)
     {
       ipmiseld_err_output (host_data, "fiid_obj_get: 'reserve_sel_command_supported': %s",
                   fiid_obj_errormsg (obj_cmd_rs));
-      goto cleanup;
+      return (-1);
     }
   sel_info->reserve_sel_command_supported = val;
 
@@ -158,10 +156,40 @@ ipmiseld_sel_info_get (ipmiseld_host_data_t *host_data, ipmiseld_sel_info_t *sel
     {
       ipmiseld_err_output (host_data, "fiid_obj_get: 'overflow_flag': %s",
                   fiid_obj_errormsg (obj_cmd_rs));
-      goto cleanup;
+      return (-1);
     }
   sel_info->overflow_flag = val;
 
+  return (0);
+}
+
+static int
+ipmiseld_sel_info_get (ipmiseld_host_data_t *host_data, ipmiseld_sel_info_t *sel_info)
+{
+  fiid_obj_t obj_cmd_rs = NULL;
+  int rv = -1;
+
+  assert (host_data);
+  assert (host_data->host_poll);
+  assert (host_data->host_poll->ipmi_ctx);
+  assert (sel_info);
+
+  if (!(obj_cmd_rs = fiid_obj_create (tmpl_cmd_get_sel_info_rs)))
+    {
+      ipmiseld_err_output (host_data, "fiid_obj_create: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (ipmi_cmd_get_sel_info (host_data->host_poll->ipmi_ctx, obj_cmd_rs) < 0)
+    {
+      ipmiseld_err_output (host_data, "ipmi_cmd_get_sel_info: %s",
+                  ipmi_ctx_errormsg (host_data->host_poll->ipmi_ctx));
+      goto cleanup;
+    }
+
+  if (_sel_info_parse (host_data, obj_cmd_rs, sel_info) < 0)
+    goto cleanup;
+
   rv = 0;
  cleanup:
   fiid_obj_destroy (obj_cmd_rs);
@@ -515,7 +543,7 @@ _sel_log_output (ipmiseld_host_data_t *host_data, uint8_t record_type)
     }
 
   if (outbuf_len)
-    ipmiseld_syslog (host_data, "%s", outbuf);
+    ipmiseld_output (host_data, IPMISELD_OUTPUT_TYPE_EVENT, record_id, outbuf);
 
   host_data->now_host_state.last_record_id.record_id = record_id;
 
@@ -523,17 +551,13 @@ _sel_log_output (ipmiseld_host_data_t *host_data, uint8_t record_type)
 }
 
 static int
-_sel_parse_callback (ipmi_sel_ctx_t ctx, void *callback_data)
+_sel_parse_record (ipmiseld_host_data_t *host_data)
 {
-  ipmiseld_host_data_t *host_data;
   uint8_t record_type;
   int record_type_class;
   int rv = -1;
 
-  assert (ctx);
-  assert (callback_data);
-
-  host_data = (ipmiseld_host_data_t *)callback_data;
+  assert (host_data);
 
   if (host_data->prog_data->args->sensor_types_length
       || host_data->prog_data->args->exclude_sensor_types_length)
@@ -660,6 +684,49 @@ _sel_parse_callback (ipmi_sel_ctx_t ctx, void *callback_data)
   return (rv);
 }
 
+static int
+_sel_parse_callback (ipmi_sel_ctx_t ctx, void *callback_data)
+{
+  ipmiseld_host_data_t *host_data;
+  int rv = -1;
+
+  assert (ctx);
+  assert (callback_data);
+
+  host_data = (ipmiseld_host_data_t *)callback_data;
+
+  /* The interpret context is shared by all hosts and both interpreting
+   * and string output modify its flags and OEM ids, so records are
+   * handled one at a time.
+   */
+  pthread_mutex_lock (&host_data->prog_data->interpret_ctx_lock);
+
+  if (host_data->host_poll->oem_data_loaded
+      && host_data->prog_data->args->interpret_oem_data)
+    {
+      if (ipmi_interpret_ctx_set_manufacturer_id (host_data->host_poll->interpret_ctx,
+                                                  host_data->host_poll->oem_data.manufacturer_id) < 0)
+        {
+          ipmiseld_err_output (host_data, "ipmi_interpret_ctx_set_manufacturer_id: %s",
+                      ipmi_interpret_ctx_errormsg (host_data->host_poll->interpret_ctx));
+          goto cleanup;
+        }
+
+      if (ipmi_interpret_ctx_set_product_id (host_data->host_poll->interpret_ctx,
+                                             host_data->host_poll->oem_data.product_id) < 0)
+        {
+          ipmiseld_err_output (host_data, "ipmi_interpret_ctx_set_product_id: %s",
+                      ipmi_interpret_ctx_errormsg (host_data->host_poll->interpret_ctx));
+          goto cleanup;
+        }
+    }
+
+  rv = _sel_parse_record (host_data);
+ cleanup:
+  pthread_mutex_unlock (&host_data->prog_data->interpret_ctx_lock);
+  return (rv);
+}
+
 static int
 ipmiseld_sel_parse_test_run (ipmiseld_host_data_t *host_data)
 {
@@ -1189,6 +1256,9 @@ ipmiseld_sel_parse_log (ipmiseld_host_data_t *host_data)
       _dump_sel_info (host_data, &host_data->now_host_state.sel_info, "Current State");
     }
 
+  if (host_data->now_host_state.sel_info.most_recent_addition_timestamp != host_data->last_host_state.sel_info.most_recent_addition_timestamp)
+    host_data->sel_activity = 1;
+
   if ((do_clear_flag = ipmiseld_check_thresholds (host_data)) < 0)
     goto cleanup;
 
@@ -1276,43 +1346,21 @@ ipmiseld_sel_parse (ipmiseld_host_data_t *host_data)
   return (rv);
 }
 
+/* sel context is created once per host, after the ipmi and sdr contexts */
 static int
-_ipmiseld_poll (void *arg)
+_ipmiseld_sel_ctx_create (ipmiseld_host_data_t *host_data)
 {
-  ipmiseld_host_data_t *host_data;
-  ipmiseld_host_poll_t host_poll;
   unsigned int sel_flags = 0;
-  unsigned int interpret_flags = 0;
-  int exit_code = EXIT_FAILURE;
-
-  assert (arg);
-
-  host_data = (ipmiseld_host_data_t *)arg;
-
-  assert (!host_data->host_poll);
 
-  if (host_data->prog_data->args->foreground
-      && host_data->prog_data->args->common_args.debug)
-    IPMISELD_DEBUG (("Poll %s", host_data->hostname ? host_data->hostname : "localhost"));
-
-  memset (&host_poll, '\0', sizeof (ipmiseld_host_poll_t));
-  host_data->host_poll = &host_poll;
-
-  if (ipmiseld_ipmi_setup (host_data) < 0)
-    goto cleanup;
-
-  if (!host_data->prog_data->args->ignore_sdr)
-    {
-      if (ipmiseld_sdr_cache_create_and_load (host_data) < 0)
-        goto cleanup;
-    }
-  else
-    host_data->host_poll->sdr_ctx = NULL;
+  assert (host_data);
+  assert (host_data->host_poll);
+  assert (host_data->host_poll->ipmi_ctx);
+  assert (!host_data->host_poll->sel_ctx);
 
   if (!(host_data->host_poll->sel_ctx = ipmi_sel_ctx_create (host_data->host_poll->ipmi_ctx, host_data->host_poll->sdr_ctx)))
     {
       ipmiseld_err_output (host_data, "ipmi_sel_ctx_create: %s", strerror (errno));
-      goto cleanup;
+      return (-1);
     }
 
   if (host_data->prog_data->args->foreground
@@ -1322,6 +1370,9 @@ _ipmiseld_poll (void *arg)
   if (host_data->prog_data->args->common_args.section_specific_workaround_flags & IPMI_PARSE_SECTION_SPECIFIC_WORKAROUND_FLAGS_ASSUME_SYSTEM_EVENT)
     sel_flags |= IPMI_SEL_FLAGS_ASSUME_SYTEM_EVENT_RECORDS;
 
+  /* Flags must be set before the interpret context is attached,
+   * otherwise they are copied into the shared interpret context.
+   */
   if (sel_flags)
     {
       /* Don't error out, if this fails we can still continue */
@@ -1339,120 +1390,180 @@ _ipmiseld_poll (void *arg)
                     ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
     }
 
-  if (!(host_data->host_poll->interpret_ctx = ipmi_interpret_ctx_create ()))
+  if (ipmi_sel_ctx_set_parameter (host_data->host_poll->sel_ctx,
+                                  IPMI_SEL_PARAMETER_INTERPRET_CONTEXT,
+                                  &(host_data->host_poll->interpret_ctx)) < 0)
     {
-      ipmiseld_err_output (host_data, "ipmi_interpret_ctx_create: %s", strerror (errno));
+      ipmiseld_err_output (host_data, "ipmi_sel_ctx_set_interpret: %s",
+                  ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
       goto cleanup;
     }
 
-  if (ipmi_interpret_load_sel_config (host_data->host_poll->interpret_ctx,
-                                      host_data->prog_data->args->event_state_config_file) < 0)
+  if (ipmi_sel_ctx_set_separator (host_data->host_poll->sel_ctx, EVENT_OUTPUT_SEPARATOR) < 0)
     {
-      /* if default file is missing its ok */
-      if (!(!host_data->prog_data->args->event_state_config_file
-            && ipmi_interpret_ctx_errnum (host_data->host_poll->interpret_ctx) == IPMI_INTERPRET_ERR_SEL_CONFIG_FILE_DOES_NOT_EXIST))
-        {
-          ipmiseld_err_output (host_data, "ipmi_interpret_load_sel_config: %s", ipmi_interpret_ctx_errormsg (host_data->host_poll->interpret_ctx));
-          goto cleanup;
-        }
+      ipmiseld_err_output (host_data, "ipmi_sel_ctx_set_separator: %s",
+                  ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
+      goto cleanup;
     }
 
-  if (host_data->prog_data->args->interpret_oem_data)
-    interpret_flags |= IPMI_INTERPRET_FLAGS_INTERPRET_OEM_DATA;
+  return (0);
 
-  if (interpret_flags)
+ cleanup:
+  ipmi_sel_ctx_destroy (host_data->host_poll->sel_ctx);
+  host_data->host_poll->sel_ctx = NULL;
+  return (-1);
+}
+
+static int
+_ipmiseld_oem_data_load (ipmiseld_host_data_t *host_data)
+{
+  int rv = -1;
+
+  assert (host_data);
+  assert (host_data->host_poll);
+  assert (host_data->host_poll->sel_ctx);
+
+  if (ipmi_get_oem_data (NULL,
+                         host_data->host_poll->ipmi_ctx,
+                         &host_data->host_poll->oem_data) < 0)
+    return (-1);
+
+  /* sel context passes these on to the shared interpret context */
+  pthread_mutex_lock (&host_data->prog_data->interpret_ctx_lock);
+
+  if (ipmi_sel_ctx_set_manufacturer_id (host_data->host_poll->sel_ctx,
+                                        host_data->host_poll->oem_data.manufacturer_id) < 0)
     {
-      if (ipmi_interpret_ctx_set_flags (host_data->host_poll->interpret_ctx, interpret_flags) < 0)
-        {
-          ipmiseld_err_output (host_data, "ipmi_interpret_ctx_set_flags: %s",
-                      ipmi_interpret_ctx_errormsg (host_data->host_poll->interpret_ctx));
-          goto cleanup;
-        }
+      ipmiseld_err_output (host_data, "ipmi_sel_ctx_set_manufacturer_id: %s",
+                  ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
+      goto cleanup;
     }
 
-  if (ipmi_sel_ctx_set_parameter (host_data->host_poll->sel_ctx,
-                                  IPMI_SEL_PARAMETER_INTERPRET_CONTEXT,
-                                  &(host_data->host_poll->interpret_ctx)) < 0)
+  if (ipmi_sel_ctx_set_product_id (host_data->host_poll->sel_ctx,
+                                   host_data->host_poll->oem_data.product_id) < 0)
     {
-      err_output("ipmi_sel_ctx_set_interpret: %s",
-                 ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
+      ipmiseld_err_output (host_data, "ipmi_sel_ctx_set_product_id: %s",
+                  ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
       goto cleanup;
     }
 
-  if (ipmi_sel_ctx_set_separator (host_data->host_poll->sel_ctx, EVENT_OUTPUT_SEPARATOR) < 0)
+  if (ipmi_sel_ctx_set_ipmi_version (host_data->host_poll->sel_ctx,
+                                     host_data->host_poll->oem_data.ipmi_version_major,
+                                     host_data->host_poll->oem_data.ipmi_version_minor) < 0)
     {
-      ipmiseld_err_output (host_data, "ipmi_sel_ctx_set_separator: %s",
+      ipmiseld_err_output (host_data, "ipmi_sel_ctx_set_ipmi_version: %s",
                   ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
-      return (-1);
+      goto cleanup;
     }
 
-  if (host_data->prog_data->args->interpret_oem_data
-      || host_data->prog_data->args->output_oem_event_strings)
+  host_data->host_poll->oem_data_loaded = 1;
+  rv = 0;
+ cleanup:
+  pthread_mutex_unlock (&host_data->prog_data->interpret_ctx_lock);
+  return (rv);
+}
+
+static int
+_ipmiseld_poll (void *arg)
+{
+  ipmiseld_host_data_t *host_data;
+  int exit_code = EXIT_FAILURE;
+
+  assert (arg);
+
+  host_data = (ipmiseld_host_data_t *)arg;
+
+  assert (host_data->host_poll);
+
+  if (host_data->keepalive)
     {
-      if (ipmi_get_oem_data (NULL,
-                             host_data->host_poll->ipmi_ctx,
-                             &host_data->host_poll->oem_data) < 0)
-        return (-1);
+      if (host_data->prog_data->args->foreground
+          && host_data->prog_data->args->common_args.debug)
+        IPMISELD_DEBUG (("Keepalive %s", host_data->hostname ? host_data->hostname : "localhost"));
 
-      if (ipmi_sel_ctx_set_manufacturer_id (host_data->host_poll->sel_ctx,
-                                            host_data->host_poll->oem_data.manufacturer_id) < 0)
-        {
-          ipmiseld_err_output (host_data, "ipmi_sel_ctx_set_manufacturer_id: %s",
-                      ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
-          return (-1);
-        }
+      if (ipmiseld_ipmi_keepalive (host_data) < 0)
+        return (EXIT_FAILURE);
+      return (EXIT_SUCCESS);
+    }
 
-      if (ipmi_sel_ctx_set_product_id (host_data->host_poll->sel_ctx,
-                                       host_data->host_poll->oem_data.product_id) < 0)
-        {
-          ipmiseld_err_output (host_data, "ipmi_sel_ctx_set_product_id: %s",
-                      ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
-          return (-1);
-        }
+  if (host_data->prog_data->args->foreground
+      && host_data->prog_data->args->common_args.debug)
+    IPMISELD_DEBUG (("Poll %s", host_data->hostname ? host_data->hostname : "localhost"));
 
-      if (ipmi_sel_ctx_set_ipmi_version (host_data->host_poll->sel_ctx,
-                                         host_data->host_poll->oem_data.ipmi_version_major,
-                                         host_data->host_poll->oem_data.ipmi_version_minor) < 0)
-        {
-          ipmiseld_err_output (host_data, "ipmi_sel_ctx_set_ipmi_version: %s",
-                      ipmi_sel_ctx_errormsg (host_data->host_poll->sel_ctx));
-          return (-1);
-        }
+  if (ipmiseld_ipmi_setup (host_data) < 0)
+    goto cleanup;
 
-      if (host_data->prog_data->args->interpret_oem_data)
-        {
-          if (ipmi_interpret_ctx_set_manufacturer_id (host_data->host_poll->interpret_ctx,
-                                                      host_data->host_poll->oem_data.manufacturer_id) < 0)
-            {
-              ipmiseld_err_output (host_data, "ipmi_interpret_ctx_set_manufacturer_id: %s",
-                          ipmi_interpret_ctx_errormsg (host_data->host_poll->interpret_ctx));
-              return (-1);
-            }
+  if (!host_data->prog_data->args->ignore_sdr)
+    {
+      if (ipmiseld_sdr_cache_create_and_load (host_data) < 0)
+        goto cleanup;
+    }
 
-          if (ipmi_interpret_ctx_set_product_id (host_data->host_poll->interpret_ctx,
-                                                 host_data->host_poll->oem_data.product_id) < 0)
-            {
-              ipmiseld_err_output (host_data, "ipmi_interpret_ctx_set_product_id: %s",
-                          ipmi_interpret_ctx_errormsg (host_data->host_poll->interpret_ctx));
-              return (-1);
-            }
-        }
+  if (!host_data->host_poll->sel_ctx)
+    {
+      if (_ipmiseld_sel_ctx_create (host_data) < 0)
+        goto cleanup;
+    }
+
+  if ((host_data->prog_data->args->interpret_oem_data
+       || host_data->prog_data->args->output_oem_event_strings)
+      && !host_data->host_poll->oem_data_loaded)
+    {
+      if (_ipmiseld_oem_data_load (host_data) < 0)
+        goto cleanup;
     }
 
   if (ipmiseld_sel_parse (host_data) < 0)
     goto cleanup;
 
+  host_data->host_poll->last_activity = time (NULL);
+
   exit_code = EXIT_SUCCESS;
  cleanup:
-  ipmi_interpret_ctx_destroy (host_data->host_poll->interpret_ctx);
-  ipmi_sel_ctx_destroy (host_data->host_poll->sel_ctx);
-  ipmi_sdr_ctx_destroy (host_data->host_poll->sdr_ctx);
-  ipmi_ctx_close (host_data->host_poll->ipmi_ctx);
-  ipmi_ctx_destroy (host_data->host_poll->ipmi_ctx);
-  host_data->host_poll = NULL;
+  /* On error, start over with a new session next time, it may be the
+   * cause of the error.  Otherwise keep it only if it is cheaper to
+   * keep alive than to re-open, and file descriptors allow.
+   */
+  if (exit_code != EXIT_SUCCESS
+      || !host_data->prog_data->session_reuse
+      || !ipmiseld_ipmi_keep (host_data))
+    ipmiseld_ipmi_close (host_data);
   return (exit_code);
 }
 
+/* Hosts with new SEL events or a SEL past the warning threshold are
+ * polled at the poll interval min.  Others back off, doubling their
+ * interval up to the poll interval max.  Hosts that fail to be polled
+ * back off too, so unreachable BMCs cost fewer timeouts.
+ */
+static void
+_ipmiseld_poll_interval_update (ipmiseld_host_data_t *host_data)
+{
+  struct ipmiseld_arguments *args;
+  unsigned int poll_interval;
+
+  assert (host_data);
+
+  args = host_data->prog_data->args;
+
+  if (host_data->sel_activity
+      || (args->warning_threshold
+          && host_data->last_host_state.last_percent_full > args->warning_threshold))
+    poll_interval = args->poll_interval_min;
+  else if (host_data->poll_interval > args->poll_interval_max / 2)
+    poll_interval = args->poll_interval_max;
+  else
+    poll_interval = host_data->poll_interval * 2;
+
+  if (poll_interval != host_data->poll_interval
+      && host_data->prog_data->args->foreground
+      && host_data->prog_data->args->common_args.debug)
+    IPMISELD_HOST_DEBUG (("poll interval = %u", poll_interval));
+
+  host_data->poll_interval = poll_interval;
+  host_data->sel_activity = 0;
+}
+
 static int
 _ipmiseld_poll_postprocess (void *arg)
 {
@@ -1464,10 +1575,37 @@ _ipmiseld_poll_postprocess (void *arg)
 
   host_data = (ipmiseld_host_data_t *)arg;
 
-  assert (!host_data->host_poll);
+  assert (host_data->host_poll);
 
   gettimeofday (&tv, NULL);
-  host_data->next_poll_time = tv.tv_sec + host_data->prog_data->args->poll_interval;
+
+  if (!host_data->keepalive)
+    {
+      _ipmiseld_poll_interval_update (host_data);
+      host_data->next_sel_poll_time = tv.tv_sec + host_data->poll_interval;
+    }
+
+  /* A host that backed off may need more keepalives than re-opening
+   * its session costs, see _ipmiseld_session_reuse_setup().
+   */
+  if (host_data->host_poll->ipmi_ctx_open
+      && host_data->prog_data->keepalive_interval
+      && host_data->next_sel_poll_time > tv.tv_sec
+      && ((host_data->next_sel_poll_time - tv.tv_sec - 1) / host_data->prog_data->keepalive_interval) > IPMISELD_KEEPALIVE_COUNT_MAX)
+    ipmiseld_ipmi_close (host_data);
+
+  if (host_data->host_poll->ipmi_ctx_open
+      && host_data->prog_data->keepalive_interval
+      && (tv.tv_sec + host_data->prog_data->keepalive_interval) < host_data->next_sel_poll_time)
+    {
+      host_data->next_poll_time = tv.tv_sec + host_data->prog_data->keepalive_interval;
+      host_data->keepalive = 1;
+    }
+  else
+    {
+      host_data->next_poll_time = host_data->next_sel_poll_time;
+      host_data->keepalive = 0;
+    }
 
   pthread_mutex_lock (&host_data_heap_lock);
 
@@ -1498,6 +1636,15 @@ _free_host_data (void *x)
   assert (x);
 
   host_data = (ipmiseld_host_data_t *)x;
+  if (host_data->host_poll)
+    {
+      ipmiseld_ipmi_close (host_data);
+      ipmi_sel_ctx_destroy (host_data->host_poll->sel_ctx);
+      ipmi_sdr_ctx_destroy (host_data->host_poll->sdr_ctx);
+      ipmi_ctx_destroy (host_data->host_poll->ipmi_ctx);
+      free (host_data->host_poll);
+    }
+  ipmiseld_engine_host_destroy (host_data->engine_host);
   free (host_data->hostname);
   free (host_data);
 }
@@ -1528,12 +1675,34 @@ _alloc_host_data (ipmiseld_prog_data_t *prog_data, const char *hostname)
     }
   else
     host_data->hostname = NULL;
-  host_data->host_poll = NULL;
+
+  if (!(host_data->host_poll = (ipmiseld_host_poll_t *) malloc (sizeof (ipmiseld_host_poll_t))))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      free (host_data->hostname);
+      free (host_data);
+      return (NULL);
+    }
+  memset (host_data->host_poll, '\0', sizeof (ipmiseld_host_poll_t));
+  host_data->host_poll->ipmi_ctx = NULL;
+  host_data->host_poll->ipmi_ctx_open = 0;
+  host_data->host_poll->ipmi_ctx_kept = 0;
+  host_data->host_poll->sdr_ctx = NULL;
+  host_data->host_poll->sdr_cache_open = 0;
+  host_data->host_poll->sel_ctx = NULL;
+  host_data->host_poll->interpret_ctx = prog_data->interpret_ctx;
+  host_data->host_poll->oem_data_loaded = 0;
+
   host_data->re_download_sdr_done = 0;
   host_data->clear_sel_done = 0;
   host_data->next_poll_time = 0; /* 0 will first immediate check first time through */
+  host_data->next_sel_poll_time = 0;
+  host_data->poll_interval = prog_data->args->poll_interval;
+  host_data->sel_activity = 0;
+  host_data->keepalive = 0;
   host_data->last_ipmi_errnum = 0;
   host_data->last_ipmi_errnum_count = 0;
+  host_data->engine_host = NULL;
 
   return (host_data);
 }
@@ -1556,6 +1725,441 @@ hostdata_timecmp (void *x, void *y)
   return (0);
 }
 
+/* One interpret context is shared by all hosts, see
+ * _sel_parse_callback().
+ */
+static int
+_ipmiseld_interpret_ctx_create (ipmiseld_prog_data_t *prog_data)
+{
+  unsigned int interpret_flags = 0;
+  int ret;
+
+  assert (prog_data);
+
+  if ((ret = pthread_mutex_init (&prog_data->interpret_ctx_lock, NULL)))
+    {
+      err_output ("pthread_mutex_init: %s", strerror (ret));
+      return (-1);
+    }
+
+  if (!(prog_data->interpret_ctx = ipmi_interpret_ctx_create ()))
+    {
+      err_output ("ipmi_interpret_ctx_create: %s", strerror (errno));
+      return (-1);
+    }
+
+  if (ipmi_interpret_load_sel_config (prog_data->interpret_ctx,
+                                      prog_data->args->event_state_config_file) < 0)
+    {
+      /* if default file is missing its ok */
+      if (!(!prog_data->args->event_state_config_file
+            && ipmi_interpret_ctx_errnum (prog_data->interpret_ctx) == IPMI_INTERPRET_ERR_SEL_CONFIG_FILE_DOES_NOT_EXIST))
+        {
+          err_output ("ipmi_interpret_load_sel_config: %s", ipmi_interpret_ctx_errormsg (prog_data->interpret_ctx));
+          return (-1);
+        }
+    }
+
+  if (prog_data->args->interpret_oem_data)
+    interpret_flags |= IPMI_INTERPRET_FLAGS_INTERPRET_OEM_DATA;
+
+  if (interpret_flags)
+    {
+      if (ipmi_interpret_ctx_set_flags (prog_data->interpret_ctx, interpret_flags) < 0)
+        {
+          err_output ("ipmi_interpret_ctx_set_flags: %s",
+                      ipmi_interpret_ctx_errormsg (prog_data->interpret_ctx));
+          return (-1);
+        }
+    }
+
+  return (0);
+}
+
+/* Each session kept open holds file descriptors, so only as many are
+ * kept as the file descriptor limit allows.
+ */
+static unsigned int
+_ipmiseld_session_reuse_max (ipmiseld_prog_data_t *prog_data)
+{
+  struct rlimit rlim;
+  rlim_t reserved;
+
+  assert (prog_data);
+
+  /* Make best effort to increase file descriptor limit, if it fails
+   * for any reason, use the current one.
+   */
+  if (getrlimit (RLIMIT_NOFILE, &rlim) == 0)
+    {
+      rlim.rlim_cur = rlim.rlim_max;
+      setrlimit (RLIMIT_NOFILE, &rlim);
+    }
+
+  if (getrlimit (RLIMIT_NOFILE, &rlim) < 0)
+    return (UINT_MAX);
+
+  if (rlim.rlim_cur == RLIM_INFINITY)
+    return (UINT_MAX);
+
+  reserved = IPMISELD_SESSION_REUSE_FDS_RESERVED
+    + (rlim_t)prog_data->args->threadpool_count * IPMISELD_SESSION_REUSE_FDS_PER_SESSION;
+
+  if (rlim.rlim_cur <= reserved)
+    return (0);
+
+  if ((rlim.rlim_cur - reserved) / IPMISELD_SESSION_REUSE_FDS_PER_SESSION > UINT_MAX)
+    return (UINT_MAX);
+
+  return ((rlim.rlim_cur - reserved) / IPMISELD_SESSION_REUSE_FDS_PER_SESSION);
+}
+
+/* Keeping a LAN session open between polls costs a keepalive every
+ * half session timeout.  Only do so when that is cheaper than opening
+ * and closing a session every poll.
+ */
+static void
+_ipmiseld_session_reuse_setup (ipmiseld_prog_data_t *prog_data)
+{
+  unsigned int session_timeout;
+  unsigned int keepalive_interval;
+  unsigned int keepalive_count;
+
+  assert (prog_data);
+
+  prog_data->session_reuse = 0;
+  prog_data->session_reuse_max = _ipmiseld_session_reuse_max (prog_data);
+  prog_data->keepalive_interval = 0;
+
+  /* inband has no session to time out */
+  if (!prog_data->args->common_args.hostname)
+    {
+      prog_data->session_reuse = 1;
+      return;
+    }
+
+  /* test run polls once */
+  if (prog_data->args->test_run)
+    return;
+
+  /* broker keeps the session alive on our behalf */
+  if (prog_data->args->common_args.session_broker)
+    {
+      prog_data->session_reuse = 1;
+      return;
+    }
+
+  if (prog_data->args->common_args.session_timeout)
+    session_timeout = prog_data->args->common_args.session_timeout;
+  else
+    session_timeout = IPMI_SESSION_TIMEOUT_DEFAULT;
+
+  /* session timeout is in milliseconds */
+  if (!(keepalive_interval = session_timeout / 2000))
+    keepalive_interval = 1;
+
+  keepalive_count = (prog_data->args->poll_interval - 1) / keepalive_interval;
+
+  if (keepalive_count <= IPMISELD_KEEPALIVE_COUNT_MAX)
+    {
+      prog_data->session_reuse = 1;
+      if (keepalive_count)
+        prog_data->keepalive_interval = keepalive_interval;
+    }
+
+  if (prog_data->args->foreground
+      && prog_data->args->common_args.debug)
+    IPMISELD_DEBUG (("session reuse = %s, max sessions = %u, keepalive interval = %u",
+                     prog_data->session_reuse ? "yes" : "no",
+                     prog_data->session_reuse_max,
+                     prog_data->keepalive_interval));
+}
+
+/* Returns milliseconds until another host may be polled under the
+ * poll rate max, 0 if one may be polled now.
+ */
+static unsigned int
+_ipmiseld_poll_rate_wait (ipmiseld_prog_data_t *prog_data)
+{
+  struct timeval now;
+  struct timeval delta;
+  unsigned int ms;
+
+  assert (prog_data);
+
+  if (!prog_data->args->poll_rate_max)
+    return (0);
+
+  gettimeofday (&now, NULL);
+
+  if (!timeval_lt (&now, &poll_rate_next))
+    return (0);
+
+  timeval_sub (&poll_rate_next, &now, &delta);
+  timeval_millisecond_calc (&delta, &ms);
+  return (ms ? ms : 1);
+}
+
+/* Keepalives count against the rate too, they are BMC queries */
+static void
+_ipmiseld_poll_rate_consume (ipmiseld_prog_data_t *prog_data)
+{
+  struct timeval now;
+  struct timeval spacing;
+  unsigned int usec;
+
+  assert (prog_data);
+
+  if (!prog_data->args->poll_rate_max)
+    return;
+
+  gettimeofday (&now, NULL);
+
+  /* no bursts after an idle period */
+  if (timeval_lt (&poll_rate_next, &now))
+    poll_rate_next = now;
+
+  usec = 1000000 / prog_data->args->poll_rate_max;
+  spacing.tv_sec = usec / 1000000;
+  spacing.tv_usec = usec % 1000000;
+  timeval_add (&poll_rate_next, &spacing, &poll_rate_next);
+}
+
+static void
+_ipmiseld_sleep_ms (unsigned int ms)
+{
+  struct timeval tv;
+
+  tv.tv_sec = ms / 1000;
+  tv.tv_usec = (ms % 1000) * 1000;
+
+  /* ignore potential error, EINTR is handled by the caller's loop */
+  select (0, NULL, NULL, NULL, &tv);
+}
+
+/* Sleeps may be as long as the poll interval, wake up to write out
+ * state stored in the meantime.
+ */
+static void
+_ipmiseld_daemon_sleep (unsigned int sleep_len)
+{
+  while (sleep_len && exit_flag)
+    {
+      unsigned int len = sleep_len;
+
+      if (len > IPMISELD_DATA_CACHE_FLUSH_INTERVAL)
+        len = IPMISELD_DATA_CACHE_FLUSH_INTERVAL;
+
+      daemon_sleep (len);
+      ipmiseld_data_cache_flush ();
+      sleep_len -= len;
+    }
+}
+
+/* The async engine only opens sessions and checks the SEL info, it
+ * implements none of the workarounds, bridging, or the broker
+ * protocol of libfreeipmi.  Sessions are not kept open between polls,
+ * the engine opens one per poll.
+ */
+static void
+_ipmiseld_async_engine_setup (ipmiseld_prog_data_t *prog_data)
+{
+  struct common_cmd_args *common_args;
+  char *reason = NULL;
+
+  assert (prog_data);
+
+  prog_data->async_engine = 0;
+
+  if (!prog_data->args->async_engine)
+    return;
+
+  common_args = &(prog_data->args->common_args);
+
+  if (prog_data->args->test_run)
+    return;
+
+  if (!common_args->hostname)
+    reason = "inband";
+  else if (common_args->session_broker)
+    reason = "session broker";
+  else if (common_args->workaround_flags_outofband
+           || common_args->workaround_flags_outofband_2_0)
+    reason = "workaround flags";
+  else if (common_args->target_channel_number_is_set
+           || common_args->target_slave_address_is_set)
+    reason = "target channel or slave address";
+
+  if (reason)
+    {
+      err_output ("async engine not supported with %s, disabled", reason);
+      return;
+    }
+
+  prog_data->async_engine = 1;
+  prog_data->session_reuse = 0;
+  prog_data->keepalive_interval = 0;
+
+  if (prog_data->args->foreground
+      && prog_data->args->common_args.debug)
+    IPMISELD_DEBUG (("async engine enabled, %u sessions",
+                     prog_data->args->async_session_count));
+}
+
+static void
+_ipmiseld_heap_reinsert (ipmiseld_host_data_t *host_data)
+{
+  assert (host_data);
+
+  pthread_mutex_lock (&host_data_heap_lock);
+
+  if (!heap_insert (host_data_heap, host_data))
+    ipmiseld_err_output (host_data, "heap_insert: %s", strerror (errno));
+
+  pthread_mutex_unlock (&host_data_heap_lock);
+}
+
+static void
+_ipmiseld_threadpool_dispatch (ipmiseld_host_data_t *host_data)
+{
+  assert (host_data);
+
+  if (ipmiseld_threadpool_queue (host_data) < 0)
+    _ipmiseld_heap_reinsert (host_data);
+}
+
+/* If the SEL info is unchanged since the last poll, there is nothing
+ * to log, save, or clear, and the host is done.  Otherwise the
+ * threadpool does the full poll.
+ */
+static void
+_ipmiseld_engine_callback (ipmiseld_host_data_t *host_data,
+                           fiid_obj_t obj_cmd_rs,
+                           int errnum)
+{
+  ipmiseld_sel_info_t sel_info;
+  unsigned int percent;
+
+  assert (host_data);
+
+  if (errnum)
+    {
+      /* non-connection errors are re-tried by the threadpool, which
+       * can output them precisely
+       */
+      if (ipmiseld_ipmi_connect_error (host_data, errnum))
+        _ipmiseld_poll_postprocess (host_data);
+      else
+        _ipmiseld_threadpool_dispatch (host_data);
+      return;
+    }
+
+  assert (obj_cmd_rs);
+
+  memset (&sel_info, '\0', sizeof (ipmiseld_sel_info_t));
+  if (_sel_info_parse (host_data, obj_cmd_rs, &sel_info) < 0)
+    {
+      _ipmiseld_threadpool_dispatch (host_data);
+      return;
+    }
+
+  percent = ipmiseld_calc_percent_full (host_data, &sel_info);
+
+  if (sel_info.entries == host_data->last_host_state.sel_info.entries
+      && sel_info.free_space == host_data->last_host_state.sel_info.free_space
+      && sel_info.most_recent_addition_timestamp == host_data->last_host_state.sel_info.most_recent_addition_timestamp
+      && sel_info.most_recent_erase_timestamp == host_data->last_host_state.sel_info.most_recent_erase_timestamp
+      && sel_info.overflow_flag == host_data->last_host_state.sel_info.overflow_flag
+      && !(host_data->prog_data->args->clear_threshold
+           && percent > host_data->prog_data->args->clear_threshold))
+    {
+      if (host_data->prog_data->args->foreground
+          && host_data->prog_data->args->common_args.debug)
+        IPMISELD_HOST_DEBUG (("SEL info unchanged"));
+
+      _ipmiseld_poll_postprocess (host_data);
+      return;
+    }
+
+  _ipmiseld_threadpool_dispatch (host_data);
+}
+
+/* The first poll of a host loads or initializes its state and a
+ * pending clear needs a SEL context, those go to the threadpool.
+ */
+static void
+_ipmiseld_engine_dispatch (ipmiseld_host_data_t *host_data)
+{
+  assert (host_data);
+
+  if (host_data->last_host_state.initialized
+      && !(host_data->prog_data->args->clear_sel
+           && !host_data->clear_sel_done))
+    {
+      if (ipmiseld_engine_submit (host_data) > 0)
+        return;
+    }
+
+  _ipmiseld_threadpool_dispatch (host_data);
+}
+
+static void
+_ipmiseld_engine_loop (ipmiseld_prog_data_t *prog_data)
+{
+  assert (prog_data);
+
+  while (exit_flag)
+    {
+      ipmiseld_host_data_t *host_data;
+      unsigned int timeout = IPMISELD_ENGINE_PROCESS_TIMEOUT_MAX;
+      struct timeval tv;
+
+      ipmiseld_data_cache_flush ();
+
+      gettimeofday (&tv, NULL);
+
+      while (!ipmiseld_engine_full ())
+        {
+          unsigned int wait;
+
+          if ((wait = _ipmiseld_poll_rate_wait (prog_data)))
+            {
+              if (wait < timeout)
+                timeout = wait;
+              break;
+            }
+
+          pthread_mutex_lock (&host_data_heap_lock);
+
+          host_data = heap_peek (host_data_heap);
+
+          /* If next_poll_time == 0, its the first time through */
+          if (host_data
+              && host_data->next_poll_time
+              && host_data->next_poll_time > tv.tv_sec)
+            {
+              if ((host_data->next_poll_time - tv.tv_sec) * 1000 < timeout)
+                timeout = (host_data->next_poll_time - tv.tv_sec) * 1000;
+              host_data = NULL;
+            }
+
+          if (host_data)
+            host_data = heap_pop (host_data_heap);
+
+          pthread_mutex_unlock (&host_data_heap_lock);
+
+          if (!host_data)
+            break;
+
+          _ipmiseld_engine_dispatch (host_data);
+          _ipmiseld_poll_rate_consume (prog_data);
+        }
+
+      if (ipmiseld_engine_process (timeout) < 0)
+        break;
+    }
+}
+
 static int
 _ipmiseld (ipmiseld_prog_data_t *prog_data)
 {
@@ -1605,6 +2209,13 @@ _ipmiseld (ipmiseld_prog_data_t *prog_data)
       goto cleanup;
     }
 
+  if (_ipmiseld_interpret_ctx_create (prog_data) < 0)
+    goto cleanup;
+
+  _ipmiseld_session_reuse_setup (prog_data);
+
+  _ipmiseld_async_engine_setup (prog_data);
+
   if (hosts_count == 1)
     {
       if (!(host_data = _alloc_host_data (prog_data, prog_data->args->common_args.hostname)))
@@ -1646,11 +2257,23 @@ _ipmiseld (ipmiseld_prog_data_t *prog_data)
       host = NULL;
     }
 
+  if (ipmiseld_output_init (prog_data) < 0)
+    goto cleanup;
+
+  if (ipmiseld_data_cache_init (prog_data) < 0)
+    goto cleanup;
+
   if (ipmiseld_threadpool_init (prog_data,
                                 _ipmiseld_poll,
                                 _ipmiseld_poll_postprocess) < 0)
     goto cleanup;
 
+  if (prog_data->async_engine)
+    {
+      if (ipmiseld_engine_init (prog_data, _ipmiseld_engine_callback) < 0)
+        goto cleanup;
+    }
+
   if (prog_data->args->test_run)
     {
       while (!heap_is_empty (host_data_heap))
@@ -1662,12 +2285,25 @@ _ipmiseld (ipmiseld_prog_data_t *prog_data)
             }
 
           _ipmiseld_poll (host_data);
+          _free_host_data (host_data);
         }
     }
+  else if (prog_data->async_engine)
+    _ipmiseld_engine_loop (prog_data);
   else
     {
       while (exit_flag)
         {
+          unsigned int wait;
+
+          ipmiseld_data_cache_flush ();
+
+          if ((wait = _ipmiseld_poll_rate_wait (prog_data)))
+            {
+              _ipmiseld_sleep_ms (wait);
+              continue;
+            }
+
           pthread_mutex_lock (&host_data_heap_lock);
 
           host_data = heap_pop (host_data_heap);
@@ -1703,7 +2339,7 @@ _ipmiseld (ipmiseld_prog_data_t *prog_data)
               if (!waittime)
                 waittime = 1;
 
-              daemon_sleep (waittime);
+              _ipmiseld_daemon_sleep (waittime);
               continue;
             }
 
@@ -1716,6 +2352,8 @@ _ipmiseld (ipmiseld_prog_data_t *prog_data)
 
               pthread_mutex_unlock (&host_data_heap_lock);
             }
+          else
+            _ipmiseld_poll_rate_consume (prog_data);
 
           pthread_mutex_lock (&host_data_heap_lock);
 
@@ -1725,10 +2363,16 @@ _ipmiseld (ipmiseld_prog_data_t *prog_data)
 
           /* empty heap, everything must be processing, so we'll sleep
            * for the poll interval, b/c no one should be scheduled
-           * until after this time has passed anyways.
+           * until after this time has passed anyways.  Unless a
+           * keepalive may be scheduled sooner.
            */
           if (!host_data)
-            daemon_sleep (prog_data->args->poll_interval + 1);
+            {
+              if (prog_data->keepalive_interval)
+                _ipmiseld_daemon_sleep (prog_data->keepalive_interval);
+              else
+                _ipmiseld_daemon_sleep (prog_data->args->poll_interval_min + 1);
+            }
           else
             {
               struct timeval tv;
@@ -1738,7 +2382,7 @@ _ipmiseld (ipmiseld_prog_data_t *prog_data)
               /* If next_poll_time == 0, no sleep, its the first time through */
               if (host_data->next_poll_time
                   && (host_data->next_poll_time > tv.tv_sec))
-                daemon_sleep ((host_data->next_poll_time - tv.tv_sec) + 1);
+                _ipmiseld_daemon_sleep ((host_data->next_poll_time - tv.tv_sec) + 1);
             }
         }
     }
@@ -1746,10 +2390,15 @@ _ipmiseld (ipmiseld_prog_data_t *prog_data)
   rv = 0;
  cleanup:
   ipmiseld_threadpool_destroy ();
+  ipmiseld_engine_destroy ();
+  /* output before the state it was logged up to is stored */
+  ipmiseld_output_fini ();
+  ipmiseld_data_cache_fini ();
   heap_destroy (host_data_heap);
   fi_hostlist_iterator_destroy (hitr);
   fi_hostlist_destroy (hlist);
   free (host);
+  ipmi_interpret_ctx_destroy (prog_data->interpret_ctx);
   return (rv);
 }
 
@@ -1765,6 +2414,7 @@ main (int argc, char **argv)
   ipmi_disable_coredump ();
 
   prog_data.progname = argv[0];
+  prog_data.interpret_ctx = NULL;
   ipmiseld_argp_parse (argc, argv, &cmd_args);
   prog_data.args = &cmd_args;
 
@@ -1783,6 +2433,16 @@ main (int argc, char **argv)
   else
     prog_data.log_priority = LOG_ERR;
 
+  if (prog_data.args->output_sink_str)
+    prog_data.output_sink = ipmiseld_output_sink_parse (prog_data.args->output_sink_str);
+  else
+    prog_data.output_sink = IPMISELD_OUTPUT_SINK_SYSLOG;
+
+  if (prog_data.args->output_format_str)
+    prog_data.output_format = ipmiseld_output_format_parse (prog_data.args->output_format_str);
+  else
+    prog_data.output_format = IPMISELD_OUTPUT_FORMAT_TEXT;
+
   if (!cmd_args.test_run)
     {
       if (!cmd_args.foreground)
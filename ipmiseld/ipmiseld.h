@@ -40,6 +40,7 @@
 #include <time.h>
 #endif /* !HAVE_SYS_TIME_H */
 #endif /* !TIME_WITH_SYS_TIME */
+#include <pthread.h>
 
 #include <freeipmi/freeipmi.h>
 
@@ -67,8 +68,35 @@
 
 #define IPMISELD_THREADPOOL_COUNT                                       8
 
+#define IPMISELD_ASYNC_SESSION_COUNT_DEFAULT                            1024
+
+#define IPMISELD_OUTPUT_SINK_SYSLOG                                     0
+#define IPMISELD_OUTPUT_SINK_FILE                                       1
+#define IPMISELD_OUTPUT_SINK_SOCKET                                     2
+
+#define IPMISELD_OUTPUT_FORMAT_TEXT                                     0
+#define IPMISELD_OUTPUT_FORMAT_KEYVALUE                                 1
+
+#define IPMISELD_OUTPUT_ROTATE_COUNT_DEFAULT                            5
+
+#define IPMISELD_OUTPUT_QUEUE_LENGTH_DEFAULT                            4096
+
 #define IPMISELD_ERROR_OUTPUT_LIMIT                                     20
 
+/* Sessions are kept open between polls if it takes no more than this
+ * many keepalives to do so, about the number of packet exchanges
+ * needed to set up and close a session.
+ */
+#define IPMISELD_KEEPALIVE_COUNT_MAX                                    6
+
+/* Sessions kept open between polls are bounded by the file descriptor
+ * limit.  Each holds its socket and SDR cache open.  The rest are
+ * reserved for output, logging, cache files, and the sessions of
+ * hosts being polled.
+ */
+#define IPMISELD_SESSION_REUSE_FDS_PER_SESSION                          2
+#define IPMISELD_SESSION_REUSE_FDS_RESERVED                             64
+
 enum ipmiseld_argp_option_keys
   {
     IPMISELD_VERBOSE_KEY = 'v',
@@ -97,6 +125,18 @@ enum ipmiseld_argp_option_keys
     IPMISELD_THREADPOOL_COUNT_KEY = 180,
     IPMISELD_TEST_RUN_KEY = 181,
     IPMISELD_FOREGROUND_KEY = 182,
+    IPMISELD_ASYNC_ENGINE_KEY = 183,
+    IPMISELD_ASYNC_SESSION_COUNT_KEY = 184,
+    IPMISELD_POLL_INTERVAL_MIN_KEY = 185,
+    IPMISELD_POLL_INTERVAL_MAX_KEY = 186,
+    IPMISELD_POLL_RATE_MAX_KEY = 187,
+    IPMISELD_PER_HOST_DATA_CACHE_KEY = 188,
+    IPMISELD_OUTPUT_SINK_KEY = 189,
+    IPMISELD_OUTPUT_PATH_KEY = 190,
+    IPMISELD_OUTPUT_FORMAT_KEY = 191,
+    IPMISELD_OUTPUT_ROTATE_SIZE_KEY = 192,
+    IPMISELD_OUTPUT_ROTATE_COUNT_KEY = 193,
+    IPMISELD_OUTPUT_QUEUE_LENGTH_KEY = 194,
   };
 
 struct ipmiseld_arguments
@@ -121,24 +161,56 @@ struct ipmiseld_arguments
   char *oem_timestamped_event_format_str;
   char *oem_non_timestamped_event_format_str;
   unsigned int poll_interval;
+  unsigned int poll_interval_min;
+  unsigned int poll_interval_max;
+  unsigned int poll_rate_max;
   char *log_facility_str;
   char *log_priority_str;
+  char *output_sink_str;
+  char *output_path;
+  char *output_format_str;
+  unsigned int output_rotate_size;
+  unsigned int output_rotate_count;
+  unsigned int output_queue_length;
   char *cache_directory;
+  int per_host_data_cache;
   int ignore_sdr;
   int re_download_sdr;
   int clear_sel;
   unsigned int threadpool_count;
   int test_run;
   int foreground;
+  int async_engine;
+  unsigned int async_session_count;
 };
 
+/* The interpret context is read only once created and is shared by
+ * all hosts.  The manufacturer and product id are set per host, so
+ * it is used under interpret_ctx_lock.
+ *
+ * session_reuse - keep sessions open between polls
+ * session_reuse_max - maximum sessions kept open between polls, others
+ * are closed after each poll
+ * keepalive_interval - seconds between keepalives on open sessions,
+ * 0 if none are needed
+ * async_engine - SEL info is checked by the async engine, the
+ * arguments may ask for it but the configuration may not allow it
+ */
 typedef struct ipmiseld_prog_data
 {
   char *progname;
   int event_state_filter_mask;
   int log_facility;
   int log_priority;
+  int output_sink;
+  int output_format;
   struct ipmiseld_arguments *args;
+  ipmi_interpret_ctx_t interpret_ctx;
+  pthread_mutex_t interpret_ctx_lock;
+  int session_reuse;
+  unsigned int session_reuse_max;
+  unsigned int keepalive_interval;
+  int async_engine;
 } ipmiseld_prog_data_t;
 
 typedef struct ipmiseld_last_record_id
@@ -166,15 +238,33 @@ typedef struct ipmiseld_host_state
   int initialized;
 } ipmiseld_host_state_t;
 
+/* Kept across polls.  The ipmi, sdr, and sel contexts are created
+ * once, the session and SDR cache are re-opened as needed.
+ */
 typedef struct ipmiseld_host_poll
 {
   ipmi_ctx_t ipmi_ctx;
+  int ipmi_ctx_open;
+  int ipmi_ctx_kept;
+  time_t last_activity;
   ipmi_sdr_ctx_t sdr_ctx;
+  int sdr_cache_open;
   ipmi_sel_ctx_t sel_ctx;
   ipmi_interpret_ctx_t interpret_ctx;
   struct ipmi_oem_data oem_data;
+  int oem_data_loaded;
 } ipmiseld_host_poll_t;
 
+struct ipmiseld_engine_host;
+
+/* next_poll_time is when the host is next handed to a thread, which
+ * is either to poll the SEL at next_sel_poll_time or, if keepalive is
+ * set, to keep the session open until then.
+ *
+ * poll_interval is the host's current SEL poll interval, between the
+ * poll interval min and max.  sel_activity is set by a poll that found
+ * new SEL entries.
+ */
 typedef struct ipmiseld_host_data
 {
   ipmiseld_prog_data_t *prog_data;
@@ -185,8 +275,13 @@ typedef struct ipmiseld_host_data
   int re_download_sdr_done;
   int clear_sel_done;
   time_t next_poll_time;
+  time_t next_sel_poll_time;
+  unsigned int poll_interval;
+  int sel_activity;
+  int keepalive;
   int last_ipmi_errnum;
   unsigned int last_ipmi_errnum_count;
+  struct ipmiseld_engine_host *engine_host;
 } ipmiseld_host_data_t;
 
 #endif /* IPMISELD_H */
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#if HAVE_ARGP_H
+#include <argp.h>
+#else /* !HAVE_ARGP_H */
+#include "freeipmi-argp.h"
+#endif /* !HAVE_ARGP_H */
+#include <limits.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "ipmisessiond.h"
+#include "ipmisessiond-argp.h"
+
+#include "freeipmi-portability.h"
+#include "error.h"
+
+const char *argp_program_version =
+  "ipmisessiond - " PACKAGE_VERSION "\n"
+  "Copyright (C) 2003-2015 FreeIPMI Core Team\n"
+  "This program is free software; you may redistribute it under the terms of\n"
+  "the GNU General Public License.  This program has absolutely no warranty.";
+
+const char *argp_program_bug_address =
+  "<" PACKAGE_BUGREPORT ">";
+
+static char cmdline_doc[] =
+  "ipmisessiond - IPMI session broker daemon";
+
+static char cmdline_args_doc[] = "";
+
+static struct argp_option cmdline_options[] =
+  {
+    { "socket-path", IPMISESSIOND_SOCKET_PATH_KEY, "PATH", 0,
+      "Specify the local socket clients connect to.", 1},
+    { "idle-timeout", IPMISESSIOND_IDLE_TIMEOUT_KEY, "SECONDS", 0,
+      "Specify how long a session without clients is kept open.", 2},
+    { "keepalive-interval", IPMISESSIOND_KEEPALIVE_INTERVAL_KEY, "SECONDS", 0,
+      "Specify how often idle sessions are kept alive, 0 to never.", 3},
+    { "max-sessions", IPMISESSIOND_MAX_SESSIONS_KEY, "NUM", 0,
+      "Specify the maximum number of sessions held.", 4},
+    { "foreground", IPMISESSIOND_FOREGROUND_KEY, 0, 0,
+      "Run daemon in foreground.", 5},
+    { "debug", IPMISESSIOND_DEBUG_KEY, 0, 0,
+      "Turn on debugging and run daemon in foreground.", 6},
+    { NULL, 0, NULL, 0, NULL, 0}
+  };
+
+static error_t cmdline_parse (int key, char *arg, struct argp_state *state);
+
+static struct argp cmdline_argp = { cmdline_options,
+                                    cmdline_parse,
+                                    cmdline_args_doc,
+                                    cmdline_doc };
+
+static unsigned int
+_parse_unsigned_int (const char *arg, const char *what, int zero_ok)
+{
+  char *endptr;
+  long tmp;
+
+  assert (arg);
+  assert (what);
+
+  errno = 0;
+  tmp = strtol (arg, &endptr, 0);
+  if (errno
+      || endptr[0] != '\0'
+      || tmp < (zero_ok ? 0 : 1)
+      || tmp > UINT_MAX)
+    {
+      fprintf (stderr, "invalid %s\n", what);
+      exit (EXIT_FAILURE);
+    }
+
+  return (tmp);
+}
+
+static error_t
+cmdline_parse (int key, char *arg, struct argp_state *state)
+{
+  struct ipmisessiond_arguments *cmd_args;
+
+  assert (state);
+
+  cmd_args = state->input;
+
+  switch (key)
+    {
+    case IPMISESSIOND_SOCKET_PATH_KEY: /* --socket-path */
+      if (!(cmd_args->socket_path = strdup (arg)))
+        {
+          perror ("strdup");
+          exit (EXIT_FAILURE);
+        }
+      break;
+    case IPMISESSIOND_IDLE_TIMEOUT_KEY: /* --idle-timeout */
+      cmd_args->idle_timeout = _parse_unsigned_int (arg, "idle timeout", 0);
+      break;
+    case IPMISESSIOND_KEEPALIVE_INTERVAL_KEY: /* --keepalive-interval */
+      cmd_args->keepalive_interval = _parse_unsigned_int (arg, "keepalive interval", 0);
+      break;
+    case IPMISESSIOND_MAX_SESSIONS_KEY: /* --max-sessions */
+      cmd_args->max_sessions = _parse_unsigned_int (arg, "max sessions", 1);
+      break;
+    case IPMISESSIOND_FOREGROUND_KEY: /* --foreground */
+      cmd_args->foreground = 1;
+      break;
+    case IPMISESSIOND_DEBUG_KEY: /* --debug */
+      cmd_args->debug = 1;
+      cmd_args->foreground = 1;
+      break;
+    case ARGP_KEY_ARG:
+      /* Too many arguments. */
+      argp_usage (state);
+      break;
+    case ARGP_KEY_END:
+      break;
+    default:
+      return (ARGP_ERR_UNKNOWN);
+    }
+
+  return (0);
+}
+
+void
+ipmisessiond_argp_parse (int argc, char **argv, struct ipmisessiond_arguments *cmd_args)
+{
+  assert (argc >= 0);
+  assert (argv);
+  assert (cmd_args);
+
+  cmd_args->socket_path = IPMISESSIOND_SOCKET_PATH_DEFAULT;
+  cmd_args->idle_timeout = IPMISESSIOND_IDLE_TIMEOUT_DEFAULT;
+  cmd_args->keepalive_interval = IPMISESSIOND_KEEPALIVE_INTERVAL_DEFAULT;
+  cmd_args->max_sessions = IPMISESSIOND_MAX_SESSIONS_DEFAULT;
+  cmd_args->foreground = 0;
+  cmd_args->debug = 0;
+
+  argp_parse (&cmdline_argp,
+              argc,
+              argv,
+              ARGP_IN_ORDER,
+              NULL,
+              cmd_args);
+}
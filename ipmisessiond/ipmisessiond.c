@@ -0,0 +1,806 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/poll.h>
+#include <syslog.h>
+#include <signal.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <freeipmi/freeipmi.h>
+
+#include "ipmisessiond.h"
+#include "ipmisessiond-argp.h"
+
+#include "freeipmi-portability.h"
+#include "error.h"
+#include "list.h"
+#include "secure.h"
+#include "session-broker.h"
+#include "tool-daemon-common.h"
+#include "tool-util-common.h"
+
+#define IPMISESSIOND_PIDFILE            IPMISESSIOND_LOCALSTATEDIR "/run/ipmisessiond.pid"
+
+#define IPMISESSIOND_POLL_TIMEOUT       1000
+
+#define IPMISESSIOND_LISTEN_BACKLOG     64
+
+#define IPMISESSIOND_KEEPALIVE_BUFLEN   64
+
+#define IPMISESSIOND_DEBUG(__msg)               \
+  do {                                          \
+    if (debug_flag)                             \
+      err_debug __msg;                          \
+  } while (0)
+
+static struct ipmisessiond_arguments *args = NULL;
+
+static int exit_flag = 1;
+
+static int debug_flag = 0;
+
+static List sessions = NULL;
+
+static pthread_mutex_t sessions_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int listen_fd = -1;
+
+static void
+_signal_handler_callback (int sig)
+{
+  exit_flag = 0;
+}
+
+static void
+_session_close (ipmisessiond_session_t *s)
+{
+  assert (s);
+
+  if (s->ipmi_ctx)
+    {
+      IPMISESSIOND_DEBUG (("%s: session closed", s->key.hostname));
+      ipmi_ctx_destroy (s->ipmi_ctx);
+      s->ipmi_ctx = NULL;
+    }
+}
+
+static void
+_session_destroy (ipmisessiond_session_t *s)
+{
+  if (!s)
+    return;
+
+  _session_close (s);
+  pthread_mutex_destroy (&(s->mutex));
+  /* secure_memset b/c key contains ipmi password */
+  secure_memset (s, '\0', sizeof (ipmisessiond_session_t));
+  free (s);
+}
+
+/* Must be called with the session's mutex held.
+ *
+ * Returns ipmi errnum
+ */
+static int
+_session_open (ipmisessiond_session_t *s)
+{
+  int errnum;
+
+  assert (s);
+  assert (!s->ipmi_ctx);
+
+  if (!(s->ipmi_ctx = ipmi_ctx_create ()))
+    {
+      err_output ("ipmi_ctx_create: %s", strerror (errno));
+      return (IPMI_ERR_OUT_OF_MEMORY);
+    }
+
+  if (ipmi_ctx_open_outofband_2_0 (s->ipmi_ctx,
+                                   s->key.hostname,
+                                   strlen (s->key.username) ? s->key.username : NULL,
+                                   strlen (s->key.password) ? s->key.password : NULL,
+                                   s->key.k_g_len ? s->key.k_g : NULL,
+                                   s->key.k_g_len,
+                                   s->key.privilege_level,
+                                   s->key.cipher_suite_id,
+                                   s->key.session_timeout,
+                                   s->key.retransmission_timeout,
+                                   s->key.workaround_flags,
+                                   s->key.flags) < 0)
+    {
+      errnum = ipmi_ctx_errnum (s->ipmi_ctx);
+      IPMISESSIOND_DEBUG (("%s: ipmi_ctx_open_outofband_2_0: %s",
+                           s->key.hostname,
+                           ipmi_ctx_errormsg (s->ipmi_ctx)));
+      ipmi_ctx_destroy (s->ipmi_ctx);
+      s->ipmi_ctx = NULL;
+      return (errnum);
+    }
+
+  IPMISESSIOND_DEBUG (("%s: session established", s->key.hostname));
+  return (IPMI_ERR_SUCCESS);
+}
+
+/* A session is only shared with clients that present exactly the
+ * same credentials it was established with.  Timeouts are taken from
+ * the client that established it.
+ */
+static int
+_session_key_match (void *x, void *key)
+{
+  ipmisessiond_session_t *s;
+  struct session_broker_open_rq *open_rq;
+
+  assert (x);
+  assert (key);
+
+  s = (ipmisessiond_session_t *)x;
+  open_rq = (struct session_broker_open_rq *)key;
+
+  return (!strcmp (s->key.hostname, open_rq->hostname)
+          && !strcmp (s->key.username, open_rq->username)
+          && !strcmp (s->key.password, open_rq->password)
+          && s->key.k_g_len == open_rq->k_g_len
+          && !memcmp (s->key.k_g, open_rq->k_g, open_rq->k_g_len)
+          && s->key.privilege_level == open_rq->privilege_level
+          && s->key.cipher_suite_id == open_rq->cipher_suite_id
+          && s->key.workaround_flags == open_rq->workaround_flags
+          && s->key.flags == open_rq->flags);
+}
+
+/* Returns session with a client reference held, NULL if no more
+ * sessions may be held
+ */
+static ipmisessiond_session_t *
+_session_attach (struct session_broker_open_rq *open_rq)
+{
+  ipmisessiond_session_t *s;
+
+  assert (open_rq);
+
+  pthread_mutex_lock (&sessions_mutex);
+
+  if (!(s = list_find_first (sessions, _session_key_match, open_rq)))
+    {
+      if (list_count (sessions) >= args->max_sessions)
+        {
+          IPMISESSIOND_DEBUG (("%s: too many sessions", open_rq->hostname));
+          goto cleanup;
+        }
+
+      if (!(s = (ipmisessiond_session_t *)malloc (sizeof (ipmisessiond_session_t))))
+        {
+          err_output ("malloc: %s", strerror (errno));
+          goto cleanup;
+        }
+      memset (s, '\0', sizeof (ipmisessiond_session_t));
+      memcpy (&(s->key), open_rq, sizeof (struct session_broker_open_rq));
+      pthread_mutex_init (&(s->mutex), NULL);
+
+      if (!list_append (sessions, s))
+        {
+          err_output ("list_append: %s", strerror (errno));
+          _session_destroy (s);
+          s = NULL;
+          goto cleanup;
+        }
+    }
+
+  s->clients++;
+  s->last_used = time (NULL);
+ cleanup:
+  pthread_mutex_unlock (&sessions_mutex);
+  return (s);
+}
+
+static void
+_session_detach (ipmisessiond_session_t *s, int client)
+{
+  time_t now;
+
+  assert (s);
+
+  now = time (NULL);
+
+  pthread_mutex_lock (&sessions_mutex);
+  assert (s->clients);
+  s->clients--;
+  if (client)
+    s->last_used = now;
+  s->last_active = now;
+  pthread_mutex_unlock (&sessions_mutex);
+}
+
+static void
+_session_touch (ipmisessiond_session_t *s)
+{
+  time_t now;
+
+  assert (s);
+
+  now = time (NULL);
+
+  pthread_mutex_lock (&sessions_mutex);
+  s->last_used = now;
+  s->last_active = now;
+  pthread_mutex_unlock (&sessions_mutex);
+}
+
+/* The session belongs to the broker, so clients may not close it or
+ * change its privilege level.
+ */
+static int
+_cmd_allowed (struct session_broker_cmd_rq *cmd_rq)
+{
+  assert (cmd_rq);
+
+  if (cmd_rq->ipmb || cmd_rq->net_fn != IPMI_NET_FN_APP_RQ)
+    return (1);
+
+  if (cmd_rq->buf_rq[0] == IPMI_CMD_GET_SESSION_CHALLENGE
+      || cmd_rq->buf_rq[0] == IPMI_CMD_ACTIVATE_SESSION
+      || cmd_rq->buf_rq[0] == IPMI_CMD_SET_SESSION_PRIVILEGE_LEVEL
+      || cmd_rq->buf_rq[0] == IPMI_CMD_CLOSE_SESSION)
+    return (0);
+
+  return (1);
+}
+
+static void
+_session_cmd (ipmisessiond_session_t *s,
+              struct session_broker_cmd_rq *cmd_rq,
+              struct session_broker_cmd_rs *cmd_rs)
+{
+  int errnum;
+  int rv;
+
+  assert (s);
+  assert (cmd_rq);
+  assert (cmd_rs);
+
+  cmd_rs->errnum = IPMI_ERR_SUCCESS;
+  cmd_rs->rv = -1;
+
+  if (!cmd_rq->buf_rq_len
+      || cmd_rq->buf_rq_len > SESSION_BROKER_BUFLEN
+      || !cmd_rq->buf_rs_len
+      || cmd_rq->buf_rs_len > SESSION_BROKER_BUFLEN)
+    {
+      cmd_rs->errnum = IPMI_ERR_PARAMETERS;
+      return;
+    }
+
+  if (!_cmd_allowed (cmd_rq))
+    {
+      cmd_rs->errnum = IPMI_ERR_COMMAND_INVALID_FOR_SELECTED_INTERFACE;
+      return;
+    }
+
+  pthread_mutex_lock (&(s->mutex));
+
+  /* re-establish a session lost earlier */
+  if (!s->ipmi_ctx
+      && (errnum = _session_open (s)) != IPMI_ERR_SUCCESS)
+    {
+      cmd_rs->errnum = errnum;
+      goto cleanup;
+    }
+
+  if (cmd_rq->ipmb)
+    rv = ipmi_cmd_raw_ipmb (s->ipmi_ctx,
+                            cmd_rq->channel_number,
+                            cmd_rq->rs_addr,
+                            cmd_rq->lun,
+                            cmd_rq->net_fn,
+                            cmd_rq->buf_rq,
+                            cmd_rq->buf_rq_len,
+                            cmd_rs->buf_rs,
+                            cmd_rq->buf_rs_len);
+  else
+    rv = ipmi_cmd_raw (s->ipmi_ctx,
+                       cmd_rq->lun,
+                       cmd_rq->net_fn,
+                       cmd_rq->buf_rq,
+                       cmd_rq->buf_rq_len,
+                       cmd_rs->buf_rs,
+                       cmd_rq->buf_rs_len);
+
+  if (rv < 0)
+    {
+      cmd_rs->errnum = ipmi_ctx_errnum (s->ipmi_ctx);
+
+      /* The BMC may have dropped the session, the next command
+       * establishes a new one.
+       */
+      if (cmd_rs->errnum == IPMI_ERR_SESSION_TIMEOUT)
+        _session_close (s);
+    }
+
+  cmd_rs->rv = rv;
+ cleanup:
+  pthread_mutex_unlock (&(s->mutex));
+}
+
+static void
+_session_keepalive (ipmisessiond_session_t *s)
+{
+  uint8_t buf_rq[1];
+  uint8_t buf_rs[IPMISESSIOND_KEEPALIVE_BUFLEN];
+
+  assert (s);
+
+  pthread_mutex_lock (&(s->mutex));
+
+  if (!s->ipmi_ctx)
+    goto cleanup;
+
+  buf_rq[0] = IPMI_CMD_GET_DEVICE_ID;
+
+  if (ipmi_cmd_raw (s->ipmi_ctx,
+                    IPMI_BMC_IPMB_LUN_BMC,
+                    IPMI_NET_FN_APP_RQ,
+                    buf_rq,
+                    1,
+                    buf_rs,
+                    IPMISESSIOND_KEEPALIVE_BUFLEN) < 0)
+    {
+      IPMISESSIOND_DEBUG (("%s: keepalive: %s",
+                           s->key.hostname,
+                           ipmi_ctx_errormsg (s->ipmi_ctx)));
+      _session_close (s);
+    }
+
+ cleanup:
+  pthread_mutex_unlock (&(s->mutex));
+}
+
+/* Sessions without clients are closed once idle_timeout passes, and
+ * sessions that are not closed are kept alive by a Get Device ID
+ * every keepalive_interval, before the BMC times them out.  Work
+ * with the BMCs is done outside of the session list lock, so a slow
+ * BMC doesn't hold up clients of other BMCs.
+ */
+static void
+_sessions_maintenance (ipmisessiond_session_t **closed,
+                       ipmisessiond_session_t **keepalive)
+{
+  ipmisessiond_session_t *s;
+  ListIterator itr;
+  unsigned int closed_count = 0;
+  unsigned int keepalive_count = 0;
+  unsigned int interval;
+  unsigned int i;
+  time_t now;
+
+  assert (closed);
+  assert (keepalive);
+
+  now = time (NULL);
+
+  pthread_mutex_lock (&sessions_mutex);
+
+  if (!(itr = list_iterator_create (sessions)))
+    {
+      err_output ("list_iterator_create: %s", strerror (errno));
+      pthread_mutex_unlock (&sessions_mutex);
+      return;
+    }
+
+  while ((s = list_next (itr)))
+    {
+      /* without clients, no one else is touching ipmi_ctx */
+      if (!s->clients
+          && (!s->ipmi_ctx
+              || (now - s->last_used) >= args->idle_timeout))
+        {
+          list_remove (itr);
+          closed[closed_count++] = s;
+          continue;
+        }
+
+      if (!args->keepalive_interval)
+        continue;
+
+      /* libfreeipmi considers a session timed out once nothing has
+       * been received for session_timeout, so stay well within it.
+       */
+      interval = args->keepalive_interval;
+      if (s->key.session_timeout
+          && (s->key.session_timeout / 2000) < interval)
+        interval = (s->key.session_timeout / 2000) ? (s->key.session_timeout / 2000) : 1;
+
+      if ((now - s->last_active) >= interval)
+        {
+          s->clients++;
+          keepalive[keepalive_count++] = s;
+        }
+    }
+
+  list_iterator_destroy (itr);
+  pthread_mutex_unlock (&sessions_mutex);
+
+  for (i = 0; i < closed_count; i++)
+    _session_destroy (closed[i]);
+
+  for (i = 0; i < keepalive_count; i++)
+    {
+      _session_keepalive (keepalive[i]);
+      _session_detach (keepalive[i], 0);
+    }
+}
+
+static void *
+_maintenance_thread (void *arg)
+{
+  ipmisessiond_session_t **closed = NULL;
+  ipmisessiond_session_t **keepalive = NULL;
+
+  if (!(closed = (ipmisessiond_session_t **)malloc (sizeof (ipmisessiond_session_t *) * args->max_sessions)))
+    err_exit ("malloc: %s", strerror (errno));
+
+  if (!(keepalive = (ipmisessiond_session_t **)malloc (sizeof (ipmisessiond_session_t *) * args->max_sessions)))
+    err_exit ("malloc: %s", strerror (errno));
+
+  while (exit_flag)
+    {
+      _sessions_maintenance (closed, keepalive);
+      sleep (1);
+    }
+
+  free (closed);
+  free (keepalive);
+  return (NULL);
+}
+
+static void *
+_client_thread (void *arg)
+{
+  struct session_broker_open_rq open_rq;
+  struct session_broker_open_rs open_rs;
+  struct session_broker_cmd_rq cmd_rq;
+  struct session_broker_cmd_rs cmd_rs;
+  ipmisessiond_session_t *s = NULL;
+  uint32_t type;
+  int fd;
+  int len;
+
+  assert (arg);
+
+  fd = *((int *)arg);
+  free (arg);
+
+  if ((len = session_broker_recv (fd, &type, &open_rq, sizeof (struct session_broker_open_rq))) <= 0)
+    {
+      if (len < 0)
+        IPMISESSIOND_DEBUG (("session_broker_recv: %s", strerror (errno)));
+      goto cleanup;
+    }
+
+  if (type != SESSION_BROKER_MSG_OPEN_RQ
+      || len != sizeof (struct session_broker_open_rq))
+    {
+      IPMISESSIOND_DEBUG (("invalid open request"));
+      goto cleanup;
+    }
+
+  open_rq.hostname[SESSION_BROKER_HOSTNAME_MAX] = '\0';
+  open_rq.username[SESSION_BROKER_USERNAME_MAX] = '\0';
+  open_rq.password[SESSION_BROKER_PASSWORD_MAX] = '\0';
+
+  if (open_rq.k_g_len > SESSION_BROKER_K_G_MAX)
+    open_rs.errnum = IPMI_ERR_PARAMETERS;
+  else if (!(s = _session_attach (&open_rq)))
+    open_rs.errnum = IPMI_ERR_BMC_BUSY;
+  else
+    {
+      pthread_mutex_lock (&(s->mutex));
+      if (!s->ipmi_ctx)
+        open_rs.errnum = _session_open (s);
+      else
+        open_rs.errnum = IPMI_ERR_SUCCESS;
+      pthread_mutex_unlock (&(s->mutex));
+    }
+
+  if (session_broker_send (fd,
+                           SESSION_BROKER_MSG_OPEN_RS,
+                           &open_rs,
+                           sizeof (struct session_broker_open_rs)) < 0)
+    {
+      IPMISESSIOND_DEBUG (("session_broker_send: %s", strerror (errno)));
+      goto cleanup;
+    }
+
+  if (open_rs.errnum != IPMI_ERR_SUCCESS)
+    goto cleanup;
+
+  while (exit_flag)
+    {
+      if ((len = session_broker_recv (fd, &type, &cmd_rq, sizeof (struct session_broker_cmd_rq))) <= 0)
+        {
+          if (len < 0)
+            IPMISESSIOND_DEBUG (("session_broker_recv: %s", strerror (errno)));
+          goto cleanup;
+        }
+
+      if (type != SESSION_BROKER_MSG_CMD_RQ
+          || len != sizeof (struct session_broker_cmd_rq))
+        {
+          IPMISESSIOND_DEBUG (("invalid command request"));
+          goto cleanup;
+        }
+
+      _session_cmd (s, &cmd_rq, &cmd_rs);
+      _session_touch (s);
+
+      if (session_broker_send (fd,
+                               SESSION_BROKER_MSG_CMD_RS,
+                               &cmd_rs,
+                               sizeof (struct session_broker_cmd_rs)) < 0)
+        {
+          IPMISESSIOND_DEBUG (("session_broker_send: %s", strerror (errno)));
+          goto cleanup;
+        }
+    }
+
+ cleanup:
+  /* secure_memset b/c message contains ipmi password */
+  secure_memset (&open_rq, '\0', sizeof (struct session_broker_open_rq));
+  if (s)
+    _session_detach (s, 1);
+  /* ignore potential error, cleanup path */
+  close (fd);
+  return (NULL);
+}
+
+static void
+_client_accept (void)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  int *fdptr;
+  int fd;
+
+  if ((fd = accept (listen_fd, NULL, NULL)) < 0)
+    {
+      if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+        IPMISESSIOND_DEBUG (("accept: %s", strerror (errno)));
+      return;
+    }
+
+  if (!(fdptr = (int *)malloc (sizeof (int))))
+    {
+      err_output ("malloc: %s", strerror (errno));
+      /* ignore potential error, rejecting client */
+      close (fd);
+      return;
+    }
+  (*fdptr) = fd;
+
+  pthread_attr_init (&attr);
+  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+
+  if ((errno = pthread_create (&thread, &attr, _client_thread, fdptr)))
+    {
+      err_output ("pthread_create: %s", strerror (errno));
+      free (fdptr);
+      /* ignore potential error, rejecting client */
+      close (fd);
+    }
+
+  pthread_attr_destroy (&attr);
+}
+
+static int
+_listen_setup (const char *socket_path)
+{
+  struct sockaddr_un addr;
+  mode_t old_umask;
+
+  assert (socket_path);
+
+  if (strlen (socket_path) >= sizeof (addr.sun_path))
+    {
+      err_output ("socket path '%s' too long", socket_path);
+      return (-1);
+    }
+
+  memset (&addr, '\0', sizeof (struct sockaddr_un));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, socket_path);
+
+  if ((listen_fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+      err_output ("socket: %s", strerror (errno));
+      return (-1);
+    }
+
+  /* a stale socket from a previous run */
+  (void) unlink (socket_path);
+
+  /* sessions are as sensitive as the BMC credentials, create the
+   * socket w/o group or other access so it is never reachable by
+   * other users
+   */
+  old_umask = umask (077);
+
+  if (bind (listen_fd, (struct sockaddr *)&addr, sizeof (struct sockaddr_un)) < 0)
+    {
+      err_output ("bind: %s: %s", socket_path, strerror (errno));
+      umask (old_umask);
+      return (-1);
+    }
+
+  umask (old_umask);
+
+  if (listen (listen_fd, IPMISESSIOND_LISTEN_BACKLOG) < 0)
+    {
+      err_output ("listen: %s", strerror (errno));
+      return (-1);
+    }
+
+  if (fcntl (listen_fd, F_SETFL, O_NONBLOCK) < 0)
+    {
+      err_output ("fcntl: %s", strerror (errno));
+      return (-1);
+    }
+
+  return (0);
+}
+
+/* Sessions in use by clients are left for the BMC to time out */
+static void
+_sessions_cleanup (void)
+{
+  ipmisessiond_session_t *s;
+  ListIterator itr;
+
+  pthread_mutex_lock (&sessions_mutex);
+
+  if ((itr = list_iterator_create (sessions)))
+    {
+      while ((s = list_next (itr)))
+        {
+          if (!s->clients)
+            {
+              list_remove (itr);
+              _session_destroy (s);
+            }
+        }
+      list_iterator_destroy (itr);
+    }
+
+  pthread_mutex_unlock (&sessions_mutex);
+}
+
+static int
+_ipmisessiond (void)
+{
+  pthread_t thread;
+  struct pollfd pfd;
+  int rv = -1;
+
+  debug_flag = args->debug;
+
+  if (!(sessions = list_create (NULL)))
+    {
+      err_output ("list_create: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  if (_listen_setup (args->socket_path) < 0)
+    goto cleanup;
+
+  if ((errno = pthread_create (&thread, NULL, _maintenance_thread, NULL)))
+    {
+      err_output ("pthread_create: %s", strerror (errno));
+      goto cleanup;
+    }
+
+  while (exit_flag)
+    {
+      pfd.fd = listen_fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+
+      if (poll (&pfd, 1, IPMISESSIOND_POLL_TIMEOUT) < 0)
+        {
+          if (errno != EINTR)
+            {
+              err_output ("poll: %s", strerror (errno));
+              exit_flag = 0;
+              break;
+            }
+          continue;
+        }
+
+      if (pfd.revents & POLLIN)
+        _client_accept ();
+    }
+
+  pthread_join (thread, NULL);
+
+  rv = 0;
+ cleanup:
+  if (listen_fd >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (listen_fd);
+      (void) unlink (args->socket_path);
+    }
+  if (sessions)
+    _sessions_cleanup ();
+  return (rv);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct ipmisessiond_arguments cmd_args;
+
+  err_init (argv[0]);
+  err_set_flags (ERROR_STDERR);
+
+  ipmi_disable_coredump ();
+
+  ipmisessiond_argp_parse (argc, argv, &cmd_args);
+  args = &cmd_args;
+
+  if (!cmd_args.foreground)
+    {
+      daemonize_common (IPMISESSIOND_PIDFILE);
+      err_set_flags (ERROR_SYSLOG);
+    }
+  else
+    err_set_flags (ERROR_STDERR);
+
+  daemon_signal_handler_setup (_signal_handler_callback);
+
+  /* clients may go away at any time */
+  if (signal (SIGPIPE, SIG_IGN) == SIG_ERR)
+    err_exit ("signal: %s", strerror (errno));
+
+  /* Call after daemonization, since daemonization closes currently
+   * open fds
+   */
+  if (argv[0][0] == '/')
+    argv[0] = strrchr(argv[0], '/') + 1;
+  openlog (argv[0], LOG_ODELAY | LOG_PID, LOG_DAEMON);
+
+  return (_ipmisessiond ());
+}
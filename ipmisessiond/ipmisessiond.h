@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMISESSIOND_H
+#define IPMISESSIOND_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <pthread.h>
+#if TIME_WITH_SYS_TIME
+#include <sys/time.h>
+#include <time.h>
+#else /* !TIME_WITH_SYS_TIME */
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else /* !HAVE_SYS_TIME_H */
+#include <time.h>
+#endif /* !HAVE_SYS_TIME_H */
+#endif /* !TIME_WITH_SYS_TIME */
+
+#include <freeipmi/freeipmi.h>
+
+#include "session-broker.h"
+
+#define IPMISESSIOND_SOCKET_PATH_DEFAULT        IPMISESSIOND_LOCALSTATEDIR "/run/ipmisessiond.sock"
+
+#define IPMISESSIOND_IDLE_TIMEOUT_DEFAULT       300
+
+#define IPMISESSIOND_KEEPALIVE_INTERVAL_DEFAULT 20
+
+#define IPMISESSIOND_MAX_SESSIONS_DEFAULT       256
+
+enum ipmisessiond_argp_option_keys
+  {
+    IPMISESSIOND_SOCKET_PATH_KEY = 160,
+    IPMISESSIOND_IDLE_TIMEOUT_KEY = 161,
+    IPMISESSIOND_KEEPALIVE_INTERVAL_KEY = 162,
+    IPMISESSIOND_MAX_SESSIONS_KEY = 163,
+    IPMISESSIOND_FOREGROUND_KEY = 164,
+    IPMISESSIOND_DEBUG_KEY = 165,
+  };
+
+struct ipmisessiond_arguments
+{
+  char *socket_path;
+  unsigned int idle_timeout;
+  unsigned int keepalive_interval;
+  unsigned int max_sessions;
+  int foreground;
+  int debug;
+};
+
+/* One IPMI 2.0 session shared by every client that opens with the
+ * same BMC and credentials.  The session list, clients, last_used
+ * and last_active are protected by the global session list mutex,
+ * ipmi_ctx by the session's mutex, which also serializes commands to
+ * the BMC.  ipmi_ctx is NULL while the session is not established.
+ *
+ * last_used is the last client activity, last_active the last
+ * traffic with the BMC including keepalives.
+ */
+typedef struct ipmisessiond_session
+{
+  struct session_broker_open_rq key;
+  pthread_mutex_t mutex;
+  ipmi_ctx_t ipmi_ctx;
+  unsigned int clients;
+  time_t last_used;
+  time_t last_active;
+} ipmisessiond_session_t;
+
+#endif /* IPMISESSIOND_H */
@@ -52,6 +52,8 @@
 
 #include "freeipmi/api/ipmi-api.h"
 
+#include "rtt.h"
+
 #define IPMI_MAX_SIK_KEY_LENGTH                           64
 #define IPMI_MAX_INTEGRITY_KEY_LENGTH                     64
 #define IPMI_MAX_CONFIDENTIALITY_KEY_LENGTH               64
@@ -67,6 +69,10 @@
 
 #define MAXPORTBUFLEN 16
 
+#ifndef MAXPATHLEN
+#define MAXPATHLEN 4096
+#endif /* MAXPATHLEN */
+
 struct ipmi_ctx_target
 {
   uint8_t channel_number;       /* for ipmb */
@@ -89,6 +95,14 @@ struct ipmi_ctx
 
   struct ipmi_ctx_target target;
 
+  /* See ipmi_ctx_set_capability_cache(), empty string if disabled */
+  char capability_cache_directory[MAXPATHLEN+1];
+  unsigned int capability_cache_lifetime;
+
+  /* See ipmi_ctx_set_session_broker(), empty string if disabled */
+  char session_broker_socket_path[MAXPATHLEN+1];
+  int session_broker_attached;
+
   fiid_field_t      *tmpl_ipmb_cmd_rq;
   fiid_field_t      *tmpl_ipmb_cmd_rs;
 
@@ -157,6 +171,7 @@ struct ipmi_ctx
       uint8_t rq_seq;
       struct timeval last_send;
       struct timeval last_received;
+      struct rtt rtt;
       uint32_t highest_received_sequence_number;
       uint32_t previously_received_list;
 
@@ -40,6 +40,7 @@
 #endif  /* !TIME_WITH_SYS_TIME */
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <limits.h>
 #include <assert.h>
@@ -81,6 +82,7 @@
 #include "ipmi-lan-session-common.h"
 #include "ipmi-kcs-driver-api.h"
 #include "ipmi-openipmi-driver-api.h"
+#include "ipmi-session-broker-api.h"
 #include "ipmi-sunbmc-driver-api.h"
 #include "ipmi-ssif-driver-api.h"
 
@@ -219,7 +221,8 @@ ipmi_ctx_set_flags (ipmi_ctx_t ctx, unsigned int flags)
                              | IPMI_FLAGS_DEBUG_DUMP
                              | IPMI_FLAGS_NO_VALID_CHECK
                              | IPMI_FLAGS_NO_LEGAL_CHECK
-                             | IPMI_FLAGS_IGNORE_AUTHENTICATION_CODE);
+                             | IPMI_FLAGS_IGNORE_AUTHENTICATION_CODE
+                             | IPMI_FLAGS_FIXED_RETRANSMISSION_TIMEOUT);
 
   if (!ctx || ctx->magic != IPMI_CTX_MAGIC)
     {
@@ -489,7 +492,8 @@ ipmi_ctx_open_outofband (ipmi_ctx_t ctx,
   unsigned int flags_mask = (IPMI_FLAGS_NOSESSION
                              | IPMI_FLAGS_DEBUG_DUMP
                              | IPMI_FLAGS_NO_VALID_CHECK
-                             | IPMI_FLAGS_NO_LEGAL_CHECK);
+                             | IPMI_FLAGS_NO_LEGAL_CHECK
+                             | IPMI_FLAGS_FIXED_RETRANSMISSION_TIMEOUT);
 
   if (!ctx || ctx->magic != IPMI_CTX_MAGIC)
     {
@@ -545,6 +549,7 @@ ipmi_ctx_open_outofband (ipmi_ctx_t ctx,
 
   memset (&ctx->io.outofband.last_send, '\0', sizeof (struct timeval));
   memset (&ctx->io.outofband.last_received, '\0', sizeof (struct timeval));
+  rtt_init (&ctx->io.outofband.rtt, ctx->io.outofband.retransmission_timeout);
 
   if (ipmi_check_session_sequence_number_1_5_init (&(ctx->io.outofband.highest_received_sequence_number),
                                                    &(ctx->io.outofband.previously_received_list)) < 0)
@@ -633,7 +638,8 @@ ipmi_ctx_open_outofband_2_0 (ipmi_ctx_t ctx,
                                         | IPMI_WORKAROUND_FLAGS_OUTOFBAND_2_0_NO_CHECKSUM_CHECK);
   unsigned int flags_mask = (IPMI_FLAGS_DEBUG_DUMP
                              | IPMI_FLAGS_NO_VALID_CHECK
-                             | IPMI_FLAGS_NO_LEGAL_CHECK);
+                             | IPMI_FLAGS_NO_LEGAL_CHECK
+                             | IPMI_FLAGS_FIXED_RETRANSMISSION_TIMEOUT);
 
   if (!ctx || ctx->magic != IPMI_CTX_MAGIC)
     {
@@ -670,6 +676,37 @@ ipmi_ctx_open_outofband_2_0 (ipmi_ctx_t ctx,
       return (-1);
     }
 
+  if (strlen (ctx->session_broker_socket_path))
+    {
+      int ret;
+
+      /* errnum set in api_session_broker_open */
+      if ((ret = api_session_broker_open (ctx,
+                                          hostname,
+                                          username,
+                                          password,
+                                          k_g,
+                                          k_g_len,
+                                          privilege_level,
+                                          cipher_suite_id,
+                                          session_timeout,
+                                          retransmission_timeout,
+                                          workaround_flags,
+                                          flags)) < 0)
+        return (-1);
+
+      if (ret)
+        {
+          ctx->type = IPMI_DEVICE_LAN_2_0;
+          ctx->workaround_flags_outofband_2_0 = workaround_flags;
+          ctx->flags = flags;
+          ctx->errnum = IPMI_ERR_SUCCESS;
+          return (0);
+        }
+
+      /* no broker running, establish our own session */
+    }
+
   ctx->type = IPMI_DEVICE_LAN_2_0;
   ctx->workaround_flags_outofband_2_0 = workaround_flags;
   ctx->flags = flags;
@@ -741,6 +778,7 @@ ipmi_ctx_open_outofband_2_0 (ipmi_ctx_t ctx,
   ctx->io.outofband.confidentiality_key_len = IPMI_MAX_CONFIDENTIALITY_KEY_LENGTH;
   memset (&ctx->io.outofband.last_send, '\0', sizeof (struct timeval));
   memset (&ctx->io.outofband.last_received, '\0', sizeof (struct timeval));
+  rtt_init (&ctx->io.outofband.rtt, ctx->io.outofband.retransmission_timeout);
 
   if (ipmi_check_session_sequence_number_2_0_init (&(ctx->io.outofband.highest_received_sequence_number),
                                                    &(ctx->io.outofband.previously_received_list)) < 0)
@@ -830,6 +868,71 @@ ipmi_ctx_open_outofband_2_0 (ipmi_ctx_t ctx,
   return (-1);
 }
 
+int
+ipmi_ctx_set_capability_cache (ipmi_ctx_t ctx,
+                               const char *directory,
+                               unsigned int lifetime)
+{
+  if (!ctx || ctx->magic != IPMI_CTX_MAGIC)
+    {
+      ERR_TRACE (ipmi_ctx_errormsg (ctx), ipmi_ctx_errnum (ctx));
+      return (-1);
+    }
+
+  if (directory && (!strlen (directory) || strlen (directory) > MAXPATHLEN))
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_PARAMETERS);
+      return (-1);
+    }
+
+  if (ctx->type != IPMI_DEVICE_UNKNOWN)
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_DEVICE_ALREADY_OPEN);
+      return (-1);
+    }
+
+  memset (ctx->capability_cache_directory, '\0', MAXPATHLEN + 1);
+  if (directory)
+    strcpy (ctx->capability_cache_directory, directory);
+  ctx->capability_cache_lifetime = (lifetime ? lifetime : IPMI_CAPABILITY_CACHE_LIFETIME_DEFAULT);
+
+  ctx->errnum = IPMI_ERR_SUCCESS;
+  return (0);
+}
+
+int
+ipmi_ctx_set_session_broker (ipmi_ctx_t ctx, const char *socket_path)
+{
+  struct sockaddr_un addr;
+
+  if (!ctx || ctx->magic != IPMI_CTX_MAGIC)
+    {
+      ERR_TRACE (ipmi_ctx_errormsg (ctx), ipmi_ctx_errnum (ctx));
+      return (-1);
+    }
+
+  if (socket_path
+      && (!strlen (socket_path)
+          || strlen (socket_path) >= sizeof (addr.sun_path)))
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_PARAMETERS);
+      return (-1);
+    }
+
+  if (ctx->type != IPMI_DEVICE_UNKNOWN)
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_DEVICE_ALREADY_OPEN);
+      return (-1);
+    }
+
+  memset (ctx->session_broker_socket_path, '\0', MAXPATHLEN + 1);
+  if (socket_path)
+    strcpy (ctx->session_broker_socket_path, socket_path);
+
+  ctx->errnum = IPMI_ERR_SUCCESS;
+  return (0);
+}
+
 int
 ipmi_ctx_open_inband (ipmi_ctx_t ctx,
                       ipmi_driver_type_t driver_type,
@@ -1650,11 +1753,12 @@ ipmi_cmd (ipmi_ctx_t ctx,
 
   if (ctx->flags & IPMI_FLAGS_DEBUG_DUMP)
     {
-      /* lan packets are dumped in ipmi lan code */
+      /* lan packets are dumped in ipmi lan code, unless brokered */
       /* kcs packets are dumped in kcs code */
       /* ssif packets are dumped in ssif code */
       if (ctx->type != IPMI_DEVICE_LAN
-          && ctx->type != IPMI_DEVICE_LAN_2_0
+          && (ctx->type != IPMI_DEVICE_LAN_2_0
+              || ctx->session_broker_attached)
           && ctx->type != IPMI_DEVICE_KCS
           && ctx->type != IPMI_DEVICE_SSIF)
         {
@@ -1722,8 +1826,11 @@ ipmi_cmd (ipmi_ctx_t ctx,
     }
   else if (ctx->type == IPMI_DEVICE_LAN_2_0)
     {
-      if (ctx->target.channel_number_is_set
-          && ctx->target.rs_addr_is_set)
+      /* the broker bridges with ipmb itself */
+      if (ctx->session_broker_attached)
+        rv = api_session_broker_cmd (ctx, obj_cmd_rq, obj_cmd_rs);
+      else if (ctx->target.channel_number_is_set
+               && ctx->target.rs_addr_is_set)
         rv = api_lan_2_0_cmd_ipmb (ctx,
                                    obj_cmd_rq,
                                    obj_cmd_rs);
@@ -1784,11 +1891,12 @@ ipmi_cmd (ipmi_ctx_t ctx,
 
   if (ctx->flags & IPMI_FLAGS_DEBUG_DUMP)
     {
-      /* lan packets are dumped in ipmi lan code */
+      /* lan packets are dumped in ipmi lan code, unless brokered */
       /* kcs packets are dumped in kcs code */
       /* ssif packets are dumped in ssif code */
       if (ctx->type != IPMI_DEVICE_LAN
-          && ctx->type != IPMI_DEVICE_LAN_2_0
+          && (ctx->type != IPMI_DEVICE_LAN_2_0
+              || ctx->session_broker_attached)
           && ctx->type != IPMI_DEVICE_KCS
           && ctx->type != IPMI_DEVICE_SSIF)
         {
@@ -1950,11 +2058,12 @@ ipmi_cmd_raw (ipmi_ctx_t ctx,
 
   if (ctx->flags & IPMI_FLAGS_DEBUG_DUMP)
     {
-      /* lan packets are dumped in ipmi lan code */
+      /* lan packets are dumped in ipmi lan code, unless brokered */
       /* kcs packets are dumped in kcs code */
       /* ssif packets are dumped in ssif code */
       if (ctx->type != IPMI_DEVICE_LAN
-          && ctx->type != IPMI_DEVICE_LAN_2_0
+          && (ctx->type != IPMI_DEVICE_LAN_2_0
+              || ctx->session_broker_attached)
           && ctx->type != IPMI_DEVICE_KCS
           && ctx->type != IPMI_DEVICE_SSIF)
         {
@@ -2000,8 +2109,11 @@ ipmi_cmd_raw (ipmi_ctx_t ctx,
     }
   else if (ctx->type == IPMI_DEVICE_LAN_2_0)
     {
-      if (ctx->target.channel_number_is_set
-          && ctx->target.rs_addr_is_set)
+      /* the broker bridges with ipmb itself */
+      if (ctx->session_broker_attached)
+        rv = api_session_broker_cmd_raw (ctx, buf_rq, buf_rq_len, buf_rs, buf_rs_len);
+      else if (ctx->target.channel_number_is_set
+               && ctx->target.rs_addr_is_set)
         rv = api_lan_2_0_cmd_raw_ipmb (ctx,
                                        buf_rq,
                                        buf_rq_len,
@@ -2072,11 +2184,12 @@ ipmi_cmd_raw (ipmi_ctx_t ctx,
 
   if (ctx->flags & IPMI_FLAGS_DEBUG_DUMP && rv >= 0)
     {
-      /* lan packets are dumped in ipmi lan code */
+      /* lan packets are dumped in ipmi lan code, unless brokered */
       /* kcs packets are dumped in kcs code */
       /* ssif packets are dumped in ssif code */
       if (ctx->type != IPMI_DEVICE_LAN
-          && ctx->type != IPMI_DEVICE_LAN_2_0
+          && (ctx->type != IPMI_DEVICE_LAN_2_0
+              || ctx->session_broker_attached)
           && ctx->type != IPMI_DEVICE_KCS
           && ctx->type != IPMI_DEVICE_SSIF)
         {
@@ -2258,6 +2371,9 @@ ipmi_ctx_close (ipmi_ctx_t ctx)
 
   if (ctx->type == IPMI_DEVICE_LAN)
     _ipmi_outofband_close (ctx);
+  else if (ctx->type == IPMI_DEVICE_LAN_2_0
+           && ctx->session_broker_attached)
+    api_session_broker_close (ctx);
   else if (ctx->type == IPMI_DEVICE_LAN_2_0)
     _ipmi_outofband_2_0_close (ctx);
   else
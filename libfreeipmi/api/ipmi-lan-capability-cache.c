@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+#if TIME_WITH_SYS_TIME
+#include <sys/time.h>
+#include <time.h>
+#else /* !TIME_WITH_SYS_TIME */
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else /* !HAVE_SYS_TIME_H */
+#include <time.h>
+#endif /* !HAVE_SYS_TIME_H */
+#endif  /* !TIME_WITH_SYS_TIME */
+#include <assert.h>
+#include <errno.h>
+
+#include "freeipmi/fiid/fiid.h"
+
+#include "ipmi-api-defs.h"
+#include "ipmi-api-trace.h"
+#include "ipmi-lan-capability-cache.h"
+
+#include "freeipmi-portability.h"
+#include "fd.h"
+
+/* Cache file format
+ *
+ * 8 bytes - magic
+ * 1 byte  - version
+ * 1 byte  - privilege level the capabilities were requested at
+ * 1 byte  - response length
+ * N bytes - Get Channel Authentication Capabilities response
+ *
+ * Freshness is determined by the file's modification time.
+ */
+#define IPMI_LAN_CAPABILITY_CACHE_MAGIC     "FIPMICAP"
+#define IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN 8
+#define IPMI_LAN_CAPABILITY_CACHE_VERSION   1
+#define IPMI_LAN_CAPABILITY_CACHE_HDR_LEN   (IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN + 3)
+
+#define IPMI_LAN_CAPABILITY_CACHE_BUFLEN    256
+
+static int
+_capability_cache_filename (ipmi_ctx_t ctx, char *buf, unsigned int buflen)
+{
+  uint16_t port = 0;
+  char *p;
+  int len;
+
+  assert (ctx);
+  assert (ctx->magic == IPMI_CTX_MAGIC);
+  assert (ctx->type == IPMI_DEVICE_LAN_2_0);
+  assert (buf);
+  assert (buflen);
+
+  if (ctx->io.outofband.remote_host == (struct sockaddr *)&(ctx->io.outofband.remote_host4))
+    port = ntohs (ctx->io.outofband.remote_host4.sin_port);
+  else if (ctx->io.outofband.remote_host == (struct sockaddr *)&(ctx->io.outofband.remote_host6))
+    port = ntohs (ctx->io.outofband.remote_host6.sin6_port);
+
+  len = snprintf (buf,
+                  buflen,
+                  "%s/capability-cache-%s-%u-%u",
+                  ctx->capability_cache_directory,
+                  ctx->io.outofband.hostname,
+                  port,
+                  ctx->io.outofband.privilege_level);
+  if (len < 0 || len >= buflen)
+    return (-1);
+
+  /* don't let a hostname escape the cache directory */
+  p = buf + strlen (ctx->capability_cache_directory) + 1;
+  while ((p = strchr (p, '/')))
+    *p = '_';
+
+  return (0);
+}
+
+int
+api_lan_capability_cache_load (ipmi_ctx_t ctx, fiid_obj_t obj_cmd_rs)
+{
+  char filename[MAXPATHLEN + 1];
+  uint8_t buf[IPMI_LAN_CAPABILITY_CACHE_BUFLEN];
+  struct stat statbuf;
+  time_t now;
+  ssize_t n;
+  int fd = -1;
+  int rv = 0;
+
+  assert (ctx);
+  assert (ctx->magic == IPMI_CTX_MAGIC);
+  assert (fiid_obj_valid (obj_cmd_rs));
+
+  if (!strlen (ctx->capability_cache_directory))
+    return (0);
+
+  if (_capability_cache_filename (ctx, filename, MAXPATHLEN + 1) < 0)
+    return (0);
+
+  if ((fd = open (filename, O_RDONLY)) < 0)
+    return (0);
+
+  if (fstat (fd, &statbuf) < 0)
+    {
+      ERRNO_TRACE (errno);
+      goto cleanup;
+    }
+
+  now = time (NULL);
+  if (statbuf.st_mtime > now
+      || (now - statbuf.st_mtime) >= ctx->capability_cache_lifetime)
+    goto cleanup;
+
+  if ((n = fd_read_n (fd, buf, IPMI_LAN_CAPABILITY_CACHE_BUFLEN)) < 0)
+    {
+      ERRNO_TRACE (errno);
+      goto cleanup;
+    }
+
+  if (n < IPMI_LAN_CAPABILITY_CACHE_HDR_LEN
+      || memcmp (buf, IPMI_LAN_CAPABILITY_CACHE_MAGIC, IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN)
+      || buf[IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN] != IPMI_LAN_CAPABILITY_CACHE_VERSION
+      || buf[IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN + 1] != ctx->io.outofband.privilege_level
+      || n != IPMI_LAN_CAPABILITY_CACHE_HDR_LEN + buf[IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN + 2])
+    goto cleanup;
+
+  if (fiid_obj_set_all (obj_cmd_rs,
+                        buf + IPMI_LAN_CAPABILITY_CACHE_HDR_LEN,
+                        n - IPMI_LAN_CAPABILITY_CACHE_HDR_LEN) < 0)
+    goto cleanup;
+
+  if (fiid_obj_packet_valid (obj_cmd_rs) != 1)
+    goto cleanup;
+
+  rv = 1;
+ cleanup:
+  if (!rv)
+    fiid_obj_clear (obj_cmd_rs);
+  /* ignore potential error, cleanup path */
+  close (fd);
+  return (rv);
+}
+
+void
+api_lan_capability_cache_store (ipmi_ctx_t ctx, fiid_obj_t obj_cmd_rs)
+{
+  char filename[MAXPATHLEN + 1];
+  char tmpfilename[MAXPATHLEN + 1];
+  uint8_t buf[IPMI_LAN_CAPABILITY_CACHE_BUFLEN];
+  int len;
+  int fd = -1;
+
+  assert (ctx);
+  assert (ctx->magic == IPMI_CTX_MAGIC);
+  assert (fiid_obj_valid (obj_cmd_rs));
+
+  if (!strlen (ctx->capability_cache_directory))
+    return;
+
+  if (_capability_cache_filename (ctx, filename, MAXPATHLEN + 1) < 0)
+    return;
+
+  len = snprintf (tmpfilename, MAXPATHLEN + 1, "%s.XXXXXX", filename);
+  if (len < 0 || len > MAXPATHLEN)
+    return;
+
+  memcpy (buf, IPMI_LAN_CAPABILITY_CACHE_MAGIC, IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN);
+  buf[IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN] = IPMI_LAN_CAPABILITY_CACHE_VERSION;
+  buf[IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN + 1] = ctx->io.outofband.privilege_level;
+
+  if ((len = fiid_obj_get_all (obj_cmd_rs,
+                               buf + IPMI_LAN_CAPABILITY_CACHE_HDR_LEN,
+                               IPMI_LAN_CAPABILITY_CACHE_BUFLEN - IPMI_LAN_CAPABILITY_CACHE_HDR_LEN)) < 0)
+    return;
+  buf[IPMI_LAN_CAPABILITY_CACHE_MAGIC_LEN + 2] = len;
+
+  /* Write to a temporary file and rename, so concurrent readers
+   * never see a partially written cache.
+   */
+  if ((fd = mkstemp (tmpfilename)) < 0)
+    {
+      ERRNO_TRACE (errno);
+      return;
+    }
+
+  if (fd_write_n (fd, buf, IPMI_LAN_CAPABILITY_CACHE_HDR_LEN + len) < 0)
+    {
+      ERRNO_TRACE (errno);
+      goto cleanup;
+    }
+
+  if (close (fd) < 0)
+    {
+      ERRNO_TRACE (errno);
+      fd = -1;
+      goto cleanup;
+    }
+  fd = -1;
+
+  if (rename (tmpfilename, filename) < 0)
+    {
+      ERRNO_TRACE (errno);
+      goto cleanup;
+    }
+
+  return;
+
+ cleanup:
+  /* ignore potential error, cleanup path */
+  if (fd >= 0)
+    close (fd);
+  unlink (tmpfilename);
+}
+
+void
+api_lan_capability_cache_invalidate (ipmi_ctx_t ctx)
+{
+  char filename[MAXPATHLEN + 1];
+
+  assert (ctx);
+  assert (ctx->magic == IPMI_CTX_MAGIC);
+
+  if (!strlen (ctx->capability_cache_directory))
+    return;
+
+  if (_capability_cache_filename (ctx, filename, MAXPATHLEN + 1) < 0)
+    return;
+
+  /* ignore potential error, cache may not exist */
+  unlink (filename);
+}
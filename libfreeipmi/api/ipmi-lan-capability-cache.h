@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMI_LAN_CAPABILITY_CACHE_H
+#define IPMI_LAN_CAPABILITY_CACHE_H
+
+#include <freeipmi/api/ipmi-api.h>
+#include <freeipmi/fiid/fiid.h>
+
+/* On disk cache of Get Channel Authentication Capabilities responses,
+ * see ipmi_ctx_set_capability_cache().  The cache is only an
+ * optimization, so any problem reading or writing it is treated as a
+ * cache miss and never returned as an error.
+ */
+
+/* Returns 1 if a fresh cached response was loaded into obj_cmd_rs, 0
+ * if not
+ */
+int api_lan_capability_cache_load (ipmi_ctx_t ctx, fiid_obj_t obj_cmd_rs);
+
+void api_lan_capability_cache_store (ipmi_ctx_t ctx, fiid_obj_t obj_cmd_rs);
+
+void api_lan_capability_cache_invalidate (ipmi_ctx_t ctx);
+
+#endif /* IPMI_LAN_CAPABILITY_CACHE_H */
@@ -70,6 +70,7 @@
 #include "ipmi-api-defs.h"
 #include "ipmi-api-trace.h"
 #include "ipmi-api-util.h"
+#include "ipmi-lan-capability-cache.h"
 #include "ipmi-lan-session-common.h"
 
 #include "libcommon/ipmi-fiid-util.h"
@@ -172,6 +173,7 @@ _calculate_timeout (ipmi_ctx_t ctx,
   struct timeval retransmission_timeout_len;
   struct timeval retransmission_timeout_val;
   struct timeval already_timedout_check;
+  unsigned int retransmission_timeout_base;
   unsigned int retransmission_timeout_multiplier;
 
   assert (ctx
@@ -193,10 +195,15 @@ _calculate_timeout (ipmi_ctx_t ctx,
   timeradd (recv_starttime, &session_timeout_len, &session_timeout);
   timersub (&session_timeout, recv_starttime, &session_timeout_val);
 
+  if (ctx->flags & IPMI_FLAGS_FIXED_RETRANSMISSION_TIMEOUT)
+    retransmission_timeout_base = ctx->io.outofband.retransmission_timeout;
+  else
+    retransmission_timeout_base = rtt_timeout (&ctx->io.outofband.rtt);
+
   retransmission_timeout_multiplier = (retransmission_count / IPMI_LAN_BACKOFF_COUNT) + 1;
 
-  retransmission_timeout_len.tv_sec = (retransmission_timeout_multiplier * ctx->io.outofband.retransmission_timeout) / 1000;
-  retransmission_timeout_len.tv_usec = ((retransmission_timeout_multiplier * ctx->io.outofband.retransmission_timeout) - (retransmission_timeout_len.tv_sec * 1000)) * 1000;
+  retransmission_timeout_len.tv_sec = (retransmission_timeout_multiplier * retransmission_timeout_base) / 1000;
+  retransmission_timeout_len.tv_usec = ((retransmission_timeout_multiplier * retransmission_timeout_base) - (retransmission_timeout_len.tv_sec * 1000)) * 1000;
 
   timeradd (&ctx->io.outofband.last_send, &retransmission_timeout_len, &retransmission_timeout);
   timersub (&retransmission_timeout, recv_starttime, &retransmission_timeout_val);
@@ -225,6 +232,25 @@ _calculate_timeout (ipmi_ctx_t ctx,
   return (1);
 }
 
+/* Responses to retransmitted requests aren't sampled, they can't be
+ * matched to the transmission they answer (Karn's algorithm).
+ */
+static void
+_api_lan_rtt_sample (ipmi_ctx_t ctx, unsigned int retransmission_count)
+{
+  assert (ctx
+          && ctx->magic == IPMI_CTX_MAGIC
+          && (ctx->type == IPMI_DEVICE_LAN
+              || ctx->type == IPMI_DEVICE_LAN_2_0));
+
+  if (retransmission_count)
+    return;
+
+  rtt_sample (&ctx->io.outofband.rtt,
+              &ctx->io.outofband.last_send,
+              &ctx->io.outofband.last_received);
+}
+
 static int
 _api_lan_recvfrom (ipmi_ctx_t ctx,
                    void *pkt,
@@ -1124,6 +1150,8 @@ api_lan_cmd_wrapper (ipmi_ctx_t ctx,
           return (-1);
         }
 
+      _api_lan_rtt_sample (ctx, retransmission_count);
+
       rv = 0;
       break;
     }
@@ -3128,6 +3156,8 @@ api_lan_2_0_cmd_wrapper (ipmi_ctx_t ctx,
           goto cleanup;
         }
 
+      _api_lan_rtt_sample (ctx, retransmission_count);
+
       rv = 0;
       break;
     }
@@ -3364,8 +3394,10 @@ api_lan_2_0_cmd_wrapper_ipmb (ipmi_ctx_t ctx,
   return (rv);
 }
 
-int
-api_lan_2_0_open_session (ipmi_ctx_t ctx)
+static int
+_api_lan_2_0_open_session (ipmi_ctx_t ctx,
+                           int use_capability_cache,
+                           int *capability_cache_used)
 {
   fiid_obj_t obj_cmd_rq = NULL;
   fiid_obj_t obj_cmd_rs = NULL;
@@ -3405,7 +3437,10 @@ api_lan_2_0_open_session (ipmi_ctx_t ctx)
           && ctx->io.outofband.integrity_key_ptr == ctx->io.outofband.integrity_key
           && ctx->io.outofband.integrity_key_len == IPMI_MAX_INTEGRITY_KEY_LENGTH
           && ctx->io.outofband.confidentiality_key_ptr == ctx->io.outofband.confidentiality_key
-          && ctx->io.outofband.confidentiality_key_len == IPMI_MAX_CONFIDENTIALITY_KEY_LENGTH);
+          && ctx->io.outofband.confidentiality_key_len == IPMI_MAX_CONFIDENTIALITY_KEY_LENGTH
+          && capability_cache_used);
+
+  (*capability_cache_used) = 0;
 
   if (_api_lan_rq_seq_init (ctx) < 0)
     goto cleanup;
@@ -3435,20 +3470,24 @@ api_lan_2_0_open_session (ipmi_ctx_t ctx)
       goto cleanup;
     }
 
+  if (use_capability_cache)
+    (*capability_cache_used) = api_lan_capability_cache_load (ctx, obj_cmd_rs);
+
   /* This portion of the protocol is sent via IPMI 1.5 */
-  if (api_lan_cmd_wrapper (ctx,
-                           0,
-                           IPMI_BMC_IPMB_LUN_BMC,
-                           IPMI_NET_FN_APP_RQ,
-                           IPMI_AUTHENTICATION_TYPE_NONE,
-                           0,
-                           NULL,
-                           0,
-                           &(ctx->io.outofband.rq_seq),
-                           NULL,
-                           0,
-                           obj_cmd_rq,
-                           obj_cmd_rs) < 0)
+  if (!(*capability_cache_used)
+      && api_lan_cmd_wrapper (ctx,
+                              0,
+                              IPMI_BMC_IPMB_LUN_BMC,
+                              IPMI_NET_FN_APP_RQ,
+                              IPMI_AUTHENTICATION_TYPE_NONE,
+                              0,
+                              NULL,
+                              0,
+                              &(ctx->io.outofband.rq_seq),
+                              NULL,
+                              0,
+                              obj_cmd_rq,
+                              obj_cmd_rs) < 0)
     {
       /* at this point in the protocol, we set a connection timeout */
       if (ctx->errnum == IPMI_ERR_SESSION_TIMEOUT)
@@ -3519,6 +3558,9 @@ api_lan_2_0_open_session (ipmi_ctx_t ctx)
         }
     }
 
+  if (!(*capability_cache_used))
+    api_lan_capability_cache_store (ctx, obj_cmd_rs);
+
   fiid_obj_destroy (obj_cmd_rq);
   obj_cmd_rq = NULL;
   fiid_obj_destroy (obj_cmd_rs);
@@ -3637,7 +3679,15 @@ api_lan_2_0_open_session (ipmi_ctx_t ctx)
                                0,
                                obj_cmd_rq,
                                obj_cmd_rs) < 0)
-    goto cleanup;
+    {
+      /* with a cached capabilities response, this is the first
+       * packet sent to the BMC, so set a connection timeout
+       */
+      if ((*capability_cache_used)
+          && ctx->errnum == IPMI_ERR_SESSION_TIMEOUT)
+        API_SET_ERRNUM (ctx, IPMI_ERR_CONNECTION_TIMEOUT);
+      goto cleanup;
+    }
 
   if (FIID_OBJ_GET (obj_cmd_rs,
                     "rmcpplus_status_code",
@@ -4289,6 +4339,42 @@ api_lan_2_0_open_session (ipmi_ctx_t ctx)
   return (rv);
 }
 
+int
+api_lan_2_0_open_session (ipmi_ctx_t ctx)
+{
+  int capability_cache_used = 0;
+
+  assert (ctx
+          && ctx->magic == IPMI_CTX_MAGIC
+          && ctx->type == IPMI_DEVICE_LAN_2_0);
+
+  if (!_api_lan_2_0_open_session (ctx, 1, &capability_cache_used))
+    return (0);
+
+  if (!capability_cache_used)
+    return (-1);
+
+  /* The cached capabilities may be stale.  If the BMC did not answer
+   * at all, don't double the wait by retrying, but don't keep using
+   * the cache either.  If the BMC answered unexpectedly, retry once
+   * with freshly queried capabilities.
+   */
+  if (ctx->errnum == IPMI_ERR_CONNECTION_TIMEOUT)
+    {
+      api_lan_capability_cache_invalidate (ctx);
+      return (-1);
+    }
+
+  if (ctx->errnum != IPMI_ERR_USERNAME_INVALID
+      && ctx->errnum != IPMI_ERR_K_G_INVALID
+      && ctx->errnum != IPMI_ERR_SESSION_TIMEOUT)
+    return (-1);
+
+  api_lan_capability_cache_invalidate (ctx);
+
+  return (_api_lan_2_0_open_session (ctx, 0, &capability_cache_used));
+}
+
 int
 api_lan_2_0_close_session (ipmi_ctx_t ctx)
 {
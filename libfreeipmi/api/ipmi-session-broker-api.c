@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#include <assert.h>
+#include <errno.h>
+
+#include "freeipmi/fiid/fiid.h"
+
+#include "ipmi-api-defs.h"
+#include "ipmi-api-trace.h"
+#include "ipmi-session-broker-api.h"
+
+#include "freeipmi-portability.h"
+#include "secure.h"
+#include "session-broker.h"
+
+/* Returns 1 if connected, 0 if no broker is running, -1 on error */
+static int
+_session_broker_connect (ipmi_ctx_t ctx, int *fd_out)
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  assert (ctx);
+  assert (strlen (ctx->session_broker_socket_path));
+  assert (fd_out);
+
+  if (strlen (ctx->session_broker_socket_path) >= sizeof (addr.sun_path))
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_PARAMETERS);
+      return (-1);
+    }
+
+  memset (&addr, '\0', sizeof (struct sockaddr_un));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, ctx->session_broker_socket_path);
+
+  if ((fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+      API_ERRNO_TO_API_ERRNUM (ctx, errno);
+      return (-1);
+    }
+
+  if (connect (fd, (struct sockaddr *)&addr, sizeof (struct sockaddr_un)) < 0)
+    {
+      /* no broker running, or one this user may not use (the
+       * socket is private to the broker's owner), caller
+       * establishes its own session
+       */
+      if (errno == ENOENT
+          || errno == ECONNREFUSED
+          || errno == EACCES
+          || errno == EPERM)
+        {
+          /* ignore potential error, cleanup path */
+          close (fd);
+          return (0);
+        }
+      API_ERRNO_TO_API_ERRNUM (ctx, errno);
+      /* ignore potential error, cleanup path */
+      close (fd);
+      return (-1);
+    }
+
+  (*fd_out) = fd;
+  return (1);
+}
+
+/* Returns 0 on success, -1 on error with errnum set */
+static int
+_session_broker_transaction (ipmi_ctx_t ctx,
+                             uint32_t rq_type,
+                             const void *rq,
+                             unsigned int rq_len,
+                             uint32_t rs_type,
+                             void *rs,
+                             unsigned int rs_len)
+{
+  uint32_t type;
+  int len;
+
+  assert (ctx);
+  assert (ctx->session_broker_attached);
+  assert (rq);
+  assert (rs);
+
+  if (session_broker_send (ctx->io.outofband.sockfd, rq_type, rq, rq_len) < 0)
+    {
+      API_ERRNO_TO_API_ERRNUM (ctx, errno);
+      return (-1);
+    }
+
+  if ((len = session_broker_recv (ctx->io.outofband.sockfd, &type, rs, rs_len)) < 0)
+    {
+      API_ERRNO_TO_API_ERRNUM (ctx, errno);
+      return (-1);
+    }
+
+  /* broker went away */
+  if (!len)
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_SYSTEM_ERROR);
+      return (-1);
+    }
+
+  if (type != rs_type || len != rs_len)
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_SYSTEM_ERROR);
+      return (-1);
+    }
+
+  return (0);
+}
+
+static void
+_session_broker_set_errnum (ipmi_ctx_t ctx, int32_t errnum)
+{
+  assert (ctx);
+
+  if (errnum > IPMI_ERR_SUCCESS && errnum < IPMI_ERR_ERRNUMRANGE)
+    API_SET_ERRNUM (ctx, errnum);
+  else
+    API_SET_ERRNUM (ctx, IPMI_ERR_SYSTEM_ERROR);
+}
+
+int
+api_session_broker_open (ipmi_ctx_t ctx,
+                         const char *hostname,
+                         const char *username,
+                         const char *password,
+                         const unsigned char *k_g,
+                         unsigned int k_g_len,
+                         uint8_t privilege_level,
+                         uint8_t cipher_suite_id,
+                         unsigned int session_timeout,
+                         unsigned int retransmission_timeout,
+                         unsigned int workaround_flags,
+                         unsigned int flags)
+{
+  struct session_broker_open_rq open_rq;
+  struct session_broker_open_rs open_rs;
+  int fd, ret;
+  int rv = -1;
+
+  assert (ctx
+          && ctx->magic == IPMI_CTX_MAGIC
+          && ctx->type == IPMI_DEVICE_UNKNOWN
+          && hostname);
+
+  /* parameters were checked by caller, so fit in the message */
+  memset (&open_rq, '\0', sizeof (struct session_broker_open_rq));
+
+  if (strlen (hostname) > SESSION_BROKER_HOSTNAME_MAX)
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_PARAMETERS);
+      return (-1);
+    }
+
+  if ((ret = _session_broker_connect (ctx, &fd)) <= 0)
+    return (ret);
+
+  ctx->io.outofband.sockfd = fd;
+  ctx->session_broker_attached = 1;
+
+  strcpy (open_rq.hostname, hostname);
+  if (username)
+    strcpy (open_rq.username, username);
+  if (password)
+    strcpy (open_rq.password, password);
+  if (k_g && k_g_len)
+    {
+      memcpy (open_rq.k_g, k_g, k_g_len);
+      open_rq.k_g_len = k_g_len;
+    }
+  open_rq.privilege_level = privilege_level;
+  open_rq.cipher_suite_id = cipher_suite_id;
+  open_rq.session_timeout = session_timeout;
+  open_rq.retransmission_timeout = retransmission_timeout;
+  open_rq.workaround_flags = workaround_flags;
+  /* debug dumps of the broker's packets are the broker's business */
+  open_rq.flags = (flags & ~IPMI_FLAGS_DEBUG_DUMP);
+
+  if (_session_broker_transaction (ctx,
+                                   SESSION_BROKER_MSG_OPEN_RQ,
+                                   &open_rq,
+                                   sizeof (struct session_broker_open_rq),
+                                   SESSION_BROKER_MSG_OPEN_RS,
+                                   &open_rs,
+                                   sizeof (struct session_broker_open_rs)) < 0)
+    goto cleanup;
+
+  if (open_rs.errnum != IPMI_ERR_SUCCESS)
+    {
+      _session_broker_set_errnum (ctx, open_rs.errnum);
+      goto cleanup;
+    }
+
+  rv = 1;
+ cleanup:
+  /* secure_memset b/c message contains ipmi password */
+  secure_memset (&open_rq, '\0', sizeof (struct session_broker_open_rq));
+  if (rv < 0)
+    api_session_broker_close (ctx);
+  return (rv);
+}
+
+int
+api_session_broker_cmd (ipmi_ctx_t ctx,
+                        fiid_obj_t obj_cmd_rq,
+                        fiid_obj_t obj_cmd_rs)
+{
+  uint8_t buf_rq[SESSION_BROKER_BUFLEN];
+  uint8_t buf_rs[SESSION_BROKER_BUFLEN];
+  int buf_rq_len, buf_rs_len;
+
+  assert (ctx
+          && ctx->magic == IPMI_CTX_MAGIC
+          && ctx->type == IPMI_DEVICE_LAN_2_0
+          && ctx->session_broker_attached
+          && fiid_obj_valid (obj_cmd_rq)
+          && fiid_obj_packet_valid (obj_cmd_rq) == 1
+          && fiid_obj_valid (obj_cmd_rs));
+
+  if ((buf_rq_len = fiid_obj_get_all (obj_cmd_rq,
+                                      buf_rq,
+                                      SESSION_BROKER_BUFLEN)) < 0)
+    {
+      API_FIID_OBJECT_ERROR_TO_API_ERRNUM (ctx, obj_cmd_rq);
+      return (-1);
+    }
+
+  if ((buf_rs_len = api_session_broker_cmd_raw (ctx,
+                                                buf_rq,
+                                                buf_rq_len,
+                                                buf_rs,
+                                                SESSION_BROKER_BUFLEN)) < 0)
+    return (-1);
+
+  if (fiid_obj_clear (obj_cmd_rs) < 0)
+    {
+      API_FIID_OBJECT_ERROR_TO_API_ERRNUM (ctx, obj_cmd_rs);
+      return (-1);
+    }
+
+  if (fiid_obj_set_all (obj_cmd_rs, buf_rs, buf_rs_len) < 0)
+    {
+      API_FIID_OBJECT_ERROR_TO_API_ERRNUM (ctx, obj_cmd_rs);
+      return (-1);
+    }
+
+  return (0);
+}
+
+int
+api_session_broker_cmd_raw (ipmi_ctx_t ctx,
+                            const void *buf_rq,
+                            unsigned int buf_rq_len,
+                            void *buf_rs,
+                            unsigned int buf_rs_len)
+{
+  struct session_broker_cmd_rq cmd_rq;
+  struct session_broker_cmd_rs cmd_rs;
+
+  assert (ctx
+          && ctx->magic == IPMI_CTX_MAGIC
+          && ctx->type == IPMI_DEVICE_LAN_2_0
+          && ctx->session_broker_attached
+          && buf_rq
+          && buf_rq_len
+          && buf_rs
+          && buf_rs_len);
+
+  if (buf_rq_len > SESSION_BROKER_BUFLEN)
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_PARAMETERS);
+      return (-1);
+    }
+
+  memset (&cmd_rq, '\0', sizeof (struct session_broker_cmd_rq));
+  cmd_rq.lun = ctx->target.lun;
+  cmd_rq.net_fn = ctx->target.net_fn;
+  if (ctx->target.channel_number_is_set
+      && ctx->target.rs_addr_is_set)
+    {
+      cmd_rq.ipmb = 1;
+      cmd_rq.channel_number = ctx->target.channel_number;
+      cmd_rq.rs_addr = ctx->target.rs_addr;
+    }
+  cmd_rq.buf_rs_len = (buf_rs_len < SESSION_BROKER_BUFLEN) ? buf_rs_len : SESSION_BROKER_BUFLEN;
+  cmd_rq.buf_rq_len = buf_rq_len;
+  memcpy (cmd_rq.buf_rq, buf_rq, buf_rq_len);
+
+  if (_session_broker_transaction (ctx,
+                                   SESSION_BROKER_MSG_CMD_RQ,
+                                   &cmd_rq,
+                                   sizeof (struct session_broker_cmd_rq),
+                                   SESSION_BROKER_MSG_CMD_RS,
+                                   &cmd_rs,
+                                   sizeof (struct session_broker_cmd_rs)) < 0)
+    return (-1);
+
+  if (cmd_rs.rv < 0)
+    {
+      _session_broker_set_errnum (ctx, cmd_rs.errnum);
+      return (-1);
+    }
+
+  if (cmd_rs.rv > cmd_rq.buf_rs_len)
+    {
+      API_SET_ERRNUM (ctx, IPMI_ERR_SYSTEM_ERROR);
+      return (-1);
+    }
+
+  memcpy (buf_rs, cmd_rs.buf_rs, cmd_rs.rv);
+  return (cmd_rs.rv);
+}
+
+void
+api_session_broker_close (ipmi_ctx_t ctx)
+{
+  assert (ctx && ctx->magic == IPMI_CTX_MAGIC);
+
+  /* the broker keeps the session open for the next client */
+  if (ctx->session_broker_attached)
+    {
+      /* ignore potential error, cleanup path */
+      close (ctx->io.outofband.sockfd);
+      ctx->io.outofband.sockfd = 0;
+      ctx->session_broker_attached = 0;
+    }
+}
@@ -163,6 +163,7 @@ typedef enum ipmi_driver_type ipmi_driver_type_t;
 
 #define IPMI_SESSION_TIMEOUT_DEFAULT                                        20000
 #define IPMI_RETRANSMISSION_TIMEOUT_DEFAULT                                 1000
+#define IPMI_CAPABILITY_CACHE_LIFETIME_DEFAULT                              86400
 
 #define IPMI_WORKAROUND_FLAGS_DEFAULT                                       0x00000000
 
@@ -226,6 +227,12 @@ typedef enum ipmi_driver_type ipmi_driver_type_t;
  * workaround flag, all authentication codes will be ignored during
  * the entire IPMI session.  With this flag, specific packets can have
  * their authentication codes ignored.
+ *
+ * FIXED_RETRANSMISSION_TIMEOUT - for outofband interfaces, always use
+ * the configured retransmission timeout.  By default, the
+ * retransmission timeout adapts to the round trip times measured to
+ * the BMC, staying between 100 milliseconds (or the configured
+ * timeout if smaller) and four times the configured timeout.
  */
 
 #define IPMI_FLAGS_DEFAULT                    0x00000000
@@ -235,6 +242,7 @@ typedef enum ipmi_driver_type ipmi_driver_type_t;
 #define IPMI_FLAGS_NO_VALID_CHECK             0x00000100
 #define IPMI_FLAGS_NO_LEGAL_CHECK             0x00000200
 #define IPMI_FLAGS_IGNORE_AUTHENTICATION_CODE 0x00000400
+#define IPMI_FLAGS_FIXED_RETRANSMISSION_TIMEOUT 0x00000800
 
 typedef struct ipmi_ctx *ipmi_ctx_t;
 
@@ -279,6 +287,37 @@ int ipmi_ctx_open_outofband_2_0 (ipmi_ctx_t ctx,
                                  unsigned int workaround_flags,
                                  unsigned int flags);
 
+/* Cache BMC capabilities on disk to shorten session establishment.
+ *
+ * When set, ipmi_ctx_open_outofband_2_0() stores the BMC's Get
+ * Channel Authentication Capabilities response in a per host file in
+ * directory.  While the file is younger than lifetime seconds, later
+ * session opens use it instead of querying the BMC, saving a round
+ * trip.  If a session open using a cached response fails, the cache
+ * is discarded and the session open is retried once without it.
+ *
+ * The directory must exist and be writable.  Specify 0 for lifetime
+ * to use the default.  Pass NULL for directory to disable the cache,
+ * the default.  Must be called before the device is opened.
+ */
+int ipmi_ctx_set_capability_cache (ipmi_ctx_t ctx,
+                                   const char *directory,
+                                   unsigned int lifetime);
+
+/* Share IPMI 2.0 sessions through the ipmisessiond(8) session broker.
+ *
+ * When set, ipmi_ctx_open_outofband_2_0() connects to the broker
+ * listening on socket_path instead of establishing a session with
+ * the BMC.  The broker holds one session per BMC and set of
+ * credentials, and commands are passed through it.  If no broker is
+ * listening, or the caller may not access its socket,
+ * ipmi_ctx_open_outofband_2_0() establishes its own session as usual.
+ *
+ * Pass NULL for socket_path to disable, the default.  Must be called
+ * before the device is opened.
+ */
+int ipmi_ctx_set_session_broker (ipmi_ctx_t ctx, const char *socket_path);
+
 /* For inband sessions */
 int ipmi_ctx_open_inband (ipmi_ctx_t ctx,
                           ipmi_driver_type_t driver_type,
@@ -120,6 +120,7 @@ static char *ipmiconsole_errmsgs[] =
 #define IPMICONSOLE_ENGINE_LOCK_MEMORY_STR                "lockmemory"
 #define IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE_STR           "serialkeepalive"
 #define IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE_EMPTY_STR     "serialkeepaliveempty"
+#define IPMICONSOLE_ENGINE_FIXED_RETRANSMISSION_TIMEOUT_STR "fixedretransmissiontimeout"
 
 #define IPMICONSOLE_BEHAVIOR_ERROR_ON_SOL_INUSE_STR       "erroronsolinuse"
 #define IPMICONSOLE_BEHAVIOR_DEACTIVATE_ONLY_STR          "deactivateonly"
@@ -382,6 +383,8 @@ _config_file_engine_flags (conffile_t cf,
         engine_flags |= IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE;
       else if (!strcasecmp (data->stringlist[i], IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE_EMPTY_STR))
         engine_flags |= IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE_EMPTY;
+      else if (!strcasecmp (data->stringlist[i], IPMICONSOLE_ENGINE_FIXED_RETRANSMISSION_TIMEOUT_STR))
+        engine_flags |= IPMICONSOLE_ENGINE_FIXED_RETRANSMISSION_TIMEOUT;
       else
         IPMICONSOLE_DEBUG (("libipmiconsole config file engine flag invalid"));
     }
@@ -760,7 +763,7 @@ ipmiconsole_engine_init (unsigned int thread_count, unsigned int debug_flags)
   struct rlimit rlim;
   unsigned int i;
 
-  if (thread_count > IPMICONSOLE_THREAD_COUNT_MAX
+  if (thread_count > ipmiconsole_engine_thread_count_max ()
       || (debug_flags != IPMICONSOLE_DEBUG_DEFAULT
           && debug_flags & ~IPMICONSOLE_DEBUG_MASK))
     {
@@ -1147,6 +1150,18 @@ ipmiconsole_engine_submit_block (ipmiconsole_ctx_t c)
   return (-1);
 }
 
+int
+ipmiconsole_engine_get_counters (struct ipmiconsole_ctx_counters *counters)
+{
+  if (!counters)
+    {
+      errno = EINVAL;
+      return (-1);
+    }
+
+  return (ipmiconsole_engine_counters (counters));
+}
+
 void
 ipmiconsole_engine_teardown (int cleanup_sol_sessions)
 {
@@ -1332,7 +1347,9 @@ ipmiconsole_ctx_set_config (ipmiconsole_ctx_t c,
       || c->api_magic != IPMICONSOLE_CTX_API_MAGIC)
     return (-1);
 
-  if ((config_option != IPMICONSOLE_CTX_CONFIG_OPTION_SOL_PAYLOAD_INSTANCE)
+  if ((config_option != IPMICONSOLE_CTX_CONFIG_OPTION_SOL_PAYLOAD_INSTANCE
+       && config_option != IPMICONSOLE_CTX_CONFIG_OPTION_SOL_COALESCE_BYTES
+       && config_option != IPMICONSOLE_CTX_CONFIG_OPTION_SOL_COALESCE_TIMEOUT)
       || !config_option_value)
     {
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_PARAMETERS);
@@ -1356,6 +1373,14 @@ ipmiconsole_ctx_set_config (ipmiconsole_ctx_t c,
         }
       c->config.sol_payload_instance = *(tmpptr);
       break;
+    case IPMICONSOLE_CTX_CONFIG_OPTION_SOL_COALESCE_BYTES:
+      tmpptr = (unsigned int *)config_option_value;
+      c->config.sol_coalesce_bytes = *(tmpptr);
+      break;
+    case IPMICONSOLE_CTX_CONFIG_OPTION_SOL_COALESCE_TIMEOUT:
+      tmpptr = (unsigned int *)config_option_value;
+      c->config.sol_coalesce_timeout = *(tmpptr);
+      break;
     default:
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
       return (-1);
@@ -1377,7 +1402,9 @@ ipmiconsole_ctx_get_config (ipmiconsole_ctx_t c,
       || c->api_magic != IPMICONSOLE_CTX_API_MAGIC)
     return (-1);
 
-  if ((config_option != IPMICONSOLE_CTX_CONFIG_OPTION_SOL_PAYLOAD_INSTANCE)
+  if ((config_option != IPMICONSOLE_CTX_CONFIG_OPTION_SOL_PAYLOAD_INSTANCE
+       && config_option != IPMICONSOLE_CTX_CONFIG_OPTION_SOL_COALESCE_BYTES
+       && config_option != IPMICONSOLE_CTX_CONFIG_OPTION_SOL_COALESCE_TIMEOUT)
       || !config_option_value)
     {
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_PARAMETERS);
@@ -1390,6 +1417,14 @@ ipmiconsole_ctx_get_config (ipmiconsole_ctx_t c,
       tmpptr = (unsigned int *)config_option_value;
       (*tmpptr) = c->config.sol_payload_instance;
       break;
+    case IPMICONSOLE_CTX_CONFIG_OPTION_SOL_COALESCE_BYTES:
+      tmpptr = (unsigned int *)config_option_value;
+      (*tmpptr) = c->config.sol_coalesce_bytes;
+      break;
+    case IPMICONSOLE_CTX_CONFIG_OPTION_SOL_COALESCE_TIMEOUT:
+      tmpptr = (unsigned int *)config_option_value;
+      (*tmpptr) = c->config.sol_coalesce_timeout;
+      break;
     default:
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
       return (-1);
@@ -1399,6 +1434,43 @@ ipmiconsole_ctx_get_config (ipmiconsole_ctx_t c,
   return (0);
 }
 
+int
+ipmiconsole_ctx_get_counters (ipmiconsole_ctx_t c,
+                              struct ipmiconsole_ctx_counters *counters)
+{
+  int perr;
+
+  if (!c
+      || c->magic != IPMICONSOLE_CTX_MAGIC
+      || c->api_magic != IPMICONSOLE_CTX_API_MAGIC)
+    return (-1);
+
+  if (!counters)
+    {
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_PARAMETERS);
+      return (-1);
+    }
+
+  if ((perr = pthread_mutex_lock (&(c->signal.counters_mutex))) != 0)
+    {
+      IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
+      return (-1);
+    }
+
+  memcpy (counters, &(c->signal.counters), sizeof (struct ipmiconsole_ctx_counters));
+
+  if ((perr = pthread_mutex_unlock (&(c->signal.counters_mutex))) != 0)
+    {
+      IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
+      return (-1);
+    }
+
+  ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SUCCESS);
+  return (0);
+}
+
 int
 ipmiconsole_ctx_errnum (ipmiconsole_ctx_t c)
 {
@@ -1481,6 +1553,112 @@ ipmiconsole_ctx_fd (ipmiconsole_ctx_t c)
   return (c->fds.user_fd);
 }
 
+int
+ipmiconsole_ctx_output_read (ipmiconsole_ctx_t c,
+                             Ipmiconsole_output_callback callback,
+                             void *callback_arg)
+{
+  int ring_empty = 0;
+  int rv = 0;
+  int perr;
+  int n;
+
+  if (!c
+      || c->magic != IPMICONSOLE_CTX_MAGIC
+      || c->api_magic != IPMICONSOLE_CTX_API_MAGIC)
+    return (-1);
+
+  if (!callback
+      || !(c->config.engine_flags & IPMICONSOLE_ENGINE_OUTPUT_RING))
+    {
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_PARAMETERS);
+      return (-1);
+    }
+
+  if (!c->session_submitted)
+    {
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_CTX_NOT_SUBMITTED);
+      return (-1);
+    }
+
+  /* Output is moved out of the ring under output_mutex and handed to
+   * the callback after it is released, so a slow callback never
+   * holds up the engine thread writing into the ring.
+   */
+  while (1)
+    {
+      if (!c->signal.output_pending_len)
+        {
+          if (ring_empty)
+            break;
+
+          if ((perr = pthread_mutex_lock (&(c->signal.output_mutex))) != 0)
+            {
+              IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+              ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
+              return (-1);
+            }
+
+          /* The engine may not have set up the connection yet */
+          if (!c->signal.output_ring)
+            n = 0;
+          else if ((n = scbuf_read (c->signal.output_ring,
+                                    c->signal.output_pending,
+                                    IPMICONSOLE_OUTPUT_READ_BUFLEN)) < 0)
+            {
+              IPMICONSOLE_DEBUG (("scbuf_read: %s", strerror (errno)));
+              ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SYSTEM_ERROR);
+              if ((perr = pthread_mutex_unlock (&(c->signal.output_mutex))) != 0)
+                IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+              return (-1);
+            }
+
+          /* Re-arm the doorbell once the user has caught up.  Done
+           * under output_mutex, so output written after this point
+           * rings again.
+           */
+          if (!c->signal.output_ring
+              || scbuf_is_empty (c->signal.output_ring))
+            {
+              c->signal.output_doorbell = 0;
+              ring_empty++;
+            }
+
+          if ((perr = pthread_mutex_unlock (&(c->signal.output_mutex))) != 0)
+            IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+
+          if (!n)
+            break;
+
+          c->signal.output_pending_offset = 0;
+          c->signal.output_pending_len = n;
+        }
+
+      if ((n = (*callback)(c->signal.output_pending + c->signal.output_pending_offset,
+                           c->signal.output_pending_len,
+                           callback_arg)) < 0)
+        {
+          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SYSTEM_ERROR);
+          return (-1);
+        }
+
+      /* be defensive against a callback claiming too much */
+      if (n > c->signal.output_pending_len)
+        n = c->signal.output_pending_len;
+
+      c->signal.output_pending_offset += n;
+      c->signal.output_pending_len -= n;
+      rv += n;
+
+      /* the rest is left for a later call */
+      if (c->signal.output_pending_len)
+        break;
+    }
+
+  ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SUCCESS);
+  return (rv);
+}
+
 int
 ipmiconsole_ctx_generate_break (ipmiconsole_ctx_t c)
 {
@@ -65,6 +65,7 @@
 
 #include "ipmiconsole_ctx.h"
 #include "ipmiconsole_debug.h"
+#include "ipmiconsole_engine.h"
 #include "ipmiconsole_util.h"
 #include "scbuf.h"
 
@@ -308,6 +309,8 @@ ipmiconsole_ctx_config_setup (ipmiconsole_ctx_t c,
     c->config.debug_flags = default_config.debug_flags;
 
   c->config.sol_payload_instance = default_config.sol_payload_instance;
+  c->config.sol_coalesce_bytes = 0;
+  c->config.sol_coalesce_timeout = 0;
 
   /* Data based on Configuration Parameters */
 
@@ -444,6 +447,23 @@ ipmiconsole_ctx_signal_setup (ipmiconsole_ctx_t c)
     }
   c->signal.ctx_state = IPMICONSOLE_CTX_STATE_INIT;
 
+  if ((perr = pthread_mutex_init (&c->signal.counters_mutex, NULL)) != 0)
+    {
+      errno = perr;
+      return (-1);
+    }
+  memset (&(c->signal.counters), '\0', sizeof (struct ipmiconsole_ctx_counters));
+
+  if ((perr = pthread_mutex_init (&c->signal.output_mutex, NULL)) != 0)
+    {
+      errno = perr;
+      return (-1);
+    }
+  c->signal.output_ring = NULL;
+  c->signal.output_doorbell = 0;
+  c->signal.output_pending_offset = 0;
+  c->signal.output_pending_len = 0;
+
   return (0);
 }
 
@@ -455,6 +475,17 @@ ipmiconsole_ctx_signal_cleanup (ipmiconsole_ctx_t c)
 
   pthread_mutex_destroy (&(c->signal.status_mutex));
   pthread_mutex_destroy (&(c->signal.mutex_ctx_state));
+  pthread_mutex_destroy (&(c->signal.counters_mutex));
+
+  if (c->signal.output_ring)
+    {
+      int secure_malloc_flag;
+
+      secure_malloc_flag = (c->config.engine_flags & IPMICONSOLE_ENGINE_LOCK_MEMORY) ? 1 : 0;
+      scbuf_destroy (c->signal.output_ring, secure_malloc_flag);
+      c->signal.output_ring = NULL;
+    }
+  pthread_mutex_destroy (&(c->signal.output_mutex));
 }
 
 int
@@ -525,6 +556,8 @@ ipmiconsole_ctx_connection_setup (ipmiconsole_ctx_t c)
   c->connection.ipmi_fd = -1;
   c->connection.asynccomm[0] = -1;
   c->connection.asynccomm[1] = -1;
+  c->connection.epoll_fd = -1;
+  c->connection.asynccomm_epoll = -1;
 
   /* File Descriptor User Interface */
 
@@ -571,6 +604,12 @@ ipmiconsole_ctx_connection_setup (ipmiconsole_ctx_t c)
       goto cleanup;
     }
 
+  /* The output ring is owned by the signal data from here on, see
+   * ipmiconsole_ctx_signal_cleanup().
+   */
+  if (c->config.engine_flags & IPMICONSOLE_ENGINE_OUTPUT_RING)
+    c->signal.output_ring = c->connection.console_bmc_to_remote_console;
+
   /* Connection Data */
 
   if (c->session.addr->sa_family == AF_INET)
@@ -978,7 +1017,8 @@ __ipmiconsole_ctx_connection_cleanup (ipmiconsole_ctx_t c, int session_submitted
 
   if (c->connection.console_remote_console_to_bmc)
     scbuf_destroy (c->connection.console_remote_console_to_bmc, secure_malloc_flag);
-  if (c->connection.console_bmc_to_remote_console)
+  if (c->connection.console_bmc_to_remote_console
+      && c->connection.console_bmc_to_remote_console != c->signal.output_ring)
     scbuf_destroy (c->connection.console_bmc_to_remote_console, secure_malloc_flag);
 
   /* ignore potential error, cleanup path */
@@ -1179,6 +1219,8 @@ ipmiconsole_ctx_session_setup (ipmiconsole_ctx_t c)
 
   timeval_clear (&(c->session.last_ipmi_packet_sent));
 
+  rtt_init (&(c->session.rtt), c->config.retransmission_timeout_len);
+
   /* Note:
    *
    * Initial last_ipmi_packet_received and last_sol_packet_received to
@@ -1449,3 +1491,90 @@ ipmiconsole_ctx_set_errnum (ipmiconsole_ctx_t c, int errnum)
   if ((perr = pthread_mutex_unlock (&(c->errnum_mutex))) != 0)
     IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
 }
+
+void
+ipmiconsole_counters_add (struct ipmiconsole_ctx_counters *counters,
+                          ipmiconsole_counter_t counter,
+                          unsigned int n)
+{
+  unsigned int bucket;
+
+  assert (counters);
+
+  switch (counter)
+    {
+    case IPMICONSOLE_COUNTER_SOL_PACKETS_SENT:
+      counters->sol_packets_sent += n;
+      break;
+    case IPMICONSOLE_COUNTER_SOL_CHARACTER_BYTES_SENT:
+      counters->sol_character_bytes_sent += n;
+      break;
+    case IPMICONSOLE_COUNTER_SOL_CHARACTER_SEND_SIZE:
+      counters->sol_character_send_size = n;
+      break;
+    case IPMICONSOLE_COUNTER_PACKETS_SENT:
+      counters->packets_sent += n;
+      break;
+    case IPMICONSOLE_COUNTER_BYTES_SENT:
+      counters->bytes_sent += n;
+      break;
+    case IPMICONSOLE_COUNTER_PACKETS_RECEIVED:
+      counters->packets_received += n;
+      break;
+    case IPMICONSOLE_COUNTER_BYTES_RECEIVED:
+      counters->bytes_received += n;
+      break;
+    case IPMICONSOLE_COUNTER_IPMI_RETRANSMISSIONS:
+      counters->ipmi_retransmissions += n;
+      break;
+    case IPMICONSOLE_COUNTER_SOL_RETRANSMISSIONS:
+      counters->sol_retransmissions += n;
+      break;
+    case IPMICONSOLE_COUNTER_KEEPALIVES_SENT:
+      counters->keepalives_sent += n;
+      break;
+    case IPMICONSOLE_COUNTER_SERIAL_KEEPALIVES_SENT:
+      counters->serial_keepalives_sent += n;
+      break;
+    case IPMICONSOLE_COUNTER_SOL_ACK_LATENCY:
+      /* bucket N is [2^(N-1), 2^N) ms */
+      bucket = 0;
+      while (n && bucket < (IPMICONSOLE_CTX_COUNTERS_SOL_ACK_LATENCY_BUCKETS - 1))
+        {
+          n >>= 1;
+          bucket++;
+        }
+      counters->sol_ack_latency[bucket]++;
+      break;
+    case IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED:
+      counters->scbuf_bytes_dropped += n;
+      break;
+    default:
+      IPMICONSOLE_DEBUG (("invalid counter: %d", counter));
+      break;
+    }
+}
+
+void
+ipmiconsole_ctx_counters_add (ipmiconsole_ctx_t c,
+                              ipmiconsole_counter_t counter,
+                              unsigned int n)
+{
+  int perr;
+
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  if ((perr = pthread_mutex_lock (&(c->signal.counters_mutex))) != 0)
+    {
+      IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+      return;
+    }
+
+  ipmiconsole_counters_add (&(c->signal.counters), counter, n);
+
+  if ((perr = pthread_mutex_unlock (&(c->signal.counters_mutex))) != 0)
+    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+
+  ipmiconsole_engine_counters_add (c->connection.engine_index, counter, n);
+}
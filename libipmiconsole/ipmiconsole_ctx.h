@@ -77,4 +77,17 @@ int ipmiconsole_ctx_get_errnum (ipmiconsole_ctx_t c);
 
 void ipmiconsole_ctx_set_errnum (ipmiconsole_ctx_t c, int errnum);
 
+/* Add n to a counter.  For IPMICONSOLE_COUNTER_SOL_ACK_LATENCY, n is
+ * the latency in milliseconds.  For
+ * IPMICONSOLE_COUNTER_SOL_CHARACTER_SEND_SIZE, n is the new value.
+ */
+void ipmiconsole_counters_add (struct ipmiconsole_ctx_counters *counters,
+                               ipmiconsole_counter_t counter,
+                               unsigned int n);
+
+/* Add n to a counter of context c and the engine */
+void ipmiconsole_ctx_counters_add (ipmiconsole_ctx_t c,
+                                   ipmiconsole_counter_t counter,
+                                   unsigned int n);
+
 #endif /* IPMICONSOLE_CTX_H */
@@ -55,6 +55,7 @@
 #endif /* HAVE_NETDB_H */
 #include <freeipmi/freeipmi.h>
 
+#include "rtt.h"
 #include "scbuf.h"
 
 #ifndef MAXHOSTNAMELEN
@@ -149,6 +150,17 @@ typedef enum
 
 #define IPMICONSOLE_THREAD_COUNT_DEFAULT                            4
 
+/* Used if only a coalesce byte count is configured, in microseconds */
+#define IPMICONSOLE_SOL_COALESCE_TIMEOUT_DEFAULT                    20000
+
+/* Engine threads rebalance contexts every interval.  A packet's load
+ * is counted as this many bytes, b/c per packet processing (crypto,
+ * fiid objects, etc.) dominates the cost of small SOL packets.
+ */
+#define IPMICONSOLE_ENGINE_REBALANCE_INTERVAL                       1000
+#define IPMICONSOLE_ENGINE_REBALANCE_PACKET_LOAD                    256
+#define IPMICONSOLE_ENGINE_REBALANCE_LOAD_MIN                       4096
+
 #define IPMICONSOLE_SESSION_TIMEOUT_LENGTH_DEFAULT                  60000
 #define IPMICONSOLE_RETRANSMISSION_TIMEOUT_LENGTH_DEFAULT           500
 #define IPMICONSOLE_RETRANSMISSION_MAX_DEFAULT                      10
@@ -196,6 +208,8 @@ typedef enum
 
 #define IPMICONSOLE_PACKET_BUFLEN             16384
 
+#define IPMICONSOLE_OUTPUT_READ_BUFLEN        4096
+
 #define IPMICONSOLE_MIN_CHARACTER_DATA        1
 #define IPMICONSOLE_MAX_CHARACTER_DATA        255
 
@@ -228,7 +242,9 @@ typedef enum
    | IPMICONSOLE_ENGINE_OUTPUT_ON_SOL_ESTABLISHED  \
    | IPMICONSOLE_ENGINE_LOCK_MEMORY                \
    | IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE           \
-   | IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE_EMPTY)
+   | IPMICONSOLE_ENGINE_SERIAL_KEEPALIVE_EMPTY     \
+   | IPMICONSOLE_ENGINE_OUTPUT_RING                \
+   | IPMICONSOLE_ENGINE_FIXED_RETRANSMISSION_TIMEOUT)
 
 #define IPMICONSOLE_BEHAVIOR_MASK           \
   (IPMICONSOLE_BEHAVIOR_ERROR_ON_SOL_INUSE  \
@@ -269,6 +285,8 @@ struct ipmiconsole_ctx_config {
 
   /* advanced config */
   unsigned int sol_payload_instance;
+  unsigned int sol_coalesce_bytes;
+  unsigned int sol_coalesce_timeout; /* microseconds */
 
   /* Data based on Configuration Parameters */
   uint8_t authentication_algorithm;
@@ -276,6 +294,19 @@ struct ipmiconsole_ctx_config {
   uint8_t confidentiality_algorithm;
 };
 
+/* Identifies the context and file descriptor of an event from an
+ * engine thread's epoll set, see ipmiconsole_engine.c
+ */
+#define IPMICONSOLE_EPOLL_DATA_IPMI_FD                              0
+#define IPMICONSOLE_EPOLL_DATA_ASYNCCOMM                            1
+#define IPMICONSOLE_EPOLL_DATA_IPMICONSOLE_FD                       2
+#define IPMICONSOLE_EPOLL_DATA_COUNT                                3
+
+struct ipmiconsole_ctx_epoll_data {
+  struct ipmiconsole_ctx *c;
+  unsigned int type;
+};
+
 /* Sockets, pipes, objects, etc. used for data in a SOL session */
 struct ipmiconsole_ctx_connection {
 
@@ -293,6 +324,28 @@ struct ipmiconsole_ctx_connection {
   /* Pipe for non-fd communication: from API to engine */
   int asynccomm[2];
 
+  /* Engine thread epoll set, -1 if the engine uses poll().  The
+   * engine registers a dup of asynccomm[0], b/c the API closes
+   * asynccomm[0] on its own.  Events of 0 means not registered.
+   */
+  int epoll_fd;
+  int asynccomm_epoll;
+  unsigned int ipmi_fd_events;
+  unsigned int asynccomm_events;
+  unsigned int ipmiconsole_fd_events;
+  struct ipmiconsole_ctx_epoll_data epoll_data[IPMICONSOLE_EPOLL_DATA_COUNT];
+
+  /* Engine thread the context is owned by and the link in that
+   * thread's submission queue.  engine_packets and engine_bytes are
+   * counted since the engine last calculated engine_load, a moving
+   * average used to rebalance contexts between engine threads.
+   */
+  unsigned int engine_index;
+  struct ipmiconsole_ctx *engine_submit_next;
+  unsigned int engine_packets;
+  unsigned int engine_bytes;
+  unsigned int engine_load;
+
   /* Fiid Objects */
 
   fiid_obj_t obj_rmcp_hdr_rq;
@@ -356,6 +409,9 @@ struct ipmiconsole_ctx_session {
   struct timeval last_ipmi_packet_received;
   struct timeval last_keepalive_packet_sent;
 
+  /* Adaptive retransmission timeout */
+  struct rtt rtt;
+
   /* Serial keepalive timeout maintenance */
   struct timeval last_sol_packet_received;
 
@@ -419,9 +475,16 @@ struct ipmiconsole_ctx_session {
   int sol_input_waiting_for_ack;
   int sol_input_waiting_for_break_ack;
   struct timeval last_sol_input_packet_sent;
+  /* last SOL input packet sent was a retransmission, don't sample rtt */
+  int sol_input_retransmitted;
   uint8_t sol_input_packet_sequence_number;
   uint8_t sol_input_character_data[IPMICONSOLE_MAX_CHARACTER_DATA+1];
   unsigned int sol_input_character_data_len;
+  /* Outbound character data is being held to coalesce it w/ more
+   * user input since sol_input_coalesce_start.
+   */
+  int sol_input_coalescing;
+  struct timeval sol_input_coalesce_start;
 
   /* SOL Output (BMC to remote console) */
   uint8_t last_sol_output_packet_sequence_number;
@@ -461,6 +524,25 @@ typedef enum {
   IPMICONSOLE_CTX_STATE_ENGINE_DESTROYED,
 } ipmiconsole_ctx_state;
 
+/* Counters in struct ipmiconsole_ctx_counters, see
+ * ipmiconsole_ctx_counters_add().
+ */
+typedef enum {
+  IPMICONSOLE_COUNTER_SOL_PACKETS_SENT,
+  IPMICONSOLE_COUNTER_SOL_CHARACTER_BYTES_SENT,
+  IPMICONSOLE_COUNTER_SOL_CHARACTER_SEND_SIZE,
+  IPMICONSOLE_COUNTER_PACKETS_SENT,
+  IPMICONSOLE_COUNTER_BYTES_SENT,
+  IPMICONSOLE_COUNTER_PACKETS_RECEIVED,
+  IPMICONSOLE_COUNTER_BYTES_RECEIVED,
+  IPMICONSOLE_COUNTER_IPMI_RETRANSMISSIONS,
+  IPMICONSOLE_COUNTER_SOL_RETRANSMISSIONS,
+  IPMICONSOLE_COUNTER_KEEPALIVES_SENT,
+  IPMICONSOLE_COUNTER_SERIAL_KEEPALIVES_SENT,
+  IPMICONSOLE_COUNTER_SOL_ACK_LATENCY,
+  IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED,
+} ipmiconsole_counter_t;
+
 struct ipmiconsole_ctx_signal {
   /* Conceptually there is not a race with the status.  The API initializes
    * the status, and the engine is the only one that modifies it.
@@ -472,6 +554,29 @@ struct ipmiconsole_ctx_signal {
   pthread_mutex_t status_mutex;
   unsigned int status;
 
+  /* Counters are updated by the engine and read by the API */
+  pthread_mutex_t counters_mutex;
+  struct ipmiconsole_ctx_counters counters;
+
+  /* With IPMICONSOLE_ENGINE_OUTPUT_RING, the API reads console output
+   * directly out of the engine's console_bmc_to_remote_console scbuf.
+   * output_ring is that scbuf; it outlives the connection so output
+   * can still be read after the session ends, and is destroyed with
+   * the signal data.  output_doorbell is set when the engine has
+   * written a doorbell byte to the user's fd and cleared by the API
+   * once the ring has been emptied.
+   *
+   * output_pending is output the API has taken out of the ring but
+   * the user's callback has not consumed yet.  It is only touched by
+   * the API, so the callback can be run without output_mutex held.
+   */
+  pthread_mutex_t output_mutex;
+  scbuf_t output_ring;
+  int output_doorbell;
+  uint8_t output_pending[IPMICONSOLE_OUTPUT_READ_BUFLEN];
+  unsigned int output_pending_offset;
+  unsigned int output_pending_len;
+
   /* ctx_state - state and mutex used to determine when the user has
    * destroyed the context and it is now the responsibility of the
    * engine/garbage-collector to cleanup, or vice versa.  Need to
@@ -41,6 +41,9 @@
 #endif /* HAVE_UNISTD_H */
 #include <sys/types.h>
 #include <sys/poll.h>
+#if HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif /* HAVE_SYS_EPOLL_H */
 #include <signal.h>
 #include <limits.h>
 #include <assert.h>
@@ -57,6 +60,7 @@
 #include "ipmiconsole_processing.h"
 #include "ipmiconsole_util.h"
 #include "scbuf.h"
+#include "timeval.h"
 
 #include "freeipmi-portability.h"
 #include "list.h"
@@ -68,6 +72,7 @@
  * when is_count mutex is locked - thread_count_mutex can be locked, not vice versa
  * when is_count mutex is locked - teardown_mutex can be locked, not vice versa
  * when thread_count mutex is locked - ctxs_mutex can be locked, not vice versa
+ * when ctxs_mutex is locked - load_mutex can be locked, not vice versa
  */
 static int console_engine_is_setup = 0;
 static pthread_mutex_t console_engine_is_setup_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -79,9 +84,51 @@ static int console_engine_teardown = 0;
 static int console_engine_teardown_immediate = 0;
 static pthread_mutex_t console_engine_teardown_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static List console_engine_ctxs[IPMICONSOLE_THREAD_COUNT_MAX];
-static unsigned int console_engine_ctxs_count[IPMICONSOLE_THREAD_COUNT_MAX];
-static pthread_mutex_t console_engine_ctxs_mutex[IPMICONSOLE_THREAD_COUNT_MAX];
+/* Per engine thread data is allocated in ipmiconsole_engine_setup(),
+ * console_engine_ctxs_num entries each.  console_engine_ctxs_num
+ * does not change until ipmiconsole_engine_cleanup().
+ *
+ * console_engine_ctxs_count is the number of contexts owned by a
+ * thread, either in its list or in its submission queue.
+ */
+static List *console_engine_ctxs = NULL;
+static unsigned int *console_engine_ctxs_count = NULL;
+static pthread_mutex_t *console_engine_ctxs_mutex = NULL;
+static unsigned int console_engine_ctxs_num = 0;
+
+/* Contexts are submitted to an engine thread through a
+ * multiple-producer single-consumer queue, a singly linked stack
+ * through engine_submit_next that the engine thread takes in its
+ * entirety.  Submitters never contend w/ the engine thread's
+ * console_engine_ctxs_mutex, which is held while contexts are
+ * processed.  Engine threads also use the queue to hand contexts to
+ * each other when rebalancing.
+ *
+ * If atomic builtins aren't available, a mutex protects the queues
+ * and the ctxs counts.
+ */
+static ipmiconsole_ctx_t *console_engine_submit_queue = NULL;
+#if !HAVE_SYNC_BUILTINS
+static pthread_mutex_t console_engine_submit_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif /* !HAVE_SYNC_BUILTINS */
+
+/* Last load calculated by each engine thread, see
+ * _ipmiconsole_engine_rebalance().
+ */
+static unsigned int *console_engine_load = NULL;
+static pthread_mutex_t console_engine_load_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Counters of all contexts since the engine was setup, see
+ * ipmiconsole_ctx_counters_add().  Each engine thread adds to its own
+ * counters, w/ a mutex only contended by readers, so packets never
+ * serialize engine threads.  Readers sum them w/ the counters of
+ * engine threads that have been torn down.
+ */
+static struct ipmiconsole_ctx_counters *console_engine_thread_counters = NULL;
+static pthread_mutex_t *console_engine_thread_counters_mutex = NULL;
+static unsigned int console_engine_thread_counters_num = 0;
+static struct ipmiconsole_ctx_counters console_engine_counters;
+static pthread_mutex_t console_engine_counters_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* In the core engine code, the poll() may sit for a large number of
  * seconds, waiting for the next event to happen.  In the meantime, a
@@ -92,8 +139,19 @@ static pthread_mutex_t console_engine_ctxs_mutex[IPMICONSOLE_THREAD_COUNT_MAX];
  * the poll() when the user wants to get things moving a little
  * faster.
  */
-static int console_engine_ctxs_notifier[IPMICONSOLE_THREAD_COUNT_MAX][2];
-static unsigned int console_engine_ctxs_notifier_num = 0;
+static int (*console_engine_ctxs_notifier)[2] = NULL;
+
+/* With thousands of SOL sessions per engine thread, rebuilding a
+ * pollfd array with three fds per context on every loop iteration
+ * gets expensive.  Each engine thread instead keeps an epoll set
+ * that a context's fds are registered in when it is submitted and
+ * removed from when it is torn down.  Registrations are only
+ * modified when an output scbuf goes between empty and non-empty,
+ * see ipmiconsole_engine_ctx_events_update().
+ *
+ * If epoll isn't available, -1, and the engine falls back to poll().
+ */
+static int *console_engine_epoll_fd = NULL;
 
 /*
  * The engine is capable of "being finished" with a context before the
@@ -126,6 +184,705 @@ struct _ipmiconsole_poll_data {
 
 #define IPMICONSOLE_PIPE_BUFLEN 1024
 
+#define IPMICONSOLE_EPOLL_EVENTS_MAX 256
+
+static void
+_ipmiconsole_counters_sum (struct ipmiconsole_ctx_counters *sum,
+                           const struct ipmiconsole_ctx_counters *counters)
+{
+  unsigned int i;
+
+  assert (sum);
+  assert (counters);
+
+  sum->sol_packets_sent += counters->sol_packets_sent;
+  sum->sol_character_bytes_sent += counters->sol_character_bytes_sent;
+  sum->packets_sent += counters->packets_sent;
+  sum->bytes_sent += counters->bytes_sent;
+  sum->packets_received += counters->packets_received;
+  sum->bytes_received += counters->bytes_received;
+  sum->ipmi_retransmissions += counters->ipmi_retransmissions;
+  sum->sol_retransmissions += counters->sol_retransmissions;
+  sum->keepalives_sent += counters->keepalives_sent;
+  sum->serial_keepalives_sent += counters->serial_keepalives_sent;
+  for (i = 0; i < IPMICONSOLE_CTX_COUNTERS_SOL_ACK_LATENCY_BUCKETS; i++)
+    sum->sol_ack_latency[i] += counters->sol_ack_latency[i];
+  sum->scbuf_bytes_dropped += counters->scbuf_bytes_dropped;
+}
+
+/* _ipmiconsole_engine_counters_setup
+ * - Reset counters and allocate per engine thread counters
+ */
+static int
+_ipmiconsole_engine_counters_setup (unsigned int thread_count)
+{
+  unsigned int i;
+  int perr;
+
+  assert (thread_count);
+
+  if ((perr = pthread_mutex_lock (&console_engine_counters_mutex)))
+    {
+      IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+      errno = perr;
+      return (-1);
+    }
+
+  assert (!console_engine_thread_counters);
+
+  memset (&console_engine_counters, '\0', sizeof (struct ipmiconsole_ctx_counters));
+
+  if (!(console_engine_thread_counters = (struct ipmiconsole_ctx_counters *)calloc (thread_count, sizeof (struct ipmiconsole_ctx_counters)))
+      || !(console_engine_thread_counters_mutex = (pthread_mutex_t *)calloc (thread_count, sizeof (pthread_mutex_t))))
+    {
+      IPMICONSOLE_DEBUG (("calloc: %s", strerror (errno)));
+      goto cleanup;
+    }
+
+  for (i = 0; i < thread_count; i++)
+    {
+      if ((perr = pthread_mutex_init (&console_engine_thread_counters_mutex[i], NULL)) != 0)
+        {
+          IPMICONSOLE_DEBUG (("pthread_mutex_init: %s", strerror (perr)));
+          errno = perr;
+          goto cleanup;
+        }
+      console_engine_thread_counters_num++;
+    }
+
+  if ((perr = pthread_mutex_unlock (&console_engine_counters_mutex)))
+    {
+      IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+      errno = perr;
+      return (-1);
+    }
+
+  return (0);
+
+ cleanup:
+  for (i = 0; i < console_engine_thread_counters_num; i++)
+    pthread_mutex_destroy (&console_engine_thread_counters_mutex[i]);
+  free (console_engine_thread_counters);
+  console_engine_thread_counters = NULL;
+  free (console_engine_thread_counters_mutex);
+  console_engine_thread_counters_mutex = NULL;
+  console_engine_thread_counters_num = 0;
+  /* ignore potential error, cleanup path */
+  pthread_mutex_unlock (&console_engine_counters_mutex);
+  return (-1);
+}
+
+/* _ipmiconsole_engine_counters_free
+ * - Keep the counters of the engine threads, then free the per
+ *   engine thread counters
+ * - Engine threads must no longer be running
+ */
+static void
+_ipmiconsole_engine_counters_free (void)
+{
+  unsigned int i;
+  int perr;
+
+  if ((perr = pthread_mutex_lock (&console_engine_counters_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+
+  for (i = 0; i < console_engine_thread_counters_num; i++)
+    {
+      _ipmiconsole_counters_sum (&console_engine_counters, &console_engine_thread_counters[i]);
+      pthread_mutex_destroy (&console_engine_thread_counters_mutex[i]);
+    }
+  free (console_engine_thread_counters);
+  console_engine_thread_counters = NULL;
+  free (console_engine_thread_counters_mutex);
+  console_engine_thread_counters_mutex = NULL;
+  console_engine_thread_counters_num = 0;
+
+  if ((perr = pthread_mutex_unlock (&console_engine_counters_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+}
+
+/* _ipmiconsole_engine_free
+ * - Free per engine thread data
+ */
+static void
+_ipmiconsole_engine_free (void)
+{
+  _ipmiconsole_engine_counters_free ();
+  free (console_engine_ctxs);
+  console_engine_ctxs = NULL;
+  free (console_engine_ctxs_count);
+  console_engine_ctxs_count = NULL;
+  free (console_engine_ctxs_mutex);
+  console_engine_ctxs_mutex = NULL;
+  free (console_engine_submit_queue);
+  console_engine_submit_queue = NULL;
+  free (console_engine_load);
+  console_engine_load = NULL;
+  free (console_engine_ctxs_notifier);
+  console_engine_ctxs_notifier = NULL;
+  free (console_engine_epoll_fd);
+  console_engine_epoll_fd = NULL;
+  console_engine_ctxs_num = 0;
+}
+
+static void
+_ipmiconsole_engine_ctxs_count_add (unsigned int index, unsigned int n)
+{
+#if HAVE_SYNC_BUILTINS
+  __sync_fetch_and_add (&console_engine_ctxs_count[index], n);
+#else /* !HAVE_SYNC_BUILTINS */
+  int perr;
+
+  if ((perr = pthread_mutex_lock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+
+  console_engine_ctxs_count[index] += n;
+
+  if ((perr = pthread_mutex_unlock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+#endif /* !HAVE_SYNC_BUILTINS */
+}
+
+static void
+_ipmiconsole_engine_ctxs_count_sub (unsigned int index, unsigned int n)
+{
+#if HAVE_SYNC_BUILTINS
+  __sync_fetch_and_sub (&console_engine_ctxs_count[index], n);
+#else /* !HAVE_SYNC_BUILTINS */
+  int perr;
+
+  if ((perr = pthread_mutex_lock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+
+  console_engine_ctxs_count[index] -= n;
+
+  if ((perr = pthread_mutex_unlock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+#endif /* !HAVE_SYNC_BUILTINS */
+}
+
+static unsigned int
+_ipmiconsole_engine_ctxs_count_get (unsigned int index)
+{
+#if HAVE_SYNC_BUILTINS
+  return (__sync_fetch_and_add (&console_engine_ctxs_count[index], 0));
+#else /* !HAVE_SYNC_BUILTINS */
+  unsigned int count;
+  int perr;
+
+  if ((perr = pthread_mutex_lock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+
+  count = console_engine_ctxs_count[index];
+
+  if ((perr = pthread_mutex_unlock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+
+  return (count);
+#endif /* !HAVE_SYNC_BUILTINS */
+}
+
+/* _ipmiconsole_engine_submit_queue_push
+ * - Queue context c to engine thread index and wake it up
+ */
+static void
+_ipmiconsole_engine_submit_queue_push (unsigned int index, ipmiconsole_ctx_t c)
+{
+#if HAVE_SYNC_BUILTINS
+  ipmiconsole_ctx_t head;
+#else /* !HAVE_SYNC_BUILTINS */
+  int perr;
+#endif /* !HAVE_SYNC_BUILTINS */
+
+  assert (index < console_engine_ctxs_num);
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  c->connection.engine_index = index;
+
+#if HAVE_SYNC_BUILTINS
+  do
+    {
+      head = console_engine_submit_queue[index];
+      c->connection.engine_submit_next = head;
+    } while (!__sync_bool_compare_and_swap (&console_engine_submit_queue[index], head, c));
+#else /* !HAVE_SYNC_BUILTINS */
+  if ((perr = pthread_mutex_lock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+
+  c->connection.engine_submit_next = console_engine_submit_queue[index];
+  console_engine_submit_queue[index] = c;
+
+  if ((perr = pthread_mutex_unlock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+#endif /* !HAVE_SYNC_BUILTINS */
+
+  /* "Interrupt" the engine and tell it to get moving along w/ the new context */
+  if (write (console_engine_ctxs_notifier[index][1], "1", 1) < 0)
+    IPMICONSOLE_DEBUG (("write: %s", strerror (errno)));
+}
+
+/* _ipmiconsole_engine_submit_queue_take
+ * - Take all contexts queued to engine thread index, in the order
+ *   they were queued
+ */
+static ipmiconsole_ctx_t
+_ipmiconsole_engine_submit_queue_take (unsigned int index)
+{
+  ipmiconsole_ctx_t head, c, c_prev = NULL;
+#if !HAVE_SYNC_BUILTINS
+  int perr;
+#endif /* !HAVE_SYNC_BUILTINS */
+
+  assert (index < console_engine_ctxs_num);
+
+#if HAVE_SYNC_BUILTINS
+  /* Only one consumer, so there are no ABA problems */
+  do
+    {
+      head = console_engine_submit_queue[index];
+    } while (head
+             && !__sync_bool_compare_and_swap (&console_engine_submit_queue[index], head, NULL));
+#else /* !HAVE_SYNC_BUILTINS */
+  if ((perr = pthread_mutex_lock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+
+  head = console_engine_submit_queue[index];
+  console_engine_submit_queue[index] = NULL;
+
+  if ((perr = pthread_mutex_unlock (&console_engine_submit_queue_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+#endif /* !HAVE_SYNC_BUILTINS */
+
+  /* queue is a stack, reverse it */
+  while (head)
+    {
+      c = head;
+      head = c->connection.engine_submit_next;
+      c->connection.engine_submit_next = c_prev;
+      c_prev = c;
+    }
+
+  return (c_prev);
+}
+
+/* _ipmiconsole_engine_console_output_pending
+ * - Return 1 if console output is waiting to be written to the
+ *   user's fd.  With IPMICONSOLE_ENGINE_OUTPUT_RING the user reads the
+ *   scbuf directly, so the engine never writes it to the fd.
+ */
+static int
+_ipmiconsole_engine_console_output_pending (ipmiconsole_ctx_t c)
+{
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  if (c->config.engine_flags & IPMICONSOLE_ENGINE_OUTPUT_RING)
+    return (0);
+
+  return (!scbuf_is_empty (c->connection.console_bmc_to_remote_console));
+}
+
+/* _ipmiconsole_engine_epoll_unregister
+ * - Remove the fds of context c from its engine thread's epoll set
+ */
+static void
+_ipmiconsole_engine_epoll_unregister (ipmiconsole_ctx_t c)
+{
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+#if HAVE_SYS_EPOLL_H
+  if (c->connection.epoll_fd < 0)
+    return;
+
+  /* ignore potential errors, cleanup path */
+  if (c->connection.ipmi_fd_events)
+    epoll_ctl (c->connection.epoll_fd, EPOLL_CTL_DEL, c->connection.ipmi_fd, NULL);
+  if (c->connection.asynccomm_events)
+    epoll_ctl (c->connection.epoll_fd, EPOLL_CTL_DEL, c->connection.asynccomm_epoll, NULL);
+  if (c->connection.ipmiconsole_fd_events)
+    epoll_ctl (c->connection.epoll_fd, EPOLL_CTL_DEL, c->connection.ipmiconsole_fd, NULL);
+#endif /* HAVE_SYS_EPOLL_H */
+
+  c->connection.ipmi_fd_events = 0;
+  c->connection.asynccomm_events = 0;
+  c->connection.ipmiconsole_fd_events = 0;
+
+  if (c->connection.asynccomm_epoll >= 0)
+    {
+      /* ignore potential error, cleanup path */
+      close (c->connection.asynccomm_epoll);
+      c->connection.asynccomm_epoll = -1;
+    }
+
+  c->connection.epoll_fd = -1;
+}
+
+#if HAVE_SYS_EPOLL_H
+static int
+_ipmiconsole_engine_epoll_ctl (ipmiconsole_ctx_t c,
+                               int fd,
+                               unsigned int type,
+                               unsigned int *registered_events,
+                               unsigned int events)
+{
+  struct epoll_event ev;
+  int op;
+
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+  assert (c->connection.epoll_fd >= 0);
+  assert (type < IPMICONSOLE_EPOLL_DATA_COUNT);
+  assert (registered_events);
+
+  if (*registered_events == events)
+    return (0);
+
+  if (!events)
+    op = EPOLL_CTL_DEL;
+  else if (!*registered_events)
+    op = EPOLL_CTL_ADD;
+  else
+    op = EPOLL_CTL_MOD;
+
+  memset (&ev, '\0', sizeof (struct epoll_event));
+  ev.events = events;
+  ev.data.ptr = &(c->connection.epoll_data[type]);
+
+  if (epoll_ctl (c->connection.epoll_fd, op, fd, &ev) < 0)
+    {
+      IPMICONSOLE_CTX_DEBUG (c, ("epoll_ctl: %s", strerror (errno)));
+      return (-1);
+    }
+
+  *registered_events = events;
+  return (0);
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
+/* _ipmiconsole_engine_epoll_register
+ * - Add the fds of context c to epoll set epoll_fd
+ */
+static int
+_ipmiconsole_engine_epoll_register (ipmiconsole_ctx_t c, int epoll_fd)
+{
+  unsigned int i;
+
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+  assert (c->connection.epoll_fd < 0);
+
+  if (epoll_fd < 0)
+    return (0);
+
+  for (i = 0; i < IPMICONSOLE_EPOLL_DATA_COUNT; i++)
+    {
+      c->connection.epoll_data[i].c = c;
+      c->connection.epoll_data[i].type = i;
+    }
+
+  if ((c->connection.asynccomm_epoll = dup (c->connection.asynccomm[0])) < 0)
+    {
+      IPMICONSOLE_CTX_DEBUG (c, ("dup: %s", strerror (errno)));
+      if (errno == EMFILE)
+        ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_TOO_MANY_OPEN_FILES);
+      else
+        ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SYSTEM_ERROR);
+      return (-1);
+    }
+
+  if (ipmiconsole_set_closeonexec (c, c->connection.asynccomm_epoll) < 0)
+    {
+      IPMICONSOLE_CTX_DEBUG (c, ("closeonexec error"));
+      goto cleanup;
+    }
+
+  c->connection.epoll_fd = epoll_fd;
+
+#if HAVE_SYS_EPOLL_H
+  if (_ipmiconsole_engine_epoll_ctl (c,
+                                     c->connection.asynccomm_epoll,
+                                     IPMICONSOLE_EPOLL_DATA_ASYNCCOMM,
+                                     &(c->connection.asynccomm_events),
+                                     EPOLLIN) < 0)
+    {
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SYSTEM_ERROR);
+      goto cleanup;
+    }
+#endif /* HAVE_SYS_EPOLL_H */
+
+  if (ipmiconsole_engine_ctx_events_update (c) < 0)
+    {
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SYSTEM_ERROR);
+      goto cleanup;
+    }
+
+  return (0);
+
+ cleanup:
+  _ipmiconsole_engine_epoll_unregister (c);
+  return (-1);
+}
+
+int
+ipmiconsole_engine_ctx_events_update (ipmiconsole_ctx_t c)
+{
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+#if HAVE_SYS_EPOLL_H
+  if (c->connection.epoll_fd < 0)
+    return (0);
+
+  if (_ipmiconsole_engine_epoll_ctl (c,
+                                     c->connection.ipmi_fd,
+                                     IPMICONSOLE_EPOLL_DATA_IPMI_FD,
+                                     &(c->connection.ipmi_fd_events),
+                                     EPOLLIN | (!scbuf_is_empty (c->connection.ipmi_to_bmc) ? EPOLLOUT : 0)) < 0)
+    return (-1);
+
+  /* If the session is being torn down, don't bother listening on
+   * these fds.  This also avoids spinning on a closed fd.
+   */
+  if (!c->session.close_session_flag)
+    {
+      if (_ipmiconsole_engine_epoll_ctl (c,
+                                         c->connection.ipmiconsole_fd,
+                                         IPMICONSOLE_EPOLL_DATA_IPMICONSOLE_FD,
+                                         &(c->connection.ipmiconsole_fd_events),
+                                         EPOLLIN | (_ipmiconsole_engine_console_output_pending (c) ? EPOLLOUT : 0)) < 0)
+        return (-1);
+    }
+  else
+    {
+      if (_ipmiconsole_engine_epoll_ctl (c,
+                                         c->connection.asynccomm_epoll,
+                                         IPMICONSOLE_EPOLL_DATA_ASYNCCOMM,
+                                         &(c->connection.asynccomm_events),
+                                         0) < 0)
+        return (-1);
+
+      if (_ipmiconsole_engine_epoll_ctl (c,
+                                         c->connection.ipmiconsole_fd,
+                                         IPMICONSOLE_EPOLL_DATA_IPMICONSOLE_FD,
+                                         &(c->connection.ipmiconsole_fd_events),
+                                         0) < 0)
+        return (-1);
+    }
+#endif /* HAVE_SYS_EPOLL_H */
+
+  return (0);
+}
+
+/* _ipmiconsole_engine_ctx_cleanup
+ * - ListDelF for engine thread context lists
+ */
+static void
+_ipmiconsole_engine_ctx_cleanup (ipmiconsole_ctx_t c)
+{
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  _ipmiconsole_engine_epoll_unregister (c);
+
+  _ipmiconsole_engine_ctxs_count_sub (c->connection.engine_index, 1);
+
+  ipmiconsole_ctx_connection_cleanup_session_submitted (c);
+}
+
+static int
+_teardown_initiate (void *x, void *arg)
+{
+  ipmiconsole_ctx_t c;
+
+  assert (x);
+
+  c = (ipmiconsole_ctx_t)x;
+
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  if (!c->session.close_session_flag)
+    c->session.close_session_flag++;
+
+  return (0);
+}
+
+/* _ipmiconsole_engine_submit_queue_process
+ * - Move contexts queued to engine thread index into its list
+ * - Called w/ console_engine_ctxs_mutex[index] locked
+ */
+static void
+_ipmiconsole_engine_submit_queue_process (unsigned int index, int teardown_initiated)
+{
+  ipmiconsole_ctx_t c, c_next;
+  void *ptr;
+
+  assert (index < console_engine_ctxs_num);
+
+  c = _ipmiconsole_engine_submit_queue_take (index);
+  while (c)
+    {
+      c_next = c->connection.engine_submit_next;
+      c->connection.engine_submit_next = NULL;
+
+      /* errnum set in function */
+      if (_ipmiconsole_engine_epoll_register (c, console_engine_epoll_fd[index]) < 0)
+        goto cleanup_ctx;
+
+      if (!(ptr = list_append (console_engine_ctxs[index], c)))
+        {
+          /* Note: Don't do a CTX debug, this is more of a global debug */
+          IPMICONSOLE_DEBUG (("list_append: %s", strerror (errno)));
+          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
+          goto cleanup_ctx;
+        }
+
+      if (ptr != (void *)c)
+        {
+          IPMICONSOLE_DEBUG (("list_append: invalid pointer: ptr=%p; c=%p", ptr, c));
+          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
+          goto cleanup_ctx;
+        }
+
+      if (teardown_initiated)
+        _teardown_initiate (c, NULL);
+
+      c = c_next;
+      continue;
+
+    cleanup_ctx:
+      /* Error will be seen by the user via a EOF on a read() or
+       * EPIPE on a write().
+       */
+      _ipmiconsole_engine_ctx_cleanup (c);
+      c = c_next;
+    }
+}
+
+/* _ipmiconsole_engine_rebalance
+ * - Calculate the load of engine thread index and, if it is
+ *   significantly busier than the least loaded engine thread, move
+ *   one context to it.
+ * - Called w/ console_engine_ctxs_mutex[index] locked
+ *
+ * Contexts are assigned to the engine thread w/ the fewest contexts
+ * on submission, but a few chatty consoles can still end up on one
+ * thread.  The context moved is the busiest one whose load is less
+ * than the difference in load between the two threads, so the
+ * imbalance always shrinks and contexts don't bounce between
+ * threads.
+ */
+static void
+_ipmiconsole_engine_rebalance (unsigned int index)
+{
+  ListIterator itr = NULL;
+  ipmiconsole_ctx_t c, c_move = NULL;
+  unsigned int load = 0;
+  unsigned int min_load = UINT_MAX;
+  unsigned int min_index = 0;
+  unsigned int i;
+  int perr;
+
+  assert (index < console_engine_ctxs_num);
+
+  if (!(itr = list_iterator_create (console_engine_ctxs[index])))
+    {
+      IPMICONSOLE_DEBUG (("list_iterator_create: %s", strerror (errno)));
+      return;
+    }
+
+  while ((c = (ipmiconsole_ctx_t)list_next (itr)))
+    {
+      /* moving average, so a short burst doesn't move a context */
+      c->connection.engine_load = (c->connection.engine_load
+                                   + c->connection.engine_packets * IPMICONSOLE_ENGINE_REBALANCE_PACKET_LOAD
+                                   + c->connection.engine_bytes) / 2;
+      c->connection.engine_packets = 0;
+      c->connection.engine_bytes = 0;
+      load += c->connection.engine_load;
+    }
+
+  if ((perr = pthread_mutex_lock (&console_engine_load_mutex)))
+    {
+      IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+      goto cleanup;
+    }
+
+  console_engine_load[index] = load;
+
+  for (i = 0; i < console_engine_ctxs_num; i++)
+    {
+      if (i != index && console_engine_load[i] < min_load)
+        {
+          min_load = console_engine_load[i];
+          min_index = i;
+        }
+    }
+
+  /* moves aren't free, only move on a significant imbalance.  Check
+   * min_load >= load first, the subtractions below are unsigned.
+   */
+  if (min_load == UINT_MAX
+      || min_load >= load
+      || load < IPMICONSOLE_ENGINE_REBALANCE_LOAD_MIN
+      || (load - min_load) < (load / 4))
+    goto unlock_load_mutex;
+
+  list_iterator_reset (itr);
+  while ((c = (ipmiconsole_ctx_t)list_next (itr)))
+    {
+      if (c->session.close_session_flag
+          || c->session.protocol_state != IPMICONSOLE_PROTOCOL_STATE_SOL_SESSION)
+        continue;
+
+      if (c->connection.engine_load
+          && c->connection.engine_load < (load - min_load)
+          && (!c_move || c->connection.engine_load > c_move->connection.engine_load))
+        c_move = c;
+    }
+
+  if (!c_move)
+    goto unlock_load_mutex;
+
+  /* so other threads don't all pick the same thread in the meantime */
+  console_engine_load[index] -= c_move->connection.engine_load;
+  console_engine_load[min_index] += c_move->connection.engine_load;
+
+ unlock_load_mutex:
+  if ((perr = pthread_mutex_unlock (&console_engine_load_mutex)))
+    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+
+  if (!c_move)
+    goto cleanup;
+
+  list_iterator_reset (itr);
+  while ((c = (ipmiconsole_ctx_t)list_next (itr)))
+    {
+      if (c == c_move)
+        {
+          /* list_remove() does not call the ListDelF */
+          list_remove (itr);
+          break;
+        }
+    }
+
+  IPMICONSOLE_CTX_DEBUG (c_move, ("moving from engine thread %u to %u; load=%u",
+                                  index,
+                                  min_index,
+                                  c_move->connection.engine_load));
+
+  /* the new engine thread registers fds in its own epoll set */
+  _ipmiconsole_engine_epoll_unregister (c_move);
+  _ipmiconsole_engine_ctxs_count_sub (index, 1);
+  _ipmiconsole_engine_ctxs_count_add (min_index, 1);
+  _ipmiconsole_engine_submit_queue_push (min_index, c_move);
+
+ cleanup:
+  list_iterator_destroy (itr);
+}
+
 static int
 _ipmiconsole_garbage_collector_create (void)
 {
@@ -205,7 +962,7 @@ ipmiconsole_engine_setup (unsigned int thread_count)
   int perr;
 
   assert (!console_engine_thread_count);
-  assert (thread_count && thread_count <= IPMICONSOLE_THREAD_COUNT_MAX);
+  assert (thread_count && thread_count <= ipmiconsole_engine_thread_count_max ());
 
   if ((perr = pthread_mutex_lock (&console_engine_is_setup_mutex)))
     {
@@ -214,13 +971,24 @@ ipmiconsole_engine_setup (unsigned int thread_count)
       return (-1);
     }
 
-  memset (console_engine_ctxs, '\0', IPMICONSOLE_THREAD_COUNT_MAX * sizeof (List));
-  memset (console_engine_ctxs_count, '\0', IPMICONSOLE_THREAD_COUNT_MAX * sizeof (unsigned int));
-  memset (console_engine_ctxs_mutex, '\0', IPMICONSOLE_THREAD_COUNT_MAX * sizeof (pthread_mutex_t));
-  for (i = 0; i < IPMICONSOLE_THREAD_COUNT_MAX; i++)
+  if (!(console_engine_ctxs = (List *)calloc (thread_count, sizeof (List)))
+      || !(console_engine_ctxs_count = (unsigned int *)calloc (thread_count, sizeof (unsigned int)))
+      || !(console_engine_ctxs_mutex = (pthread_mutex_t *)calloc (thread_count, sizeof (pthread_mutex_t)))
+      || !(console_engine_submit_queue = (ipmiconsole_ctx_t *)calloc (thread_count, sizeof (ipmiconsole_ctx_t)))
+      || !(console_engine_load = (unsigned int *)calloc (thread_count, sizeof (unsigned int)))
+      || !(console_engine_ctxs_notifier = (int (*)[2])calloc (thread_count, sizeof (int [2])))
+      || !(console_engine_epoll_fd = (int *)calloc (thread_count, sizeof (int))))
+    {
+      IPMICONSOLE_DEBUG (("calloc: %s", strerror (errno)));
+      goto cleanup;
+    }
+  console_engine_ctxs_num = thread_count;
+
+  for (i = 0; i < console_engine_ctxs_num; i++)
     {
       console_engine_ctxs_notifier[i][0] = -1;
       console_engine_ctxs_notifier[i][1] = -1;
+      console_engine_epoll_fd[i] = -1;
     }
   garbage_collector_notifier[0] = -1;
   garbage_collector_notifier[1] = -1;
@@ -234,9 +1002,9 @@ ipmiconsole_engine_setup (unsigned int thread_count)
       goto cleanup;
     }
 
-  for (i = 0; i < IPMICONSOLE_THREAD_COUNT_MAX; i++)
+  for (i = 0; i < console_engine_ctxs_num; i++)
     {
-      if (!(console_engine_ctxs[i] = list_create ((ListDelF)ipmiconsole_ctx_connection_cleanup_session_submitted)))
+      if (!(console_engine_ctxs[i] = list_create ((ListDelF)_ipmiconsole_engine_ctx_cleanup)))
         {
           IPMICONSOLE_DEBUG (("list_create: %s", strerror (errno)));
           goto cleanup;
@@ -249,9 +1017,7 @@ ipmiconsole_engine_setup (unsigned int thread_count)
         }
     }
 
-  /* Don't create fds for all ctxs_notifier to limit fd creation */
-  console_engine_ctxs_notifier_num = thread_count;
-  for (i = 0; i < console_engine_ctxs_notifier_num; i++)
+  for (i = 0; i < console_engine_ctxs_num; i++)
     {
       if (pipe (console_engine_ctxs_notifier[i]) < 0)
         {
@@ -265,11 +1031,46 @@ ipmiconsole_engine_setup (unsigned int thread_count)
           goto cleanup;
         }
 
-      if (ipmiconsole_set_closeonexec (NULL, console_engine_ctxs_notifier[i][1]) < 0)
-        {
-          IPMICONSOLE_DEBUG (("closeonexec error"));
-          goto cleanup;
+      if (ipmiconsole_set_closeonexec (NULL, console_engine_ctxs_notifier[i][1]) < 0)
+        {
+          IPMICONSOLE_DEBUG (("closeonexec error"));
+          goto cleanup;
+        }
+
+#if HAVE_SYS_EPOLL_H
+      if ((console_engine_epoll_fd[i] = epoll_create (IPMICONSOLE_EPOLL_EVENTS_MAX)) < 0)
+        {
+          /* not supported by the kernel, use poll() */
+          if (errno != ENOSYS)
+            {
+              IPMICONSOLE_DEBUG (("epoll_create: %s", strerror (errno)));
+              goto cleanup;
+            }
+        }
+      else
+        {
+          struct epoll_event ev;
+
+          if (ipmiconsole_set_closeonexec (NULL, console_engine_epoll_fd[i]) < 0)
+            {
+              IPMICONSOLE_DEBUG (("closeonexec error"));
+              goto cleanup;
+            }
+
+          /* NULL data is the notifier */
+          memset (&ev, '\0', sizeof (struct epoll_event));
+          ev.events = EPOLLIN;
+          ev.data.ptr = NULL;
+          if (epoll_ctl (console_engine_epoll_fd[i],
+                         EPOLL_CTL_ADD,
+                         console_engine_ctxs_notifier[i][0],
+                         &ev) < 0)
+            {
+              IPMICONSOLE_DEBUG (("epoll_ctl: %s", strerror (errno)));
+              goto cleanup;
+            }
         }
+#endif /* HAVE_SYS_EPOLL_H */
     }
 
   if (pipe (garbage_collector_notifier) < 0)
@@ -305,6 +1106,9 @@ ipmiconsole_engine_setup (unsigned int thread_count)
   if (_ipmiconsole_garbage_collector_create () < 0)
     goto cleanup;
 
+  if (_ipmiconsole_engine_counters_setup (console_engine_ctxs_num) < 0)
+    goto cleanup;
+
   console_engine_is_setup++;
   console_engine_teardown = 0;
   console_engine_teardown_immediate = 0;
@@ -319,7 +1123,7 @@ ipmiconsole_engine_setup (unsigned int thread_count)
   return (0);
 
  cleanup:
-  for (i = 0; i < IPMICONSOLE_THREAD_COUNT_MAX; i++)
+  for (i = 0; i < console_engine_ctxs_num; i++)
     {
       if (console_engine_ctxs[i])
         {
@@ -331,7 +1135,10 @@ ipmiconsole_engine_setup (unsigned int thread_count)
       close (console_engine_ctxs_notifier[i][0]);
       /* ignore potential error, cleanup path */
       close (console_engine_ctxs_notifier[i][1]);
+      /* ignore potential error, cleanup path */
+      close (console_engine_epoll_fd[i]);
     }
+  _ipmiconsole_engine_free ();
   if (console_engine_ctxs_to_destroy)
     list_destroy (console_engine_ctxs_to_destroy);
   console_engine_ctxs_to_destroy = NULL;
@@ -394,24 +1201,86 @@ ipmiconsole_engine_thread_count (void)
   return (thread_count);
 }
 
-static int
-_teardown_initiate (void *x, void *arg)
+void
+ipmiconsole_engine_counters_add (unsigned int index,
+                                 ipmiconsole_counter_t counter,
+                                 unsigned int n)
 {
-  ipmiconsole_ctx_t c;
+  int perr;
 
-  assert (x);
+  assert (index < console_engine_thread_counters_num);
 
-  c = (ipmiconsole_ctx_t)x;
+  /* not meaningful summed across contexts */
+  if (counter == IPMICONSOLE_COUNTER_SOL_CHARACTER_SEND_SIZE)
+    return;
 
-  assert (c);
-  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+  if ((perr = pthread_mutex_lock (&console_engine_thread_counters_mutex[index])))
+    {
+      IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+      return;
+    }
 
-  if (!c->session.close_session_flag)
-    c->session.close_session_flag++;
+  ipmiconsole_counters_add (&console_engine_thread_counters[index], counter, n);
+
+  if ((perr = pthread_mutex_unlock (&console_engine_thread_counters_mutex[index])))
+    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+}
+
+int
+ipmiconsole_engine_counters (struct ipmiconsole_ctx_counters *counters)
+{
+  unsigned int i;
+  int perr;
+
+  assert (counters);
+
+  if ((perr = pthread_mutex_lock (&console_engine_counters_mutex)))
+    {
+      IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+      errno = perr;
+      return (-1);
+    }
+
+  memcpy (counters, &console_engine_counters, sizeof (struct ipmiconsole_ctx_counters));
+
+  for (i = 0; i < console_engine_thread_counters_num; i++)
+    {
+      if ((perr = pthread_mutex_lock (&console_engine_thread_counters_mutex[i])))
+        {
+          IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
+          continue;
+        }
+
+      _ipmiconsole_counters_sum (counters, &console_engine_thread_counters[i]);
+
+      if ((perr = pthread_mutex_unlock (&console_engine_thread_counters_mutex[i])))
+        IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+    }
+
+  if ((perr = pthread_mutex_unlock (&console_engine_counters_mutex)))
+    {
+      IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+      errno = perr;
+      return (-1);
+    }
 
   return (0);
 }
 
+unsigned int
+ipmiconsole_engine_thread_count_max (void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  long ncpus;
+
+  /* Allow one engine thread per core on large machines */
+  if ((ncpus = sysconf (_SC_NPROCESSORS_ONLN)) > IPMICONSOLE_THREAD_COUNT_MAX)
+    return ((unsigned int)ncpus);
+#endif /* _SC_NPROCESSORS_ONLN */
+
+  return (IPMICONSOLE_THREAD_COUNT_MAX);
+}
+
 static int
 _poll_setup (void *x, void *arg)
 {
@@ -450,7 +1319,7 @@ _poll_setup (void *x, void *arg)
       poll_data->pfds[poll_data->pfds_index*3 + 2].events = 0;
       poll_data->pfds[poll_data->pfds_index*3 + 2].revents = 0;
       poll_data->pfds[poll_data->pfds_index*3 + 2].events |= POLLIN;
-      if (!scbuf_is_empty (c->connection.console_bmc_to_remote_console))
+      if (_ipmiconsole_engine_console_output_pending (c))
         poll_data->pfds[poll_data->pfds_index*3 + 2].events |= POLLOUT;
     }
   else
@@ -619,10 +1488,15 @@ _ipmi_recvfrom (ipmiconsole_ctx_t c)
   if (dropped)
     {
       IPMICONSOLE_CTX_DEBUG (c, ("scbuf_write: dropped data: dropped=%d", dropped));
+      ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED, dropped);
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
       return (-1);
     }
 
+  c->connection.engine_packets++;
+  c->connection.engine_bytes += len;
+  ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_PACKETS_RECEIVED, 1);
+  ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_BYTES_RECEIVED, len);
   return (0);
 }
 
@@ -679,6 +1553,11 @@ _ipmi_sendto (ipmiconsole_ctx_t c)
       return (-1);
     }
 
+  c->connection.engine_packets++;
+  c->connection.engine_bytes += len;
+  ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_PACKETS_SENT, 1);
+  ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_BYTES_SENT, len);
+
 #if 0
   /* don't check, let bad packet timeout */
   if (len != n)
@@ -804,10 +1683,12 @@ _console_read (ipmiconsole_ctx_t c)
   if (dropped)
     {
       IPMICONSOLE_CTX_DEBUG (c, ("scbuf_write: dropped data: dropped=%d", dropped));
+      ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED, dropped);
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
       return (-1);
     }
 
+  c->connection.engine_bytes += len;
   return (0);
 }
 
@@ -818,8 +1699,6 @@ _console_read (ipmiconsole_ctx_t c)
 static int
 _console_write (ipmiconsole_ctx_t c)
 {
-  char buffer[IPMICONSOLE_PACKET_BUFLEN];
-  ssize_t len;
   int n;
 
   assert (c);
@@ -833,18 +1712,19 @@ _console_write (ipmiconsole_ctx_t c)
    * Deal with it later.
    */
 
-  if ((n = scbuf_read (c->connection.console_bmc_to_remote_console, buffer, IPMICONSOLE_PACKET_BUFLEN)) < 0)
+  /* Write straight out of the scbuf rather than bouncing through a
+   * stack buffer.  A wrapped scbuf goes out in one writev().  If
+   * fewer bytes are written than are available, the remainder stays
+   * in the scbuf and goes out on the next POLLOUT.
+   */
+  if ((n = scbuf_read_to_fd (c->connection.console_bmc_to_remote_console,
+                             c->connection.ipmiconsole_fd,
+                             -1)) < 0)
     {
-      IPMICONSOLE_CTX_DEBUG (c, ("scbuf_read: %s", strerror (errno)));
-      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
-      return (-1);
-    }
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return (0);
 
-  if ((len = write (c->connection.ipmiconsole_fd,
-                    buffer,
-                    n)) < 0)
-    {
-      IPMICONSOLE_CTX_DEBUG (c, ("write: %s", strerror (errno)));
+      IPMICONSOLE_CTX_DEBUG (c, ("scbuf_read_to_fd: %s", strerror (errno)));
 
       if (errno == EPIPE)
         {
@@ -858,21 +1738,7 @@ _console_write (ipmiconsole_ctx_t c)
       return (-1);
     }
 
-  if (len != n)
-    {
-      IPMICONSOLE_CTX_DEBUG (c, ("write: invalid bytes written; n=%d; len=%d", n, len));
-      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
-      return (-1);
-    }
-
-  /* scbuf should be empty now */
-  if (!scbuf_is_empty (c->connection.console_bmc_to_remote_console))
-    {
-      IPMICONSOLE_CTX_DEBUG (c, ("console_bmc_to_remote_console not empty"));
-      /* Note: Not a fatal error, just return*/
-      return (0);
-    }
-
+  c->connection.engine_bytes += n;
   return (0);
 }
 
@@ -932,6 +1798,122 @@ _ipmiconsole_poll (struct pollfd *ufds, unsigned int nfds, int timeout)
   return n;
 }
 
+/* _ipmiconsole_engine_ctx_events
+ * - Handle the poll()/epoll events on the fds of context c.  Errors
+ *   are handled by setting the close_session_flag.
+ */
+static void
+_ipmiconsole_engine_ctx_events (ipmiconsole_ctx_t c,
+                                short ipmi_fd_revents,
+                                short asynccomm_revents,
+                                short ipmiconsole_fd_revents)
+{
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  if (ipmi_fd_revents & POLLERR)
+    {
+      IPMICONSOLE_CTX_DEBUG (c, ("POLLERR"));
+      /* See comments in _ipmi_recvfrom() regarding ECONNRESET/ECONNREFUSED */
+      if (_ipmi_recvfrom (c) < 0)
+        {
+          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SYSTEM_ERROR);
+          c->session.close_session_flag++;
+          goto done;
+        }
+    }
+  if (!c->session.close_session_flag)
+    {
+      if (asynccomm_revents & POLLNVAL)
+        {
+          /* This indicates the user closed the asynccomm file descriptors
+           * which is ok.  With epoll, this is a hangup on the engine's
+           * dup of asynccomm[0].
+           */
+          IPMICONSOLE_CTX_DEBUG (c, ("POLLNVAL"));
+          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SUCCESS);
+          c->session.close_session_flag++;
+          goto done;
+        }
+      if (ipmiconsole_fd_revents & POLLHUP)
+        {
+          /* This indicates the user closed the other end of
+           * the socketpair so it's ok.
+           */
+          IPMICONSOLE_CTX_DEBUG (c, ("POLLHUP"));
+          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SUCCESS);
+          c->session.close_session_flag++;
+          goto done;
+        }
+      if (asynccomm_revents & POLLERR)
+        {
+          IPMICONSOLE_CTX_DEBUG (c, ("POLLERR"));
+          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
+          c->session.close_session_flag++;
+          goto done;
+        }
+      if (ipmiconsole_fd_revents & POLLERR)
+        {
+          IPMICONSOLE_CTX_DEBUG (c, ("POLLERR"));
+          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
+          c->session.close_session_flag++;
+          goto done;
+        }
+    }
+  if (ipmi_fd_revents & POLLIN)
+    {
+      if (_ipmi_recvfrom (c) < 0)
+        {
+          c->session.close_session_flag++;
+          goto done;
+        }
+    }
+  if (ipmi_fd_revents & POLLOUT)
+    {
+      if (_ipmi_sendto (c) < 0)
+        {
+          c->session.close_session_flag++;
+          goto done;
+        }
+    }
+  if (asynccomm_revents & POLLIN)
+    {
+      if (_asynccomm (c) < 0)
+        {
+          c->session.close_session_flag++;
+          goto done;
+        }
+    }
+  if (!c->session.close_session_flag)
+    {
+      if (ipmiconsole_fd_revents & POLLIN)
+        {
+          if (_console_read (c) < 0)
+            {
+              c->session.close_session_flag++;
+              goto done;
+            }
+        }
+      if (ipmiconsole_fd_revents & POLLOUT
+          && _ipmiconsole_engine_console_output_pending (c))
+        {
+          if (_console_write (c) < 0)
+            {
+              c->session.close_session_flag++;
+              goto done;
+            }
+        }
+    }
+
+ done:
+  /* output scbufs may have been drained, or the session is closing */
+  if (ipmiconsole_engine_ctx_events_update (c) < 0)
+    {
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SYSTEM_ERROR);
+      c->session.close_session_flag++;
+    }
+}
+
 static void *
 _ipmiconsole_engine (void *arg)
 {
@@ -939,12 +1921,13 @@ _ipmiconsole_engine (void *arg)
   unsigned int index;
   unsigned int teardown_flag = 0;
   unsigned int teardown_initiated = 0;
+  struct timeval next_rebalance;
 
   assert (arg);
 
   index = *((unsigned int *)arg);
 
-  assert (index < IPMICONSOLE_THREAD_COUNT_MAX);
+  assert (index < console_engine_ctxs_num);
 
   free (arg);
 
@@ -952,6 +1935,8 @@ _ipmiconsole_engine (void *arg)
   if (signal (SIGPIPE, SIG_IGN) == SIG_ERR)
     IPMICONSOLE_DEBUG (("signal: %s", strerror (errno)));
 
+  timeval_clear (&next_rebalance);
+
   while (!teardown_flag || ctxs_count)
     {
       struct _ipmiconsole_poll_data poll_data;
@@ -1004,6 +1989,8 @@ _ipmiconsole_engine (void *arg)
           teardown_flag = 1;
         }
 
+      _ipmiconsole_engine_submit_queue_process (index, teardown_initiated);
+
       /* Note: Set close_session_flag in the contexts before
        * ipmiconsole_process_ctxs(), so the initiation of the closing
        * down will begin now rather than the next iteration of the
@@ -1022,9 +2009,28 @@ _ipmiconsole_engine (void *arg)
           teardown_initiated++;
         }
 
+      if (console_engine_ctxs_num > 1 && !teardown_flag)
+        {
+          struct timeval current;
+
+          if (gettimeofday (&current, NULL) < 0)
+            IPMICONSOLE_DEBUG (("gettimeofday: %s", strerror (errno)));
+          else if (!timeval_lt (&current, &next_rebalance))
+            {
+              _ipmiconsole_engine_rebalance (index);
+              timeval_add_ms (&current, IPMICONSOLE_ENGINE_REBALANCE_INTERVAL, &next_rebalance);
+            }
+        }
+
       if ((ctxs_count = ipmiconsole_process_ctxs (console_engine_ctxs[index], &timeout_len)) < 0)
         goto continue_loop;
 
+      /* wake up for the next rebalance even if contexts are idle */
+      if (console_engine_ctxs_num > 1
+          && !teardown_flag
+          && timeout_len > IPMICONSOLE_ENGINE_REBALANCE_INTERVAL)
+        timeout_len = IPMICONSOLE_ENGINE_REBALANCE_INTERVAL;
+
       if (!ctxs_count && teardown_flag)
         continue;
 
@@ -1035,6 +2041,72 @@ _ipmiconsole_engine (void *arg)
         }
       poll_data.ctxs_len = ctxs_count;
 
+#if HAVE_SYS_EPOLL_H
+      if (console_engine_epoll_fd[index] >= 0)
+        {
+          struct epoll_event events[IPMICONSOLE_EPOLL_EVENTS_MAX];
+          int n;
+
+          /* fds are registered on submission, nothing to setup */
+          if ((perr = pthread_mutex_unlock (&console_engine_ctxs_mutex[index])))
+            IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+          unlock_console_engine_ctxs_mutex_flag++;
+
+          if ((n = epoll_wait (console_engine_epoll_fd[index],
+                               events,
+                               IPMICONSOLE_EPOLL_EVENTS_MAX,
+                               timeout_len)) < 0)
+            {
+              /* on EINTR, timeouts are calculated again in the next
+               * iteration
+               */
+              if (errno != EINTR)
+                IPMICONSOLE_DEBUG (("epoll_wait: %s", strerror (errno)));
+              goto continue_loop;
+            }
+
+          /* contexts are only removed from the list by this thread,
+           * so the event data is still valid
+           */
+          for (i = 0; i < n; i++)
+            {
+              struct ipmiconsole_ctx_epoll_data *data;
+              short revents = 0;
+
+              if (!(data = (struct ipmiconsole_ctx_epoll_data *)events[i].data.ptr))
+                {
+                  /* We don't care what's read, just get it off the fd */
+                  if (read (console_engine_ctxs_notifier[index][0], buf, IPMICONSOLE_PIPE_BUFLEN) < 0)
+                    IPMICONSOLE_DEBUG (("read: %s", strerror (errno)));
+                  continue;
+                }
+
+              if (events[i].events & EPOLLIN)
+                revents |= POLLIN;
+              if (events[i].events & EPOLLOUT)
+                revents |= POLLOUT;
+              if (events[i].events & EPOLLERR)
+                revents |= POLLERR;
+              if (events[i].events & EPOLLHUP)
+                revents |= POLLHUP;
+
+              if (data->type == IPMICONSOLE_EPOLL_DATA_IPMI_FD)
+                _ipmiconsole_engine_ctx_events (data->c, revents, 0, 0);
+              else if (data->type == IPMICONSOLE_EPOLL_DATA_ASYNCCOMM)
+                {
+                  /* user closed asynccomm, see above */
+                  if (revents & POLLHUP)
+                    revents = (revents & ~POLLHUP) | POLLNVAL;
+                  _ipmiconsole_engine_ctx_events (data->c, 0, revents, 0);
+                }
+              else
+                _ipmiconsole_engine_ctx_events (data->c, 0, 0, revents);
+            }
+
+          goto continue_loop;
+        }
+#endif /* HAVE_SYS_EPOLL_H */
+
       /* achu: I always wonder if this poll() loop could be done far
        * more elegantly and efficiently without all this crazy
        * indexing, perhaps through a callback/event mechanism.  It'd
@@ -1100,99 +2172,10 @@ _ipmiconsole_engine (void *arg)
         }
 
       for (i = 0; i < poll_data.ctxs_len; i++)
-        {
-          if (poll_data.pfds[i*3].revents & POLLERR)
-            {
-              IPMICONSOLE_CTX_DEBUG (poll_data.pfds_ctxs[i], ("POLLERR"));
-              /* See comments in _ipmi_recvfrom() regarding ECONNRESET/ECONNREFUSED */
-              if (_ipmi_recvfrom (poll_data.pfds_ctxs[i]) < 0)
-                {
-                  ipmiconsole_ctx_set_errnum (poll_data.pfds_ctxs[i], IPMICONSOLE_ERR_SYSTEM_ERROR);
-                  poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                  continue;
-                }
-            }
-          if (!poll_data.pfds_ctxs[i]->session.close_session_flag)
-            {
-              if (poll_data.pfds[i*3+1].revents & POLLNVAL)
-                {
-                  /* This indicates the user closed the asynccomm file descriptors
-                   * which is ok.
-                   */
-                  IPMICONSOLE_CTX_DEBUG (poll_data.pfds_ctxs[i], ("POLLNVAL"));
-                  ipmiconsole_ctx_set_errnum (poll_data.pfds_ctxs[i], IPMICONSOLE_ERR_SUCCESS);
-                  poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                  continue;
-                }
-              if (poll_data.pfds[i*3+2].revents & POLLHUP)
-                {
-                  /* This indicates the user closed the other end of
-                   * the socketpair so it's ok.
-                   */
-                  IPMICONSOLE_CTX_DEBUG (poll_data.pfds_ctxs[i], ("POLLHUP"));
-                  ipmiconsole_ctx_set_errnum (poll_data.pfds_ctxs[i], IPMICONSOLE_ERR_SUCCESS);
-                  poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                  continue;
-                }
-              if (poll_data.pfds[i*3+1].revents & POLLERR)
-                {
-                  IPMICONSOLE_CTX_DEBUG (poll_data.pfds_ctxs[i], ("POLLERR"));
-                  ipmiconsole_ctx_set_errnum (poll_data.pfds_ctxs[i], IPMICONSOLE_ERR_INTERNAL_ERROR);
-                  poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                  continue;
-                }
-              if (poll_data.pfds[i*3+2].revents & POLLERR)
-                {
-                  IPMICONSOLE_CTX_DEBUG (poll_data.pfds_ctxs[i], ("POLLERR"));
-                  ipmiconsole_ctx_set_errnum (poll_data.pfds_ctxs[i], IPMICONSOLE_ERR_INTERNAL_ERROR);
-                  poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                  continue;
-                }
-            }
-          if (poll_data.pfds[i*3].revents & POLLIN)
-            {
-              if (_ipmi_recvfrom (poll_data.pfds_ctxs[i]) < 0)
-                {
-                  poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                  continue;
-                }
-            }
-          if (poll_data.pfds[i*3].revents & POLLOUT)
-            {
-              if (_ipmi_sendto (poll_data.pfds_ctxs[i]) < 0)
-                {
-                  poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                  continue;
-                }
-            }
-          if (poll_data.pfds[i*3 + 1].revents & POLLIN)
-            {
-              if (_asynccomm (poll_data.pfds_ctxs[i]) < 0)
-                {
-                  poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                  continue;
-                }
-            }
-          if (!poll_data.pfds_ctxs[i]->session.close_session_flag)
-            {
-              if (poll_data.pfds[i*3+2].revents & POLLIN)
-                {
-                  if (_console_read (poll_data.pfds_ctxs[i]) < 0)
-                    {
-                      poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                      continue;
-                    }
-                }
-              if (poll_data.pfds[i*3+2].revents & POLLOUT)
-                {
-                  if (_console_write (poll_data.pfds_ctxs[i]) < 0)
-                    {
-                      poll_data.pfds_ctxs[i]->session.close_session_flag++;
-                      continue;
-                    }
-                }
-            }
-        }
+        _ipmiconsole_engine_ctx_events (poll_data.pfds_ctxs[i],
+                                        poll_data.pfds[i*3].revents,
+                                        poll_data.pfds[i*3 + 1].revents,
+                                        poll_data.pfds[i*3 + 2].revents);
 
       /* We don't care what's read, just get it off the fd */
       if (poll_data.pfds[(poll_data.ctxs_len * 3)].revents & POLLIN)
@@ -1257,7 +2240,7 @@ ipmiconsole_engine_thread_create (void)
       return (-1);
     }
 
-  assert (console_engine_thread_count < IPMICONSOLE_THREAD_COUNT_MAX);
+  assert (console_engine_thread_count < console_engine_ctxs_num);
 
   if ((perr = pthread_attr_init (&attr)))
     {
@@ -1309,71 +2292,33 @@ ipmiconsole_engine_thread_create (void)
 int
 ipmiconsole_engine_submit_ctx (ipmiconsole_ctx_t c)
 {
-  void *ptr;
   unsigned int i;
-  int perr, ret = -1;
+  int perr;
   unsigned int min_submitted = UINT_MAX;
-  int index = 0;
+  unsigned int index = 0;
 
   assert (c);
   assert (c->magic == IPMICONSOLE_CTX_MAGIC);
   assert (!(c->session_submitted));
   assert (console_engine_is_setup);
 
-  if ((perr = pthread_mutex_lock (&console_engine_thread_count_mutex)))
-    {
-      IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
-      return (-1);
-    }
-
-  for (i = 0; i < console_engine_thread_count; i++)
+  /* Note: No locks necessary, console_engine_ctxs_num does not
+   * change while the engine is setup and the counts are atomic.  A
+   * racing submission may pick the same thread, the engine threads
+   * will rebalance later if necessary.
+   */
+  for (i = 0; i < console_engine_ctxs_num; i++)
     {
-      if ((perr = pthread_mutex_lock (&console_engine_ctxs_mutex[i])))
-        {
-          IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
-          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
-          goto cleanup_thread_count;
-        }
+      unsigned int count = _ipmiconsole_engine_ctxs_count_get (i);
 
-      if (console_engine_ctxs_count[i] < min_submitted)
+      if (count < min_submitted)
         {
-          min_submitted = console_engine_ctxs_count[i];
+          min_submitted = count;
           index = i;
         }
-
-      if ((perr = pthread_mutex_unlock (&console_engine_ctxs_mutex[i])))
-        {
-          IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
-          ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
-          goto cleanup_thread_count;
-        }
-    }
-
-  if ((perr = pthread_mutex_lock (&console_engine_ctxs_mutex[index])))
-    {
-      IPMICONSOLE_DEBUG (("pthread_mutex_lock: %s", strerror (perr)));
-      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
-      goto cleanup_thread_count;
-    }
-
-  if (!(ptr = list_append (console_engine_ctxs[index], c)))
-    {
-      /* Note: Don't do a CTX debug, this is more of a global debug */
-      IPMICONSOLE_DEBUG (("list_append: %s", strerror (errno)));
-      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
-      goto cleanup_ctxs;
-    }
-
-  if (ptr != (void *)c)
-    {
-      IPMICONSOLE_DEBUG (("list_append: invalid pointer: ptr=%p; c=%p", ptr, c));
-      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
-      goto cleanup_ctxs;
     }
 
-  console_engine_ctxs_count[index]++;
-
-  ret = 0;
+  _ipmiconsole_engine_ctxs_count_add (index, 1);
 
   /* achu:
    *
@@ -1391,22 +2336,10 @@ ipmiconsole_engine_submit_ctx (ipmiconsole_ctx_t c)
   if ((perr = pthread_mutex_unlock (&(c->signal.mutex_ctx_state))) != 0)
     IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
 
-  /* "Interrupt" the engine and tell it to get moving along w/ the new context */
-  if (write (console_engine_ctxs_notifier[index][1], "1", 1) < 0)
-    IPMICONSOLE_DEBUG (("write: %s", strerror (errno)));
-
- cleanup_ctxs:
-  if ((perr = pthread_mutex_unlock (&console_engine_ctxs_mutex[index])))
-    {
-      IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
-      goto cleanup_thread_count;
-    }
-
- cleanup_thread_count:
-  if ((perr = pthread_mutex_unlock (&console_engine_thread_count_mutex)))
-    IPMICONSOLE_DEBUG (("pthread_mutex_unlock: %s", strerror (perr)));
+  /* Note: After this, the context belongs to the engine thread */
+  _ipmiconsole_engine_submit_queue_push (index, c);
 
-  return (ret);
+  return (0);
 }
 
 int
@@ -1462,7 +2395,7 @@ ipmiconsole_engine_cleanup (int cleanup_sol_sessions)
     }
 
   /* "Interrupt" the engine thread and tell it to get moving along */
-  for (i = 0; i < console_engine_ctxs_notifier_num; i++)
+  for (i = 0; i < console_engine_ctxs_num; i++)
     {
       if (write (console_engine_ctxs_notifier[i][1], "1", 1) < 0)
         IPMICONSOLE_DEBUG (("write: %s", strerror (errno)));
@@ -1526,18 +2459,32 @@ ipmiconsole_engine_cleanup (int cleanup_sol_sessions)
     }
 
  engine_cleanup:
-  for (i = 0; i < IPMICONSOLE_THREAD_COUNT_MAX; i++)
+  for (i = 0; i < console_engine_ctxs_num; i++)
     {
+      ipmiconsole_ctx_t c;
+
       if (console_engine_ctxs[i])
         list_destroy (console_engine_ctxs[i]);
       console_engine_ctxs[i] = NULL;
-      console_engine_ctxs[i] = 0;
+
+      /* Contexts submitted or moved after the engine thread exited */
+      c = _ipmiconsole_engine_submit_queue_take (i);
+      while (c)
+        {
+          ipmiconsole_ctx_t c_next = c->connection.engine_submit_next;
+          _ipmiconsole_engine_ctx_cleanup (c);
+          c = c_next;
+        }
+
       pthread_mutex_destroy (&console_engine_ctxs_mutex[i]);
       /* ignore potential error, cleanup path */
       close (console_engine_ctxs_notifier[i][0]);
       /* ignore potential error, cleanup path */
       close (console_engine_ctxs_notifier[i][1]);
+      /* ignore potential error, cleanup path */
+      close (console_engine_epoll_fd[i]);
     }
+  _ipmiconsole_engine_free ();
   /* ignore potential error, cleanup path */
   close (garbage_collector_notifier[0]);
   /* ignore potential error, cleanup path */
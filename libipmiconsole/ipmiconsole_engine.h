@@ -35,10 +35,30 @@ int ipmiconsole_engine_is_setup (void);
 
 int ipmiconsole_engine_thread_count (void);
 
+/* Maximum thread count, IPMICONSOLE_THREAD_COUNT_MAX or the number of
+ * online cores, whichever is larger.
+ */
+unsigned int ipmiconsole_engine_thread_count_max (void);
+
 int ipmiconsole_engine_thread_create (void);
 
+/* Add n to a counter of engine thread index, see
+ * ipmiconsole_ctx_counters_add()
+ */
+void ipmiconsole_engine_counters_add (unsigned int index,
+                                      ipmiconsole_counter_t counter,
+                                      unsigned int n);
+
+int ipmiconsole_engine_counters (struct ipmiconsole_ctx_counters *counters);
+
 int ipmiconsole_engine_submit_ctx (ipmiconsole_ctx_t c);
 
+/* Update the engine's epoll registrations of context c after its
+ * output scbufs may have gone between empty and non-empty, or its
+ * session started closing.  No-op if the engine uses poll().
+ */
+int ipmiconsole_engine_ctx_events_update (ipmiconsole_ctx_t c);
+
 int ipmiconsole_engine_cleanup (int cleanup_sol_sessions);
 
 #endif /* IPMICONSOLE_ENGINE_H */
@@ -151,6 +151,7 @@ _send_ipmi_packet (ipmiconsole_ctx_t c, ipmiconsole_packet_type_t p)
   if (dropped)
     {
       IPMICONSOLE_CTX_DEBUG (c, ("scbuf_write: dropped data: dropped=%d", dropped));
+      ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED, dropped);
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
       return (-1);
     }
@@ -245,6 +246,8 @@ _send_sol_packet_with_character_data (ipmiconsole_ctx_t c,
         }
       else
         c->session.sol_input_character_data_len = 0;
+
+      c->session.sol_input_coalescing = 0;
     }
 
   if ((pkt_len = ipmiconsole_sol_packet_assemble (c,
@@ -281,6 +284,7 @@ _send_sol_packet_with_character_data (ipmiconsole_ctx_t c,
   if (dropped)
     {
       IPMICONSOLE_CTX_DEBUG (c, ("scbuf_write: dropped data: dropped=%d", dropped));
+      ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED, dropped);
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
       goto cleanup;
     }
@@ -292,12 +296,112 @@ _send_sol_packet_with_character_data (ipmiconsole_ctx_t c,
       goto cleanup;
     }
 
+  c->session.sol_input_retransmitted = is_retransmission;
   c->session.sol_input_waiting_for_ack++;
+
+  if (!is_retransmission && c->session.sol_input_character_data_len)
+    {
+      ipmiconsole_ctx_counters_add (c,
+                                    IPMICONSOLE_COUNTER_SOL_PACKETS_SENT,
+                                    1);
+      ipmiconsole_ctx_counters_add (c,
+                                    IPMICONSOLE_COUNTER_SOL_CHARACTER_BYTES_SENT,
+                                    c->session.sol_input_character_data_len);
+      ipmiconsole_ctx_counters_add (c,
+                                    IPMICONSOLE_COUNTER_SOL_CHARACTER_SEND_SIZE,
+                                    c->session.max_sol_character_send_size);
+    }
+
   rv = 0;
  cleanup:
   return (rv);
 }
 
+/* _sol_input_coalesce_timeout_len
+ * - Returns the time in microseconds outbound character data may be
+ *   held, 0 if coalescing is not configured
+ */
+static unsigned int
+_sol_input_coalesce_timeout_len (ipmiconsole_ctx_t c)
+{
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  if (c->config.sol_coalesce_timeout)
+    return (c->config.sol_coalesce_timeout);
+
+  if (c->config.sol_coalesce_bytes)
+    return (IPMICONSOLE_SOL_COALESCE_TIMEOUT_DEFAULT);
+
+  return (0);
+}
+
+/*
+ * Returns 1 if outbound character data should be held to coalesce it
+ * w/ more user input, similar to Nagle's algorithm.
+ * Returns 0 if it should be sent now
+ * Returns -1 on error
+ */
+static int
+_sol_input_coalesce (ipmiconsole_ctx_t c)
+{
+  struct timeval current, timeout, timeout_len;
+  unsigned int coalesce_timeout_len;
+  unsigned int coalesce_bytes;
+  unsigned int used;
+  int n;
+
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  if (!(coalesce_timeout_len = _sol_input_coalesce_timeout_len (c)))
+    return (0);
+
+  /* Don't hold up a serial break */
+  if (c->session.break_requested)
+    goto send;
+
+  coalesce_bytes = c->session.max_sol_character_send_size;
+  if (c->config.sol_coalesce_bytes
+      && c->config.sol_coalesce_bytes < coalesce_bytes)
+    coalesce_bytes = c->config.sol_coalesce_bytes;
+
+  if ((n = scbuf_used (c->connection.console_remote_console_to_bmc)) < 0)
+    {
+      IPMICONSOLE_CTX_DEBUG (c, ("scbuf_used: %s", strerror (errno)));
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
+      return (-1);
+    }
+  used = n;
+
+  if (used >= coalesce_bytes)
+    goto send;
+
+  if (gettimeofday (&current, NULL) < 0)
+    {
+      IPMICONSOLE_CTX_DEBUG (c, ("gettimeofday: %s", strerror (errno)));
+      ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_SYSTEM_ERROR);
+      return (-1);
+    }
+
+  if (!c->session.sol_input_coalescing)
+    {
+      c->session.sol_input_coalesce_start = current;
+      c->session.sol_input_coalescing++;
+      return (1);
+    }
+
+  timeout_len.tv_sec = coalesce_timeout_len / 1000000;
+  timeout_len.tv_usec = coalesce_timeout_len % 1000000;
+  timeval_add (&c->session.sol_input_coalesce_start, &timeout_len, &timeout);
+  if (timeval_lt (&current, &timeout))
+    return (1);
+
+ send:
+  c->session.sol_input_coalescing = 0;
+  return (0);
+}
+
 /*
  * Returns 0 on success
  * Returns -1 on error
@@ -362,6 +466,7 @@ _send_sol_packet_ack_only (ipmiconsole_ctx_t c,
   if (dropped)
     {
       IPMICONSOLE_CTX_DEBUG (c, ("scbuf_write: dropped data: dropped=%d", dropped));
+      ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED, dropped);
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
       return (-1);
     }
@@ -443,6 +548,7 @@ _send_sol_packet_generate_break (ipmiconsole_ctx_t c,
   if (dropped)
     {
       IPMICONSOLE_CTX_DEBUG (c, ("scbuf_write: dropped data: dropped=%d", dropped));
+      ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED, dropped);
       ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
       return (-1);
     }
@@ -454,11 +560,90 @@ _send_sol_packet_generate_break (ipmiconsole_ctx_t c,
       return (-1);
     }
 
+  c->session.sol_input_retransmitted = is_retransmission;
   c->session.sol_input_waiting_for_ack++;
   c->session.sol_input_waiting_for_break_ack++;
   return (0);
 }
 
+/*
+ * With IPMICONSOLE_ENGINE_OUTPUT_RING, tell the user console output
+ * is waiting in the output ring by writing a doorbell byte to their
+ * fd.  Only one doorbell is outstanding at a time, the API re-arms it
+ * when the ring has been emptied.
+ */
+static void
+_console_output_notify (ipmiconsole_ctx_t c)
+{
+  int perr;
+
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  if (!(c->config.engine_flags & IPMICONSOLE_ENGINE_OUTPUT_RING))
+    return;
+
+  if ((perr = pthread_mutex_lock (&(c->signal.output_mutex))) != 0)
+    {
+      IPMICONSOLE_CTX_DEBUG (c, ("pthread_mutex_lock: %s", strerror (perr)));
+      return;
+    }
+
+  if (!c->signal.output_doorbell)
+    {
+      /* An EPIPE is ok, the user is allowed to close the session and
+       * the engine will notice on the next read.
+       */
+      if (write (c->connection.ipmiconsole_fd, "\0", 1) < 0)
+        {
+          if (errno != EPIPE)
+            IPMICONSOLE_CTX_DEBUG (c, ("write: %s", strerror (errno)));
+        }
+      else
+        c->signal.output_doorbell = 1;
+    }
+
+  if ((perr = pthread_mutex_unlock (&(c->signal.output_mutex))) != 0)
+    IPMICONSOLE_CTX_DEBUG (c, ("pthread_mutex_unlock: %s", strerror (perr)));
+}
+
+/*
+ * Returns the current retransmission timeout in milliseconds
+ */
+static unsigned int
+_retransmission_timeout_len (ipmiconsole_ctx_t c)
+{
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  if (c->config.engine_flags & IPMICONSOLE_ENGINE_FIXED_RETRANSMISSION_TIMEOUT)
+    return (c->config.retransmission_timeout_len);
+
+  return (rtt_timeout (&(c->session.rtt)));
+}
+
+/*
+ * Sample the round trip time of a request sent at sent and answered
+ * now.  Callers must not sample responses to retransmitted requests.
+ */
+static void
+_rtt_sample (ipmiconsole_ctx_t c, struct timeval *sent)
+{
+  struct timeval current;
+
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+  assert (sent);
+
+  if (gettimeofday (&current, NULL) < 0)
+    {
+      IPMICONSOLE_CTX_DEBUG (c, ("gettimeofday: %s", strerror (errno)));
+      return;
+    }
+
+  rtt_sample (&(c->session.rtt), sent, &current);
+}
+
 /*
  * Returns 0 on success
  * Returns -1 on error
@@ -1327,6 +1512,12 @@ _receive_packet (ipmiconsole_ctx_t c, ipmiconsole_packet_type_t *p)
     }
   else
     {
+      /* Karn's algorithm, a response to a retransmitted request
+       * cannot be matched to the transmission it answers.
+       */
+      if (!c->session.retransmission_count)
+        _rtt_sample (c, &(c->session.last_ipmi_packet_sent));
+
       if (_receive_ipmi_packet_data_reset (c) < 0)
         goto cleanup;
     }
@@ -1470,7 +1661,7 @@ _ipmi_retransmission_timeout (ipmiconsole_ctx_t c)
     retransmission_timeout_multiplier = (c->session.retransmission_count / c->config.retransmission_backoff_count) + 1;
   else
     retransmission_timeout_multiplier = 1;
-  retransmission_timeout_len = c->config.retransmission_timeout_len * retransmission_timeout_multiplier;
+  retransmission_timeout_len = _retransmission_timeout_len (c) * retransmission_timeout_multiplier;
 
   timeval_add_ms (&(c->session.last_ipmi_packet_sent), retransmission_timeout_len, &timeout);
 
@@ -1494,6 +1685,8 @@ _ipmi_retransmission_timeout (ipmiconsole_ctx_t c)
         ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_EXCESS_RETRANSMISSIONS_SENT);
       return (-1);
     }
+  ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_IPMI_RETRANSMISSIONS, 1);
+
 #if 0
   IPMICONSOLE_CTX_DEBUG (c, ("retransmission: retransmission_count = %d; maximum_retransmission_count = %d; protocol_state = %d", c->session.retransmission_count, c->config.maximum_retransmission_count, c->session.protocol_state));
 #endif
@@ -1612,7 +1805,7 @@ _sol_retransmission_timeout (ipmiconsole_ctx_t c, int *dont_deactivate_flag)
 
   (*dont_deactivate_flag) = 0;
 
-  timeval_add_ms (&(c->session.last_sol_input_packet_sent), c->config.retransmission_timeout_len, &timeout);
+  timeval_add_ms (&(c->session.last_sol_input_packet_sent), _retransmission_timeout_len (c), &timeout);
   if (gettimeofday (&current, NULL) < 0)
     {
       IPMICONSOLE_CTX_DEBUG (c, ("gettimeofday: %s", strerror (errno)));
@@ -1673,6 +1866,8 @@ _sol_retransmission_timeout (ipmiconsole_ctx_t c, int *dont_deactivate_flag)
 
  send_sol_packet:
 
+  ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SOL_RETRANSMISSIONS, 1);
+
   if (!c->session.sol_input_waiting_for_break_ack)
     {
       /* Notes: If the previous sol transmission included an ACK,
@@ -1762,6 +1957,7 @@ _keepalive_timeout (ipmiconsole_ctx_t c)
           /* Note that the protocol_state stays in SOL_SESSION */
           if (_send_ipmi_packet (c, IPMICONSOLE_PACKET_TYPE_GET_CHANNEL_PAYLOAD_VERSION_RQ) < 0)
             return (-1);
+          ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_KEEPALIVES_SENT, 1);
           return (1);
         }
     }
@@ -1872,6 +2068,7 @@ _serial_keepalive_timeout (ipmiconsole_ctx_t c)
               if (dropped)
                 {
                   IPMICONSOLE_CTX_DEBUG (c, ("scbuf_write: dropped data: dropped=%d", dropped));
+                  ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED, dropped);
                   ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
                   return (-1);
                 }
@@ -1886,6 +2083,7 @@ _serial_keepalive_timeout (ipmiconsole_ctx_t c)
               c->session.protocol_state = IPMICONSOLE_PROTOCOL_STATE_DEACTIVATE_PAYLOAD_SENT;
               return (1);
             }
+          ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SERIAL_KEEPALIVES_SENT, 1);
           return (1);
         }
     }
@@ -2519,6 +2717,35 @@ _check_try_new_port (ipmiconsole_ctx_t c)
   return (0);
 }
 
+/* _sol_ack_latency_count
+ * - Count the time since the SOL packet being ACKed was last sent
+ */
+static void
+_sol_ack_latency_count (ipmiconsole_ctx_t c)
+{
+  struct timeval current;
+  struct timeval latency;
+
+  assert (c);
+  assert (c->magic == IPMICONSOLE_CTX_MAGIC);
+
+  if (gettimeofday (&current, NULL) < 0)
+    {
+      IPMICONSOLE_CTX_DEBUG (c, ("gettimeofday: %s", strerror (errno)));
+      return;
+    }
+
+  /* clock went backwards */
+  if (timeval_lt (&current, &(c->session.last_sol_input_packet_sent)))
+    return;
+
+  timeval_sub (&current, &(c->session.last_sol_input_packet_sent), &latency);
+
+  ipmiconsole_ctx_counters_add (c,
+                                IPMICONSOLE_COUNTER_SOL_ACK_LATENCY,
+                                latency.tv_sec * 1000 + latency.tv_usec / 1000);
+}
+
 /*
  * Returns 0 on success
  * Returns -1 on error
@@ -2661,6 +2888,11 @@ _sol_bmc_to_remote_console_packet (ipmiconsole_ctx_t c, int *sol_deactivating_fl
       && c->session.sol_input_waiting_for_ack
       && c->session.sol_input_packet_sequence_number == packet_ack_nack_sequence_number)
     {
+      _sol_ack_latency_count (c);
+
+      if (!c->session.sol_input_retransmitted)
+        _rtt_sample (c, &(c->session.last_sol_input_packet_sent));
+
       if (!c->session.sol_input_waiting_for_break_ack)
         {
           /* It's ok if it's a NACK, but we'll log for debugging anyways */
@@ -2792,9 +3024,12 @@ _sol_bmc_to_remote_console_packet (ipmiconsole_ctx_t c, int *sol_deactivating_fl
           if (dropped)
             {
               IPMICONSOLE_CTX_DEBUG (c, ("scbuf_write: dropped data: dropped=%d", dropped));
+              ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED, dropped);
               ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
               goto cleanup;
             }
+
+          _console_output_notify (c);
         }
 
       c->session.last_sol_output_packet_sequence_number = packet_sequence_number;
@@ -2824,6 +3059,9 @@ _sol_bmc_to_remote_console_packet (ipmiconsole_ctx_t c, int *sol_deactivating_fl
           && (!c->session.break_requested
               || (c->session.break_requested && c->session.console_remote_console_to_bmc_bytes_before_break)))
         {
+          /* Not coalesced, the input has already been held while
+           * waiting for this ack, like Nagle's algorithm.
+           */
           if (_send_sol_packet_with_character_data (c, 0, 0, 0) < 0)
             goto cleanup;
         }
@@ -2885,7 +3123,7 @@ _calculate_timeout (ipmiconsole_ctx_t c, unsigned int *timeout)
           else
             sol_retransmission_timeout_multiplier = 1;
 
-          sol_retransmission_timeout_len = c->config.retransmission_timeout_len * sol_retransmission_timeout_multiplier;
+          sol_retransmission_timeout_len = _retransmission_timeout_len (c) * sol_retransmission_timeout_multiplier;
 
           timeval_add_ms (&c->session.last_sol_input_packet_sent, sol_retransmission_timeout_len, &sol_retransmission_timeout);
           timeval_sub (&sol_retransmission_timeout, &current, &sol_retransmission_timeout_val);
@@ -2893,6 +3131,28 @@ _calculate_timeout (ipmiconsole_ctx_t c, unsigned int *timeout)
           if (sol_retransmission_timeout_ms < *timeout)
             *timeout = sol_retransmission_timeout_ms;
         }
+      else if (c->session.sol_input_coalescing)
+        {
+          struct timeval coalesce_timeout;
+          struct timeval coalesce_timeout_len;
+          struct timeval coalesce_timeout_val;
+          unsigned int coalesce_timeout_us;
+          unsigned int coalesce_timeout_ms = 0;
+
+          /* Time when held character data must be sent */
+          coalesce_timeout_us = _sol_input_coalesce_timeout_len (c);
+          coalesce_timeout_len.tv_sec = coalesce_timeout_us / 1000000;
+          coalesce_timeout_len.tv_usec = coalesce_timeout_us % 1000000;
+          timeval_add (&c->session.sol_input_coalesce_start, &coalesce_timeout_len, &coalesce_timeout);
+          if (timeval_gt (&coalesce_timeout, &current))
+            {
+              timeval_sub (&coalesce_timeout, &current, &coalesce_timeout_val);
+              /* round up, don't wake up before the data can be sent */
+              coalesce_timeout_ms = coalesce_timeout_val.tv_sec * 1000 + (coalesce_timeout_val.tv_usec + 999) / 1000;
+            }
+          if (coalesce_timeout_ms < *timeout)
+            *timeout = coalesce_timeout_ms;
+        }
 
       if ((rv = _keepalive_is_necessary (c)) < 0)
         return (-1);
@@ -2944,7 +3204,7 @@ _calculate_timeout (ipmiconsole_ctx_t c, unsigned int *timeout)
       else
         retransmission_timeout_multiplier = 1;
 
-      retransmission_timeout_len = c->config.retransmission_timeout_len * retransmission_timeout_multiplier;
+      retransmission_timeout_len = _retransmission_timeout_len (c) * retransmission_timeout_multiplier;
 
       timeval_add_ms (&c->session.last_ipmi_packet_sent, retransmission_timeout_len, &retransmission_timeout);
       timeval_sub (&retransmission_timeout, &current, &retransmission_timeout_val);
@@ -2975,6 +3235,15 @@ _send_sol_character_data_or_break (ipmiconsole_ctx_t c)
       && (!c->session.break_requested
           || (c->session.break_requested && c->session.console_remote_console_to_bmc_bytes_before_break)))
     {
+      int ret;
+
+      if ((ret = _sol_input_coalesce (c)) < 0)
+        return (-1);
+
+      /* sent later, see _calculate_timeout() */
+      if (ret)
+        return (0);
+
       if (_send_sol_packet_with_character_data (c, 0, 0, 0) < 0)
         {
           /* Attempt to close the session cleanly */
@@ -3571,6 +3840,7 @@ _process_protocol_state_activate_payload_sent (ipmiconsole_ctx_t c)
       if (dropped)
         {
           IPMICONSOLE_CTX_DEBUG (c, ("scbuf_write: dropped data: dropped=%d", dropped));
+          ipmiconsole_ctx_counters_add (c, IPMICONSOLE_COUNTER_SCBUF_BYTES_DROPPED, dropped);
           ipmiconsole_ctx_set_errnum (c, IPMICONSOLE_ERR_INTERNAL_ERROR);
 
           /* Attempt to close the session cleanly */
@@ -3580,6 +3850,8 @@ _process_protocol_state_activate_payload_sent (ipmiconsole_ctx_t c)
           c->session.protocol_state = IPMICONSOLE_PROTOCOL_STATE_DEACTIVATE_PAYLOAD_SENT;
           return (0);
         }
+
+      _console_output_notify (c);
     }
 
   /* only call callback if blocking was not requested */
@@ -4226,7 +4498,8 @@ ipmiconsole_process_ctxs (List console_engine_ctxs, unsigned int *timeout)
       assert (c);
       assert (c->magic == IPMICONSOLE_CTX_MAGIC);
 
-      if ((_process_ctx (c, &ctx_timeout)) < 0)
+      if ((_process_ctx (c, &ctx_timeout)) < 0
+          || ipmiconsole_engine_ctx_events_update (c) < 0)
         {
           /* On delete, function to cleanup ctx session will be done.
            * Error will be seen by the user via a EOF on a read() or
@@ -41,6 +41,9 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif /* HAVE_UNISTD_H */
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif /* HAVE_SYS_UIO_H */
 #include "scbuf.h"
 
 #include "secure.h"
@@ -134,6 +137,9 @@ static int scbuf_put_mem (void *srscbuf, unsigned char **pdstbuf, int len);
 static int scbuf_copier (scbuf_t src, scbuf_t dst, int len, int *ndropped, int secure_malloc_flag);
 static int scbuf_dropper (scbuf_t cb, int len);
 static int scbuf_reader (scbuf_t src, int len, scbuf_iof putf, void *dst);
+#if HAVE_SYS_UIO_H
+static int scbuf_reader_fd (scbuf_t src, int len, int dstfd);
+#endif /* HAVE_SYS_UIO_H */
 static int scbuf_replayer (scbuf_t src, int len, scbuf_iof putf, void *dst);
 static int scbuf_writer (scbuf_t dst, int len, scbuf_iof getf, void *src,
        int *ndropped, int secure_malloc_flag);
@@ -964,7 +970,11 @@ scbuf_read_to_fd (scbuf_t src, int dstfd, int len)
         len = src->used;
     }
     if (len > 0) {
+#if HAVE_SYS_UIO_H
+        n = scbuf_reader_fd (src, len, dstfd);
+#else /* !HAVE_SYS_UIO_H */
         n = scbuf_reader (src, len, (scbuf_iof) scbuf_put_fd, &dstfd);
+#endif /* !HAVE_SYS_UIO_H */
         if (n > 0) {
             scbuf_dropper (src, n);
         }
@@ -1533,6 +1543,52 @@ scbuf_reader (scbuf_t src, int len, scbuf_iof putf, void *dst)
 }
 
 
+#if HAVE_SYS_UIO_H
+static int
+scbuf_reader_fd (scbuf_t src, int len, int dstfd)
+{
+/*  Reads up to [len] bytes from [src] into the file referenced by [dstfd].
+ *    Unlike scbuf_reader() w/ scbuf_put_fd(), a wrapped buffer is written
+ *    with a single writev() instead of one write() per segment.
+ *  Returns the number of bytes written, or -1 on error (with errno set).
+ */
+    struct iovec iov[2];
+    int iovcnt;
+    int i_src;
+    int n;
+
+    assert (src != NULL);
+    assert (len > 0);
+    assert (dstfd >= 0);
+    assert (scbuf_mutex_is_locked (src));
+
+    /*  Bound len by the number of bytes available.
+     */
+    len = MIN (len, src->used);
+    if (len == 0) {
+        return (0);
+    }
+    /*  The unread data is at most two segments: from i_out to the end
+     *    of the buffer, and the wrapped remainder from the start.
+     */
+    i_src = src->i_out;
+    n = MIN (len, (src->size + 1) - i_src);
+    iov[0].iov_base = &src->data[i_src];
+    iov[0].iov_len = n;
+    iovcnt = 1;
+    if (n < len) {
+        iov[1].iov_base = &src->data[0];
+        iov[1].iov_len = len - n;
+        iovcnt = 2;
+    }
+    do {
+        n = writev (dstfd, iov, iovcnt);
+    } while ((n < 0) && (errno == EINTR));
+    return (n);
+}
+#endif /* HAVE_SYS_UIO_H */
+
+
 static int
 scbuf_replayer (scbuf_t src, int len, scbuf_iof putf, void *dst)
 {
@@ -52,12 +52,15 @@
 #include <errno.h>
 
 #include "ipmi_monitoring.h"
+#include "ipmi_monitoring_arena.h"
 #include "ipmi_monitoring_defs.h"
 #include "ipmi_monitoring_debug.h"
+#include "ipmi_monitoring_hostrange.h"
 #include "ipmi_monitoring_ipmi_communication.h"
 #include "ipmi_monitoring_sdr_cache.h"
 #include "ipmi_monitoring_sel.h"
 #include "ipmi_monitoring_sensor_reading.h"
+#include "ipmi_monitoring_session_cache.h"
 
 #include "freeipmi-portability.h"
 #include "secure.h"
@@ -161,31 +164,6 @@ _destroy_sel_record (void *x)
   free (record);
 }
 
-static void
-_destroy_sensor_reading (void *x)
-{
-  struct ipmi_monitoring_sensor_reading *reading;
-
-  assert (x);
-
-  reading = (struct ipmi_monitoring_sensor_reading *)x;
-
-  if (reading->sensor_bitmask_strings)
-    {
-      unsigned int i = 0;
-
-      while (reading->sensor_bitmask_strings[i])
-        {
-          free (reading->sensor_bitmask_strings[i]);
-          i++;
-        }
-
-      free (reading->sensor_bitmask_strings);
-    }
-
-  free (reading);
-}
-
 static void
 _destroy_ctx (ipmi_monitoring_ctx_t c)
 {
@@ -194,6 +172,12 @@ _destroy_ctx (ipmi_monitoring_ctx_t c)
 
   ipmi_interpret_ctx_destroy (c->interpret_ctx);
 
+  ipmi_monitoring_hostrange_ctxs_destroy (c);
+
+  ipmi_monitoring_session_cache_destroy (c);
+  if (c->session_cache_lock_initialized)
+    pthread_mutex_destroy (&c->session_cache_lock);
+
   /* Note: destroy iterator first */
   if (c->sel_records_itr)
     {
@@ -207,21 +191,13 @@ _destroy_ctx (ipmi_monitoring_ctx_t c)
       c->sel_records = NULL;
     }
 
-  /* Note: destroy iterator first */
-  if (c->sensor_readings_itr)
-    {
-      list_iterator_destroy (c->sensor_readings_itr);
-      c->sensor_readings_itr = NULL;
-    }
-
-  if (c->sensor_readings)
-    {
-      list_destroy (c->sensor_readings);
-      c->sensor_readings = NULL;
-    }
-
+  c->sensor_readings = NULL;
+  c->sensor_readings_last = NULL;
+  c->sensor_readings_itr = 0;
   c->current_sensor_reading = NULL;
 
+  ipmi_monitoring_arena_destroy (c);
+
   c->magic = ~IPMI_MONITORING_MAGIC;
   if (_ipmi_monitoring_flags & IPMI_MONITORING_FLAGS_LOCK_MEMORY)
     secure_free (c, sizeof (struct ipmi_monitoring_ctx));
@@ -254,8 +230,9 @@ ipmi_monitoring_ctx_create (void)
   if (!(c->sel_records = list_create ((ListDelF)_destroy_sel_record)))
     goto cleanup;
 
-  if (!(c->sensor_readings = list_create ((ListDelF)_destroy_sensor_reading)))
+  if (pthread_mutex_init (&c->session_cache_lock, NULL))
     goto cleanup;
+  c->session_cache_lock_initialized = 1;
 
   return (c);
 
@@ -328,6 +305,12 @@ ipmi_monitoring_ctx_sel_config_file (ipmi_monitoring_ctx_t c,
   if (!c || c->magic != IPMI_MONITORING_MAGIC)
     return (-1);
 
+  if (sel_config_file && strlen (sel_config_file) > MAXPATHLEN)
+    {
+      c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
+      return (-1);
+    }
+
   if (ipmi_interpret_load_sel_config (c->interpret_ctx,
                                       sel_config_file) < 0)
     {
@@ -335,6 +318,14 @@ ipmi_monitoring_ctx_sel_config_file (ipmi_monitoring_ctx_t c,
       return (-1);
     }
 
+  /* for the contexts of hostrange functions */
+  memset (c->sel_config_file, '\0', MAXPATHLEN + 1);
+  if (sel_config_file)
+    strncpy (c->sel_config_file, sel_config_file, MAXPATHLEN);
+  c->sel_config_file_set = 1;
+
+  ipmi_monitoring_hostrange_ctxs_destroy (c);
+
   c->errnum = IPMI_MONITORING_ERR_SUCCESS;
   return (0);
 }
@@ -346,6 +337,12 @@ ipmi_monitoring_ctx_sensor_config_file (ipmi_monitoring_ctx_t c,
   if (!c || c->magic != IPMI_MONITORING_MAGIC)
     return (-1);
 
+  if (sensor_config_file && strlen (sensor_config_file) > MAXPATHLEN)
+    {
+      c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
+      return (-1);
+    }
+
   if (ipmi_interpret_load_sensor_config (c->interpret_ctx,
                                          sensor_config_file) < 0)
     {
@@ -353,6 +350,14 @@ ipmi_monitoring_ctx_sensor_config_file (ipmi_monitoring_ctx_t c,
       return (-1);
     }
 
+  /* for the contexts of hostrange functions */
+  memset (c->sensor_config_file, '\0', MAXPATHLEN + 1);
+  if (sensor_config_file)
+    strncpy (c->sensor_config_file, sensor_config_file, MAXPATHLEN);
+  c->sensor_config_file_set = 1;
+
+  ipmi_monitoring_hostrange_ctxs_destroy (c);
+
   c->errnum = IPMI_MONITORING_ERR_SUCCESS;
   return (0);
 }
@@ -389,6 +394,10 @@ ipmi_monitoring_ctx_sdr_cache_directory (ipmi_monitoring_ctx_t c, const char *di
   strncpy (c->sdr_cache_directory, dir, MAXPATHLEN);
   c->sdr_cache_directory_set = 1;
 
+  /* SDRs kept open with cached sessions may be from elsewhere */
+  ipmi_monitoring_session_cache_flush (c);
+  ipmi_monitoring_hostrange_ctxs_destroy (c);
+
   c->errnum = IPMI_MONITORING_ERR_SUCCESS;
   return (0);
 }
@@ -426,6 +435,40 @@ ipmi_monitoring_ctx_sdr_cache_filenames (ipmi_monitoring_ctx_t c, const char *fo
   strncpy (c->sdr_cache_filename_format, format, MAXPATHLEN);
   c->sdr_cache_filename_format_set = 1;
 
+  /* SDRs kept open with cached sessions may be from elsewhere */
+  ipmi_monitoring_session_cache_flush (c);
+  ipmi_monitoring_hostrange_ctxs_destroy (c);
+
+  c->errnum = IPMI_MONITORING_ERR_SUCCESS;
+  return (0);
+}
+
+int
+ipmi_monitoring_ctx_session_cache (ipmi_monitoring_ctx_t c,
+                                   unsigned int max_sessions,
+                                   unsigned int idle_timeout)
+{
+  if (!c || c->magic != IPMI_MONITORING_MAGIC)
+    return (-1);
+
+  if (!_ipmi_monitoring_initialized)
+    {
+      c->errnum = IPMI_MONITORING_ERR_LIBRARY_UNINITIALIZED;
+      return (-1);
+    }
+
+  if (max_sessions > IPMI_MONITORING_SESSION_CACHE_MAX)
+    {
+      c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
+      return (-1);
+    }
+
+  if (!idle_timeout)
+    idle_timeout = IPMI_MONITORING_SESSION_CACHE_IDLE_TIMEOUT_DEFAULT;
+
+  if (ipmi_monitoring_session_cache_setup (c, max_sessions, idle_timeout) < 0)
+    return (-1);
+
   c->errnum = IPMI_MONITORING_ERR_SUCCESS;
   return (0);
 }
@@ -877,7 +920,7 @@ ipmi_monitoring_sel_iterator_destroy (ipmi_monitoring_ctx_t c)
   if (!c || c->magic != IPMI_MONITORING_MAGIC)
     return;
 
-  list_delete_all (c->sensor_readings, _list_delete_all, "dummyvalue");
+  list_delete_all (c->sel_records, _list_delete_all, "dummyvalue");
 
   if (c->sel_records_itr)
     {
@@ -1467,15 +1510,11 @@ _ipmi_monitoring_sensor_readings_by_record_id (ipmi_monitoring_ctx_t c,
         }
     }
 
-  if ((rv = list_count (c->sensor_readings)) > 0)
+  /* with CALLBACK_ONLY, readings are counted but not stored */
+  if ((rv = c->sensor_readings_count) > 0 && c->sensor_readings)
     {
-      if (!(c->sensor_readings_itr = list_iterator_create (c->sensor_readings)))
-        {
-          IPMI_MONITORING_DEBUG (("list_iterator_create: %s", strerror (errno)));
-          c->errnum = IPMI_MONITORING_ERR_INTERNAL_ERROR;
-          goto cleanup;
-        }
-      c->current_sensor_reading = list_next (c->sensor_readings_itr);
+      c->sensor_readings_itr = 1;
+      c->current_sensor_reading = c->sensor_readings;
     }
 
   ipmi_monitoring_sdr_cache_unload (c);
@@ -1514,7 +1553,9 @@ ipmi_monitoring_sensor_readings_by_record_id (ipmi_monitoring_ctx_t c,
     }
 
   if ((sensor_reading_flags & ~IPMI_MONITORING_SENSOR_READING_FLAGS_MASK)
-      || (record_ids && !record_ids_len))
+      || (record_ids && !record_ids_len)
+      || ((sensor_reading_flags & IPMI_MONITORING_SENSOR_READING_FLAGS_CALLBACK_ONLY)
+          && !callback))
     {
       c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
       return (-1);
@@ -1602,15 +1643,11 @@ _ipmi_monitoring_sensor_readings_by_sensor_type (ipmi_monitoring_ctx_t c,
       goto cleanup;
     }
 
-  if ((rv = list_count (c->sensor_readings)) > 0)
+  /* with CALLBACK_ONLY, readings are counted but not stored */
+  if ((rv = c->sensor_readings_count) > 0 && c->sensor_readings)
     {
-      if (!(c->sensor_readings_itr = list_iterator_create (c->sensor_readings)))
-        {
-          IPMI_MONITORING_DEBUG (("list_iterator_create: %s", strerror (errno)));
-          c->errnum = IPMI_MONITORING_ERR_INTERNAL_ERROR;
-          goto cleanup;
-        }
-      c->current_sensor_reading = list_next (c->sensor_readings_itr);
+      c->sensor_readings_itr = 1;
+      c->current_sensor_reading = c->sensor_readings;
     }
 
   ipmi_monitoring_sdr_cache_unload (c);
@@ -1649,7 +1686,9 @@ ipmi_monitoring_sensor_readings_by_sensor_type (ipmi_monitoring_ctx_t c,
     }
 
   if ((sensor_reading_flags & ~IPMI_MONITORING_SENSOR_READING_FLAGS_MASK)
-      || (sensor_types && !sensor_types_len))
+      || (sensor_types && !sensor_types_len)
+      || ((sensor_reading_flags & IPMI_MONITORING_SENSOR_READING_FLAGS_CALLBACK_ONLY)
+          && !callback))
     {
       c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
       return (-1);
@@ -1683,8 +1722,7 @@ ipmi_monitoring_sensor_iterator_first (ipmi_monitoring_ctx_t c)
       return (-1);
     }
 
-  list_iterator_reset (c->sensor_readings_itr);
-  c->current_sensor_reading = list_next (c->sensor_readings_itr);
+  c->current_sensor_reading = c->sensor_readings;
   c->errnum = IPMI_MONITORING_ERR_SUCCESS;
   return (0);
 }
@@ -1701,7 +1739,8 @@ ipmi_monitoring_sensor_iterator_next (ipmi_monitoring_ctx_t c)
       return (-1);
     }
 
-  c->current_sensor_reading = list_next (c->sensor_readings_itr);
+  if (c->current_sensor_reading)
+    c->current_sensor_reading = c->current_sensor_reading->next;
   c->errnum = IPMI_MONITORING_ERR_SUCCESS;
   return ((c->current_sensor_reading) ? 1 : 0);
 }
@@ -1712,15 +1751,14 @@ ipmi_monitoring_sensor_iterator_destroy (ipmi_monitoring_ctx_t c)
   if (!c || c->magic != IPMI_MONITORING_MAGIC)
     return;
 
-  list_delete_all (c->sensor_readings, _list_delete_all, "dummyvalue");
-
-  if (c->sensor_readings_itr)
-    {
-      list_iterator_destroy (c->sensor_readings_itr);
-      c->sensor_readings_itr = NULL;
-    }
-
+  c->sensor_readings = NULL;
+  c->sensor_readings_last = NULL;
+  c->sensor_readings_count = 0;
+  c->sensor_readings_itr = 0;
   c->current_sensor_reading = NULL;
+
+  /* all readings were allocated from the arena */
+  ipmi_monitoring_arena_reset (c);
 }
 
 static int
@@ -1906,3 +1944,313 @@ ipmi_monitoring_sensor_read_event_reading_type_code (ipmi_monitoring_ctx_t c)
   c->errnum = IPMI_MONITORING_ERR_SUCCESS;
   return (sensor_reading->event_reading_type_code);
 }
+
+static int
+_ipmi_monitoring_hostrange_common (ipmi_monitoring_ctx_t c,
+                                   const char *hostnames,
+                                   unsigned int *fanout,
+                                   Ipmi_Monitoring_Hostrange_Callback callback)
+{
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (fanout);
+
+  if (!_ipmi_monitoring_initialized)
+    {
+      c->errnum = IPMI_MONITORING_ERR_LIBRARY_UNINITIALIZED;
+      return (-1);
+    }
+
+  if (!hostnames
+      || (*fanout) > IPMI_MONITORING_HOSTRANGE_FANOUT_MAX
+      || !callback)
+    {
+      c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
+      return (-1);
+    }
+
+  if (!(*fanout))
+    (*fanout) = IPMI_MONITORING_HOSTRANGE_FANOUT_DEFAULT;
+
+  return (0);
+}
+
+static int
+_ipmi_monitoring_hostrange_sel_common (ipmi_monitoring_ctx_t c,
+                                       unsigned int sel_flags,
+                                       unsigned int *record_ids,
+                                       unsigned int record_ids_len,
+                                       unsigned int *sensor_types,
+                                       unsigned int sensor_types_len)
+{
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+
+  if ((sel_flags & ~IPMI_MONITORING_SEL_FLAGS_MASK)
+      || (record_ids && !record_ids_len)
+      || (sensor_types && !sensor_types_len))
+    {
+      c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
+      return (-1);
+    }
+
+  if (record_ids && record_ids_len)
+    {
+      unsigned int i;
+
+      for (i = 0; i < record_ids_len; i++)
+        {
+          if (record_ids[i] > IPMI_SEL_GET_RECORD_ID_LAST_ENTRY)
+            {
+              c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
+              return (-1);
+            }
+        }
+    }
+
+  return (0);
+}
+
+int
+ipmi_monitoring_sel_by_record_id_hostrange (ipmi_monitoring_ctx_t c,
+                                            const char *hostnames,
+                                            unsigned int fanout,
+                                            struct ipmi_monitoring_ipmi_config *config,
+                                            unsigned int sel_flags,
+                                            unsigned int *record_ids,
+                                            unsigned int record_ids_len,
+                                            Ipmi_Monitoring_Hostrange_Callback callback,
+                                            void *callback_data)
+{
+  struct ipmi_monitoring_hostrange_args args;
+
+  if (!c || c->magic != IPMI_MONITORING_MAGIC)
+    return (-1);
+
+  if (_ipmi_monitoring_hostrange_common (c, hostnames, &fanout, callback) < 0)
+    return (-1);
+
+  if (_ipmi_monitoring_hostrange_sel_common (c,
+                                             sel_flags,
+                                             record_ids,
+                                             record_ids_len,
+                                             NULL,
+                                             0) < 0)
+    return (-1);
+
+  memset (&args, '\0', sizeof (struct ipmi_monitoring_hostrange_args));
+  args.type = IPMI_MONITORING_HOSTRANGE_SEL_BY_RECORD_ID;
+  args.config = config;
+  args.flags = sel_flags;
+  args.record_ids = record_ids;
+  args.record_ids_len = record_ids_len;
+
+  return (ipmi_monitoring_hostrange (c,
+                                     hostnames,
+                                     fanout,
+                                     &args,
+                                     callback,
+                                     callback_data));
+}
+
+int
+ipmi_monitoring_sel_by_sensor_type_hostrange (ipmi_monitoring_ctx_t c,
+                                              const char *hostnames,
+                                              unsigned int fanout,
+                                              struct ipmi_monitoring_ipmi_config *config,
+                                              unsigned int sel_flags,
+                                              unsigned int *sensor_types,
+                                              unsigned int sensor_types_len,
+                                              Ipmi_Monitoring_Hostrange_Callback callback,
+                                              void *callback_data)
+{
+  struct ipmi_monitoring_hostrange_args args;
+
+  if (!c || c->magic != IPMI_MONITORING_MAGIC)
+    return (-1);
+
+  if (_ipmi_monitoring_hostrange_common (c, hostnames, &fanout, callback) < 0)
+    return (-1);
+
+  if (_ipmi_monitoring_hostrange_sel_common (c,
+                                             sel_flags,
+                                             NULL,
+                                             0,
+                                             sensor_types,
+                                             sensor_types_len) < 0)
+    return (-1);
+
+  memset (&args, '\0', sizeof (struct ipmi_monitoring_hostrange_args));
+  args.type = IPMI_MONITORING_HOSTRANGE_SEL_BY_SENSOR_TYPE;
+  args.config = config;
+  args.flags = sel_flags;
+  args.sensor_types = sensor_types;
+  args.sensor_types_len = sensor_types_len;
+
+  return (ipmi_monitoring_hostrange (c,
+                                     hostnames,
+                                     fanout,
+                                     &args,
+                                     callback,
+                                     callback_data));
+}
+
+int
+ipmi_monitoring_sel_by_date_range_hostrange (ipmi_monitoring_ctx_t c,
+                                             const char *hostnames,
+                                             unsigned int fanout,
+                                             struct ipmi_monitoring_ipmi_config *config,
+                                             unsigned int sel_flags,
+                                             const char *date_begin,
+                                             const char *date_end,
+                                             Ipmi_Monitoring_Hostrange_Callback callback,
+                                             void *callback_data)
+{
+  struct ipmi_monitoring_hostrange_args args;
+  unsigned int date_val;
+
+  if (!c || c->magic != IPMI_MONITORING_MAGIC)
+    return (-1);
+
+  if (_ipmi_monitoring_hostrange_common (c, hostnames, &fanout, callback) < 0)
+    return (-1);
+
+  if (_ipmi_monitoring_hostrange_sel_common (c,
+                                             sel_flags,
+                                             NULL,
+                                             0,
+                                             NULL,
+                                             0) < 0)
+    return (-1);
+
+  /* Check dates once here rather than fail on every host */
+  if (date_begin)
+    {
+      if (_ipmi_monitoring_date_parse (c, date_begin, &date_val) < 0)
+        return (-1);
+    }
+
+  if (date_end)
+    {
+      if (_ipmi_monitoring_date_parse (c, date_end, &date_val) < 0)
+        return (-1);
+    }
+
+  memset (&args, '\0', sizeof (struct ipmi_monitoring_hostrange_args));
+  args.type = IPMI_MONITORING_HOSTRANGE_SEL_BY_DATE_RANGE;
+  args.config = config;
+  args.flags = sel_flags;
+  args.date_begin = date_begin;
+  args.date_end = date_end;
+
+  return (ipmi_monitoring_hostrange (c,
+                                     hostnames,
+                                     fanout,
+                                     &args,
+                                     callback,
+                                     callback_data));
+}
+
+int
+ipmi_monitoring_sensor_readings_by_record_id_hostrange (ipmi_monitoring_ctx_t c,
+                                                        const char *hostnames,
+                                                        unsigned int fanout,
+                                                        struct ipmi_monitoring_ipmi_config *config,
+                                                        unsigned int sensor_reading_flags,
+                                                        unsigned int *record_ids,
+                                                        unsigned int record_ids_len,
+                                                        Ipmi_Monitoring_Hostrange_Callback callback,
+                                                        void *callback_data)
+{
+  struct ipmi_monitoring_hostrange_args args;
+
+  if (!c || c->magic != IPMI_MONITORING_MAGIC)
+    return (-1);
+
+  if (_ipmi_monitoring_hostrange_common (c, hostnames, &fanout, callback) < 0)
+    return (-1);
+
+  /* readings are handed back per host through the iterators, so
+   * CALLBACK_ONLY is not supported
+   */
+  if ((sensor_reading_flags & ~IPMI_MONITORING_SENSOR_READING_FLAGS_MASK)
+      || (sensor_reading_flags & IPMI_MONITORING_SENSOR_READING_FLAGS_CALLBACK_ONLY)
+      || (record_ids && !record_ids_len))
+    {
+      c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
+      return (-1);
+    }
+
+  if (record_ids && record_ids_len)
+    {
+      unsigned int i;
+
+      for (i = 0; i < record_ids_len; i++)
+        {
+          if (record_ids[i] > IPMI_SDR_RECORD_ID_LAST)
+            {
+              c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
+              return (-1);
+            }
+        }
+    }
+
+  memset (&args, '\0', sizeof (struct ipmi_monitoring_hostrange_args));
+  args.type = IPMI_MONITORING_HOSTRANGE_SENSOR_READINGS_BY_RECORD_ID;
+  args.config = config;
+  args.flags = sensor_reading_flags;
+  args.record_ids = record_ids;
+  args.record_ids_len = record_ids_len;
+
+  return (ipmi_monitoring_hostrange (c,
+                                     hostnames,
+                                     fanout,
+                                     &args,
+                                     callback,
+                                     callback_data));
+}
+
+int
+ipmi_monitoring_sensor_readings_by_sensor_type_hostrange (ipmi_monitoring_ctx_t c,
+                                                          const char *hostnames,
+                                                          unsigned int fanout,
+                                                          struct ipmi_monitoring_ipmi_config *config,
+                                                          unsigned int sensor_reading_flags,
+                                                          unsigned int *sensor_types,
+                                                          unsigned int sensor_types_len,
+                                                          Ipmi_Monitoring_Hostrange_Callback callback,
+                                                          void *callback_data)
+{
+  struct ipmi_monitoring_hostrange_args args;
+
+  if (!c || c->magic != IPMI_MONITORING_MAGIC)
+    return (-1);
+
+  if (_ipmi_monitoring_hostrange_common (c, hostnames, &fanout, callback) < 0)
+    return (-1);
+
+  /* readings are handed back per host through the iterators, so
+   * CALLBACK_ONLY is not supported
+   */
+  if ((sensor_reading_flags & ~IPMI_MONITORING_SENSOR_READING_FLAGS_MASK)
+      || (sensor_reading_flags & IPMI_MONITORING_SENSOR_READING_FLAGS_CALLBACK_ONLY)
+      || (sensor_types && !sensor_types_len))
+    {
+      c->errnum = IPMI_MONITORING_ERR_PARAMETERS;
+      return (-1);
+    }
+
+  memset (&args, '\0', sizeof (struct ipmi_monitoring_hostrange_args));
+  args.type = IPMI_MONITORING_HOSTRANGE_SENSOR_READINGS_BY_SENSOR_TYPE;
+  args.config = config;
+  args.flags = sensor_reading_flags;
+  args.sensor_types = sensor_types;
+  args.sensor_types_len = sensor_types_len;
+
+  return (ipmi_monitoring_hostrange (c,
+                                     hostnames,
+                                     fanout,
+                                     &args,
+                                     callback,
+                                     callback_data));
+}
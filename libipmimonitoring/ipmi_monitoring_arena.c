@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <assert.h>
+#include <errno.h>
+
+#include "ipmi_monitoring.h"
+#include "ipmi_monitoring_arena.h"
+#include "ipmi_monitoring_debug.h"
+#include "ipmi_monitoring_defs.h"
+
+#include "freeipmi-portability.h"
+
+#define IPMI_MONITORING_ARENA_BLOCK_LEN 16384
+
+/* sufficient for any type stored, such as the double in a sensor reading */
+#define IPMI_MONITORING_ARENA_ALIGN     16
+
+#define IPMI_MONITORING_ARENA_ROUNDUP(__len) \
+  (((__len) + IPMI_MONITORING_ARENA_ALIGN - 1) & ~((size_t)IPMI_MONITORING_ARENA_ALIGN - 1))
+
+#define IPMI_MONITORING_ARENA_HEADER_LEN \
+  IPMI_MONITORING_ARENA_ROUNDUP (sizeof (struct ipmi_monitoring_arena_block))
+
+static struct ipmi_monitoring_arena_block *
+_arena_block_create (ipmi_monitoring_ctx_t c, size_t len)
+{
+  struct ipmi_monitoring_arena_block *b;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+
+  if (len < IPMI_MONITORING_ARENA_BLOCK_LEN)
+    len = IPMI_MONITORING_ARENA_BLOCK_LEN;
+
+  if (!(b = (struct ipmi_monitoring_arena_block *)malloc (IPMI_MONITORING_ARENA_HEADER_LEN + len)))
+    {
+      IPMI_MONITORING_DEBUG (("malloc: %s", strerror (errno)));
+      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
+      return (NULL);
+    }
+  b->next = NULL;
+  b->len = len;
+  b->used = 0;
+  return (b);
+}
+
+void *
+ipmi_monitoring_arena_alloc (ipmi_monitoring_ctx_t c, size_t len)
+{
+  struct ipmi_monitoring_arena_block *b;
+  void *ptr;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (len);
+
+  len = IPMI_MONITORING_ARENA_ROUNDUP (len);
+
+  /* Blocks after the current one are left over from an earlier call.
+   * Skip any too small, the space is reclaimed on the next reset.
+   */
+  b = c->arena_current;
+  while (b && (b->len - b->used) < len)
+    b = b->next;
+
+  if (!b)
+    {
+      if (!(b = _arena_block_create (c, len)))
+        return (NULL);
+
+      if (c->arena_last)
+        c->arena_last->next = b;
+      else
+        c->arena = b;
+      c->arena_last = b;
+    }
+
+  c->arena_current = b;
+  ptr = (char *)b + IPMI_MONITORING_ARENA_HEADER_LEN + b->used;
+  b->used += len;
+  memset (ptr, '\0', len);
+  return (ptr);
+}
+
+char *
+ipmi_monitoring_arena_strdup (ipmi_monitoring_ctx_t c, const char *str)
+{
+  char *rv;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (str);
+
+  if (!(rv = ipmi_monitoring_arena_alloc (c, strlen (str) + 1)))
+    return (NULL);
+
+  strcpy (rv, str);
+  return (rv);
+}
+
+void
+ipmi_monitoring_arena_reset (ipmi_monitoring_ctx_t c)
+{
+  struct ipmi_monitoring_arena_block *b;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+
+  for (b = c->arena; b; b = b->next)
+    b->used = 0;
+  c->arena_current = c->arena;
+}
+
+void
+ipmi_monitoring_arena_destroy (ipmi_monitoring_ctx_t c)
+{
+  struct ipmi_monitoring_arena_block *b;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+
+  b = c->arena;
+  while (b)
+    {
+      struct ipmi_monitoring_arena_block *next = b->next;
+      free (b);
+      b = next;
+    }
+  c->arena = NULL;
+  c->arena_current = NULL;
+  c->arena_last = NULL;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMI_MONITORING_ARENA_H
+#define IPMI_MONITORING_ARENA_H
+
+#include <sys/types.h>
+
+#include "ipmi_monitoring.h"
+
+/* Per context arena, results of a call are allocated from it and
+ * freed all at once with ipmi_monitoring_arena_reset().  Memory is
+ * returned zeroed.
+ */
+
+void *ipmi_monitoring_arena_alloc (ipmi_monitoring_ctx_t c, size_t len);
+
+char *ipmi_monitoring_arena_strdup (ipmi_monitoring_ctx_t c, const char *str);
+
+/* Blocks are kept for reuse by the next call */
+void ipmi_monitoring_arena_reset (ipmi_monitoring_ctx_t c);
+
+void ipmi_monitoring_arena_destroy (ipmi_monitoring_ctx_t c);
+
+#endif /* IPMI_MONITORING_ARENA_H */
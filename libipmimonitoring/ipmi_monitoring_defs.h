@@ -33,6 +33,7 @@
 
 #include <stdint.h>
 #include <sys/param.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <limits.h>             /* MAXHOSTNAMELEN */
@@ -124,7 +125,8 @@
    | IPMI_MONITORING_SENSOR_READING_FLAGS_IGNORE_SCANNING_DISABLED         \
    | IPMI_MONITORING_SENSOR_READING_FLAGS_ASSUME_BMC_OWNER                 \
    | IPMI_MONITORING_SENSOR_READING_FLAGS_ENTITY_SENSOR_NAMES              \
-   | IPMI_MONITORING_SENSOR_READING_FLAGS_ASSUME_MAX_SDR_RECORD_COUNT)
+   | IPMI_MONITORING_SENSOR_READING_FLAGS_ASSUME_MAX_SDR_RECORD_COUNT      \
+   | IPMI_MONITORING_SENSOR_READING_FLAGS_CALLBACK_ONLY)
 
 #define IPMI_MONITORING_AUTHENTICATION_TYPE_DEFAULT           IPMI_AUTHENTICATION_TYPE_MD5
 #define IPMI_MONITORING_PRIVILEGE_LEVEL_DEFAULT               IPMI_PRIVILEGE_LEVEL_USER
@@ -139,6 +141,14 @@
 
 #define IPMI_MONITORING_PACKET_BUFLEN 1024
 
+#define IPMI_MONITORING_HOSTRANGE_FANOUT_DEFAULT 64
+
+#define IPMI_MONITORING_HOSTRANGE_FANOUT_MAX     1024
+
+#define IPMI_MONITORING_SESSION_CACHE_MAX                  1024
+
+#define IPMI_MONITORING_SESSION_CACHE_IDLE_TIMEOUT_DEFAULT 30
+
 struct ipmi_monitoring_sel_record {
   /* for all records */
   int record_id;
@@ -170,7 +180,9 @@ struct ipmi_monitoring_sel_record {
   unsigned int oem_data_len;
 };
 
+/* allocated from the context arena */
 struct ipmi_monitoring_sensor_reading {
+  struct ipmi_monitoring_sensor_reading *next;
   int record_id;
   int sensor_number;
   int sensor_type;
@@ -189,6 +201,13 @@ struct ipmi_monitoring_sensor_reading {
   int event_reading_type_code;
 };
 
+struct ipmi_monitoring_arena_block {
+  struct ipmi_monitoring_arena_block *next;
+  size_t len;
+  size_t used;
+  /* data follows */
+};
+
 struct ipmi_monitoring_ctx {
   uint32_t magic;
   int errnum;
@@ -199,6 +218,29 @@ struct ipmi_monitoring_ctx {
   int sdr_cache_directory_set;
   char sdr_cache_filename_format[MAXPATHLEN+1];
   int sdr_cache_filename_format_set;
+  /* empty if the default config file was loaded */
+  char sel_config_file[MAXPATHLEN+1];
+  int sel_config_file_set;
+  char sensor_config_file[MAXPATHLEN+1];
+  int sensor_config_file_set;
+
+  /* cached out-of-band sessions, NULL if disabled */
+  List session_cache;
+  unsigned int session_cache_max;
+  unsigned int session_cache_idle_timeout;
+  /* entry c->ipmi_ctx is borrowed from while in use */
+  void *session_cache_entry;
+  /* hostrange worker contexts use the session cache of the context
+   * they were created for, session_cache is only accessed under the
+   * lock of the context owning it.
+   */
+  ipmi_monitoring_ctx_t session_cache_parent;
+  pthread_mutex_t session_cache_lock;
+  int session_cache_lock_initialized;
+
+  /* hostrange worker contexts, kept between calls */
+  ipmi_monitoring_ctx_t *hostrange_ctxs;
+  unsigned int hostrange_ctxs_count;
 
   /* for use by both sel and sensor codepath */
   uint32_t manufacturer_id;
@@ -219,10 +261,17 @@ struct ipmi_monitoring_ctx {
 
   /* for sensor codepath */
   ipmi_sensor_read_ctx_t sensor_read_ctx;
-  List sensor_readings;
-  ListIterator sensor_readings_itr;
+  struct ipmi_monitoring_sensor_reading *sensor_readings;
+  struct ipmi_monitoring_sensor_reading *sensor_readings_last;
+  unsigned int sensor_readings_count;
+  int sensor_readings_itr;
   struct ipmi_monitoring_sensor_reading *current_sensor_reading;
   struct ipmi_monitoring_sensor_reading *callback_sensor_reading;
+
+  /* results of the current call */
+  struct ipmi_monitoring_arena_block *arena;
+  struct ipmi_monitoring_arena_block *arena_current;
+  struct ipmi_monitoring_arena_block *arena_last;
 };
 
 #endif /* IPMI_MONITORING_DEFS_H */
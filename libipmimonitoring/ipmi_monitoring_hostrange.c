@@ -0,0 +1,522 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#include <pthread.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "ipmi_monitoring.h"
+#include "ipmi_monitoring_debug.h"
+#include "ipmi_monitoring_defs.h"
+#include "ipmi_monitoring_hostrange.h"
+
+#include "freeipmi-portability.h"
+#include "fi_hostlist.h"
+
+/*
+ * Hosts are retrieved from by up to 'fanout' worker threads, each
+ * with its own context.  The libipmimonitoring single host functions
+ * are used on each host, so the only thread state shared is the list
+ * of hosts and the queue of completed workers below, and the session
+ * cache of the calling context, which has its own lock.
+ *
+ * Worker contexts are kept on the calling context between calls, so
+ * their config files are not re-read and their result arenas are
+ * reused.  They are destroyed when the settings they were created
+ * from change.
+ *
+ * A worker that completes a host queues itself and waits until the
+ * calling thread has passed its context to the user's callback before
+ * moving on to the next host.  This way results are never copied and
+ * the callback is always called from the calling thread.
+ */
+
+struct ipmi_monitoring_hostrange_worker
+{
+  struct ipmi_monitoring_hostrange *hr;
+  ipmi_monitoring_ctx_t c;
+  pthread_t thread;
+  int thread_created;
+  char *hostname;
+  int rv;
+  int delivered;
+};
+
+struct ipmi_monitoring_hostrange
+{
+  struct ipmi_monitoring_hostrange_args *args;
+  char **hosts;
+  unsigned int hosts_count;
+  unsigned int hosts_next;
+  struct ipmi_monitoring_hostrange_worker *workers;
+  unsigned int workers_count;
+  unsigned int workers_running;
+  /* completed workers, at most one slot per worker */
+  struct ipmi_monitoring_hostrange_worker **done;
+  unsigned int done_head;
+  unsigned int done_count;
+  int stop;
+  pthread_mutex_t mutex;
+  pthread_cond_t done_cond;
+  pthread_cond_t delivered_cond;
+};
+
+static int
+_hostrange_retrieve (ipmi_monitoring_ctx_t c,
+                     const char *hostname,
+                     struct ipmi_monitoring_hostrange_args *args)
+{
+  assert (c);
+  assert (hostname);
+  assert (args);
+
+  switch (args->type)
+    {
+    case IPMI_MONITORING_HOSTRANGE_SEL_BY_RECORD_ID:
+      return (ipmi_monitoring_sel_by_record_id (c,
+                                                hostname,
+                                                args->config,
+                                                args->flags,
+                                                args->record_ids,
+                                                args->record_ids_len,
+                                                NULL,
+                                                NULL));
+    case IPMI_MONITORING_HOSTRANGE_SEL_BY_SENSOR_TYPE:
+      return (ipmi_monitoring_sel_by_sensor_type (c,
+                                                  hostname,
+                                                  args->config,
+                                                  args->flags,
+                                                  args->sensor_types,
+                                                  args->sensor_types_len,
+                                                  NULL,
+                                                  NULL));
+    case IPMI_MONITORING_HOSTRANGE_SEL_BY_DATE_RANGE:
+      return (ipmi_monitoring_sel_by_date_range (c,
+                                                 hostname,
+                                                 args->config,
+                                                 args->flags,
+                                                 args->date_begin,
+                                                 args->date_end,
+                                                 NULL,
+                                                 NULL));
+    case IPMI_MONITORING_HOSTRANGE_SENSOR_READINGS_BY_RECORD_ID:
+      return (ipmi_monitoring_sensor_readings_by_record_id (c,
+                                                            hostname,
+                                                            args->config,
+                                                            args->flags,
+                                                            args->record_ids,
+                                                            args->record_ids_len,
+                                                            NULL,
+                                                            NULL));
+    case IPMI_MONITORING_HOSTRANGE_SENSOR_READINGS_BY_SENSOR_TYPE:
+      return (ipmi_monitoring_sensor_readings_by_sensor_type (c,
+                                                              hostname,
+                                                              args->config,
+                                                              args->flags,
+                                                              args->sensor_types,
+                                                              args->sensor_types_len,
+                                                              NULL,
+                                                              NULL));
+    default:
+      break;
+    }
+
+  IPMI_MONITORING_DEBUG (("invalid hostrange type: %d", args->type));
+  c->errnum = IPMI_MONITORING_ERR_INTERNAL_ERROR;
+  return (-1);
+}
+
+static void *
+_hostrange_worker (void *arg)
+{
+  struct ipmi_monitoring_hostrange_worker *w;
+  struct ipmi_monitoring_hostrange *hr;
+
+  assert (arg);
+
+  w = (struct ipmi_monitoring_hostrange_worker *)arg;
+  hr = w->hr;
+
+  pthread_mutex_lock (&hr->mutex);
+  while (!hr->stop && hr->hosts_next < hr->hosts_count)
+    {
+      unsigned int index;
+
+      w->hostname = hr->hosts[hr->hosts_next++];
+      pthread_mutex_unlock (&hr->mutex);
+
+      w->rv = _hostrange_retrieve (w->c, w->hostname, hr->args);
+
+      pthread_mutex_lock (&hr->mutex);
+      index = (hr->done_head + hr->done_count) % hr->workers_count;
+      hr->done[index] = w;
+      hr->done_count++;
+      w->delivered = 0;
+      pthread_cond_signal (&hr->done_cond);
+
+      while (!w->delivered)
+        pthread_cond_wait (&hr->delivered_cond, &hr->mutex);
+    }
+  hr->workers_running--;
+  pthread_cond_signal (&hr->done_cond);
+  pthread_mutex_unlock (&hr->mutex);
+
+  return (NULL);
+}
+
+static ipmi_monitoring_ctx_t
+_hostrange_ctx_create (ipmi_monitoring_ctx_t c)
+{
+  ipmi_monitoring_ctx_t wc;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+
+  if (!(wc = ipmi_monitoring_ctx_create ()))
+    {
+      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
+      return (NULL);
+    }
+
+  if (c->sdr_cache_directory_set)
+    {
+      strcpy (wc->sdr_cache_directory, c->sdr_cache_directory);
+      wc->sdr_cache_directory_set = 1;
+    }
+
+  if (c->sdr_cache_filename_format_set)
+    {
+      strcpy (wc->sdr_cache_filename_format, c->sdr_cache_filename_format);
+      wc->sdr_cache_filename_format_set = 1;
+    }
+
+  if (c->sel_config_file_set)
+    {
+      if (ipmi_monitoring_ctx_sel_config_file (wc,
+                                               strlen (c->sel_config_file) ? c->sel_config_file : NULL) < 0)
+        {
+          c->errnum = wc->errnum;
+          goto cleanup;
+        }
+    }
+
+  if (c->sensor_config_file_set)
+    {
+      if (ipmi_monitoring_ctx_sensor_config_file (wc,
+                                                  strlen (c->sensor_config_file) ? c->sensor_config_file : NULL) < 0)
+        {
+          c->errnum = wc->errnum;
+          goto cleanup;
+        }
+    }
+
+  wc->session_cache_parent = c;
+  return (wc);
+
+ cleanup:
+  ipmi_monitoring_ctx_destroy (wc);
+  return (NULL);
+}
+
+/* Create worker contexts as needed, so config file errors are
+ * returned before any host is contacted.
+ */
+static int
+_hostrange_ctxs_setup (ipmi_monitoring_ctx_t c, unsigned int count)
+{
+  ipmi_monitoring_ctx_t *ctxs;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (count);
+
+  if (count <= c->hostrange_ctxs_count)
+    return (0);
+
+  if (!(ctxs = (ipmi_monitoring_ctx_t *)realloc (c->hostrange_ctxs, sizeof (ipmi_monitoring_ctx_t) * count)))
+    {
+      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
+      return (-1);
+    }
+  c->hostrange_ctxs = ctxs;
+
+  while (c->hostrange_ctxs_count < count)
+    {
+      if (!(c->hostrange_ctxs[c->hostrange_ctxs_count] = _hostrange_ctx_create (c)))
+        return (-1);
+      c->hostrange_ctxs_count++;
+    }
+
+  return (0);
+}
+
+void
+ipmi_monitoring_hostrange_ctxs_destroy (ipmi_monitoring_ctx_t c)
+{
+  unsigned int i;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+
+  for (i = 0; i < c->hostrange_ctxs_count; i++)
+    ipmi_monitoring_ctx_destroy (c->hostrange_ctxs[i]);
+  free (c->hostrange_ctxs);
+  c->hostrange_ctxs = NULL;
+  c->hostrange_ctxs_count = 0;
+}
+
+static int
+_hostrange_hosts_create (ipmi_monitoring_ctx_t c,
+                         struct ipmi_monitoring_hostrange *hr,
+                         const char *hostnames)
+{
+  fi_hostlist_t hl = NULL;
+  fi_hostlist_iterator_t hitr = NULL;
+  char *host;
+  int count;
+  int rv = -1;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (hr);
+  assert (hostnames);
+
+  if (!(hl = fi_hostlist_create (hostnames)))
+    {
+      c->errnum = IPMI_MONITORING_ERR_HOSTNAME_INVALID;
+      goto cleanup;
+    }
+
+  fi_hostlist_uniq (hl);
+
+  if ((count = fi_hostlist_count (hl)) <= 0)
+    {
+      c->errnum = IPMI_MONITORING_ERR_HOSTNAME_INVALID;
+      goto cleanup;
+    }
+
+  if (!(hr->hosts = (char **)malloc (sizeof (char *) * count)))
+    {
+      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+  memset (hr->hosts, '\0', sizeof (char *) * count);
+
+  if (!(hitr = fi_hostlist_iterator_create (hl)))
+    {
+      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+
+  while (hr->hosts_count < (unsigned int)count
+         && (host = fi_hostlist_next (hitr)))
+    {
+      if (strlen (host) > MAXHOSTNAMELEN)
+        {
+          free (host);
+          c->errnum = IPMI_MONITORING_ERR_HOSTNAME_INVALID;
+          goto cleanup;
+        }
+      hr->hosts[hr->hosts_count++] = host;
+    }
+
+  if (hr->hosts_count != (unsigned int)count)
+    {
+      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+
+  rv = 0;
+ cleanup:
+  if (hitr)
+    fi_hostlist_iterator_destroy (hitr);
+  if (hl)
+    fi_hostlist_destroy (hl);
+  return (rv);
+}
+
+int
+ipmi_monitoring_hostrange (ipmi_monitoring_ctx_t c,
+                           const char *hostnames,
+                           unsigned int fanout,
+                           struct ipmi_monitoring_hostrange_args *args,
+                           Ipmi_Monitoring_Hostrange_Callback callback,
+                           void *callback_data)
+{
+  struct ipmi_monitoring_hostrange hr;
+  unsigned int successes = 0;
+  unsigned int i;
+  int mutex_initialized = 0;
+  int done_cond_initialized = 0;
+  int delivered_cond_initialized = 0;
+  int rv = -1;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (hostnames);
+  assert (fanout);
+  assert (args);
+  assert (callback);
+
+  memset (&hr, '\0', sizeof (struct ipmi_monitoring_hostrange));
+  hr.args = args;
+
+  if (_hostrange_hosts_create (c, &hr, hostnames) < 0)
+    goto cleanup;
+
+  hr.workers_count = hr.hosts_count < fanout ? hr.hosts_count : fanout;
+
+  if (!(hr.workers = (struct ipmi_monitoring_hostrange_worker *)malloc (sizeof (struct ipmi_monitoring_hostrange_worker) * hr.workers_count)))
+    {
+      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+  memset (hr.workers, '\0', sizeof (struct ipmi_monitoring_hostrange_worker) * hr.workers_count);
+
+  if (!(hr.done = (struct ipmi_monitoring_hostrange_worker **)malloc (sizeof (struct ipmi_monitoring_hostrange_worker *) * hr.workers_count)))
+    {
+      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+
+  if (_hostrange_ctxs_setup (c, hr.workers_count) < 0)
+    goto cleanup;
+
+  for (i = 0; i < hr.workers_count; i++)
+    {
+      hr.workers[i].hr = &hr;
+      hr.workers[i].c = c->hostrange_ctxs[i];
+    }
+
+  if ((errno = pthread_mutex_init (&hr.mutex, NULL)))
+    {
+      IPMI_MONITORING_DEBUG (("pthread_mutex_init: %s", strerror (errno)));
+      c->errnum = IPMI_MONITORING_ERR_SYSTEM_ERROR;
+      goto cleanup;
+    }
+  mutex_initialized++;
+
+  if ((errno = pthread_cond_init (&hr.done_cond, NULL)))
+    {
+      IPMI_MONITORING_DEBUG (("pthread_cond_init: %s", strerror (errno)));
+      c->errnum = IPMI_MONITORING_ERR_SYSTEM_ERROR;
+      goto cleanup;
+    }
+  done_cond_initialized++;
+
+  if ((errno = pthread_cond_init (&hr.delivered_cond, NULL)))
+    {
+      IPMI_MONITORING_DEBUG (("pthread_cond_init: %s", strerror (errno)));
+      c->errnum = IPMI_MONITORING_ERR_SYSTEM_ERROR;
+      goto cleanup;
+    }
+  delivered_cond_initialized++;
+
+  c->errnum = IPMI_MONITORING_ERR_SUCCESS;
+
+  pthread_mutex_lock (&hr.mutex);
+  for (i = 0; i < hr.workers_count; i++)
+    {
+      if ((errno = pthread_create (&hr.workers[i].thread,
+                                   NULL,
+                                   _hostrange_worker,
+                                   &hr.workers[i])))
+        {
+          IPMI_MONITORING_DEBUG (("pthread_create: %s", strerror (errno)));
+          c->errnum = IPMI_MONITORING_ERR_SYSTEM_ERROR;
+          hr.stop = 1;
+          break;
+        }
+      hr.workers[i].thread_created = 1;
+      hr.workers_running++;
+    }
+
+  /* Deliver results as workers complete hosts.  Once stopped, results
+   * still outstanding are discarded.
+   */
+  while (hr.workers_running || hr.done_count)
+    {
+      struct ipmi_monitoring_hostrange_worker *w;
+
+      if (!hr.done_count)
+        {
+          pthread_cond_wait (&hr.done_cond, &hr.mutex);
+          continue;
+        }
+
+      w = hr.done[hr.done_head];
+      hr.done_head = (hr.done_head + 1) % hr.workers_count;
+      hr.done_count--;
+
+      if (!hr.stop)
+        {
+          pthread_mutex_unlock (&hr.mutex);
+
+          if (w->rv >= 0)
+            successes++;
+
+          if (callback (w->c, w->hostname, callback_data) < 0)
+            {
+              c->errnum = IPMI_MONITORING_ERR_CALLBACK_ERROR;
+              pthread_mutex_lock (&hr.mutex);
+              hr.stop = 1;
+            }
+          else
+            pthread_mutex_lock (&hr.mutex);
+        }
+
+      w->delivered = 1;
+      pthread_cond_broadcast (&hr.delivered_cond);
+    }
+  pthread_mutex_unlock (&hr.mutex);
+
+  for (i = 0; i < hr.workers_count; i++)
+    {
+      if (hr.workers[i].thread_created)
+        pthread_join (hr.workers[i].thread, NULL);
+    }
+
+  if (c->errnum == IPMI_MONITORING_ERR_SUCCESS)
+    rv = successes;
+
+ cleanup:
+  if (delivered_cond_initialized)
+    pthread_cond_destroy (&hr.delivered_cond);
+  if (done_cond_initialized)
+    pthread_cond_destroy (&hr.done_cond);
+  if (mutex_initialized)
+    pthread_mutex_destroy (&hr.mutex);
+  free (hr.workers);
+  free (hr.done);
+  if (hr.hosts)
+    {
+      for (i = 0; i < hr.hosts_count; i++)
+        free (hr.hosts[i]);
+      free (hr.hosts);
+    }
+  return (rv);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMI_MONITORING_HOSTRANGE_H
+#define IPMI_MONITORING_HOSTRANGE_H
+
+#include "ipmi_monitoring.h"
+
+#define IPMI_MONITORING_HOSTRANGE_SEL_BY_RECORD_ID                0
+#define IPMI_MONITORING_HOSTRANGE_SEL_BY_SENSOR_TYPE              1
+#define IPMI_MONITORING_HOSTRANGE_SEL_BY_DATE_RANGE               2
+#define IPMI_MONITORING_HOSTRANGE_SENSOR_READINGS_BY_RECORD_ID    3
+#define IPMI_MONITORING_HOSTRANGE_SENSOR_READINGS_BY_SENSOR_TYPE  4
+
+/* Arguments passed through to the single host function for each
+ * host.  Only those relevant to the type are used.
+ */
+struct ipmi_monitoring_hostrange_args
+{
+  int type;
+  struct ipmi_monitoring_ipmi_config *config;
+  unsigned int flags;
+  unsigned int *record_ids;
+  unsigned int record_ids_len;
+  unsigned int *sensor_types;
+  unsigned int sensor_types_len;
+  const char *date_begin;
+  const char *date_end;
+};
+
+/* Returns number of hosts retrieved from successfully, -1 on error */
+int ipmi_monitoring_hostrange (ipmi_monitoring_ctx_t c,
+                               const char *hostnames,
+                               unsigned int fanout,
+                               struct ipmi_monitoring_hostrange_args *args,
+                               Ipmi_Monitoring_Hostrange_Callback callback,
+                               void *callback_data);
+
+/* Destroy worker contexts kept from previous calls */
+void ipmi_monitoring_hostrange_ctxs_destroy (ipmi_monitoring_ctx_t c);
+
+#endif /* IPMI_MONITORING_HOSTRANGE_H */
@@ -46,6 +46,7 @@
 #include "ipmi_monitoring_defs.h"
 #include "ipmi_monitoring_debug.h"
 #include "ipmi_monitoring_ipmi_communication.h"
+#include "ipmi_monitoring_session_cache.h"
 
 #include "freeipmi-portability.h"
 #include "fi_hostlist.h"
@@ -549,6 +550,11 @@ ipmi_monitoring_ipmi_communication_init (ipmi_monitoring_ctx_t c,
   assert (c->magic == IPMI_MONITORING_MAGIC);
   assert (!c->ipmi_ctx);
 
+  if (hostname
+      && !host_is_localhost (hostname)
+      && ipmi_monitoring_session_cache_get (c, hostname, config) > 0)
+    return (0);
+
   if (!(c->ipmi_ctx = ipmi_ctx_create ()))
     {
       IPMI_MONITORING_DEBUG (("ipmi_ctx_create: %s", strerror (errno)));
@@ -565,6 +571,8 @@ ipmi_monitoring_ipmi_communication_init (ipmi_monitoring_ctx_t c,
     {
       if (_outofband_init (c, hostname, config) < 0)
         goto cleanup;
+
+      ipmi_monitoring_session_cache_add (c, hostname, config);
     }
 
   return (0);
@@ -602,6 +610,9 @@ ipmi_monitoring_ipmi_communication_cleanup (ipmi_monitoring_ctx_t c)
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
 
-  _ipmi_communication_cleanup (c);
+  if (c->session_cache_entry)
+    ipmi_monitoring_session_cache_release (c);
+  else
+    _ipmi_communication_cleanup (c);
   return (0);
 }
@@ -271,6 +271,10 @@ ipmi_monitoring_sdr_cache_load (ipmi_monitoring_ctx_t c,
   assert (c->magic == IPMI_MONITORING_MAGIC);
   assert (c->ipmi_ctx);
 
+  /* already open from a cached session */
+  if (c->sdr_ctx)
+    return (0);
+
   memset (filename, '\0', MAXPATHLEN + 1);
 
   if (_ipmi_monitoring_sdr_cache_filename (c, hostname, filename, MAXPATHLEN + 1) < 0)
@@ -354,6 +358,10 @@ ipmi_monitoring_sdr_cache_unload (ipmi_monitoring_ctx_t c)
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
 
+  /* kept open with the cached session */
+  if (c->session_cache_entry)
+    return (0);
+
   ipmi_sdr_cache_close (c->sdr_ctx);
   ipmi_sdr_ctx_destroy (c->sdr_ctx);
   c->sdr_ctx = NULL;
@@ -369,6 +377,14 @@ ipmi_monitoring_sdr_cache_flush (ipmi_monitoring_ctx_t c,
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
 
+  /* close SDR opened from a cached session */
+  if (c->sdr_ctx)
+    {
+      ipmi_sdr_cache_close (c->sdr_ctx);
+      ipmi_sdr_ctx_destroy (c->sdr_ctx);
+      c->sdr_ctx = NULL;
+    }
+
   memset (filename, '\0', MAXPATHLEN + 1);
 
   if (_ipmi_monitoring_sdr_cache_filename (c, hostname, filename, MAXPATHLEN + 1) < 0)
@@ -380,6 +396,8 @@ ipmi_monitoring_sdr_cache_flush (ipmi_monitoring_ctx_t c,
   if (_ipmi_monitoring_sdr_cache_delete (c, hostname, filename) < 0)
     goto cleanup;
 
+  ipmi_sdr_ctx_destroy (c->sdr_ctx);
+  c->sdr_ctx = NULL;
   return (0);
 
  cleanup:
@@ -38,6 +38,7 @@
 #include <freeipmi/freeipmi.h>
 
 #include "ipmi_monitoring.h"
+#include "ipmi_monitoring_arena.h"
 #include "ipmi_monitoring_bitmasks.h"
 #include "ipmi_monitoring_debug.h"
 #include "ipmi_monitoring_defs.h"
@@ -91,22 +92,84 @@ ipmi_monitoring_sensor_reading_cleanup (ipmi_monitoring_ctx_t c)
   return (0);
 }
 
-static struct ipmi_monitoring_sensor_reading *
-_allocate_sensor_reading (ipmi_monitoring_ctx_t c)
+static char **
+_copy_sensor_bitmask_strings (ipmi_monitoring_ctx_t c,
+                              char **sensor_bitmask_strings)
 {
-  struct ipmi_monitoring_sensor_reading *s = NULL;
+  char **rv;
+  unsigned int count = 0;
+  unsigned int i;
 
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (sensor_bitmask_strings);
+
+  while (sensor_bitmask_strings[count])
+    count++;
+
+  if (!(rv = (char **)ipmi_monitoring_arena_alloc (c, sizeof (char *) * (count + 1))))
+    return (NULL);
 
-  if (!(s = (struct ipmi_monitoring_sensor_reading *)malloc (sizeof (struct ipmi_monitoring_sensor_reading))))
+  for (i = 0; i < count; i++)
     {
-      IPMI_MONITORING_DEBUG (("malloc: %s", strerror (errno)));
-      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
-      return (NULL);
+      if (!(rv[i] = ipmi_monitoring_arena_strdup (c, sensor_bitmask_strings[i])))
+        return (NULL);
+    }
+
+  return (rv);
+}
+
+/* 's' and its bitmask strings belong to the caller.  Unless the
+ * caller only wants callbacks, the reading is copied into the context
+ * arena and appended to the results.
+ */
+static int
+_output_sensor_reading (ipmi_monitoring_ctx_t c,
+                        unsigned int sensor_reading_flags,
+                        struct ipmi_monitoring_sensor_reading *s)
+{
+  struct ipmi_monitoring_sensor_reading *stored;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (s);
+
+  if (c->callback)
+    {
+      c->callback_sensor_reading = s;
+      if ((*c->callback)(c, c->callback_data) < 0)
+        {
+          IPMI_MONITORING_DEBUG (("callback error"));
+          c->errnum = IPMI_MONITORING_ERR_CALLBACK_ERROR;
+          c->callback_sensor_reading = NULL;
+          return (-1);
+        }
+      c->callback_sensor_reading = NULL;
     }
-  memset (s, '\0', sizeof (struct ipmi_monitoring_sensor_reading));
-  return (s);
+
+  if (!(sensor_reading_flags & IPMI_MONITORING_SENSOR_READING_FLAGS_CALLBACK_ONLY))
+    {
+      if (!(stored = (struct ipmi_monitoring_sensor_reading *)ipmi_monitoring_arena_alloc (c, sizeof (struct ipmi_monitoring_sensor_reading))))
+        return (-1);
+
+      memcpy (stored, s, sizeof (struct ipmi_monitoring_sensor_reading));
+      stored->next = NULL;
+
+      if (s->sensor_bitmask_strings)
+        {
+          if (!(stored->sensor_bitmask_strings = _copy_sensor_bitmask_strings (c, s->sensor_bitmask_strings)))
+            return (-1);
+        }
+
+      if (c->sensor_readings_last)
+        c->sensor_readings_last->next = stored;
+      else
+        c->sensor_readings = stored;
+      c->sensor_readings_last = stored;
+    }
+
+  c->sensor_readings_count++;
+  return (0);
 }
 
 /* return -1 on error, 0 on no append, 1 on append */
@@ -126,11 +189,10 @@ _store_sensor_reading (ipmi_monitoring_ctx_t c,
                        void *sensor_reading,
                        int event_reading_type_code)
 {
-  struct ipmi_monitoring_sensor_reading *s = NULL;
+  struct ipmi_monitoring_sensor_reading s;
 
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
-  assert (c->sensor_readings);
   assert (IPMI_MONITORING_SENSOR_TYPE_VALID (sensor_type));
   assert (sensor_name);
   assert (IPMI_MONITORING_STATE_VALID (sensor_state));
@@ -142,53 +204,32 @@ _store_sensor_reading (ipmi_monitoring_ctx_t c,
       && sensor_state == IPMI_MONITORING_STATE_UNKNOWN)
     return (0);
 
-  if (!(s = _allocate_sensor_reading (c)))
-    goto cleanup;
-
-  s->record_id = record_id;
-  s->sensor_number = sensor_number;
-  s->sensor_type = sensor_type;
-  strncpy (s->sensor_name, sensor_name, IPMI_MONITORING_MAX_SENSOR_NAME_LENGTH);
-  s->sensor_state = sensor_state;
-  s->sensor_units = sensor_units;
-  s->sensor_reading_type = sensor_reading_type;
-  s->sensor_bitmask_type = sensor_bitmask_type;
-  s->sensor_bitmask = sensor_bitmask;
-  s->sensor_bitmask_strings = sensor_bitmask_strings;
-
-  if (s->sensor_reading_type == IPMI_MONITORING_SENSOR_READING_TYPE_UNSIGNED_INTEGER8_BOOL)
-    s->sensor_reading.bool_val = *((uint8_t *)sensor_reading);
-  else if (s->sensor_reading_type == IPMI_MONITORING_SENSOR_READING_TYPE_UNSIGNED_INTEGER32)
-    s->sensor_reading.integer_val = *((uint32_t *)sensor_reading);
-  else if (s->sensor_reading_type == IPMI_MONITORING_SENSOR_READING_TYPE_DOUBLE)
-    s->sensor_reading.double_val = *((double *)sensor_reading);
-
-  s->event_reading_type_code = event_reading_type_code;
-
-  /* achu: should come before list_append to avoid having a freed entry on the list */
-  if (c->callback)
-    {
-      c->callback_sensor_reading = s;
-      if ((*c->callback)(c, c->callback_data) < 0)
-        {
-          IPMI_MONITORING_DEBUG (("callback error"));
-          c->errnum = IPMI_MONITORING_ERR_CALLBACK_ERROR;
-          goto cleanup;
-        }
-    }
-
-  if (!list_append (c->sensor_readings, s))
-    {
-      IPMI_MONITORING_DEBUG (("list_append: %s", strerror (errno)));
-      c->errnum = IPMI_MONITORING_ERR_INTERNAL_ERROR;
-      goto cleanup;
-    }
+  memset (&s, '\0', sizeof (struct ipmi_monitoring_sensor_reading));
+
+  s.record_id = record_id;
+  s.sensor_number = sensor_number;
+  s.sensor_type = sensor_type;
+  strncpy (s.sensor_name, sensor_name, IPMI_MONITORING_MAX_SENSOR_NAME_LENGTH);
+  s.sensor_state = sensor_state;
+  s.sensor_units = sensor_units;
+  s.sensor_reading_type = sensor_reading_type;
+  s.sensor_bitmask_type = sensor_bitmask_type;
+  s.sensor_bitmask = sensor_bitmask;
+  s.sensor_bitmask_strings = sensor_bitmask_strings;
+
+  if (s.sensor_reading_type == IPMI_MONITORING_SENSOR_READING_TYPE_UNSIGNED_INTEGER8_BOOL)
+    s.sensor_reading.bool_val = *((uint8_t *)sensor_reading);
+  else if (s.sensor_reading_type == IPMI_MONITORING_SENSOR_READING_TYPE_UNSIGNED_INTEGER32)
+    s.sensor_reading.integer_val = *((uint32_t *)sensor_reading);
+  else if (s.sensor_reading_type == IPMI_MONITORING_SENSOR_READING_TYPE_DOUBLE)
+    s.sensor_reading.double_val = *((double *)sensor_reading);
+
+  s.event_reading_type_code = event_reading_type_code;
+
+  if (_output_sensor_reading (c, sensor_reading_flags, &s) < 0)
+    return (-1);
 
   return (1);
-
- cleanup:
-  free (s);
-  return (-1);
 }
 
 static int
@@ -201,57 +242,35 @@ _store_unreadable_sensor_reading (ipmi_monitoring_ctx_t c,
                                   int sensor_units,
                                   int event_reading_type_code)
 {
-  struct ipmi_monitoring_sensor_reading *s = NULL;
+  struct ipmi_monitoring_sensor_reading s;
 
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
-  assert (c->sensor_readings);
   assert (IPMI_MONITORING_SENSOR_TYPE_VALID (sensor_type));
   assert (IPMI_MONITORING_SENSOR_UNITS_VALID (sensor_units));
 
   if (sensor_reading_flags & IPMI_MONITORING_SENSOR_READING_FLAGS_IGNORE_NON_INTERPRETABLE_SENSORS)
     return (0);
 
-  if (!(s = _allocate_sensor_reading (c)))
-    goto cleanup;
+  memset (&s, '\0', sizeof (struct ipmi_monitoring_sensor_reading));
 
-  s->record_id = record_id;
-  s->sensor_number = sensor_number;
-  s->sensor_type = sensor_type;
+  s.record_id = record_id;
+  s.sensor_number = sensor_number;
+  s.sensor_type = sensor_type;
   if (sensor_name)
-    strncpy (s->sensor_name, sensor_name, IPMI_MONITORING_MAX_SENSOR_NAME_LENGTH);
-  s->sensor_state = IPMI_MONITORING_STATE_UNKNOWN;
-  s->sensor_units = sensor_units;
-  s->sensor_reading_type = IPMI_MONITORING_SENSOR_READING_TYPE_UNKNOWN;
-  s->sensor_bitmask_type = IPMI_MONITORING_SENSOR_BITMASK_TYPE_UNKNOWN;
-  s->sensor_bitmask = 0;
-  s->sensor_bitmask_strings = NULL;
-  s->event_reading_type_code = event_reading_type_code;
-
-  /* achu: should come before list_append to avoid having a freed entry on the list */
-  if (c->callback)
-    {
-      c->callback_sensor_reading = s;
-      if ((*c->callback)(c, c->callback_data) < 0)
-        {
-          IPMI_MONITORING_DEBUG (("callback error"));
-          c->errnum = IPMI_MONITORING_ERR_CALLBACK_ERROR;
-          goto cleanup;
-        }
-    }
-
-  if (!list_append (c->sensor_readings, s))
-    {
-      IPMI_MONITORING_DEBUG (("list_append: %s", strerror (errno)));
-      c->errnum = IPMI_MONITORING_ERR_INTERNAL_ERROR;
-      goto cleanup;
-    }
+    strncpy (s.sensor_name, sensor_name, IPMI_MONITORING_MAX_SENSOR_NAME_LENGTH);
+  s.sensor_state = IPMI_MONITORING_STATE_UNKNOWN;
+  s.sensor_units = sensor_units;
+  s.sensor_reading_type = IPMI_MONITORING_SENSOR_READING_TYPE_UNKNOWN;
+  s.sensor_bitmask_type = IPMI_MONITORING_SENSOR_BITMASK_TYPE_UNKNOWN;
+  s.sensor_bitmask = 0;
+  s.sensor_bitmask_strings = NULL;
+  s.event_reading_type_code = event_reading_type_code;
+
+  if (_output_sensor_reading (c, sensor_reading_flags, &s) < 0)
+    return (-1);
 
   return (0);
-
- cleanup:
-  free (s);
-  return (-1);
 }
 
 static int
@@ -334,7 +353,6 @@ _get_sensor_reading (ipmi_monitoring_ctx_t c,
 
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
-  assert (c->sensor_readings);
   assert (sensor_reading);
   assert (sensor_reading_valid);
   assert (sensor_event_bitmask);
@@ -547,7 +565,6 @@ _threshold_sensor_reading (ipmi_monitoring_ctx_t c,
 
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
-  assert (c->sensor_readings);
   assert (IPMI_MONITORING_SENSOR_TYPE_VALID (sensor_type));
   assert (sensor_name);
 
@@ -612,25 +629,23 @@ _threshold_sensor_reading (ipmi_monitoring_ctx_t c,
                                    &sensor_bitmask_strings) < 0)
     return (-1);
 
-  if ((ret = _store_sensor_reading (c,
-                                    sensor_reading_flags,
-                                    record_id,
-                                    sensor_number_base + shared_sensor_number_offset,
-                                    sensor_type,
-                                    sensor_name,
-                                    sensor_state,
-                                    sensor_units,
-                                    IPMI_MONITORING_SENSOR_READING_TYPE_DOUBLE,
-                                    IPMI_MONITORING_SENSOR_BITMASK_TYPE_THRESHOLD,
-                                    sensor_event_bitmask,
-                                    sensor_bitmask_strings,
-                                    &sensor_reading,
-                                    event_reading_type_code)) <= 0)
-    {
-      _free_sensor_bitmask_strings (sensor_bitmask_strings);
-      if (ret < 0)
-        return (-1);
-    }
+  ret = _store_sensor_reading (c,
+                               sensor_reading_flags,
+                               record_id,
+                               sensor_number_base + shared_sensor_number_offset,
+                               sensor_type,
+                               sensor_name,
+                               sensor_state,
+                               sensor_units,
+                               IPMI_MONITORING_SENSOR_READING_TYPE_DOUBLE,
+                               IPMI_MONITORING_SENSOR_BITMASK_TYPE_THRESHOLD,
+                               sensor_event_bitmask,
+                               sensor_bitmask_strings,
+                               &sensor_reading,
+                               event_reading_type_code);
+  _free_sensor_bitmask_strings (sensor_bitmask_strings);
+  if (ret < 0)
+    return (-1);
 
   return (0);
 }
@@ -644,7 +659,6 @@ _get_sensor_bitmask_type (ipmi_monitoring_ctx_t c,
 
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
-  assert (c->sensor_readings);
 
   if (event_reading_type_code == IPMI_EVENT_READING_TYPE_CODE_THRESHOLD)
     sensor_bitmask_type = IPMI_MONITORING_SENSOR_BITMASK_TYPE_THRESHOLD;
@@ -803,7 +817,6 @@ _digital_sensor_reading (ipmi_monitoring_ctx_t c,
 
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
-  assert (c->sensor_readings);
   assert (IPMI_EVENT_READING_TYPE_CODE_IS_GENERIC (event_reading_type_code));
   assert (IPMI_MONITORING_SENSOR_TYPE_VALID (sensor_type));
   assert (sensor_name);
@@ -885,49 +898,45 @@ _digital_sensor_reading (ipmi_monitoring_ctx_t c,
       if (sensor_units == IPMI_MONITORING_SENSOR_UNITS_UNKNOWN)
         goto normal_reading;
 
-      if ((ret = _store_sensor_reading (c,
-                                        sensor_reading_flags,
-                                        record_id,
-                                        sensor_number_base + shared_sensor_number_offset,
-                                        sensor_type,
-                                        sensor_name,
-                                        sensor_state,
-                                        sensor_units,
-                                        IPMI_MONITORING_SENSOR_READING_TYPE_DOUBLE,
-                                        sensor_bitmask_type,
-                                        sensor_event_bitmask,
-                                        sensor_bitmask_strings,
-                                        &sensor_reading,
-                                        event_reading_type_code)) <= 0)
-        {
-          _free_sensor_bitmask_strings (sensor_bitmask_strings);
-          if (ret < 0)
-            return (-1);
-        }
+      ret = _store_sensor_reading (c,
+                                   sensor_reading_flags,
+                                   record_id,
+                                   sensor_number_base + shared_sensor_number_offset,
+                                   sensor_type,
+                                   sensor_name,
+                                   sensor_state,
+                                   sensor_units,
+                                   IPMI_MONITORING_SENSOR_READING_TYPE_DOUBLE,
+                                   sensor_bitmask_type,
+                                   sensor_event_bitmask,
+                                   sensor_bitmask_strings,
+                                   &sensor_reading,
+                                   event_reading_type_code);
+      _free_sensor_bitmask_strings (sensor_bitmask_strings);
+      if (ret < 0)
+        return (-1);
     }
   else
     {
 normal_reading:
       /* No actual sensor reading, only a sensor event bitmask */
-      if ((ret = _store_sensor_reading (c,
-                                        sensor_reading_flags,
-                                        record_id,
-                                        sensor_number_base + shared_sensor_number_offset,
-                                        sensor_type,
-                                        sensor_name,
-                                        sensor_state,
-                                        IPMI_MONITORING_SENSOR_UNITS_NONE,
-                                        IPMI_MONITORING_SENSOR_READING_TYPE_UNKNOWN,
-                                        sensor_bitmask_type,
-                                        sensor_event_bitmask,
-                                        sensor_bitmask_strings,
-                                        NULL,
-                                        event_reading_type_code)) <= 0)
-        {
-          _free_sensor_bitmask_strings (sensor_bitmask_strings);
-          if (ret < 0)
-            return (-1);
-        }
+      ret = _store_sensor_reading (c,
+                                   sensor_reading_flags,
+                                   record_id,
+                                   sensor_number_base + shared_sensor_number_offset,
+                                   sensor_type,
+                                   sensor_name,
+                                   sensor_state,
+                                   IPMI_MONITORING_SENSOR_UNITS_NONE,
+                                   IPMI_MONITORING_SENSOR_READING_TYPE_UNKNOWN,
+                                   sensor_bitmask_type,
+                                   sensor_event_bitmask,
+                                   sensor_bitmask_strings,
+                                   NULL,
+                                   event_reading_type_code);
+      _free_sensor_bitmask_strings (sensor_bitmask_strings);
+      if (ret < 0)
+        return (-1);
     }
 
   return (0);
@@ -954,7 +963,6 @@ _specific_sensor_reading (ipmi_monitoring_ctx_t c,
 
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
-  assert (c->sensor_readings);
   assert (sensor_name);
 
   if ((ret = _get_sensor_reading (c,
@@ -1034,49 +1042,45 @@ _specific_sensor_reading (ipmi_monitoring_ctx_t c,
       if (sensor_units == IPMI_MONITORING_SENSOR_UNITS_UNKNOWN)
         goto normal_reading;
 
-      if ((ret = _store_sensor_reading (c,
-                                        sensor_reading_flags,
-                                        record_id,
-                                        sensor_number_base + shared_sensor_number_offset,
-                                        sensor_type,
-                                        sensor_name,
-                                        sensor_state,
-                                        sensor_units,
-                                        IPMI_MONITORING_SENSOR_READING_TYPE_DOUBLE,
-                                        sensor_bitmask_type,
-                                        sensor_event_bitmask,
-                                        sensor_bitmask_strings,
-                                        &sensor_reading,
-                                        event_reading_type_code)) <= 0)
-        {
-          _free_sensor_bitmask_strings (sensor_bitmask_strings);
-          if (ret < 0)
-            return (-1);
-        }
+      ret = _store_sensor_reading (c,
+                                   sensor_reading_flags,
+                                   record_id,
+                                   sensor_number_base + shared_sensor_number_offset,
+                                   sensor_type,
+                                   sensor_name,
+                                   sensor_state,
+                                   sensor_units,
+                                   IPMI_MONITORING_SENSOR_READING_TYPE_DOUBLE,
+                                   sensor_bitmask_type,
+                                   sensor_event_bitmask,
+                                   sensor_bitmask_strings,
+                                   &sensor_reading,
+                                   event_reading_type_code);
+      _free_sensor_bitmask_strings (sensor_bitmask_strings);
+      if (ret < 0)
+        return (-1);
     }
   else
     {
 normal_reading:
       /* No actual sensor reading, only a sensor event bitmask */
-      if ((ret = _store_sensor_reading (c,
-                                        sensor_reading_flags,
-                                        record_id,
-                                        sensor_number_base + shared_sensor_number_offset,
-                                        sensor_type,
-                                        sensor_name,
-                                        sensor_state,
-                                        IPMI_MONITORING_SENSOR_UNITS_NONE,
-                                        IPMI_MONITORING_SENSOR_READING_TYPE_UNKNOWN,
-                                        sensor_bitmask_type,
-                                        sensor_event_bitmask,
-                                        sensor_bitmask_strings,
-                                        NULL,
-                                        event_reading_type_code)) <= 0)
-        {
-          _free_sensor_bitmask_strings (sensor_bitmask_strings);
-          if (ret < 0)
-            return (-1);
-        }
+      ret = _store_sensor_reading (c,
+                                   sensor_reading_flags,
+                                   record_id,
+                                   sensor_number_base + shared_sensor_number_offset,
+                                   sensor_type,
+                                   sensor_name,
+                                   sensor_state,
+                                   IPMI_MONITORING_SENSOR_UNITS_NONE,
+                                   IPMI_MONITORING_SENSOR_READING_TYPE_UNKNOWN,
+                                   sensor_bitmask_type,
+                                   sensor_event_bitmask,
+                                   sensor_bitmask_strings,
+                                   NULL,
+                                   event_reading_type_code);
+      _free_sensor_bitmask_strings (sensor_bitmask_strings);
+      if (ret < 0)
+        return (-1);
     }
 
   return (0);
@@ -1103,7 +1107,6 @@ _oem_sensor_reading (ipmi_monitoring_ctx_t c,
 
   assert (c);
   assert (c->magic == IPMI_MONITORING_MAGIC);
-  assert (c->sensor_readings);
   assert (sensor_name);
 
   if ((ret = _get_sensor_reading (c,
@@ -1150,25 +1153,23 @@ _oem_sensor_reading (ipmi_monitoring_ctx_t c,
     return (-1);
 
   /* No actual sensor reading, only a sensor event bitmask */
-  if ((ret = _store_sensor_reading (c,
-                                    sensor_reading_flags,
-                                    record_id,
-                                    sensor_number_base + shared_sensor_number_offset,
-                                    sensor_type,
-                                    sensor_name,
-                                    sensor_state,
-                                    IPMI_MONITORING_SENSOR_UNITS_NONE,
-                                    IPMI_MONITORING_SENSOR_READING_TYPE_UNKNOWN,
-                                    sensor_bitmask_type,
-                                    sensor_event_bitmask,
-                                    sensor_bitmask_strings,
-                                    NULL,
-                                    event_reading_type_code)) <= 0)
-    {
-      _free_sensor_bitmask_strings (sensor_bitmask_strings);
-      if (ret < 0)
-        return (-1);
-    }
+  ret = _store_sensor_reading (c,
+                               sensor_reading_flags,
+                               record_id,
+                               sensor_number_base + shared_sensor_number_offset,
+                               sensor_type,
+                               sensor_name,
+                               sensor_state,
+                               IPMI_MONITORING_SENSOR_UNITS_NONE,
+                               IPMI_MONITORING_SENSOR_READING_TYPE_UNKNOWN,
+                               sensor_bitmask_type,
+                               sensor_event_bitmask,
+                               sensor_bitmask_strings,
+                               NULL,
+                               event_reading_type_code);
+  _free_sensor_bitmask_strings (sensor_bitmask_strings);
+  if (ret < 0)
+    return (-1);
 
   return (0);
 }
@@ -1194,7 +1195,6 @@ ipmi_monitoring_get_sensor_reading (ipmi_monitoring_ctx_t c,
   assert (c->magic == IPMI_MONITORING_MAGIC);
   assert (c->ipmi_ctx);
   assert (c->sensor_read_ctx);
-  assert (c->sensor_readings);
   assert (!sensor_types || sensor_types_len);
 
   if (ipmi_sdr_parse_record_id_and_type (c->sdr_ctx,
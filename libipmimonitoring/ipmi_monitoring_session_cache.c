@@ -0,0 +1,541 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#if STDC_HEADERS
+#include <string.h>
+#endif /* STDC_HEADERS */
+#if TIME_WITH_SYS_TIME
+#include <sys/time.h>
+#include <time.h>
+#else /* !TIME_WITH_SYS_TIME */
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else /* !HAVE_SYS_TIME_H */
+#include <time.h>
+#endif /* !HAVE_SYS_TIME_H */
+#endif /* !TIME_WITH_SYS_TIME */
+#include <pthread.h>
+#include <assert.h>
+#include <errno.h>
+#include <freeipmi/freeipmi.h>
+
+#include "ipmi_monitoring.h"
+#include "ipmi_monitoring_debug.h"
+#include "ipmi_monitoring_defs.h"
+#include "ipmi_monitoring_session_cache.h"
+
+#include "freeipmi-portability.h"
+#include "secure.h"
+
+/*
+ * Out-of-band sessions are cached per hostname, along with the SDR
+ * cache opened for the host, so that repeated calls against the same
+ * hosts do not repeat the session establishment handshake and SDR
+ * cache open.
+ *
+ * Sessions are kept in least recently used order, least recently
+ * used at the front of the list.  A session is reused only if it was
+ * opened with the same configuration, has not been idle longer than
+ * the idle timeout, and still responds to a Get SDR Repository Info.
+ * A session that timed out while in use is discarded.  The SDR cache
+ * kept with a session is closed, so it is re-opened and checked
+ * against the host, if the SDR repository has been added to or
+ * erased since it was opened.
+ *
+ * Hostrange worker contexts use the cache of the context they were
+ * created for, see ipmi_monitoring_hostrange.c.  The list is only
+ * accessed under the lock of the context owning it, and a session is
+ * removed from the list while in use, so no two contexts can use or
+ * evict the same session.  Sessions are closed outside of the lock.
+ */
+
+extern uint32_t _ipmi_monitoring_flags;
+
+struct ipmi_monitoring_session_cache_entry {
+  char hostname[MAXHOSTNAMELEN+1];
+
+  /* configuration session was opened with */
+  int config_set;
+  int protocol_version;
+  char username[IPMI_MAX_USER_NAME_LENGTH+1];
+  int username_set;
+  char password[IPMI_2_0_MAX_PASSWORD_LENGTH+1];
+  int password_set;
+  unsigned char k_g[IPMI_MAX_K_G_LENGTH];
+  unsigned int k_g_len;
+  int privilege_level;
+  int authentication_type;
+  int cipher_suite_id;
+  int session_timeout_len;
+  int retransmission_timeout_len;
+  unsigned int workaround_flags;
+
+  ipmi_ctx_t ipmi_ctx;
+  ipmi_sdr_ctx_t sdr_ctx;
+  time_t last_used;
+};
+
+static void
+_ipmi_monitoring_session_cache_entry_destroy (void *x)
+{
+  struct ipmi_monitoring_session_cache_entry *entry;
+
+  assert (x);
+
+  entry = (struct ipmi_monitoring_session_cache_entry *)x;
+
+  if (entry->sdr_ctx)
+    {
+      ipmi_sdr_cache_close (entry->sdr_ctx);
+      ipmi_sdr_ctx_destroy (entry->sdr_ctx);
+    }
+
+  if (entry->ipmi_ctx)
+    {
+      ipmi_ctx_close (entry->ipmi_ctx);
+      ipmi_ctx_destroy (entry->ipmi_ctx);
+    }
+
+  if (_ipmi_monitoring_flags & IPMI_MONITORING_FLAGS_LOCK_MEMORY)
+    secure_free (entry, sizeof (struct ipmi_monitoring_session_cache_entry));
+  else
+    {
+      secure_memset (entry, '\0', sizeof (struct ipmi_monitoring_session_cache_entry));
+      free (entry);
+    }
+}
+
+static int
+_config_match (struct ipmi_monitoring_session_cache_entry *entry,
+               struct ipmi_monitoring_ipmi_config *config)
+{
+  assert (entry);
+
+  if (!config)
+    return (!entry->config_set);
+
+  if (!entry->config_set)
+    return (0);
+
+  if (entry->protocol_version != config->protocol_version
+      || entry->k_g_len != (config->k_g ? config->k_g_len : 0)
+      || entry->privilege_level != config->privilege_level
+      || entry->authentication_type != config->authentication_type
+      || entry->cipher_suite_id != config->cipher_suite_id
+      || entry->session_timeout_len != config->session_timeout_len
+      || entry->retransmission_timeout_len != config->retransmission_timeout_len
+      || entry->workaround_flags != config->workaround_flags)
+    return (0);
+
+  if (entry->username_set != (config->username ? 1 : 0)
+      || (config->username && strcmp (entry->username, config->username)))
+    return (0);
+
+  if (entry->password_set != (config->password ? 1 : 0)
+      || (config->password && strcmp (entry->password, config->password)))
+    return (0);
+
+  if (entry->k_g_len
+      && memcmp (entry->k_g, config->k_g, entry->k_g_len))
+    return (0);
+
+  return (1);
+}
+
+static int
+_sdr_current (struct ipmi_monitoring_session_cache_entry *entry,
+              fiid_obj_t obj_cmd_rs)
+{
+  uint32_t most_recent_addition_timestamp;
+  uint32_t most_recent_erase_timestamp;
+  uint64_t val;
+
+  assert (entry);
+  assert (entry->sdr_ctx);
+  assert (obj_cmd_rs);
+
+  if (ipmi_sdr_cache_most_recent_addition_timestamp (entry->sdr_ctx,
+                                                     &most_recent_addition_timestamp) < 0
+      || ipmi_sdr_cache_most_recent_erase_timestamp (entry->sdr_ctx,
+                                                     &most_recent_erase_timestamp) < 0)
+    {
+      IPMI_MONITORING_DEBUG (("ipmi_sdr_cache_most_recent_timestamp: %s",
+                              ipmi_sdr_ctx_errormsg (entry->sdr_ctx)));
+      return (0);
+    }
+
+  if (FIID_OBJ_GET (obj_cmd_rs,
+                    "most_recent_addition_timestamp",
+                    &val) < 0
+      || val != most_recent_addition_timestamp)
+    return (0);
+
+  if (FIID_OBJ_GET (obj_cmd_rs,
+                    "most_recent_erase_timestamp",
+                    &val) < 0
+      || val != most_recent_erase_timestamp)
+    return (0);
+
+  return (1);
+}
+
+static int
+_session_alive (ipmi_monitoring_ctx_t c,
+                struct ipmi_monitoring_session_cache_entry *entry)
+{
+  fiid_obj_t obj_cmd_rs = NULL;
+  int rv = 0;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (entry);
+  assert (entry->ipmi_ctx);
+
+  if (!(obj_cmd_rs = fiid_obj_create (tmpl_cmd_get_sdr_repository_info_rs)))
+    {
+      IPMI_MONITORING_DEBUG (("fiid_obj_create: %s", strerror (errno)));
+      return (0);
+    }
+
+  if (ipmi_cmd_get_sdr_repository_info (entry->ipmi_ctx, obj_cmd_rs) < 0)
+    {
+      IPMI_MONITORING_DEBUG (("ipmi_cmd_get_sdr_repository_info: %s: %s",
+                              entry->hostname,
+                              ipmi_ctx_errormsg (entry->ipmi_ctx)));
+      goto cleanup;
+    }
+
+  /* SDR changed since it was opened, re-open it */
+  if (entry->sdr_ctx
+      && !_sdr_current (entry, obj_cmd_rs))
+    {
+      ipmi_sdr_cache_close (entry->sdr_ctx);
+      ipmi_sdr_ctx_destroy (entry->sdr_ctx);
+      entry->sdr_ctx = NULL;
+    }
+
+  rv = 1;
+ cleanup:
+  fiid_obj_destroy (obj_cmd_rs);
+  return (rv);
+}
+
+static ipmi_monitoring_ctx_t
+_session_cache_ctx (ipmi_monitoring_ctx_t c)
+{
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+
+  return (c->session_cache_parent ? c->session_cache_parent : c);
+}
+
+/* Remove sessions to be closed into 'reap', so they can be closed
+ * once the lock is released.  If 'reap' is NULL they are closed
+ * immediately.
+ */
+static void
+_session_cache_reap (List reap, struct ipmi_monitoring_session_cache_entry *entry)
+{
+  assert (entry);
+
+  if (!reap || !list_append (reap, entry))
+    _ipmi_monitoring_session_cache_entry_destroy (entry);
+}
+
+static void
+_session_cache_expire (ipmi_monitoring_ctx_t c, time_t now, List reap)
+{
+  struct ipmi_monitoring_session_cache_entry *entry;
+  ListIterator itr;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (c->session_cache);
+
+  if (!(itr = list_iterator_create (c->session_cache)))
+    {
+      IPMI_MONITORING_DEBUG (("list_iterator_create: %s", strerror (errno)));
+      return;
+    }
+
+  while ((entry = list_next (itr)))
+    {
+      if ((now - entry->last_used) > (time_t)c->session_cache_idle_timeout)
+        _session_cache_reap (reap, list_remove (itr));
+    }
+
+  list_iterator_destroy (itr);
+}
+
+int
+ipmi_monitoring_session_cache_setup (ipmi_monitoring_ctx_t c,
+                                     unsigned int max_sessions,
+                                     unsigned int idle_timeout)
+{
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (!c->session_cache_parent);
+  assert (!c->session_cache_entry);
+
+  ipmi_monitoring_session_cache_destroy (c);
+
+  if (!max_sessions)
+    return (0);
+
+  if (!(c->session_cache = list_create ((ListDelF)_ipmi_monitoring_session_cache_entry_destroy)))
+    {
+      IPMI_MONITORING_DEBUG (("list_create: %s", strerror (errno)));
+      c->errnum = IPMI_MONITORING_ERR_OUT_OF_MEMORY;
+      return (-1);
+    }
+
+  c->session_cache_max = max_sessions;
+  c->session_cache_idle_timeout = idle_timeout;
+  return (0);
+}
+
+void
+ipmi_monitoring_session_cache_destroy (ipmi_monitoring_ctx_t c)
+{
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (!c->session_cache_entry);
+
+  if (c->session_cache)
+    {
+      list_destroy (c->session_cache);
+      c->session_cache = NULL;
+    }
+  c->session_cache_max = 0;
+  c->session_cache_idle_timeout = 0;
+}
+
+int
+ipmi_monitoring_session_cache_get (ipmi_monitoring_ctx_t c,
+                                   const char *hostname,
+                                   struct ipmi_monitoring_ipmi_config *config)
+{
+  struct ipmi_monitoring_session_cache_entry *entry = NULL;
+  ipmi_monitoring_ctx_t pc;
+  ListIterator itr;
+  List reap;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (hostname);
+  assert (!c->ipmi_ctx);
+  assert (!c->sdr_ctx);
+  assert (!c->session_cache_entry);
+
+  pc = _session_cache_ctx (c);
+
+  if (!pc->session_cache)
+    return (0);
+
+  reap = list_create ((ListDelF)_ipmi_monitoring_session_cache_entry_destroy);
+
+  pthread_mutex_lock (&pc->session_cache_lock);
+
+  _session_cache_expire (pc, time (NULL), reap);
+
+  if ((itr = list_iterator_create (pc->session_cache)))
+    {
+      while ((entry = list_next (itr)))
+        {
+          if (!strcmp (entry->hostname, hostname))
+            {
+              list_remove (itr);
+              break;
+            }
+        }
+      list_iterator_destroy (itr);
+    }
+  else
+    IPMI_MONITORING_DEBUG (("list_iterator_create: %s", strerror (errno)));
+
+  pthread_mutex_unlock (&pc->session_cache_lock);
+
+  if (reap)
+    list_destroy (reap);
+
+  if (!entry)
+    return (0);
+
+  if (!_config_match (entry, config)
+      || !_session_alive (c, entry))
+    {
+      _ipmi_monitoring_session_cache_entry_destroy (entry);
+      return (0);
+    }
+
+  /* ipmi_ctx remains owned by the entry, the SDR is owned by the
+   * monitoring context until the session is released.
+   */
+  c->ipmi_ctx = entry->ipmi_ctx;
+  c->sdr_ctx = entry->sdr_ctx;
+  entry->sdr_ctx = NULL;
+  c->session_cache_entry = entry;
+  return (1);
+}
+
+void
+ipmi_monitoring_session_cache_add (ipmi_monitoring_ctx_t c,
+                                   const char *hostname,
+                                   struct ipmi_monitoring_ipmi_config *config)
+{
+  struct ipmi_monitoring_session_cache_entry *entry;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (hostname);
+  assert (c->ipmi_ctx);
+  assert (!c->session_cache_entry);
+
+  if (!_session_cache_ctx (c)->session_cache)
+    return;
+
+  if (strlen (hostname) > MAXHOSTNAMELEN
+      || (config && config->username && strlen (config->username) > IPMI_MAX_USER_NAME_LENGTH)
+      || (config && config->password && strlen (config->password) > IPMI_2_0_MAX_PASSWORD_LENGTH)
+      || (config && config->k_g && config->k_g_len > IPMI_MAX_K_G_LENGTH))
+    return;
+
+  if (_ipmi_monitoring_flags & IPMI_MONITORING_FLAGS_LOCK_MEMORY)
+    {
+      if (!(entry = (struct ipmi_monitoring_session_cache_entry *)secure_malloc (sizeof (struct ipmi_monitoring_session_cache_entry))))
+        return;
+      /* secure_memset called in secure_malloc()*/
+    }
+  else
+    {
+      if (!(entry = (struct ipmi_monitoring_session_cache_entry *)malloc (sizeof (struct ipmi_monitoring_session_cache_entry))))
+        return;
+      memset (entry, '\0', sizeof (struct ipmi_monitoring_session_cache_entry));
+    }
+
+  strcpy (entry->hostname, hostname);
+
+  if (config)
+    {
+      entry->config_set = 1;
+      entry->protocol_version = config->protocol_version;
+      if (config->username)
+        {
+          strcpy (entry->username, config->username);
+          entry->username_set = 1;
+        }
+      if (config->password)
+        {
+          strcpy (entry->password, config->password);
+          entry->password_set = 1;
+        }
+      if (config->k_g && config->k_g_len)
+        {
+          memcpy (entry->k_g, config->k_g, config->k_g_len);
+          entry->k_g_len = config->k_g_len;
+        }
+      entry->privilege_level = config->privilege_level;
+      entry->authentication_type = config->authentication_type;
+      entry->cipher_suite_id = config->cipher_suite_id;
+      entry->session_timeout_len = config->session_timeout_len;
+      entry->retransmission_timeout_len = config->retransmission_timeout_len;
+      entry->workaround_flags = config->workaround_flags;
+    }
+
+  /* added to the list when released */
+  entry->ipmi_ctx = c->ipmi_ctx;
+  c->session_cache_entry = entry;
+}
+
+void
+ipmi_monitoring_session_cache_release (ipmi_monitoring_ctx_t c)
+{
+  struct ipmi_monitoring_session_cache_entry *entry;
+  ipmi_monitoring_ctx_t pc;
+  List reap;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (c->session_cache_entry);
+
+  pc = _session_cache_ctx (c);
+  assert (pc->session_cache);
+
+  entry = c->session_cache_entry;
+  assert (entry->ipmi_ctx == c->ipmi_ctx);
+
+  /* ipmi_monitoring_sdr_cache_unload() leaves the SDR open for us */
+  entry->sdr_ctx = c->sdr_ctx;
+  c->sdr_ctx = NULL;
+  c->ipmi_ctx = NULL;
+  c->session_cache_entry = NULL;
+  entry->last_used = time (NULL);
+
+  /* The session is likely gone on the BMC, don't bother checking it
+   * next time.
+   */
+  if (ipmi_ctx_errnum (entry->ipmi_ctx) == IPMI_ERR_SESSION_TIMEOUT)
+    {
+      _ipmi_monitoring_session_cache_entry_destroy (entry);
+      return;
+    }
+
+  reap = list_create ((ListDelF)_ipmi_monitoring_session_cache_entry_destroy);
+
+  pthread_mutex_lock (&pc->session_cache_lock);
+
+  /* evict least recently used */
+  while (list_count (pc->session_cache) >= (int)pc->session_cache_max)
+    _session_cache_reap (reap, list_dequeue (pc->session_cache));
+
+  if (!list_append (pc->session_cache, entry))
+    {
+      IPMI_MONITORING_DEBUG (("list_append: %s", strerror (errno)));
+      _session_cache_reap (reap, entry);
+    }
+
+  pthread_mutex_unlock (&pc->session_cache_lock);
+
+  if (reap)
+    list_destroy (reap);
+}
+
+void
+ipmi_monitoring_session_cache_flush (ipmi_monitoring_ctx_t c)
+{
+  struct ipmi_monitoring_session_cache_entry *entry;
+
+  assert (c);
+  assert (c->magic == IPMI_MONITORING_MAGIC);
+  assert (!c->session_cache_parent);
+  assert (!c->session_cache_entry);
+
+  if (!c->session_cache)
+    return;
+
+  pthread_mutex_lock (&c->session_cache_lock);
+  while ((entry = list_dequeue (c->session_cache)))
+    _ipmi_monitoring_session_cache_entry_destroy (entry);
+  pthread_mutex_unlock (&c->session_cache_lock);
+}
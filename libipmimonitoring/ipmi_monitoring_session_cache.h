@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2003-2015 FreeIPMI Core Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IPMI_MONITORING_SESSION_CACHE_H
+#define IPMI_MONITORING_SESSION_CACHE_H
+
+#include "ipmi_monitoring.h"
+
+/* max_sessions of 0 disables the cache */
+int ipmi_monitoring_session_cache_setup (ipmi_monitoring_ctx_t c,
+                                         unsigned int max_sessions,
+                                         unsigned int idle_timeout);
+
+void ipmi_monitoring_session_cache_destroy (ipmi_monitoring_ctx_t c);
+
+/* Returns 1 if c->ipmi_ctx and c->sdr_ctx were set from a cached
+ * session, 0 if not.
+ */
+int ipmi_monitoring_session_cache_get (ipmi_monitoring_ctx_t c,
+                                       const char *hostname,
+                                       struct ipmi_monitoring_ipmi_config *config);
+
+/* Cache the session just opened in c->ipmi_ctx.  Failure to cache is
+ * not an error, the session is simply closed after use.
+ */
+void ipmi_monitoring_session_cache_add (ipmi_monitoring_ctx_t c,
+                                        const char *hostname,
+                                        struct ipmi_monitoring_ipmi_config *config);
+
+/* Return the session in use back to the cache */
+void ipmi_monitoring_session_cache_release (ipmi_monitoring_ctx_t c);
+
+/* Close all cached sessions */
+void ipmi_monitoring_session_cache_flush (ipmi_monitoring_ctx_t c);
+
+#endif /* IPMI_MONITORING_SESSION_CACHE_H */